@@ -36,6 +36,7 @@
 #include <termios.h>
 #include <stdarg.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <assert.h>
 #include <sys/types.h>
@@ -54,6 +55,9 @@
 /* Each 10 bits takes ~ 3 digits, plus one, plus one for nul terminator. */
 #define MAX_STRLEN(x) ((sizeof(x) * CHAR_BIT + CHAR_BIT-1) / 10 * 3 + 2)
 
+/* How many log segments are gathered into a single writev() */
+#define LOG_IOV_MAX 64
+
 /* How many events are allowed in each time period */
 #define RATE_LIMIT_ALLOWANCE 30
 /* Duration of each time period in ms */
@@ -263,6 +267,30 @@ static int write_all(int fd, const char* buf, size_t len)
 	return 0;
 }
 
+static int writev_all(int fd, struct iovec *iov, int iovcnt)
+{
+	while (iovcnt) {
+		ssize_t ret = writev(fd, iov, iovcnt);
+
+		if (ret == -1 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -1;
+
+		while (iovcnt && (size_t)ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt) {
+			iov->iov_base = (char *)iov->iov_base + ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
 static int write_with_timestamp(int fd, const char *data, size_t sz,
 				int *needts)
 {
@@ -271,6 +299,8 @@ static int write_with_timestamp(int fd, const char *data, size_t sz,
 	const struct tm *tmnow = localtime(&now);
 	size_t tslen = strftime(ts, sizeof(ts), "[%Y-%m-%d %H:%M:%S] ", tmnow);
 	const char *last_byte = data + sz - 1;
+	struct iovec iov[LOG_IOV_MAX];
+	int iovcnt = 0;
 
 	while (data <= last_byte) {
 		const char *nl = memchr(data, '\n', last_byte + 1 - data);
@@ -278,9 +308,28 @@ static int write_with_timestamp(int fd, const char *data, size_t sz,
 		if (!found_nl)
 			nl = last_byte;
 
-		if ((*needts && write_all(fd, ts, tslen))
-		    || write_all(fd, data, nl + 1 - data))
-			return -1;
+		if (replace_escape) {
+			/* Escapes are rewritten in a bounce buffer. */
+			if ((*needts && write_all(fd, ts, tslen))
+			    || write_all(fd, data, nl + 1 - data))
+				return -1;
+		} else {
+			/*
+			 * Gather the timestamps and lines, so that a burst of
+			 * guest output costs a few syscalls, not two per line.
+			 */
+			if (iovcnt > LOG_IOV_MAX - 2) {
+				if (writev_all(fd, iov, iovcnt))
+					return -1;
+				iovcnt = 0;
+			}
+			if (*needts) {
+				iov[iovcnt].iov_base = ts;
+				iov[iovcnt++].iov_len = tslen;
+			}
+			iov[iovcnt].iov_base = (void *)data;
+			iov[iovcnt++].iov_len = nl + 1 - data;
+		}
 
 		*needts = found_nl;
 		data = nl + 1;
@@ -291,6 +340,9 @@ static int write_with_timestamp(int fd, const char *data, size_t sz,
 		}
 	}
 
+	if (iovcnt && writev_all(fd, iov, iovcnt))
+		return -1;
+
 	return 0;
 }
 
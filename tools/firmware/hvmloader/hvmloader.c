@@ -28,6 +28,7 @@
 #include <acpi2_0.h>
 #include <xen/version.h>
 #include <xen/hvm/params.h>
+#include <xen/hvm/hvm_xs_strings.h>
 #include <xen/arch-x86/hvm/start_info.h>
 
 const struct hvm_start_info *hvm_start_info;
@@ -117,6 +118,7 @@ uint32_t ioapic_base_address = 0xfec00000;
 uint8_t ioapic_version;
 
 bool acpi_enabled;
+bool fast_boot;
 
 static void init_hypercalls(void)
 {
@@ -340,6 +342,12 @@ int main(void)
     bios = detect_bios();
     printf("System requested %s\n", bios->name);
 
+    acpi_enabled = !strncmp(xenstore_read("platform/acpi", "1"), "1", 1);
+
+    fast_boot = !strncmp(xenstore_read(HVM_XS_FAST_BOOT, "0"), "1", 1);
+    if ( fast_boot )
+        printf("Fast boot requested\n");
+
     printf("CPU speed is %u MHz\n", get_cpu_mhz());
 
     apic_setup();
@@ -347,7 +355,8 @@ int main(void)
 
     smp_initialise();
 
-    perform_tests();
+    if ( !fast_boot )
+        perform_tests();
 
     if ( bios->bios_info_setup )
         bios->bios_info_setup();
@@ -388,7 +397,12 @@ int main(void)
         BUG();
     }
 
-    if ( (hvm_info->nr_vcpus > 1) || hvm_info->apic_mode )
+    /*
+     * MP and $PIR tables are only consumed by OSes predating ACPI (or booted
+     * with ACPI disabled).
+     */
+    if ( ((hvm_info->nr_vcpus > 1) || hvm_info->apic_mode) &&
+         !(fast_boot && acpi_enabled) )
     {
         if ( bios->create_mp_tables )
             bios->create_mp_tables();
@@ -399,8 +413,6 @@ int main(void)
     if ( bios->load_roms )
         bios->load_roms();
 
-    acpi_enabled = !strncmp(xenstore_read("platform/acpi", "1"), "1", 1);
-
     if ( acpi_enabled )
     {
         init_vnuma_info();
@@ -84,6 +84,7 @@ void pci_setup(void)
     uint16_t class, vendor_id, device_id;
     unsigned int bar, pin, link, isa_irq;
     uint8_t pci_devfn_decode_type[256] = {};
+    bool skip_functions = false;
 
     /* Resources assignable to PCI devices via BARs. */
     struct resource {
@@ -154,12 +155,27 @@ void pci_setup(void)
     /* Scan the PCI bus and map resources. */
     for ( devfn = 0; devfn < 256; devfn++ )
     {
-        class     = pci_readw(devfn, PCI_CLASS_DEVICE);
-        vendor_id = pci_readw(devfn, PCI_VENDOR_ID);
-        device_id = pci_readw(devfn, PCI_DEVICE_ID);
+        uint32_t id;
+
+        /*
+         * In fast boot mode, don't probe the other functions of absent or
+         * single-function devices.
+         */
+        if ( (devfn & 7) && skip_functions )
+            continue;
+
+        id = pci_readl(devfn, PCI_VENDOR_ID);
+        vendor_id = id;
+        device_id = id >> 16;
+        if ( !(devfn & 7) )
+            skip_functions = fast_boot &&
+                             ((id == 0xffffffff) ||
+                              !(pci_readb(devfn, PCI_HEADER_TYPE) & 0x80));
         if ( (vendor_id == 0xffff) && (device_id == 0xffff) )
             continue;
 
+        class     = pci_readw(devfn, PCI_CLASS_DEVICE);
+
         ASSERT((devfn != PCI_ISA_DEVFN) ||
                ((vendor_id == 0x8086) && (device_id == 0x7000)));
 
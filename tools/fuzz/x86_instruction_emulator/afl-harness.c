@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,6 +9,11 @@
 
 static uint8_t input[INPUT_SIZE];
 
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+/* Have afl-fuzz pass test cases in shared memory rather than via stdin. */
+__AFL_FUZZ_INIT();
+#endif
+
 int main(int argc, char **argv)
 {
     size_t size;
@@ -21,9 +27,11 @@ int main(int argc, char **argv)
     {
         enum {
             OPT_MIN_SIZE,
+            OPT_QUIET,
         };
         static const struct option lopts[] = {
             { "min-input-size", no_argument, NULL, OPT_MIN_SIZE },
+            { "quiet", no_argument, NULL, OPT_QUIET },
             { 0, 0, 0, 0 }
         };
         int c = getopt_long_only(argc, argv, "", lopts, NULL);
@@ -38,8 +46,13 @@ int main(int argc, char **argv)
             exit(0);
             break;
 
+        case OPT_QUIET:
+            fuzz_quiet = true;
+            break;
+
         case '?':
-            printf("Usage: %s $FILE [$FILE...] | [--min-input-size]\n", argv[0]);
+            printf("Usage: %s [--quiet] $FILE [$FILE...] | [--min-input-size]\n",
+                   argv[0]);
             exit(-1);
             break;
 
@@ -50,6 +63,13 @@ int main(int argc, char **argv)
         }
     }
 
+    /*
+     * The tracing of every input dominates the cost of an iteration, and
+     * nobody reads it when running under afl-fuzz.
+     */
+    if ( getenv("__AFL_SHM_ID") )
+        fuzz_quiet = true;
+
     max = argc - optind;
 
     if ( !max ) /* No positional parameters.  Use stdin. */
@@ -64,6 +84,26 @@ int main(int argc, char **argv)
 #ifdef __AFL_HAVE_MANUAL_CONTROL
     __AFL_INIT();
 
+#ifdef __AFL_FUZZ_TESTCASE_LEN
+    if ( fp == stdin )
+    {
+        const uint8_t *buf = __AFL_FUZZ_TESTCASE_BUF;
+
+        /*
+         * Persistent mode with shared memory input: no read() or fseek()
+         * per iteration, and no copy of the test case.  Oversized inputs
+         * are truncated, as fread() would have done.
+         */
+        while ( __AFL_LOOP(1000) )
+        {
+            size = __AFL_FUZZ_TESTCASE_LEN;
+            LLVMFuzzerTestOneInput(buf, size < INPUT_SIZE ? size : INPUT_SIZE);
+        }
+
+        return 0;
+    }
+#endif
+
     for( count = 0; __AFL_LOOP(1000); )
 #else
     for( count = 0; count < max; count++ )
@@ -24,6 +24,12 @@
 #include <string.h>
 #include "fuzz-emul.h"
 
+/* Set to leave out the tracing of each input, e.g. for persistent fuzzing. */
+bool fuzz_quiet;
+
+#define trace_printf(fmt, ...) \
+    do { if ( !fuzz_quiet ) printf(fmt, ## __VA_ARGS__); } while ( 0 )
+
 #define MSR_INDEX_MAX 16
 
 #define SEG_NUM x86_seg_none
@@ -117,7 +123,7 @@ static int maybe_fail(struct x86_emulate_ctxt *ctxt,
     if ( rc == X86EMUL_EXCEPTION && !exception )
         rc = X86EMUL_OKAY;
 
-    printf("maybe_fail %s: %s\n", why, x86emul_return_string[rc]);
+    trace_printf("maybe_fail %s: %s\n", why, x86emul_return_string[rc]);
 
     if ( rc == X86EMUL_EXCEPTION )
         /* Fake up a pagefault. */
@@ -145,7 +151,7 @@ static int data_read(struct x86_emulate_ctxt *ctxt,
             x86_emul_hw_exception(13, 0, ctxt);
 
         rc = X86EMUL_EXCEPTION;
-        printf("data_read %s: X86EMUL_EXCEPTION (end of input)\n", why);
+        trace_printf("data_read %s: X86EMUL_EXCEPTION (end of input)\n", why);
     }
     else
         rc = maybe_fail(ctxt, why, true);
@@ -154,10 +160,10 @@ static int data_read(struct x86_emulate_ctxt *ctxt,
     {
         input_read(s, dst, bytes);
 
-        printf("%s: ", why);
+        trace_printf("%s: ", why);
         for ( i = 0; i < bytes; i++ )
-            printf(" %02x", *(unsigned char *)(dst + i));
-        printf("\n");
+            trace_printf(" %02x", *(unsigned char *)(dst + i));
+        trace_printf("\n");
     }
 
     return rc;
@@ -550,7 +556,7 @@ static int fuzz_read_msr(
         if ( (*val & EFER_LME) && (c->cr[4] & X86_CR4_PAE) &&
              (c->cr[0] & X86_CR0_PG) )
         {
-            printf("Setting EFER_LMA\n");
+            trace_printf("Setting EFER_LMA\n");
             *val |= EFER_LMA;
         }
         return X86EMUL_OKAY;
@@ -658,16 +664,16 @@ static void dump_state(struct x86_emulate_ctxt *ctxt)
     struct cpu_user_regs *regs = ctxt->regs;
     uint64_t val = 0;
 
-    printf(" -- State -- \n");
-    printf("addr / sp size: %d / %d\n", ctxt->addr_size, ctxt->sp_size);
-    printf(" cr0: %lx\n", c->cr[0]);
-    printf(" cr3: %lx\n", c->cr[3]);
-    printf(" cr4: %lx\n", c->cr[4]);
+    trace_printf(" -- State -- \n");
+    trace_printf("addr / sp size: %d / %d\n", ctxt->addr_size, ctxt->sp_size);
+    trace_printf(" cr0: %lx\n", c->cr[0]);
+    trace_printf(" cr3: %lx\n", c->cr[3]);
+    trace_printf(" cr4: %lx\n", c->cr[4]);
 
-    printf(" rip: %"PRIx64"\n", regs->rip);
+    trace_printf(" rip: %"PRIx64"\n", regs->rip);
 
     fuzz_read_msr(MSR_EFER, &val, ctxt);
-    printf("EFER: %"PRIx64"\n", val);
+    trace_printf("EFER: %"PRIx64"\n", val);
 }
 
 static bool long_mode_active(struct x86_emulate_ctxt *ctxt)
@@ -711,7 +717,7 @@ static void set_sizes(struct x86_emulate_ctxt *ctxt)
             _y |= (~0ULL) << (bits);                      \
         else                                              \
             _y &= (1ULL << (bits)) - 1;                   \
-        printf("Canonicalized %" PRIx64 " to %" PRIx64 "\n", x, _y);    \
+        trace_printf("Canonicalized %" PRIx64 " to %" PRIx64 "\n", x, _y);    \
         (x) = _y;                                       \
     } while( 0 )
 
@@ -757,7 +763,7 @@ enum {
     if ( bitmap & (1 << HOOK_##h) )                    \
     {                                                  \
         s->ops.h = NULL;                               \
-        printf("Disabling hook "#h"\n");               \
+        trace_printf("Disabling hook "#h"\n");         \
     }
 
 static void disable_hooks(struct x86_emulate_ctxt *ctxt)
@@ -907,13 +913,13 @@ int LLVMFuzzerTestOneInput(const uint8_t *data_p, size_t size)
 
     if ( size <= DATA_OFFSET )
     {
-        printf("Input too small\n");
+        trace_printf("Input too small\n");
         return 1;
     }
 
     if ( size > FUZZ_CORPUS_SIZE )
     {
-        printf("Input too large\n");
+        trace_printf("Input too large\n");
         return 1;
     }
 
@@ -934,7 +940,7 @@ int LLVMFuzzerTestOneInput(const uint8_t *data_p, size_t size)
         dump_state(&ctxt);
 
         rc = x86_emulate(&ctxt, &state.ops);
-        printf("Emulation result: %d\n", rc);
+        trace_printf("Emulation result: %d\n", rc);
     } while ( rc == X86EMUL_OKAY );
 
     return 0;
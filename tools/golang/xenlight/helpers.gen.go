@@ -701,6 +701,14 @@ x.StreamVersion = uint32(xc.stream_version)
 x.ColoProxyScript = C.GoString(xc.colo_proxy_script)
 if err := x.UserspaceColoProxy.fromC(&xc.userspace_colo_proxy);err != nil {
 return fmt.Errorf("converting field UserspaceColoProxy: %v", err)
+}
+x.AuxFds = nil
+if n := int(xc.num_aux_fds); n > 0 {
+cAuxFds := (*[1<<28]C.int)(unsafe.Pointer(xc.aux_fds))[:n:n]
+x.AuxFds = make([]int, n)
+for i, v := range cAuxFds {
+x.AuxFds[i] = int(v)
+}
 }
 
  return nil}
@@ -716,6 +724,14 @@ if x.ColoProxyScript != "" {
 xc.colo_proxy_script = C.CString(x.ColoProxyScript)}
 if err := x.UserspaceColoProxy.toC(&xc.userspace_colo_proxy); err != nil {
 return fmt.Errorf("converting field UserspaceColoProxy: %v", err)
+}
+if numAuxFds := len(x.AuxFds); numAuxFds > 0 {
+xc.aux_fds = (*C.int)(C.malloc(C.size_t(numAuxFds*numAuxFds)))
+xc.num_aux_fds = C.int(numAuxFds)
+cAuxFds := (*[1<<28]C.int)(unsafe.Pointer(xc.aux_fds))[:numAuxFds:numAuxFds]
+for i,v := range x.AuxFds {
+cAuxFds[i] = C.int(v)
+}
 }
 
  return nil
@@ -1010,6 +1026,14 @@ if err := x.VnumaNodes[i].fromC(&v); err != nil {
 return fmt.Errorf("converting field VnumaNodes: %v", err) }
 }
 }
+x.LlcColors = nil
+if n := int(xc.num_llc_colors); n > 0 {
+cLlcColors := (*[1<<28]C.uint32_t)(unsafe.Pointer(xc.llc_colors))[:n:n]
+x.LlcColors = make([]uint32, n)
+for i, v := range cLlcColors {
+x.LlcColors[i] = uint32(v)
+}
+}
 x.MaxGrantFrames = uint32(xc.max_grant_frames)
 x.MaxMaptrackFrames = uint32(xc.max_maptrack_frames)
 x.DeviceModelVersion = DeviceModelVersion(xc.device_model_version)
@@ -1223,6 +1247,9 @@ return fmt.Errorf("converting field Rdm: %v", err)
 }
 x.RdmMemBoundaryMemkb = uint64(tmp.rdm_mem_boundary_memkb)
 x.McaCaps = uint64(tmp.mca_caps)
+if err := x.FastBoot.fromC(&tmp.fast_boot);err != nil {
+return fmt.Errorf("converting field FastBoot: %v", err)
+}
 return nil
 }
 
@@ -1331,6 +1358,14 @@ return fmt.Errorf("converting field VnumaNodes: %v", err)
 }
 }
 }
+if numLlcColors := len(x.LlcColors); numLlcColors > 0 {
+xc.llc_colors = (*C.uint32_t)(C.malloc(C.size_t(numLlcColors*numLlcColors)))
+xc.num_llc_colors = C.int(numLlcColors)
+cLlcColors := (*[1<<28]C.uint32_t)(unsafe.Pointer(xc.llc_colors))[:numLlcColors:numLlcColors]
+for i,v := range x.LlcColors {
+cLlcColors[i] = C.uint32_t(v)
+}
+}
 xc.max_grant_frames = C.uint32_t(x.MaxGrantFrames)
 xc.max_maptrack_frames = C.uint32_t(x.MaxMaptrackFrames)
 xc.device_model_version = C.libxl_device_model_version(x.DeviceModelVersion)
@@ -1538,6 +1573,9 @@ return fmt.Errorf("converting field Rdm: %v", err)
 }
 hvm.rdm_mem_boundary_memkb = C.uint64_t(tmp.RdmMemBoundaryMemkb)
 hvm.mca_caps = C.uint64_t(tmp.McaCaps)
+if err := tmp.FastBoot.toC(&hvm.fast_boot); err != nil {
+return fmt.Errorf("converting field FastBoot: %v", err)
+}
 hvmBytes := C.GoBytes(unsafe.Pointer(&hvm),C.sizeof_libxl_domain_build_info_type_union_hvm)
 copy(xc.u[:],hvmBytes)
 case DomainTypePv:
@@ -210,6 +210,7 @@ ViridianEnlightenmentCrashCtl ViridianEnlightenment = 6
 ViridianEnlightenmentSynic ViridianEnlightenment = 7
 ViridianEnlightenmentStimer ViridianEnlightenment = 8
 ViridianEnlightenmentHcallIpi ViridianEnlightenment = 9
+ViridianEnlightenmentExProcessorMasks ViridianEnlightenment = 10
 )
 
 type Hdtype int
@@ -392,6 +393,7 @@ CheckpointedStream int
 StreamVersion uint32
 ColoProxyScript string
 UserspaceColoProxy Defbool
+AuxFds []int
 }
 
 type SchedParams struct {
@@ -474,6 +476,7 @@ DisableMigrate Defbool
 Cpuid CpuidPolicyList
 BlkdevStart string
 VnumaNodes []VnodeInfo
+LlcColors []uint32
 MaxGrantFrames uint32
 MaxMaptrackFrames uint32
 DeviceModelVersion DeviceModelVersion
@@ -566,6 +569,7 @@ SerialList StringList
 Rdm RdmReserve
 RdmMemBoundaryMemkb uint64
 McaCaps uint64
+FastBoot Defbool
 }
 
 func (x DomainBuildInfoTypeUnionHvm) isdomainBuildInfoTypeUnion(){}
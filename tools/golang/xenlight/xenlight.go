@@ -32,6 +32,27 @@ static const libxl_childproc_hooks childproc_hooks = { .chldowner = libxl_sigchl
 void xenlight_set_chldproc(libxl_ctx *ctx) {
 	libxl_childproc_setmode(ctx, &childproc_hooks, NULL);
 }
+
+// Domains which don't exist are skipped: returns the number of entries of
+// info filled in, or a libxl error.
+static int xenlight_domain_info_batch(libxl_ctx *ctx, libxl_dominfo *info,
+                                      const uint32_t *domids, int nr) {
+	int i, n = 0, rc;
+
+	for (i = 0; i < nr; i++) {
+		libxl_dominfo_dispose(&info[n]);
+		libxl_dominfo_init(&info[n]);
+
+		rc = libxl_domain_info(ctx, &info[n], domids[i]);
+		if (rc == ERROR_DOMAIN_NOTFOUND)
+			continue;
+		if (rc)
+			return rc;
+		n++;
+	}
+
+	return n;
+}
 */
 import "C"
 
@@ -518,16 +539,21 @@ type Bitmap struct {
 }
 
 func (bm *Bitmap) fromC(cbm *C.libxl_bitmap) error {
-	bm.bitmap = nil
 	if size := int(cbm.size); size > 0 {
-		// Alloc a Go slice for the bytes
-		bm.bitmap = make([]C.uint8_t, size)
+		// Reuse the Go slice if it is big enough, else alloc one
+		if cap(bm.bitmap) >= size {
+			bm.bitmap = bm.bitmap[:size]
+		} else {
+			bm.bitmap = make([]C.uint8_t, size)
+		}
 
 		// Make a slice pointing to the C array
 		cs := (*[1 << 30]C.uint8_t)(unsafe.Pointer(cbm._map))[:size:size]
 
 		// And copy the C array into the Go array
 		copy(bm.bitmap, cs)
+	} else {
+		bm.bitmap = nil
 	}
 
 	return nil
@@ -1015,6 +1041,20 @@ func (Ctx *Context) GetVersionInfo() (info *VersionInfo, err error) {
 }
 
 func (Ctx *Context) DomainInfo(Id Domid) (di *Dominfo, err error) {
+	var info Dominfo
+
+	if err = Ctx.DomainInfoInto(Id, &info); err != nil {
+		return
+	}
+
+	di = &info
+
+	return
+}
+
+// DomainInfoInto is DomainInfo, filling in di rather than allocating a
+// new Dominfo.
+func (Ctx *Context) DomainInfoInto(Id Domid, di *Dominfo) error {
 	var cdi C.libxl_dominfo
 	C.libxl_dominfo_init(&cdi)
 	defer C.libxl_dominfo_dispose(&cdi)
@@ -1022,13 +1062,87 @@ func (Ctx *Context) DomainInfo(Id Domid) (di *Dominfo, err error) {
 	ret := C.libxl_domain_info(Ctx.ctx, &cdi, C.uint32_t(Id))
 
 	if ret != 0 {
-		err = Error(-ret)
+		return Error(-ret)
+	}
+
+	return di.fromC(&cdi)
+}
+
+// DominfoBatch gets the information of many domains with a single call
+// into C, instead of one cgo call (and one Dominfo allocation) per domain.
+// Its C buffers are kept from one call to the next, so once they have
+// grown to the number of domains asked for, Get allocates nothing beyond
+// the SsidLabel strings of domains which have one.
+//
+// A DominfoBatch must not be used from several goroutines at once, and
+// must be freed with Close.
+type DominfoBatch struct {
+	ctx   *Context
+	cinfo *C.libxl_dominfo
+	size  int
+}
+
+// NewDominfoBatch returns an empty DominfoBatch using Ctx.
+func (Ctx *Context) NewDominfoBatch() *DominfoBatch {
+	return &DominfoBatch{ctx: Ctx}
+}
+
+// Get fills in out with the information of the domains in ids, in order,
+// and returns the filled in part of out.  Domains which don't exist are
+// left out: compare the Domid of each entry with ids to tell which.  out
+// is grown if it lacks capacity.
+func (b *DominfoBatch) Get(ids []Domid, out []Dominfo) ([]Dominfo, error) {
+	if len(ids) == 0 {
+		return out[:0], nil
+	}
+
+	if len(ids) > b.size {
+		b.Close()
+		b.cinfo = (*C.libxl_dominfo)(C.calloc(C.size_t(len(ids)),
+			C.sizeof_libxl_dominfo))
+		if b.cinfo == nil {
+			return out[:0], ErrorNomem
+		}
+		b.size = len(ids)
+	}
+
+	// Domid is a uint32, so ids can be handed to C as it is.
+	ret := C.xenlight_domain_info_batch(b.ctx.ctx, b.cinfo,
+		(*C.uint32_t)(unsafe.Pointer(&ids[0])), C.int(len(ids)))
+	if ret < 0 {
+		return out[:0], Error(-ret)
+	}
+
+	n := int(ret)
+	if cap(out) < n {
+		out = make([]Dominfo, n)
+	}
+	out = out[:n]
+
+	cslice := (*[1 << 30]C.libxl_dominfo)(unsafe.Pointer(b.cinfo))[:n:n]
+	for i := range cslice {
+		if err := out[i].fromC(&cslice[i]); err != nil {
+			return out[:i], err
+		}
+	}
+
+	return out, nil
+}
+
+// Close frees the C buffers of b.  b may be used again afterwards.
+func (b *DominfoBatch) Close() {
+	if b.cinfo == nil {
 		return
 	}
 
-	err = di.fromC(&cdi)
+	cslice := (*[1 << 30]C.libxl_dominfo)(unsafe.Pointer(b.cinfo))[:b.size:b.size]
+	for i := range cslice {
+		C.libxl_dominfo_dispose(&cslice[i])
+	}
+	C.free(unsafe.Pointer(b.cinfo))
 
-	return
+	b.cinfo = nil
+	b.size = 0
 }
 
 func (Ctx *Context) DomainUnpause(Id Domid) (err error) {
@@ -1073,19 +1187,29 @@ func (Ctx *Context) DomainReboot(id Domid) (err error) {
 //libxl_dominfo * libxl_list_domain(libxl_ctx*, int *nb_domain_out);
 //void libxl_dominfo_list_free(libxl_dominfo *list, int nb_domain);
 func (Ctx *Context) ListDomain() (glist []Dominfo) {
+	return Ctx.ListDomainInto(nil)
+}
+
+// ListDomainInto is ListDomain, reusing the storage of buf, e.g. the
+// result of a previous call, when it has enough capacity.
+func (Ctx *Context) ListDomainInto(buf []Dominfo) (glist []Dominfo) {
 	var nbDomain C.int
 	clist := C.libxl_list_domain(Ctx.ctx, &nbDomain)
 	defer C.libxl_dominfo_list_free(clist, nbDomain)
 
+	glist = buf[:0]
 	if int(nbDomain) == 0 {
 		return
 	}
 
+	if cap(glist) < int(nbDomain) {
+		glist = make([]Dominfo, nbDomain)
+	}
+	glist = glist[:nbDomain]
+
 	gslice := (*[1 << 30]C.libxl_dominfo)(unsafe.Pointer(clist))[:nbDomain:nbDomain]
 	for i := range gslice {
-		var info Dominfo
-		_ = info.fromC(&gslice[i])
-		glist = append(glist, info)
+		_ = glist[i].fromC(&gslice[i])
 	}
 
 	return
@@ -1095,21 +1219,32 @@ func (Ctx *Context) ListDomain() (glist []Dominfo) {
 //				int *nb_vcpu, int *nr_cpus_out);
 //void libxl_vcpuinfo_list_free(libxl_vcpuinfo *, int nr_vcpus);
 func (Ctx *Context) ListVcpu(id Domid) (glist []Vcpuinfo) {
+	return Ctx.ListVcpuInto(id, nil)
+}
+
+// ListVcpuInto is ListVcpu, reusing the storage of buf, e.g. the result of
+// a previous call, when it has enough capacity.  This includes the
+// Cpumap and CpumapSoft bitmaps of its entries.
+func (Ctx *Context) ListVcpuInto(id Domid, buf []Vcpuinfo) (glist []Vcpuinfo) {
 	var nbVcpu C.int
 	var nrCpu C.int
 
 	clist := C.libxl_list_vcpu(Ctx.ctx, C.uint32_t(id), &nbVcpu, &nrCpu)
 	defer C.libxl_vcpuinfo_list_free(clist, nbVcpu)
 
+	glist = buf[:0]
 	if int(nbVcpu) == 0 {
 		return
 	}
 
+	if cap(glist) < int(nbVcpu) {
+		glist = make([]Vcpuinfo, nbVcpu)
+	}
+	glist = glist[:nbVcpu]
+
 	gslice := (*[1 << 30]C.libxl_vcpuinfo)(unsafe.Pointer(clist))[:nbVcpu:nbVcpu]
 	for i := range gslice {
-		var info Vcpuinfo
-		_ = info.fromC(&gslice[i])
-		glist = append(glist, info)
+		_ = glist[i].fromC(&gslice[i])
 	}
 
 	return
@@ -42,6 +42,7 @@
  *  compile time, so the macros in ring.h cannot be used to access the rings.
  */
 
+#include <sys/uio.h>
 #include <xen/io/libxenvchan.h>
 #include <xen/xen.h>
 #include <xen/sys/evtchn.h>
@@ -153,6 +154,34 @@ int libxenvchan_send(struct libxenvchan *ctrl, const void *data, size_t size);
  *         the vchan is nonblocking)
  */
 int libxenvchan_write(struct libxenvchan *ctrl, const void *data, size_t size);
+/**
+ * Packet-based gather send: send all segments if possible, notifying the
+ * peer once for the whole batch rather than once per segment.
+ * @param ctrl The vchan control structure
+ * @param iov Segments to send
+ * @param iovcnt Number of segments
+ * @return -1 on error (including a total larger than the ring), 0 if
+ *         nonblocking and insufficient space is available, or the total size
+ */
+int libxenvchan_writev(struct libxenvchan *ctrl, const struct iovec *iov,
+                       int iovcnt);
+/**
+ * Zero-copy receive: return a pointer to the next contiguous run of data in
+ * the ring without consuming it. The data lives in memory shared with the
+ * peer, so it must be validated after copying anything security relevant.
+ * @param ctrl The vchan control structure
+ * @param data Set to the start of the readable data
+ * @return -1 on error, otherwise the number of bytes readable at *data (which
+ *         may be zero if the vchan is nonblocking)
+ */
+int libxenvchan_read_peek(struct libxenvchan *ctrl, const void **data);
+/**
+ * Release data obtained by libxenvchan_read_peek() back to the peer.
+ * @param ctrl The vchan control structure
+ * @param size Number of bytes to consume
+ * @return -1 on error or if size exceeds the data ready, otherwise size
+ */
+int libxenvchan_read_consume(struct libxenvchan *ctrl, size_t size);
 /**
  * Waits for reads or writes to unblock, or for a close
  */
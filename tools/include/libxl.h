@@ -127,6 +127,14 @@
  */
 #define LIBXL_HAVE_CPUPOOL_ADD_REM_CPUMAP 1
 
+/* LIBXL_HAVE_CPUPOOL_MOVEDOMAINS
+ *
+ * If this is defined, libxl has a library function called
+ * libxl_cpupool_movedomains, which moves all the domains in an array
+ * to a cpupool with a single operation.
+ */
+#define LIBXL_HAVE_CPUPOOL_MOVEDOMAINS 1
+
 /*
  *
  * LIBXL_HAVE_BITMAP_AND_OR
@@ -1310,6 +1318,60 @@ void libxl_mac_copy(libxl_ctx *ctx, libxl_mac *dst, const libxl_mac *src);
  */
 #define LIBXL_HAVE_CREATEINFO_XEND_SUSPEND_EVTCHN_COMPAT
 
+/*
+ * LIBXL_HAVE_BUILDINFO_HVM_FAST_BOOT
+ *
+ * libxl_domain_build_info contains a boolean 'u.hvm.fast_boot' value to
+ * make hvmloader skip setup steps only needed for legacy guests.
+ */
+#define LIBXL_HAVE_BUILDINFO_HVM_FAST_BOOT
+
+/*
+ * LIBXL_HAVE_BUILDINFO_LLC_COLORS
+ *
+ * libxl_domain_build_info contains an array 'llc_colors' of the LLC colors
+ * the domain's memory is allocated from, if Xen has LLC coloring enabled.
+ */
+#define LIBXL_HAVE_BUILDINFO_LLC_COLORS
+
+/*
+ * LIBXL_HAVE_MIGRATION_AUX_STREAMS
+ *
+ * If this is defined, libxl_domain_suspend_streams() spreads the memory of
+ * a live migration across further auxiliary streams, e.g. extra TCP
+ * connections to the destination, which are passed to the receiving
+ * libxl_domain_create_restore() in the 'aux_fds' array of
+ * libxl_domain_restore_params, in any order.
+ */
+#define LIBXL_HAVE_MIGRATION_AUX_STREAMS
+
+/*
+ * LIBXL_HAVE_SUSPEND_AUTO_CONVERGE
+ *
+ * If this is defined, libxl_domain_suspend() accepts
+ * LIBXL_SUSPEND_AUTO_CONVERGE alongside LIBXL_SUSPEND_LIVE: the vcpus of a
+ * domain which dirties memory faster than it can be sent are throttled,
+ * through the scheduler's cap, until the end of the live phase.
+ */
+#define LIBXL_HAVE_SUSPEND_AUTO_CONVERGE
+
+/*
+ * LIBXL_HAVE_DOMAIN_MOVE_MEMORY
+ *
+ * If this is defined, libxl_domain_move_memory() exists, moving the memory
+ * of an HVM domain onto a given NUMA node.
+ */
+#define LIBXL_HAVE_DOMAIN_MOVE_MEMORY
+
+/*
+ * LIBXL_HAVE_DOMAIN_PREWARM
+ *
+ * If this is defined, libxl_domain_prewarm_add() and
+ * libxl_domain_prewarm_claim() exist, for keeping pools of fully built
+ * paused domains which can be started without waiting for domain creation.
+ */
+#define LIBXL_HAVE_DOMAIN_PREWARM
+
 typedef char **libxl_string_list;
 void libxl_string_list_dispose(libxl_string_list *sl);
 int libxl_string_list_length(const libxl_string_list *sl);
@@ -1672,6 +1734,17 @@ int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd,
                          LIBXL_EXTERNAL_CALLERS_ONLY;
 #define LIBXL_SUSPEND_DEBUG 1
 #define LIBXL_SUSPEND_LIVE 2
+#define LIBXL_SUSPEND_AUTO_CONVERGE 4
+
+/*
+ * As libxl_domain_suspend(), with num_aux_fds auxiliary streams.  These must
+ * be in blocking mode, and are only used by a LIBXL_SUSPEND_LIVE save.
+ */
+int libxl_domain_suspend_streams(libxl_ctx *ctx, uint32_t domid, int fd,
+                                 const int *aux_fds, int num_aux_fds,
+                                 int flags, /* LIBXL_SUSPEND_* */
+                                 const libxl_asyncop_how *ao_how)
+                                 LIBXL_EXTERNAL_CALLERS_ONLY;
 
 /*
  * Only suspend domain, do not save its state to file, do not destroy it.
@@ -1749,6 +1822,21 @@ int libxl_domain_rename(libxl_ctx *ctx, uint32_t domid,
 int libxl_domain_pause(libxl_ctx *ctx, uint32_t domid,
                        const libxl_asyncop_how *ao_how)
                        LIBXL_EXTERNAL_CALLERS_ONLY;
+
+/*
+ * Prewarmed domains: domains created paused, from the same configuration,
+ * and put in a named pool with libxl_domain_prewarm_add().  A later
+ * libxl_domain_prewarm_claim() takes one out of the pool, gives it @name
+ * and unpauses it, returning its domid in @domid_r, which is a lot faster
+ * than creating a domain.  ERROR_NOTFOUND means the pool is empty.  If
+ * unpausing fails the domain is not returned to the pool.
+ */
+int libxl_domain_prewarm_add(libxl_ctx *ctx, uint32_t domid,
+                             const char *pool);
+int libxl_domain_prewarm_claim(libxl_ctx *ctx, const char *pool,
+                               const char *name, uint32_t *domid_r,
+                               const libxl_asyncop_how *ao_how)
+                               LIBXL_EXTERNAL_CALLERS_ONLY;
 int libxl_domain_unpause(libxl_ctx *ctx, uint32_t domid,
                          const libxl_asyncop_how *ao_how)
                          LIBXL_EXTERNAL_CALLERS_ONLY;
@@ -2479,6 +2567,12 @@ int libxl_domain_set_nodeaffinity(libxl_ctx *ctx, uint32_t domid,
                                   libxl_bitmap *nodemap);
 int libxl_domain_get_nodeaffinity(libxl_ctx *ctx, uint32_t domid,
                                   libxl_bitmap *nodemap);
+/*
+ * Set a domain's node affinity to @node and move the memory it already has
+ * there.  If @nr_moved is not NULL, it returns the number of pages moved.
+ */
+int libxl_domain_move_memory(libxl_ctx *ctx, uint32_t domid, uint32_t node,
+                             uint64_t *nr_moved);
 int libxl_set_vcpuonline(libxl_ctx *ctx, uint32_t domid,
                          libxl_bitmap *cpumap,
                          const libxl_asyncop_how *ao_how)
@@ -2612,6 +2706,8 @@ int libxl_cpupool_cpuremove_node(libxl_ctx *ctx, uint32_t poolid, int node, int
 int libxl_cpupool_cpuremove_cpumap(libxl_ctx *ctx, uint32_t poolid,
                                    const libxl_bitmap *cpumap);
 int libxl_cpupool_movedomain(libxl_ctx *ctx, uint32_t poolid, uint32_t domid);
+int libxl_cpupool_movedomains(libxl_ctx *ctx, uint32_t poolid,
+                              const uint32_t *domids, int nr_doms);
 int libxl_cpupool_info(libxl_ctx *ctx, libxl_cpupoolinfo *info, uint32_t poolid);
 
 int libxl_domid_valid_guest(uint32_t domid);
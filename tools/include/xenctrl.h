@@ -684,6 +684,79 @@ int xc_domain_node_getaffinity(xc_interface *xch,
                                uint32_t domind,
                                xc_nodemap_t nodemap);
 
+/**
+ * This function moves the memory backing a range of a (HVM) domain's
+ * guest frames onto the given host NUMA node.  Frames which are already
+ * there, or which are in use by something other than the guest itself,
+ * are left alone.  The domain is paused while its memory is copied.
+ *
+ * @parm xch a handle to an open hypervisor interface.
+ * @parm domid the domain id one wants to move the memory of.
+ * @parm first_gfn the first guest frame of the range.
+ * @parm nr_gfns the number of guest frames in the range.
+ * @parm node the host NUMA node to move the memory to.
+ * @parm nr_migrated if not NULL, returns the number of frames moved.
+ * @return 0 on success, -1 on failure.
+ */
+int xc_domain_numa_migrate(xc_interface *xch,
+                           uint32_t domid,
+                           xen_pfn_t first_gfn,
+                           unsigned long nr_gfns,
+                           unsigned int node,
+                           unsigned long *nr_migrated);
+
+/**
+ * This function sets the LLC colors a domain's memory is allocated from.
+ * It must be called before any memory is populated for the domain, and
+ * fails with EOPNOTSUPP if Xen doesn't have LLC coloring enabled.
+ *
+ * @parm xch a handle to an open hypervisor interface.
+ * @parm domid the domain id to set the colors of.
+ * @parm llc_colors the array of colors.
+ * @parm num_llc_colors the number of colors in the array.
+ * @return 0 on success, -1 on failure.
+ */
+int xc_domain_set_llc_colors(xc_interface *xch,
+                             uint32_t domid,
+                             const uint32_t *llc_colors,
+                             uint32_t num_llc_colors);
+
+/**
+ * This function turns hardware accessed-bit tracking of a (HVM, EPT)
+ * domain's memory on or off, for use by xc_domain_get_accessed().
+ *
+ * @parm xch a handle to an open hypervisor interface.
+ * @parm domid the domain id.
+ * @parm enable whether to enable or disable tracking.
+ * @return 0 on success, -1 on failure.
+ */
+int xc_domain_track_accessed(xc_interface *xch,
+                             uint32_t domid,
+                             bool enable);
+
+/**
+ * This function reports which guest frames of a range have been accessed
+ * since tracking was enabled or since the last clearing call, which can be
+ * used to estimate a domain's working set.  Frames mapped by one superpage
+ * are reported together.
+ *
+ * @parm xch a handle to an open hypervisor interface.
+ * @parm domid the domain id.
+ * @parm first_gfn the first guest frame of the range.
+ * @parm nr_gfns the number of guest frames in the range.
+ * @parm clear whether to also clear the accessed state.
+ * @parm bitmap if not NULL, one bit per frame of the range, set if accessed.
+ * @parm nr_accessed if not NULL, returns the number of frames accessed.
+ * @return 0 on success, -1 on failure.
+ */
+int xc_domain_get_accessed(xc_interface *xch,
+                           uint32_t domid,
+                           xen_pfn_t first_gfn,
+                           unsigned long nr_gfns,
+                           bool clear,
+                           uint8_t *bitmap,
+                           unsigned long *nr_accessed);
+
 /**
  * This function specifies the CPU affinity for a vcpu.
  *
@@ -809,6 +882,21 @@ int xc_domain_getinfolist(xc_interface *xch,
                           unsigned int max_domains,
                           xc_domaininfo_t *info);
 
+/**
+ * As xc_domain_getinfolist(), additionally returning the hypervisor's
+ * domain list generation, which changes whenever a domain is created or
+ * destroyed.  Pollers seeing an unchanged generation know the set of
+ * domains to be the same as last time.
+ *
+ * @parm generation returns the domain list generation
+ * @return the number of domains enumerated or -1 on error
+ */
+int xc_domain_getinfolist_generation(xc_interface *xch,
+                                     uint32_t first_domain,
+                                     unsigned int max_domains,
+                                     xc_domaininfo_t *info,
+                                     uint32_t *generation);
+
 /**
  * This function set p2m for broken page
  * &parm xch a handle to an open hypervisor interface
@@ -954,6 +1042,23 @@ int xc_shadow_control(xc_interface *xch,
                       uint32_t mode,
                       xc_shadow_op_stats_t *stats);
 
+/*
+ * As xc_shadow_control() for XEN_DOMCTL_SHADOW_OP_{CLEAN,PEEK}, but reporting
+ * dirty pages as a list of ranges.  On entry *nr_ranges is the capacity of
+ * ranges; on success it is updated with the number of entries used.  Returns
+ * the number of pages scanned, which is less than pages if the list filled
+ * up, or -1 on error.
+ */
+typedef struct xen_domctl_shadow_op_range xc_shadow_op_range_t;
+int xc_shadow_control_ranges(xc_interface *xch,
+                             uint32_t domid,
+                             unsigned int sop,
+                             xc_hypercall_buffer_t *ranges,
+                             unsigned int *nr_ranges,
+                             unsigned long pages,
+                             uint32_t mode,
+                             xc_shadow_op_stats_t *stats);
+
 int xc_sched_credit_domain_set(xc_interface *xch,
                                uint32_t domid,
                                struct xen_domctl_sched_credit *sdom);
@@ -1169,6 +1274,20 @@ int xc_cpupool_movedomain(xc_interface *xch,
                           uint32_t poolid,
                           uint32_t domid);
 
+/**
+ * Move several domains to another cpupool in one go.
+ *
+ * @parm xc_handle a handle to an open hypervisor interface
+ * @parm poolid id of the destination cpupool
+ * @parm domids ids of the domains to move
+ * @parm nr_doms number of entries in domids
+ * return 0 on success, -1 on failure
+ */
+int xc_cpupool_movedomains(xc_interface *xch,
+                           uint32_t poolid,
+                           const uint32_t *domids,
+                           unsigned int nr_doms);
+
 /**
  * Return map of cpus not in any cpupool.
  *
@@ -2045,6 +2164,13 @@ int xc_vm_event_get_version(xc_interface *xch);
  * Caller has to unmap this page when done.
  */
 void *xc_monitor_enable(xc_interface *xch, uint32_t domain_id, uint32_t *port);
+/*
+ * As xc_monitor_enable(), but with the ring spanning nr_frames (at most
+ * XEN_VM_EVENT_RING_FRAMES_MAX) contiguous pages starting at the monitor ring
+ * GFN.  The caller has to unmap all nr_frames pages when done.
+ */
+void *xc_monitor_enable_frames(xc_interface *xch, uint32_t domain_id,
+                               unsigned int nr_frames, uint32_t *port);
 int xc_monitor_disable(xc_interface *xch, uint32_t domain_id);
 int xc_monitor_resume(xc_interface *xch, uint32_t domain_id);
 /*
@@ -2077,6 +2203,14 @@ int xc_monitor_guest_request(xc_interface *xch, uint32_t domain_id,
  */
 int xc_monitor_inguest_pagefault(xc_interface *xch, uint32_t domain_id,
                                  bool disable);
+/*
+ * Add (enable) or remove (!enable) the sub-page range [gpa, gpa + size),
+ * which must not cross a page boundary.  mem_access violations on a page with
+ * ranges which don't touch any of them are emulated by Xen without an event
+ * being sent.  Removing with size 0 drops all ranges.
+ */
+int xc_monitor_mem_access_filter(xc_interface *xch, uint32_t domain_id,
+                                 bool enable, uint64_t gpa, uint32_t size);
 int xc_monitor_debug_exceptions(xc_interface *xch, uint32_t domain_id,
                                 bool enable, bool sync);
 int xc_monitor_cpuid(xc_interface *xch, uint32_t domain_id, bool enable);
@@ -180,6 +180,24 @@ int xendevicemodel_destroy_ioreq_server(
 int xendevicemodel_set_ioreq_server_state(
     xendevicemodel_handle *dmod, domid_t domid, ioservid_t id, int enabled);
 
+/**
+ * This function sets how an IOREQ Server and the domain's vCPUs wait for
+ * each other.  With XEN_DMOP_IOREQ_POLL_REQUESTS in flags the emulator
+ * polls for requests and Xen stops notifying it of new ones.  A non-zero
+ * spin_ns makes a vCPU spin that long for a response before blocking.
+ * Responses must still be notified as usual.
+ *
+ * @parm dmod a handle to an open devicemodel interface.
+ * @parm domid the domain id to be serviced
+ * @parm id the IOREQ Server id.
+ * @parm flags XEN_DMOP_IOREQ_POLL_* flags.
+ * @parm spin_ns the vCPU spin time in ns (capped by Xen).
+ * @return 0 on success, -1 on failure.
+ */
+int xendevicemodel_set_ioreq_server_polling(
+    xendevicemodel_handle *dmod, domid_t domid, ioservid_t id,
+    uint32_t flags, uint32_t spin_ns);
+
 /**
  * This function sets the level of INTx pin of an emulated PCI device.
  *
@@ -296,6 +296,13 @@ int xengnttab_grant_copy(xengnttab_handle *xgt,
                          uint32_t count,
                          xengnttab_grant_copy_segment_t *segs);
 
+/*
+ * The dma-buf functions below let backends hand granted pages to other
+ * devices and drivers without copying.  They are only implemented on
+ * Linux; elsewhere they fail with EOPNOTSUPP, and backends should fall
+ * back to mapping or copying the grants.
+ */
+
 /*
  * Flags to be used while requesting memory mapping's backing storage
  * to be allocated with DMA API.
@@ -26,6 +26,12 @@
 
 #define XCFLAGS_LIVE      (1 << 0)
 #define XCFLAGS_DEBUG     (1 << 1)
+#define XCFLAGS_PIPELINE  (1 << 2) /* Write pages from a separate thread. */
+#define XCFLAGS_COMPRESS  (1 << 3) /* Send COMPRESSED_PAGE_DATA records. */
+#define XCFLAGS_POSTCOPY  (1 << 4) /* Demand-fetch the final dirty pages,
+                                      * or all pages if not live. */
+#define XCFLAGS_AUTO_CONVERGE (1 << 5) /* Throttle vcpus which dirty memory
+                                        * faster than it can be sent. */
 
 #define X86_64_B_SIZE   64 
 #define X86_32_B_SIZE   32
@@ -527,13 +533,20 @@ typedef enum {
  * @param flags XCFLAGS_xxx
  * @param stream_type XC_STREAM_PLAIN if the far end of the stream
  *        doesn't use checkpointing
- * @param recv_fd Only used for XC_STREAM_COLO.  Contains backchannel from
- *        the destination side.
+ * @param recv_fd Only used for XC_STREAM_COLO and XCFLAGS_POSTCOPY.  Contains
+ *        backchannel from the destination side.  May be -1 for
+ *        XCFLAGS_POSTCOPY, e.g. when saving to a file.
+ * @param aux_fds Auxiliary streams, e.g. further TCP connections to the
+ *        destination, across which the page data of a live XC_STREAM_PLAIN
+ *        pre-copy migration is spread.  The same number of streams, in any
+ *        order, must be passed to xc_domain_restore().
+ * @param nr_aux_fds the number of entries in aux_fds, or 0
  * @return 0 on success, -1 on failure
  */
 int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
                    uint32_t flags, struct save_callbacks *callbacks,
-                   xc_stream_type_t stream_type, int recv_fd);
+                   xc_stream_type_t stream_type, int recv_fd,
+                   const int *aux_fds, unsigned int nr_aux_fds);
 
 /* callbacks provided by xc_domain_restore */
 struct restore_callbacks {
@@ -555,6 +568,9 @@ struct restore_callbacks {
      * Called after the secondary vm is ready to resume.
      * Callback function resumes the guest & the device model,
      * returns to xc_domain_restore.
+     *
+     * Also used by post-copy streams, once the vcpu state has arrived and
+     * the remaining pages are to be fetched on demand while the guest runs.
      */
     int (*postcopy)(void *data);
 
@@ -606,8 +622,12 @@ struct restore_callbacks {
  *        checkpointing
  * @param callbacks non-NULL to receive a callback to restore toolstack
  *        specific data
- * @param send_back_fd Only used for XC_STREAM_COLO.  Contains backchannel to
- *        the source side.
+ * @param send_back_fd Only used for XC_STREAM_COLO and post-copy streams.
+ *        Contains backchannel to the source side.  May be -1 for a
+ *        post-copy stream, in which case vcpus wait for the pages in
+ *        stream order.
+ * @param aux_fds the auxiliary streams passed to xc_domain_save()
+ * @param nr_aux_fds the number of entries in aux_fds, or 0
  * @return 0 on success, -1 on failure
  */
 int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
@@ -615,7 +635,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
                       uint32_t store_domid, unsigned int console_evtchn,
                       unsigned long *console_mfn, uint32_t console_domid,
                       xc_stream_type_t stream_type,
-                      struct restore_callbacks *callbacks, int send_back_fd);
+                      struct restore_callbacks *callbacks, int send_back_fd,
+                      const int *aux_fds, unsigned int nr_aux_fds);
 
 /**
  * This function will create a domain for a paravirtualized Linux
@@ -113,6 +113,28 @@ void *xs_read(struct xs_handle *h, xs_transaction_t t,
 bool xs_write(struct xs_handle *h, xs_transaction_t t,
 	      const char *path, const void *data, unsigned int len);
 
+/* Get the values of num files in one request.
+ * Returns a malloced array of num values, each nul terminated, with the
+ * values stored in the same allocation: call free() on the array only.
+ * A value is NULL if that file couldn't be read. lens[] is filled with the
+ * length of each value, not including terminator.
+ * Falls back to pipelined single reads if the daemon doesn't support
+ * batched reads, or if the values don't fit in a single reply.
+ * Returns NULL on failure.
+ */
+void **xs_read_multiple(struct xs_handle *h, xs_transaction_t t,
+			const char *const *paths, unsigned int num,
+			unsigned int *lens);
+
+/* Write the values of num files in one request.
+ * The writes are done in order, stopping at the first failure; use a
+ * transaction to make them atomic.
+ * Returns false on failure.
+ */
+bool xs_write_multiple(struct xs_handle *h, xs_transaction_t t,
+		       const char *const *paths, const void *const *data,
+		       const unsigned int *lens, unsigned int num);
+
 /* Create a new directory.
  * Returns false on failure, or success if it already exists.
  */
@@ -0,0 +1,100 @@
+/*
+ * libxentrace: consume the Xen trace buffers record by record.
+ *
+ * Records are handed out as pointers into the trace buffers themselves,
+ * which are mapped from Xen: nothing is copied.  Xen doesn't overwrite
+ * data which hasn't been consumed yet (it counts lost records instead), so
+ * a record stays valid until xentrace_release() is called for its CPU.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef XENTRACE_H
+#define XENTRACE_H
+
+#include <stdint.h>
+
+#include <xen/xen.h>
+#include <xen/trace.h>
+
+/* Callers who don't care don't need to #include <xentoollog.h> */
+struct xentoollog_logger;
+
+typedef struct xentrace_handle xentrace_handle;
+
+/* Size in bytes of a trace record, header included. */
+#define XENTRACE_REC_SIZE(rec)                                  \
+    (sizeof(uint32_t) * (1 + (rec)->extra_u32 +                 \
+                         ((rec)->cycles_included ? 2 : 0)))
+
+/*
+ * Enable tracing and map the trace buffers of all CPUs.  @tbuf_pages is the
+ * size in pages of each CPU's buffer if Xen hasn't allocated them yet (0
+ * for the default); it is ignored otherwise, as the buffers can't be
+ * resized once allocated.  The event and CPU masks are left alone.
+ *
+ * @open_flags must be 0.  Tracing is left enabled by xentrace_close().
+ */
+xentrace_handle *xentrace_open(struct xentoollog_logger *logger,
+                               unsigned long tbuf_pages,
+                               unsigned int open_flags);
+int xentrace_close(xentrace_handle *xth);
+
+/* Number of per-CPU buffers, i.e. the valid range of @cpu below. */
+unsigned int xentrace_nr_cpus(xentrace_handle *xth);
+
+/*
+ * File descriptor which becomes readable when Xen signals VIRQ_TBUF, i.e.
+ * when a buffer is filling up.  Use xentrace_wait() to acknowledge it.
+ */
+int xentrace_fd(xentrace_handle *xth);
+
+/*
+ * Wait up to @timeout_ms milliseconds (-1: forever) for VIRQ_TBUF.
+ * Returns 1 if it arrived, 0 on timeout, or -1 with errno set.
+ */
+int xentrace_wait(xentrace_handle *xth, int timeout_ms);
+
+/*
+ * Return the next record in @cpu's buffer, or NULL if there is none (or,
+ * with errno set to EILSEQ, if the buffer is corrupt).  The records used to
+ * pad the end of the buffer are skipped.
+ *
+ * Successive calls walk forward through the buffer without giving the space
+ * back to Xen; xentrace_release() does that, after which the records
+ * returned so far must no longer be used.
+ */
+const struct t_rec *xentrace_next(xentrace_handle *xth, unsigned int cpu);
+void xentrace_release(xentrace_handle *xth, unsigned int cpu);
+
+/*
+ * Hand every pending record of every CPU to @fn, then release them.  @fn
+ * returning non-zero stops the walk; the record it was given is not
+ * released.  Returns the number of records consumed, or -1 with errno set.
+ */
+typedef int xentrace_record_fn(void *arg, unsigned int cpu,
+                               const struct t_rec *rec);
+int xentrace_consume(xentrace_handle *xth, xentrace_record_fn *fn,
+                     void *arg);
+
+#endif /* XENTRACE_H */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -48,6 +48,7 @@ static void cache_unlock(xencall_handle *xcall)
 static void *cache_alloc(xencall_handle *xcall, size_t nr_pages)
 {
     void *p = NULL;
+    int i;
 
     cache_lock(xcall);
 
@@ -56,20 +57,29 @@ static void *cache_alloc(xencall_handle *xcall, size_t nr_pages)
     if ( xcall->buffer_current_allocations > xcall->buffer_maximum_allocations )
         xcall->buffer_maximum_allocations = xcall->buffer_current_allocations;
 
-    if ( nr_pages > 1 )
+    if ( nr_pages > BUFFER_CACHE_MAX_PAGES )
     {
         xcall->buffer_cache_toobig++;
+        goto out;
     }
-    else if ( xcall->buffer_cache_nr > 0 )
+
+    /* Prefer the most recently freed buffers, which are likely cache hot. */
+    for ( i = xcall->buffer_cache_nr - 1; i >= 0; i-- )
     {
-        p = xcall->buffer_cache[--xcall->buffer_cache_nr];
-        xcall->buffer_cache_hits++;
+        if ( xcall->buffer_cache[i].nr_pages != nr_pages )
+            continue;
+
+        p = xcall->buffer_cache[i].p;
+        xcall->buffer_cache[i] = xcall->buffer_cache[--xcall->buffer_cache_nr];
+        break;
     }
+
+    if ( p )
+        xcall->buffer_cache_hits++;
     else
-    {
         xcall->buffer_cache_misses++;
-    }
 
+ out:
     cache_unlock(xcall);
 
     return p;
@@ -84,10 +94,12 @@ static int cache_free(xencall_handle *xcall, void *p, size_t nr_pages)
     xcall->buffer_total_releases++;
     xcall->buffer_current_allocations--;
 
-    if ( nr_pages == 1 &&
+    if ( nr_pages <= BUFFER_CACHE_MAX_PAGES &&
          xcall->buffer_cache_nr < BUFFER_CACHE_SIZE )
     {
-        xcall->buffer_cache[xcall->buffer_cache_nr++] = p;
+        xcall->buffer_cache[xcall->buffer_cache_nr].p = p;
+        xcall->buffer_cache[xcall->buffer_cache_nr].nr_pages = nr_pages;
+        xcall->buffer_cache_nr++;
         rc = 1;
     }
 
@@ -98,8 +110,6 @@ static int cache_free(xencall_handle *xcall, void *p, size_t nr_pages)
 
 void buffer_release_cache(xencall_handle *xcall)
 {
-    void *p;
-
     cache_lock(xcall);
 
     DBGPRINTF("total allocations:%d total releases:%d",
@@ -117,8 +127,10 @@ void buffer_release_cache(xencall_handle *xcall)
 
     while ( xcall->buffer_cache_nr > 0 )
     {
-        p = xcall->buffer_cache[--xcall->buffer_cache_nr];
-        osdep_free_pages(xcall, p, 1);
+        --xcall->buffer_cache_nr;
+        osdep_free_pages(xcall,
+                         xcall->buffer_cache[xcall->buffer_cache_nr].p,
+                         xcall->buffer_cache[xcall->buffer_cache_nr].nr_pages);
     }
 
     cache_unlock(xcall);
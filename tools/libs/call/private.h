@@ -29,13 +29,20 @@ struct xencall_handle {
     Xentoolcore__Active_Handle tc_ah;
 
     /*
-     * A simple cache of unused, single page, hypercall buffers
+     * A simple cache of unused hypercall buffers of up to
+     * BUFFER_CACHE_MAX_PAGES pages, handed out again on an exact size
+     * match.  Repeated mapping, locking and zapping of buffer memory
+     * otherwise dominates the cost of many small hypercalls.
      *
      * Protected by a global lock.
      */
-#define BUFFER_CACHE_SIZE 4
+#define BUFFER_CACHE_SIZE 16
+#define BUFFER_CACHE_MAX_PAGES 8
     int buffer_cache_nr;
-    void *buffer_cache[BUFFER_CACHE_SIZE];
+    struct {
+        void *p;
+        size_t nr_pages;
+    } buffer_cache[BUFFER_CACHE_SIZE];
 
     /*
      * Hypercall buffer statistics. All protected by the global
@@ -67,7 +67,7 @@ xc_sched_arinc653_schedule_get(
     DECLARE_HYPERCALL_BOUNCE(
         schedule,
         sizeof(*schedule),
-        XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+        XC_HYPERCALL_BUFFER_BOUNCE_BOTH);
 
     if ( xc_hypercall_bounce_pre(xch, schedule) )
         return -1;
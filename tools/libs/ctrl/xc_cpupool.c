@@ -179,6 +179,40 @@ int xc_cpupool_movedomain(xc_interface *xch,
     return do_sysctl_save(xch, &sysctl);
 }
 
+int xc_cpupool_movedomains(xc_interface *xch,
+                           uint32_t poolid,
+                           const uint32_t *domids,
+                           unsigned int nr_doms)
+{
+    int err;
+    unsigned int i;
+    DECLARE_SYSCTL;
+    DECLARE_HYPERCALL_BUFFER(uint16_t, local);
+
+    local = xc_hypercall_buffer_alloc(xch, local, nr_doms * sizeof(*local));
+    if ( !local )
+    {
+        PERROR("Could not allocate domid array for cpupool operation");
+        return -1;
+    }
+
+    for ( i = 0; i < nr_doms; i++ )
+        local[i] = domids[i];
+
+    sysctl.cmd = XEN_SYSCTL_cpupool_op;
+    sysctl.u.cpupool_op.op = XEN_SYSCTL_CPUPOOL_OP_MOVEDOMAINS;
+    sysctl.u.cpupool_op.cpupool_id = poolid;
+    sysctl.u.cpupool_op.n_dom = nr_doms;
+    set_xen_guest_handle(sysctl.u.cpupool_op.domids, local);
+
+    /* Already moved domains are skipped when the operation is repeated. */
+    err = do_sysctl_save(xch, &sysctl);
+
+    xc_hypercall_buffer_free(xch, local);
+
+    return err;
+}
+
 xc_cpumap_t xc_cpupool_freeinfo(xc_interface *xch)
 {
     int err = -1;
@@ -198,6 +198,115 @@ int xc_domain_node_getaffinity(xc_interface *xch,
     return ret;
 }
 
+int xc_domain_numa_migrate(xc_interface *xch,
+                           uint32_t domid,
+                           xen_pfn_t first_gfn,
+                           unsigned long nr_gfns,
+                           unsigned int node,
+                           unsigned long *nr_migrated)
+{
+    DECLARE_DOMCTL;
+    int ret;
+
+    domctl.cmd = XEN_DOMCTL_numa_migrate;
+    domctl.domain = domid;
+    domctl.u.numa_migrate.first_gfn = first_gfn;
+    domctl.u.numa_migrate.nr_gfns = nr_gfns;
+    domctl.u.numa_migrate.nr_migrated = 0;
+    domctl.u.numa_migrate.node = node;
+
+    ret = do_domctl(xch, &domctl);
+
+    if ( nr_migrated )
+        *nr_migrated = domctl.u.numa_migrate.nr_migrated;
+
+    return ret;
+}
+
+int xc_domain_set_llc_colors(xc_interface *xch,
+                             uint32_t domid,
+                             const uint32_t *llc_colors,
+                             uint32_t num_llc_colors)
+{
+    DECLARE_DOMCTL;
+    DECLARE_HYPERCALL_BOUNCE_IN(llc_colors,
+                                sizeof(*llc_colors) * num_llc_colors);
+    int ret;
+
+    if ( xc_hypercall_bounce_pre(xch, llc_colors) )
+        return -1;
+
+    memset(&domctl, 0, sizeof(domctl));
+
+    domctl.cmd = XEN_DOMCTL_set_llc_colors;
+    domctl.domain = domid;
+    domctl.u.set_llc_colors.num_llc_colors = num_llc_colors;
+    set_xen_guest_handle(domctl.u.set_llc_colors.llc_colors, llc_colors);
+
+    ret = do_domctl(xch, &domctl);
+
+    xc_hypercall_bounce_post(xch, llc_colors);
+
+    return ret;
+}
+
+int xc_domain_track_accessed(xc_interface *xch,
+                             uint32_t domid,
+                             bool enable)
+{
+    DECLARE_DOMCTL;
+
+    memset(&domctl, 0, sizeof(domctl));
+
+    domctl.cmd = XEN_DOMCTL_accessed_op;
+    domctl.domain = domid;
+    domctl.u.accessed_op.op = enable ? XEN_DOMCTL_ACCESSED_OP_ENABLE
+                                     : XEN_DOMCTL_ACCESSED_OP_DISABLE;
+
+    return do_domctl(xch, &domctl);
+}
+
+int xc_domain_get_accessed(xc_interface *xch,
+                           uint32_t domid,
+                           xen_pfn_t first_gfn,
+                           unsigned long nr_gfns,
+                           bool clear,
+                           uint8_t *bitmap,
+                           unsigned long *nr_accessed)
+{
+    DECLARE_DOMCTL;
+    DECLARE_HYPERCALL_BOUNCE(bitmap, (nr_gfns + 7) / 8,
+                             XC_HYPERCALL_BUFFER_BOUNCE_OUT);
+    int ret;
+
+    if ( bitmap && xc_hypercall_bounce_pre(xch, bitmap) )
+    {
+        PERROR("Could not allocate memory for accessed bitmap");
+        return -1;
+    }
+
+    memset(&domctl, 0, sizeof(domctl));
+
+    domctl.cmd = XEN_DOMCTL_accessed_op;
+    domctl.domain = domid;
+    domctl.u.accessed_op.op = XEN_DOMCTL_ACCESSED_OP_SCAN;
+    domctl.u.accessed_op.flags = clear ? XEN_DOMCTL_ACCESSED_CLEAR : 0;
+    domctl.u.accessed_op.first_gfn = first_gfn;
+    domctl.u.accessed_op.nr_gfns = nr_gfns;
+    if ( bitmap )
+        set_xen_guest_handle(domctl.u.accessed_op.bitmap, bitmap);
+
+    ret = do_domctl(xch, &domctl);
+
+    if ( bitmap )
+        xc_hypercall_bounce_post(xch, bitmap);
+
+    if ( nr_accessed )
+        *nr_accessed = domctl.u.accessed_op.nr_accessed;
+
+    return ret;
+}
+
 int xc_vcpu_setaffinity(xc_interface *xch,
                         uint32_t domid,
                         int vcpu,
@@ -417,6 +526,16 @@ int xc_domain_getinfolist(xc_interface *xch,
                           uint32_t first_domain,
                           unsigned int max_domains,
                           xc_domaininfo_t *info)
+{
+    return xc_domain_getinfolist_generation(xch, first_domain, max_domains,
+                                            info, NULL);
+}
+
+int xc_domain_getinfolist_generation(xc_interface *xch,
+                                     uint32_t first_domain,
+                                     unsigned int max_domains,
+                                     xc_domaininfo_t *info,
+                                     uint32_t *generation)
 {
     int ret = 0;
     DECLARE_SYSCTL;
@@ -433,7 +552,11 @@ int xc_domain_getinfolist(xc_interface *xch,
     if ( xc_sysctl(xch, &sysctl) < 0 )
         ret = -1;
     else
+    {
         ret = sysctl.u.getdomaininfolist.num_domains;
+        if ( generation )
+            *generation = sysctl.u.getdomaininfolist.generation;
+    }
 
     xc_hypercall_bounce_post(xch, info);
 
@@ -686,6 +809,42 @@ int xc_shadow_control(xc_interface *xch,
     return (rc == 0) ? domctl.u.shadow_op.pages : rc;
 }
 
+int xc_shadow_control_ranges(xc_interface *xch,
+                             uint32_t domid,
+                             unsigned int sop,
+                             xc_hypercall_buffer_t *ranges,
+                             unsigned int *nr_ranges,
+                             unsigned long pages,
+                             uint32_t mode,
+                             xc_shadow_op_stats_t *stats)
+{
+    int rc;
+    DECLARE_DOMCTL;
+    DECLARE_HYPERCALL_BUFFER_ARGUMENT(ranges);
+
+    memset(&domctl, 0, sizeof(domctl));
+
+    domctl.cmd = XEN_DOMCTL_shadow_op;
+    domctl.domain = domid;
+    domctl.u.shadow_op.op        = sop;
+    domctl.u.shadow_op.pages     = pages;
+    domctl.u.shadow_op.mode      = mode | XEN_DOMCTL_SHADOW_LOGDIRTY_RANGES;
+    domctl.u.shadow_op.nr_ranges = *nr_ranges;
+    set_xen_guest_handle(domctl.u.shadow_op.dirty_ranges, ranges);
+
+    rc = do_domctl(xch, &domctl);
+    if ( rc )
+        return rc;
+
+    if ( stats )
+        memcpy(stats, &domctl.u.shadow_op.stats,
+               sizeof(xc_shadow_op_stats_t));
+
+    *nr_ranges = domctl.u.shadow_op.nr_ranges;
+
+    return domctl.u.shadow_op.pages;
+}
+
 int xc_domain_setmaxmem(xc_interface *xch,
                         uint32_t domid,
                         uint64_t max_memkb)
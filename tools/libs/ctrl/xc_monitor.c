@@ -25,7 +25,14 @@
 void *xc_monitor_enable(xc_interface *xch, uint32_t domain_id, uint32_t *port)
 {
     return xc_vm_event_enable(xch, domain_id, HVM_PARAM_MONITOR_RING_PFN,
-                              port);
+                              1, port);
+}
+
+void *xc_monitor_enable_frames(xc_interface *xch, uint32_t domain_id,
+                               unsigned int nr_frames, uint32_t *port)
+{
+    return xc_vm_event_enable(xch, domain_id, HVM_PARAM_MONITOR_RING_PFN,
+                              nr_frames, port);
 }
 
 int xc_monitor_disable(xc_interface *xch, uint32_t domain_id)
@@ -177,6 +184,24 @@ int xc_monitor_inguest_pagefault(xc_interface *xch, uint32_t domain_id,
     return do_domctl(xch, &domctl);
 }
 
+int xc_monitor_mem_access_filter(xc_interface *xch, uint32_t domain_id,
+                                 bool enable, uint64_t gpa, uint32_t size)
+{
+    DECLARE_DOMCTL;
+
+    memset(&domctl.u.monitor_op, 0, sizeof(domctl.u.monitor_op));
+
+    domctl.cmd = XEN_DOMCTL_monitor_op;
+    domctl.domain = domain_id;
+    domctl.u.monitor_op.op = enable ? XEN_DOMCTL_MONITOR_OP_ENABLE
+                                    : XEN_DOMCTL_MONITOR_OP_DISABLE;
+    domctl.u.monitor_op.event = XEN_DOMCTL_MONITOR_EVENT_MEM_ACCESS_FILTER;
+    domctl.u.monitor_op.u.mem_access_filter.gpa = gpa;
+    domctl.u.monitor_op.u.mem_access_filter.size = size;
+
+    return do_domctl(xch, &domctl);
+}
+
 int xc_monitor_emulate_each_rep(xc_interface *xch, uint32_t domain_id,
                                 bool enable)
 {
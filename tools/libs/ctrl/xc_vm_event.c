@@ -22,8 +22,9 @@
 
 #include "xc_private.h"
 
-int xc_vm_event_control(xc_interface *xch, uint32_t domain_id, unsigned int op,
-                        unsigned int mode, uint32_t *port)
+static int vm_event_control(xc_interface *xch, uint32_t domain_id,
+                            unsigned int op, unsigned int mode,
+                            unsigned int nr_frames, uint32_t *port)
 {
     DECLARE_DOMCTL;
     int rc;
@@ -32,6 +33,7 @@ int xc_vm_event_control(xc_interface *xch, uint32_t domain_id, unsigned int op,
     domctl.domain = domain_id;
     domctl.u.vm_event_op.op = op;
     domctl.u.vm_event_op.mode = mode;
+    domctl.u.vm_event_op.u.enable.nr_frames = nr_frames;
 
     rc = do_domctl(xch, &domctl);
     if ( !rc && port )
@@ -39,16 +41,23 @@ int xc_vm_event_control(xc_interface *xch, uint32_t domain_id, unsigned int op,
     return rc;
 }
 
+int xc_vm_event_control(xc_interface *xch, uint32_t domain_id, unsigned int op,
+                        unsigned int mode, uint32_t *port)
+{
+    return vm_event_control(xch, domain_id, op, mode, 1, port);
+}
+
 void *xc_vm_event_enable(xc_interface *xch, uint32_t domain_id, int param,
-                         uint32_t *port)
+                         unsigned int nr_frames, uint32_t *port)
 {
     void *ring_page = NULL;
     uint64_t pfn;
-    xen_pfn_t ring_pfn, mmap_pfn;
-    unsigned int op, mode;
+    xen_pfn_t ring_pfns[XEN_VM_EVENT_RING_FRAMES_MAX];
+    xen_pfn_t mmap_pfns[XEN_VM_EVENT_RING_FRAMES_MAX];
+    unsigned int i, op, mode;
     int rc1, rc2, saved_errno;
 
-    if ( !port )
+    if ( !port || !nr_frames || nr_frames > XEN_VM_EVENT_RING_FRAMES_MAX )
     {
         errno = EINVAL;
         return NULL;
@@ -70,14 +79,18 @@ void *xc_vm_event_enable(xc_interface *xch, uint32_t domain_id, int param,
         goto out;
     }
 
-    ring_pfn = pfn;
-    mmap_pfn = pfn;
-    rc1 = xc_get_pfn_type_batch(xch, domain_id, 1, &mmap_pfn);
-    if ( rc1 || mmap_pfn & XEN_DOMCTL_PFINFO_XTAB )
+    for ( i = 0; i < nr_frames; i++ )
+        ring_pfns[i] = mmap_pfns[i] = pfn + i;
+
+    rc1 = xc_get_pfn_type_batch(xch, domain_id, nr_frames, mmap_pfns);
+    for ( i = 0; i < nr_frames; i++ )
     {
+        if ( !rc1 && !(mmap_pfns[i] & XEN_DOMCTL_PFINFO_XTAB) )
+            continue;
+
         /* Page not in the physmap, try to populate it */
         rc1 = xc_domain_populate_physmap_exact(xch, domain_id, 1, 0, 0,
-                                              &ring_pfn);
+                                              &ring_pfns[i]);
         if ( rc1 != 0 )
         {
             PERROR("Failed to populate ring pfn\n");
@@ -85,9 +98,9 @@ void *xc_vm_event_enable(xc_interface *xch, uint32_t domain_id, int param,
         }
     }
 
-    mmap_pfn = ring_pfn;
+    memcpy(mmap_pfns, ring_pfns, nr_frames * sizeof(*mmap_pfns));
     ring_page = xc_map_foreign_pages(xch, domain_id, PROT_READ | PROT_WRITE,
-                                         &mmap_pfn, 1);
+                                     mmap_pfns, nr_frames);
     if ( !ring_page )
     {
         PERROR("Could not map the ring page\n");
@@ -121,15 +134,16 @@ void *xc_vm_event_enable(xc_interface *xch, uint32_t domain_id, int param,
         goto out;
     }
 
-    rc1 = xc_vm_event_control(xch, domain_id, op, mode, port);
+    rc1 = vm_event_control(xch, domain_id, op, mode, nr_frames, port);
     if ( rc1 != 0 )
     {
         PERROR("Failed to enable vm_event\n");
         goto out;
     }
 
-    /* Remove the ring_pfn from the guest's physmap */
-    rc1 = xc_domain_decrease_reservation_exact(xch, domain_id, 1, 0, &ring_pfn);
+    /* Remove the ring_pfns from the guest's physmap */
+    rc1 = xc_domain_decrease_reservation_exact(xch, domain_id, nr_frames, 0,
+                                               ring_pfns);
     if ( rc1 != 0 )
         PERROR("Failed to remove ring page from guest physmap");
 
@@ -147,7 +161,7 @@ void *xc_vm_event_enable(xc_interface *xch, uint32_t domain_id, int param,
         }
 
         if ( ring_page )
-            xenforeignmemory_unmap(xch->fmem, ring_page, 1);
+            xenforeignmemory_unmap(xch->fmem, ring_page, nr_frames);
         ring_page = NULL;
 
         errno = saved_errno;
@@ -391,6 +391,25 @@ int xendevicemodel_set_ioreq_server_state(
     return xendevicemodel_op(dmod, domid, 1, &op, sizeof(op));
 }
 
+int xendevicemodel_set_ioreq_server_polling(
+    xendevicemodel_handle *dmod, domid_t domid, ioservid_t id,
+    uint32_t flags, uint32_t spin_ns)
+{
+    struct xen_dm_op op;
+    struct xen_dm_op_set_ioreq_server_polling *data;
+
+    memset(&op, 0, sizeof(op));
+
+    op.op = XEN_DMOP_set_ioreq_server_polling;
+    data = &op.u.set_ioreq_server_polling;
+
+    data->id = id;
+    data->flags = flags;
+    data->spin_ns = spin_ns;
+
+    return xendevicemodel_op(dmod, domid, 1, &op, sizeof(op));
+}
+
 int xendevicemodel_set_pci_intx_level(
     xendevicemodel_handle *dmod, domid_t domid, uint16_t segment,
     uint8_t bus, uint8_t device, uint8_t intx, unsigned int level)
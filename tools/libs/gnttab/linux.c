@@ -396,6 +396,7 @@ int osdep_gnttab_dmabuf_imp_to_refs(xengnttab_handle *xgt, uint32_t domid,
     to_refs->fd = fd;
     to_refs->count = count;
     to_refs->domid = domid;
+    to_refs->reserved = 0;
 
     if ( (rc = ioctl(xgt->fd, IOCTL_GNTDEV_DMABUF_IMP_TO_REFS, to_refs)) )
     {
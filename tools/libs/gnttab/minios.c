@@ -117,12 +117,14 @@ int osdep_gnttab_dmabuf_exp_from_refs(xengnttab_handle *xgt, uint32_t domid,
                                       uint32_t flags, uint32_t count,
                                       const uint32_t *refs, uint32_t *fd)
 {
+    errno = EOPNOTSUPP;
     return -1;
 }
 
 int osdep_gnttab_dmabuf_exp_wait_released(xengnttab_handle *xgt,
                                           uint32_t fd, uint32_t wait_to_ms)
 {
+    errno = EOPNOTSUPP;
     return -1;
 }
 
@@ -130,11 +132,13 @@ int osdep_gnttab_dmabuf_imp_to_refs(xengnttab_handle *xgt, uint32_t domid,
                                     uint32_t fd, uint32_t count,
                                     uint32_t *refs)
 {
+    errno = EOPNOTSUPP;
     return -1;
 }
 
 int osdep_gnttab_dmabuf_imp_release(xengnttab_handle *xgt, uint32_t fd)
 {
+    errno = EOPNOTSUPP;
     return -1;
 }
 
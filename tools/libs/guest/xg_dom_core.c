@@ -30,6 +30,7 @@
 #include <inttypes.h>
 #include <zlib.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "xg_private.h"
 #include "_paths.h"
@@ -976,7 +977,92 @@ int xc_dom_mem_init(struct xc_dom_image *dom, unsigned int mem_mb)
     return 0;
 }
 
-static int xc_dom_build_module(struct xc_dom_image *dom, unsigned int mod)
+/*
+ * Decompression of a module into its guest segment is handed to a thread,
+ * so that several modules, and the remainder of the image construction,
+ * proceed while it runs.  The thread must not touch dom or xch: errors are
+ * reported when the thread is collected.
+ */
+struct xc_dom_module_load {
+    pthread_t thread;
+    bool started;
+    void *blob;
+    size_t size;
+    void *dst;
+    size_t unziplen;
+    size_t modulelen;
+    int zrc;
+    int rc;
+};
+
+static void *xc_dom_module_load_thread(void *arg)
+{
+    struct xc_dom_module_load *load = arg;
+    z_stream zStream;
+
+    memset(&zStream, 0, sizeof(zStream));
+    zStream.next_in = load->blob;
+    zStream.avail_in = load->size;
+    zStream.next_out = load->dst;
+    zStream.avail_out = load->unziplen;
+    load->zrc = inflateInit2(&zStream, (MAX_WBITS + 32));
+    if ( load->zrc == Z_OK )
+    {
+        load->zrc = inflate(&zStream, Z_FINISH);
+        inflateEnd(&zStream);
+        if ( load->zrc == Z_STREAM_END )
+            return NULL;
+    }
+
+    /* Fall back to handing over the raw blob, as xc_dom_build_module(). */
+    if ( load->size > load->modulelen )
+    {
+        load->rc = -1;
+        return NULL;
+    }
+    memcpy(load->dst, load->blob, load->size);
+    if ( load->unziplen > load->size )
+        memset(load->dst + load->size, 0, load->unziplen - load->size);
+
+    return NULL;
+}
+
+static int xc_dom_wait_modules(struct xc_dom_image *dom,
+                               struct xc_dom_module_load *loads)
+{
+    unsigned int mod;
+    int rc = 0;
+
+    for ( mod = 0; mod < dom->num_modules; mod++ )
+    {
+        struct xc_dom_module_load *load = &loads[mod];
+
+        if ( !load->started )
+            continue;
+
+        pthread_join(load->thread, NULL);
+        load->started = false;
+
+        if ( load->zrc == Z_STREAM_END )
+            DOMPRINTF("%s: module%u unzip ok, 0x%zx -> 0x%zx", __FUNCTION__,
+                      mod, load->size, load->unziplen);
+        else if ( load->rc )
+        {
+            xc_dom_panic(dom->xch, XC_INTERNAL_ERROR,
+                         "%s: module%u inflate failed (rc=%d)",
+                         __FUNCTION__, mod, load->zrc);
+            rc = -1;
+        }
+        else
+            DOMPRINTF("%s: module%u inflate failed (rc=%d), loaded raw",
+                      __FUNCTION__, mod, load->zrc);
+    }
+
+    return rc;
+}
+
+static int xc_dom_build_module(struct xc_dom_image *dom, unsigned int mod,
+                               struct xc_dom_module_load *load)
 {
     size_t unziplen, modulelen;
     void *modulemap;
@@ -1018,6 +1104,19 @@ static int xc_dom_build_module(struct xc_dom_image *dom, unsigned int mod)
     }
     if ( unziplen )
     {
+        load->blob = dom->modules[mod].blob;
+        load->size = dom->modules[mod].size;
+        load->dst = modulemap;
+        load->unziplen = unziplen;
+        load->modulelen = modulelen;
+        load->rc = 0;
+        if ( !pthread_create(&load->thread, NULL,
+                             xc_dom_module_load_thread, load) )
+        {
+            load->started = true;
+            return 0;
+        }
+
         if ( xc_dom_do_gunzip(dom->xch, dom->modules[mod].blob, dom->modules[mod].size,
                               modulemap, unziplen) != -1 )
             return 0;
@@ -1138,6 +1237,7 @@ int xc_dom_build_image(struct xc_dom_image *dom)
     unsigned int page_size;
     bool unmapped_initrd;
     unsigned int mod;
+    struct xc_dom_module_load loads[XG_MAX_MODULES] = {};
 
     DOMPRINTF_CALLED(dom->xch);
 
@@ -1169,7 +1269,7 @@ int xc_dom_build_image(struct xc_dom_image *dom)
 
         if ( dom->modules[mod].blob && !unmapped_initrd )
         {
-            if ( xc_dom_build_module(dom, mod) != 0 )
+            if ( xc_dom_build_module(dom, mod, &loads[mod]) != 0 )
                 goto err;
 
             if ( mod == 0 )
@@ -1231,7 +1331,7 @@ int xc_dom_build_image(struct xc_dom_image *dom)
 
     /* Make sure all memory mapped by initial page tables is available */
     if ( dom->virt_pgtab_end && xc_dom_alloc_pad(dom, dom->virt_pgtab_end) )
-        return -1;
+        goto err;
 
     for ( mod = 0; mod < dom->num_modules; mod++ )
     {
@@ -1241,7 +1341,7 @@ int xc_dom_build_image(struct xc_dom_image *dom)
         /* Load ramdisk / other modules if no initial mapping required. */
         if ( dom->modules[mod].blob && unmapped_initrd )
         {
-            if ( xc_dom_build_module(dom, mod) != 0 )
+            if ( xc_dom_build_module(dom, mod, &loads[mod]) != 0 )
                 goto err;
 
             if ( mod == 0 )
@@ -1261,9 +1361,10 @@ int xc_dom_build_image(struct xc_dom_image *dom)
         dom->p2m_seg.vstart = dom->parms->p2m_base;
     }
 
-    return 0;
+    return xc_dom_wait_modules(dom, loads);
 
  err:
+    xc_dom_wait_modules(dom, loads);
     return -1;
 }
 
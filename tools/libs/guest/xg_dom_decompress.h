@@ -3,4 +3,5 @@
 #endif
 
 int xc_try_lz4_decode(struct xc_dom_image *dom, void **blob, size_t *size);
+int xc_try_zstd_decode(struct xc_dom_image *dom, void **blob, size_t *size);
 
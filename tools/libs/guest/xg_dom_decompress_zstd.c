@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdint.h>
+
+#include "xg_private.h"
+#include "xg_dom_decompress.h"
+
+#include "../../xen/common/decompress.h"
+
+#ifndef __MINIOS__
+
+#include "../../xen/common/zstd/decompress.c"
+
+int xc_try_zstd_decode(
+    struct xc_dom_image *dom, void **blob, size_t *psize)
+{
+    unsigned char *inp = *blob, *output;
+    size_t out_len, in_used, dest_len;
+    const char *msg;
+
+    /* Compressed kernels carry their decompressed size at the end. */
+    if ( *psize < 8 )
+    {
+        msg = "input too small";
+        goto err;
+    }
+    out_len = zstd_le32(inp + *psize - 4);
+    if ( xc_dom_kernel_check_size(dom, out_len) )
+    {
+        msg = "Decompressed image too large";
+        goto err;
+    }
+
+    output = malloc(out_len);
+    if ( !output )
+    {
+        msg = "Could not allocate output buffer";
+        goto err;
+    }
+
+    if ( zstd_decompress(inp, *psize, output, out_len, &in_used,
+                         &dest_len, &msg) )
+        goto err_free;
+
+    if ( xc_dom_register_external(dom, output, dest_len) )
+    {
+        msg = "Error registering stream output";
+        goto err_free;
+    }
+
+    *blob = output;
+    *psize = dest_len;
+    return 0;
+
+ err_free:
+    free(output);
+ err:
+    DOMPRINTF("ZSTD decompression error: %s\n", msg);
+    return -1;
+}
+
+#else /* __MINIOS__ */
+
+#include "../../xen/common/unzstd.c"
+
+int xc_try_zstd_decode(
+    struct xc_dom_image *dom, void **blob, size_t *size)
+{
+    return xc_dom_decompress_unsafe(unzstd, dom, blob, size);
+}
+
+#endif
@@ -1569,10 +1569,13 @@ static int meminit_hvm(struct xc_dom_image *dom)
 
             if ( count != 0 )
             {
-                /* Clip count to maximum 8MB extent. */
-                max_pages = SUPERPAGE_2MB_NR_PFNS * 4;
-                if ( count > max_pages )
-                    count = max_pages;
+                /*
+                 * count is already clipped to (at most) 1GB above, so the
+                 * whole range can be handed to the hypervisor in one go:
+                 * populate_physmap is preemptible, and the number of
+                 * hypercalls (with their bouncing of the extent list) would
+                 * otherwise dominate for large guests.
+                 */
 
                 /* Clip partial superpage extents to superpage
                  * boundaries. */
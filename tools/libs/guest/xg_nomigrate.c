@@ -22,7 +22,8 @@
 
 int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom, uint32_t flags,
                    struct save_callbacks *callbacks,
-                   xc_stream_type_t stream_type, int recv_fd)
+                   xc_stream_type_t stream_type, int recv_fd,
+                   const int *aux_fds, unsigned int nr_aux_fds)
 {
     errno = ENOSYS;
     return -1;
@@ -33,7 +34,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
                       uint32_t store_domid, unsigned int console_evtchn,
                       unsigned long *console_mfn, uint32_t console_domid,
                       xc_stream_type_t stream_type,
-                      struct restore_callbacks *callbacks, int send_back_fd)
+                      struct restore_callbacks *callbacks, int send_back_fd,
+                      const int *aux_fds, unsigned int nr_aux_fds)
 {
     errno = ENOSYS;
     return -1;
@@ -16,6 +16,10 @@ const char *dhdr_type_to_str(uint32_t type);
 const char *rec_type_to_str(uint32_t type);
 
 struct xc_sr_context;
+struct xc_sr_save_pipeline;
+struct xc_sr_save_aux_stream;
+struct xc_sr_restore_postcopy;
+struct z_stream_s;
 struct xc_sr_record;
 
 /**
@@ -237,6 +241,49 @@ struct xc_sr_context
             /* Further debugging information in the stream. */
             bool debug;
 
+            /* Overlap mapping of page batches with writing them out. */
+            bool pipelined;
+            struct xc_sr_save_pipeline *pipeline;
+
+            /*
+             * Saving to a regular file: drop the page data from the page
+             * cache every SAVE_DISCARD_BYTES written.
+             */
+            bool discard_cache;
+            size_t discard_pending;
+
+            /* Elide zero/duplicate pages and compress the rest. */
+            bool compress;
+            struct z_stream_s *zstream;
+
+            /*
+             * Post-copy: the final dirty pages are sent after the vcpu state,
+             * prioritising those the destination has faulted on.
+             */
+            bool postcopy;
+            unsigned long *postcopy_pfns;
+            unsigned long nr_postcopy_pfns;
+
+            /*
+             * Auxiliary streams.  The page data of the live iterations is
+             * spread across these, by pfn, between the STREAM_FORK and
+             * STREAM_JOIN records.
+             */
+            const int *aux_fds;
+            unsigned int nr_aux_fds;
+            struct xc_sr_save_aux_stream *aux_streams;
+            bool streams_forked;
+
+            /*
+             * Auto-converge: while the guest dirties memory faster than it
+             * can be sent, cap its vcpus ever harder via the scheduler.
+             * The cap in place beforehand is restored once precopy ends.
+             */
+            bool auto_converge;
+            unsigned int throttle_pct, throttle_hot_iters;
+            uint32_t sched_id;
+            uint16_t sched_cap;
+
             unsigned long p2m_size;
 
             struct precopy_stats stats;
@@ -246,6 +293,15 @@ struct xc_sr_context
             unsigned long *deferred_pages;
             unsigned long nr_deferred_pages;
             xc_hypercall_buffer_t dirty_bitmap_hbuf;
+
+            /*
+             * Dirty pages of a live iteration as a list of ranges, used in
+             * place of the dirty bitmap when dirty_ranges_valid.
+             */
+            xc_hypercall_buffer_t dirty_ranges_hbuf;
+            xc_shadow_op_range_t *dirty_ranges;
+            unsigned int nr_dirty_ranges, max_dirty_ranges;
+            bool dirty_ranges_valid, no_dirty_ranges;
         } save;
 
         struct /* Restore data. */
@@ -257,6 +313,11 @@ struct xc_sr_context
             unsigned long p2m_size;
             xc_hypercall_buffer_t dirty_bitmap_hbuf;
 
+            /* Auxiliary streams, read between STREAM_FORK and STREAM_JOIN. */
+            const int *aux_fds;
+            unsigned int nr_aux_fds;
+            bool streams_forked;
+
             /* From Image Header. */
             uint32_t format_version;
 
@@ -297,6 +358,9 @@ struct xc_sr_context
 
             /* Sender has invoked verify mode on the stream. */
             bool verify;
+
+            /* Pages being demand-fetched from the sender, if post-copy. */
+            struct xc_sr_restore_postcopy *postcopy;
         } restore;
     };
 
@@ -376,6 +440,9 @@ struct xc_sr_context
                         /* Whether qemu enabled logdirty mode, and we should
                          * disable on cleanup. */
                         bool qemu_enabled_logdirty;
+
+                        /* HVM context buffer, reused across checkpoints. */
+                        struct xc_sr_blob context;
                     } save;
 
                     struct
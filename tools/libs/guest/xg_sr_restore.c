@@ -1,6 +1,11 @@
 #include <arpa/inet.h>
 
 #include <assert.h>
+#include <poll.h>
+#include <zlib.h>
+
+#include <xenevtchn.h>
+#include <xen/vm_event.h>
 
 #include "xg_sr_common.h"
 
@@ -197,6 +202,129 @@ int populate_pfns(struct xc_sr_context *ctx, unsigned int count,
     return rc;
 }
 
+/*
+ * Post-copy state.  Pages still to arrive from the sender are paged out in
+ * the guest, and the paging ring reports when the guest touches one.
+ */
+struct xc_sr_restore_postcopy
+{
+    /* Pages announced by POSTCOPY_PFNS which have yet to arrive. */
+    unsigned long *outstanding;
+    unsigned long nr_outstanding;
+
+    /* Pages for which a POSTCOPY_FAULT has been sent. */
+    unsigned long *requested;
+    bool backchannel_closed;
+
+    /* Paging requests blocked on a page which has yet to arrive. */
+    vm_event_request_t *waiting;
+    unsigned int nr_waiting, max_waiting;
+
+    /* Paging ring. */
+    bool paging_enabled;
+    xenevtchn_handle *xce;
+    evtchn_port_t port;
+    void *ring_page;
+    vm_event_back_ring_t back_ring;
+};
+
+static void postcopy_put_response(struct xc_sr_context *ctx,
+                                  const vm_event_request_t *req)
+{
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+    vm_event_response_t rsp = {
+        .version = VM_EVENT_INTERFACE_VERSION,
+        .vcpu_id = req->vcpu_id,
+        .flags = req->flags,
+        .reason = req->reason,
+        .u.mem_paging.gfn = req->u.mem_paging.gfn,
+    };
+
+    memcpy(RING_GET_RESPONSE(&pc->back_ring, pc->back_ring.rsp_prod_pvt),
+           &rsp, sizeof(rsp));
+    pc->back_ring.rsp_prod_pvt++;
+}
+
+/*
+ * Load pages which have arrived during the post-copy phase, and let any
+ * vcpus waiting on them continue.
+ */
+static int postcopy_load_pages(struct xc_sr_context *ctx, unsigned int count,
+                               const xen_pfn_t *pfns, const uint32_t *types,
+                               void *page_data)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+    unsigned int i, j;
+    bool notify = false;
+    int rc;
+
+    for ( i = 0; i < count; ++i )
+    {
+        switch ( types[i] )
+        {
+        case XEN_DOMCTL_PFINFO_XTAB:
+        case XEN_DOMCTL_PFINFO_BROKEN:
+        case XEN_DOMCTL_PFINFO_XALLOC:
+            /* No page data to deal with. */
+            continue;
+        }
+
+        /* Dropped by the guest in the meantime. */
+        if ( pfns[i] >= ctx->restore.p2m_size ||
+             !test_and_clear_bit(pfns[i], pc->outstanding) )
+        {
+            page_data += PAGE_SIZE;
+            continue;
+        }
+
+        pc->nr_outstanding--;
+
+        rc = ctx->restore.ops.localise_page(ctx, types[i], page_data);
+        if ( rc )
+        {
+            ERROR("Failed to localise pfn %#"PRIpfn" (type %#"PRIx32")",
+                  pfns[i], types[i] >> XEN_DOMCTL_PFINFO_LTAB_SHIFT);
+            return rc;
+        }
+
+        if ( xc_mem_paging_load(xch, ctx->domid,
+                                ctx->restore.ops.pfn_to_gfn(ctx, pfns[i]),
+                                page_data) )
+        {
+            PERROR("Failed to load pfn %#"PRIpfn, pfns[i]);
+            return -1;
+        }
+
+        for ( j = 0; j < pc->nr_waiting; )
+        {
+            if ( pc->waiting[j].u.mem_paging.gfn != pfns[i] )
+            {
+                ++j;
+                continue;
+            }
+
+            postcopy_put_response(ctx, &pc->waiting[j]);
+            pc->waiting[j] = pc->waiting[--pc->nr_waiting];
+            notify = true;
+        }
+
+        page_data += PAGE_SIZE;
+    }
+
+    if ( notify )
+    {
+        RING_PUSH_RESPONSES(&pc->back_ring);
+        if ( xenevtchn_notify(pc->xce, pc->port) )
+        {
+            PERROR("Failed to notify the paging event channel");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * Given a list of pfns, their types, and a block of page data from the
  * stream, populate and record their types, map the relevant subset and copy
@@ -222,6 +350,13 @@ static int process_page_data(struct xc_sr_context *ctx, unsigned int count,
         goto err;
     }
 
+    /* The guest is running; pages are paged in rather than copied. */
+    if ( ctx->restore.postcopy && ctx->restore.postcopy->paging_enabled )
+    {
+        rc = postcopy_load_pages(ctx, count, pfns, types, page_data);
+        goto err;
+    }
+
     rc = populate_pfns(ctx, count, pfns, types);
     if ( rc )
     {
@@ -328,6 +463,51 @@ static int process_page_data(struct xc_sr_context *ctx, unsigned int count,
     return rc;
 }
 
+/*
+ * Decode and validate the pfn array of a PAGE_DATA or COMPRESSED_PAGE_DATA
+ * record, counting the pages which carry data.
+ */
+static int decode_pfns(struct xc_sr_context *ctx, unsigned int count,
+                       const uint64_t *rec_pfns, xen_pfn_t *pfns,
+                       uint32_t *types, unsigned int *pages_of_data)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned int i;
+    xen_pfn_t pfn;
+    uint32_t type;
+
+    *pages_of_data = 0;
+
+    for ( i = 0; i < count; ++i )
+    {
+        pfn = rec_pfns[i] & PAGE_DATA_PFN_MASK;
+        if ( !ctx->restore.ops.pfn_is_valid(ctx, pfn) )
+        {
+            ERROR("pfn %#"PRIpfn" (index %u) outside domain maximum", pfn, i);
+            return -1;
+        }
+
+        type = (rec_pfns[i] & PAGE_DATA_TYPE_MASK) >> 32;
+        if ( ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) >= 5) &&
+             ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) <= 8) )
+        {
+            ERROR("Invalid type %#"PRIx32" for pfn %#"PRIpfn" (index %u)",
+                  type, pfn, i);
+            return -1;
+        }
+
+        if ( type < XEN_DOMCTL_PFINFO_BROKEN )
+            /* NOTAB and all L1 through L4 tables (including pinned) should
+             * have a page worth of data in the record. */
+            (*pages_of_data)++;
+
+        pfns[i] = pfn;
+        types[i] = type;
+    }
+
+    return 0;
+}
+
 /*
  * Validate a PAGE_DATA record from the stream, and pass the results to
  * process_page_data() to actually perform the legwork.
@@ -336,11 +516,11 @@ static int handle_page_data(struct xc_sr_context *ctx, struct xc_sr_record *rec)
 {
     xc_interface *xch = ctx->xch;
     struct xc_sr_rec_page_data_header *pages = rec->data;
-    unsigned int i, pages_of_data = 0;
+    unsigned int pages_of_data = 0;
     int rc = -1;
 
-    xen_pfn_t *pfns = NULL, pfn;
-    uint32_t *types = NULL, type;
+    xen_pfn_t *pfns = NULL;
+    uint32_t *types = NULL;
 
     /*
      * v2 compatibility only exists for x86 streams.  This is a bit of a
@@ -396,46 +576,204 @@ static int handle_page_data(struct xc_sr_context *ctx, struct xc_sr_record *rec)
         goto err;
     }
 
+    if ( decode_pfns(ctx, pages->count, pages->pfn, pfns, types,
+                     &pages_of_data) )
+        goto err;
+
+    if ( rec->length != (sizeof(*pages) +
+                         (sizeof(uint64_t) * pages->count) +
+                         (PAGE_SIZE * pages_of_data)) )
+    {
+        ERROR("PAGE_DATA record wrong size: length %u, expected "
+              "%zu + %zu + %lu", rec->length, sizeof(*pages),
+              (sizeof(uint64_t) * pages->count), (PAGE_SIZE * pages_of_data));
+        goto err;
+    }
+
+    rc = process_page_data(ctx, pages->count, pfns, types,
+                           &pages->pfn[pages->count]);
+ err:
+    free(types);
+    free(pfns);
+
+    return rc;
+}
+
+/*
+ * Validate a COMPRESSED_PAGE_DATA record from the stream, expand zero,
+ * duplicate and deflated pages into a plain block of page data, and pass the
+ * results to process_page_data().
+ */
+static int handle_compressed_page_data(struct xc_sr_context *ctx,
+                                       struct xc_sr_record *rec)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_rec_compressed_page_data_header *pages = rec->data;
+    unsigned int i, j, l, ref, pages_of_data = 0, nr_literals = 0;
+    int rc = -1;
+    const uint32_t *encodings;
+    const void *data;
+    void *literals = NULL, *page_data = NULL;
+    unsigned long literal_size;
+    xen_pfn_t *pfns = NULL;
+    uint32_t *types = NULL;
+    unsigned int *slots = NULL;
+
+    if ( !ctx->restore.seen_static_data_end )
+    {
+        ERROR("No STATIC_DATA_END seen");
+        goto err;
+    }
+
+    if ( rec->length < sizeof(*pages) )
+    {
+        ERROR("COMPRESSED_PAGE_DATA record truncated: length %u, min %zu",
+              rec->length, sizeof(*pages));
+        goto err;
+    }
+
+    if ( pages->count < 1 )
+    {
+        ERROR("Expected at least 1 pfn in COMPRESSED_PAGE_DATA record");
+        goto err;
+    }
+
+    if ( rec->length != (sizeof(*pages) +
+                         (pages->count * sizeof(uint64_t)) +
+                         (pages->count * sizeof(uint32_t)) +
+                         pages->data_length) )
+    {
+        ERROR("COMPRESSED_PAGE_DATA record wrong size: length %u, expected "
+              "%zu + %zu + %zu + %u", rec->length, sizeof(*pages),
+              (sizeof(uint64_t) * pages->count),
+              (sizeof(uint32_t) * pages->count), pages->data_length);
+        goto err;
+    }
+
+    pfns = malloc(pages->count * sizeof(*pfns));
+    types = malloc(pages->count * sizeof(*types));
+    slots = malloc(pages->count * sizeof(*slots));
+    if ( !pfns || !types || !slots )
+    {
+        ERROR("Unable to allocate enough memory for %u pfns",
+              pages->count);
+        goto err;
+    }
+
+    if ( decode_pfns(ctx, pages->count, pages->pfn, pfns, types,
+                     &pages_of_data) )
+        goto err;
+
+    encodings = (const void *)&pages->pfn[pages->count];
+    data = &encodings[pages->count];
+
     for ( i = 0; i < pages->count; ++i )
     {
-        pfn = pages->pfn[i] & PAGE_DATA_PFN_MASK;
-        if ( !ctx->restore.ops.pfn_is_valid(ctx, pfn) )
+        if ( types[i] >= XEN_DOMCTL_PFINFO_BROKEN )
+            continue;
+
+        switch ( encodings[i] & COMPRESSED_PAGE_ENC_MASK )
         {
-            ERROR("pfn %#"PRIpfn" (index %u) outside domain maximum", pfn, i);
+        case COMPRESSED_PAGE_LITERAL:
+            nr_literals++;
+            break;
+
+        case COMPRESSED_PAGE_ZERO:
+        case COMPRESSED_PAGE_DUPLICATE:
+            break;
+
+        default:
+            ERROR("Invalid encoding %#"PRIx32" for pfn %#"PRIpfn" (index %u)",
+                  encodings[i], pfns[i], i);
             goto err;
         }
+    }
 
-        type = (pages->pfn[i] & PAGE_DATA_TYPE_MASK) >> 32;
-        if ( ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) >= 5) &&
-             ((type >> XEN_DOMCTL_PFINFO_LTAB_SHIFT) <= 8) )
+    literal_size = (unsigned long)nr_literals * PAGE_SIZE;
+
+    switch ( pages->compression )
+    {
+    case COMPRESSED_PAGE_DATA_NONE:
+        if ( pages->data_length != literal_size )
         {
-            ERROR("Invalid type %#"PRIx32" for pfn %#"PRIpfn" (index %u)",
-                  type, pfn, i);
+            ERROR("COMPRESSED_PAGE_DATA has %u octets of data for %u pages",
+                  pages->data_length, nr_literals);
             goto err;
         }
+        break;
 
-        if ( type < XEN_DOMCTL_PFINFO_BROKEN )
-            /* NOTAB and all L1 through L4 tables (including pinned) should
-             * have a page worth of data in the record. */
-            pages_of_data++;
+    case COMPRESSED_PAGE_DATA_ZLIB:
+        literals = malloc(literal_size ?: 1);
+        if ( !literals )
+        {
+            ERROR("Unable to allocate %lu bytes for decompressed pages",
+                  literal_size);
+            goto err;
+        }
 
-        pfns[i] = pfn;
-        types[i] = type;
+        rc = uncompress(literals, &literal_size, data, pages->data_length);
+        if ( rc != Z_OK ||
+             literal_size != (unsigned long)nr_literals * PAGE_SIZE )
+        {
+            ERROR("Failed to decompress %u pages: %d, got %lu octets",
+                  nr_literals, rc, literal_size);
+            rc = -1;
+            goto err;
+        }
+        rc = -1;
+        data = literals;
+        break;
+
+    default:
+        ERROR("Unknown COMPRESSED_PAGE_DATA compression %#x",
+              pages->compression);
+        goto err;
     }
 
-    if ( rec->length != (sizeof(*pages) +
-                         (sizeof(uint64_t) * pages->count) +
-                         (PAGE_SIZE * pages_of_data)) )
+    page_data = malloc((pages_of_data ?: 1) * PAGE_SIZE);
+    if ( !page_data )
     {
-        ERROR("PAGE_DATA record wrong size: length %u, expected "
-              "%zu + %zu + %lu", rec->length, sizeof(*pages),
-              (sizeof(uint64_t) * pages->count), (PAGE_SIZE * pages_of_data));
+        ERROR("Unable to allocate %u pages of page data", pages_of_data);
         goto err;
     }
 
-    rc = process_page_data(ctx, pages->count, pfns, types,
-                           &pages->pfn[pages->count]);
+    for ( i = 0, j = 0, l = 0; i < pages->count; ++i )
+    {
+        void *page = page_data + (j * PAGE_SIZE);
+
+        if ( types[i] >= XEN_DOMCTL_PFINFO_BROKEN )
+            continue;
+
+        slots[i] = j++;
+
+        switch ( encodings[i] & COMPRESSED_PAGE_ENC_MASK )
+        {
+        case COMPRESSED_PAGE_LITERAL:
+            memcpy(page, data + (l++ * PAGE_SIZE), PAGE_SIZE);
+            break;
+
+        case COMPRESSED_PAGE_ZERO:
+            memset(page, 0, PAGE_SIZE);
+            break;
+
+        case COMPRESSED_PAGE_DUPLICATE:
+            ref = encodings[i] >> COMPRESSED_PAGE_REF_SHIFT;
+            if ( ref >= i || types[ref] >= XEN_DOMCTL_PFINFO_BROKEN )
+            {
+                ERROR("Invalid duplicate reference %u for pfn %#"PRIpfn
+                      " (index %u)", ref, pfns[i], i);
+                goto err;
+            }
+            memcpy(page, page_data + (slots[ref] * PAGE_SIZE), PAGE_SIZE);
+            break;
+        }
+    }
+
+    rc = process_page_data(ctx, pages->count, pfns, types, page_data);
  err:
+    free(page_data);
+    free(literals);
+    free(slots);
     free(types);
     free(pfns);
 
@@ -629,50 +967,642 @@ static int handle_checkpoint(struct xc_sr_context *ctx)
     return rc;
 }
 
-static int buffer_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
+static int postcopy_setup(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    unsigned int new_alloc_num;
-    struct xc_sr_record *p;
+    struct xc_sr_restore_postcopy *pc;
 
-    if ( ctx->restore.buffered_rec_num >= ctx->restore.allocated_rec_num )
-    {
-        new_alloc_num = ctx->restore.allocated_rec_num + DEFAULT_BUF_RECORDS;
-        p = realloc(ctx->restore.buffered_records,
-                    new_alloc_num * sizeof(struct xc_sr_record));
-        if ( !p )
-        {
-            ERROR("Failed to realloc memory for buffered records");
-            return -1;
-        }
+    if ( ctx->restore.postcopy )
+        return 0;
 
-        ctx->restore.buffered_records = p;
-        ctx->restore.allocated_rec_num = new_alloc_num;
+    if ( ctx->stream_type != XC_STREAM_PLAIN || !ctx->dominfo.hvm ||
+         !ctx->restore.callbacks->postcopy ||
+         !ctx->restore.callbacks->restore_results )
+    {
+        ERROR("Post-copy record found, but not set up for post-copy");
+        return -1;
     }
 
-    memcpy(&ctx->restore.buffered_records[ctx->restore.buffered_rec_num++],
-           rec, sizeof(*rec));
+    pc = calloc(1, sizeof(*pc));
+    if ( !pc )
+        goto err;
+
+    ctx->restore.postcopy = pc;
+    /* E.g. a lazy restore from a file: vcpus wait for the stream. */
+    pc->backchannel_closed = ctx->restore.send_back_fd < 0;
+    pc->outstanding = bitmap_alloc(ctx->restore.p2m_size);
+    pc->requested = bitmap_alloc(ctx->restore.p2m_size);
+    if ( !pc->outstanding || !pc->requested )
+        goto err;
 
     return 0;
+
+ err:
+    ERROR("Unable to allocate memory for post-copy state");
+    return -1;
 }
 
-int handle_static_data_end(struct xc_sr_context *ctx)
+/*
+ * Map the paging ring and enable paging for the domain.  Follows what
+ * xenpaging does, except the ring PFN has arrived in the HVM_PARAMS record.
+ */
+static int postcopy_enable_paging(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    unsigned int missing = 0;
-    int rc = 0;
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+    uint64_t param;
+    xen_pfn_t ring_pfn;
+    uint32_t remote_port;
+    int rc;
 
-    if ( ctx->restore.seen_static_data_end )
+    if ( xc_hvm_param_get(xch, ctx->domid, HVM_PARAM_PAGING_RING_PFN,
+                          &param) || !param )
     {
-        ERROR("Multiple STATIC_DATA_END records found");
+        PERROR("No paging ring available for post-copy");
         return -1;
     }
+    ring_pfn = param;
 
-    ctx->restore.seen_static_data_end = true;
+    pc->ring_page = xc_map_foreign_pages(xch, ctx->domid,
+                                         PROT_READ | PROT_WRITE,
+                                         &ring_pfn, 1);
+    if ( !pc->ring_page )
+    {
+        if ( xc_domain_populate_physmap_exact(xch, ctx->domid, 1, 0, 0,
+                                              &ring_pfn) )
+        {
+            PERROR("Failed to populate paging ring gfn");
+            return -1;
+        }
 
-    rc = ctx->restore.ops.static_data_complete(ctx, &missing);
-    if ( rc )
-        return rc;
+        pc->ring_page = xc_map_foreign_pages(xch, ctx->domid,
+                                             PROT_READ | PROT_WRITE,
+                                             &ring_pfn, 1);
+        if ( !pc->ring_page )
+        {
+            PERROR("Failed to map the paging ring");
+            return -1;
+        }
+    }
+
+    if ( xc_mem_paging_enable(xch, ctx->domid, &remote_port) )
+    {
+        PERROR("Failed to enable paging for post-copy");
+        return -1;
+    }
+    pc->paging_enabled = true;
+
+    pc->xce = xenevtchn_open(NULL, 0);
+    if ( !pc->xce )
+    {
+        PERROR("Failed to open event channel");
+        return -1;
+    }
+
+    rc = xenevtchn_bind_interdomain(pc->xce, ctx->domid, remote_port);
+    if ( rc < 0 )
+    {
+        PERROR("Failed to bind paging event channel");
+        return -1;
+    }
+    pc->port = rc;
+
+    SHARED_RING_INIT((vm_event_sring_t *)pc->ring_page);
+    BACK_RING_INIT(&pc->back_ring, (vm_event_sring_t *)pc->ring_page,
+                   PAGE_SIZE);
+
+    /* Now that the ring is set, remove it from the guest's physmap. */
+    if ( xc_domain_decrease_reservation_exact(xch, ctx->domid, 1, 0,
+                                              &ring_pfn) )
+    {
+        PERROR("Failed to remove paging ring from guest physmap");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void postcopy_cleanup(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+
+    if ( !pc )
+        return;
+
+    if ( pc->paging_enabled && xc_mem_paging_disable(xch, ctx->domid) )
+        PERROR("Failed to disable paging");
+
+    if ( pc->xce )
+        xenevtchn_close(pc->xce);
+
+    if ( pc->ring_page )
+        munmap(pc->ring_page, PAGE_SIZE);
+
+    free(pc->waiting);
+    free(pc->requested);
+    free(pc->outstanding);
+    free(pc);
+    ctx->restore.postcopy = NULL;
+}
+
+/*
+ * A POSTCOPY_PFNS record lists pages which the sender will only send once
+ * the guest is running here.  They are populated now so they can be paged
+ * out before the guest starts.
+ */
+static int handle_postcopy_pfns(struct xc_sr_context *ctx,
+                                struct xc_sr_record *rec)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_rec_postcopy_pfns *hdr = rec->data;
+    xen_pfn_t *pfns = NULL;
+    uint32_t *types = NULL;
+    unsigned int i;
+    int rc = -1;
+
+    if ( postcopy_setup(ctx) )
+        return -1;
+
+    if ( rec->length < sizeof(*hdr) ||
+         rec->length != sizeof(*hdr) + hdr->count * sizeof(*hdr->pfn) )
+    {
+        ERROR("POSTCOPY_PFNS record wrong size: length %u", rec->length);
+        return -1;
+    }
+
+    pfns = malloc(hdr->count * sizeof(*pfns));
+    types = malloc(hdr->count * sizeof(*types));
+    if ( hdr->count && (!pfns || !types) )
+    {
+        ERROR("Unable to allocate memory for %u postcopy pfns", hdr->count);
+        goto err;
+    }
+
+    for ( i = 0; i < hdr->count; ++i )
+    {
+        if ( hdr->pfn[i] >= ctx->restore.p2m_size )
+        {
+            ERROR("Postcopy pfn %#"PRIx64" beyond p2m_size %#lx",
+                  hdr->pfn[i], ctx->restore.p2m_size);
+            goto err;
+        }
+
+        pfns[i] = hdr->pfn[i];
+        types[i] = XEN_DOMCTL_PFINFO_NOTAB;
+
+        if ( !test_and_set_bit(pfns[i], ctx->restore.postcopy->outstanding) )
+            ctx->restore.postcopy->nr_outstanding++;
+    }
+
+    rc = populate_pfns(ctx, hdr->count, pfns, types);
+
+ err:
+    free(types);
+    free(pfns);
+
+    return rc;
+}
+
+/*
+ * All state but the outstanding pages has arrived.  Page the outstanding
+ * pages out, complete the domain and have the caller resume it.
+ */
+static int handle_postcopy_transition(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc;
+    xen_pfn_t pfn;
+    int rc;
+
+    rc = postcopy_setup(ctx);
+    if ( rc )
+        return rc;
+
+    pc = ctx->restore.postcopy;
+
+    rc = postcopy_enable_paging(ctx);
+    if ( rc )
+        return rc;
+
+    for ( pfn = 0; pfn < ctx->restore.p2m_size; ++pfn )
+    {
+        if ( !test_bit(pfn, pc->outstanding) )
+            continue;
+
+        if ( xc_mem_paging_nominate(xch, ctx->domid, pfn) ||
+             xc_mem_paging_evict(xch, ctx->domid, pfn) )
+        {
+            PERROR("Failed to page out pfn %#"PRIpfn, pfn);
+            return -1;
+        }
+    }
+
+    rc = ctx->restore.ops.stream_complete(ctx);
+    if ( rc )
+        return rc;
+
+    ctx->restore.callbacks->restore_results(ctx->restore.xenstore_gfn,
+                                            ctx->restore.console_gfn,
+                                            ctx->restore.callbacks->data);
+
+    IPRINTF("Resuming guest with %lu pages outstanding", pc->nr_outstanding);
+
+    if ( ctx->restore.callbacks->postcopy(ctx->restore.callbacks->data) != 1 )
+    {
+        ERROR("Failed to resume the guest for post-copy");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Ask the sender for pages which vcpus are waiting on.  Failing to do so is
+ * not fatal, as the sender streams all outstanding pages regardless.
+ */
+static void postcopy_send_faults(struct xc_sr_context *ctx,
+                                 const uint64_t *pfns, unsigned int count)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+    struct xc_sr_rec_postcopy_pfns hdr = { .count = count };
+    struct xc_sr_record rec = {
+        .type = REC_TYPE_POSTCOPY_FAULT,
+        .length = sizeof(hdr) + count * sizeof(*pfns),
+    };
+    struct iovec iov[] = {
+        { .iov_base = &rec.type,    .iov_len = sizeof(rec.type) },
+        { .iov_base = &rec.length,  .iov_len = sizeof(rec.length) },
+        { .iov_base = &hdr,         .iov_len = sizeof(hdr) },
+        { .iov_base = (void *)pfns, .iov_len = count * sizeof(*pfns) },
+    };
+
+    if ( !count || pc->backchannel_closed )
+        return;
+
+    if ( writev_exact(ctx->restore.send_back_fd, iov, ARRAY_SIZE(iov)) )
+    {
+        PERROR("Failed to send postcopy faults; waiting for the stream");
+        pc->backchannel_closed = true;
+    }
+}
+
+/*
+ * Consume requests from the paging ring.  Pages which have already arrived
+ * are resumed straight away; the rest are requested from the sender.
+ */
+static int postcopy_handle_paging(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+    vm_event_request_t req;
+    uint64_t *faults = NULL;
+    unsigned int nr_faults = 0, max_faults = 0;
+    bool notify = false;
+    xenevtchn_port_or_error_t port;
+    int rc = -1;
+
+    port = xenevtchn_pending(pc->xce);
+    if ( port < 0 )
+    {
+        PERROR("Failed to read paging event channel");
+        return -1;
+    }
+
+    if ( xenevtchn_unmask(pc->xce, port) )
+    {
+        PERROR("Failed to unmask paging event channel");
+        return -1;
+    }
+
+    while ( RING_HAS_UNCONSUMED_REQUESTS(&pc->back_ring) )
+    {
+        memcpy(&req, RING_GET_REQUEST(&pc->back_ring, pc->back_ring.req_cons),
+               sizeof(req));
+        pc->back_ring.req_cons++;
+        pc->back_ring.sring->req_event = pc->back_ring.req_cons + 1;
+
+        if ( req.u.mem_paging.gfn >= ctx->restore.p2m_size )
+        {
+            ERROR("Paging request for gfn %#"PRIx64" beyond p2m_size %#lx",
+                  req.u.mem_paging.gfn, ctx->restore.p2m_size);
+            goto out;
+        }
+
+        if ( test_bit(req.u.mem_paging.gfn, pc->outstanding) &&
+             (req.u.mem_paging.flags & MEM_PAGING_DROP_PAGE) )
+        {
+            /* The guest has freed the page.  Ignore it when it arrives. */
+            clear_bit(req.u.mem_paging.gfn, pc->outstanding);
+            pc->nr_outstanding--;
+        }
+        else if ( test_bit(req.u.mem_paging.gfn, pc->outstanding) )
+        {
+            if ( pc->nr_waiting == pc->max_waiting )
+            {
+                unsigned int max = pc->max_waiting ? pc->max_waiting * 2 : 16;
+                vm_event_request_t *w = realloc(pc->waiting,
+                                                max * sizeof(*w));
+
+                if ( !w )
+                {
+                    ERROR("Unable to allocate memory for paging requests");
+                    goto out;
+                }
+                pc->waiting = w;
+                pc->max_waiting = max;
+            }
+            pc->waiting[pc->nr_waiting++] = req;
+
+            if ( test_and_set_bit(req.u.mem_paging.gfn, pc->requested) )
+                continue;
+
+            if ( nr_faults == max_faults )
+            {
+                unsigned int max = max_faults ? max_faults * 2 : 16;
+                uint64_t *f = realloc(faults, max * sizeof(*f));
+
+                if ( !f )
+                {
+                    ERROR("Unable to allocate memory for postcopy faults");
+                    goto out;
+                }
+                faults = f;
+                max_faults = max;
+            }
+            faults[nr_faults++] = req.u.mem_paging.gfn;
+            continue;
+        }
+
+        if ( (req.flags & VM_EVENT_FLAG_VCPU_PAUSED) ||
+             (req.u.mem_paging.flags & MEM_PAGING_EVICT_FAIL) )
+        {
+            postcopy_put_response(ctx, &req);
+            notify = true;
+        }
+    }
+
+    postcopy_send_faults(ctx, faults, nr_faults);
+    rc = 0;
+
+ out:
+    if ( notify )
+    {
+        RING_PUSH_RESPONSES(&pc->back_ring);
+        if ( xenevtchn_notify(pc->xce, pc->port) )
+        {
+            PERROR("Failed to notify the paging event channel");
+            rc = -1;
+        }
+    }
+
+    free(faults);
+
+    return rc;
+}
+
+/*
+ * Post-copy phase.  The guest is running; service its paging requests while
+ * the outstanding pages arrive, until the END record.
+ */
+static int postcopy_restore(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_restore_postcopy *pc = ctx->restore.postcopy;
+    struct xc_sr_record rec;
+    struct pollfd pfds[] = {
+        { .fd = ctx->fd,               .events = POLLIN },
+        { .fd = xenevtchn_fd(pc->xce), .events = POLLIN },
+    };
+    int rc;
+
+    do
+    {
+        rc = poll(pfds, ARRAY_SIZE(pfds), -1);
+        if ( rc < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            PERROR("Failed to poll during post-copy");
+            return -1;
+        }
+
+        if ( pfds[1].revents )
+        {
+            rc = postcopy_handle_paging(ctx);
+            if ( rc )
+                return rc;
+        }
+
+        if ( !pfds[0].revents )
+            continue;
+
+        rc = read_record(ctx, ctx->fd, &rec);
+        if ( rc )
+            return rc;
+
+        switch ( rec.type )
+        {
+        case REC_TYPE_END:
+        case REC_TYPE_PAGE_DATA:
+        case REC_TYPE_COMPRESSED_PAGE_DATA:
+            break;
+
+        default:
+            ERROR("Unexpected %s record during post-copy",
+                  rec_type_to_str(rec.type));
+            free(rec.data);
+            return -1;
+        }
+
+        rc = process_record(ctx, &rec);
+        if ( rc )
+            return rc;
+
+    } while ( rec.type != REC_TYPE_END );
+
+    if ( pc->nr_outstanding )
+    {
+        ERROR("Stream ended with %lu post-copy pages outstanding",
+              pc->nr_outstanding);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Read the auxiliary streams, in whichever order their records arrive, until
+ * each has ended.  The saver keeps every copy of a page in the same stream,
+ * so page data can be applied as it is read.
+ */
+static int read_aux_streams(struct xc_sr_context *ctx, unsigned int count)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_record rec;
+    struct pollfd *pfds;
+    unsigned int i, nr_open = count;
+    int rc = -1;
+
+    pfds = calloc(count, sizeof(*pfds));
+    if ( !pfds )
+    {
+        ERROR("Unable to allocate auxiliary stream poll array");
+        return -1;
+    }
+
+    for ( i = 0; i < count; ++i )
+    {
+        pfds[i].fd = ctx->restore.aux_fds[i];
+        pfds[i].events = POLLIN;
+    }
+
+    while ( nr_open )
+    {
+        if ( poll(pfds, count, -1) < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            PERROR("Failed to poll auxiliary streams");
+            goto out;
+        }
+
+        for ( i = 0; i < count; ++i )
+        {
+            if ( !pfds[i].revents )
+                continue;
+
+            if ( read_record(ctx, pfds[i].fd, &rec) )
+                goto out;
+
+            switch ( rec.type )
+            {
+            case REC_TYPE_END:
+                /* A negative fd is ignored by poll(). */
+                pfds[i].fd = -1;
+                nr_open--;
+                break;
+
+            case REC_TYPE_PAGE_DATA:
+            case REC_TYPE_COMPRESSED_PAGE_DATA:
+                if ( process_record(ctx, &rec) )
+                    goto out;
+                break;
+
+            default:
+                ERROR("Unexpected %s record in auxiliary stream %u",
+                      rec_type_to_str(rec.type), i);
+                free(rec.data);
+                goto out;
+            }
+        }
+    }
+
+    rc = 0;
+
+ out:
+    free(pfds);
+
+    return rc;
+}
+
+static int handle_stream_fork(struct xc_sr_context *ctx,
+                              struct xc_sr_record *rec)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_rec_stream_fork *fork = rec->data;
+
+    if ( rec->length != sizeof(*fork) )
+    {
+        ERROR("STREAM_FORK record wrong size: length %u, expected %zu",
+              rec->length, sizeof(*fork));
+        return -1;
+    }
+
+    if ( ctx->stream_type != XC_STREAM_PLAIN )
+    {
+        ERROR("STREAM_FORK record found in a checkpointed stream");
+        return -1;
+    }
+
+    if ( !fork->count || fork->count != ctx->restore.nr_aux_fds )
+    {
+        ERROR("Stream forks into %u auxiliary streams, but %u were provided",
+              fork->count, ctx->restore.nr_aux_fds);
+        return -1;
+    }
+
+    if ( read_aux_streams(ctx, fork->count) )
+        return -1;
+
+    /* Nothing but the STREAM_JOIN record may follow in the main stream. */
+    ctx->restore.streams_forked = true;
+
+    return 0;
+}
+
+static int handle_stream_join(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+
+    if ( !ctx->restore.streams_forked )
+    {
+        ERROR("STREAM_JOIN record without STREAM_FORK");
+        return -1;
+    }
+
+    ctx->restore.streams_forked = false;
+
+    return 0;
+}
+
+static int buffer_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned int new_alloc_num;
+    struct xc_sr_record *p;
+
+    if ( ctx->restore.buffered_rec_num >= ctx->restore.allocated_rec_num )
+    {
+        new_alloc_num = ctx->restore.allocated_rec_num + DEFAULT_BUF_RECORDS;
+        p = realloc(ctx->restore.buffered_records,
+                    new_alloc_num * sizeof(struct xc_sr_record));
+        if ( !p )
+        {
+            ERROR("Failed to realloc memory for buffered records");
+            return -1;
+        }
+
+        ctx->restore.buffered_records = p;
+        ctx->restore.allocated_rec_num = new_alloc_num;
+    }
+
+    memcpy(&ctx->restore.buffered_records[ctx->restore.buffered_rec_num++],
+           rec, sizeof(*rec));
+
+    return 0;
+}
+
+int handle_static_data_end(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned int missing = 0;
+    int rc = 0;
+
+    if ( ctx->restore.seen_static_data_end )
+    {
+        ERROR("Multiple STATIC_DATA_END records found");
+        return -1;
+    }
+
+    ctx->restore.seen_static_data_end = true;
+
+    rc = ctx->restore.ops.static_data_complete(ctx, &missing);
+    if ( rc )
+        return rc;
 
     if ( ctx->restore.callbacks->static_data_done &&
          (rc = ctx->restore.callbacks->static_data_done(
@@ -687,6 +1617,15 @@ static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
     xc_interface *xch = ctx->xch;
     int rc = 0;
 
+    if ( ctx->restore.streams_forked && rec->type != REC_TYPE_STREAM_JOIN )
+    {
+        ERROR("Expected STREAM_JOIN record, got %s",
+              rec_type_to_str(rec->type));
+        free(rec->data);
+        rec->data = NULL;
+        return -1;
+    }
+
     switch ( rec->type )
     {
     case REC_TYPE_END:
@@ -696,6 +1635,10 @@ static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
         rc = handle_page_data(ctx, rec);
         break;
 
+    case REC_TYPE_COMPRESSED_PAGE_DATA:
+        rc = handle_compressed_page_data(ctx, rec);
+        break;
+
     case REC_TYPE_VERIFY:
         DPRINTF("Verify mode enabled");
         ctx->restore.verify = true;
@@ -709,6 +1652,22 @@ static int process_record(struct xc_sr_context *ctx, struct xc_sr_record *rec)
         rc = handle_static_data_end(ctx);
         break;
 
+    case REC_TYPE_POSTCOPY_PFNS:
+        rc = handle_postcopy_pfns(ctx, rec);
+        break;
+
+    case REC_TYPE_POSTCOPY_TRANSITION:
+        rc = handle_postcopy_transition(ctx);
+        break;
+
+    case REC_TYPE_STREAM_FORK:
+        rc = handle_stream_fork(ctx, rec);
+        break;
+
+    case REC_TYPE_STREAM_JOIN:
+        rc = handle_stream_join(ctx);
+        break;
+
     default:
         rc = ctx->restore.ops.process_record(ctx, rec);
         break;
@@ -782,6 +1741,8 @@ static void cleanup(struct xc_sr_context *ctx)
         xc_hypercall_buffer_free_pages(
             xch, dirty_bitmap, NRPAGES(bitmap_size(ctx->restore.p2m_size)));
 
+    postcopy_cleanup(ctx);
+
     free(ctx->restore.buffered_records);
     free(ctx->restore.populated_pfns);
 
@@ -845,6 +1806,17 @@ static int restore(struct xc_sr_context *ctx)
                 goto err;
         }
 
+        if ( rec.type == REC_TYPE_POSTCOPY_TRANSITION )
+        {
+            /* The guest is running, and the remaining pages follow. */
+            rc = postcopy_restore(ctx);
+            if ( rc )
+                goto err;
+
+            IPRINTF("Post-copy restore successful");
+            goto done;
+        }
+
     } while ( rec.type != REC_TYPE_END );
 
  remus_failover:
@@ -889,7 +1861,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
                       uint32_t store_domid, unsigned int console_evtchn,
                       unsigned long *console_gfn, uint32_t console_domid,
                       xc_stream_type_t stream_type,
-                      struct restore_callbacks *callbacks, int send_back_fd)
+                      struct restore_callbacks *callbacks, int send_back_fd,
+                      const int *aux_fds, unsigned int nr_aux_fds)
 {
     xen_pfn_t nr_pfns;
     struct xc_sr_context ctx = {
@@ -905,6 +1878,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
     ctx.restore.xenstore_domid = store_domid;
     ctx.restore.callbacks = callbacks;
     ctx.restore.send_back_fd = send_back_fd;
+    ctx.restore.aux_fds = aux_fds;
+    ctx.restore.nr_aux_fds = nr_aux_fds;
 
     /* Sanity check stream_type-related parameters */
     switch ( stream_type )
@@ -938,8 +1913,8 @@ int xc_domain_restore(xc_interface *xch, int io_fd, uint32_t dom,
         return -1;
     }
 
-    DPRINTF("fd %d, dom %u, hvm %u, stream_type %d",
-            io_fd, dom, ctx.dominfo.hvm, stream_type);
+    DPRINTF("fd %d (+%u), dom %u, hvm %u, stream_type %d",
+            io_fd, nr_aux_fds, dom, ctx.dominfo.hvm, stream_type);
 
     ctx.domid = dom;
 
@@ -1,4 +1,7 @@
 #include <assert.h>
+#include <poll.h>
+#include <pthread.h>
+#include <zlib.h>
 #include <arpa/inet.h>
 
 #include "xg_sr_common.h"
@@ -75,35 +78,321 @@ static int write_checkpoint_record(struct xc_sr_context *ctx)
 }
 
 /*
- * Writes a batch of memory as a PAGE_DATA record into the stream.  The batch
+ * A batch of memory which has been mapped and localised, along with the
+ * iovec[] describing its PAGE_DATA record.  Owns all of the resources needed
+ * to write the record, so may outlive ctx->save.batch_pfns[].
+ */
+struct xc_sr_save_batch
+{
+    struct xc_sr_record rec;
+    struct xc_sr_rec_page_data_header hdr;
+    uint64_t *rec_pfns;
+    struct iovec *iov;
+    int iovcnt;
+
+    /* COMPRESSED_PAGE_DATA only. */
+    struct xc_sr_rec_compressed_page_data_header chdr;
+    uint32_t *encodings;
+    void *cdata;
+    uint64_t padding;
+
+    void *guest_mapping;
+    unsigned int nr_pages_mapped;
+    /* Pointers to locally allocated pages.  Need freeing. */
+    void **local_pages;
+    unsigned int nr_pfns;
+};
+
+/*
+ * Maximum number of prepared batches which may be queued up for the writer
+ * thread in pipelined mode.  Bounds the amount of guest memory held mapped.
+ */
+#define SAVE_PIPELINE_DEPTH 4
+
+/* How much page data to write to a file between page cache discards. */
+#define SAVE_DISCARD_BYTES (64UL << 20)
+
+/*
+ * State for pipelined page sending.  The main thread maps and localises
+ * batches, while the writer thread writes them into its stream strictly in
+ * submission order.
+ */
+struct xc_sr_save_pipeline
+{
+    struct xc_sr_context *ctx;
+    /* The stream this pipeline writes to. */
+    int fd;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    /* Signalled whenever any of the fields below change. */
+    pthread_cond_t cond;
+
+    struct xc_sr_save_batch *queue[SAVE_PIPELINE_DEPTH];
+    unsigned int head, count;
+
+    /* The writer thread is writing a batch it has taken off the queue. */
+    bool busy;
+    /* The writer thread should discard anything queued and exit. */
+    bool stop;
+    /* errno from the first failed write, or 0. */
+    int error;
+};
+
+/*
+ * An auxiliary stream.  Always written through a pipeline of its own, so the
+ * streams are written to in parallel.
+ */
+struct xc_sr_save_aux_stream
+{
+    struct xc_sr_save_pipeline *pipeline;
+
+    /* Pfns accumulated for this stream's next batch. */
+    xen_pfn_t *batch_pfns;
+    unsigned int nr_batch_pfns;
+};
+
+static void free_batch(struct xc_sr_context *ctx,
+                       struct xc_sr_save_batch *batch)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned int i;
+
+    if ( !batch )
+        return;
+
+    free(batch->rec_pfns);
+    free(batch->encodings);
+    free(batch->cdata);
+    if ( batch->guest_mapping )
+        xenforeignmemory_unmap(xch->fmem, batch->guest_mapping,
+                               batch->nr_pages_mapped);
+    for ( i = 0; batch->local_pages && i < batch->nr_pfns; ++i )
+        free(batch->local_pages[i]);
+    free(batch->local_pages);
+    free(batch->iov);
+    free(batch);
+}
+
+/* Size of the duplicate detection table.  Must be a power of two. */
+#define DUP_TABLE_SIZE (MAX_BATCH_SIZE * 2)
+
+static bool page_is_zero(const void *page)
+{
+    const uint64_t *p = page;
+    unsigned int i;
+
+    for ( i = 0; i < PAGE_SIZE / sizeof(*p); ++i )
+        if ( p[i] )
+            return false;
+
+    return true;
+}
+
+/*
+ * Cheap hash of a page for duplicate detection, sampling one word from each
+ * cacheline.  Candidates are always confirmed with memcmp().
+ */
+static unsigned int page_hash(const void *page)
+{
+    const uint64_t *p = page;
+    uint64_t h = 0;
+    unsigned int i;
+
+    for ( i = 0; i < PAGE_SIZE / sizeof(*p); i += 8 )
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+
+    return (h ^ (h >> 32)) & (DUP_TABLE_SIZE - 1);
+}
+
+/*
+ * Build a COMPRESSED_PAGE_DATA record for a mapped batch.  Zero pages and
+ * duplicates of an earlier page in the same batch are sent as encodings only,
+ * while the remaining pages are deflated as a single stream.  If deflating
+ * does not save space, the literal pages are sent as they are.
+ */
+static int compress_batch(struct xc_sr_context *ctx,
+                          struct xc_sr_save_batch *batch, void **guest_data)
+{
+    xc_interface *xch = ctx->xch;
+    z_stream *zs = ctx->save.zstream;
+    unsigned int dup_table[DUP_TABLE_SIZE] = { 0 };
+    unsigned int i, h, nr_pfns = batch->nr_pfns, nr_literals = 0;
+    size_t bound;
+    struct iovec *iov = batch->iov;
+    int zrc;
+
+    batch->encodings = malloc(nr_pfns * sizeof(*batch->encodings));
+    if ( !batch->encodings )
+    {
+        ERROR("Unable to allocate encodings for a batch of %u pages",
+              nr_pfns);
+        return -1;
+    }
+
+    for ( i = 0; i < nr_pfns; ++i )
+    {
+        batch->encodings[i] = COMPRESSED_PAGE_LITERAL;
+
+        if ( !guest_data[i] )
+            continue;
+
+        if ( page_is_zero(guest_data[i]) )
+        {
+            batch->encodings[i] = COMPRESSED_PAGE_ZERO;
+            guest_data[i] = NULL;
+            continue;
+        }
+
+        h = page_hash(guest_data[i]);
+        if ( dup_table[h] &&
+             !memcmp(guest_data[dup_table[h] - 1], guest_data[i], PAGE_SIZE) )
+        {
+            batch->encodings[i] = COMPRESSED_PAGE_DUPLICATE |
+                ((dup_table[h] - 1) << COMPRESSED_PAGE_REF_SHIFT);
+            guest_data[i] = NULL;
+            continue;
+        }
+
+        if ( !dup_table[h] )
+            dup_table[h] = i + 1;
+        ++nr_literals;
+    }
+
+    batch->chdr.count = nr_pfns;
+    batch->chdr.compression = COMPRESSED_PAGE_DATA_NONE;
+    batch->chdr.data_length = nr_literals * PAGE_SIZE;
+
+    if ( nr_literals )
+    {
+        bound = deflateBound(zs, nr_literals * PAGE_SIZE);
+        batch->cdata = malloc(bound);
+        if ( !batch->cdata )
+        {
+            ERROR("Unable to allocate %zu bytes of compression buffer", bound);
+            return -1;
+        }
+
+        deflateReset(zs);
+        zs->next_out = batch->cdata;
+        zs->avail_out = bound;
+
+        for ( i = 0, zrc = Z_OK; i < nr_pfns && zrc == Z_OK; ++i )
+        {
+            if ( !guest_data[i] )
+                continue;
+
+            zs->next_in = guest_data[i];
+            zs->avail_in = PAGE_SIZE;
+            zrc = deflate(zs, Z_NO_FLUSH);
+        }
+
+        if ( zrc == Z_OK )
+            zrc = deflate(zs, Z_FINISH);
+
+        if ( zrc != Z_STREAM_END )
+        {
+            ERROR("Failed to compress batch of %u pages: %d (%s)",
+                  nr_literals, zrc, zs->msg ?: "");
+            return -1;
+        }
+
+        if ( zs->total_out < nr_literals * PAGE_SIZE )
+        {
+            batch->chdr.compression = COMPRESSED_PAGE_DATA_ZLIB;
+            batch->chdr.data_length = zs->total_out;
+        }
+    }
+
+    batch->rec.type = REC_TYPE_COMPRESSED_PAGE_DATA;
+    batch->rec.length = sizeof(batch->chdr);
+    batch->rec.length += nr_pfns * sizeof(*batch->rec_pfns);
+    batch->rec.length += nr_pfns * sizeof(*batch->encodings);
+    batch->rec.length += batch->chdr.data_length;
+
+    iov[0].iov_base = &batch->rec.type;
+    iov[0].iov_len = sizeof(batch->rec.type);
+
+    iov[1].iov_base = &batch->rec.length;
+    iov[1].iov_len = sizeof(batch->rec.length);
+
+    iov[2].iov_base = &batch->chdr;
+    iov[2].iov_len = sizeof(batch->chdr);
+
+    iov[3].iov_base = batch->rec_pfns;
+    iov[3].iov_len = nr_pfns * sizeof(*batch->rec_pfns);
+
+    iov[4].iov_base = batch->encodings;
+    iov[4].iov_len = nr_pfns * sizeof(*batch->encodings);
+
+    batch->iovcnt = 5;
+
+    if ( batch->chdr.compression == COMPRESSED_PAGE_DATA_ZLIB )
+    {
+        iov[batch->iovcnt].iov_base = batch->cdata;
+        iov[batch->iovcnt].iov_len = batch->chdr.data_length;
+        batch->iovcnt++;
+    }
+    else
+    {
+        for ( i = 0; i < nr_pfns; ++i )
+        {
+            if ( !guest_data[i] )
+                continue;
+
+            iov[batch->iovcnt].iov_base = guest_data[i];
+            iov[batch->iovcnt].iov_len = PAGE_SIZE;
+            batch->iovcnt++;
+        }
+    }
+
+    /* Pad the record out to REC_ALIGN_ORDER. */
+    if ( batch->rec.length & ((1U << REC_ALIGN_ORDER) - 1) )
+    {
+        iov[batch->iovcnt].iov_base = &batch->padding;
+        iov[batch->iovcnt].iov_len = ROUNDUP(batch->rec.length,
+                                             REC_ALIGN_ORDER) -
+            batch->rec.length;
+        batch->iovcnt++;
+    }
+
+    return 0;
+}
+
+/*
+ * Prepares a batch of memory to be written as a PAGE_DATA record.  The batch
  * is constructed in ctx->save.batch_pfns.
  *
  * This function:
  * - gets the types for each pfn in the batch.
  * - for each pfn with real data:
  *   - maps and attempts to localise the pages.
- * - construct and writes a PAGE_DATA record into the stream.
+ * - constructs the iovec[] for the PAGE_DATA record.
  */
-static int write_batch(struct xc_sr_context *ctx)
+static struct xc_sr_save_batch *map_batch(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
     xen_pfn_t *mfns = NULL, *types = NULL;
-    void *guest_mapping = NULL;
     void **guest_data = NULL;
-    void **local_pages = NULL;
     int *errors = NULL, rc = -1;
-    unsigned int i, p, nr_pages = 0, nr_pages_mapped = 0;
+    unsigned int i, p, nr_pages = 0;
     unsigned int nr_pfns = ctx->save.nr_batch_pfns;
     void *page, *orig_page;
-    uint64_t *rec_pfns = NULL;
-    struct iovec *iov = NULL; int iovcnt = 0;
-    struct xc_sr_rec_page_data_header hdr = { 0 };
-    struct xc_sr_record rec = {
-        .type = REC_TYPE_PAGE_DATA,
-    };
+    struct xc_sr_save_batch *batch;
+    struct iovec *iov;
 
     assert(nr_pfns != 0);
 
+    batch = calloc(1, sizeof(*batch));
+    if ( !batch )
+    {
+        ERROR("Unable to allocate batch descriptor");
+        return NULL;
+    }
+
+    batch->rec.type = REC_TYPE_PAGE_DATA;
+    batch->nr_pfns = nr_pfns;
+
     /* Mfns of the batch pfns. */
     mfns = malloc(nr_pfns * sizeof(*mfns));
     /* Types of the batch pfns. */
@@ -113,11 +402,12 @@ static int write_batch(struct xc_sr_context *ctx)
     /* Pointers to page data to send.  Mapped gfns or local allocations. */
     guest_data = calloc(nr_pfns, sizeof(*guest_data));
     /* Pointers to locally allocated pages.  Need freeing. */
-    local_pages = calloc(nr_pfns, sizeof(*local_pages));
+    batch->local_pages = calloc(nr_pfns, sizeof(*batch->local_pages));
     /* iovec[] for writev(). */
-    iov = malloc((nr_pfns + 4) * sizeof(*iov));
+    batch->iov = iov = malloc((nr_pfns + 6) * sizeof(*iov));
 
-    if ( !mfns || !types || !errors || !guest_data || !local_pages || !iov )
+    if ( !mfns || !types || !errors || !guest_data || !batch->local_pages ||
+         !iov )
     {
         ERROR("Unable to allocate arrays for a batch of %u pages",
               nr_pfns);
@@ -160,14 +450,14 @@ static int write_batch(struct xc_sr_context *ctx)
 
     if ( nr_pages > 0 )
     {
-        guest_mapping = xenforeignmemory_map(
+        batch->guest_mapping = xenforeignmemory_map(
             xch->fmem, ctx->domid, PROT_READ, nr_pages, mfns, errors);
-        if ( !guest_mapping )
+        if ( !batch->guest_mapping )
         {
             PERROR("Failed to map guest pages");
             goto err;
         }
-        nr_pages_mapped = nr_pages;
+        batch->nr_pages_mapped = nr_pages;
 
         for ( i = 0, p = 0; i < nr_pfns; ++i )
         {
@@ -186,11 +476,11 @@ static int write_batch(struct xc_sr_context *ctx)
                 goto err;
             }
 
-            orig_page = page = guest_mapping + (p * PAGE_SIZE);
+            orig_page = page = batch->guest_mapping + (p * PAGE_SIZE);
             rc = ctx->save.ops.normalise_page(ctx, types[i], &page);
 
             if ( orig_page != page )
-                local_pages[i] = page;
+                batch->local_pages[i] = page;
 
             if ( rc )
             {
@@ -212,36 +502,43 @@ static int write_batch(struct xc_sr_context *ctx)
         }
     }
 
-    rec_pfns = malloc(nr_pfns * sizeof(*rec_pfns));
-    if ( !rec_pfns )
+    batch->rec_pfns = malloc(nr_pfns * sizeof(*batch->rec_pfns));
+    if ( !batch->rec_pfns )
     {
         ERROR("Unable to allocate %zu bytes of memory for page data pfn list",
-              nr_pfns * sizeof(*rec_pfns));
+              nr_pfns * sizeof(*batch->rec_pfns));
         goto err;
     }
 
-    hdr.count = nr_pfns;
+    for ( i = 0; i < nr_pfns; ++i )
+        batch->rec_pfns[i] = ((uint64_t)(types[i]) << 32) |
+            ctx->save.batch_pfns[i];
+
+    if ( ctx->save.compress )
+    {
+        rc = compress_batch(ctx, batch, guest_data);
+        goto err;
+    }
 
-    rec.length = sizeof(hdr);
-    rec.length += nr_pfns * sizeof(*rec_pfns);
-    rec.length += nr_pages * PAGE_SIZE;
+    batch->hdr.count = nr_pfns;
 
-    for ( i = 0; i < nr_pfns; ++i )
-        rec_pfns[i] = ((uint64_t)(types[i]) << 32) | ctx->save.batch_pfns[i];
+    batch->rec.length = sizeof(batch->hdr);
+    batch->rec.length += nr_pfns * sizeof(*batch->rec_pfns);
+    batch->rec.length += nr_pages * PAGE_SIZE;
 
-    iov[0].iov_base = &rec.type;
-    iov[0].iov_len = sizeof(rec.type);
+    iov[0].iov_base = &batch->rec.type;
+    iov[0].iov_len = sizeof(batch->rec.type);
 
-    iov[1].iov_base = &rec.length;
-    iov[1].iov_len = sizeof(rec.length);
+    iov[1].iov_base = &batch->rec.length;
+    iov[1].iov_len = sizeof(batch->rec.length);
 
-    iov[2].iov_base = &hdr;
-    iov[2].iov_len = sizeof(hdr);
+    iov[2].iov_base = &batch->hdr;
+    iov[2].iov_len = sizeof(batch->hdr);
 
-    iov[3].iov_base = rec_pfns;
-    iov[3].iov_len = nr_pfns * sizeof(*rec_pfns);
+    iov[3].iov_base = batch->rec_pfns;
+    iov[3].iov_len = nr_pfns * sizeof(*batch->rec_pfns);
 
-    iovcnt = 4;
+    batch->iovcnt = 4;
 
     if ( nr_pages )
     {
@@ -249,227 +546,790 @@ static int write_batch(struct xc_sr_context *ctx)
         {
             if ( guest_data[i] )
             {
-                iov[iovcnt].iov_base = guest_data[i];
-                iov[iovcnt].iov_len = PAGE_SIZE;
-                iovcnt++;
+                iov[batch->iovcnt].iov_base = guest_data[i];
+                iov[batch->iovcnt].iov_len = PAGE_SIZE;
+                batch->iovcnt++;
                 --nr_pages;
             }
         }
     }
 
-    if ( writev_exact(ctx->fd, iov, iovcnt) )
-    {
-        PERROR("Failed to write page data to stream");
-        goto err;
-    }
-
-    /* Sanity check we have sent all the pages we expected to. */
+    /* Sanity check we have collected all the pages we expected to. */
     assert(nr_pages == 0);
-    rc = ctx->save.nr_batch_pfns = 0;
+    rc = 0;
 
  err:
-    free(rec_pfns);
-    if ( guest_mapping )
-        xenforeignmemory_unmap(xch->fmem, guest_mapping, nr_pages_mapped);
-    for ( i = 0; local_pages && i < nr_pfns; ++i )
-        free(local_pages[i]);
-    free(iov);
-    free(local_pages);
     free(guest_data);
     free(errors);
     free(types);
     free(mfns);
 
-    return rc;
+    if ( rc )
+    {
+        free_batch(ctx, batch);
+        batch = NULL;
+    }
+
+    return batch;
 }
 
 /*
- * Flush a batch of pfns into the stream.
+ * Write a batch of page data into a stream.  When saving to a file, the
+ * data won't be read back, so drop it from the page cache as it goes to
+ * keep a big save from evicting everything else on the host.
  */
-static int flush_batch(struct xc_sr_context *ctx)
+static int write_batch_data(struct xc_sr_context *ctx, int fd,
+                            struct xc_sr_save_batch *batch)
 {
-    int rc = 0;
+    int i;
 
-    if ( ctx->save.nr_batch_pfns == 0 )
-        return rc;
+    if ( writev_exact(fd, batch->iov, batch->iovcnt) )
+        return -1;
 
-    rc = write_batch(ctx);
+    /* Auxiliary streams are never files. */
+    if ( !ctx->save.discard_cache || fd != ctx->fd )
+        return 0;
 
-    if ( !rc )
+    for ( i = 0; i < batch->iovcnt; i++ )
+        ctx->save.discard_pending += batch->iov[i].iov_len;
+
+    if ( ctx->save.discard_pending >= SAVE_DISCARD_BYTES )
     {
-        VALGRIND_MAKE_MEM_UNDEFINED(ctx->save.batch_pfns,
-                                    MAX_BATCH_SIZE *
-                                    sizeof(*ctx->save.batch_pfns));
+        discard_file_cache(ctx->xch, ctx->fd, 0 /* no flush */);
+        ctx->save.discard_pending = 0;
     }
 
-    return rc;
+    return 0;
 }
 
 /*
- * Add a single pfn to the batch, flushing the batch if full.
+ * Writer thread for pipelined mode.  Writes queued batches into the stream
+ * in order until told to stop, or a write fails.
  */
-static int add_to_batch(struct xc_sr_context *ctx, xen_pfn_t pfn)
+static void *pipeline_writer(void *arg)
 {
-    int rc = 0;
+    struct xc_sr_save_pipeline *pipe = arg;
+    struct xc_sr_context *ctx = pipe->ctx;
+    struct xc_sr_save_batch *batch;
+    bool discard;
+    int err;
 
-    if ( ctx->save.nr_batch_pfns == MAX_BATCH_SIZE )
-        rc = flush_batch(ctx);
+    pthread_mutex_lock(&pipe->lock);
+    for ( ; ; )
+    {
+        while ( !pipe->count && !pipe->stop )
+            pthread_cond_wait(&pipe->cond, &pipe->lock);
 
-    if ( rc == 0 )
-        ctx->save.batch_pfns[ctx->save.nr_batch_pfns++] = pfn;
+        if ( !pipe->count )
+            break;
 
-    return rc;
+        batch = pipe->queue[pipe->head];
+        pipe->head = (pipe->head + 1) % SAVE_PIPELINE_DEPTH;
+        pipe->count--;
+        pipe->busy = true;
+        discard = pipe->stop || pipe->error;
+        pthread_cond_broadcast(&pipe->cond);
+        pthread_mutex_unlock(&pipe->lock);
+
+        err = 0;
+        if ( !discard && write_batch_data(ctx, pipe->fd, batch) )
+            err = errno ?: EIO;
+        free_batch(ctx, batch);
+
+        pthread_mutex_lock(&pipe->lock);
+        if ( err && !pipe->error )
+            pipe->error = err;
+        pipe->busy = false;
+        pthread_cond_broadcast(&pipe->cond);
+    }
+    pthread_mutex_unlock(&pipe->lock);
+
+    return NULL;
 }
 
 /*
- * Pause/suspend the domain, and refresh ctx->dominfo if required.
+ * Hand a prepared batch to the writer thread, waiting for space in the queue
+ * if necessary.  Ownership of the batch passes to the pipeline regardless of
+ * outcome.
  */
-static int suspend_domain(struct xc_sr_context *ctx)
+static int pipeline_submit(struct xc_sr_context *ctx,
+                           struct xc_sr_save_pipeline *pipe,
+                           struct xc_sr_save_batch *batch)
 {
     xc_interface *xch = ctx->xch;
+    int err;
 
-    /* TODO: Properly specify the return value from this callback.  All
-     * implementations currently appear to return 1 for success, whereas
-     * the legacy code checks for != 0. */
-    int cb_rc = ctx->save.callbacks->suspend(ctx->save.callbacks->data);
+    pthread_mutex_lock(&pipe->lock);
+    while ( pipe->count == SAVE_PIPELINE_DEPTH && !pipe->error )
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
 
-    if ( cb_rc == 0 )
+    err = pipe->error;
+    if ( !err )
     {
-        ERROR("save callback suspend() failed: %d", cb_rc);
-        return -1;
+        pipe->queue[(pipe->head + pipe->count) % SAVE_PIPELINE_DEPTH] = batch;
+        pipe->count++;
+        pthread_cond_broadcast(&pipe->cond);
     }
+    pthread_mutex_unlock(&pipe->lock);
 
-    /* Refresh domain information. */
-    if ( (xc_domain_getinfo(xch, ctx->domid, 1, &ctx->dominfo) != 1) ||
-         (ctx->dominfo.domid != ctx->domid) )
+    if ( err )
     {
-        PERROR("Unable to refresh domain information");
+        free_batch(ctx, batch);
+        errno = err;
+        PERROR("Failed to write page data to stream");
         return -1;
     }
 
-    /* Confirm the domain has actually been paused. */
-    if ( !ctx->dominfo.shutdown ||
-         (ctx->dominfo.shutdown_reason != SHUTDOWN_suspend) )
+    return 0;
+}
+
+/* Wait for a writer thread to have written every batch submitted to it. */
+static int pipeline_wait(struct xc_sr_context *ctx,
+                         struct xc_sr_save_pipeline *pipe)
+{
+    xc_interface *xch = ctx->xch;
+    int err;
+
+    if ( !pipe )
+        return 0;
+
+    pthread_mutex_lock(&pipe->lock);
+    while ( (pipe->count || pipe->busy) && !pipe->error )
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    err = pipe->error;
+    pthread_mutex_unlock(&pipe->lock);
+
+    if ( err )
     {
-        ERROR("Domain has not been suspended: shutdown %d, reason %d",
-              ctx->dominfo.shutdown, ctx->dominfo.shutdown_reason);
+        errno = err;
+        PERROR("Failed to write page data to stream");
         return -1;
     }
 
-    xc_report_progress_single(xch, "Domain now suspended");
-
     return 0;
 }
 
 /*
- * Send a subset of pages in the guests p2m, according to the dirty bitmap.
- * Used for each subsequent iteration of the live migration loop.
- *
- * Bitmap is bounded by p2m_size.
+ * Wait for every writer thread to have written every submitted batch.  Must
+ * be called before anything else is written into the streams, to keep the
+ * records in order.
  */
-static int send_dirty_pages(struct xc_sr_context *ctx,
-                            unsigned long entries)
+static int pipeline_drain(struct xc_sr_context *ctx)
 {
-    xc_interface *xch = ctx->xch;
-    xen_pfn_t p;
-    unsigned long written;
-    int rc;
-    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
-                                    &ctx->save.dirty_bitmap_hbuf);
+    unsigned int i;
 
-    for ( p = 0, written = 0; p < ctx->save.p2m_size; ++p )
-    {
-        if ( !test_bit(p, dirty_bitmap) )
-            continue;
+    if ( pipeline_wait(ctx, ctx->save.pipeline) )
+        return -1;
 
-        rc = add_to_batch(ctx, p);
-        if ( rc )
-            return rc;
+    for ( i = 0; ctx->save.aux_streams && i < ctx->save.nr_aux_fds; ++i )
+        if ( pipeline_wait(ctx, ctx->save.aux_streams[i].pipeline) )
+            return -1;
+
+    return 0;
+}
 
-        /* Update progress every 4MB worth of memory sent. */
-        if ( (written & ((1U << (22 - 12)) - 1)) == 0 )
-            xc_report_progress_step(xch, written, entries);
+static struct xc_sr_save_pipeline *pipeline_start(struct xc_sr_context *ctx,
+                                                  int fd)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_save_pipeline *pipe;
+    int err;
 
-        ++written;
+    pipe = calloc(1, sizeof(*pipe));
+    if ( !pipe )
+    {
+        ERROR("Unable to allocate save pipeline");
+        return NULL;
     }
 
-    rc = flush_batch(ctx);
-    if ( rc )
-        return rc;
-
-    if ( written > entries )
-        DPRINTF("Bitmap contained more entries than expected...");
+    pipe->ctx = ctx;
+    pipe->fd = fd;
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->cond, NULL);
 
-    xc_report_progress_step(xch, entries, entries);
+    err = pthread_create(&pipe->writer, NULL, pipeline_writer, pipe);
+    if ( err )
+    {
+        errno = err;
+        PERROR("Unable to create save pipeline writer thread");
+        pthread_cond_destroy(&pipe->cond);
+        pthread_mutex_destroy(&pipe->lock);
+        free(pipe);
+        return NULL;
+    }
 
-    return ctx->save.ops.check_vm_state(ctx);
+    return pipe;
 }
 
 /*
- * Send all pages in the guests p2m.  Used as the first iteration of the live
- * migration loop, and for a non-live save.
+ * Stop a writer thread.  Anything still queued (only possible on an error
+ * path) is discarded.
  */
-static int send_all_pages(struct xc_sr_context *ctx)
+static void pipeline_stop(struct xc_sr_save_pipeline *pipe)
 {
-    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
-                                    &ctx->save.dirty_bitmap_hbuf);
+    if ( !pipe )
+        return;
 
-    bitmap_set(dirty_bitmap, ctx->save.p2m_size);
+    pthread_mutex_lock(&pipe->lock);
+    pipe->stop = true;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
 
-    return send_dirty_pages(ctx, ctx->save.p2m_size);
+    pthread_join(pipe->writer, NULL);
+
+    pthread_cond_destroy(&pipe->cond);
+    pthread_mutex_destroy(&pipe->lock);
+    free(pipe);
 }
 
-static int enable_logdirty(struct xc_sr_context *ctx)
+/*
+ * Writes a batch of memory as a PAGE_DATA record into the stream.  The batch
+ * is constructed in ctx->save.batch_pfns.
+ *
+ * With a pipeline, the write itself is deferred to its writer thread so the
+ * next batch can be mapped and localised in the meantime.  Without one, the
+ * batch is written to the main stream.
+ */
+static int write_batch(struct xc_sr_context *ctx,
+                       struct xc_sr_save_pipeline *pipe)
 {
     xc_interface *xch = ctx->xch;
-    int on1 = 0, off = 0, on2 = 0;
+    struct xc_sr_save_batch *batch;
     int rc;
 
-    /* This juggling is required if logdirty is enabled for VRAM tracking. */
-    rc = xc_shadow_control(xch, ctx->domid,
-                           XEN_DOMCTL_SHADOW_OP_ENABLE_LOGDIRTY,
-                           NULL, 0, NULL, 0, NULL);
-    if ( rc < 0 )
+    batch = map_batch(ctx);
+    if ( !batch )
+        return -1;
+
+    if ( pipe )
+        rc = pipeline_submit(ctx, pipe, batch);
+    else
     {
-        on1 = errno;
-        rc = xc_shadow_control(xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_OFF,
-                               NULL, 0, NULL, 0, NULL);
-        if ( rc < 0 )
-            off = errno;
-        else {
-            rc = xc_shadow_control(xch, ctx->domid,
-                                   XEN_DOMCTL_SHADOW_OP_ENABLE_LOGDIRTY,
-                                   NULL, 0, NULL, 0, NULL);
-            if ( rc < 0 )
-                on2 = errno;
-        }
-        if ( rc < 0 )
-        {
-            PERROR("Failed to enable logdirty: %d,%d,%d", on1, off, on2);
-            return rc;
-        }
+        rc = write_batch_data(ctx, ctx->fd, batch);
+        if ( rc )
+            PERROR("Failed to write page data to stream");
+        free_batch(ctx, batch);
     }
 
-    return 0;
+    if ( !rc )
+        ctx->save.nr_batch_pfns = 0;
+
+    return rc;
+}
+
+/*
+ * Flush the pfns accumulated for an auxiliary stream into it, by way of
+ * ctx->save.batch_pfns.
+ */
+static int flush_aux_batch(struct xc_sr_context *ctx,
+                           struct xc_sr_save_aux_stream *aux)
+{
+    int rc;
+
+    if ( aux->nr_batch_pfns == 0 )
+        return 0;
+
+    assert(ctx->save.nr_batch_pfns == 0);
+    memcpy(ctx->save.batch_pfns, aux->batch_pfns,
+           aux->nr_batch_pfns * sizeof(*aux->batch_pfns));
+    ctx->save.nr_batch_pfns = aux->nr_batch_pfns;
+
+    rc = write_batch(ctx, aux->pipeline);
+    if ( !rc )
+        aux->nr_batch_pfns = 0;
+
+    return rc;
+}
+
+/*
+ * Flush a batch of pfns into the stream, or every auxiliary stream's batch
+ * while the streams are forked.
+ */
+static int flush_batch(struct xc_sr_context *ctx)
+{
+    unsigned int i;
+    int rc = 0;
+
+    if ( ctx->save.streams_forked )
+    {
+        for ( i = 0; !rc && i < ctx->save.nr_aux_fds; ++i )
+            rc = flush_aux_batch(ctx, &ctx->save.aux_streams[i]);
+    }
+    else if ( ctx->save.nr_batch_pfns )
+        rc = write_batch(ctx, ctx->save.pipeline);
+
+    if ( !rc )
+    {
+        VALGRIND_MAKE_MEM_UNDEFINED(ctx->save.batch_pfns,
+                                    MAX_BATCH_SIZE *
+                                    sizeof(*ctx->save.batch_pfns));
+    }
+
+    return rc;
+}
+
+/*
+ * Add a single pfn to the batch, flushing the batch if full.
+ *
+ * While the streams are forked, each aligned run of MAX_BATCH_SIZE pfns
+ * belongs to one auxiliary stream.  Every copy of a page therefore travels
+ * down the same stream, so the restorer sees the copies in order whichever
+ * order it reads the streams in.
+ */
+static int add_to_batch(struct xc_sr_context *ctx, xen_pfn_t pfn)
+{
+    int rc = 0;
+
+    if ( ctx->save.streams_forked )
+    {
+        struct xc_sr_save_aux_stream *aux = &ctx->save.aux_streams[
+            (pfn / MAX_BATCH_SIZE) % ctx->save.nr_aux_fds];
+
+        if ( aux->nr_batch_pfns == MAX_BATCH_SIZE )
+            rc = flush_aux_batch(ctx, aux);
+
+        if ( rc == 0 )
+            aux->batch_pfns[aux->nr_batch_pfns++] = pfn;
+
+        return rc;
+    }
+
+    if ( ctx->save.nr_batch_pfns == MAX_BATCH_SIZE )
+        rc = flush_batch(ctx);
+
+    if ( rc == 0 )
+        ctx->save.batch_pfns[ctx->save.nr_batch_pfns++] = pfn;
+
+    return rc;
+}
+
+/*
+ * Pause/suspend the domain, and refresh ctx->dominfo if required.
+ */
+static int suspend_domain(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+
+    /* TODO: Properly specify the return value from this callback.  All
+     * implementations currently appear to return 1 for success, whereas
+     * the legacy code checks for != 0. */
+    int cb_rc = ctx->save.callbacks->suspend(ctx->save.callbacks->data);
+
+    if ( cb_rc == 0 )
+    {
+        ERROR("save callback suspend() failed: %d", cb_rc);
+        return -1;
+    }
+
+    /* Refresh domain information. */
+    if ( (xc_domain_getinfo(xch, ctx->domid, 1, &ctx->dominfo) != 1) ||
+         (ctx->dominfo.domid != ctx->domid) )
+    {
+        PERROR("Unable to refresh domain information");
+        return -1;
+    }
+
+    /* Confirm the domain has actually been paused. */
+    if ( !ctx->dominfo.shutdown ||
+         (ctx->dominfo.shutdown_reason != SHUTDOWN_suspend) )
+    {
+        ERROR("Domain has not been suspended: shutdown %d, reason %d",
+              ctx->dominfo.shutdown, ctx->dominfo.shutdown_reason);
+        return -1;
+    }
+
+    xc_report_progress_single(xch, "Domain now suspended");
+
+    return 0;
+}
+
+static int send_dirty_pfn(struct xc_sr_context *ctx, xen_pfn_t pfn,
+                          unsigned long *written, unsigned long entries)
+{
+    int rc = add_to_batch(ctx, pfn);
+
+    if ( rc )
+        return rc;
+
+    /* Update progress every 4MB worth of memory sent. */
+    if ( (*written & ((1U << (22 - 12)) - 1)) == 0 )
+        xc_report_progress_step(ctx->xch, *written, entries);
+
+    ++*written;
+
+    return 0;
+}
+
+/*
+ * Send a subset of pages in the guests p2m, according to the dirty bitmap,
+ * or the list of dirty ranges if one has been fetched.  Used for each
+ * subsequent iteration of the live migration loop.
+ *
+ * Bitmap is bounded by p2m_size.
+ */
+static int send_dirty_pages(struct xc_sr_context *ctx,
+                            unsigned long entries)
+{
+    xc_interface *xch = ctx->xch;
+    xen_pfn_t p, end;
+    unsigned long written = 0;
+    unsigned int r;
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    if ( ctx->save.dirty_ranges_valid )
+    {
+        ctx->save.dirty_ranges_valid = false;
+
+        for ( r = 0; r < ctx->save.nr_dirty_ranges; ++r )
+        {
+            end = min_t(xen_pfn_t, ctx->save.p2m_size,
+                        ctx->save.dirty_ranges[r].start +
+                        ctx->save.dirty_ranges[r].nr);
+
+            for ( p = ctx->save.dirty_ranges[r].start; p < end; ++p )
+            {
+                rc = send_dirty_pfn(ctx, p, &written, entries);
+                if ( rc )
+                    return rc;
+            }
+        }
+    }
+    else
+    {
+        for ( p = 0; p < ctx->save.p2m_size; ++p )
+        {
+            /* Skip clean words wholesale. */
+            if ( !(p % BITS_PER_LONG) && !dirty_bitmap[p / BITS_PER_LONG] )
+            {
+                p += BITS_PER_LONG - 1;
+                continue;
+            }
+
+            if ( !test_bit(p, dirty_bitmap) )
+                continue;
+
+            rc = send_dirty_pfn(ctx, p, &written, entries);
+            if ( rc )
+                return rc;
+        }
+    }
+
+    rc = flush_batch(ctx);
+    if ( rc )
+        return rc;
+
+    rc = pipeline_drain(ctx);
+    if ( rc )
+        return rc;
+
+    if ( written > entries )
+        DPRINTF("Bitmap contained more entries than expected...");
+
+    xc_report_progress_step(xch, entries, entries);
+
+    return ctx->save.ops.check_vm_state(ctx);
+}
+
+/*
+ * Send all pages in the guests p2m.  Used as the first iteration of the live
+ * migration loop, and for a non-live save.
+ */
+static int send_all_pages(struct xc_sr_context *ctx)
+{
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    bitmap_set(dirty_bitmap, ctx->save.p2m_size);
+
+    return send_dirty_pages(ctx, ctx->save.p2m_size);
+}
+
+/*
+ * Clean the log-dirty state between live iterations.  Where Xen supports it,
+ * fetch the dirty pages as a list of ranges, so neither Xen nor we have to
+ * walk the whole bitmap when only a little of the guest is being dirtied.
+ */
+#define DIRTY_RANGES_PER_CALL 4096
+static int clean_logdirty(struct xc_sr_context *ctx,
+                          xc_shadow_op_stats_t *stats)
+{
+    xc_interface *xch = ctx->xch;
+    xc_shadow_op_range_t *list;
+    unsigned long dirty = 0;
+    unsigned int nr, i;
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(xc_shadow_op_range_t, ranges,
+                                    &ctx->save.dirty_ranges_hbuf);
+
+    ctx->save.nr_dirty_ranges = 0;
+
+    while ( !ctx->save.no_dirty_ranges )
+    {
+        nr = DIRTY_RANGES_PER_CALL;
+        rc = xc_shadow_control_ranges(
+            xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
+            HYPERCALL_BUFFER(ranges), &nr, ctx->save.p2m_size, 0,
+            ctx->save.nr_dirty_ranges ? NULL : stats);
+        if ( rc < 0 )
+        {
+            if ( errno == EINVAL && !ctx->save.nr_dirty_ranges )
+            {
+                DPRINTF("Dirty ranges unavailable, using the bitmap");
+                ctx->save.no_dirty_ranges = true;
+                break;
+            }
+
+            PERROR("Failed to retrieve logdirty ranges");
+            return -1;
+        }
+
+        if ( ctx->save.nr_dirty_ranges + nr > ctx->save.max_dirty_ranges )
+        {
+            unsigned int max = ctx->save.max_dirty_ranges * 2 +
+                DIRTY_RANGES_PER_CALL;
+
+            list = realloc(ctx->save.dirty_ranges, max * sizeof(*list));
+            if ( !list )
+            {
+                ERROR("Unable to allocate memory for %u dirty ranges", max);
+                return -1;
+            }
+
+            ctx->save.dirty_ranges = list;
+            ctx->save.max_dirty_ranges = max;
+        }
+
+        memcpy(&ctx->save.dirty_ranges[ctx->save.nr_dirty_ranges], ranges,
+               nr * sizeof(*ranges));
+        ctx->save.nr_dirty_ranges += nr;
+
+        /* A full list means Xen stopped early; go round for the rest. */
+        if ( nr < DIRTY_RANGES_PER_CALL )
+        {
+            for ( i = 0; i < ctx->save.nr_dirty_ranges; ++i )
+                dirty += ctx->save.dirty_ranges[i].nr;
+
+            stats->dirty_count = dirty;
+            ctx->save.dirty_ranges_valid = true;
+
+            return 0;
+        }
+    }
+
+    if ( xc_shadow_control(
+             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
+             &ctx->save.dirty_bitmap_hbuf, ctx->save.p2m_size,
+             NULL, 0, stats) != ctx->save.p2m_size )
+    {
+        PERROR("Failed to retrieve logdirty bitmap");
+        return -1;
+    }
+
+    return 0;
+}
+
+static int enable_logdirty(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    int on1 = 0, off = 0, on2 = 0;
+    int rc;
+
+    /* This juggling is required if logdirty is enabled for VRAM tracking. */
+    rc = xc_shadow_control(xch, ctx->domid,
+                           XEN_DOMCTL_SHADOW_OP_ENABLE_LOGDIRTY,
+                           NULL, 0, NULL, 0, NULL);
+    if ( rc < 0 )
+    {
+        on1 = errno;
+        rc = xc_shadow_control(xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_OFF,
+                               NULL, 0, NULL, 0, NULL);
+        if ( rc < 0 )
+            off = errno;
+        else {
+            rc = xc_shadow_control(xch, ctx->domid,
+                                   XEN_DOMCTL_SHADOW_OP_ENABLE_LOGDIRTY,
+                                   NULL, 0, NULL, 0, NULL);
+            if ( rc < 0 )
+                on2 = errno;
+        }
+        if ( rc < 0 )
+        {
+            PERROR("Failed to enable logdirty: %d,%d,%d", on1, off, on2);
+            return rc;
+        }
+    }
+
+    return 0;
+}
+
+static int update_progress_string(struct xc_sr_context *ctx, char **str)
+{
+    xc_interface *xch = ctx->xch;
+    char *new_str = NULL;
+    unsigned int iter = ctx->save.stats.iteration;
+
+    if ( asprintf(&new_str, "Frames iteration %u", iter) == -1 )
+    {
+        PERROR("Unable to allocate new progress string");
+        return -1;
+    }
+
+    free(*str);
+    *str = new_str;
+
+    xc_set_progress_prefix(xch, *str);
+    return 0;
+}
+
+/*
+ * Auto-converge.  A guest which dirties its memory at least as fast as it
+ * can be sent never converges, and is eventually stopped with most of its
+ * memory still dirty, for a long downtime.  Once an iteration's dirty pages
+ * exceed half of those sent in it, twice in a row, the guest's vcpus are
+ * throttled through a scheduler cap: to 80% of their previous allowance at
+ * first, and a further 10% each time the condition recurs, but never below
+ * 1%.  Only the credit and credit2 schedulers implement caps.
+ */
+#define AC_THROTTLE_INITIAL    20
+#define AC_THROTTLE_INCREMENT  10
+#define AC_THROTTLE_MAX        99
+#define AC_HOT_ITERATIONS       2
+
+static int set_sched_cap(struct xc_sr_context *ctx, uint16_t cap)
+{
+    switch ( ctx->save.sched_id )
+    {
+    case XEN_SCHEDULER_CREDIT:
+    {
+        struct xen_domctl_sched_credit sdom = { .cap = cap };
+
+        return xc_sched_credit_domain_set(ctx->xch, ctx->domid, &sdom);
+    }
+
+    case XEN_SCHEDULER_CREDIT2:
+    {
+        struct xen_domctl_sched_credit2 sdom = { .cap = cap };
+
+        return xc_sched_credit2_domain_set(ctx->xch, ctx->domid, &sdom);
+    }
+
+    default:
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+}
+
+/* Find the domain's scheduler and the cap to restore afterwards. */
+static int throttle_init(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    xc_cpupoolinfo_t *pool;
+    int rc = -1;
+
+    pool = xc_cpupool_getinfo(xch, ctx->dominfo.cpupool);
+    if ( !pool || pool->cpupool_id != ctx->dominfo.cpupool )
+    {
+        PERROR("Unable to find cpupool %u", ctx->dominfo.cpupool);
+        goto out;
+    }
+
+    ctx->save.sched_id = pool->sched_id;
+
+    switch ( ctx->save.sched_id )
+    {
+    case XEN_SCHEDULER_CREDIT:
+    {
+        struct xen_domctl_sched_credit sdom;
+
+        rc = xc_sched_credit_domain_get(xch, ctx->domid, &sdom);
+        ctx->save.sched_cap = sdom.cap;
+        break;
+    }
+
+    case XEN_SCHEDULER_CREDIT2:
+    {
+        struct xen_domctl_sched_credit2 sdom;
+
+        rc = xc_sched_credit2_domain_get(xch, ctx->domid, &sdom);
+        ctx->save.sched_cap = sdom.cap;
+        break;
+    }
+
+    default:
+        DPRINTF("Scheduler %u has no caps, not auto-converging",
+                ctx->save.sched_id);
+        ctx->save.auto_converge = false;
+        rc = 0;
+        goto out;
+    }
+
+    if ( rc )
+        PERROR("Unable to get scheduling parameters");
+
+ out:
+    if ( pool )
+        xc_cpupool_infofree(xch, pool);
+    return rc;
+}
+
+/*
+ * Called at the end of each live iteration, with the number of pages sent
+ * in it and the number dirtied meanwhile.
+ */
+static void throttle_update(struct xc_sr_context *ctx, unsigned long sent,
+                            unsigned long dirtied)
+{
+    xc_interface *xch = ctx->xch;
+    unsigned int nr_vcpus = ctx->dominfo.max_vcpu_id + 1;
+    unsigned int pct, base, cap;
+
+    if ( !ctx->save.auto_converge )
+        return;
+
+    if ( dirtied <= sent / 2 )
+    {
+        ctx->save.throttle_hot_iters = 0;
+        return;
+    }
+
+    if ( ++ctx->save.throttle_hot_iters < AC_HOT_ITERATIONS ||
+         ctx->save.throttle_pct == AC_THROTTLE_MAX )
+        return;
+
+    ctx->save.throttle_hot_iters = 0;
+    pct = ctx->save.throttle_pct
+        ? ctx->save.throttle_pct + AC_THROTTLE_INCREMENT
+        : AC_THROTTLE_INITIAL;
+    pct = min(pct, AC_THROTTLE_MAX + 0U);
+
+    base = ctx->save.sched_cap ?: 100 * nr_vcpus;
+    cap = max(base * (100 - pct) / 100, 1U);
+
+    if ( set_sched_cap(ctx, cap) )
+    {
+        PERROR("Unable to throttle domain, not auto-converging");
+        ctx->save.auto_converge = false;
+        return;
+    }
+
+    DPRINTF("Dirtied %lu of %lu pages sent, throttling vcpus by %u%% (cap %u)",
+            dirtied, sent, pct, cap);
+    ctx->save.throttle_pct = pct;
 }
 
-static int update_progress_string(struct xc_sr_context *ctx, char **str)
+static void throttle_release(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    char *new_str = NULL;
-    unsigned int iter = ctx->save.stats.iteration;
 
-    if ( asprintf(&new_str, "Frames iteration %u", iter) == -1 )
-    {
-        PERROR("Unable to allocate new progress string");
-        return -1;
-    }
+    if ( !ctx->save.throttle_pct )
+        return;
 
-    free(*str);
-    *str = new_str;
+    if ( set_sched_cap(ctx, ctx->save.sched_cap) )
+        PERROR("Unable to restore scheduler cap %u", ctx->save.sched_cap);
 
-    xc_set_progress_prefix(xch, *str);
-    return 0;
+    ctx->save.throttle_pct = 0;
 }
 
 /*
@@ -494,6 +1354,27 @@ static int simple_precopy_policy(struct precopy_stats stats, void *user)
         : XGS_POLICY_CONTINUE_PRECOPY;
 }
 
+/*
+ * With auto-converge, keep iterating past SPP_MAX_ITERATIONS for as long as
+ * the throttle can still be tightened, up to SPP_AC_MAX_ITERATIONS.
+ */
+#define SPP_AC_MAX_ITERATIONS  30
+
+static int auto_converge_precopy_policy(struct precopy_stats stats,
+                                        void *user)
+{
+    struct xc_sr_context *ctx = user;
+
+    return ((stats.dirty_count >= 0 &&
+             stats.dirty_count < SPP_TARGET_DIRTY_COUNT) ||
+            (stats.iteration >= SPP_MAX_ITERATIONS &&
+             (!ctx->save.auto_converge ||
+              ctx->save.throttle_pct == AC_THROTTLE_MAX)) ||
+            stats.iteration >= SPP_AC_MAX_ITERATIONS)
+        ? XGS_POLICY_STOP_AND_COPY
+        : XGS_POLICY_CONTINUE_PRECOPY;
+}
+
 /*
  * Send memory while guest is running.
  */
@@ -503,6 +1384,7 @@ static int send_memory_live(struct xc_sr_context *ctx)
     xc_shadow_op_stats_t stats = { 0, ctx->save.p2m_size };
     char *progress_str = NULL;
     unsigned int x = 0;
+    unsigned long sent;
     int rc;
     int policy_decision;
 
@@ -523,8 +1405,23 @@ static int send_memory_live(struct xc_sr_context *ctx)
     };
     policy_stats = &ctx->save.stats;
 
+    if ( ctx->save.auto_converge )
+    {
+        rc = throttle_init(ctx);
+        if ( rc )
+            goto out;
+    }
+
     if ( precopy_policy == NULL )
-        precopy_policy = simple_precopy_policy;
+    {
+        if ( ctx->save.auto_converge )
+        {
+            precopy_policy = auto_converge_precopy_policy;
+            data = ctx;
+        }
+        else
+            precopy_policy = simple_precopy_policy;
+    }
 
     bitmap_set(dirty_bitmap, ctx->save.p2m_size);
 
@@ -544,157 +1441,457 @@ static int send_memory_live(struct xc_sr_context *ctx)
                 goto out;
         }
 
-        if ( policy_decision != XGS_POLICY_CONTINUE_PRECOPY )
-            break;
+        if ( policy_decision != XGS_POLICY_CONTINUE_PRECOPY )
+            break;
+
+        policy_stats->iteration     = x;
+        policy_stats->total_written += policy_stats->dirty_count;
+        policy_stats->dirty_count   = -1;
+
+        policy_decision = precopy_policy(*policy_stats, data);
+
+        if ( policy_decision != XGS_POLICY_CONTINUE_PRECOPY )
+            break;
+
+        sent = stats.dirty_count;
+        rc = clean_logdirty(ctx, &stats);
+        if ( rc )
+            goto out;
+
+        throttle_update(ctx, sent, stats.dirty_count);
+        policy_stats->dirty_count = stats.dirty_count;
+
+    }
+
+    /* The final pass always uses the bitmap. */
+    ctx->save.dirty_ranges_valid = false;
+
+    if ( policy_decision == XGS_POLICY_ABORT )
+    {
+        PERROR("Abort precopy loop");
+        rc = -1;
+        goto out;
+    }
+
+ out:
+    /* The guest is about to be suspended, or the migration abandoned. */
+    throttle_release(ctx);
+    xc_set_progress_prefix(xch, NULL);
+    free(progress_str);
+    return rc;
+}
+
+static int colo_merge_secondary_dirty_bitmap(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_record rec;
+    uint64_t *pfns = NULL;
+    uint64_t pfn;
+    unsigned int count, i;
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    rc = read_record(ctx, ctx->save.recv_fd, &rec);
+    if ( rc )
+        goto err;
+
+    if ( rec.type != REC_TYPE_CHECKPOINT_DIRTY_PFN_LIST )
+    {
+        PERROR("Expect dirty bitmap record, but received %u", rec.type);
+        rc = -1;
+        goto err;
+    }
+
+    if ( rec.length % sizeof(*pfns) )
+    {
+        PERROR("Invalid dirty pfn list record length %u", rec.length);
+        rc = -1;
+        goto err;
+    }
+
+    count = rec.length / sizeof(*pfns);
+    pfns = rec.data;
+
+    for ( i = 0; i < count; i++ )
+    {
+        pfn = pfns[i];
+        if ( pfn > ctx->save.p2m_size )
+        {
+            PERROR("Invalid pfn 0x%" PRIx64, pfn);
+            rc = -1;
+            goto err;
+        }
+
+        set_bit(pfn, dirty_bitmap);
+    }
+
+    rc = 0;
+
+ err:
+    free(rec.data);
+    return rc;
+}
+
+/*
+ * Suspend the domain and send dirty memory.
+ * This is the last iteration of the live migration and the
+ * heart of the checkpointed stream.
+ */
+static int suspend_and_send_dirty(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    xc_shadow_op_stats_t stats = { 0, ctx->save.p2m_size };
+    char *progress_str = NULL;
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    rc = suspend_domain(ctx);
+    if ( rc )
+        goto out;
+
+    if ( xc_shadow_control(
+             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
+             HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
+             NULL, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats) !=
+         ctx->save.p2m_size )
+    {
+        PERROR("Failed to retrieve logdirty bitmap");
+        rc = -1;
+        goto out;
+    }
+
+    if ( ctx->save.live )
+    {
+        rc = update_progress_string(ctx, &progress_str);
+        if ( rc )
+            goto out;
+    }
+    else
+        xc_set_progress_prefix(xch, "Checkpointed save");
+
+    bitmap_or(dirty_bitmap, ctx->save.deferred_pages, ctx->save.p2m_size);
+
+    if ( !ctx->save.live && ctx->stream_type == XC_STREAM_COLO )
+    {
+        rc = colo_merge_secondary_dirty_bitmap(ctx);
+        if ( rc )
+        {
+            PERROR("Failed to get secondary vm's dirty pages");
+            goto out;
+        }
+    }
+
+    rc = send_dirty_pages(ctx, stats.dirty_count + ctx->save.nr_deferred_pages);
+    if ( rc )
+        goto out;
+
+    bitmap_clear(ctx->save.deferred_pages, ctx->save.p2m_size);
+    ctx->save.nr_deferred_pages = 0;
+
+ out:
+    xc_set_progress_prefix(xch, NULL);
+    free(progress_str);
+    return rc;
+}
+
+/*
+ * Announce the outstanding post-copy pages to the destination, as a series
+ * of POSTCOPY_PFNS records.
+ */
+#define POSTCOPY_PFNS_PER_RECORD 1024
+static int write_postcopy_pfns(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_rec_postcopy_pfns *hdr;
+    struct xc_sr_record rec = { .type = REC_TYPE_POSTCOPY_PFNS };
+    xen_pfn_t p;
+    int rc = 0;
+
+    hdr = malloc(sizeof(*hdr) +
+                 POSTCOPY_PFNS_PER_RECORD * sizeof(*hdr->pfn));
+    if ( !hdr )
+    {
+        ERROR("Unable to allocate memory for postcopy pfns");
+        return -1;
+    }
+
+    rec.data = hdr;
+    hdr->count = 0;
+    hdr->_res1 = 0;
+    ctx->save.nr_postcopy_pfns = 0;
+
+    for ( p = 0; p < ctx->save.p2m_size; ++p )
+    {
+        if ( !test_bit(p, ctx->save.postcopy_pfns) )
+            continue;
+
+        hdr->pfn[hdr->count++] = p;
+        ctx->save.nr_postcopy_pfns++;
+
+        if ( hdr->count == POSTCOPY_PFNS_PER_RECORD )
+        {
+            rec.length = sizeof(*hdr) + hdr->count * sizeof(*hdr->pfn);
+            rc = write_record(ctx, &rec);
+            if ( rc )
+                goto out;
+
+            hdr->count = 0;
+        }
+    }
+
+    if ( hdr->count )
+    {
+        rec.length = sizeof(*hdr) + hdr->count * sizeof(*hdr->pfn);
+        rc = write_record(ctx, &rec);
+    }
+
+ out:
+    free(hdr);
+    return rc;
+}
+
+/*
+ * Suspend the domain, but rather than sending the final dirty pages, record
+ * them as outstanding and announce them to the destination.  They are sent
+ * by send_postcopy_pages() once the vcpu state is in the stream.
+ */
+static int suspend_and_defer_dirty(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    xc_shadow_op_stats_t stats = { 0, ctx->save.p2m_size };
+    int rc;
+    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
+                                    &ctx->save.dirty_bitmap_hbuf);
+
+    rc = suspend_domain(ctx);
+    if ( rc )
+        return rc;
+
+    if ( xc_shadow_control(
+             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
+             HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
+             NULL, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats) !=
+         ctx->save.p2m_size )
+    {
+        PERROR("Failed to retrieve logdirty bitmap");
+        return -1;
+    }
+
+    bitmap_or(dirty_bitmap, ctx->save.deferred_pages, ctx->save.p2m_size);
+    memcpy(ctx->save.postcopy_pfns, dirty_bitmap,
+           bitmap_size(ctx->save.p2m_size));
+
+    bitmap_clear(ctx->save.deferred_pages, ctx->save.p2m_size);
+    ctx->save.nr_deferred_pages = 0;
+
+    rc = write_postcopy_pfns(ctx);
+    if ( rc )
+        return rc;
+
+    IPRINTF("Deferred %lu pages to post-copy", ctx->save.nr_postcopy_pfns);
+
+    return 0;
+}
+
+/*
+ * Suspend the domain, and defer all of its memory to the post-copy phase, so
+ * the destination (typically restoring from a file) can resume the guest
+ * as soon as its state has arrived, and load memory behind it.  Broken and
+ * allocate-only pages carry no data, and are sent up front.
+ */
+static int suspend_and_defer_all(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    xen_pfn_t p, *types;
+    unsigned int i, nr;
+    int rc;
+
+    rc = suspend_domain(ctx);
+    if ( rc )
+        return rc;
 
-        policy_stats->iteration     = x;
-        policy_stats->total_written += policy_stats->dirty_count;
-        policy_stats->dirty_count   = -1;
+    types = malloc(MAX_BATCH_SIZE * sizeof(*types));
+    if ( !types )
+    {
+        ERROR("Unable to allocate memory for pfn types");
+        return -1;
+    }
 
-        policy_decision = precopy_policy(*policy_stats, data);
+    for ( p = 0; p < ctx->save.p2m_size; p += nr )
+    {
+        nr = min_t(xen_pfn_t, MAX_BATCH_SIZE, ctx->save.p2m_size - p);
 
-        if ( policy_decision != XGS_POLICY_CONTINUE_PRECOPY )
-            break;
+        for ( i = 0; i < nr; ++i )
+            types[i] = ctx->save.ops.pfn_to_gfn(ctx, p + i);
 
-        if ( xc_shadow_control(
-                 xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
-                 &ctx->save.dirty_bitmap_hbuf, ctx->save.p2m_size,
-                 NULL, 0, &stats) != ctx->save.p2m_size )
+        rc = xc_get_pfn_type_batch(xch, ctx->domid, nr, types);
+        if ( rc )
         {
-            PERROR("Failed to retrieve logdirty bitmap");
-            rc = -1;
+            PERROR("Failed to get types for pfns %#"PRIpfn"-%#"PRIpfn,
+                   p, p + nr - 1);
             goto out;
         }
 
-        policy_stats->dirty_count = stats.dirty_count;
+        for ( i = 0; i < nr; ++i )
+        {
+            switch ( types[i] )
+            {
+            case XEN_DOMCTL_PFINFO_XTAB:
+                continue;
+
+            case XEN_DOMCTL_PFINFO_BROKEN:
+            case XEN_DOMCTL_PFINFO_XALLOC:
+                rc = add_to_batch(ctx, p + i);
+                if ( rc )
+                    goto out;
+                continue;
+            }
 
+            set_bit(p + i, ctx->save.postcopy_pfns);
+        }
     }
 
-    if ( policy_decision == XGS_POLICY_ABORT )
-    {
-        PERROR("Abort precopy loop");
-        rc = -1;
+    rc = flush_batch(ctx);
+    if ( rc )
+        goto out;
+
+    rc = write_postcopy_pfns(ctx);
+    if ( rc )
         goto out;
-    }
+
+    IPRINTF("Deferred %lu pages to post-copy", ctx->save.nr_postcopy_pfns);
 
  out:
-    xc_set_progress_prefix(xch, NULL);
-    free(progress_str);
+    free(types);
     return rc;
 }
 
-static int colo_merge_secondary_dirty_bitmap(struct xc_sr_context *ctx)
+/*
+ * Handle a POSTCOPY_FAULT record from the destination, sending any of the
+ * faulted pages which are still outstanding.
+ */
+static int handle_postcopy_fault(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
     struct xc_sr_record rec;
-    uint64_t *pfns = NULL;
-    uint64_t pfn;
-    unsigned int count, i;
+    struct xc_sr_rec_postcopy_pfns *fault;
+    unsigned int i;
     int rc;
-    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
-                                    &ctx->save.dirty_bitmap_hbuf);
 
     rc = read_record(ctx, ctx->save.recv_fd, &rec);
     if ( rc )
-        goto err;
+        return rc;
 
-    if ( rec.type != REC_TYPE_CHECKPOINT_DIRTY_PFN_LIST )
+    rc = -1;
+    fault = rec.data;
+
+    if ( rec.type != REC_TYPE_POSTCOPY_FAULT )
     {
-        PERROR("Expect dirty bitmap record, but received %u", rec.type);
-        rc = -1;
-        goto err;
+        ERROR("Unexpected %s record on the backchannel",
+              rec_type_to_str(rec.type));
+        goto out;
     }
 
-    if ( rec.length % sizeof(*pfns) )
+    if ( rec.length < sizeof(*fault) ||
+         rec.length != sizeof(*fault) + fault->count * sizeof(*fault->pfn) )
     {
-        PERROR("Invalid dirty pfn list record length %u", rec.length);
-        rc = -1;
-        goto err;
+        ERROR("POSTCOPY_FAULT record wrong size: length %u", rec.length);
+        goto out;
     }
 
-    count = rec.length / sizeof(*pfns);
-    pfns = rec.data;
-
-    for ( i = 0; i < count; i++ )
+    for ( i = 0; i < fault->count; ++i )
     {
-        pfn = pfns[i];
-        if ( pfn > ctx->save.p2m_size )
+        if ( fault->pfn[i] >= ctx->save.p2m_size )
         {
-            PERROR("Invalid pfn 0x%" PRIx64, pfn);
-            rc = -1;
-            goto err;
+            ERROR("Fault on pfn %#"PRIx64" beyond p2m_size %#lx",
+                  fault->pfn[i], ctx->save.p2m_size);
+            goto out;
         }
 
-        set_bit(pfn, dirty_bitmap);
+        /* Already sent, and the destination will see it shortly. */
+        if ( !test_and_clear_bit(fault->pfn[i], ctx->save.postcopy_pfns) )
+            continue;
+
+        ctx->save.nr_postcopy_pfns--;
+
+        rc = add_to_batch(ctx, fault->pfn[i]);
+        if ( rc )
+            goto out;
     }
 
-    rc = 0;
+    rc = flush_batch(ctx);
 
- err:
+ out:
     free(rec.data);
     return rc;
 }
 
 /*
- * Suspend the domain and send dirty memory.
- * This is the last iteration of the live migration and the
- * heart of the checkpointed stream.
+ * Post-copy phase.  The destination is running the guest, and faulting on
+ * the outstanding pages.  Pages are sent as soon as they are requested, and
+ * the rest are streamed in the background whenever no request is pending.
  */
-static int suspend_and_send_dirty(struct xc_sr_context *ctx)
+static int send_postcopy_pages(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    xc_shadow_op_stats_t stats = { 0, ctx->save.p2m_size };
-    char *progress_str = NULL;
+    struct xc_sr_record rec = { .type = REC_TYPE_POSTCOPY_TRANSITION };
+    struct pollfd pfd = { .fd = ctx->save.recv_fd, .events = POLLIN };
+    unsigned long total = ctx->save.nr_postcopy_pfns;
+    xen_pfn_t p = 0;
     int rc;
-    DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
-                                    &ctx->save.dirty_bitmap_hbuf);
 
-    rc = suspend_domain(ctx);
+    rc = write_record(ctx, &rec);
     if ( rc )
-        goto out;
+        return rc;
 
-    if ( xc_shadow_control(
-             xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_CLEAN,
-             HYPERCALL_BUFFER(dirty_bitmap), ctx->save.p2m_size,
-             NULL, XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL, &stats) !=
-         ctx->save.p2m_size )
-    {
-        PERROR("Failed to retrieve logdirty bitmap");
-        rc = -1;
-        goto out;
-    }
+    xc_set_progress_prefix(xch, "Post-copy");
 
-    if ( ctx->save.live )
+    while ( ctx->save.nr_postcopy_pfns )
     {
-        rc = update_progress_string(ctx, &progress_str);
-        if ( rc )
+        /* Without a backchannel, just stream the pages in order. */
+        rc = (pfd.fd < 0) ? 0 : poll(&pfd, 1, 0);
+        if ( rc < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            PERROR("Failed to poll the backchannel");
             goto out;
-    }
-    else
-        xc_set_progress_prefix(xch, "Checkpointed save");
+        }
 
-    bitmap_or(dirty_bitmap, ctx->save.deferred_pages, ctx->save.p2m_size);
+        if ( rc > 0 )
+        {
+            rc = handle_postcopy_fault(ctx);
+            if ( rc )
+                goto out;
 
-    if ( !ctx->save.live && ctx->stream_type == XC_STREAM_COLO )
-    {
-        rc = colo_merge_secondary_dirty_bitmap(ctx);
-        if ( rc )
+            continue;
+        }
+
+        for ( ; p < ctx->save.p2m_size &&
+                  ctx->save.nr_batch_pfns < MAX_BATCH_SIZE; ++p )
         {
-            PERROR("Failed to get secondary vm's dirty pages");
-            goto out;
+            if ( !test_and_clear_bit(p, ctx->save.postcopy_pfns) )
+                continue;
+
+            ctx->save.nr_postcopy_pfns--;
+            ctx->save.batch_pfns[ctx->save.nr_batch_pfns++] = p;
         }
-    }
 
-    rc = send_dirty_pages(ctx, stats.dirty_count + ctx->save.nr_deferred_pages);
-    if ( rc )
-        goto out;
+        rc = flush_batch(ctx);
+        if ( rc )
+            goto out;
 
-    bitmap_clear(ctx->save.deferred_pages, ctx->save.p2m_size);
-    ctx->save.nr_deferred_pages = 0;
+        xc_report_progress_step(xch, total - ctx->save.nr_postcopy_pfns,
+                                total);
+    }
+
+    rc = pipeline_drain(ctx);
 
  out:
     xc_set_progress_prefix(xch, NULL);
-    free(progress_str);
     return rc;
 }
 
@@ -733,6 +1930,72 @@ static int verify_frames(struct xc_sr_context *ctx)
     return rc;
 }
 
+/*
+ * Switch the page data over to the auxiliary streams, if there are any, by
+ * writing a STREAM_FORK record into the main stream.
+ */
+static int fork_streams(struct xc_sr_context *ctx)
+{
+    struct xc_sr_rec_stream_fork fork = {
+        .count = ctx->save.nr_aux_fds,
+    };
+    struct xc_sr_record rec = {
+        .type = REC_TYPE_STREAM_FORK,
+        .length = sizeof(fork),
+        .data = &fork,
+    };
+    int rc;
+
+    if ( !ctx->save.nr_aux_fds )
+        return 0;
+
+    rc = flush_batch(ctx) ?: pipeline_drain(ctx);
+    if ( rc )
+        return rc;
+
+    rc = write_record(ctx, &rec);
+    if ( rc )
+        return rc;
+
+    ctx->save.streams_forked = true;
+
+    return 0;
+}
+
+/*
+ * Switch the page data back to the main stream.  Every auxiliary stream is
+ * terminated with an END record, after which a STREAM_JOIN record in the
+ * main stream tells the restorer it has seen all of their page data.
+ */
+static int join_streams(struct xc_sr_context *ctx)
+{
+    xc_interface *xch = ctx->xch;
+    struct xc_sr_rhdr end = { .type = REC_TYPE_END };
+    struct xc_sr_record rec = { .type = REC_TYPE_STREAM_JOIN };
+    unsigned int i;
+    int rc;
+
+    if ( !ctx->save.streams_forked )
+        return 0;
+
+    rc = flush_batch(ctx) ?: pipeline_drain(ctx);
+    if ( rc )
+        return rc;
+
+    ctx->save.streams_forked = false;
+
+    for ( i = 0; i < ctx->save.nr_aux_fds; ++i )
+    {
+        if ( write_exact(ctx->save.aux_fds[i], &end, sizeof(end)) )
+        {
+            PERROR("Unable to write END record to auxiliary stream %u", i);
+            return -1;
+        }
+    }
+
+    return write_record(ctx, &rec);
+}
+
 /*
  * Send all domain memory.  This is the heart of the live migration loop.
  */
@@ -744,11 +2007,23 @@ static int send_domain_memory_live(struct xc_sr_context *ctx)
     if ( rc )
         goto out;
 
+    rc = fork_streams(ctx);
+    if ( rc )
+        goto out;
+
     rc = send_memory_live(ctx);
     if ( rc )
         goto out;
 
-    rc = suspend_and_send_dirty(ctx);
+    /* The final, paused, iteration is small; use just the main stream. */
+    rc = join_streams(ctx);
+    if ( rc )
+        goto out;
+
+    if ( ctx->save.postcopy )
+        rc = suspend_and_defer_dirty(ctx);
+    else
+        rc = suspend_and_send_dirty(ctx);
     if ( rc )
         goto out;
 
@@ -780,6 +2055,9 @@ static int send_domain_memory_nonlive(struct xc_sr_context *ctx)
     xc_interface *xch = ctx->xch;
     int rc;
 
+    if ( ctx->save.postcopy )
+        return suspend_and_defer_all(ctx);
+
     rc = suspend_domain(ctx);
     if ( rc )
         goto err;
@@ -797,21 +2075,30 @@ static int send_domain_memory_nonlive(struct xc_sr_context *ctx)
 static int setup(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
+    struct stat st;
+    unsigned int i;
     int rc;
     DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
                                     &ctx->save.dirty_bitmap_hbuf);
+    DECLARE_HYPERCALL_BUFFER_SHADOW(xc_shadow_op_range_t, dirty_ranges,
+                                    &ctx->save.dirty_ranges_hbuf);
 
     rc = ctx->save.ops.setup(ctx);
     if ( rc )
         goto err;
 
+    ctx->save.discard_cache = !fstat(ctx->fd, &st) && S_ISREG(st.st_mode);
+
     dirty_bitmap = xc_hypercall_buffer_alloc_pages(
         xch, dirty_bitmap, NRPAGES(bitmap_size(ctx->save.p2m_size)));
     ctx->save.batch_pfns = malloc(MAX_BATCH_SIZE *
                                   sizeof(*ctx->save.batch_pfns));
+    dirty_ranges = xc_hypercall_buffer_alloc(
+        xch, dirty_ranges, DIRTY_RANGES_PER_CALL * sizeof(*dirty_ranges));
     ctx->save.deferred_pages = bitmap_alloc(ctx->save.p2m_size);
 
-    if ( !ctx->save.batch_pfns || !dirty_bitmap || !ctx->save.deferred_pages )
+    if ( !ctx->save.batch_pfns || !dirty_bitmap || !dirty_ranges ||
+         !ctx->save.deferred_pages )
     {
         ERROR("Unable to allocate memory for dirty bitmaps, batch pfns and"
               " deferred pages");
@@ -820,6 +2107,75 @@ static int setup(struct xc_sr_context *ctx)
         goto err;
     }
 
+    if ( ctx->save.postcopy )
+    {
+        ctx->save.postcopy_pfns = bitmap_alloc(ctx->save.p2m_size);
+        if ( !ctx->save.postcopy_pfns )
+        {
+            ERROR("Unable to allocate memory for postcopy pfns");
+            rc = -1;
+            errno = ENOMEM;
+            goto err;
+        }
+    }
+
+    if ( ctx->save.pipelined )
+    {
+        ctx->save.pipeline = pipeline_start(ctx, ctx->fd);
+        if ( !ctx->save.pipeline )
+        {
+            rc = -1;
+            goto err;
+        }
+    }
+
+    if ( ctx->save.nr_aux_fds )
+    {
+        ctx->save.aux_streams = calloc(ctx->save.nr_aux_fds,
+                                       sizeof(*ctx->save.aux_streams));
+        if ( !ctx->save.aux_streams )
+        {
+            ERROR("Unable to allocate auxiliary streams");
+            rc = -1;
+            goto err;
+        }
+
+        for ( i = 0; i < ctx->save.nr_aux_fds; ++i )
+        {
+            struct xc_sr_save_aux_stream *aux = &ctx->save.aux_streams[i];
+
+            aux->batch_pfns = malloc(MAX_BATCH_SIZE *
+                                     sizeof(*aux->batch_pfns));
+            if ( !aux->batch_pfns )
+            {
+                ERROR("Unable to allocate auxiliary stream batch pfns");
+                rc = -1;
+                goto err;
+            }
+
+            aux->pipeline = pipeline_start(ctx, ctx->save.aux_fds[i]);
+            if ( !aux->pipeline )
+            {
+                rc = -1;
+                goto err;
+            }
+        }
+    }
+
+    if ( ctx->save.compress )
+    {
+        ctx->save.zstream = calloc(1, sizeof(*ctx->save.zstream));
+        if ( !ctx->save.zstream ||
+             deflateInit(ctx->save.zstream, Z_BEST_SPEED) != Z_OK )
+        {
+            ERROR("Unable to initialise page compression");
+            free(ctx->save.zstream);
+            ctx->save.zstream = NULL;
+            rc = -1;
+            goto err;
+        }
+    }
+
     rc = 0;
 
  err:
@@ -829,9 +2185,26 @@ static int setup(struct xc_sr_context *ctx)
 static void cleanup(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
+    unsigned int i;
     DECLARE_HYPERCALL_BUFFER_SHADOW(unsigned long, dirty_bitmap,
                                     &ctx->save.dirty_bitmap_hbuf);
 
+    pipeline_stop(ctx->save.pipeline);
+    ctx->save.pipeline = NULL;
+
+    for ( i = 0; ctx->save.aux_streams && i < ctx->save.nr_aux_fds; ++i )
+    {
+        pipeline_stop(ctx->save.aux_streams[i].pipeline);
+        free(ctx->save.aux_streams[i].batch_pfns);
+    }
+    free(ctx->save.aux_streams);
+    ctx->save.aux_streams = NULL;
+
+    if ( ctx->save.zstream )
+    {
+        deflateEnd(ctx->save.zstream);
+        free(ctx->save.zstream);
+    }
 
     xc_shadow_control(xch, ctx->domid, XEN_DOMCTL_SHADOW_OP_OFF,
                       NULL, 0, NULL, 0, NULL);
@@ -841,6 +2214,9 @@ static void cleanup(struct xc_sr_context *ctx)
 
     xc_hypercall_buffer_free_pages(xch, dirty_bitmap,
                                    NRPAGES(bitmap_size(ctx->save.p2m_size)));
+    xc__hypercall_buffer_free(xch, &ctx->save.dirty_ranges_hbuf);
+    free(ctx->save.dirty_ranges);
+    free(ctx->save.postcopy_pfns);
     free(ctx->save.deferred_pages);
     free(ctx->save.batch_pfns);
 }
@@ -909,6 +2285,13 @@ static int save(struct xc_sr_context *ctx, uint16_t guest_type)
         if ( rc )
             goto err;
 
+        if ( ctx->save.postcopy )
+        {
+            rc = send_postcopy_pages(ctx);
+            if ( rc )
+                goto err;
+        }
+
         if ( ctx->stream_type != XC_STREAM_PLAIN )
         {
             /*
@@ -964,6 +2347,9 @@ static int save(struct xc_sr_context *ctx, uint16_t guest_type)
     if ( rc )
         goto err;
 
+    if ( ctx->save.discard_cache )
+        discard_file_cache(xch, ctx->fd, 1 /* flush */);
+
     xc_report_progress_single(xch, "Complete");
     goto done;
 
@@ -986,7 +2372,8 @@ static int save(struct xc_sr_context *ctx, uint16_t guest_type)
 
 int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
                    uint32_t flags, struct save_callbacks *callbacks,
-                   xc_stream_type_t stream_type, int recv_fd)
+                   xc_stream_type_t stream_type, int recv_fd,
+                   const int *aux_fds, unsigned int nr_aux_fds)
 {
     struct xc_sr_context ctx = {
         .xch = xch,
@@ -998,7 +2385,13 @@ int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
     ctx.save.callbacks = callbacks;
     ctx.save.live  = !!(flags & XCFLAGS_LIVE);
     ctx.save.debug = !!(flags & XCFLAGS_DEBUG);
+    ctx.save.pipelined = !!(flags & XCFLAGS_PIPELINE);
+    ctx.save.compress = !!(flags & XCFLAGS_COMPRESS);
+    ctx.save.postcopy = !!(flags & XCFLAGS_POSTCOPY);
+    ctx.save.auto_converge = !!(flags & XCFLAGS_AUTO_CONVERGE);
     ctx.save.recv_fd = recv_fd;
+    ctx.save.aux_fds = aux_fds;
+    ctx.save.nr_aux_fds = nr_aux_fds;
 
     if ( xc_domain_getinfo(xch, dom, 1, &ctx.dominfo) != 1 )
     {
@@ -1031,8 +2424,23 @@ int xc_domain_save(xc_interface *xch, int io_fd, uint32_t dom,
         break;
     }
 
-    DPRINTF("fd %d, dom %u, flags %u, hvm %d",
-            io_fd, dom, flags, ctx.dominfo.hvm);
+    if ( ctx.save.postcopy &&
+         (!ctx.dominfo.hvm || stream_type != XC_STREAM_PLAIN) )
+    {
+        ERROR("Post-copy requires a plain HVM stream");
+        errno = EINVAL;
+        return -1;
+    }
+
+    if ( nr_aux_fds && (stream_type != XC_STREAM_PLAIN || ctx.save.postcopy) )
+    {
+        ERROR("Auxiliary streams require a plain, pre-copy stream");
+        errno = EINVAL;
+        return -1;
+    }
+
+    DPRINTF("fd %d (+%u), dom %u, flags %u, hvm %d",
+            io_fd, nr_aux_fds, dom, flags, ctx.dominfo.hvm);
 
     ctx.domid = dom;
 
@@ -6,51 +6,67 @@
 
 /*
  * Query for the HVM context and write an HVM_CONTEXT record into the stream.
+ *
+ * The buffer is kept for the next checkpoint, and only resized (after
+ * querying Xen for the size) when the context no longer fits, saving a
+ * hypercall and an allocation per checkpoint for Remus/COLO.
  */
 static int write_hvm_context(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
-    int rc, hvm_buf_size;
+    struct xc_sr_blob *context = &ctx->x86.hvm.save.context;
+    int hvm_buf_size = -1;
     struct xc_sr_record hvm_rec = {
         .type = REC_TYPE_HVM_CONTEXT,
     };
 
-    hvm_buf_size = xc_domain_hvm_getcontext(xch, ctx->domid, 0, 0);
+    if ( context->ptr )
+        hvm_buf_size = xc_domain_hvm_getcontext(xch, ctx->domid,
+                                                context->ptr, context->size);
+
     if ( hvm_buf_size < 0 )
     {
-        PERROR("Couldn't get HVM context size from Xen");
-        rc = -1;
-        goto out;
-    }
+        if ( context->ptr && errno != ENOSPC )
+        {
+            PERROR("Couldn't get HVM context from Xen");
+            return -1;
+        }
 
-    hvm_rec.data = malloc(hvm_buf_size);
-    if ( !hvm_rec.data )
-    {
-        PERROR("Couldn't allocate memory");
-        rc = -1;
-        goto out;
-    }
+        hvm_buf_size = xc_domain_hvm_getcontext(xch, ctx->domid, 0, 0);
+        if ( hvm_buf_size < 0 )
+        {
+            PERROR("Couldn't get HVM context size from Xen");
+            return -1;
+        }
 
-    hvm_buf_size = xc_domain_hvm_getcontext(xch, ctx->domid,
-                                            hvm_rec.data, hvm_buf_size);
-    if ( hvm_buf_size < 0 )
-    {
-        PERROR("Couldn't get HVM context from Xen");
-        rc = -1;
-        goto out;
+        free(context->ptr);
+        context->size = 0;
+        context->ptr = malloc(hvm_buf_size);
+        if ( !context->ptr )
+        {
+            PERROR("Couldn't allocate memory");
+            return -1;
+        }
+        context->size = hvm_buf_size;
+
+        hvm_buf_size = xc_domain_hvm_getcontext(xch, ctx->domid,
+                                                context->ptr, context->size);
+        if ( hvm_buf_size < 0 )
+        {
+            PERROR("Couldn't get HVM context from Xen");
+            return -1;
+        }
     }
 
+    hvm_rec.data = context->ptr;
     hvm_rec.length = hvm_buf_size;
-    rc = write_record(ctx, &hvm_rec);
-    if ( rc < 0 )
+    if ( write_record(ctx, &hvm_rec) < 0 )
     {
         PERROR("error write HVM_CONTEXT record");
-        goto out;
+        return -1;
     }
 
- out:
-    free(hvm_rec.data);
-    return rc;
+    return 0;
 }
 
 /*
@@ -215,6 +231,10 @@ static int x86_hvm_cleanup(struct xc_sr_context *ctx)
 {
     xc_interface *xch = ctx->xch;
 
+    free(ctx->x86.hvm.save.context.ptr);
+    ctx->x86.hvm.save.context.ptr = NULL;
+    ctx->x86.hvm.save.context.size = 0;
+
     /* If qemu successfully enabled logdirty mode, attempt to disable. */
     if ( ctx->x86.hvm.save.qemu_enabled_logdirty &&
          ctx->save.callbacks->switch_qemu_logdirty(
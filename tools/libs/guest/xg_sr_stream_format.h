@@ -76,6 +76,12 @@ struct xc_sr_rhdr
 #define REC_TYPE_STATIC_DATA_END            0x00000010U
 #define REC_TYPE_X86_CPUID_POLICY           0x00000011U
 #define REC_TYPE_X86_MSR_POLICY             0x00000012U
+#define REC_TYPE_COMPRESSED_PAGE_DATA       0x00000013U
+#define REC_TYPE_POSTCOPY_PFNS              0x00000014U
+#define REC_TYPE_POSTCOPY_TRANSITION        0x00000015U
+#define REC_TYPE_POSTCOPY_FAULT             0x00000016U
+#define REC_TYPE_STREAM_FORK                0x00000017U
+#define REC_TYPE_STREAM_JOIN                0x00000018U
 
 #define REC_TYPE_OPTIONAL             0x80000000U
 
@@ -90,6 +96,42 @@ struct xc_sr_rec_page_data_header
 #define PAGE_DATA_PFN_MASK  0x000fffffffffffffULL
 #define PAGE_DATA_TYPE_MASK 0xf000000000000000ULL
 
+/* COMPRESSED_PAGE_DATA */
+struct xc_sr_rec_compressed_page_data_header
+{
+    uint32_t count;
+    uint16_t compression;
+    uint16_t _res1;
+    uint32_t data_length;
+    uint32_t _res2;
+    uint64_t pfn[0];
+    /* uint32_t encoding[count] follows, then data_length octets of data. */
+};
+
+#define COMPRESSED_PAGE_DATA_NONE   0x0000U
+#define COMPRESSED_PAGE_DATA_ZLIB   0x0001U
+
+#define COMPRESSED_PAGE_ENC_MASK    0x000000ffU
+#define COMPRESSED_PAGE_LITERAL     0x00000000U
+#define COMPRESSED_PAGE_ZERO        0x00000001U
+#define COMPRESSED_PAGE_DUPLICATE   0x00000002U
+#define COMPRESSED_PAGE_REF_SHIFT   8
+
+/* POSTCOPY_{PFNS,FAULT} */
+struct xc_sr_rec_postcopy_pfns
+{
+    uint32_t count;
+    uint32_t _res1;
+    uint64_t pfn[0];
+};
+
+/* STREAM_FORK */
+struct xc_sr_rec_stream_fork
+{
+    uint32_t count;
+    uint32_t _res1;
+};
+
 /* X86_PV_INFO */
 struct xc_sr_rec_x86_pv_info
 {
@@ -443,6 +443,33 @@ int libxl_cpupool_movedomain(libxl_ctx *ctx, uint32_t poolid, uint32_t domid)
     return 0;
 }
 
+int libxl_cpupool_movedomains(libxl_ctx *ctx, uint32_t poolid,
+                              const uint32_t *domids, int nr_doms)
+{
+    GC_INIT(ctx);
+    int rc;
+
+    if (nr_doms < 0) {
+        GC_FREE;
+        return ERROR_INVAL;
+    }
+
+    if (!nr_doms) {
+        GC_FREE;
+        return 0;
+    }
+
+    rc = xc_cpupool_movedomains(ctx->xch, poolid, domids, nr_doms);
+    if (rc) {
+        LOGE(ERROR, "Error moving %d domains to cpupool %u", nr_doms, poolid);
+        GC_FREE;
+        return ERROR_FAIL;
+    }
+
+    GC_FREE;
+    return 0;
+}
+
 /*
  * Local variables:
  * mode: C
@@ -363,6 +363,7 @@ int libxl__domain_build_info_setdefault(libxl__gc *gc,
         libxl_defbool_setdefault(&b_info->u.hvm.usb,                false);
         libxl_defbool_setdefault(&b_info->u.hvm.vkb_device,         true);
         libxl_defbool_setdefault(&b_info->u.hvm.xen_platform_pci,   true);
+        libxl_defbool_setdefault(&b_info->u.hvm.fast_boot,          false);
 
         libxl_defbool_setdefault(&b_info->u.hvm.spice.enable, false);
         if (!libxl_defbool_val(b_info->u.hvm.spice.enable) &&
@@ -1855,27 +1856,36 @@ static void domcreate_attach_devices(libxl__egc *egc,
     int domid = dcs->guest_domid;
     libxl_domain_config *const d_config = dcs->guest_config;
     const libxl__device_type *dt;
+    bool started = false;
     char *tty_path;
 
     if (ret) {
-        LOGD(ERROR, domid, "unable to add %s devices",
-             libxl__device_kind_to_string(device_type_tbl[dcs->device_type_idx]->type));
+        LOGD(ERROR, domid, "unable to add devices");
         goto error_out;
     }
 
-    dcs->device_type_idx++;
-    dt = device_type_tbl[dcs->device_type_idx];
-    if (dt) {
-        if (*libxl__device_type_get_num(dt, d_config) > 0 && !dt->skip_attach) {
-            /* Attach devices */
+    /*
+     * Attach the devices of all the types up to the next barrier in one
+     * go, so that e.g. disk and nic backends are brought up in parallel.
+     */
+    while ((dt = device_type_tbl[dcs->device_type_idx + 1])) {
+        if (started && dt->attach_barrier)
+            break;
+        dcs->device_type_idx++;
+
+        if (*libxl__device_type_get_num(dt, d_config) == 0 || dt->skip_attach)
+            continue;
+
+        if (!started) {
             libxl__multidev_begin(ao, &dcs->multidev);
             dcs->multidev.callback = domcreate_attach_devices;
-            dt->add(egc, ao, domid, d_config, &dcs->multidev);
-            libxl__multidev_prepared(egc, &dcs->multidev, 0);
-            return;
+            started = true;
         }
+        dt->add(egc, ao, domid, d_config, &dcs->multidev);
+    }
 
-        domcreate_attach_devices(egc, &dcs->multidev, 0);
+    if (started) {
+        libxl__multidev_prepared(egc, &dcs->multidev, 0);
         return;
     }
 
@@ -2031,6 +2041,19 @@ static int do_domain_create(libxl_ctx *ctx, libxl_domain_config *d_config,
     cdcs->dcs.send_back_fd = send_back_fd;
     if (restore_fd >= 0) {
         cdcs->dcs.restore_params = *params;
+        if (params->num_aux_fds) {
+            if (params->checkpointed_stream !=
+                LIBXL_CHECKPOINTED_STREAM_NONE) {
+                LOG(ERROR, "Auxiliary streams can't carry a checkpointed "
+                           "stream");
+                rc = ERROR_INVAL;
+                goto out_err;
+            }
+            GCNEW_ARRAY(cdcs->dcs.restore_params.aux_fds,
+                        params->num_aux_fds);
+            memcpy(cdcs->dcs.restore_params.aux_fds, params->aux_fds,
+                   params->num_aux_fds * sizeof(*params->aux_fds));
+        }
         rc = libxl__fd_flags_modify_save(gc, cdcs->dcs.restore_fd,
                                          ~(O_NONBLOCK|O_NDELAY), 0,
                                          &cdcs->dcs.restore_fdfl);
@@ -256,6 +256,14 @@ int libxl__build_pre(libxl__gc *gc, uint32_t domid,
         return ERROR_FAIL;
     }
 
+    /* The colors must be in place before any memory is allocated. */
+    if (info->num_llc_colors &&
+        xc_domain_set_llc_colors(ctx->xch, domid, info->llc_colors,
+                                 info->num_llc_colors)) {
+        LOGED(ERROR, domid, "Couldn't set LLC colors");
+        return ERROR_FAIL;
+    }
+
     /*
      * Check if the domain has any CPU or node affinity already. If not, try
      * to build up the latter via automatic NUMA placement. In fact, in case
@@ -803,6 +811,15 @@ static int hvm_build_set_xs_values(libxl__gc *gc,
             goto err;
     }
 
+    if (info->type == LIBXL_DOMAIN_TYPE_HVM &&
+        libxl_defbool_val(info->u.hvm.fast_boot)) {
+        path = GCSPRINTF("/local/domain/%d/"HVM_XS_FAST_BOOT, domid);
+
+        ret = libxl__xs_printf(gc, XBT_NULL, path, "1");
+        if (ret)
+            goto err;
+    }
+
     return 0;
 
 err:
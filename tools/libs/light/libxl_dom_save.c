@@ -398,6 +398,14 @@ void libxl__domain_save(libxl__egc *egc, libxl__domain_save_state *dss)
         goto out;
     }
 
+    if (dss->num_aux_fds &&
+        dss->checkpointed_stream != LIBXL_CHECKPOINTED_STREAM_NONE) {
+        LOGD(ERROR, domid, "Auxiliary streams can't carry a checkpointed "
+                           "stream");
+        rc = ERROR_INVAL;
+        goto out;
+    }
+
     dss->rc = 0;
     libxl__logdirty_init(&dss->logdirty);
     dss->logdirty.ao = ao;
@@ -409,7 +417,13 @@ void libxl__domain_save(libxl__egc *egc, libxl__domain_save_state *dss)
     if (rc) goto out;
 
     dss->xcflags = (live ? XCFLAGS_LIVE : 0)
-          | (debug ? XCFLAGS_DEBUG : 0);
+          | (debug ? XCFLAGS_DEBUG : 0)
+          | (live && dss->auto_converge ? XCFLAGS_AUTO_CONVERGE : 0);
+
+    /* Checkpoint compression (on by default) doesn't apply to COLO. */
+    if (dss->checkpointed_stream == LIBXL_CHECKPOINTED_STREAM_REMUS &&
+        libxl_defbool_val(r_info->compression))
+        dss->xcflags |= XCFLAGS_COMPRESS;
 
     /* Disallow saving a guest with vNUMA configured because migration
      * stream does not preserve node information.
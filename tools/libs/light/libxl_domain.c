@@ -505,8 +505,9 @@ static void domain_suspend_cb(libxl__egc *egc,
 
 }
 
-int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
-                         const libxl_asyncop_how *ao_how)
+static int domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd,
+                          const int *aux_fds, int num_aux_fds, int flags,
+                          const libxl_asyncop_how *ao_how)
 {
     AO_CREATE(ctx, domid, ao_how);
     int rc;
@@ -528,8 +529,18 @@ int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
     dss->type = type;
     dss->live = flags & LIBXL_SUSPEND_LIVE;
     dss->debug = flags & LIBXL_SUSPEND_DEBUG;
+    dss->auto_converge = flags & LIBXL_SUSPEND_AUTO_CONVERGE;
     dss->checkpointed_stream = LIBXL_CHECKPOINTED_STREAM_NONE;
 
+    if (num_aux_fds) {
+        int *fds;
+
+        GCNEW_ARRAY(fds, num_aux_fds);
+        memcpy(fds, aux_fds, num_aux_fds * sizeof(*fds));
+        dss->aux_fds = fds;
+        dss->num_aux_fds = num_aux_fds;
+    }
+
     rc = libxl__fd_flags_modify_save(gc, dss->fd,
                                      ~(O_NONBLOCK|O_NDELAY), 0,
                                      &dss->fdfl);
@@ -542,6 +553,20 @@ int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
     return AO_CREATE_FAIL(rc);
 }
 
+int libxl_domain_suspend(libxl_ctx *ctx, uint32_t domid, int fd, int flags,
+                         const libxl_asyncop_how *ao_how)
+{
+    return domain_suspend(ctx, domid, fd, NULL, 0, flags, ao_how);
+}
+
+int libxl_domain_suspend_streams(libxl_ctx *ctx, uint32_t domid, int fd,
+                                 const int *aux_fds, int num_aux_fds,
+                                 int flags, const libxl_asyncop_how *ao_how)
+{
+    return domain_suspend(ctx, domid, fd, aux_fds, num_aux_fds, flags,
+                          ao_how);
+}
+
 static void domain_suspend_empty_cb(libxl__egc *egc,
                               libxl__domain_suspend_state *dss, int rc)
 {
@@ -720,6 +745,126 @@ static void domain_unpause_ao_done(libxl__egc *egc,
     libxl__ao_complete(egc, ao, rc);
 }
 
+/* Marks a paused domain as available in the prewarm pool named there. */
+static const char *prewarm_path(libxl__gc *gc, uint32_t domid)
+{
+    return GCSPRINTF("%s/prewarm-pool", libxl__xs_libxl_path(gc, domid));
+}
+
+int libxl_domain_prewarm_add(libxl_ctx *ctx, uint32_t domid,
+                             const char *pool)
+{
+    GC_INIT(ctx);
+    libxl_dominfo info;
+    int rc;
+
+    libxl_dominfo_init(&info);
+
+    if (!pool || !pool[0]) {
+        rc = ERROR_INVAL;
+        goto out;
+    }
+
+    rc = libxl_domain_info(ctx, &info, domid);
+    if (rc) goto out;
+
+    if (!info.paused || info.dying) {
+        LOGD(ERROR, domid, "Only paused domains can be prewarmed");
+        rc = ERROR_INVAL;
+        goto out;
+    }
+
+    rc = libxl__xs_write_checked(gc, XBT_NULL, prewarm_path(gc, domid), pool);
+
+ out:
+    libxl_dominfo_dispose(&info);
+    GC_FREE;
+    return rc;
+}
+
+/*
+ * Atomically take a domain out of @pool, so that concurrent claims never
+ * get the same one.
+ */
+static int prewarm_take(libxl__gc *gc, const char *pool, uint32_t *domid_r)
+{
+    libxl_dominfo *info;
+    xs_transaction_t t = XBT_NULL;
+    int nb, i, rc;
+
+    info = libxl_list_domain(CTX, &nb);
+    if (!info) return ERROR_FAIL;
+
+    for (i = 0; i < nb; i++) {
+        const char *path = prewarm_path(gc, info[i].domid);
+        const char *got;
+
+        if (!info[i].paused || info[i].dying)
+            continue;
+
+        for (;;) {
+            rc = libxl__xs_transaction_start(gc, &t);
+            if (rc) goto out;
+
+            rc = libxl__xs_read_checked(gc, t, path, &got);
+            if (rc) goto out;
+            if (!got || strcmp(got, pool))
+                break;
+
+            rc = libxl__xs_rm_checked(gc, t, path);
+            if (rc) goto out;
+
+            rc = libxl__xs_transaction_commit(gc, &t);
+            if (!rc) {
+                *domid_r = info[i].domid;
+                goto out;
+            }
+            if (rc < 0) goto out;
+        }
+        libxl__xs_transaction_abort(gc, &t);
+    }
+
+    LOG(ERROR, "No prewarmed domain left in pool \"%s\"", pool);
+    rc = ERROR_NOTFOUND;
+
+ out:
+    libxl__xs_transaction_abort(gc, &t);
+    libxl_dominfo_list_free(info, nb);
+    return rc;
+}
+
+int libxl_domain_prewarm_claim(libxl_ctx *ctx, const char *pool,
+                               const char *name, uint32_t *domid_r,
+                               const libxl_asyncop_how *ao_how)
+{
+    AO_CREATE(ctx, 0, ao_how);
+    libxl__dm_resume_state *dmrs;
+    uint32_t domid;
+    int rc;
+
+    rc = prewarm_take(gc, pool, &domid);
+    if (rc) goto out;
+
+    rc = libxl__domain_rename(gc, domid, NULL, name, XBT_NULL);
+    if (rc) {
+        /* Put it back, so that it can still be claimed. */
+        libxl__xs_write_checked(gc, XBT_NULL, prewarm_path(gc, domid), pool);
+        goto out;
+    }
+
+    *domid_r = domid;
+
+    GCNEW(dmrs);
+    dmrs->ao = ao;
+    dmrs->domid = domid;
+    dmrs->callback = domain_unpause_ao_done;
+    libxl__domain_unpause(egc, dmrs); /* must be last */
+    return AO_INPROGRESS;
+
+ out:
+    return AO_CREATE_FAIL(rc);
+}
+
 int libxl__domain_pvcontrol_available(libxl__gc *gc, uint32_t domid)
 {
     libxl_ctx *ctx = libxl__gc_owner(gc);
@@ -344,6 +344,39 @@ static void osevent_hook_failed_noop(libxl__gc *gc, void *ev,
  * fd events
  */
 
+/*
+ * CTX->efds_by_fd lets afterpoll find the libxl__ev_fds for an fd which
+ * poll reported, without scanning all of CTX->efds.  There is normally
+ * just one per fd, so each chain is a simple singly-linked list.
+ */
+
+static void efd_index_add(libxl__gc *gc, libxl__ev_fd *ev)
+{
+    if (ev->fd >= CTX->efds_by_fd_allocd) {
+        int newsz = ev->fd + 1 > CTX->efds_by_fd_allocd * 2
+            ? ev->fd + 1 : CTX->efds_by_fd_allocd * 2;
+
+        assert(ARRAY_SIZE_OK(CTX->efds_by_fd, newsz));
+        CTX->efds_by_fd = libxl__realloc(NOGC, CTX->efds_by_fd,
+                                         newsz * sizeof(*CTX->efds_by_fd));
+        memset(CTX->efds_by_fd + CTX->efds_by_fd_allocd, 0,
+               (newsz - CTX->efds_by_fd_allocd) * sizeof(*CTX->efds_by_fd));
+        CTX->efds_by_fd_allocd = newsz;
+    }
+
+    ev->fd_next = CTX->efds_by_fd[ev->fd];
+    CTX->efds_by_fd[ev->fd] = ev;
+}
+
+static void efd_index_remove(libxl__gc *gc, libxl__ev_fd *ev)
+{
+    libxl__ev_fd **evp;
+
+    for (evp = &CTX->efds_by_fd[ev->fd]; *evp != ev; evp = &(*evp)->fd_next)
+        assert(*evp);
+    *evp = ev->fd_next;
+}
+
 int libxl__ev_fd_register(libxl__gc *gc, libxl__ev_fd *ev,
                           libxl__ev_fd_callback *func,
                           int fd, short events)
@@ -365,6 +398,7 @@ int libxl__ev_fd_register(libxl__gc *gc, libxl__ev_fd *ev,
     ev->func = func;
 
     LIBXL_LIST_INSERT_HEAD(&CTX->efds, ev, entry);
+    efd_index_add(gc, ev);
     pollers_note_osevent_added(CTX);
 
     rc = 0;
@@ -410,6 +444,7 @@ void libxl__ev_fd_deregister(libxl__gc *gc, libxl__ev_fd *ev)
 
     OSEVENT_HOOK_VOID(fd,deregister, release, ev->fd, ev->nexus->for_app_reg);
     LIBXL_LIST_REMOVE(ev, entry);
+    efd_index_remove(gc, ev);
     ev->fd = -1;
 
     LIBXL_LIST_FOREACH(poller, &CTX->pollers_active, active_entry)
@@ -474,11 +509,103 @@ static int time_rel_to_abs(libxl__gc *gc, int ms, struct timeval *abs_out)
     return 0;
 }
 
+/*
+ * Finite timeouts live in CTX->etimes, a binary min-heap ordered by
+ * expiry and then by registration order, so that registering and
+ * deregistering are O(log n) and the next one to expire is etimes[0].
+ */
+
+static bool etime_before(const libxl__ev_time *a, const libxl__ev_time *b)
+{
+    if (timercmp(&a->abs, &b->abs, !=))
+        return timercmp(&a->abs, &b->abs, <);
+    return a->etimes_seq < b->etimes_seq;
+}
+
+static void etimes_set(libxl_ctx *ctx, int i, libxl__ev_time *ev)
+{
+    ctx->etimes[i] = ev;
+    ev->etimes_index = i;
+}
+
+static void etimes_sift_up(libxl_ctx *ctx, int i)
+{
+    libxl__ev_time *ev = ctx->etimes[i];
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+
+        if (!etime_before(ev, ctx->etimes[parent]))
+            break;
+        etimes_set(ctx, i, ctx->etimes[parent]);
+        i = parent;
+    }
+    etimes_set(ctx, i, ev);
+}
+
+static void etimes_sift_down(libxl_ctx *ctx, int i)
+{
+    libxl__ev_time *ev = ctx->etimes[i];
+
+    for (;;) {
+        int child = 2 * i + 1;
+
+        if (child >= ctx->etimes_used)
+            break;
+        if (child + 1 < ctx->etimes_used &&
+            etime_before(ctx->etimes[child + 1], ctx->etimes[child]))
+            child++;
+        if (!etime_before(ctx->etimes[child], ev))
+            break;
+        etimes_set(ctx, i, ctx->etimes[child]);
+        i = child;
+    }
+    etimes_set(ctx, i, ev);
+}
+
+static void etimes_insert(libxl__gc *gc, libxl__ev_time *ev)
+{
+    if (CTX->etimes_used == CTX->etimes_allocd) {
+        int newsz = CTX->etimes_allocd ? CTX->etimes_allocd * 2 : 16;
+
+        assert(ARRAY_SIZE_OK(CTX->etimes, newsz));
+        CTX->etimes = libxl__realloc(NOGC, CTX->etimes,
+                                     newsz * sizeof(*CTX->etimes));
+        CTX->etimes_allocd = newsz;
+    }
+
+    ev->etimes_seq = CTX->etimes_seq++;
+    etimes_set(CTX, CTX->etimes_used++, ev);
+    etimes_sift_up(CTX, ev->etimes_index);
+}
+
+static void etimes_remove(libxl__gc *gc, libxl__ev_time *ev)
+{
+    int i = ev->etimes_index;
+    libxl__ev_time *last;
+
+    assert(i < CTX->etimes_used && CTX->etimes[i] == ev);
+
+    last = CTX->etimes[--CTX->etimes_used];
+    if (last == ev)
+        return;
+
+    etimes_set(CTX, i, last);
+    if (i > 0 && etime_before(last, CTX->etimes[(i - 1) / 2]))
+        etimes_sift_up(CTX, i);
+    else
+        etimes_sift_down(CTX, i);
+}
+
+static libxl__ev_time *etimes_first(libxl__gc *gc)
+{
+    return CTX->etimes_used ? CTX->etimes[0] : NULL;
+}
+
 static int time_register_finite(libxl__gc *gc, libxl__ev_time *ev,
                                 struct timeval absolute)
 {
     int rc;
-    libxl__ev_time *evsearch;
 
     rc = OSEVENT_HOOK(timeout,register, alloc, &ev->nexus->for_app_reg,
                       absolute, ev->nexus);
@@ -486,8 +613,7 @@ static int time_register_finite(libxl__gc *gc, libxl__ev_time *ev,
 
     ev->infinite = 0;
     ev->abs = absolute;
-    LIBXL_TAILQ_INSERT_SORTED(&CTX->etimes, entry, ev, evsearch, /*empty*/,
-                              timercmp(&ev->abs, &evsearch->abs, >));
+    etimes_insert(gc, ev);
 
     pollers_note_osevent_added(CTX);
     return 0;
@@ -504,7 +630,7 @@ static void time_deregister(libxl__gc *gc, libxl__ev_time *ev)
         OSEVENT_HOOK_VOID(timeout,modify,
                           noop /* release nexus in _occurred_ */,
                           &ev->nexus->for_app_reg, right_away);
-        LIBXL_TAILQ_REMOVE(&CTX->etimes, ev, entry);
+        etimes_remove(gc, ev);
     }
 }
 
@@ -1298,7 +1424,7 @@ static int beforepoll_internal(libxl__gc *gc, libxl__poller *poller,
     poller->fds_deregistered = 0;
     poller->osevents_added = 0;
 
-    libxl__ev_time *etime = LIBXL_TAILQ_FIRST(&CTX->etimes);
+    libxl__ev_time *etime = etimes_first(gc);
     if (etime) {
         int our_timeout;
         struct timeval rel;
@@ -1396,6 +1522,7 @@ static void afterpoll_internal(libxl__egc *egc, libxl__poller *poller,
      * ctx must be locked exactly once */
     EGC_GC;
     libxl__ev_fd *efd;
+    int i;
 
     /*
      * Warning! Reentrancy hazards!
@@ -1425,36 +1552,47 @@ static void afterpoll_internal(libxl__egc *egc, libxl__poller *poller,
      *
      *   CTX->etimes  is used in a simple reentrancy-safe manner.
      *
-     *   CTX->efds    is more complicated; see below.
+     *   CTX->efds_by_fd is more complicated; see below.
      */
 
-    for (;;) {
-        /* We restart our scan of fd events whenever we call a
-         * callback function.  This is necessary because such
-         * a callback might make arbitrary changes to CTX->efds.
-         * We invalidate the fd_rindices[] entries which were used
-         * so that we don't call the same function again. */
-        int revents;
+    for (i = 0; i < nfds; i++) {
+        int fd = fds[i].fd;
 
-        LIBXL_LIST_FOREACH(efd, &CTX->efds, entry) {
+        if (!fds[i].revents || fd < 0)
+            continue;
 
-            if (!efd->events)
-                continue;
+        for (;;) {
+            /* We restart our scan of this fd's events whenever we
+             * call a callback function.  This is necessary because
+             * such a callback might make arbitrary changes to
+             * CTX->efds_by_fd.  We invalidate the fd_rindices[]
+             * entries which were used so that we don't call the same
+             * function again. */
+            int revents;
+
+            if (fd >= CTX->efds_by_fd_allocd)
+                break;
 
-            revents = afterpoll_check_fd(poller,fds,nfds,
-                                         efd->fd,efd->events);
-            if (revents)
-                goto found_fd_event;
-        }
-        /* no ordinary fd events, then */
-        break;
+            for (efd = CTX->efds_by_fd[fd]; efd; efd = efd->fd_next) {
+
+                if (!efd->events)
+                    continue;
 
-    found_fd_event:
-        fd_occurs(egc, efd, revents);
+                revents = afterpoll_check_fd(poller,fds,nfds,
+                                             efd->fd,efd->events);
+                if (revents)
+                    goto found_fd_event;
+            }
+            /* no more ordinary fd events for this fd, then */
+            break;
+
+        found_fd_event:
+            fd_occurs(egc, efd, revents);
+        }
     }
 
     for (;;) {
-        libxl__ev_time *etime = LIBXL_TAILQ_FIRST(&CTX->etimes);
+        libxl__ev_time *etime = etimes_first(gc);
         if (!etime)
             break;
 
@@ -1495,7 +1633,7 @@ void libxl_osevent_register_hooks(libxl_ctx *ctx,
     GC_INIT(ctx);
     CTX_LOCK;
     assert(LIBXL_LIST_EMPTY(&ctx->efds));
-    assert(LIBXL_TAILQ_EMPTY(&ctx->etimes));
+    assert(!ctx->etimes_used);
     ctx->osevent_hooks = hooks;
     ctx->osevent_user = user;
     CTX_UNLOCK;
@@ -1534,7 +1672,7 @@ void libxl_osevent_occurred_timeout(libxl_ctx *ctx, void *for_libxl)
     if (!ev) goto out;
     assert(!ev->infinite);
 
-    LIBXL_TAILQ_REMOVE(&CTX->etimes, ev, entry);
+    etimes_remove(gc, ev);
 
     time_occurs(egc, ev, ERROR_TIMEDOUT);
 
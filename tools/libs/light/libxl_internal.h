@@ -247,6 +247,7 @@ struct libxl__ev_fd {
     libxl__ev_fd_callback *func;
     /* remainder is private for libxl__ev_fd... */
     LIBXL_LIST_ENTRY(libxl__ev_fd) entry;
+    libxl__ev_fd *fd_next; /* on CTX->efds_by_fd[fd] */
     libxl__osevent_hook_nexus *nexus;
 };
 
@@ -296,8 +297,9 @@ struct libxl__ev_time {
     /* read-only for caller, who may read only when registered: */
     libxl__ev_time_callback *func;
     /* remainder is private for libxl__ev_time... */
-    int infinite; /* not registered in list or with app if infinite */
-    LIBXL_TAILQ_ENTRY(libxl__ev_time) entry;
+    int infinite; /* not registered in heap or with app if infinite */
+    int etimes_index; /* in CTX->etimes */
+    uint64_t etimes_seq; /* orders timeouts with equal abs */
     struct timeval abs;
     libxl__osevent_hook_nexus *nexus;
     libxl__ao_abortable abrt;
@@ -539,6 +541,8 @@ struct libxl__ev_qmp {
     char *rx_buf;
     size_t rx_buf_size; /* current allocated size */
     size_t rx_buf_used; /* actual data in the buffer */
+    size_t rx_buf_off;  /* start of the data not yet parsed */
+    size_t rx_buf_scanned; /* bytes after rx_buf_off without "\r\n" */
     /* sending buffer */
     char *tx_buf;
     size_t tx_buf_len;  /* tx_buf size */
@@ -695,7 +699,13 @@ struct libxl__ctx {
     LIBXL_SLIST_HEAD(libxl__osevent_hook_nexi, libxl__osevent_hook_nexus)
         hook_fd_nexi_idle, hook_timeout_nexi_idle;
     LIBXL_LIST_HEAD(, libxl__ev_fd) efds;
-    LIBXL_TAILQ_HEAD(, libxl__ev_time) etimes;
+    /* efds indexed by fd, each chained through fd_next */
+    libxl__ev_fd **efds_by_fd;
+    int efds_by_fd_allocd;
+    /* finite timeouts: binary min-heap on (abs, etimes_seq) */
+    libxl__ev_time **etimes;
+    int etimes_used, etimes_allocd;
+    uint64_t etimes_seq;
 
     libxl__ev_watch_slot *watch_slots;
     int watch_nslots, nwatches;
@@ -3634,9 +3644,12 @@ struct libxl__domain_save_state {
     int fd;
     int fdfl; /* original flags on fd */
     int recv_fd;
+    const int *aux_fds;
+    int num_aux_fds;
     libxl_domain_type type;
     int live;
     int debug;
+    int auto_converge;
     int checkpointed_stream;
     const libxl_domain_remus_info *remus;
     /* private */
@@ -3927,6 +3940,8 @@ typedef int (*device_set_xenstore_config_fn_t)(libxl__gc *, uint32_t, void *,
 struct libxl__device_type {
     libxl__device_kind type;
     int skip_attach;   /* Skip entry in domcreate_attach_devices() if 1 */
+    int attach_barrier; /* Attach only after all previous entries in
+                           domcreate_attach_devices() are done if 1 */
     int ptr_offset;    /* Offset of device array ptr in libxl_domain_config */
     int num_offset;    /* Offset of # of devices in libxl_domain_config */
     int dev_elem_size; /* Size of one device element in array */
@@ -160,6 +160,27 @@ out:
     return rc;
 }
 
+/*
+ * The stock block script has nothing to undo for a block device (only
+ * loop devices set up for files need tearing down), so spare forking a
+ * shell for it on every disk removal.
+ */
+static bool hotplug_disk_remove_is_noop(libxl__gc *gc, const char *be_path,
+                                        const char *script)
+{
+    const char *params;
+    struct stat st;
+
+    if (strcmp(script, GCSPRINTF("%s/block", libxl__xen_script_dir_path())))
+        return false;
+
+    params = libxl__xs_read(gc, XBT_NULL, GCSPRINTF("%s/params", be_path));
+    if (!params || stat(params, &st))
+        return false;
+
+    return S_ISBLK(st.st_mode);
+}
+
 static int libxl__hotplug_disk(libxl__gc *gc, libxl__device *dev,
                                char ***args, char ***env,
                                libxl__device_action action)
@@ -177,6 +198,14 @@ static int libxl__hotplug_disk(libxl__gc *gc, libxl__device *dev,
         goto error;
     }
 
+    if (action == LIBXL__DEVICE_ACTION_REMOVE &&
+        hotplug_disk_remove_is_noop(gc, be_path, script)) {
+        LOGD(DEBUG, dev->domid, "%s remove is a no-op, not running it",
+             script);
+        rc = 0;
+        goto error;
+    }
+
     *env = get_hotplug_env(gc, script, dev);
     if (!*env) {
         LOGD(ERROR, dev->domid, "Failed to get hotplug environment");
@@ -1014,6 +1014,25 @@ out:
     return rc;
 }
 
+/*
+ * Resetting a device can take a long time: an FLR alone takes at least
+ * 100ms, and the kernel may have to fall back to slower methods.  So do it
+ * in a child process, letting the devices of a domain being created or
+ * destroyed be reset in parallel instead of one after the other, and
+ * without blocking the event loop meanwhile.
+ */
+typedef struct pci_reset_state {
+    /* filled by user of pci_reset_async */
+    libxl__ao *ao;
+    const libxl_device_pci *pci;
+    void (*callback)(libxl__egc *, struct pci_reset_state *, int rc);
+
+    /* private to pci_reset_async */
+    libxl__ev_child child;
+} pci_reset_state;
+
+static void pci_reset_async(libxl__egc *egc, pci_reset_state *prst);
+
 typedef struct pci_add_state {
     /* filled by user of do_pci_add */
     libxl__ao_device *aodev;
@@ -1030,6 +1049,9 @@ typedef struct pci_add_state {
     libxl__ev_time timeout;
     libxl_device_pci pci;
     libxl_domid pci_domid;
+
+    /* private to libxl__device_pci_add */
+    pci_reset_state reset;
 } pci_add_state;
 
 static void pci_add_qemu_trad_watch_state_cb(libxl__egc *egc,
@@ -1455,6 +1477,50 @@ static int libxl__device_pci_reset(libxl__gc *gc, unsigned int domain, unsigned
     return -1;
 }
 
+static void pci_reset_exited(libxl__egc *egc, libxl__ev_child *child,
+                             pid_t pid, int status);
+
+static void pci_reset_async(libxl__egc *egc, pci_reset_state *prst)
+{
+    STATE_AO_GC(prst->ao);
+    const libxl_device_pci *pci = prst->pci;
+    pid_t pid;
+    int rc;
+
+    libxl__ev_child_init(&prst->child);
+
+    pid = libxl__ev_child_fork(gc, &prst->child, pci_reset_exited);
+    if (pid < 0) {
+        LOG(WARN, "Resetting PCI device "PCI_BDF" synchronously",
+            pci->domain, pci->bus, pci->dev, pci->func);
+        rc = libxl__device_pci_reset(gc, pci->domain, pci->bus, pci->dev,
+                                     pci->func);
+        prst->callback(egc, prst, rc ? ERROR_FAIL : 0); /* must be last */
+        return;
+    }
+
+    if (!pid) {
+        /* child */
+        rc = libxl__device_pci_reset(gc, pci->domain, pci->bus, pci->dev,
+                                     pci->func);
+        _exit(rc ? 1 : 0);
+    }
+}
+
+static void pci_reset_exited(libxl__egc *egc, libxl__ev_child *child,
+                             pid_t pid, int status)
+{
+    pci_reset_state *prst = CONTAINER_OF(child, *prst, child);
+    STATE_AO_GC(prst->ao);
+
+    /* The child has logged the details already. */
+    if (status && !(WIFEXITED(status) && WEXITSTATUS(status) == 1))
+        libxl_report_child_exitstatus(CTX, XTL_ERROR, "PCI device reset",
+                                      pid, status);
+
+    prst->callback(egc, prst, status ? ERROR_FAIL : 0); /* must be last */
+}
+
 int libxl__device_pci_setdefault(libxl__gc *gc, uint32_t domid,
                                  libxl_device_pci *pci, bool hotplug)
 {
@@ -1501,6 +1567,8 @@ static void device_pci_add_stubdom_done(libxl__egc *egc,
     pci_add_state *, int rc);
 static void device_pci_add_done(libxl__egc *egc,
     pci_add_state *, int rc);
+static void device_pci_add_reset_done(libxl__egc *egc,
+    pci_reset_state *prst, int rc);
 
 void libxl__device_pci_add(libxl__egc *egc, uint32_t domid,
                            libxl_device_pci *pci, bool starting,
@@ -1509,7 +1577,6 @@ void libxl__device_pci_add(libxl__egc *egc, uint32_t domid,
     STATE_AO_GC(aodev->ao);
     libxl_ctx *ctx = libxl__gc_owner(gc);
     int rc;
-    int stubdomid = 0;
     pci_add_state *pas;
 
     GCNEW(pas);
@@ -1553,9 +1620,27 @@ void libxl__device_pci_add(libxl__egc *egc, uint32_t domid,
     rc = pci_info_xs_write(gc, pci, "domid", GCSPRINTF("%u", domid));
     if (rc) goto out;
 
-    libxl__device_pci_reset(gc, pci->domain, pci->bus, pci->dev, pci->func);
+    pas->reset.ao = ao;
+    pas->reset.pci = pci;
+    pas->reset.callback = device_pci_add_reset_done;
+    pci_reset_async(egc, &pas->reset); /* must be last */
+    return;
+
+out:
+    device_pci_add_done(egc, pas, rc); /* must be last */
+}
+
+static void device_pci_add_reset_done(libxl__egc *egc,
+                                      pci_reset_state *prst,
+                                      int rc)
+{
+    pci_add_state *pas = CONTAINER_OF(prst, *pas, reset);
+    STATE_AO_GC(pas->aodev->ao);
+    int stubdomid;
+
+    /* As ever, a failed reset has been logged but is not fatal. */
 
-    stubdomid = libxl_get_stubdom_id(ctx, domid);
+    stubdomid = libxl_get_stubdom_id(CTX, pas->domid);
     if (stubdomid != 0) {
         pas->callback = device_pci_add_stubdom_wait;
 
@@ -1564,10 +1649,6 @@ void libxl__device_pci_add(libxl__egc *egc, uint32_t domid,
     }
 
     device_pci_add_stubdom_done(egc, pas, 0); /* must be last */
-    return;
-
-out:
-    device_pci_add_done(egc, pas, rc); /* must be last */
 }
 
 static void device_pci_add_stubdom_wait(libxl__egc *egc,
@@ -1778,6 +1859,7 @@ typedef struct pci_remove_state {
     libxl__ev_qmp qmp;
     libxl__ev_time timeout;
     libxl__ev_time retry_timer;
+    pci_reset_state reset;
 } pci_remove_state;
 
 static void libxl__device_pci_remove_common(libxl__egc *egc,
@@ -1800,6 +1882,8 @@ static void pci_remove_timeout(libxl__egc *egc,
     libxl__ev_time *ev, const struct timeval *requested_abs, int rc);
 static void pci_remove_detached(libxl__egc *egc,
     pci_remove_state *prs, int rc);
+static void pci_remove_reset_done(libxl__egc *egc,
+    pci_reset_state *prst, int rc);
 static void pci_remove_stubdom_done(libxl__egc *egc,
     libxl__ao_device *aodev);
 static void pci_remove_done(libxl__egc *egc,
@@ -2090,29 +2174,48 @@ static void pci_remove_detached(libxl__egc *egc,
                                 int rc)
 {
     STATE_AO_GC(prs->aodev->ao);
-    int stubdomid = 0;
-    uint32_t domainid = prs->domid;
-    bool isstubdom;
 
     /* Convenience aliases */
     libxl_device_pci *const pci = &prs->pci;
-    libxl_domid domid = prs->domid;
 
     /* Cleaning QMP states ASAP */
     libxl__ev_qmp_dispose(gc, &prs->qmp);
     libxl__ev_time_deregister(gc, &prs->timeout);
     libxl__ev_time_deregister(gc, &prs->retry_timer);
 
-    if (rc && !prs->force)
-        goto out;
-
-    isstubdom = libxl_is_stubdom(CTX, domid, &domainid);
+    if (rc && !prs->force) {
+        pci_remove_done(egc, prs, rc);
+        return;
+    }
 
     /* don't do multiple resets while some functions are still passed through */
     if ((pci->vdevfn & 0x7) == 0) {
-        libxl__device_pci_reset(gc, pci->domain, pci->bus, pci->dev, pci->func);
+        prs->reset.ao = ao;
+        prs->reset.pci = pci;
+        prs->reset.callback = pci_remove_reset_done;
+        pci_reset_async(egc, &prs->reset); /* must be last */
+        return;
     }
 
+    pci_remove_reset_done(egc, &prs->reset, 0);
+}
+
+static void pci_remove_reset_done(libxl__egc *egc,
+                                  pci_reset_state *prst,
+                                  int rc)
+{
+    pci_remove_state *prs = CONTAINER_OF(prst, *prs, reset);
+    STATE_AO_GC(prs->aodev->ao);
+    int stubdomid = 0;
+    uint32_t domainid = prs->domid;
+    bool isstubdom;
+
+    /* Convenience aliases */
+    libxl_device_pci *const pci = &prs->pci;
+    libxl_domid domid = prs->domid;
+
+    isstubdom = libxl_is_stubdom(CTX, domid, &domainid);
+
     if (!isstubdom) {
         rc = xc_deassign_device(CTX->xch, domid, pci_encode_bdf(pci));
         if (rc < 0 && (prs->hvm || errno != ENOSYS))
@@ -2137,9 +2240,7 @@ static void pci_remove_detached(libxl__egc *egc,
         return;
     }
 
-    rc = 0;
-out:
-    pci_remove_done(egc, prs, rc);
+    pci_remove_done(egc, prs, 0);
 }
 
 static void pci_remove_stubdom_done(libxl__egc *egc,
@@ -1131,6 +1131,8 @@ static void dm_state_saved(libxl__egc *egc, libxl__ev_qmp *ev,
  *     rx_buf           NULL   NULL or allocated
  *     rx_buf_size      0      allocation size of `rx_buf`
  *     rx_buf_used      0      <= rx_buf_size, actual data in the buffer
+ *     rx_buf_off       0      <= rx_buf_used, data already parsed
+ *     rx_buf_scanned   0      <= rx_buf_used - rx_buf_off, searched for EOM
  * - transmitting buffer:
  *                     free   used
  *     tx_buf           NULL   contains data
@@ -1551,6 +1553,13 @@ static int qmp_ev_callback_readable(libxl__egc *egc,
                 return rc;
         }
 
+        /* Drop the messages already parsed, all at once */
+        if (ev->rx_buf_off) {
+            ev->rx_buf_used -= ev->rx_buf_off;
+            memmove(ev->rx_buf, ev->rx_buf + ev->rx_buf_off, ev->rx_buf_used);
+            ev->rx_buf_off = 0;
+        }
+
         /* Check if the buffer still have space, or increase size */
         if (ev->rx_buf_size - ev->rx_buf_used < QMP_RECEIVE_BUFFER_SIZE) {
             size_t newsize = ev->rx_buf_size * 2 + QMP_RECEIVE_BUFFER_SIZE;
@@ -1602,34 +1611,45 @@ static int qmp_ev_get_next_msg(libxl__egc *egc, libxl__ev_qmp *ev,
      */
 {
     STATE_AO_GC(ev->ao);
-    size_t len;
-    char *end = NULL;
+    size_t len, avail, skip;
+    char *start, *end = NULL;
     const char eom[] = "\r\n";
     const size_t eoml = sizeof(eom) - 1;
     libxl__json_object *o = NULL;
 
-    if (!ev->rx_buf_used)
+    start = ev->rx_buf + ev->rx_buf_off;
+    avail = ev->rx_buf_used - ev->rx_buf_off;
+    if (!avail)
         return ERROR_NOTFOUND;
 
-    /* Search for the end of a QMP message: "\r\n" */
-    end = memmem(ev->rx_buf, ev->rx_buf_used, eom, eoml);
-    if (!end)
+    /* Search for the end of a QMP message: "\r\n", but don't rescan what
+     * an earlier call already searched, a big reply can come in many
+     * reads. Back off by one byte in case the "\r" was the last one. */
+    skip = ev->rx_buf_scanned >= eoml ? ev->rx_buf_scanned - (eoml - 1) : 0;
+    end = memmem(start + skip, avail - skip, eom, eoml);
+    if (!end) {
+        ev->rx_buf_scanned = avail;
         return ERROR_NOTFOUND;
-    len = (end - ev->rx_buf) + eoml;
+    }
+    len = (end - start) + eoml;
 
-    LOG_QMP("parsing %luB: '%.*s'", len, (int)len, ev->rx_buf);
+    LOG_QMP("parsing %luB: '%.*s'", len, (int)len, start);
 
     /* Replace \r by \0 so that libxl__json_parse can use strlen */
-    ev->rx_buf[len - eoml] = '\0';
-    o = libxl__json_parse(gc, ev->rx_buf);
+    start[len - eoml] = '\0';
+    o = libxl__json_parse(gc, start);
 
     if (!o) {
         LOGD(ERROR, ev->domid, "Parse error");
         return ERROR_PROTOCOL_ERROR_QMP;
     }
 
-    ev->rx_buf_used -= len;
-    memmove(ev->rx_buf, ev->rx_buf + len, ev->rx_buf_used);
+    /* Only advance past the message, the buffer is compacted before the
+     * next read rather than after every message. */
+    ev->rx_buf_off += len;
+    ev->rx_buf_scanned = 0;
+    if (ev->rx_buf_off == ev->rx_buf_used)
+        ev->rx_buf_off = ev->rx_buf_used = 0;
 
     LOG_QMP("JSON object received: %s", JSON(o));
 
@@ -1858,6 +1878,7 @@ void libxl__ev_qmp_init(libxl__ev_qmp *ev)
 
     ev->rx_buf = NULL;
     ev->rx_buf_size = ev->rx_buf_used = 0;
+    ev->rx_buf_off = ev->rx_buf_scanned = 0;
     qmp_ev_tx_buf_clear(ev);
 
     ev->msg = NULL;
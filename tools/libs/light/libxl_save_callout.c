@@ -39,6 +39,28 @@ static void helper_exited(libxl__egc *egc, libxl__ev_child *ch,
                           pid_t pid, int status);
 static void helper_done(libxl__egc *egc, libxl__save_helper_state *shs);
 
+/*
+ * The helper takes the auxiliary stream fds as a count and then the fds,
+ * after the fixed arguments.
+ */
+static const unsigned long *append_aux_fds(libxl__gc *gc,
+                                           const unsigned long *argnums,
+                                           int *num_argnums,
+                                           const int *aux_fds,
+                                           int num_aux_fds)
+{
+    unsigned long *args;
+    int i;
+
+    GCNEW_ARRAY(args, *num_argnums + 1 + num_aux_fds);
+    memcpy(args, argnums, *num_argnums * sizeof(*args));
+    args[(*num_argnums)++] = num_aux_fds;
+    for (i = 0; i < num_aux_fds; i++)
+        args[(*num_argnums)++] = aux_fds[i];
+
+    return args;
+}
+
 /*----- entrypoints -----*/
 
 void libxl__xc_domain_restore(libxl__egc *egc, libxl__domain_create_state *dcs,
@@ -55,13 +77,18 @@ void libxl__xc_domain_restore(libxl__egc *egc, libxl__domain_create_state *dcs,
     unsigned cbflags =
         libxl__srm_callout_enumcallbacks_restore(&shs->callbacks.restore.a);
 
-    const unsigned long argnums[] = {
+    const unsigned long fixed_argnums[] = {
         domid,
         state->store_port,
         state->store_domid, state->console_port,
         state->console_domid,
         cbflags, dcs->restore_params.checkpointed_stream,
     };
+    int num_argnums = ARRAY_SIZE(fixed_argnums);
+    const unsigned long *argnums =
+        append_aux_fds(gc, fixed_argnums, &num_argnums,
+                       dcs->restore_params.aux_fds,
+                       dcs->restore_params.num_aux_fds);
 
     shs->ao = ao;
     shs->domid = domid;
@@ -74,8 +101,9 @@ void libxl__xc_domain_restore(libxl__egc *egc, libxl__domain_create_state *dcs,
     shs->caller_state = dcs;
     shs->need_results = 1;
 
-    run_helper(egc, shs, "--restore-domain", restore_fd, send_back_fd, 0, 0,
-               argnums, ARRAY_SIZE(argnums));
+    run_helper(egc, shs, "--restore-domain", restore_fd, send_back_fd,
+               dcs->restore_params.aux_fds, dcs->restore_params.num_aux_fds,
+               argnums, num_argnums);
 }
 
 void libxl__xc_domain_save(libxl__egc *egc, libxl__domain_save_state *dss,
@@ -86,10 +114,14 @@ void libxl__xc_domain_save(libxl__egc *egc, libxl__domain_save_state *dss,
     unsigned cbflags =
         libxl__srm_callout_enumcallbacks_save(&shs->callbacks.save.a);
 
-    const unsigned long argnums[] = {
+    const unsigned long fixed_argnums[] = {
         dss->domid, dss->xcflags, cbflags,
         dss->checkpointed_stream,
     };
+    int num_argnums = ARRAY_SIZE(fixed_argnums);
+    const unsigned long *argnums =
+        append_aux_fds(gc, fixed_argnums, &num_argnums,
+                       dss->aux_fds, dss->num_aux_fds);
 
     shs->ao = ao;
     shs->domid = dss->domid;
@@ -99,8 +131,8 @@ void libxl__xc_domain_save(libxl__egc *egc, libxl__domain_save_state *dss,
     shs->need_results = 0;
 
     run_helper(egc, shs, "--save-domain", dss->fd, dss->recv_fd,
-               NULL, 0,
-               argnums, ARRAY_SIZE(argnums));
+               dss->aux_fds, dss->num_aux_fds,
+               argnums, num_argnums);
     return;
 }
 
@@ -236,6 +236,8 @@ int main(int argc, char **argv)
 {
     int r;
     int send_back_fd, recv_fd;
+    unsigned nr_aux_fds, i;
+    int *aux_fds;
 
 #define NEXTARG (++argv, assert(*argv), *argv)
 
@@ -251,6 +253,11 @@ int main(int argc, char **argv)
         uint32_t flags =                    strtoul(NEXTARG,0,10);
         unsigned cbflags =                  strtoul(NEXTARG,0,10);
         xc_stream_type_t stream_type =      strtoul(NEXTARG,0,10);
+        nr_aux_fds =                        strtoul(NEXTARG,0,10);
+        aux_fds = malloc(nr_aux_fds * sizeof(*aux_fds) ?: 1);
+        if (!aux_fds) fail(errno,"allocate auxiliary stream fds");
+        for (i = 0; i < nr_aux_fds; i++)
+            aux_fds[i] =                    atoi(NEXTARG);
         assert(!*++argv);
 
         helper_setcallbacks_save(&cb, cbflags);
@@ -258,7 +265,8 @@ int main(int argc, char **argv)
         startup("save");
         setup_signals(save_signal_handler);
 
-        r = xc_domain_save(xch, io_fd, dom, flags, &cb, stream_type, recv_fd);
+        r = xc_domain_save(xch, io_fd, dom, flags, &cb, stream_type, recv_fd,
+                           aux_fds, nr_aux_fds);
         complete(r);
 
     } else if (!strcmp(mode,"--restore-domain")) {
@@ -273,6 +281,11 @@ int main(int argc, char **argv)
         domid_t console_domid =             strtoul(NEXTARG,0,10);
         unsigned cbflags =                  strtoul(NEXTARG,0,10);
         xc_stream_type_t stream_type =      strtoul(NEXTARG,0,10);
+        nr_aux_fds =                        strtoul(NEXTARG,0,10);
+        aux_fds = malloc(nr_aux_fds * sizeof(*aux_fds) ?: 1);
+        if (!aux_fds) fail(errno,"allocate auxiliary stream fds");
+        for (i = 0; i < nr_aux_fds; i++)
+            aux_fds[i] =                    atoi(NEXTARG);
         assert(!*++argv);
 
         helper_setcallbacks_restore(&cb, cbflags);
@@ -285,7 +298,8 @@ int main(int argc, char **argv)
 
         r = xc_domain_restore(xch, io_fd, dom, store_evtchn, &store_mfn,
                               store_domid, console_evtchn, &console_mfn,
-                              console_domid, stream_type, &cb, send_back_fd);
+                              console_domid, stream_type, &cb, send_back_fd,
+                              aux_fds, nr_aux_fds);
         helper_stub_restore_results(store_mfn,console_mfn,0);
         complete(r);
 
@@ -143,6 +143,57 @@ int libxl_domain_set_nodeaffinity(libxl_ctx *ctx, uint32_t domid,
     return 0;
 }
 
+int libxl_domain_move_memory(libxl_ctx *ctx, uint32_t domid, uint32_t node,
+                             uint64_t *nr_moved)
+{
+    GC_INIT(ctx);
+    libxl_bitmap nodemap;
+    xen_pfn_t max_gpfn;
+    unsigned long moved = 0;
+    int rc;
+
+    libxl_bitmap_init(&nodemap);
+
+    rc = libxl_node_bitmap_alloc(ctx, &nodemap, 0);
+    if (rc)
+        goto out;
+
+    if (node >= nodemap.size * 8) {
+        LOGD(ERROR, domid, "Invalid node %u", node);
+        rc = ERROR_INVAL;
+        goto out;
+    }
+    libxl_bitmap_set(&nodemap, node);
+
+    /* Whatever the domain allocates from now on should come from there too. */
+    rc = libxl_domain_set_nodeaffinity(ctx, domid, &nodemap);
+    if (rc)
+        goto out;
+
+    if (xc_domain_maximum_gpfn(ctx->xch, domid, &max_gpfn) < 0) {
+        LOGED(ERROR, domid, "Getting maximum gpfn");
+        rc = ERROR_FAIL;
+        goto out;
+    }
+
+    if (xc_domain_numa_migrate(ctx->xch, domid, 0, max_gpfn + 1, node,
+                               &moved)) {
+        LOGED(ERROR, domid, "Moving memory to node %u", node);
+        rc = errno == EOPNOTSUPP ? ERROR_NI : ERROR_FAIL;
+        goto out;
+    }
+
+    LOGD(DEBUG, domid, "Moved %lu pages to node %u", moved, node);
+    if (nr_moved)
+        *nr_moved = moved;
+    rc = 0;
+
+out:
+    libxl_bitmap_dispose(&nodemap);
+    GC_FREE;
+    return rc;
+}
+
 int libxl_domain_get_nodeaffinity(libxl_ctx *ctx, uint32_t domid,
                                   libxl_bitmap *nodemap)
 {
@@ -124,7 +124,8 @@ static int init_acpi_config(libxl__gc *gc,
         }
 
         vmemrange = libxl__zalloc(gc, dom->nr_vmemranges * sizeof(*vmemrange));
-        vdistance = libxl__zalloc(gc, dom->nr_vnodes * sizeof(*vdistance));
+        vdistance = libxl__zalloc(gc, dom->nr_vnodes * dom->nr_vnodes *
+                                  sizeof(*vdistance));
         vcpu_to_vnode = libxl__zalloc(gc, hvminfo->nr_vcpus *
                                       sizeof(*vcpu_to_vnode));
         r = xc_domain_getvnuma(xch, domid, &numa->nr_vnodes,
@@ -156,14 +157,140 @@ out:
     return rc;
 }
 
+/*
+ * The tables only depend on the inputs gathered by init_acpi_config(), which
+ * are the same for all guests with identical vCPU count and vNUMA layout.
+ * Toolstacks creating many similar guests from one process would otherwise
+ * re-generate the very same tables every time, so keep the most recently
+ * built sets of tables around.
+ */
+#define ACPI_CACHE_ENTRIES 4
+
+struct acpi_cache_entry {
+    void *key;
+    size_t key_len;
+    void *rsdp, *info, *tables;
+    unsigned int tables_pages;
+};
+
+static struct acpi_cache_entry acpi_cache[ACPI_CACHE_ENTRIES];
+static unsigned int acpi_cache_next;
+static pthread_mutex_t acpi_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Serialise everything the tables are generated from.  Fields of the config
+ * which init_acpi_config() sets to constants aren't included.
+ */
+static void *acpi_cache_key(libxl__gc *gc, const struct acpi_config *config,
+                            unsigned int page_size, size_t *len)
+{
+    const struct acpi_numa *numa = &config->numa;
+    unsigned int nr_vcpus = config->hvminfo->nr_vcpus;
+    size_t vmemrange_sz = numa->nr_vmemranges * sizeof(*numa->vmemrange);
+    size_t vdistance_sz = numa->nr_vnodes * numa->nr_vnodes *
+                          sizeof(*numa->vdistance);
+    size_t vcpu_to_vnode_sz = numa->nr_vnodes ?
+                              nr_vcpus * sizeof(*numa->vcpu_to_vnode) : 0;
+    char *key, *p;
+
+    *len = sizeof(page_size) + sizeof(*config->hvminfo) +
+           sizeof(numa->nr_vnodes) + sizeof(numa->nr_vmemranges) +
+           vmemrange_sz + vdistance_sz + vcpu_to_vnode_sz;
+    p = key = libxl__malloc(gc, *len);
+
+#define APPEND(src, sz) ({ memcpy(p, src, sz); p += (sz); })
+    APPEND(&page_size, sizeof(page_size));
+    APPEND(config->hvminfo, sizeof(*config->hvminfo));
+    APPEND(&numa->nr_vnodes, sizeof(numa->nr_vnodes));
+    APPEND(&numa->nr_vmemranges, sizeof(numa->nr_vmemranges));
+    if (vmemrange_sz)
+        APPEND(numa->vmemrange, vmemrange_sz);
+    if (vdistance_sz)
+        APPEND(numa->vdistance, vdistance_sz);
+    if (vcpu_to_vnode_sz)
+        APPEND(numa->vcpu_to_vnode, vcpu_to_vnode_sz);
+#undef APPEND
+
+    return key;
+}
+
+static bool acpi_cache_lookup(const void *key, size_t key_len,
+                              void *rsdp, void *info, void *tables,
+                              unsigned int page_size,
+                              unsigned int *tables_pages)
+{
+    unsigned int i;
+    bool found = false;
+
+    pthread_mutex_lock(&acpi_cache_lock);
+
+    for (i = 0; i < ACPI_CACHE_ENTRIES; i++) {
+        const struct acpi_cache_entry *e = &acpi_cache[i];
+
+        if (e->key_len != key_len || memcmp(e->key, key, key_len))
+            continue;
+
+        memcpy(rsdp, e->rsdp, page_size);
+        memcpy(info, e->info, page_size);
+        memcpy(tables, e->tables, e->tables_pages * page_size);
+        *tables_pages = e->tables_pages;
+        found = true;
+        break;
+    }
+
+    pthread_mutex_unlock(&acpi_cache_lock);
+
+    return found;
+}
+
+static void acpi_cache_insert(const void *key, size_t key_len,
+                              const void *rsdp, const void *info,
+                              const void *tables, unsigned int page_size,
+                              unsigned int tables_pages)
+{
+    struct acpi_cache_entry n = {
+        .key = malloc(key_len),
+        .key_len = key_len,
+        .rsdp = malloc(page_size),
+        .info = malloc(page_size),
+        .tables = malloc(tables_pages * page_size),
+        .tables_pages = tables_pages,
+    }, old;
+
+    /* Caching is best effort only. */
+    if (!n.key || !n.rsdp || !n.info || !n.tables) {
+        old = n;
+        goto out;
+    }
+
+    memcpy(n.key, key, key_len);
+    memcpy(n.rsdp, rsdp, page_size);
+    memcpy(n.info, info, page_size);
+    memcpy(n.tables, tables, tables_pages * page_size);
+
+    pthread_mutex_lock(&acpi_cache_lock);
+    old = acpi_cache[acpi_cache_next];
+    acpi_cache[acpi_cache_next] = n;
+    acpi_cache_next = (acpi_cache_next + 1) % ACPI_CACHE_ENTRIES;
+    pthread_mutex_unlock(&acpi_cache_lock);
+
+ out:
+    free(old.key);
+    free(old.rsdp);
+    free(old.info);
+    free(old.tables);
+}
+
 int libxl__dom_load_acpi(libxl__gc *gc,
                          const libxl_domain_build_info *b_info,
                          struct xc_dom_image *dom)
 {
     struct acpi_config config = {0};
     struct libxl_acpi_ctxt libxl_ctxt;
-    int rc = 0, acpi_pages_num;
-    void *acpi_pages;
+    int rc = 0;
+    unsigned int acpi_pages_num;
+    void *acpi_pages, *key;
+    size_t key_len;
     unsigned long page_mask;
 
     if (b_info->type != LIBXL_DOMAIN_TYPE_PVH)
@@ -200,18 +327,29 @@ int libxl__dom_load_acpi(libxl__gc *gc,
     libxl_ctxt.alloc_end = (unsigned long)acpi_pages +
         (NUM_ACPI_PAGES * libxl_ctxt.page_size);
 
-    /* Build the tables. */
-    rc = acpi_build_tables(&libxl_ctxt.c, &config);
-    if (rc) {
-        LOG(ERROR, "acpi_build_tables failed with %d", rc);
-        goto out;
-    }
+    key = acpi_cache_key(gc, &config, libxl_ctxt.page_size, &key_len);
+    if (acpi_cache_lookup(key, key_len, (void *)config.rsdp,
+                          (void *)config.infop, acpi_pages,
+                          libxl_ctxt.page_size, &acpi_pages_num)) {
+        LOG(DEBUG, "using cached ACPI tables");
+    } else {
+        /* Build the tables. */
+        rc = acpi_build_tables(&libxl_ctxt.c, &config);
+        if (rc) {
+            LOG(ERROR, "acpi_build_tables failed with %d", rc);
+            goto out;
+        }
 
-    /* Calculate how many pages are needed for the tables. */
-    acpi_pages_num =
-        ((libxl_ctxt.alloc_currp - (unsigned long)acpi_pages)
-         >> libxl_ctxt.page_shift) +
-        ((libxl_ctxt.alloc_currp & page_mask) ? 1 : 0);
+        /* Calculate how many pages are needed for the tables. */
+        acpi_pages_num =
+            ((libxl_ctxt.alloc_currp - (unsigned long)acpi_pages)
+             >> libxl_ctxt.page_shift) +
+            ((libxl_ctxt.alloc_currp & page_mask) ? 1 : 0);
+
+        acpi_cache_insert(key, key_len, (void *)config.rsdp,
+                          (void *)config.infop, acpi_pages,
+                          libxl_ctxt.page_size, acpi_pages_num);
+    }
 
     dom->acpi_modules[0].data = (void *)config.rsdp;
     dom->acpi_modules[0].length = 64;
@@ -25,6 +25,7 @@
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <string.h>
+#include <ctype.h>
 #include <unistd.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -79,22 +80,27 @@ struct xs_handle {
 	bool unwatch_filter;
 
 	/*
-         * A list of replies. Currently only one will ever be outstanding
-         * because we serialise requests. The requester can wait on the
-         * conditional variable for its response.
+         * A list of replies, matched to their requests by req_id. Several
+         * can be outstanding, from pipelined requests or, with a read
+         * thread, from requests of several threads. Requesters wait on the
+         * conditional variable for their response.
          */
 	struct list_head reply_list;
 	pthread_mutex_t reply_mutex;
 	pthread_cond_t reply_condvar;
 
-	/* One request at a time. */
+	/* One request written at a time. */
 	pthread_mutex_t request_mutex;
+	uint32_t req_id;
 
 	/* Lock discipline:
 	 *  Only holder of the request lock may write to h->fd.
-	 *  Only holder of the request lock may access read_thr_exists.
-	 *  If read_thr_exists==0, only holder of request lock may read h->fd;
-	 *  If read_thr_exists==1, only the read thread may read h->fd.
+	 *  Only holder of the request lock may access read_thr_exists and
+	 *  req_id.
+	 *  If read_thr_exists==0, only holder of request lock may read h->fd,
+	 *  so the lock is held until the replies have been read;
+	 *  If read_thr_exists==1, only the read thread may read h->fd, and
+	 *  requesters drop the request lock while waiting for replies.
 	 *  Only holder of the reply lock may access reply_list.
 	 *  Only holder of the watch lock may access watch_list.
 	 * Lock hierarchy:
@@ -108,6 +114,7 @@ struct xs_handle {
 #define mutex_lock(m)		pthread_mutex_lock(m)
 #define mutex_unlock(m)		pthread_mutex_unlock(m)
 #define condvar_signal(c)	pthread_cond_signal(c)
+#define condvar_broadcast(c)	pthread_cond_broadcast(c)
 #define condvar_wait(c,m)	pthread_cond_wait(c,m)
 #define cleanup_push(f, a)	\
     pthread_cleanup_push((void (*)(void *))(f), (void *)(a))
@@ -138,11 +145,13 @@ struct xs_handle {
 	int watch_pipe[2];
 	/* Filtering watch event in unwatch function? */
 	bool unwatch_filter;
+	uint32_t req_id;
 };
 
 #define mutex_lock(m)		((void)0)
 #define mutex_unlock(m)		((void)0)
 #define condvar_signal(c)	((void)0)
+#define condvar_broadcast(c)	((void)0)
 #define condvar_wait(c,m)	((void)0)
 #define cleanup_push(f, a)	((void)0)
 #define cleanup_pop(run)	((void)0)
@@ -442,34 +451,56 @@ static int get_error(const char *errorstring)
 	return xsd_errors[i].errnum;
 }
 
+/* Take the reply to request req_id off the list, if it has arrived. */
+static struct xs_stored_msg *get_reply(struct xs_handle *h, uint32_t req_id)
+{
+	struct xs_stored_msg *msg;
+
+	list_for_each_entry(msg, &h->reply_list, list) {
+		if (msg->hdr.req_id == req_id) {
+			list_del(&msg->list);
+			return msg;
+		}
+	}
+
+	return NULL;
+}
+
 /* Adds extra nul terminator, because we generally (always?) hold strings. */
-static void *read_reply(
-	struct xs_handle *h, enum xsd_sockmsg_type *type, unsigned int *len)
+static void *read_reply(struct xs_handle *h, int read_from_thread,
+			uint32_t req_id, enum xsd_sockmsg_type *type,
+			unsigned int *len)
 {
 	struct xs_stored_msg *msg;
 	char *body;
-	int read_from_thread;
 
-	read_from_thread = read_thread_exists(h);
+	mutex_lock(&h->reply_mutex);
+	for (;;) {
+		msg = get_reply(h, req_id);
+		if (msg)
+			break;
 
-	/* Read from comms channel ourselves if there is no reader thread. */
-	if (!read_from_thread && (read_message(h, 0) == -1))
-		return NULL;
+		if (!read_from_thread) {
+			/* Read from comms channel ourselves. */
+			mutex_unlock(&h->reply_mutex);
+			if (read_message(h, 0) == -1)
+				return NULL;
+			mutex_lock(&h->reply_mutex);
+			continue;
+		}
 
-	mutex_lock(&h->reply_mutex);
 #ifdef USE_PTHREAD
-	while (list_empty(&h->reply_list) && read_from_thread && h->fd != -1)
+		if (h->fd == -1)
+			break;
 		condvar_wait(&h->reply_condvar, &h->reply_mutex);
 #endif
-	if (list_empty(&h->reply_list)) {
-		mutex_unlock(&h->reply_mutex);
+	}
+	mutex_unlock(&h->reply_mutex);
+
+	if (!msg) {
 		errno = EINVAL;
 		return NULL;
 	}
-	msg = list_top(&h->reply_list, struct xs_stored_msg, list);
-	list_del(&msg->list);
-	assert(list_empty(&h->reply_list));
-	mutex_unlock(&h->reply_mutex);
 
 	*type = msg->hdr.type;
 	if (len)
@@ -481,29 +512,76 @@ static void *read_reply(
 	return body;
 }
 
-/* Send message to xs, get malloc'ed reply.  NULL and set errno on error. */
-static void *xs_talkv(struct xs_handle *h, xs_transaction_t t,
-		      enum xsd_sockmsg_type type,
-		      const struct iovec *iovec,
-		      unsigned int num_vecs,
-		      unsigned int *len)
+/* One request of a pipelined batch, see xs_talkv_pipelined(). */
+struct xs_pipelined_req {
+	const struct iovec *iovec;
+	unsigned int num_vecs;
+	uint32_t req_id;
+	/* Result: malloc'ed reply and its length, or NULL and an errno. */
+	void *reply;
+	unsigned int len;
+	int err;
+};
+
+/*
+ * Requests in flight at once on a connection.  The daemon buffers its
+ * replies, but bounding this keeps our replies backlog (and the amount of
+ * work lost if the connection breaks) small.
+ */
+#define XS_PIPELINE_DEPTH 16
+
+static bool xs_send(struct xs_handle *h, xs_transaction_t t,
+		    enum xsd_sockmsg_type type, const struct iovec *iovec,
+		    unsigned int num_vecs, uint32_t req_id)
 {
 	struct xsd_sockmsg msg;
-	void *ret = NULL;
-	int saved_errno;
 	unsigned int i;
-	struct sigaction ignorepipe, oldact;
 
 	msg.tx_id = t;
-	msg.req_id = 0;
+	msg.req_id = req_id;
 	msg.type = type;
 	msg.len = 0;
 	for (i = 0; i < num_vecs; i++)
 		msg.len += iovec[i].iov_len;
 
-	if (msg.len > XENSTORE_PAYLOAD_MAX) {
-		errno = E2BIG;
-		return 0;
+	if (!xs_write_all(h->fd, &msg, sizeof(msg)))
+		return false;
+
+	for (i = 0; i < num_vecs; i++)
+		if (!xs_write_all(h->fd, iovec[i].iov_base, iovec[i].iov_len))
+			return false;
+
+	return true;
+}
+
+/*
+ * Send num requests of one type to xs, writing further requests before
+ * the replies to earlier ones have arrived, and collect the replies.
+ * Returns false and sets errno if the connection failed, in which case it
+ * is closed; otherwise the result of each request is in reqs[].
+ */
+static bool xs_talkv_pipelined(struct xs_handle *h, xs_transaction_t t,
+			       enum xsd_sockmsg_type type,
+			       struct xs_pipelined_req *reqs,
+			       unsigned int num)
+{
+	unsigned int i, sent = 0, done = 0;
+	enum xsd_sockmsg_type reply_type;
+	struct sigaction ignorepipe, oldact;
+	int read_from_thread, saved_errno;
+
+	for (i = 0; i < num; i++) {
+		size_t len = 0, v;
+
+		for (v = 0; v < reqs[i].num_vecs; v++)
+			len += reqs[i].iovec[v].iov_len;
+		if (len > XENSTORE_PAYLOAD_MAX) {
+			errno = E2BIG;
+			return false;
+		}
+		reqs[i].reply = NULL;
+		reqs[i].len = 0;
+		reqs[i].err = 0;
 	}
 
 	ignorepipe.sa_handler = SIG_IGN;
@@ -512,45 +590,87 @@ static void *xs_talkv(struct xs_handle *h, xs_transaction_t t,
 	sigaction(SIGPIPE, &ignorepipe, &oldact);
 
 	mutex_lock(&h->request_mutex);
+	read_from_thread = read_thread_exists(h);
 
-	if (!xs_write_all(h->fd, &msg, sizeof(msg)))
-		goto fail;
+	while (done < num) {
+		while (sent < num && sent - done < XS_PIPELINE_DEPTH) {
+			reqs[sent].req_id = h->req_id++;
+			if (!xs_send(h, t, type, reqs[sent].iovec,
+				     reqs[sent].num_vecs, reqs[sent].req_id))
+				goto fail;
+			sent++;
+		}
 
-	for (i = 0; i < num_vecs; i++)
-		if (!xs_write_all(h->fd, iovec[i].iov_base, iovec[i].iov_len))
+		/* Let other threads send while the read thread gets ours. */
+		if (read_from_thread)
+			mutex_unlock(&h->request_mutex);
+
+		reqs[done].reply = read_reply(h, read_from_thread,
+					      reqs[done].req_id, &reply_type,
+					      &reqs[done].len);
+
+		if (read_from_thread)
+			mutex_lock(&h->request_mutex);
+
+		if (!reqs[done].reply)
 			goto fail;
 
-	ret = read_reply(h, &msg.type, len);
-	if (!ret)
-		goto fail;
+		if (reply_type == XS_ERROR) {
+			reqs[done].err = get_error(reqs[done].reply);
+			free(reqs[done].reply);
+			reqs[done].reply = NULL;
+			reqs[done].len = 0;
+		} else if (reply_type != type) {
+			errno = EBADF;
+			goto fail;
+		}
 
-	mutex_unlock(&h->request_mutex);
+		done++;
+	}
 
+	mutex_unlock(&h->request_mutex);
 	sigaction(SIGPIPE, &oldact, NULL);
-	if (msg.type == XS_ERROR) {
-		saved_errno = get_error(ret);
-		free(ret);
-		errno = saved_errno;
-		return NULL;
-	}
 
-	if (msg.type != type) {
-		free(ret);
-		saved_errno = EBADF;
-		goto close_fd;
-	}
-	return ret;
+	return true;
 
 fail:
 	/* We're in a bad state, so close fd. */
 	saved_errno = errno;
-	mutex_unlock(&h->request_mutex);
-	sigaction(SIGPIPE, &oldact, NULL);
-close_fd:
+	for (i = 0; i < num; i++) {
+		free(reqs[i].reply);
+		reqs[i].reply = NULL;
+	}
 	close(h->fd);
 	h->fd = -1;
+	mutex_unlock(&h->request_mutex);
+	sigaction(SIGPIPE, &oldact, NULL);
 	errno = saved_errno;
-	return NULL;
+	return false;
+}
+
+/* Send message to xs, get malloc'ed reply.  NULL and set errno on error. */
+static void *xs_talkv(struct xs_handle *h, xs_transaction_t t,
+		      enum xsd_sockmsg_type type,
+		      const struct iovec *iovec,
+		      unsigned int num_vecs,
+		      unsigned int *len)
+{
+	struct xs_pipelined_req req = {
+		.iovec = iovec,
+		.num_vecs = num_vecs,
+	};
+
+	if (!xs_talkv_pipelined(h, t, type, &req, 1))
+		return NULL;
+
+	if (req.err) {
+		errno = req.err;
+		return NULL;
+	}
+
+	if (len)
+		*len = req.len;
+	return req.reply;
 }
 
 /* free(), but don't change errno. */
@@ -702,6 +822,196 @@ bool xs_write(struct xs_handle *h, xs_transaction_t t,
 				ARRAY_SIZE(iovec), NULL));
 }
 
+/* Daemons not knowing the batched operations will reject them. */
+static bool xs_multiple_fallback(int err)
+{
+	return err == ENOSYS || err == EINVAL || err == E2BIG;
+}
+
+/* Copy num values (NULL for failed reads) into one allocation. */
+static void **xs_pack_values(char **vals, unsigned int *lens,
+			     unsigned int num)
+{
+	size_t size = num * sizeof(void *);
+	unsigned int i;
+	void **ret;
+	char *p;
+
+	for (i = 0; i < num; i++)
+		if (vals[i])
+			size += lens[i] + 1;
+
+	ret = malloc(size);
+	if (!ret)
+		return NULL;
+
+	p = (char *)&ret[num];
+	for (i = 0; i < num; i++) {
+		if (!vals[i]) {
+			ret[i] = NULL;
+			continue;
+		}
+		memcpy(p, vals[i], lens[i]);
+		p[lens[i]] = '\0';
+		ret[i] = p;
+		p += lens[i] + 1;
+	}
+
+	return ret;
+}
+
+/* Read the files with pipelined XS_READ requests, in one round trip. */
+static void **xs_read_multiple_single(struct xs_handle *h, xs_transaction_t t,
+				      const char *const *paths,
+				      unsigned int num, unsigned int *lens)
+{
+	struct xs_pipelined_req *reqs;
+	struct iovec *iovec;
+	char **vals;
+	void **ret = NULL;
+	unsigned int i;
+
+	reqs = calloc(num, sizeof(*reqs));
+	iovec = calloc(num, sizeof(*iovec));
+	vals = calloc(num, sizeof(*vals));
+	if (!reqs || !iovec || !vals)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		iovec[i].iov_base = (void *)paths[i];
+		iovec[i].iov_len = strlen(paths[i]) + 1;
+		reqs[i].iovec = &iovec[i];
+		reqs[i].num_vecs = 1;
+	}
+
+	if (!xs_talkv_pipelined(h, t, XS_READ, reqs, num))
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		vals[i] = reqs[i].reply;
+		lens[i] = reqs[i].len;
+	}
+
+	ret = xs_pack_values(vals, lens, num);
+
+	for (i = 0; i < num; i++)
+		free_no_errno(vals[i]);
+ out:
+	free_no_errno(vals);
+	free_no_errno(iovec);
+	free_no_errno(reqs);
+
+	return ret;
+}
+
+/* Get the values of num files in one request; see xenstore.h. */
+void **xs_read_multiple(struct xs_handle *h, xs_transaction_t t,
+			const char *const *paths, unsigned int num,
+			unsigned int *lens)
+{
+	struct iovec *iovec;
+	char *reply = NULL, *p, *end, **vals = NULL;
+	unsigned int i, len, vlen;
+	void **ret = NULL;
+
+	if (!num) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	iovec = calloc(num, sizeof(*iovec));
+	vals = calloc(num, sizeof(*vals));
+	if (!iovec || !vals)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		iovec[i].iov_base = (void *)paths[i];
+		iovec[i].iov_len = strlen(paths[i]) + 1;
+	}
+
+	reply = xs_talkv(h, t, XS_READ_MULTIPLE, iovec, num, &len);
+	if (!reply) {
+		if (xs_multiple_fallback(errno))
+			ret = xs_read_multiple_single(h, t, paths, num, lens);
+		goto out;
+	}
+
+	for (p = reply, end = reply + len, i = 0; i < num; i++) {
+		if (p >= end)
+			goto eio;
+		if (!isdigit((unsigned char)*p)) {
+			/* Per-path error. */
+			vals[i] = NULL;
+			lens[i] = 0;
+			p += strlen(p) + 1;
+			continue;
+		}
+		vlen = strtoul(p, NULL, 10);
+		p += strlen(p) + 1;
+		if (vlen > end - p)
+			goto eio;
+		vals[i] = p;
+		lens[i] = vlen;
+		p += vlen;
+	}
+
+	ret = xs_pack_values(vals, lens, num);
+	goto out;
+
+ eio:
+	errno = EIO;
+ out:
+	free_no_errno(reply);
+	free_no_errno(vals);
+	free_no_errno(iovec);
+	return ret;
+}
+
+/* Write the values of num files in one request; see xenstore.h. */
+bool xs_write_multiple(struct xs_handle *h, xs_transaction_t t,
+		       const char *const *paths, const void *const *data,
+		       const unsigned int *lens, unsigned int num)
+{
+	struct iovec *iovec;
+	char (*lenstr)[12];
+	unsigned int i;
+	bool ret = false;
+
+	if (!num) {
+		errno = EINVAL;
+		return false;
+	}
+
+	iovec = calloc(num * 3, sizeof(*iovec));
+	lenstr = calloc(num, sizeof(*lenstr));
+	if (!iovec || !lenstr)
+		goto out;
+
+	for (i = 0; i < num; i++) {
+		snprintf(lenstr[i], sizeof(lenstr[i]), "%u", lens[i]);
+		iovec[i * 3].iov_base = (void *)paths[i];
+		iovec[i * 3].iov_len = strlen(paths[i]) + 1;
+		iovec[i * 3 + 1].iov_base = lenstr[i];
+		iovec[i * 3 + 1].iov_len = strlen(lenstr[i]) + 1;
+		iovec[i * 3 + 2].iov_base = (void *)data[i];
+		iovec[i * 3 + 2].iov_len = lens[i];
+	}
+
+	ret = xs_bool(xs_talkv(h, t, XS_WRITE_MULTIPLE, iovec, num * 3, NULL));
+	if (!ret && xs_multiple_fallback(errno)) {
+		/* Writes are idempotent, so partial success doesn't matter. */
+		for (i = 0; i < num; i++)
+			if (!xs_write(h, t, paths[i], data[i], lens[i]))
+				goto out;
+		ret = true;
+	}
+
+ out:
+	free_no_errno(lenstr);
+	free_no_errno(iovec);
+	return ret;
+}
+
 /* Create a new directory.
  * Returns false on failure, or success if it already exists.
  */
@@ -1292,15 +1602,9 @@ static int read_message(struct xs_handle *h, int nonblocking)
 	} else {
 		mutex_lock(&h->reply_mutex);
 
-		/* There should only ever be one response pending! */
-		if (!list_empty(&h->reply_list)) {
-			mutex_unlock(&h->reply_mutex);
-			saved_errno = EEXIST;
-			goto error_freebody;
-		}
-
 		list_add_tail(&msg->list, &h->reply_list);
-		condvar_signal(&h->reply_condvar);
+		/* Several requesters may be waiting for different replies. */
+		condvar_broadcast(&h->reply_condvar);
 
 		mutex_unlock(&h->reply_mutex);
 	}
@@ -0,0 +1,337 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include <xentoollog.h>
+#include <xenctrl.h>
+#include <xenevtchn.h>
+#include <xenforeignmemory.h>
+#include <xentrace.h>
+
+#define DEFAULT_TBUF_PAGES 32
+
+#define PERROR(_f...) \
+    xtl_log(xth->logger, XTL_ERROR, errno, "xentrace", _f)
+
+struct xentrace_cpu {
+    struct t_buf *meta;         /* NULL if the CPU has no buffer. */
+    const unsigned char *data;
+    uint32_t cursor;            /* Next record to hand out, cf. meta->cons. */
+};
+
+struct xentrace_handle {
+    xentoollog_logger *logger, *logger_tofree;
+    xc_interface *xch;
+    xenevtchn_handle *xce;
+    xenforeignmemory_handle *fmem;
+
+    const struct t_info *t_info;
+    size_t t_info_pages;
+    uint32_t data_size;         /* Bytes of records in each buffer. */
+
+    unsigned int nr_cpus;
+    struct xentrace_cpu *cpus;
+};
+
+static int map_cpu_buffers(xentrace_handle *xth, size_t t_info_size)
+{
+    unsigned int tbuf_size = xth->t_info->tbuf_size, cpu, i;
+    xen_pfn_t *pfns;
+
+    if (!tbuf_size) {
+        errno = ENODATA;
+        PERROR("Trace buffers have no size");
+        return -1;
+    }
+
+    xth->data_size = tbuf_size * XC_PAGE_SIZE - sizeof(struct t_buf);
+
+    pfns = calloc(tbuf_size, sizeof(*pfns));
+    if (!pfns)
+        return -1;
+
+    for (cpu = 0; cpu < xth->nr_cpus; cpu++) {
+        struct xentrace_cpu *c = &xth->cpus[cpu];
+        unsigned int offset = xth->t_info->mfn_offset[cpu];
+        const uint32_t *mfns = (const uint32_t *)xth->t_info + offset;
+
+        /* CPUs which weren't online when tracing was set up have none. */
+        if (!offset)
+            continue;
+
+        if ((offset + tbuf_size) * sizeof(*mfns) > t_info_size) {
+            errno = EILSEQ;
+            PERROR("Bad MFN list offset %u for CPU%u", offset, cpu);
+            goto err;
+        }
+
+        for (i = 0; i < tbuf_size; i++)
+            pfns[i] = mfns[i];
+
+        c->meta = xenforeignmemory_map(xth->fmem, DOMID_XEN,
+                                       PROT_READ | PROT_WRITE,
+                                       tbuf_size, pfns, NULL);
+        if (!c->meta) {
+            PERROR("Failed to map the trace buffer of CPU%u", cpu);
+            goto err;
+        }
+
+        c->data = (const unsigned char *)(c->meta + 1);
+        c->cursor = c->meta->cons;
+    }
+
+    free(pfns);
+    return 0;
+
+err:
+    free(pfns);
+    return -1;
+}
+
+xentrace_handle *xentrace_open(xentoollog_logger *logger,
+                               unsigned long tbuf_pages,
+                               unsigned int open_flags)
+{
+    xentrace_handle *xth;
+    xc_physinfo_t physinfo = {};
+    unsigned long t_info_mfn = 0, t_info_size = 0;
+    xen_pfn_t *pfns;
+    size_t i;
+
+    if (open_flags) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    xth = calloc(1, sizeof(*xth));
+    if (!xth)
+        return NULL;
+
+    xth->logger = logger;
+    if (!xth->logger) {
+        xth->logger = xth->logger_tofree =
+            (xentoollog_logger*)
+            xtl_createlogger_stdiostream(stderr, XTL_PROGRESS, 0);
+        if (!xth->logger)
+            goto err;
+    }
+
+    xth->xch = xc_interface_open(xth->logger, xth->logger, 0);
+    xth->xce = xenevtchn_open(xth->logger, 0);
+    xth->fmem = xenforeignmemory_open(xth->logger, 0);
+    if (!xth->xch || !xth->xce || !xth->fmem)
+        goto err;
+
+    if (xc_physinfo(xth->xch, &physinfo)) {
+        PERROR("Failed to get the number of CPUs");
+        goto err;
+    }
+    xth->nr_cpus = physinfo.max_cpu_id + 1;
+
+    xth->cpus = calloc(xth->nr_cpus, sizeof(*xth->cpus));
+    if (!xth->cpus)
+        goto err;
+
+    if (xenevtchn_bind_virq(xth->xce, VIRQ_TBUF) < 0) {
+        PERROR("Failed to bind VIRQ_TBUF");
+        goto err;
+    }
+
+    if (xc_tbuf_enable(xth->xch, tbuf_pages ?: DEFAULT_TBUF_PAGES,
+                       &t_info_mfn, &t_info_size) || !t_info_size) {
+        PERROR("Failed to enable tracing");
+        goto err;
+    }
+
+    /* The metadata is a physically contiguous Xen heap allocation. */
+    xth->t_info_pages = (t_info_size + XC_PAGE_SIZE - 1) >> XC_PAGE_SHIFT;
+    pfns = calloc(xth->t_info_pages, sizeof(*pfns));
+    if (!pfns)
+        goto err;
+
+    for (i = 0; i < xth->t_info_pages; i++)
+        pfns[i] = t_info_mfn + i;
+
+    xth->t_info = xenforeignmemory_map(xth->fmem, DOMID_XEN, PROT_READ,
+                                       xth->t_info_pages, pfns, NULL);
+    free(pfns);
+    if (!xth->t_info) {
+        PERROR("Failed to map the trace buffer metadata");
+        goto err;
+    }
+
+    if (map_cpu_buffers(xth, t_info_size))
+        goto err;
+
+    return xth;
+
+err:
+    xentrace_close(xth);
+    return NULL;
+}
+
+int xentrace_close(xentrace_handle *xth)
+{
+    unsigned int cpu;
+
+    if (!xth)
+        return 0;
+
+    if (xth->cpus) {
+        for (cpu = 0; cpu < xth->nr_cpus; cpu++)
+            if (xth->cpus[cpu].meta)
+                xenforeignmemory_unmap(xth->fmem, xth->cpus[cpu].meta,
+                                       xth->t_info->tbuf_size);
+        free(xth->cpus);
+    }
+
+    if (xth->t_info)
+        xenforeignmemory_unmap(xth->fmem, (void *)xth->t_info,
+                               xth->t_info_pages);
+
+    xenforeignmemory_close(xth->fmem);
+    xenevtchn_close(xth->xce);
+    xc_interface_close(xth->xch);
+    xtl_logger_destroy(xth->logger_tofree);
+    free(xth);
+    return 0;
+}
+
+unsigned int xentrace_nr_cpus(xentrace_handle *xth)
+{
+    return xth->nr_cpus;
+}
+
+int xentrace_fd(xentrace_handle *xth)
+{
+    return xenevtchn_fd(xth->xce);
+}
+
+int xentrace_wait(xentrace_handle *xth, int timeout_ms)
+{
+    struct pollfd fd = { .fd = xenevtchn_fd(xth->xce), .events = POLLIN };
+    xenevtchn_port_or_error_t port;
+    int rc;
+
+    rc = poll(&fd, 1, timeout_ms);
+    if (rc <= 0)
+        return rc;
+
+    port = xenevtchn_pending(xth->xce);
+    if (port < 0 || xenevtchn_unmask(xth->xce, port))
+        return -1;
+
+    return 1;
+}
+
+const struct t_rec *xentrace_next(xentrace_handle *xth, unsigned int cpu)
+{
+    struct xentrace_cpu *c = &xth->cpus[cpu];
+    uint32_t data_size = xth->data_size;
+
+    errno = 0;
+    if (!c->meta)
+        return NULL;
+
+    for (;;) {
+        /* cons and prod run modulo twice the buffer size, cf. struct t_buf. */
+        uint32_t prod = c->meta->prod, offset, size, avail;
+        const struct t_rec *rec;
+
+        xen_rmb(); /* read prod, then read item. */
+
+        if (c->cursor == prod)
+            return NULL;
+        if (prod >= 2 * data_size)
+            goto bogus;
+
+        avail = prod > c->cursor ? prod - c->cursor
+                                 : prod + 2 * data_size - c->cursor;
+        offset = c->cursor % data_size;
+        rec = (const struct t_rec *)(c->data + offset);
+        size = XENTRACE_REC_SIZE(rec);
+
+        /* Xen pads the end of the buffer rather than wrap records around. */
+        if (size > avail || size > data_size - offset)
+            goto bogus;
+
+        c->cursor += size;
+        if (c->cursor >= 2 * data_size)
+            c->cursor -= 2 * data_size;
+
+        if (rec->event != TRC_TRACE_WRAP_BUFFER)
+            return rec;
+    }
+
+bogus:
+    errno = EILSEQ;
+    PERROR("Corrupt trace buffer on CPU%u: cons %#x prod %#x",
+           cpu, c->cursor, c->meta->prod);
+    return NULL;
+}
+
+void xentrace_release(xentrace_handle *xth, unsigned int cpu)
+{
+    struct xentrace_cpu *c = &xth->cpus[cpu];
+
+    if (!c->meta)
+        return;
+
+    xen_mb(); /* read buffer, then update cons. */
+    c->meta->cons = c->cursor;
+}
+
+int xentrace_consume(xentrace_handle *xth, xentrace_record_fn *fn, void *arg)
+{
+    unsigned int cpu;
+    int nr = 0;
+
+    for (cpu = 0; cpu < xth->nr_cpus; cpu++) {
+        struct xentrace_cpu *c = &xth->cpus[cpu];
+        uint32_t cursor = c->cursor;
+        const struct t_rec *rec;
+
+        while ((rec = xentrace_next(xth, cpu))) {
+            if (fn(arg, cpu, rec)) {
+                /* Leave the rejected record for next time. */
+                c->cursor = cursor;
+                xentrace_release(xth, cpu);
+                return nr;
+            }
+            cursor = c->cursor;
+            nr++;
+        }
+
+        xentrace_release(xth, cpu);
+        if (errno)
+            return -1;
+    }
+
+    return nr;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -208,19 +208,25 @@ int libxenvchan_wait(struct libxenvchan *ctrl)
  *
  * caller must have checked that enough space is available
  */
-static int do_send(struct libxenvchan *ctrl, const void *data, size_t size)
+static void copy_to_ring(struct libxenvchan *ctrl, uint32_t prod,
+                         const void *data, size_t size)
 {
-	int real_idx = wr_prod(ctrl) & (wr_ring_size(ctrl) - 1);
+	int real_idx = prod & (wr_ring_size(ctrl) - 1);
 	int avail_contig = wr_ring_size(ctrl) - real_idx;
 	if (avail_contig > size)
 		avail_contig = size;
-	xen_mb(); /* read indexes /then/ write data */
 	memcpy(wr_ring(ctrl) + real_idx, data, avail_contig);
 	if (avail_contig < size)
 	{
 		// we rolled across the end of the ring
 		memcpy(wr_ring(ctrl), data + avail_contig, size - avail_contig);
 	}
+}
+
+static int do_send(struct libxenvchan *ctrl, const void *data, size_t size)
+{
+	xen_mb(); /* read indexes /then/ write data */
+	copy_to_ring(ctrl, wr_prod(ctrl), data, size);
 	xen_wmb(); /* write data /then/ notify */
 	wr_prod(ctrl) += size;
 	if (send_notify(ctrl, VCHAN_NOTIFY_WRITE))
@@ -279,6 +285,50 @@ int libxenvchan_write(struct libxenvchan *ctrl, const void *data, size_t size)
 	}
 }
 
+/**
+ * Gather-send: all segments are copied into the ring before the producer
+ * index is published, so the peer sees (and is notified about) them once.
+ * returns 0 if nonblocking and insufficient space is available, -1 on error,
+ * or the total size on success
+ */
+int libxenvchan_writev(struct libxenvchan *ctrl, const struct iovec *iov,
+                       int iovcnt)
+{
+	size_t size = 0, pos = 0;
+	uint32_t prod;
+	int i, avail;
+
+	for (i = 0; i < iovcnt; i++)
+		size += iov[i].iov_len;
+	if (size > wr_ring_size(ctrl))
+		return -1;
+	while (1) {
+		if (!libxenvchan_is_open(ctrl))
+			return -1;
+		avail = fast_get_buffer_space(ctrl, size);
+		if (size <= avail)
+			break;
+		if (!ctrl->blocking)
+			return 0;
+		if (libxenvchan_wait(ctrl))
+			return -1;
+	}
+	if (size == 0)
+		return 0;
+
+	xen_mb(); /* read indexes /then/ write data */
+	prod = wr_prod(ctrl);
+	for (i = 0; i < iovcnt; i++) {
+		copy_to_ring(ctrl, prod + pos, iov[i].iov_base, iov[i].iov_len);
+		pos += iov[i].iov_len;
+	}
+	xen_wmb(); /* write data /then/ notify */
+	wr_prod(ctrl) = prod + size;
+	if (send_notify(ctrl, VCHAN_NOTIFY_WRITE))
+		return -1;
+	return size;
+}
+
 /**
  * returns -1 on error, or size on success
  *
@@ -342,6 +392,47 @@ int libxenvchan_read(struct libxenvchan *ctrl, void *data, size_t size)
 	}
 }
 
+/**
+ * Zero-copy receive: point the caller at the data in the ring rather than
+ * copying it out. Only the part up to the end of the ring is returned;
+ * the remainder becomes visible after the caller consumes this part.
+ */
+int libxenvchan_read_peek(struct libxenvchan *ctrl, const void **data)
+{
+	int avail, real_idx, avail_contig;
+
+	while (1) {
+		avail = fast_get_data_ready(ctrl, 1);
+		if (avail)
+			break;
+		if (!libxenvchan_is_open(ctrl))
+			return -1;
+		if (!ctrl->blocking)
+			return 0;
+		if (libxenvchan_wait(ctrl))
+			return -1;
+	}
+
+	real_idx = rd_cons(ctrl) & (rd_ring_size(ctrl) - 1);
+	avail_contig = rd_ring_size(ctrl) - real_idx;
+	if (avail_contig > avail)
+		avail_contig = avail;
+	xen_rmb(); /* data read must happen /after/ rd_cons read */
+	*data = rd_ring(ctrl) + real_idx;
+	return avail_contig;
+}
+
+int libxenvchan_read_consume(struct libxenvchan *ctrl, size_t size)
+{
+	if (size > raw_get_data_ready(ctrl))
+		return -1;
+	xen_mb(); /* consume /then/ notify */
+	rd_cons(ctrl) += size;
+	if (send_notify(ctrl, VCHAN_NOTIFY_READ))
+		return -1;
+	return size;
+}
+
 int libxenvchan_is_open(struct libxenvchan* ctrl)
 {
 	if (ctrl->is_server)
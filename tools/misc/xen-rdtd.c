@@ -0,0 +1,526 @@
+/*
+ * xen-rdtd: closed-loop L3 cache and memory bandwidth allocation.
+ *
+ * Uses the RDT monitoring Xen exposes (CMT cache occupancy and MBM total
+ * memory bandwidth) to drive the allocation features (L3 CAT and MBA) once
+ * per interval, on one socket:
+ *
+ *  - The domains named on the command line are "protected": they share one
+ *    L3 partition, which grows by a way while their combined occupancy fills
+ *    it and shrinks by a way when they use less than half of it.  All other
+ *    domains share the remaining ways.
+ *
+ *  - With a bandwidth budget (-b), the combined memory bandwidth of all other
+ *    domains is kept under it by stepping their MBA throttle up and down.
+ *    Protected domains are never throttled.
+ *
+ * usage: xen-rdtd [-i MS] [-s SOCKET] [-w WAYS] [-b MBPS] [-v] DOMID...
+ *
+ * On SIGINT / SIGTERM the default (unrestricted) allocation is restored and
+ * the monitoring IDs attached by xen-rdtd are released.
+ */
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; version 2.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xenctrl.h>
+
+/* MBM counters are at least 24 bits wide; deltas are taken modulo that. */
+#define MBM_COUNTER_MASK  ((1ULL << 24) - 1)
+
+#define MAX_DOMAINS 1024
+
+struct dom {
+    uint32_t domid;
+    bool protected;
+    bool seen;          /* Present in the latest domain scan. */
+    bool attached;      /* RMID attached by us, to be released on exit. */
+    bool monitored;     /* Has an RMID. */
+    bool have_mbm;
+    uint64_t last_mbm;
+    uint64_t occupancy; /* Bytes of L3, latest sample. */
+    uint64_t bandwidth; /* Bytes per second, latest sample. */
+    uint64_t cbm;       /* Allocation last applied, ~0 if none yet. */
+    unsigned int thrtl;
+};
+
+static xc_interface *xch;
+static struct dom doms[MAX_DOMAINS];
+static unsigned int nr_doms;
+static uint32_t protected_ids[MAX_DOMAINS];
+static unsigned int nr_protected;
+
+static uint32_t socket, cpu;
+static unsigned int interval_ms = 1000, min_ways = 1, verbose;
+static uint64_t bw_budget; /* Bytes per second, 0 for no MBA control. */
+static uint32_t upscaling_factor;
+
+static bool have_cat, cdp, have_mba, mba_linear;
+static unsigned int cbm_len, thrtl_max;
+static unsigned int prot_ways, bg_thrtl;
+static uint64_t way_bytes;
+
+static volatile sig_atomic_t stop;
+
+static void handle_signal(int sig)
+{
+    stop = 1;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int pick_socket_cpu(void)
+{
+    xc_cputopo_t *cputopo;
+    unsigned int max_cpus = 0, i;
+    int rc = -1;
+
+    if ( xc_cputopoinfo(xch, &max_cpus, NULL) )
+        return -1;
+
+    cputopo = calloc(max_cpus, sizeof(*cputopo));
+    if ( !cputopo )
+        return -1;
+
+    if ( !xc_cputopoinfo(xch, &max_cpus, cputopo) )
+        for ( i = 0; i < max_cpus; i++ )
+            if ( cputopo[i].socket == socket )
+            {
+                cpu = i;
+                rc = 0;
+                break;
+            }
+
+    free(cputopo);
+
+    return rc;
+}
+
+/* Contiguous masks: protected domains take the top ways, others the rest. */
+static uint64_t dom_cbm(const struct dom *d)
+{
+    unsigned int bg_ways = cbm_len - prot_ways;
+
+    if ( d->protected )
+        return ((1ULL << prot_ways) - 1) << bg_ways;
+
+    return (1ULL << bg_ways) - 1;
+}
+
+static unsigned int thrtl_step_up(unsigned int t)
+{
+    if ( mba_linear )
+        t += 100 - thrtl_max;
+    else
+        t = t ? t * 2 : 1;
+
+    return t > thrtl_max ? thrtl_max : t;
+}
+
+static unsigned int thrtl_step_down(unsigned int t)
+{
+    if ( mba_linear )
+        return t > 100 - thrtl_max ? t - (100 - thrtl_max) : 0;
+
+    return t / 2;
+}
+
+static int set_cbm(uint32_t domid, uint64_t cbm)
+{
+    if ( !cdp )
+        return xc_psr_set_domain_data(xch, domid, XC_PSR_CAT_L3_CBM,
+                                      socket, cbm);
+
+    return xc_psr_set_domain_data(xch, domid, XC_PSR_CAT_L3_CBM_CODE,
+                                  socket, cbm) ||
+           xc_psr_set_domain_data(xch, domid, XC_PSR_CAT_L3_CBM_DATA,
+                                  socket, cbm);
+}
+
+static void apply(struct dom *d)
+{
+    uint64_t cbm;
+    unsigned int thrtl;
+
+    if ( have_cat && (cbm = dom_cbm(d)) != d->cbm )
+    {
+        if ( set_cbm(d->domid, cbm) )
+            fprintf(stderr, "d%u: failed to set CBM %#"PRIx64": %s\n",
+                    d->domid, cbm, strerror(errno));
+        else
+            d->cbm = cbm;
+    }
+
+    thrtl = d->protected ? 0 : bg_thrtl;
+    if ( have_mba && bw_budget && thrtl != d->thrtl )
+    {
+        if ( xc_psr_set_domain_data(xch, d->domid, XC_PSR_MBA_THRTL,
+                                    socket, thrtl) )
+            fprintf(stderr, "d%u: failed to set MBA throttle %u: %s\n",
+                    d->domid, thrtl, strerror(errno));
+        else
+            d->thrtl = thrtl;
+    }
+}
+
+static void forget(unsigned int i)
+{
+    doms[i] = doms[--nr_doms];
+}
+
+static struct dom *lookup(uint32_t domid)
+{
+    unsigned int i;
+
+    for ( i = 0; i < nr_doms; i++ )
+        if ( doms[i].domid == domid )
+            return &doms[i];
+
+    return NULL;
+}
+
+static void scan_domains(void)
+{
+    static xc_domaininfo_t info[MAX_DOMAINS];
+    unsigned int i, j;
+    int nr;
+
+    nr = xc_domain_getinfolist(xch, 0, MAX_DOMAINS, info);
+    if ( nr < 0 )
+    {
+        perror("xc_domain_getinfolist");
+        return;
+    }
+
+    for ( i = 0; i < nr_doms; i++ )
+        doms[i].seen = false;
+
+    for ( j = 0; j < nr; j++ )
+    {
+        struct dom *d;
+        uint32_t rmid;
+
+        if ( info[j].flags & (XEN_DOMINF_dying | XEN_DOMINF_shutdown) )
+            continue;
+
+        d = lookup(info[j].domain);
+        if ( d )
+        {
+            d->seen = true;
+            continue;
+        }
+
+        if ( nr_doms == MAX_DOMAINS )
+            break;
+
+        d = &doms[nr_doms++];
+        memset(d, 0, sizeof(*d));
+        d->domid = info[j].domain;
+        d->seen = true;
+        d->cbm = ~0ULL;
+
+        for ( i = 0; i < nr_protected; i++ )
+            if ( protected_ids[i] == d->domid )
+                d->protected = true;
+
+        if ( !xc_psr_cmt_get_domain_rmid(xch, d->domid, &rmid) && rmid )
+            d->monitored = true;
+        else if ( !xc_psr_cmt_attach(xch, d->domid) )
+            d->monitored = d->attached = true;
+        else if ( verbose )
+            fprintf(stderr, "d%u: not monitored: %s\n",
+                    d->domid, strerror(errno));
+    }
+
+    /* Domains which have gone away take their RMIDs with them. */
+    for ( i = 0; i < nr_doms; )
+        if ( !doms[i].seen )
+            forget(i);
+        else
+            i++;
+}
+
+static void sample(struct dom *d, uint64_t elapsed_ns)
+{
+    uint32_t rmid;
+    uint64_t data;
+
+    d->occupancy = d->bandwidth = 0;
+
+    if ( !d->monitored || xc_psr_cmt_get_domain_rmid(xch, d->domid, &rmid) ||
+         !rmid )
+        return;
+
+    if ( !xc_psr_cmt_get_data(xch, rmid, cpu, XC_PSR_CMT_L3_OCCUPANCY,
+                              &data, NULL) )
+        d->occupancy = data * upscaling_factor;
+
+    if ( !bw_budget ||
+         xc_psr_cmt_get_data(xch, rmid, cpu, XC_PSR_CMT_TOTAL_MEM_COUNT,
+                             &data, NULL) )
+        return;
+
+    if ( d->have_mbm && elapsed_ns )
+        d->bandwidth = ((data - d->last_mbm) & MBM_COUNTER_MASK) *
+                       upscaling_factor * 1000000000ull / elapsed_ns;
+
+    d->last_mbm = data;
+    d->have_mbm = true;
+}
+
+static void control(uint64_t elapsed_ns)
+{
+    uint64_t prot_occ = 0, bg_bw = 0, alloc;
+    unsigned int i;
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        sample(&doms[i], elapsed_ns);
+
+        if ( doms[i].protected )
+            prot_occ += doms[i].occupancy;
+        else
+            bg_bw += doms[i].bandwidth;
+    }
+
+    if ( have_cat && nr_protected )
+    {
+        alloc = prot_ways * way_bytes;
+
+        if ( prot_occ * 10 > alloc * 9 && prot_ways + min_ways < cbm_len )
+            prot_ways++;
+        else if ( prot_occ * 2 < alloc && prot_ways > min_ways )
+            prot_ways--;
+    }
+
+    if ( have_mba && bw_budget )
+    {
+        if ( bg_bw > bw_budget )
+            bg_thrtl = thrtl_step_up(bg_thrtl);
+        else if ( bg_bw * 4 < bw_budget * 3 )
+            bg_thrtl = thrtl_step_down(bg_thrtl);
+    }
+
+    if ( verbose )
+        printf("protected: %"PRIu64" KiB in %u ways, others: %"PRIu64
+               " MB/s throttled %u%%\n", prot_occ >> 10, prot_ways,
+               bg_bw / 1000000, bg_thrtl);
+
+    for ( i = 0; i < nr_doms; i++ )
+        apply(&doms[i]);
+}
+
+static void restore(void)
+{
+    unsigned int i;
+
+    for ( i = 0; i < nr_doms; i++ )
+    {
+        if ( have_cat && doms[i].cbm != ~0ULL )
+            set_cbm(doms[i].domid, (1ULL << cbm_len) - 1);
+        if ( have_mba && doms[i].thrtl )
+            xc_psr_set_domain_data(xch, doms[i].domid, XC_PSR_MBA_THRTL,
+                                   socket, 0);
+        if ( doms[i].attached )
+            xc_psr_cmt_detach(xch, doms[i].domid);
+    }
+}
+
+static int probe(void)
+{
+    xc_psr_hw_info hw_info;
+    uint32_t l3_kb;
+
+    if ( !xc_psr_cmt_enabled(xch) )
+    {
+        fprintf(stderr, "Cache monitoring is not enabled in Xen\n");
+        return -1;
+    }
+
+    if ( pick_socket_cpu() )
+    {
+        fprintf(stderr, "No CPU found on socket %u\n", socket);
+        return -1;
+    }
+
+    if ( xc_psr_cmt_get_l3_upscaling_factor(xch, &upscaling_factor) ||
+         xc_psr_cmt_get_l3_cache_size(xch, cpu, &l3_kb) )
+    {
+        perror("Failed to get L3 monitoring parameters");
+        return -1;
+    }
+
+    if ( !xc_psr_get_hw_info(xch, socket, XC_PSR_CAT_L3, &hw_info) &&
+         hw_info.cat.cbm_len > 2 * min_ways && hw_info.cat.cbm_len < 64 )
+    {
+        have_cat = true;
+        cdp = hw_info.cat.cdp_enabled;
+        cbm_len = hw_info.cat.cbm_len;
+        way_bytes = (uint64_t)l3_kb * 1024 / cbm_len;
+        prot_ways = nr_protected ? cbm_len / 2 : 0;
+    }
+    else if ( nr_protected )
+        fprintf(stderr, "L3 CAT unavailable, not partitioning the cache\n");
+
+    if ( bw_budget )
+    {
+        uint32_t event_mask;
+
+        if ( xc_psr_cmt_get_l3_event_mask(xch, &event_mask) ||
+             !(event_mask & (1u << XC_PSR_CMT_TOTAL_MEM_COUNT)) )
+        {
+            fprintf(stderr, "Memory bandwidth monitoring unavailable\n");
+            bw_budget = 0;
+        }
+        else if ( xc_psr_get_hw_info(xch, socket, XC_PSR_MBA, &hw_info) ||
+                  !hw_info.mba.thrtl_max || hw_info.mba.thrtl_max >= 100 )
+        {
+            fprintf(stderr, "MBA unavailable, not throttling bandwidth\n");
+            bw_budget = 0;
+        }
+        else
+        {
+            have_mba = true;
+            thrtl_max = hw_info.mba.thrtl_max;
+            mba_linear = hw_info.mba.linear;
+        }
+    }
+
+    if ( !have_cat && !have_mba )
+    {
+        fprintf(stderr, "Nothing to control\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-i MS] [-s SOCKET] [-w WAYS] [-b MBPS] [-v] DOMID...\n"
+            "  -i MS      control interval (default 1000)\n"
+            "  -s SOCKET  socket to control (default 0)\n"
+            "  -w WAYS    minimum L3 ways for either partition (default 1)\n"
+            "  -b MBPS    memory bandwidth budget for unprotected domains,\n"
+            "             in MB/s (default: no bandwidth control)\n"
+            "  -v         report each interval\n"
+            "  DOMID...   protected domains\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    struct sigaction sa = { .sa_handler = handle_signal };
+    uint64_t last;
+    int opt;
+
+    while ( (opt = getopt(argc, argv, "i:s:w:b:vh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'i':
+            interval_ms = strtoul(optarg, NULL, 0);
+            break;
+        case 's':
+            socket = strtoul(optarg, NULL, 0);
+            break;
+        case 'w':
+            min_ways = strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            bw_budget = strtoull(optarg, NULL, 0) * 1000000;
+            break;
+        case 'v':
+            verbose++;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if ( !interval_ms || !min_ways || argc - optind > MAX_DOMAINS )
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    for ( ; optind < argc; optind++ )
+        protected_ids[nr_protected++] = strtoul(argv[optind], NULL, 0);
+
+    xch = xc_interface_open(NULL, NULL, 0);
+    if ( !xch )
+    {
+        perror("xc_interface_open");
+        return 1;
+    }
+
+    if ( probe() )
+    {
+        xc_interface_close(xch);
+        return 1;
+    }
+
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    scan_domains();
+    last = now_ns();
+    control(0);
+
+    while ( !stop )
+    {
+        uint64_t now;
+
+        usleep(interval_ms * 1000);
+        if ( stop )
+            break;
+
+        scan_domains();
+        now = now_ns();
+        control(now - last);
+        last = now;
+    }
+
+    restore();
+    xc_interface_close(xch);
+
+    return 0;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
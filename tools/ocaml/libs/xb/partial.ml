@@ -20,7 +20,8 @@ type pkt =
 	rid: int;
 	ty: Op.operation;
 	len: int;
-	buf: Buffer.t;
+	buf: bytes;
+	mutable off: int;
 }
 
 external header_size: unit -> int = "stub_header_size"
@@ -42,12 +43,29 @@ let of_string s =
 		rid = rid;
 		ty = (Op.of_cval opint);
 		len = dlen;
-		buf = Buffer.create dlen;
+		buf = Bytes.create dlen;
+		off = 0;
 	}
 
+(* The payload buffer is allocated once at its final size when the header
+   arrives; data is either blitted with [append] or read straight into
+   [buf] at [off] and accounted with [advance]. *)
+let advance pkt sz =
+	if pkt.off + sz > pkt.len then failwith "Partial.advance: packet overflow";
+	pkt.off <- pkt.off + sz
+
 let append pkt s sz =
-	if pkt.len > 4096 then failwith "Buffer.add: cannot grow buffer";
-	Buffer.add_string pkt.buf (String.sub s 0 sz)
+	if pkt.off + sz > pkt.len then failwith "Partial.append: packet overflow";
+	Bytes.blit s 0 pkt.buf pkt.off sz;
+	pkt.off <- pkt.off + sz
 
 let to_complete pkt =
-	pkt.len - (Buffer.length pkt.buf)
+	pkt.len - pkt.off
+
+(* Hand the completed payload over without copying it.  The packet must not
+   be appended to afterwards. *)
+let contents pkt =
+	if pkt.off = Bytes.length pkt.buf then
+		Bytes.unsafe_to_string pkt.buf
+	else
+		Bytes.sub_string pkt.buf 0 pkt.off
@@ -3,7 +3,8 @@ type pkt = {
   rid : int;
   ty : Op.operation;
   len : int;
-  buf : Buffer.t;
+  buf : bytes;
+  mutable off : int;
 }
 external header_size : unit -> int = "stub_header_size"
 external header_of_string_internal : string -> int * int * int * int
@@ -11,5 +12,7 @@ external header_of_string_internal : string -> int * int * int * int
 val xenstore_payload_max : int
 val xenstore_rel_path_max : int
 val of_string : string -> pkt
-val append : pkt -> string -> int -> unit
+val advance : pkt -> int -> unit
+val append : pkt -> bytes -> int -> unit
 val to_complete : pkt -> int
+val contents : pkt -> string
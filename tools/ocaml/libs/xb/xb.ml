@@ -69,25 +69,39 @@ let reconnect t = match t.backend with
 
 let queue con pkt = Queue.push pkt con.pkt_out
 
-let read_fd back _con b len =
-	let rd = Unix.read back.fd b 0 len in
+let read_fd_at back _con b off len =
+	let rd = Unix.read back.fd b off len in
 	if rd = 0 then
 		raise End_of_file;
 	rd
 
-let read_mmap back _con b len =
-	let s = Bytes.make len '\000' in
-	let rd = Xs_ring.read back.mmap s len in
-	Bytes.blit s 0 b 0 rd;
+let read_fd back con b len = read_fd_at back con b 0 len
+
+let read_mmap_at back _con b off len =
+	(* The ring stub always fills from the start of its buffer, so only
+	   bounce through a scratch buffer when reading into the middle. *)
+	let rd =
+		if off = 0 then
+			Xs_ring.read back.mmap b len
+		else (
+			let s = Bytes.create len in
+			let rd = Xs_ring.read back.mmap s len in
+			Bytes.blit s 0 b off rd;
+			rd
+		) in
 	back.work_again <- (rd > 0);
 	if rd > 0 then
 		back.eventchn_notify ();
 	rd
 
-let read con b len =
+let read_mmap back con b len = read_mmap_at back con b 0 len
+
+let read_at con b off len =
 	match con.backend with
-	| Fd backfd     -> read_fd backfd con b len
-	| Xenmmap backmmap -> read_mmap backmmap con b len
+	| Fd backfd     -> read_fd_at backfd con b off len
+	| Xenmmap backmmap -> read_mmap_at backmmap con b off len
+
+let read con b len = read_at con b 0 len
 
 let write_fd back _con b len =
 	Unix.write_substring back.fd b 0 len
@@ -125,21 +139,16 @@ let output con =
 (* NB: can throw Reconnect *)
 let input con =
 	let newpacket = ref false in
-	let to_read =
-		match con.partial_in with
-		| HaveHdr partial_pkt -> Partial.to_complete partial_pkt
-		| NoHdr   (i, _)    -> i in
-
-	(* try to get more data from input stream *)
-	let b = Bytes.make to_read '\000' in
-	let sz = if to_read > 0 then read con b to_read else 0 in
-
 	(
 	match con.partial_in with
 	| HaveHdr partial_pkt ->
-		(* we complete the data *)
+		(* read the payload straight into the packet's own buffer *)
+		let to_read = Partial.to_complete partial_pkt in
+		let sz = if to_read > 0 then
+			read_at con partial_pkt.Partial.buf partial_pkt.Partial.off to_read
+			else 0 in
 		if sz > 0 then
-			Partial.append partial_pkt (Bytes.to_string b) sz;
+			Partial.advance partial_pkt sz;
 		if Partial.to_complete partial_pkt = 0 then (
 			let pkt = Packet.of_partialpkt partial_pkt in
 			con.partial_in <- init_partial_in ();
@@ -148,10 +157,11 @@ let input con =
 		)
 	| NoHdr (i, buf)      ->
 		(* we complete the partial header *)
-		if sz > 0 then
-			Bytes.blit b 0 buf (Partial.header_size () - i) sz;
+		let sz = if i > 0 then
+			read_at con buf (Partial.header_size () - i) i
+			else 0 in
 		con.partial_in <- if sz = i then
-			HaveHdr (Partial.of_string (Bytes.to_string buf)) else NoHdr (i - sz, buf)
+			HaveHdr (Partial.of_string (Bytes.unsafe_to_string buf)) else NoHdr (i - sz, buf)
 	);
 	!newpacket
 
@@ -23,29 +23,34 @@ type history_record = {
 let history : history_record list ref = ref []
 
 (* Called from periodic_ops to ensure we don't discard symbols that are still needed. *)
-(* There is scope for optimisation here, since in consecutive commits one commit's `after`
- * is the same thing as the next commit's `before`, but not all commits in history are
- * consecutive. *)
+(* Consecutive commits share almost all of their trees (one commit's `after` is
+ * normally the next commit's `before`), so rather than walking every snapshot in
+ * full we only walk the subtrees that have not been seen in an earlier one. *)
 let mark_symbols () =
-	(* There are gaps where dom0's commits are missing. Otherwise we could assume that
-	 * each element's `before` is the same thing as the next element's `after`
-	 * since the next element is the previous commit *)
+	let seen = Store.Node.Tbl.create 1024 in
 	List.iter (fun hist_rec ->
-			Store.mark_symbols hist_rec.before;
-			Store.mark_symbols hist_rec.after;
+			Store.mark_symbols_shared seen hist_rec.before;
+			Store.mark_symbols_shared seen hist_rec.after;
 		)
 		!history
 
+(* Records are pushed in commit order, so the list is sorted newest first by
+ * finish_count and everything after the first stale record is stale too.
+ * The list is returned unchanged (not copied) when nothing needs dropping. *)
+let rec take_newer_than count = function
+	| r :: rest as l when r.finish_count > count ->
+		let rest' = take_newer_than count rest in
+		if rest' == rest then l else r :: rest'
+	| _ -> []
+
 (* Keep only enough commit-history to protect the running transactions that we are still tracking *)
-(* There is scope for optimisation here, replacing List.filter with something more efficient,
- * probably on a different list-like structure. *)
 let trim ?txn () =
 	Transaction.trim_short_running_transactions txn;
 	history := match Transaction.oldest_short_running_transaction () with
 	| None -> [] (* We have no open transaction, so no history is needed *)
 	| Some (_, txn) -> (
 		(* keep records with finish_count recent enough to be relevant *)
-		List.filter (fun r -> r.finish_count > txn.Transaction.start_count) !history
+		take_newer_than txn.Transaction.start_count !history
 	)
 
 let end_transaction txn con tid commit =
@@ -89,6 +89,23 @@ let check_owner node connection =
 
 let rec recurse fct node = fct node; List.iter (recurse fct) node.children
 
+(** Tables keyed on physical node identity.  Snapshots of the store share
+    every subtree that has not changed between them. *)
+module Tbl = Hashtbl.Make(struct
+	type nonrec t = t
+	let equal = (==)
+	let hash = Hashtbl.hash
+end)
+
+(** [recurse_unseen seen fct node] is [recurse fct node], except that subtrees
+    already recorded in [seen] are skipped and visited ones are recorded. *)
+let rec recurse_unseen seen fct node =
+	if not (Tbl.mem seen node) then (
+		Tbl.add seen node ();
+		fct node;
+		List.iter (recurse_unseen seen fct) node.children
+	)
+
 (** [recurse_map f tree] applies [f] on each node in the tree recursively *)
 let recurse_map f =
 	let rec walk node =
@@ -492,6 +509,11 @@ let copy store = {
 let mark_symbols store =
 	Node.recurse (fun node -> Symbol.mark_as_used node.Node.name) store.root
 
+(* As [mark_symbols], but only walks the parts of [store] not already marked
+   through the same [seen] table, e.g. by an earlier snapshot. *)
+let mark_symbols_shared seen store =
+	Node.recurse_unseen seen (fun node -> Symbol.mark_as_used node.Node.name) store.root
+
 let incr_transaction_coalesce store =
 	store.stat_transaction_coalesce <- store.stat_transaction_coalesce + 1
 let incr_transaction_abort store =
@@ -59,6 +59,12 @@ REC_TYPE_checkpoint_dirty_pfn_list  = 0x0000000f
 REC_TYPE_static_data_end            = 0x00000010
 REC_TYPE_x86_cpuid_policy           = 0x00000011
 REC_TYPE_x86_msr_policy             = 0x00000012
+REC_TYPE_compressed_page_data       = 0x00000013
+REC_TYPE_postcopy_pfns              = 0x00000014
+REC_TYPE_postcopy_transition        = 0x00000015
+REC_TYPE_postcopy_fault             = 0x00000016
+REC_TYPE_stream_fork                = 0x00000017
+REC_TYPE_stream_join                = 0x00000018
 
 rec_type_to_str = {
     REC_TYPE_end                        : "End",
@@ -80,6 +86,12 @@ rec_type_to_str = {
     REC_TYPE_static_data_end            : "Static data end",
     REC_TYPE_x86_cpuid_policy           : "x86 CPUID policy",
     REC_TYPE_x86_msr_policy             : "x86 MSR policy",
+    REC_TYPE_compressed_page_data       : "Compressed page data",
+    REC_TYPE_postcopy_pfns              : "Postcopy pfns",
+    REC_TYPE_postcopy_transition        : "Postcopy transition",
+    REC_TYPE_postcopy_fault             : "Postcopy fault",
+    REC_TYPE_stream_fork                : "Stream fork",
+    REC_TYPE_stream_join                : "Stream join",
 }
 
 # page_data
@@ -102,6 +114,22 @@ PAGE_DATA_TYPE_BROKEN        = (0xd << PAGE_DATA_TYPE_SHIFT) # Broken
 PAGE_DATA_TYPE_XALLOC        = (0xe << PAGE_DATA_TYPE_SHIFT) # Allocate-only
 PAGE_DATA_TYPE_XTAB          = (0xf << PAGE_DATA_TYPE_SHIFT) # Invalid
 
+# compressed_page_data
+COMPRESSED_PAGE_DATA_FORMAT      = "IHHII"
+COMPRESSED_PAGE_DATA_NONE        = 0x0000
+COMPRESSED_PAGE_DATA_ZLIB        = 0x0001
+COMPRESSED_PAGE_ENC_MASK         = 0xff
+COMPRESSED_PAGE_LITERAL          = 0x00
+COMPRESSED_PAGE_ZERO             = 0x01
+COMPRESSED_PAGE_DUPLICATE        = 0x02
+COMPRESSED_PAGE_REF_SHIFT        = 8
+
+# postcopy_pfns
+POSTCOPY_PFNS_FORMAT             = "II"
+
+# stream_fork
+STREAM_FORK_FORMAT               = "II"
+
 # x86_pv_info
 X86_PV_INFO_FORMAT        = "BBHI"
 
@@ -477,6 +505,135 @@ class VerifyLibxc(VerifyBase):
                               (contentsz, sz))
 
 
+    def verify_record_compressed_page_data(self, content):
+        """ Compressed Page Data record """
+        minsz = calcsize(COMPRESSED_PAGE_DATA_FORMAT)
+
+        if self.version < 3:
+            raise RecordError("Compressed page data record found in v2 stream")
+
+        if len(content) <= minsz:
+            raise RecordError(
+                "COMPRESSED_PAGE_DATA record must be at least %d bytes long" %
+                (minsz, ))
+
+        count, compression, res1, data_len, res2 = unpack(
+            COMPRESSED_PAGE_DATA_FORMAT, content[:minsz])
+
+        if res1 != 0 or res2 != 0:
+            raise StreamError(
+                "Reserved bits set in COMPRESSED_PAGE_DATA record 0x%04x 0x%08x"
+                % (res1, res2))
+
+        if compression not in (COMPRESSED_PAGE_DATA_NONE,
+                               COMPRESSED_PAGE_DATA_ZLIB):
+            raise RecordError("Unknown compression 0x%04x" % (compression, ))
+
+        pfnsz = count * 8
+        encsz = count * 4
+        if len(content) != minsz + pfnsz + encsz + data_len:
+            raise RecordError("Expected %u + %u + %u + %u, got %u" %
+                              (minsz, pfnsz, encsz, data_len, len(content)))
+
+        pfns = list(unpack("=%dQ" % (count, ), content[minsz:minsz + pfnsz]))
+        encs = list(unpack("=%dI" % (count, ),
+                           content[minsz + pfnsz:minsz + pfnsz + encsz]))
+
+        nr_literals = 0
+        for idx, (pfn, enc) in enumerate(zip(pfns, encs)):
+
+            if pfn & PAGE_DATA_PFN_RESZ_MASK:
+                raise RecordError("Reserved bits set in pfn[%d]: 0x%016x" %
+                                  (idx, pfn & PAGE_DATA_PFN_RESZ_MASK))
+
+            if pfn >> PAGE_DATA_TYPE_SHIFT in (5, 6, 7, 8):
+                raise RecordError("Invalid type value in pfn[%d]: 0x%016x" %
+                                  (idx, pfn & PAGE_DATA_TYPE_LTAB_MASK))
+
+            if not (PAGE_DATA_TYPE_NOTAB <=
+                    (pfn & PAGE_DATA_TYPE_LTABTYPE_MASK) <=
+                    PAGE_DATA_TYPE_L4TAB):
+                if enc != 0:
+                    raise RecordError("Encoding 0x%08x for pfn[%d] without data"
+                                      % (enc, idx))
+                continue
+
+            kind = enc & COMPRESSED_PAGE_ENC_MASK
+            if kind == COMPRESSED_PAGE_LITERAL:
+                nr_literals += 1
+            elif kind == COMPRESSED_PAGE_DUPLICATE:
+                if (enc >> COMPRESSED_PAGE_REF_SHIFT) >= idx:
+                    raise RecordError("Bad duplicate reference in pfn[%d]: %u"
+                                      % (idx, enc >> COMPRESSED_PAGE_REF_SHIFT))
+            elif kind != COMPRESSED_PAGE_ZERO:
+                raise RecordError("Unknown encoding in pfn[%d]: 0x%08x" %
+                                  (idx, enc))
+
+        if (compression == COMPRESSED_PAGE_DATA_NONE and
+                data_len != nr_literals * 4096):
+            raise RecordError("Expected %u octets of literal pages, got %u" %
+                              (nr_literals * 4096, data_len))
+
+
+    def verify_record_postcopy_pfns(self, content):
+        """ Postcopy pfns record """
+        minsz = calcsize(POSTCOPY_PFNS_FORMAT)
+
+        if len(content) < minsz:
+            raise RecordError(
+                "POSTCOPY_PFNS record must be at least %d bytes long" %
+                (minsz, ))
+
+        count, res1 = unpack(POSTCOPY_PFNS_FORMAT, content[:minsz])
+
+        if res1 != 0:
+            raise StreamError("Reserved bits set in POSTCOPY_PFNS record 0x%08x"
+                              % (res1, ))
+
+        if len(content) != minsz + count * 8:
+            raise RecordError("Expected %u + %u, got %u" %
+                              (minsz, count * 8, len(content)))
+
+
+    def verify_record_postcopy_transition(self, content):
+        """ Postcopy transition record """
+
+        if len(content) != 0:
+            raise RecordError("Postcopy transition record with non-zero length")
+
+
+    def verify_record_postcopy_fault(self, content):
+        """ Postcopy fault """
+        raise RecordError("Found postcopy fault record in stream")
+
+
+    def verify_record_stream_fork(self, content):
+        """ Stream fork record """
+        sz = calcsize(STREAM_FORK_FORMAT)
+
+        if len(content) != sz:
+            raise RecordError("STREAM_FORK record must be %d bytes long, got %d"
+                              % (sz, len(content)))
+
+        count, res1 = unpack(STREAM_FORK_FORMAT, content)
+
+        if count == 0:
+            raise RecordError("STREAM_FORK record with no streams")
+
+        if res1 != 0:
+            raise StreamError("Reserved bits set in STREAM_FORK record 0x%08x"
+                              % (res1, ))
+
+        self.info("  Auxiliary streams: %d" % (count, ))
+
+
+    def verify_record_stream_join(self, content):
+        """ Stream join record """
+
+        if len(content) != 0:
+            raise RecordError("Stream join record with non-zero length")
+
+
 record_verifiers = {
     REC_TYPE_end:
         VerifyLibxc.verify_record_end,
@@ -526,4 +683,19 @@ record_verifiers = {
         VerifyLibxc.verify_record_x86_cpuid_policy,
     REC_TYPE_x86_msr_policy:
         VerifyLibxc.verify_record_x86_msr_policy,
+
+    REC_TYPE_compressed_page_data:
+        VerifyLibxc.verify_record_compressed_page_data,
+
+    REC_TYPE_postcopy_pfns:
+        VerifyLibxc.verify_record_postcopy_pfns,
+    REC_TYPE_postcopy_transition:
+        VerifyLibxc.verify_record_postcopy_transition,
+    REC_TYPE_postcopy_fault:
+        VerifyLibxc.verify_record_postcopy_fault,
+
+    REC_TYPE_stream_fork:
+        VerifyLibxc.verify_record_stream_fork,
+    REC_TYPE_stream_join:
+        VerifyLibxc.verify_record_stream_join,
     }
@@ -0,0 +1,303 @@
+/*
+ * hypercall-bench
+ *
+ * Microbenchmarks for the round trip cost of common hypercalls, as issued
+ * from a toolstack domain, and of a few instructions which cause a VM exit
+ * (or, for PV, a trap into Xen).
+ *
+ * usage:
+ *  hypercall-bench [-n ITERATIONS] [-r ROUNDS] [-d DOMID] [-l] [TEST...]
+ *
+ * Each test is run for ROUNDS rounds of ITERATIONS calls, and the minimum,
+ * median and maximum cost per call across rounds is printed in ns.  Without
+ * TEST arguments all tests are run; "-l" lists them.
+ *
+ * The evtchn-send test binds a loopback event channel to DOMID (default 0),
+ * which must be the domain the benchmark runs in.
+ */
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation; version 2.1 of the
+ * License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <xencall.h>
+#include <xenctrl.h>
+#include <xenevtchn.h>
+#include <xen-tools/libs.h>
+
+#include <xen/sched.h>
+#include <xen/version.h>
+
+static xc_interface *xch;
+static xencall_handle *xcall;
+static xenevtchn_handle *xce;
+static evtchn_port_t local_port;
+static uint32_t domid;
+
+struct test {
+    const char *name;
+    const char *desc;
+    int (*setup)(void);
+    int (*run)(void);
+};
+
+static int run_version(void)
+{
+    return xencall2(xcall, __HYPERVISOR_xen_version, XENVER_version, 0) < 0;
+}
+
+static int run_yield(void)
+{
+    return xencall2(xcall, __HYPERVISOR_sched_op, SCHEDOP_yield, 0);
+}
+
+static int run_getdomaininfo(void)
+{
+    xc_domaininfo_t info;
+
+    return xc_domain_getinfolist(xch, domid, 1, &info) != 1;
+}
+
+static int setup_evtchn(void)
+{
+    xenevtchn_port_or_error_t remote, local;
+
+    if ( !xce )
+    {
+        xce = xenevtchn_open(NULL, 0);
+        if ( !xce )
+            return -1;
+    }
+
+    remote = xenevtchn_bind_unbound_port(xce, domid);
+    if ( remote < 0 )
+        return -1;
+
+    local = xenevtchn_bind_interdomain(xce, domid, remote);
+    if ( local < 0 )
+        return -1;
+
+    local_port = local;
+
+    return 0;
+}
+
+static int run_evtchn_send(void)
+{
+    return xenevtchn_notify(xce, local_port);
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+static int run_cpuid(void)
+{
+    unsigned int a = 0, b, c = 0, d;
+
+    asm volatile ( "cpuid"
+                   : "+a" (a), "=b" (b), "+c" (c), "=d" (d) );
+
+    return 0;
+}
+
+/* Xen's forced emulation prefix: always traps, including for PV guests. */
+static int run_cpuid_forced(void)
+{
+    unsigned int a = 0, b, c = 0, d;
+
+    asm volatile ( "ud2a; .ascii \"xen\"; cpuid"
+                   : "+a" (a), "=b" (b), "+c" (c), "=d" (d) );
+
+    return 0;
+}
+#endif
+
+static const struct test tests[] = {
+    { "version", "XENVER_version hypercall", NULL, run_version },
+    { "yield", "SCHEDOP_yield hypercall", NULL, run_yield },
+    { "getdomaininfo", "XEN_SYSCTL_getdomaininfolist (via libxc)",
+      NULL, run_getdomaininfo },
+    { "evtchn-send", "EVTCHNOP_send on a loopback channel (via evtchn dev)",
+      setup_evtchn, run_evtchn_send },
+#if defined(__i386__) || defined(__x86_64__)
+    { "cpuid", "CPUID leaf 0 (a VM exit for HVM / PVH)", NULL, run_cpuid },
+    { "cpuid-forced", "CPUID leaf 0 with the forced emulation prefix",
+      NULL, run_cpuid_forced },
+#endif
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmp_u64(const void *l, const void *r)
+{
+    uint64_t a = *(const uint64_t *)l, b = *(const uint64_t *)r;
+
+    return (a > b) - (a < b);
+}
+
+static int run_test(const struct test *t, unsigned long iters,
+                    unsigned int rounds)
+{
+    uint64_t *ns = calloc(rounds, sizeof(*ns));
+    unsigned long i;
+    unsigned int r;
+
+    if ( !ns )
+        return -1;
+
+    if ( t->setup && t->setup() )
+    {
+        fprintf(stderr, "%s: setup failed: %s\n", t->name, strerror(errno));
+        free(ns);
+        return -1;
+    }
+
+    /* Warm up caches and TLBs, and check the operation works at all. */
+    if ( t->run() )
+    {
+        fprintf(stderr, "%s: failed: %s\n", t->name, strerror(errno));
+        free(ns);
+        return -1;
+    }
+
+    for ( r = 0; r < rounds; r++ )
+    {
+        uint64_t start = now_ns();
+
+        for ( i = 0; i < iters; i++ )
+            t->run();
+
+        ns[r] = now_ns() - start;
+    }
+
+    qsort(ns, rounds, sizeof(*ns), cmp_u64);
+
+    printf("%-16s %10.1f %10.1f %10.1f\n", t->name,
+           (double)ns[0] / iters, (double)ns[rounds / 2] / iters,
+           (double)ns[rounds - 1] / iters);
+
+    free(ns);
+
+    return 0;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-n ITERATIONS] [-r ROUNDS] [-d DOMID] [-l] [TEST...]\n",
+            prog);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iters = 100000;
+    unsigned int rounds = 10, i;
+    bool list = false;
+    int opt, rc = 0;
+
+    while ( (opt = getopt(argc, argv, "n:r:d:lh")) != -1 )
+    {
+        switch ( opt )
+        {
+        case 'n':
+            iters = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            rounds = strtoul(optarg, NULL, 0);
+            break;
+        case 'd':
+            domid = strtoul(optarg, NULL, 0);
+            break;
+        case 'l':
+            list = true;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if ( list )
+    {
+        for ( i = 0; i < ARRAY_SIZE(tests); i++ )
+            printf("%-16s %s\n", tests[i].name, tests[i].desc);
+        return 0;
+    }
+
+    if ( !iters || !rounds )
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    xch = xc_interface_open(NULL, NULL, 0);
+    xcall = xencall_open(NULL, 0);
+    if ( !xch || !xcall )
+    {
+        fprintf(stderr, "Failed to open hypervisor interfaces: %s\n",
+                strerror(errno));
+        return 1;
+    }
+
+    printf("%lu iterations x %u rounds, ns per call\n", iters, rounds);
+    printf("%-16s %10s %10s %10s\n", "test", "min", "median", "max");
+
+    for ( i = 0; i < ARRAY_SIZE(tests); i++ )
+    {
+        int j;
+
+        if ( optind < argc )
+        {
+            for ( j = optind; j < argc; j++ )
+                if ( !strcmp(argv[j], tests[i].name) )
+                    break;
+            if ( j == argc )
+                continue;
+        }
+
+        if ( run_test(&tests[i], iters, rounds) )
+            rc = 1;
+    }
+
+    if ( xce )
+        xenevtchn_close(xce);
+    xencall_close(xcall);
+    xc_interface_close(xch);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -31,6 +31,8 @@ static int usage(const char* prog)
     printf("                          - Populate a page in a domain with a shared page.\n");
     printf("  debug-gfn <domid> <gfn> - Debug a particular domain and gfn.\n");
     printf("  audit                   - Audit the sharing subsytem in Xen.\n");
+    printf("  dedup <domid> <first-gfn> <last-gfn>\n");
+    printf("                          - Share identical pages in a range of a domain.\n");
     return 1;
 }
 
@@ -46,6 +48,131 @@ static int usage(const char* prog)
     } \
 } while(0)
 
+#define DEDUP_BATCH 1024
+
+struct dedup_entry {
+    uint64_t hash;
+    unsigned long gfn;
+};
+
+/* FNV-1a over the page, one 64-bit word at a time. */
+static uint64_t page_hash(const void *page)
+{
+    const uint64_t *p = page;
+    uint64_t h = 0xcbf29ce484222325ULL;
+    unsigned int i;
+
+    for ( i = 0; i < XC_PAGE_SIZE / sizeof(*p); i++ )
+        h = (h ^ p[i]) * 0x100000001b3ULL;
+
+    return h;
+}
+
+static int dedup_cmp(const void *a, const void *b)
+{
+    const struct dedup_entry *x = a, *y = b;
+
+    if ( x->hash != y->hash )
+        return x->hash < y->hash ? -1 : 1;
+    if ( x->gfn != y->gfn )
+        return x->gfn < y->gfn ? -1 : 1;
+    return 0;
+}
+
+/*
+ * Share cgfn with sgfn if their contents match.  The comparison is repeated
+ * once both pages have been nominated (and hence can no longer be written
+ * without being unshared first), so a guest write racing with the scan can't
+ * cause differing pages to be merged.  Returns 0 if the pages were shared,
+ * 1 if they differ or already were shared, and -1 on error.
+ */
+static int dedup_pair(xc_interface *xch, domid_t domid,
+                      unsigned long sgfn, unsigned long cgfn)
+{
+    uint64_t sh, ch;
+    xen_pfn_t pfns[2] = { sgfn, cgfn };
+    int err[2];
+    char *map;
+    int same;
+
+    if ( xc_memshr_nominate_gfn(xch, domid, sgfn, &sh) ||
+         xc_memshr_nominate_gfn(xch, domid, cgfn, &ch) )
+        return -1;
+
+    if ( sh == ch )
+        return 1;
+
+    map = xc_map_foreign_bulk(xch, domid, PROT_READ, pfns, err, 2);
+    if ( !map )
+        return -1;
+    same = !err[0] && !err[1] && !memcmp(map, map + XC_PAGE_SIZE, XC_PAGE_SIZE);
+    munmap(map, 2 * XC_PAGE_SIZE);
+
+    if ( !same )
+        return 1;
+
+    return xc_memshr_share_gfns(xch, domid, sgfn, sh, domid, cgfn, ch);
+}
+
+static int dedup(xc_interface *xch, domid_t domid,
+                 unsigned long first_gfn, unsigned long last_gfn)
+{
+    unsigned long nr = last_gfn - first_gfn + 1, n = 0, i, j, shared = 0;
+    struct dedup_entry *entries;
+    xen_pfn_t pfns[DEDUP_BATCH];
+    int err[DEDUP_BATCH];
+
+    if ( last_gfn < first_gfn )
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    entries = calloc(nr, sizeof(*entries));
+    if ( !entries )
+        return -1;
+
+    /* Pages have to be unmapped again before they can be nominated. */
+    for ( i = 0; i < nr; i += DEDUP_BATCH )
+    {
+        unsigned int k, count = (nr - i) < DEDUP_BATCH ? nr - i : DEDUP_BATCH;
+        char *map;
+
+        for ( k = 0; k < count; k++ )
+            pfns[k] = first_gfn + i + k;
+
+        map = xc_map_foreign_bulk(xch, domid, PROT_READ, pfns, err, count);
+        if ( !map )
+            continue;
+
+        for ( k = 0; k < count; k++ )
+        {
+            if ( err[k] )
+                continue;
+            entries[n].hash = page_hash(map + k * XC_PAGE_SIZE);
+            entries[n].gfn = pfns[k];
+            n++;
+        }
+
+        munmap(map, count * XC_PAGE_SIZE);
+    }
+
+    qsort(entries, n, sizeof(*entries), dedup_cmp);
+
+    for ( i = 0; i < n; i = j )
+    {
+        for ( j = i + 1; j < n && entries[j].hash == entries[i].hash; j++ )
+            if ( !dedup_pair(xch, domid, entries[i].gfn, entries[j].gfn) )
+                shared++;
+    }
+
+    free(entries);
+
+    printf("scanned = %lu\nshared = %lu\n", n, shared);
+
+    return 0;
+}
+
 int main(int argc, const char** argv)
 {
     const char* cmd = NULL;
@@ -203,5 +330,18 @@ int main(int argc, const char** argv)
             return rc;
         }
     }
+    else if( !strcasecmp(cmd, "dedup") )
+    {
+        domid_t domid;
+        unsigned long first_gfn, last_gfn;
+
+        if( argc != 5 )
+            return usage(argv[0]);
+
+        domid = strtol(argv[2], NULL, 0);
+        first_gfn = strtoul(argv[3], NULL, 0);
+        last_gfn = strtoul(argv[4], NULL, 0);
+        R(dedup(xch, domid, first_gfn, last_gfn));
+    }
     return 0;
 }
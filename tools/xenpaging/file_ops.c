@@ -22,20 +22,21 @@
 #include <unistd.h>
 #include <xenctrl.h>
 
-static int file_op(int fd, void *page, int i,
-                   ssize_t (*fn)(int, void *, size_t))
+/*
+ * Positioned I/O: no separate lseek() per page, and the file offset is not
+ * shared state, so callers in different threads cannot race on it.
+ */
+static int file_op(int fd, void *page, int i, int nr,
+                   ssize_t (*fn)(int, void *, size_t, off_t))
 {
-    off_t offset = i;
-    int total = 0;
-    int bytes;
-
-    offset = lseek(fd, offset << XC_PAGE_SHIFT, SEEK_SET);
-    if ( offset == (off_t)-1 )
-        return -1;
+    off_t offset = (off_t)i << XC_PAGE_SHIFT;
+    size_t size = (size_t)nr << XC_PAGE_SHIFT;
+    size_t total = 0;
+    ssize_t bytes;
 
-    while ( total < XC_PAGE_SIZE )
+    while ( total < size )
     {
-        bytes = fn(fd, page + total, XC_PAGE_SIZE - total);
+        bytes = fn(fd, page + total, size - total, offset + total);
         if ( bytes <= 0 )
             return -1;
 
@@ -45,21 +46,25 @@ static int file_op(int fd, void *page, int i,
     return 0;
 }
 
-static ssize_t my_write(int fd, void *buf, size_t count)
+static ssize_t my_pwrite(int fd, void *buf, size_t count, off_t offset)
 {
-    return write(fd, buf, count);
+    return pwrite(fd, buf, count, offset);
 }
 
 int read_page(int fd, void *page, int i)
 {
-    return file_op(fd, page, i, &read);
+    return file_op(fd, page, i, 1, &pread);
 }
 
 int write_page(int fd, void *page, int i)
 {
-    return file_op(fd, page, i, &my_write);
+    return file_op(fd, page, i, 1, &my_pwrite);
 }
 
+int write_pages(int fd, void *pages, int i, int nr)
+{
+    return file_op(fd, pages, i, nr, &my_pwrite);
+}
 
 /*
  * Local variables:
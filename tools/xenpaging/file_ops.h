@@ -26,6 +26,8 @@
 
 int read_page(int fd, void *page, int i);
 int write_page(int fd, void *page, int i);
+/* Write nr contiguous pages to nr consecutive slots starting at slot i. */
+int write_pages(int fd, void *pages, int i, int nr);
 
 
 #endif
@@ -588,81 +588,144 @@ static void put_response(struct vm_event *vm_event, vm_event_response_t *rsp)
     RING_PUSH_RESPONSES(back_ring);
 }
 
-/* Evict a given gfn
+/* Choose a victim and nominate it for eviction
  * Returns < 0 on fatal error
- * Returns 0 on successful evict
- * Returns > 0 if gfn can not be evicted
+ * Returns 0 with *gfn set on successful nomination
+ * Returns > 0 if no gfn can be nominated
  */
-static int xenpaging_evict_page(struct xenpaging *paging, unsigned long gfn, int slot)
+static int nominate_victim(struct xenpaging *paging, unsigned long *gfn)
 {
     xc_interface *xch = paging->xc_handle;
-    void *page;
-    xen_pfn_t victim = gfn;
+    static int num_paged_out;
     int ret;
-    struct xen_domctl domctl;
 
-    /* Nominate page */
-    ret = xc_mem_paging_nominate(xch, paging->vm_event.domain_id, gfn);
-    if ( ret < 0 )
+    do
     {
-        /* unpageable gfn is indicated by EBUSY */
-        if ( errno == EBUSY )
-            ret = 1;
-        else
-            PERROR("Error nominating page %lx", gfn);
-        goto out;
+        *gfn = policy_choose_victim(paging);
+        if ( *gfn == INVALID_MFN )
+        {
+            /* If the number did not change after last flush command then
+             * the command did not reach qemu yet, or qemu still processes
+             * the command, or qemu has nothing to release.
+             * Right now there is no need to issue the command again.
+             */
+            if ( num_paged_out != paging->num_paged_out )
+            {
+                DPRINTF("Flushing qemu cache\n");
+                xenpaging_mem_paging_flush_ioemu_cache(paging);
+                num_paged_out = paging->num_paged_out;
+            }
+            return ENOSPC;
+        }
+
+        if ( interrupted )
+            return EINTR;
+
+        ret = xc_mem_paging_nominate(xch, paging->vm_event.domain_id, *gfn);
+        if ( ret < 0 )
+        {
+            /* unpageable gfn is indicated by EBUSY */
+            if ( errno != EBUSY )
+            {
+                PERROR("Error nominating page %lx", *gfn);
+                return -1;
+            }
+        }
+    }
+    while ( ret );
+
+    return 0;
+}
+
+/* Evict up to nr gfns into the given slots
+ * Victims are nominated first, then mapped with a single foreign mapping and
+ * written to the paging file, coalescing runs of consecutive slots into one
+ * write, before Xen is asked to evict them.  Slots that were not used are
+ * left with slot_to_gfn[] clear.
+ * Returns < 0 on fatal error
+ * Returns 0 if all slots were tried, adding the number evicted to *num
+ * Returns > 0 if no more gfns can be evicted, adding to *num likewise
+ */
+static int evict_batch(struct xenpaging *paging, const int *slots, int nr,
+                       int *num)
+{
+    xc_interface *xch = paging->xc_handle;
+    xen_pfn_t victims[XENPAGING_EVICT_BATCH];
+    unsigned long gfn;
+    void *page;
+    int i, j, n, ret = 0;
+
+    for ( n = 0; n < nr; n++ )
+    {
+        ret = nominate_victim(paging, &gfn);
+        if ( ret )
+            break;
+        victims[n] = gfn;
     }
 
-    /* Map page */
-    page = xc_map_foreign_pages(xch, paging->vm_event.domain_id, PROT_READ, &victim, 1);
+    if ( ret < 0 || n == 0 )
+        return ret;
+
+    /* Map pages */
+    page = xc_map_foreign_pages(xch, paging->vm_event.domain_id, PROT_READ,
+                                victims, n);
     if ( page == NULL )
     {
-        PERROR("Error mapping page %lx", gfn);
-        ret = -1;
-        goto out;
+        PERROR("Error mapping %d pages from %"PRI_xen_pfn, n, victims[0]);
+        return -1;
     }
 
-    /* Copy page */
-    ret = write_page(paging->fd, page, slot);
-    if ( ret < 0 )
+    /* Copy pages */
+    for ( i = 0; i < n; i = j )
     {
-        PERROR("Error copying page %lx", gfn);
-        munmap(page, XC_PAGE_SIZE);
-        ret = -1;
-        goto out;
+        for ( j = i + 1; j < n && slots[j] == slots[j - 1] + 1; j++ )
+            continue;
+
+        if ( write_pages(paging->fd, page + i * XC_PAGE_SIZE, slots[i],
+                         j - i) < 0 )
+        {
+            PERROR("Error copying page %"PRI_xen_pfn, victims[i]);
+            munmap(page, n * XC_PAGE_SIZE);
+            return -1;
+        }
     }
 
-    /* Release page */
-    munmap(page, XC_PAGE_SIZE);
+    /* Release pages */
+    munmap(page, n * XC_PAGE_SIZE);
 
-    /* Tell Xen to evict page */
-    ret = xc_mem_paging_evict(xch, paging->vm_event.domain_id, gfn);
-    if ( ret < 0 )
+    for ( i = 0; i < n; i++ )
     {
-        /* A gfn in use is indicated by EBUSY */
-        if ( errno == EBUSY )
+        gfn = victims[i];
+
+        /* Tell Xen to evict page */
+        if ( xc_mem_paging_evict(xch, paging->vm_event.domain_id, gfn) < 0 )
         {
-                ret = 1;
-                DPRINTF("Nominated page %lx busy", gfn);
-        } else
-            PERROR("Error evicting page %lx", gfn);
-        goto out;
-    }
+            /* A gfn in use is indicated by EBUSY */
+            if ( errno != EBUSY )
+            {
+                PERROR("Error evicting page %lx", gfn);
+                return -1;
+            }
+            DPRINTF("Nominated page %lx busy", gfn);
+            continue;
+        }
 
-    DPRINTF("evict_page > gfn %lx pageslot %d\n", gfn, slot);
-    /* Notify policy of page being paged out */
-    policy_notify_paged_out(gfn);
+        DPRINTF("evict_page > gfn %lx pageslot %d\n", gfn, slots[i]);
+        /* Notify policy of page being paged out */
+        policy_notify_paged_out(gfn);
 
-    /* Update index */
-    paging->slot_to_gfn[slot] = gfn;
-    paging->gfn_to_slot[gfn] = slot;
+        /* Update index */
+        paging->slot_to_gfn[slots[i]] = gfn;
+        paging->gfn_to_slot[gfn] = slots[i];
 
-    /* Record number of evicted pages */
-    paging->num_paged_out++;
+        /* Record number of evicted pages */
+        paging->num_paged_out++;
+        (*num)++;
 
-    ret = 0;
+        if ( test_and_set_bit(gfn, paging->bitmap) )
+            ERROR("Page %lx has been evicted before", gfn);
+    }
 
- out:
     return ret;
 }
 
@@ -753,59 +816,6 @@ static void resume_pages(struct xenpaging *paging, int num_pages)
         page_in_trigger();
 }
 
-/* Evict one gfn and write it to the given slot
- * Returns < 0 on fatal error
- * Returns 0 on successful evict
- * Returns > 0 if no gfn can be evicted
- */
-static int evict_victim(struct xenpaging *paging, int slot)
-{
-    xc_interface *xch = paging->xc_handle;
-    unsigned long gfn;
-    static int num_paged_out;
-    int ret;
-
-    do
-    {
-        gfn = policy_choose_victim(paging);
-        if ( gfn == INVALID_MFN )
-        {
-            /* If the number did not change after last flush command then
-             * the command did not reach qemu yet, or qemu still processes
-             * the command, or qemu has nothing to release.
-             * Right now there is no need to issue the command again.
-             */
-            if ( num_paged_out != paging->num_paged_out )
-            {
-                DPRINTF("Flushing qemu cache\n");
-                xenpaging_mem_paging_flush_ioemu_cache(paging);
-                num_paged_out = paging->num_paged_out;
-            }
-            ret = ENOSPC;
-            goto out;
-        }
-
-        if ( interrupted )
-        {
-            ret = EINTR;
-            goto out;
-        }
-
-        ret = xenpaging_evict_page(paging, gfn, slot);
-        if ( ret < 0 )
-            goto out;
-    }
-    while ( ret );
-
-    if ( test_and_set_bit(gfn, paging->bitmap) )
-        ERROR("Page %lx has been evicted before", gfn);
-
-    ret = 0;
-
- out:
-    return ret;
-}
-
 /* Evict a batch of pages and write them to a free slot in the paging file
  * Returns < 0 on fatal error
  * Returns 0 if no gfn can be evicted
@@ -813,38 +823,49 @@ static int evict_victim(struct xenpaging *paging, int slot)
  */
 static int evict_pages(struct xenpaging *paging, int num_pages)
 {
-    xc_interface *xch = paging->xc_handle;
-    int rc, slot, num = 0;
+    int slots[XENPAGING_EVICT_BATCH];
+    int i, n, rc, slot, num = 0;
 
     /* Reuse known free slots */
     while ( paging->stack_count > 0 && num < num_pages )
     {
-        slot = paging->free_slot_stack[--paging->stack_count];
-        rc = evict_victim(paging, slot);
+        for ( n = 0; n < XENPAGING_EVICT_BATCH && n < num_pages - num &&
+                     paging->stack_count > 0; n++ )
+            slots[n] = paging->free_slot_stack[--paging->stack_count];
+
+        rc = evict_batch(paging, slots, n, &num);
+
+        /* Give back slots which ended up unused, preserving the order */
+        for ( i = n; i-- > 0; )
+            if ( !paging->slot_to_gfn[slots[i]] )
+                paging->free_slot_stack[paging->stack_count++] = slots[i];
+
         if ( rc )
-        {
-            num = rc < 0 ? -1 : num;
-            return num;
-        }
-        num++;
+            return rc < 0 ? -1 : num;
     }
 
     /* Scan all slots slots for remainders */
-    for ( slot = 0; slot < paging->max_pages && num < num_pages; slot++ )
+    slot = 0;
+    while ( num < num_pages )
     {
-        /* Slot is allocated */
-        if ( paging->slot_to_gfn[slot] )
-            continue;
-
-        rc = evict_victim(paging, slot);
-        if ( rc )
+        for ( n = 0; slot < paging->max_pages && n < XENPAGING_EVICT_BATCH &&
+                     n < num_pages - num; slot++ )
         {
-            num = rc < 0 ? -1 : num;
-            break;
+            /* Slot is allocated */
+            if ( paging->slot_to_gfn[slot] )
+                continue;
+
+            slots[n++] = slot;
         }
 
-        num++;
+        if ( n == 0 )
+            break;
+
+        rc = evict_batch(paging, slots, n, &num);
+        if ( rc )
+            return rc < 0 ? -1 : num;
     }
+
     return num;
 }
 
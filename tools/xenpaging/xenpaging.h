@@ -38,6 +38,8 @@
 #include <xen/vm_event.h>
 
 #define XENPAGING_PAGEIN_QUEUE_SIZE 64
+/* Pages nominated, mapped and written out together per batch */
+#define XENPAGING_EVICT_BATCH 32
 
 struct vm_event {
     domid_t domain_id;
@@ -656,7 +656,7 @@ unsigned int get_strings(struct buffered_data *data,
 	return i;
 }
 
-static void send_error(struct connection *conn, int error)
+static const char *error_string(int error)
 {
 	unsigned int i;
 
@@ -667,8 +667,15 @@ static void send_error(struct connection *conn, int error)
 			break;
 		}
 	}
-	send_reply(conn, XS_ERROR, xsd_errors[i].errstring,
-			  strlen(xsd_errors[i].errstring) + 1);
+
+	return xsd_errors[i].errstring;
+}
+
+static void send_error(struct connection *conn, int error)
+{
+	const char *str = error_string(error);
+
+	send_reply(conn, XS_ERROR, str, strlen(str) + 1);
 }
 
 void send_reply(struct connection *conn, enum xsd_sockmsg_type type,
@@ -909,6 +916,52 @@ static int do_read(struct connection *conn, struct buffered_data *in)
 	return 0;
 }
 
+/*
+ * Reply is a sequence of either "<len>|<value>" (exactly <len> bytes of
+ * value, not nul terminated) or "<error>|" per path, in request order.
+ */
+static int do_read_multiple(struct connection *conn, struct buffered_data *in)
+{
+	struct node *node;
+	unsigned int off, len, rlen = 0;
+	char *reply, hdr[16];
+	const char *err;
+	int hlen;
+
+	reply = talloc_array(in, char, XENSTORE_PAYLOAD_MAX);
+	if (!reply)
+		return ENOMEM;
+
+	for (off = 0; (len = get_string(in, off)) != 0; off += len) {
+		node = get_node_canonicalized(conn, in, in->buffer + off, NULL,
+					      XS_PERM_READ);
+		if (node) {
+			hlen = snprintf(hdr, sizeof(hdr), "%u", node->datalen);
+			if (rlen + hlen + 1 + node->datalen >
+			    XENSTORE_PAYLOAD_MAX)
+				return E2BIG;
+			memcpy(reply + rlen, hdr, hlen + 1);
+			memcpy(reply + rlen + hlen + 1, node->data,
+			       node->datalen);
+			rlen += hlen + 1 + node->datalen;
+		} else {
+			err = error_string(errno);
+			hlen = strlen(err);
+			if (rlen + hlen + 1 > XENSTORE_PAYLOAD_MAX)
+				return E2BIG;
+			memcpy(reply + rlen, err, hlen + 1);
+			rlen += hlen + 1;
+		}
+	}
+
+	if (!off)
+		return EINVAL;
+
+	send_reply(conn, XS_READ_MULTIPLE, reply, rlen);
+
+	return 0;
+}
+
 static void delete_node_single(struct connection *conn, struct node *node)
 {
 	TDB_DATA key;
@@ -1049,42 +1102,98 @@ static struct node *create_node(struct connection *conn, const void *ctx,
 }
 
 /* path, data... */
-static int do_write(struct connection *conn, struct buffered_data *in)
+static int write_one(struct connection *conn, struct buffered_data *in,
+		     const char *path, void *data, unsigned int datalen)
 {
-	unsigned int offset, datalen;
 	struct node *node;
-	char *vec[1] = { NULL }; /* gcc4 + -W + -Werror fucks code. */
 	char *name;
 
-	/* Extra "strings" can be created by binary data. */
-	if (get_strings(in, vec, ARRAY_SIZE(vec)) < ARRAY_SIZE(vec))
-		return EINVAL;
-
-	offset = strlen(vec[0]) + 1;
-	datalen = in->used - offset;
-
-	node = get_node_canonicalized(conn, in, vec[0], &name, XS_PERM_WRITE);
+	node = get_node_canonicalized(conn, in, path, &name, XS_PERM_WRITE);
 	if (!node) {
 		/* No permissions, invalid input? */
 		if (errno != ENOENT)
 			return errno;
-		node = create_node(conn, in, name, in->buffer + offset,
-				   datalen);
+		node = create_node(conn, in, name, data, datalen);
 		if (!node)
 			return errno;
 	} else {
-		node->data = in->buffer + offset;
+		node->data = data;
 		node->datalen = datalen;
 		if (write_node(conn, node, false))
 			return errno;
 	}
 
 	fire_watches(conn, in, name, node, false, NULL);
+
+	return 0;
+}
+
+static int do_write(struct connection *conn, struct buffered_data *in)
+{
+	unsigned int offset;
+	char *vec[1] = { NULL }; /* gcc4 + -W + -Werror fucks code. */
+	int ret;
+
+	/* Extra "strings" can be created by binary data. */
+	if (get_strings(in, vec, ARRAY_SIZE(vec)) < ARRAY_SIZE(vec))
+		return EINVAL;
+
+	offset = strlen(vec[0]) + 1;
+
+	ret = write_one(conn, in, vec[0], in->buffer + offset,
+			in->used - offset);
+	if (ret)
+		return ret;
+
 	send_ack(conn, XS_WRITE);
 
 	return 0;
 }
 
+/*
+ * Input is a sequence of "<path>|<len>|<value>" (exactly <len> bytes of
+ * value).  The writes are done in order, stopping at the first failure.
+ */
+static int do_write_multiple(struct connection *conn,
+			     struct buffered_data *in)
+{
+	unsigned int off = 0, len, datalen;
+	char *path, *end;
+	int ret;
+
+	if (!in->used)
+		return EINVAL;
+
+	while (off < in->used) {
+		len = get_string(in, off);
+		if (!len)
+			return EINVAL;
+		path = in->buffer + off;
+		off += len;
+
+		len = get_string(in, off);
+		if (!len)
+			return EINVAL;
+		errno = 0;
+		datalen = strtoul(in->buffer + off, &end, 10);
+		if (errno || *end || end == in->buffer + off)
+			return EINVAL;
+		off += len;
+
+		if (datalen > in->used - off)
+			return EINVAL;
+
+		ret = write_one(conn, in, path, in->buffer + off, datalen);
+		if (ret)
+			return ret;
+		off += datalen;
+	}
+
+	send_ack(conn, XS_WRITE_MULTIPLE);
+
+	return 0;
+}
+
 static int do_mkdir(struct connection *conn, struct buffered_data *in)
 {
 	struct node *node;
@@ -1114,59 +1223,95 @@ static void memdel(void *mem, unsigned off, unsigned len, unsigned total)
 	memmove(mem + off, mem + off + len, total - off - len);
 }
 
+/* Offset of the last entry in a non-empty children list. */
+static unsigned int last_child_offset(const struct node *node)
+{
+	unsigned int off = node->childlen - 1;
+
+	while (off && node->children[off - 1])
+		off--;
+
+	return off;
+}
+
 static void remove_child_entry(struct connection *conn, struct node *node,
-			       size_t offset)
+			       size_t offset, bool update)
 {
 	size_t childlen = strlen(node->children + offset);
 
 	memdel(node->children, offset, childlen + 1, node->childlen);
 	node->childlen -= childlen + 1;
-	if (write_node(conn, node, true))
+	if (update && write_node(conn, node, true))
 		corrupt(conn, "Can't update parent node '%s'", node->name);
 }
 
-static void delete_child(struct connection *conn,
-			 struct node *node, const char *childname)
+static void delete_child(struct connection *conn, struct node *node,
+			 const char *childname, bool update)
 {
 	unsigned int i;
 
+	/* Subtrees are deleted last child first, see delete_node(). */
+	i = last_child_offset(node);
+	if (streq(node->children + i, childname)) {
+		remove_child_entry(conn, node, i, update);
+		return;
+	}
+
 	for (i = 0; i < node->childlen; i += strlen(node->children+i) + 1) {
 		if (streq(node->children+i, childname)) {
-			remove_child_entry(conn, node, i);
+			remove_child_entry(conn, node, i, update);
 			return;
 		}
 	}
 	corrupt(conn, "Can't find child '%s' in %s", childname, node->name);
 }
 
+/*
+ * Delete a node and its subtree.  With update_parent false the parent is
+ * being deleted as well, so its children list is only changed in memory
+ * rather than rewritten for every child, which is quadratic for large
+ * directories.  It is written back only if deleting stops half way.
+ */
 static int delete_node(struct connection *conn, const void *ctx,
-		       struct node *parent, struct node *node)
+		       struct node *parent, struct node *node,
+		       bool update_parent)
 {
 	char *name;
 
-	/* Delete children. */
+	/*
+	 * Delete children.  Going from the last one makes both finding it in
+	 * the list and removing it from there cheap.
+	 */
 	while (node->childlen) {
 		struct node *child;
+		const char *childname = node->children +
+					last_child_offset(node);
+		int ret;
 
-		name = talloc_asprintf(node, "%s/%s", node->name,
-				       node->children);
+		name = talloc_asprintf(node, "%s/%s", node->name, childname);
 		child = name ? read_node(conn, node, name) : NULL;
 		if (child) {
-			if (delete_node(conn, ctx, node, child))
-				return errno;
+			if (!delete_node(conn, ctx, node, child, false)) {
+				talloc_free(name);
+				continue;
+			}
+			ret = errno;
 		} else {
 			trace("delete_node: Error deleting child '%s/%s'!\n",
-			      node->name, node->children);
-			/* Quit deleting. */
-			errno = ENOMEM;
-			return errno;
+			      node->name, childname);
+			ret = ENOMEM;
 		}
-		talloc_free(name);
+
+		/* Quit deleting, keeping the list in line with the store. */
+		if (write_node(conn, node, true))
+			corrupt(conn, "Can't update node '%s'", node->name);
+		errno = ret;
+		return errno;
 	}
 
 	fire_watches(conn, ctx, node->name, node, true, NULL);
 	delete_node_single(conn, node);
-	delete_child(conn, parent, basename(node->name));
+	delete_child(conn, parent, basename(node->name), update_parent);
 	talloc_free(node);
 
 	return 0;
@@ -1196,7 +1341,7 @@ static int _rm(struct connection *conn, const void *ctx, struct node *node,
 	 * be handled only after the node has been really removed.
 	 */
 	fire_watches(conn, ctx, name, node, false, NULL);
-	return delete_node(conn, ctx, parent, node);
+	return delete_node(conn, ctx, parent, node, true);
 }
 
 
@@ -1352,6 +1497,8 @@ static struct {
 	    { "SET_TARGET",    do_set_target,   XS_FLAG_PRIV },
 	[XS_RESET_WATCHES]     = { "RESET_WATCHES",     do_reset_watches },
 	[XS_DIRECTORY_PART]    = { "DIRECTORY_PART",    send_directory_part },
+	[XS_READ_MULTIPLE]     = { "READ_MULTIPLE",     do_read_multiple },
+	[XS_WRITE_MULTIPLE]    = { "WRITE_MULTIPLE",    do_write_multiple },
 };
 
 /*
@@ -1592,7 +1739,7 @@ static void accept_connection(int sock)
 }
 #endif
 
-static int tdb_flags;
+static int tdb_flags = TDB_INTERNAL | TDB_NOLOCK;
 
 /* We create initial nodes manually. */
 static void manual_node(const char *name, const char *child)
@@ -1751,7 +1898,7 @@ static int check_store_(const char *name, struct hashtable *reachable)
 
 					if (recovery) {
 						remove_child_entry(NULL, node,
-								   i);
+								   i, true);
 						i -= childlen + 1;
 					}
 				}
@@ -1772,7 +1919,7 @@ static int check_store_(const char *name, struct hashtable *reachable)
 				    childname);
 
 				if (recovery) {
-					remove_child_entry(NULL, node, i);
+					remove_child_entry(NULL, node, i, true);
 					i -= childlen + 1;
 				}
 			} else {
@@ -1946,7 +2093,8 @@ static void usage(void)
 "  -M, --path-max <chars>  limit the allowed Xenstore node path length,\n"
 "  -R, --no-recovery       to request that no recovery should be attempted when\n"
 "                          the store is corrupted (debug only),\n"
-"  -I, --internal-db       store database in memory, not on disk\n"
+"  -I, --internal-db [on|off] store database in memory, not on disk, default is\n"
+"                          memory, with \"--internal-db off\" it is on disk\n"
 "  -V, --verbose           to request verbose execution.\n");
 }
 
@@ -1967,7 +2115,7 @@ static struct option options[] = {
 	{ "perm-nb", 1, NULL, 'A' },
 	{ "path-max", 1, NULL, 'M' },
 	{ "no-recovery", 0, NULL, 'R' },
-	{ "internal-db", 0, NULL, 'I' },
+	{ "internal-db", 2, NULL, 'I' },
 	{ "verbose", 0, NULL, 'V' },
 	{ "watch-nb", 1, NULL, 'W' },
 	{ NULL, 0, NULL, 0 } };
@@ -1977,6 +2125,9 @@ int dom0_domid = 0;
 int dom0_event = 0;
 int priv_domid = 0;
 
+/* Maximum number of input steps handled per domain connection and loop. */
+#define DOMAIN_INPUT_BUDGET 32
+
 int main(int argc, char *argv[])
 {
 	int opt;
@@ -1988,7 +2139,7 @@ int main(int argc, char *argv[])
 	int timeout;
 
 
-	while ((opt = getopt_long(argc, argv, "DE:F:HNPS:t:A:M:T:RVW:", options,
+	while ((opt = getopt_long(argc, argv, "DE:F:HNPS:t:A:M:T:RI::VW:", options,
 				  NULL)) != -1) {
 		switch (opt) {
 		case 'D':
@@ -2022,7 +2173,8 @@ int main(int argc, char *argv[])
 			tracefile = optarg;
 			break;
 		case 'I':
-			tdb_flags = TDB_INTERNAL|TDB_NOLOCK;
+			if (optarg && !strcmp(optarg, "off"))
+				tdb_flags = 0;
 			break;
 		case 'V':
 			verbose = true;
@@ -2169,9 +2321,22 @@ int main(int argc, char *argv[])
 				talloc_increase_ref_count(next);
 
 			if (conn->domain) {
-				if (domain_can_read(conn))
+				unsigned int budget = DOMAIN_INPUT_BUDGET;
+				bool freed = false;
+
+				/*
+				 * Drain several requests from a busy ring in
+				 * one go instead of going through poll() and a
+				 * scan of all connections for each of them.
+				 */
+				while (!freed && budget-- &&
+				       domain_can_read(conn)) {
 					handle_input(conn);
-				if (talloc_free(conn) == 0)
+					freed = talloc_free(conn) == 0;
+					if (!freed)
+						talloc_increase_ref_count(conn);
+				}
+				if (freed || talloc_free(conn) == 0)
 					continue;
 
 				talloc_increase_ref_count(conn);
@@ -103,6 +103,10 @@ struct connection
 	/* My watches. */
 	struct list_head watches;
 
+	/* Result of the last permission check done by fire_watches(). */
+	uint64_t watch_fire_gen;
+	bool watch_fire_permitted;
+
 	/* Methods for communicating over this connection: write can be NULL */
 	connwritefn_t *write;
 	connreadfn_t *read;
@@ -62,6 +62,13 @@
  * succeeded transaction possibly overwriting another modification which may
  * have occurred concurrent to the transaction.
  *
+ * Only nodes modified in the transaction get a transaction specific copy in
+ * the data base. Nodes which have only been read are read from the global
+ * data base again on each access: should such a node have been modified
+ * meanwhile, the generation check at the end of the transaction fails, so a
+ * transaction can never commit based on inconsistent reads, while reading a
+ * node doesn't cost a data base write.
+ *
  * Examples:
  * ---------
  * The following notation is used:
@@ -128,7 +135,7 @@ struct accessed_node
 	/* Modified? */
 	bool modified;
 
-	/* Transaction node in data base? */
+	/* Transaction node in data base? Only ever for modified nodes. */
 	bool ta_node;
 };
 
@@ -193,10 +200,12 @@ static char *transaction_get_node_name(void *ctx, struct transaction *trans,
 int transaction_prepend(struct connection *conn, const char *name,
 			TDB_DATA *key)
 {
+	struct accessed_node *i;
 	char *tdb_name;
 
 	if (!conn || !conn->transaction ||
-	    !find_accessed_node(conn->transaction, name)) {
+	    !(i = find_accessed_node(conn->transaction, name)) ||
+	    !i->modified) {
 		set_tdb_key(name, key);
 		return 0;
 	}
@@ -230,9 +239,7 @@ int access_node(struct connection *conn, struct node *node,
 {
 	struct accessed_node *i = NULL;
 	struct transaction *trans;
-	TDB_DATA local_key;
 	const char *trans_name = NULL;
-	int ret;
 	bool introduce = false;
 
 	if (type != NODE_ACCESS_READ) {
@@ -276,22 +283,12 @@ int access_node(struct connection *conn, struct node *node,
 		i->ta_node = false;
 
 		/*
-		 * Additional transaction-specific node for read type. We only
-		 * have to verify read nodes if we didn't write them.
-		 *
-		 * The node is created and written to DB here to distinguish
-		 * from the write types.
+		 * We only have to verify read nodes if we didn't write them.
+		 * No transaction specific copy is made for reads, see above.
 		 */
 		if (type == NODE_ACCESS_READ) {
 			i->generation = node->generation;
 			i->check_gen = true;
-			if (node->generation != NO_GENERATION) {
-				set_tdb_key(trans_name, &local_key);
-				ret = write_node_raw(conn, &local_key, node, true);
-				if (ret)
-					goto err;
-				i->ta_node = true;
-			}
 		}
 		list_add_tail(&i->list, &trans->accessed);
 	}
@@ -314,13 +311,11 @@ int access_node(struct connection *conn, struct node *node,
 	return 0;
 
 nomem:
-	ret = ENOMEM;
-err:
 	talloc_free((void *)trans_name);
 	talloc_free(i);
 	trans->fail = true;
-	errno = ret;
-	return ret;
+	errno = ENOMEM;
+	return ENOMEM;
 }
 
 /*
@@ -25,6 +25,7 @@
 #include <assert.h>
 #include "talloc.h"
 #include "list.h"
+#include "hashtable.h"
 #include "xenstored_watch.h"
 #include "xenstore_lib.h"
 #include "utils.h"
@@ -37,6 +38,10 @@ struct watch
 	/* Watches on this connection */
 	struct list_head list;
 
+	/* Watches on the same node, by any connection (see watch_table). */
+	struct list_head node_list;
+	struct connection *conn;
+
 	/* Current outstanding events applying to this watch. */
 	struct list_head events;
 
@@ -47,29 +52,81 @@ struct watch
 	char *node;
 };
 
-static bool check_special_event(const char *name)
+/*
+ * All watches, indexed by the node they are set on.  Each entry holds the
+ * watches of every connection on that node, so firing only has to look at
+ * the node's ancestors rather than at every watch of every connection.
+ * Keys and values are malloc()ed, as hashtable_remove() free()s keys.
+ */
+struct watch_node
 {
-	assert(name);
+	struct list_head watches;
+};
+static struct hashtable *watch_table;
 
-	return strstarts(name, "@");
+static unsigned int watch_hash_fn(void *k)
+{
+	char *str = k;
+	unsigned int hash = 5381;
+	char c;
+
+	while ((c = *str++))
+		hash = ((hash << 5) + hash) + (unsigned int)c;
+
+	return hash;
 }
 
-/* Is child a subnode of parent, or equal? */
-static bool is_child(const char *child, const char *parent)
+static int watch_equal_fn(void *key1, void *key2)
 {
-	unsigned int len = strlen(parent);
+	return 0 == strcmp((char *)key1, (char *)key2);
+}
 
-	/*
-	 * / should really be "" for this algorithm to work, but that's a
-	 * usability nightmare.
-	 */
-	if (streq(parent, "/"))
-		return true;
+static bool watch_index_add(struct watch *watch)
+{
+	struct watch_node *wn;
+	char *key;
 
-	if (strncmp(child, parent, len) != 0)
-		return false;
+	if (!watch_table) {
+		watch_table = create_hashtable(16, watch_hash_fn,
+					       watch_equal_fn);
+		if (!watch_table)
+			return false;
+	}
+
+	wn = hashtable_search(watch_table, watch->node);
+	if (!wn) {
+		wn = malloc(sizeof(*wn));
+		key = strdup(watch->node);
+		if (!wn || !key ||
+		    !hashtable_insert(watch_table, key, wn)) {
+			free(wn);
+			free(key);
+			return false;
+		}
+		INIT_LIST_HEAD(&wn->watches);
+	}
+
+	list_add_tail(&watch->node_list, &wn->watches);
+
+	return true;
+}
+
+static void watch_index_del(struct watch *watch)
+{
+	struct watch_node *wn;
+
+	list_del(&watch->node_list);
+
+	wn = hashtable_search(watch_table, watch->node);
+	if (wn && list_empty(&wn->watches))
+		free(hashtable_remove(watch_table, watch->node));
+}
+
+static bool check_special_event(const char *name)
+{
+	assert(name);
 
-	return child[len] == '/' || child[len] == '\0';
+	return strstarts(name, "@");
 }
 
 /*
@@ -150,6 +207,43 @@ static bool watch_permitted(struct connection *conn, const void *ctx,
 	return perm & XS_PERM_READ;
 }
 
+/*
+ * Fire all watches set on the node @watched.
+ * The permission check is done at most once per connection for every call
+ * of fire_watches(), identified by @gen.
+ */
+static void fire_node_watches(const void *ctx, const char *watched,
+			      const char *name, struct node *node,
+			      struct node_perms *perms, uint64_t gen)
+{
+	struct watch_node *wn;
+	struct watch *watch;
+	struct connection *i;
+
+	wn = hashtable_search(watch_table, (void *)watched);
+	if (!wn)
+		return;
+
+	list_for_each_entry(watch, &wn->watches, node_list) {
+		i = watch->conn;
+
+		if (i->watch_fire_gen != gen) {
+			i->watch_fire_gen = gen;
+			/* introduce/release domain watches */
+			if (check_special_event(name))
+				i->watch_fire_permitted =
+					check_perms_special(name, i);
+			else
+				i->watch_fire_permitted =
+					watch_permitted(i, ctx, name, node,
+							perms);
+		}
+
+		if (i->watch_fire_permitted)
+			add_event(i, ctx, watch, name);
+	}
+}
+
 /*
  * Check whether any watch events are to be sent.
  * Temporary memory allocations are done with ctx.
@@ -160,38 +254,48 @@ static bool watch_permitted(struct connection *conn, const void *ctx,
 void fire_watches(struct connection *conn, const void *ctx, const char *name,
 		  struct node *node, bool exact, struct node_perms *perms)
 {
-	struct connection *i;
-	struct watch *watch;
+	static uint64_t fire_gen;
+	char *path, *slash;
 
 	/* During transactions, don't fire watches. */
 	if (conn && conn->transaction)
 		return;
 
-	/* Create an event for each watch. */
-	list_for_each_entry(i, &connections, list) {
-		/* introduce/release domain watches */
-		if (check_special_event(name)) {
-			if (!check_perms_special(name, i))
-				continue;
-		} else {
-			if (!watch_permitted(i, ctx, name, node, perms))
-				continue;
-		}
+	if (!watch_table || !hashtable_count(watch_table))
+		return;
 
-		list_for_each_entry(watch, &i->watches, list) {
-			if (exact) {
-				if (streq(name, watch->node))
-					add_event(i, ctx, watch, name);
-			} else {
-				if (is_child(name, watch->node))
-					add_event(i, ctx, watch, name);
-			}
-		}
+	fire_gen++;
+
+	if (exact) {
+		fire_node_watches(ctx, name, name, node, perms, fire_gen);
+		return;
+	}
+
+	/*
+	 * Watches on the node itself and on all of its ancestors fire.  A
+	 * watch on "/" counts as an ancestor of everything.
+	 */
+	fire_node_watches(ctx, "/", name, node, perms, fire_gen);
+	if (streq(name, "/"))
+		return;
+
+	path = talloc_strdup(ctx, name);
+	if (!path)
+		return;
+	for (slash = strchr(path + 1, '/'); slash;
+	     slash = strchr(slash + 1, '/')) {
+		*slash = '\0';
+		fire_node_watches(ctx, path, name, node, perms, fire_gen);
+		*slash = '/';
 	}
+	talloc_free(path);
+
+	fire_node_watches(ctx, name, name, node, perms, fire_gen);
 }
 
 static int destroy_watch(void *_watch)
 {
+	watch_index_del(_watch);
 	trace_destroy(_watch, "watch");
 	return 0;
 }
@@ -245,6 +349,12 @@ int do_watch(struct connection *conn, struct buffered_data *in)
 
 	INIT_LIST_HEAD(&watch->events);
 
+	watch->conn = conn;
+	if (!watch_index_add(watch)) {
+		talloc_free(watch);
+		return ENOMEM;
+	}
+
 	domain_watch_inc(conn);
 	list_add_tail(&watch->list, &conn->watches);
 	trace_create(watch, "watch");
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -27,6 +28,22 @@ mread_handle_t mread_init(int fd)
     fstat(fd, &s);
     h->file_size = s.st_size;
 
+    /*
+     * Records for the different pcpus are read from as many places in
+     * the file at once, which with more pcpus than MREAD_MAPS makes the
+     * window cache below thrash.  Where the address space allows, just
+     * map the whole file once and let the kernel read ahead on all of
+     * the streams in parallel.
+     */
+    if ( h->file_size > 0 && (size_t)h->file_size == h->file_size )
+    {
+        h->whole = mmap(NULL, h->file_size, PROT_READ, MAP_SHARED, fd, 0);
+        if ( h->whole == MAP_FAILED )
+            h->whole = NULL;
+        else
+            madvise(h->whole, h->file_size, MADV_WILLNEED);
+    }
+
     return h;
 }
 
@@ -66,6 +83,12 @@ ssize_t mread64(mread_handle_t h, void *rec, ssize_t len, off_t offset)
         len = h->file_size - offset;
     }
 
+    if ( h->whole )
+    {
+        memcpy(rec, h->whole + offset, len);
+        return len;
+    }
+
     /* Try to find the offset in our range */
     dprintf(warn, " Trying last, %d\n", last);
     if ( h->map[h->last].buffer
@@ -6,6 +6,8 @@
 typedef struct mread_ctrl {
     int fd;
     off_t file_size;
+    /* Whole-file mapping, if one could be established */
+    char * whole;
     struct mread_buffer {
         char * buffer;
         off_t start_offset;
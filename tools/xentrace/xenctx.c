@@ -686,31 +686,57 @@ static void print_ctx(vcpu_guest_context_any_t *ctx_any)
 #endif
 
 #ifndef NO_TRANSLATION
+/*
+ * Stack and memory dumps access the same few pages over and over (often a
+ * byte at a time), and translating an address means walking the guest's
+ * page tables by mapping every level.  Keep a small pool of recently used
+ * translations along with their mappings.
+ */
+#define MAP_CACHE_SIZE 8
+
+static struct map_cache_entry {
+    int vcpu;
+    guest_word_t virt;          /* page aligned */
+    void *mapped;
+} map_cache[MAP_CACHE_SIZE];
+static unsigned int map_cache_next;
+
 static void *map_page(vcpu_guest_context_any_t *ctx, int vcpu, guest_word_t virt)
 {
-    static unsigned long previous_mfn = 0;
-    static void *mapped = NULL;
-
-    unsigned long mfn = xc_translate_foreign_address(xenctx.xc_handle, xenctx.domid, vcpu, virt);
+    guest_word_t page = virt & ~(guest_word_t)(XC_PAGE_SIZE - 1);
     unsigned long offset = virt & ~XC_PAGE_MASK;
+    struct map_cache_entry *ent;
+    unsigned long mfn;
+    unsigned int i;
 
-    if (mapped && mfn == previous_mfn)
-        goto out;
+    for (i = 0; i < MAP_CACHE_SIZE; i++) {
+        ent = &map_cache[i];
+        if (ent->mapped && ent->vcpu == vcpu && ent->virt == page)
+            goto out;
+    }
 
-    if (mapped)
-        munmap(mapped, XC_PAGE_SIZE);
+    ent = &map_cache[map_cache_next];
+    map_cache_next = (map_cache_next + 1) % MAP_CACHE_SIZE;
 
-    previous_mfn = mfn;
+    if (ent->mapped) {
+        munmap(ent->mapped, XC_PAGE_SIZE);
+        ent->mapped = NULL;
+    }
 
-    mapped = xc_map_foreign_range(xenctx.xc_handle, xenctx.domid, XC_PAGE_SIZE, PROT_READ, mfn);
+    mfn = xc_translate_foreign_address(xenctx.xc_handle, xenctx.domid, vcpu, virt);
 
-    if (mapped == NULL) {
+    ent->mapped = xc_map_foreign_range(xenctx.xc_handle, xenctx.domid, XC_PAGE_SIZE, PROT_READ, mfn);
+
+    if (ent->mapped == NULL) {
         fprintf(stderr, "\nfailed to map page for "FMT_32B_WORD".\n", virt);
         return NULL;
     }
 
+    ent->vcpu = vcpu;
+    ent->virt = page;
+
  out:
-    return (void *)(mapped + offset);
+    return (void *)(ent->mapped + offset);
 }
 
 static guest_word_t read_stack_word(guest_word_t *src, int width)
@@ -26,6 +26,7 @@
 #include <ctype.h>
 #include <poll.h>
 #include <sys/statvfs.h>
+#include <sys/uio.h>
 
 #include <xen/xen.h>
 #include <xen/trace.h>
@@ -333,21 +334,62 @@ fail:
 }
 
 /**
- * write_buffer - write a section of the trace buffer
+ * write_all - write out a vector of buffers in full
+ * @iov      - buffers to write (modified)
+ * @iovcnt   - number of entries in @iov
+ *
+ * Returns 0 on success, -1 (with errno set) on failure.  Short writes,
+ * as seen when streaming to a pipe or socket, are retried.
+ */
+static int write_all(struct iovec *iov, int iovcnt)
+{
+    while ( iovcnt )
+    {
+        ssize_t written = writev(outfd, iov, iovcnt);
+
+        if ( written < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            return -1;
+        }
+
+        while ( iovcnt && written >= iov->iov_len )
+        {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+
+        if ( iovcnt )
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * write_buffer - write a window of the trace buffer
  * @cpu      - source buffer CPU ID
- * @start
- * @size     - size of write (may be less than total window size)
- * @total_size - total size of the window (0 on 2nd write of wrapped windows)
- * @out      - output stream
+ * @start    - start of the window
+ * @size     - size of the window up to the end of the buffer
+ * @start2   - start of the wrapped part of the window, if any
+ * @size2    - size of the wrapped part of the window (0 if not wrapped)
  *
  * Outputs the trace buffer to a filestream, prepending the CPU and size
- * of the buffer write.
+ * of the buffer write.  The window is written with a single system call
+ * where possible.
  */
 static void write_buffer(unsigned int cpu, unsigned char *start, int size,
-                         int total_size)
+                         unsigned char *start2, int size2)
 {
     struct statvfs stat;
-    size_t written = 0;
+    struct cpu_change_record rec;
+    struct iovec iov[3];
+    int iovcnt = 0;
     
     if ( opts.memory_buffer == 0 && opts.disk_rsvd != 0 )
     {
@@ -362,10 +404,7 @@ static void write_buffer(unsigned int cpu, unsigned char *start, int size,
 
         freespace = stat.f_frsize * (unsigned long long)stat.f_bfree;
 
-        if ( total_size )
-            freespace -= total_size;
-        else
-            freespace -= size;
+        freespace -= size + size2;
 
         freespace >>= 20; /* Convert to MB */
 
@@ -376,46 +415,35 @@ static void write_buffer(unsigned int cpu, unsigned char *start, int size,
         }
     }
 
-    /* Write a CPU_BUF record on each buffer "window" written.  Wrapped
-     * windows may involve two writes, so only write the record on the
-     * first write. */
-    if ( total_size != 0 )
+    if ( opts.memory_buffer )
     {
-        if ( opts.memory_buffer )
-        {
-            membuf_reserve_window(cpu, total_size);
-        }
-        else
-        {
-            struct cpu_change_record rec;
-
-            rec.header = CPU_CHANGE_HEADER;
-            rec.data.cpu = cpu;
-            rec.data.window_size = total_size;
-
-            written = write(outfd, &rec, sizeof(rec));
-            if ( written != sizeof(rec) )
-            {
-                fprintf(stderr, "Cannot write cpu change (write returned %zd)\n",
-                        written);
-                goto fail;
-            }
-        }
+        membuf_reserve_window(cpu, size + size2);
+        membuf_write(start, size);
+        if ( size2 )
+            membuf_write(start2, size2);
+        return;
     }
 
-    if ( opts.memory_buffer )
+    /* Write a CPU_BUF record on each buffer "window" written. */
+    rec.header = CPU_CHANGE_HEADER;
+    rec.data.cpu = cpu;
+    rec.data.window_size = size + size2;
+
+    iov[iovcnt].iov_base = &rec;
+    iov[iovcnt++].iov_len = sizeof(rec);
+    iov[iovcnt].iov_base = start;
+    iov[iovcnt++].iov_len = size;
+    if ( size2 )
     {
-        membuf_write(start, size);
+        iov[iovcnt].iov_base = start2;
+        iov[iovcnt++].iov_len = size2;
     }
-    else
+
+    if ( write_all(iov, iovcnt) )
     {
-        written = write(outfd, start, size);
-        if ( written != size )
-        {
-            fprintf(stderr, "Write failed! (size %d, returned %zd)\n",
-                    size, written);
-            goto fail;
-        }
+        fprintf(stderr, "Write failed! (size %zu)\n",
+                sizeof(rec) + size + size2);
+        goto fail;
     }
 
     return;
@@ -747,9 +775,8 @@ static int monitor_tbufs(void)
             if ( end_offset > start_offset )
             {
                 /* If window does not wrap, write in one big chunk */
-                write_buffer(i, data[i]+start_offset,
-                             window_size,
-                             window_size);
+                write_buffer(i, data[i] + start_offset, window_size,
+                             NULL, 0);
             }
             else
             {
@@ -759,10 +786,7 @@ static int monitor_tbufs(void)
                  */
                 write_buffer(i, data[i] + start_offset,
                              data_size - start_offset,
-                             window_size);
-                write_buffer(i, data[i],
-                             end_offset,
-                             0);
+                             data[i], end_offset);
             }
 
             xen_mb(); /* read buffer, then update cons. */
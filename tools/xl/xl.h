@@ -49,6 +49,8 @@ struct domain_create {
     bool userspace_colo_proxy;
     int migrate_fd; /* -1 means none */
     int send_back_fd; /* -1 means none */
+    const int *aux_fds; /* auxiliary migration streams */
+    int num_aux_fds;
     char **migration_domname_r; /* from malloc */
 };
 
@@ -67,6 +69,9 @@ static const char migrate_permission_to_go[]=
     "domain is yours, you are cleared to unpause";
 static const char migrate_report[]=
     "my copy unpause results are as follows";
+/* followed by " <address> <port> <token>\n", for migrate --streams */
+static const char migrate_streams_msg[]=
+    "xl migration streams:";
 #endif
 
   /* followed by one byte:
@@ -141,12 +146,15 @@ int main_reboot(int argc, char **argv);
 int main_list(int argc, char **argv);
 int main_vm_list(int argc, char **argv);
 int main_create(int argc, char **argv);
+int main_prewarm(int argc, char **argv);
+int main_prewarm_claim(int argc, char **argv);
 int main_config_update(int argc, char **argv);
 int main_button_press(int argc, char **argv);
 int main_vcpupin(int argc, char **argv);
 int main_vcpuset(int argc, char **argv);
 int main_memmax(int argc, char **argv);
 int main_memset(int argc, char **argv);
+int main_numamigrate(int argc, char **argv);
 int main_sched_credit(int argc, char **argv);
 int main_sched_credit2(int argc, char **argv);
 int main_sched_rtds(int argc, char **argv);
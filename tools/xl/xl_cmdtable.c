@@ -38,6 +38,17 @@ struct cmd_spec cmd_table[] = {
       "                        Pass VNC password to viewer via stdin.\n"
       "--ignore-global-affinity-masks Ignore global masks in xl.conf."
     },
+    { "prewarm",
+      &main_prewarm, 0, 1,
+      "Create paused domains to be started later with prewarm-claim",
+      "[-n COUNT] <Pool> <ConfigFile> [vars]",
+      "-n COUNT                Number of domains to create (default 1)."
+    },
+    { "prewarm-claim",
+      &main_prewarm_claim, 0, 1,
+      "Start a prewarmed domain from a pool, using a new name",
+      "<Pool> <NewDomainName>",
+    },
     { "config-update",
       &main_config_update, 1, 1,
       "Update a running domain's saved configuration, used when rebuilding "
@@ -169,7 +180,10 @@ struct cmd_spec cmd_table[] = {
       "                of the domain.\n"
       "--debug         Print huge (!) amount of debug during the migration process.\n"
       "-p              Do not unpause domain after migrating it.\n"
-      "-D              Preserve the domain id"
+      "-D              Preserve the domain id\n"
+      "--streams <N>   Send memory over <N> extra TCP connections to <host>.\n"
+      "--auto-converge Throttle the domain if it dirties memory faster than it\n"
+      "                can be sent."
     },
     { "restore",
       &main_restore, 0, 1,
@@ -213,6 +227,11 @@ struct cmd_spec cmd_table[] = {
       "Set the current memory usage for a domain",
       "<Domain> <MemMB['b'[bytes]|'k'[KB]|'m'[MB]|'g'[GB]|'t'[TB]]>",
     },
+    { "numa-migrate",
+      &main_numamigrate, 0, 1,
+      "Move the memory of a domain to a NUMA node",
+      "<Domain> <Node>",
+    },
     { "button-press",
       &main_button_press, 0, 1,
       "Indicate an ACPI button press to the domain",
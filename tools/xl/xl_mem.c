@@ -12,6 +12,7 @@
  * GNU Lesser General Public License for more details.
  */
 
+#include <inttypes.h>
 #include <stdlib.h>
 
 #include <libxl.h>
@@ -90,6 +91,39 @@ int main_memset(int argc, char **argv)
     return set_memory_target(domid, mem);
 }
 
+int main_numamigrate(int argc, char **argv)
+{
+    uint32_t domid;
+    unsigned long node;
+    uint64_t moved;
+    int opt = 0, rc;
+    char *endptr;
+
+    SWITCH_FOREACH_OPT(opt, "", NULL, "numa-migrate", 2) {
+        /* No options */
+    }
+
+    domid = find_domain(argv[optind]);
+    node = strtoul(argv[optind + 1], &endptr, 10);
+    if (*endptr || node > UINT32_MAX) {
+        fprintf(stderr, "invalid node: %s\n", argv[optind + 1]);
+        return EXIT_FAILURE;
+    }
+
+    rc = libxl_domain_move_memory(ctx, domid, node, &moved);
+    if (rc) {
+        fprintf(stderr, "cannot move memory of domid %u to node %lu%s\n",
+                domid, node,
+                rc == ERROR_NI ? ": not supported for this domain" : "");
+        return EXIT_FAILURE;
+    }
+
+    printf("Moved %"PRIu64" pages of domid %u to node %lu\n",
+           moved, domid, node);
+
+    return EXIT_SUCCESS;
+}
+
 static void sharing(const libxl_dominfo *info, int nb_domain)
 {
     int i;
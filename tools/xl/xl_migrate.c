@@ -14,8 +14,11 @@
 
 #include <fcntl.h>
 #include <inttypes.h>
+#include <netdb.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdlib.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/utsname.h>
@@ -151,9 +154,204 @@ static void migration_child_report(int recv_fd) {
     }
 }
 
+/*
+ * Auxiliary streams (migrate --streams).  The receiver listens on a TCP
+ * port and sends the address, the port and a random token down the
+ * transport.  The sender makes that many connections, presenting the token
+ * on each, and the receiver accepts connections until it has as many as
+ * were asked for with the right token.
+ *
+ * The streams are not encrypted: they are meant for a trusted migration
+ * network, where a single ssh connection would be the bottleneck.
+ */
+#define MIGRATE_STREAMS_MAX       16
+#define MIGRATE_TOKEN_LEN         32 /* hex digits */
+#define MIGRATE_ACCEPT_TIMEOUT_MS 30000
+
+static void migrate_make_token(char token[MIGRATE_TOKEN_LEN + 1])
+{
+    uint8_t bytes[MIGRATE_TOKEN_LEN / 2];
+    int fd, i;
+
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd < 0 ||
+        libxl_read_exactly(ctx, fd, bytes, sizeof(bytes),
+                           "/dev/urandom", "migration stream token")) {
+        fprintf(stderr, "migration target: Failed to make a stream token\n");
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    for (i = 0; i < sizeof(bytes); i++)
+        sprintf(token + 2 * i, "%02x", bytes[i]);
+}
+
+static void migrate_listen_streams(int send_fd, int nr_streams, int *aux_fds)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+        .ai_flags = AI_PASSIVE | AI_NUMERICHOST,
+    }, *ai = NULL;
+    struct sockaddr_storage ss;
+    socklen_t sslen = sizeof(ss);
+    char addr[NI_MAXHOST] = "-", port[NI_MAXSERV];
+    char token[MIGRATE_TOKEN_LEN + 1], buf[MIGRATE_TOKEN_LEN];
+    const char *ssh = getenv("SSH_CONNECTION");
+    struct timeval tv = { .tv_sec = 10 };
+    char *msg;
+    int lfd, fd, n = 0, rc;
+
+    /* Listen on the address the ssh connection arrived on, if known. */
+    if (!ssh || sscanf(ssh, "%*s %*s %1024s", addr) != 1)
+        strcpy(addr, "-");
+
+    rc = getaddrinfo(strcmp(addr, "-") ? addr : NULL, "0", &hints, &ai);
+    if (rc) {
+        fprintf(stderr, "migration target: Failed to resolve %s: %s\n",
+                addr, gai_strerror(rc));
+        exit(EXIT_FAILURE);
+    }
+
+    lfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (lfd < 0 ||
+        bind(lfd, ai->ai_addr, ai->ai_addrlen) ||
+        listen(lfd, nr_streams) ||
+        getsockname(lfd, (struct sockaddr *)&ss, &sslen) ||
+        getnameinfo((struct sockaddr *)&ss, sslen, NULL, 0,
+                    port, sizeof(port), NI_NUMERICSERV)) {
+        perror("migration target: Failed to listen for streams");
+        exit(EXIT_FAILURE);
+    }
+    freeaddrinfo(ai);
+
+    migrate_make_token(token);
+
+    xasprintf(&msg, "%s %s %s %s\n", migrate_streams_msg, addr, port, token);
+    CHK_ERRNOVAL(libxl_write_exactly(ctx, send_fd, msg, strlen(msg),
+                                     "migration ack stream",
+                                     "stream address") );
+    free(msg);
+
+    while (n < nr_streams) {
+        struct pollfd pfd = { .fd = lfd, .events = POLLIN };
+
+        rc = poll(&pfd, 1, MIGRATE_ACCEPT_TIMEOUT_MS);
+        if (rc < 0 && errno == EINTR)
+            continue;
+        if (rc <= 0) {
+            fprintf(stderr, "migration target: Only %d of %d streams"
+                    " connected\n", n, nr_streams);
+            exit(EXIT_FAILURE);
+        }
+
+        fd = accept(lfd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        /* Don't let a stray connection hold us up for long. */
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        if (libxl_read_exactly(ctx, fd, buf, sizeof(buf),
+                               "migration stream", "token") ||
+            memcmp(buf, token, sizeof(buf))) {
+            fprintf(stderr, "migration target: Rejecting stream connection"
+                    " with a bad token\n");
+            close(fd);
+            continue;
+        }
+        tv.tv_sec = 0;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        tv.tv_sec = 10;
+
+        aux_fds[n++] = fd;
+    }
+
+    close(lfd);
+}
+
+static void migrate_connect_streams(int recv_fd, const char *host,
+                                    int nr_streams, int *aux_fds,
+                                    const char *rune)
+{
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_STREAM,
+    }, *ais = NULL, *ai;
+    char line[NI_MAXHOST + NI_MAXSERV + MIGRATE_TOKEN_LEN + 64];
+    char addr[NI_MAXHOST], port[NI_MAXSERV], token[MIGRATE_TOKEN_LEN + 1];
+    const size_t msglen = sizeof(migrate_streams_msg) - 1;
+    size_t len = 0;
+    int fd, n, rc;
+
+    do {
+        if (len == sizeof(line) - 1 ||
+            libxl_read_exactly(ctx, recv_fd, &line[len], 1,
+                               "migration receiver stream", "stream address"))
+            goto bad;
+    } while (line[len++] != '\n');
+    line[len] = '\0';
+
+    if (strncmp(line, migrate_streams_msg, msglen) ||
+        sscanf(line + msglen, " %1024s %31s %32s", addr, port, token) != 3 ||
+        strlen(token) != MIGRATE_TOKEN_LEN)
+        goto bad;
+
+    /* The receiver doesn't know its address; use the one we ssh'd to. */
+    if (!strcmp(addr, "-")) {
+        const char *at;
+
+        if (!host) {
+            fprintf(stderr, "migration sender: Receiver address unknown\n");
+            exit(EXIT_FAILURE);
+        }
+        at = strrchr(host, '@');
+        snprintf(addr, sizeof(addr), "%s", at ? at + 1 : host);
+    }
+
+    rc = getaddrinfo(addr, port, &hints, &ais);
+    if (rc) {
+        fprintf(stderr, "migration sender: Failed to resolve %s: %s\n",
+                addr, gai_strerror(rc));
+        exit(EXIT_FAILURE);
+    }
+
+    for (n = 0; n < nr_streams; n++) {
+        fd = -1;
+        for (ai = ais; ai; ai = ai->ai_next) {
+            fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+            if (fd < 0)
+                continue;
+            if (!connect(fd, ai->ai_addr, ai->ai_addrlen))
+                break;
+            close(fd);
+            fd = -1;
+        }
+        if (fd < 0) {
+            fprintf(stderr, "migration sender: Failed to connect stream"
+                    " to %s port %s: %s\n", addr, port, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        CHK_ERRNOVAL(libxl_write_exactly(ctx, fd, token, MIGRATE_TOKEN_LEN,
+                                         "migration stream", "token") );
+        aux_fds[n] = fd;
+    }
+
+    freeaddrinfo(ais);
+    return;
+
+ bad:
+    fprintf(stderr, "migration receiver stream contained unexpected data"
+            " instead of the stream address\n");
+    if (rune)
+        fprintf(stderr, "(command run was: %s )\n", rune);
+    exit(EXIT_FAILURE);
+}
+
 static void migrate_do_preamble(int send_fd, int recv_fd, pid_t child,
                                 uint8_t *config_data, int config_len,
-                                const char *rune)
+                                const char *rune, const char *host,
+                                int nr_streams, int *aux_fds)
 {
     int rc = 0;
 
@@ -171,18 +369,23 @@ static void migrate_do_preamble(int send_fd, int recv_fd, pid_t child,
         exit(EXIT_FAILURE);
     }
 
+    if (nr_streams)
+        migrate_connect_streams(recv_fd, host, nr_streams, aux_fds, rune);
+
     save_domain_core_writeconfig(send_fd, "migration stream",
                                  config_data, config_len);
 
 }
 
 static void migrate_domain(uint32_t domid, int preserve_domid,
-                           const char *rune, int debug,
+                           const char *rune, const char *host, int debug,
+                           int auto_converge, int nr_streams,
                            const char *override_config_file)
 {
     pid_t child = -1;
     int rc;
     int send_fd = -1, recv_fd = -1;
+    int aux_fds[MIGRATE_STREAMS_MAX];
     char *away_domname;
     char rc_buf;
     uint8_t *config_data;
@@ -200,13 +403,16 @@ static void migrate_domain(uint32_t domid, int preserve_domid,
     child = create_migration_child(rune, &send_fd, &recv_fd);
 
     migrate_do_preamble(send_fd, recv_fd, child, config_data, config_len,
-                        rune);
+                        rune, host, nr_streams, aux_fds);
 
     xtl_stdiostream_adjust_flags(logger, XTL_STDIOSTREAM_HIDE_PROGRESS, 0);
 
     if (debug)
         flags |= LIBXL_SUSPEND_DEBUG;
-    rc = libxl_domain_suspend(ctx, domid, send_fd, flags, NULL);
+    if (auto_converge)
+        flags |= LIBXL_SUSPEND_AUTO_CONVERGE;
+    rc = libxl_domain_suspend_streams(ctx, domid, send_fd,
+                                      aux_fds, nr_streams, flags, NULL);
     if (rc) {
         fprintf(stderr, "migration sender: libxl_domain_suspend failed"
                 " (rc=%d)\n", rc);
@@ -318,11 +524,12 @@ static void migrate_domain(uint32_t domid, int preserve_domid,
 
 static void migrate_receive(int debug, int daemonize, int monitor,
                             int pause_after_migration,
-                            int send_fd, int recv_fd,
+                            int send_fd, int recv_fd, int nr_streams,
                             libxl_checkpointed_stream checkpointed,
                             char *colo_proxy_script,
                             bool userspace_colo_proxy)
 {
+    int aux_fds[MIGRATE_STREAMS_MAX];
     uint32_t domid;
     int rc, rc2;
     char rc_buf;
@@ -339,6 +546,9 @@ static void migrate_receive(int debug, int daemonize, int monitor,
                      sizeof(migrate_receiver_banner)-1,
                      "migration ack stream", "banner") );
 
+    if (nr_streams)
+        migrate_listen_streams(send_fd, nr_streams, aux_fds);
+
     memset(&dom_info, 0, sizeof(dom_info));
     dom_info.debug = debug;
     dom_info.daemonize = daemonize;
@@ -346,6 +556,8 @@ static void migrate_receive(int debug, int daemonize, int monitor,
     dom_info.paused = 1;
     dom_info.migrate_fd = recv_fd;
     dom_info.send_back_fd = send_fd;
+    dom_info.aux_fds = aux_fds;
+    dom_info.num_aux_fds = nr_streams;
     dom_info.migration_domname_r = &migration_domname;
     dom_info.checkpointed_stream = checkpointed;
     dom_info.colo_proxy_script = colo_proxy_script;
@@ -480,7 +692,7 @@ int main_migrate_receive(int argc, char **argv)
 {
     int debug = 0, daemonize = 1, monitor = 1, pause_after_migration = 0;
     libxl_checkpointed_stream checkpointed = LIBXL_CHECKPOINTED_STREAM_NONE;
-    int opt;
+    int opt, nr_streams = 0;
     bool userspace_colo_proxy = false;
     char *script = NULL;
     static struct option opts[] = {
@@ -488,6 +700,7 @@ int main_migrate_receive(int argc, char **argv)
         /* It is a shame that the management code for disk is not here. */
         {"coloft-script", 1, 0, 0x200},
         {"userspace-colo-proxy", 0, 0, 0x300},
+        {"streams", 1, 0, 0x400},
         COMMON_LONG_OPTS
     };
 
@@ -514,17 +727,22 @@ int main_migrate_receive(int argc, char **argv)
     case 0x300:
         userspace_colo_proxy = true;
         break;
+    case 0x400:
+        nr_streams = atoi(optarg);
+        break;
     case 'p':
         pause_after_migration = 1;
         break;
     }
 
-    if (argc-optind != 0) {
+    if (argc-optind != 0 ||
+        nr_streams < 0 || nr_streams > MIGRATE_STREAMS_MAX ||
+        (nr_streams && checkpointed != LIBXL_CHECKPOINTED_STREAM_NONE)) {
         help("migrate-receive");
         return EXIT_FAILURE;
     }
     migrate_receive(debug, daemonize, monitor, pause_after_migration,
-                    STDOUT_FILENO, STDIN_FILENO,
+                    STDOUT_FILENO, STDIN_FILENO, nr_streams,
                     checkpointed, script, userspace_colo_proxy);
 
     return EXIT_SUCCESS;
@@ -538,10 +756,12 @@ int main_migrate(int argc, char **argv)
     char *rune = NULL;
     char *host;
     int opt, daemonize = 1, monitor = 1, debug = 0, pause_after_migration = 0;
-    int preserve_domid = 0;
+    int preserve_domid = 0, nr_streams = 0, auto_converge = 0;
     static struct option opts[] = {
         {"debug", 0, 0, 0x100},
         {"live", 0, 0, 0x200},
+        {"streams", 1, 0, 0x300},
+        {"auto-converge", 0, 0, 0x400},
         COMMON_LONG_OPTS
     };
 
@@ -571,6 +791,17 @@ int main_migrate(int argc, char **argv)
     case 0x200: /* --live */
         /* ignored for compatibility with xm */
         break;
+    case 0x300: /* --streams */
+        nr_streams = atoi(optarg);
+        if (nr_streams < 0 || nr_streams > MIGRATE_STREAMS_MAX) {
+            fprintf(stderr, "--streams must be between 0 and %d\n",
+                    MIGRATE_STREAMS_MAX);
+            return EXIT_FAILURE;
+        }
+        break;
+    case 0x400: /* --auto-converge */
+        auto_converge = 1;
+        break;
     }
 
     domid = find_domain(argv[optind]);
@@ -592,16 +823,24 @@ int main_migrate(int argc, char **argv)
         } else {
             verbose_len = (minmsglevel_default - minmsglevel) + 2;
         }
-        xasprintf(&rune, "exec %s %s xl%s%.*s migrate-receive%s%s%s",
+        char *streams_arg = NULL;
+
+        if (nr_streams)
+            xasprintf(&streams_arg, " --streams %d", nr_streams);
+        xasprintf(&rune, "exec %s %s xl%s%.*s migrate-receive%s%s%s%s",
                   ssh_command, host,
                   pass_tty_arg ? " -t" : "",
                   verbose_len, verbose_buf,
                   daemonize ? "" : " -e",
                   debug ? " -d" : "",
-                  pause_after_migration ? " -p" : "");
+                  pause_after_migration ? " -p" : "",
+                  streams_arg ?: "");
+        free(streams_arg);
     }
 
-    migrate_domain(domid, preserve_domid, rune, debug, config_filename);
+    migrate_domain(domid, preserve_domid, rune,
+                   ssh_command[0] ? host : NULL, debug, auto_converge,
+                   nr_streams, config_filename);
     return EXIT_SUCCESS;
 }
 
@@ -732,7 +971,7 @@ int main_remus(int argc, char **argv)
         child = create_migration_child(rune, &send_fd, &recv_fd);
 
         migrate_do_preamble(send_fd, recv_fd, child, config_data, config_len,
-                            rune);
+                            rune, NULL, 0, NULL);
 
         if (ssh_command[0])
             free(rune);
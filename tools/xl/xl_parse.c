@@ -572,6 +572,52 @@ int parse_nic_config(libxl_device_nic *nic, XLU_Config **config, char *token)
     return 0;
 }
 
+/* Parse "llc_colors", a list of colors and color ranges like "0-3,8". */
+static void parse_llc_colors(const XLU_Config *config,
+                             libxl_domain_build_info *b_info)
+{
+    const char *buf, *p;
+    char *endptr;
+    unsigned long start, end;
+
+    if (xlu_cfg_get_string(config, "llc_colors", &buf, 0))
+        return;
+
+    for (p = buf; *p; p = endptr) {
+        start = strtoul(p, &endptr, 10);
+        if (endptr == p)
+            goto err;
+        end = start;
+        if (*endptr == '-') {
+            p = endptr + 1;
+            end = strtoul(p, &endptr, 10);
+            if (endptr == p || end < start)
+                goto err;
+        }
+
+        for (; start <= end; start++) {
+            b_info->llc_colors = xrealloc(b_info->llc_colors,
+                                          sizeof(*b_info->llc_colors) *
+                                          (b_info->num_llc_colors + 1));
+            b_info->llc_colors[b_info->num_llc_colors++] = start;
+        }
+
+        if (*endptr == ',')
+            endptr++;
+        else if (*endptr)
+            goto err;
+    }
+
+    if (!b_info->num_llc_colors)
+        goto err;
+
+    return;
+
+ err:
+    fprintf(stderr, "Invalid llc_colors \"%s\"\n", buf);
+    exit(EXIT_FAILURE);
+}
+
 static void parse_vnuma_config(const XLU_Config *config,
                                libxl_domain_build_info *b_info)
 {
@@ -1390,6 +1436,8 @@ void parse_config_data(const char *config_source,
 
     parse_vnuma_config(config, b_info);
 
+    parse_llc_colors(config, b_info);
+
     /* Set max_memkb to target_memkb and max_vcpus to avail_vcpus if
      * they are not set by user specified config option or vnuma.
      */
@@ -1743,6 +1791,7 @@ void parse_config_data(const char *config_source,
                                &b_info->u.hvm.smbios_firmware, 0);
         xlu_cfg_replace_string(config, "acpi_firmware",
                                &b_info->u.hvm.acpi_firmware, 0);
+        xlu_cfg_get_defbool(config, "fast_boot", &b_info->u.hvm.fast_boot, 0);
 
         if (!xlu_cfg_get_string(config, "ms_vm_genid", &buf, 0)) {
             if (!strcmp(buf, "generate")) {
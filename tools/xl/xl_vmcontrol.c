@@ -920,6 +920,13 @@ start:
         params.colo_proxy_script = dom_info->colo_proxy_script;
         libxl_defbool_set(&params.userspace_colo_proxy,
                           dom_info->userspace_colo_proxy);
+        if (dom_info->num_aux_fds) {
+            params.num_aux_fds = dom_info->num_aux_fds;
+            params.aux_fds = xcalloc(params.num_aux_fds,
+                                     sizeof(*params.aux_fds));
+            memcpy(params.aux_fds, dom_info->aux_fds,
+                   params.num_aux_fds * sizeof(*params.aux_fds));
+        }
 
         ret = libxl_domain_create_restore(ctx, &d_config,
                                           &domid, restore_fd,
@@ -1262,6 +1269,104 @@ int main_create(int argc, char **argv)
     return 0;
 }
 
+int main_prewarm(int argc, char **argv)
+{
+    const char *pool, *filename;
+    int count = 1, opt, i, j, rc;
+
+    SWITCH_FOREACH_OPT(opt, "n:", NULL, "prewarm", 2) {
+    case 'n':
+        count = strtol(optarg, NULL, 10);
+        break;
+    }
+
+    if (count < 1) {
+        help("prewarm");
+        return 2;
+    }
+
+    pool = argv[optind++];
+    filename = argv[optind++];
+
+    for (i = 0; i < count; i++) {
+        struct domain_create dom_info;
+        uint32_t domid;
+        unsigned int n;
+        char *name;
+
+        /* Prewarmed domains get a placeholder name until claimed. */
+        for (n = 0; ; n++) {
+            xasprintf(&name, "%s-prewarm-%u", pool, n);
+            if (libxl_name_to_domid(ctx, name, &domid))
+                break;
+            free(name);
+        }
+
+        memset(&dom_info, 0, sizeof(dom_info));
+        xasprintf(&dom_info.extra_config, "name=\"%s\"\n", name);
+        for (j = optind; j < argc; j++) {
+            string_realloc_append(&dom_info.extra_config, argv[j]);
+            string_realloc_append(&dom_info.extra_config, "\n");
+        }
+
+        dom_info.daemonize = 1;
+        dom_info.monitor = 1;
+        dom_info.paused = 1;
+        dom_info.quiet = 1;
+        dom_info.config_file = filename;
+        dom_info.migrate_fd = -1;
+        dom_info.send_back_fd = -1;
+
+        rc = create_domain(&dom_info);
+        free(dom_info.extra_config);
+        if (rc < 0) {
+            fprintf(stderr, "Failed to create prewarmed domain %s\n", name);
+            free(name);
+            return -rc;
+        }
+        domid = rc;
+
+        if (libxl_domain_prewarm_add(ctx, domid, pool)) {
+            fprintf(stderr, "Failed to add %s to pool %s\n", name, pool);
+            libxl_domain_destroy(ctx, domid, 0);
+            free(name);
+            return 1;
+        }
+
+        printf("Domain %s (domid %u) added to pool %s\n", name, domid, pool);
+        free(name);
+    }
+
+    return 0;
+}
+
+int main_prewarm_claim(int argc, char **argv)
+{
+    const char *pool, *name;
+    uint32_t domid;
+    int opt, rc;
+
+    SWITCH_FOREACH_OPT(opt, "", NULL, "prewarm-claim", 2) {
+        /* No options */
+    }
+
+    pool = argv[optind++];
+    name = argv[optind];
+
+    rc = libxl_domain_prewarm_claim(ctx, pool, name, &domid, NULL);
+    if (rc) {
+        if (rc == ERROR_NOTFOUND)
+            fprintf(stderr, "No prewarmed domain left in pool %s\n", pool);
+        else
+            fprintf(stderr, "Failed to start a domain from pool %s\n", pool);
+        return 1;
+    }
+
+    printf("%u\n", domid);
+
+    return 0;
+}
+
 /*
  * Local variables:
  * mode: C
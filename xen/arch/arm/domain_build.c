@@ -6,6 +6,8 @@
 #include <xen/domain_page.h>
 #include <xen/sched.h>
 #include <xen/sizes.h>
+#include <xen/softirq.h>
+#include <xen/tasklet.h>
 #include <asm/irq.h>
 #include <asm/regs.h>
 #include <xen/errno.h>
@@ -14,6 +16,7 @@
 #include <xen/libfdt/libfdt.h>
 #include <xen/guest_access.h>
 #include <xen/iocap.h>
+#include <xen/llc-coloring.h>
 #include <xen/acpi.h>
 #include <xen/vmap.h>
 #include <xen/warning.h>
@@ -36,6 +39,10 @@ integer_param("dom0_max_vcpus", opt_dom0_max_vcpus);
 static u64 __initdata dom0_mem;
 static bool __initdata dom0_mem_set;
 
+/* Construct dom0less domains concurrently on all online CPUs. */
+static bool __initdata opt_dom0less_parallel = true;
+boolean_param("dom0less-parallel", opt_dom0less_parallel);
+
 static int __init parse_dom0_mem(const char *s)
 {
     dom0_mem_set = true;
@@ -2467,15 +2474,57 @@ static int __init construct_domU(struct domain *d,
     return rc;
 }
 
+struct domU_build {
+    struct domain *d;
+    const struct dt_device_node *node;
+    unsigned int cpu;
+    struct tasklet tasklet;
+    int rc;
+};
+
+static atomic_t __initdata domU_builds_pending;
+
+static void __init domU_build_work(void *data)
+{
+    struct domU_build *build = data;
+
+    build->rc = construct_domU(build->d, build->node);
+
+    smp_wmb(); /* Result must be visible before the completion. */
+    atomic_dec(&domU_builds_pending);
+}
+
 void __init create_domUs(void)
 {
     struct dt_device_node *node;
     const struct dt_device_node *chosen = dt_find_node_by_path("/chosen");
+    struct domU_build *builds;
+    unsigned int i, nr = 0, cpu = smp_processor_id();
 
     BUG_ON(chosen == NULL);
+
+    dt_for_each_child_node(chosen, node)
+        if ( dt_device_is_compatible(node, "xen,domain") )
+            nr++;
+
+    if ( !nr )
+        return;
+
+    builds = xzalloc_array(struct domU_build, nr);
+    if ( !builds )
+        panic("Unable to allocate dom0less build state\n");
+
+    /*
+     * Domains are created one after the other, so that domids are handed
+     * out in device tree order.  Building them - allocating, scrubbing and
+     * loading their memory - is what takes time, so that part is spread
+     * over all online CPUs, this one included.
+     */
+    nr = 0;
     dt_for_each_child_node(chosen, node)
     {
         struct domain *d;
+        const char *llc_colors_str;
         struct xen_domctl_createdomain d_cfg = {
             .arch.gic_version = XEN_DOMCTL_CONFIG_GIC_NATIVE,
             .flags = XEN_DOMCTL_CDF_hvm | XEN_DOMCTL_CDF_hap,
@@ -2513,11 +2562,58 @@ void __init create_domUs(void)
 
         d->is_console = true;
 
-        if ( construct_domU(d, node) != 0 )
-            panic("Could not set up domain %s\n", dt_node_name(node));
+        /* Colors must be set before any memory is given to the domain. */
+        if ( !dt_property_read_string(node, "llc-colors", &llc_colors_str) )
+        {
+            if ( !llc_coloring_enabled )
+                printk(XENLOG_WARNING
+                       "%s: LLC coloring is disabled, ignoring 'llc-colors'\n",
+                       dt_node_name(node));
+            else if ( domain_set_llc_colors_from_str(d, llc_colors_str) )
+                panic("Error setting LLC colors for domain %s\n",
+                      dt_node_name(node));
+        }
+
+        if ( opt_dom0less_parallel )
+            cpu = cpumask_cycle(cpu, &cpu_online_map);
 
-        domain_unpause_by_systemcontroller(d);
+        builds[nr].d = d;
+        builds[nr].node = node;
+        builds[nr].cpu = cpu;
+        tasklet_init(&builds[nr].tasklet, domU_build_work, &builds[nr]);
+        nr++;
     }
+
+    atomic_set(&domU_builds_pending, nr);
+
+    for ( i = 0; i < nr; i++ )
+        if ( builds[i].cpu != smp_processor_id() )
+            tasklet_schedule_on_cpu(&builds[i].tasklet, builds[i].cpu);
+
+    for ( i = 0; i < nr; i++ )
+        if ( builds[i].cpu == smp_processor_id() )
+            domU_build_work(&builds[i]);
+
+    while ( atomic_read(&domU_builds_pending) )
+    {
+        process_pending_softirqs();
+        cpu_relax();
+    }
+    smp_rmb();
+
+    for ( i = 0; i < nr; i++ )
+    {
+        /* The tasklet code may still be touching it after the last dec. */
+        tasklet_kill(&builds[i].tasklet);
+
+        if ( builds[i].rc )
+            panic("Could not set up domain %s\n",
+                  dt_node_name(builds[i].node));
+
+        domain_unpause_by_systemcontroller(builds[i].d);
+    }
+
+    xfree(builds);
 }
 
 int __init construct_dom0(struct domain *d)
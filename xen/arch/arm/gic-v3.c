@@ -778,6 +778,18 @@ static int __init gicv3_populate_rdist(void)
 
                 printk("GICv3: CPU%d: Found redistributor in region %d @%p\n",
                         smp_processor_id(), i, ptr);
+
+                /*
+                 * Direct vLPI injection (GICv4, or GICv4.1 when the
+                 * redistributor has RVPEID) would let the ITS deliver
+                 * guest LPIs without going through gicv3_do_LPI(). This
+                 * needs vPE tables and VMAPP/VMOVP handling in the ITS
+                 * driver, which we don't have yet, so just say so once.
+                 */
+                if ( (typer & GICR_TYPER_VLPIS) && !smp_processor_id() )
+                    printk("GICv3: GICv4%s direct vLPI injection available but not used\n",
+                           (typer & GICR_TYPER_RVPEID) ? ".1" : "");
+
                 return 0;
             }
 
@@ -27,6 +27,9 @@
 
 #define lr_all_full() (this_cpu(lr_mask) == ((1 << gic_get_nr_lrs()) - 1))
 
+/* Whether GICH_HCR.UIE is set on this pCPU, see gic_set_lr_underflow(). */
+static DEFINE_PER_CPU(bool, lr_underflow_armed);
+
 #undef GIC_DEBUG
 
 static void gic_update_one_lr(struct vcpu *v, int i);
@@ -249,6 +252,25 @@ static void gic_update_one_lr(struct vcpu *v, int i)
     }
 }
 
+/*
+ * When more interrupts are pending than there are LRs, the underflow
+ * maintenance interrupt tells us once the guest has drained the LRs, so the
+ * rest can be moved in as a batch.  HCR accesses aren't cheap (MMIO on
+ * GICv2), so only write it when the state changes rather than on every
+ * entry and exit while LRs overflow.
+ */
+static void gic_set_lr_underflow(bool arm)
+{
+    if ( this_cpu(lr_underflow_armed) == arm )
+        return;
+
+    if ( arm )
+        perfc_incr(vgic_lr_overflow);
+
+    gic_hw_ops->update_hcr_status(GICH_HCR_UIE, arm);
+    this_cpu(lr_underflow_armed) = arm;
+}
+
 void vgic_sync_from_lrs(struct vcpu *v)
 {
     int i = 0;
@@ -261,7 +283,7 @@ void vgic_sync_from_lrs(struct vcpu *v)
     if ( is_idle_vcpu(v) )
         return;
 
-    gic_hw_ops->update_hcr_status(GICH_HCR_UIE, false);
+    gic_set_lr_underflow(false);
 
     spin_lock_irqsave(&v->arch.vgic.lock, flags);
 
@@ -399,7 +421,7 @@ void vgic_sync_to_lrs(void)
     gic_restore_pending_irqs(current);
 
     if ( !list_empty(&current->arch.vgic.lr_pending) && lr_all_full() )
-        gic_hw_ops->update_hcr_status(GICH_HCR_UIE, true);
+        gic_set_lr_underflow(true);
 }
 
 void gic_dump_vgic_info(struct vcpu *v)
@@ -47,8 +47,12 @@ struct minimal_dtb_header {
  */
 void __init copy_from_paddr(void *dst, paddr_t paddr, unsigned long len)
 {
+    /* FIXMAP_MISC is shared by all CPUs, which may build domUs in parallel. */
+    static DEFINE_SPINLOCK(copy_lock);
     void *src = (void *)FIXMAP_ADDR(FIXMAP_MISC);
 
+    spin_lock(&copy_lock);
+
     while (len) {
         unsigned long l, s;
 
@@ -64,6 +68,8 @@ void __init copy_from_paddr(void *dst, paddr_t paddr, unsigned long len)
         dst += l;
         len -= l;
     }
+
+    spin_unlock(&copy_lock);
 }
 
 static void __init place_modules(struct kernel_info *info,
@@ -0,0 +1,92 @@
+/*
+ * Last Level Cache (LLC) coloring support for ARM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <xen/init.h>
+#include <xen/lib.h>
+#include <xen/llc-coloring.h>
+#include <xen/types.h>
+
+#include <asm/processor.h>
+#include <asm/sysregs.h>
+
+#define CLIDR_CTYPEn_SHIFT(n)   (3 * ((n) - 1))
+#define CLIDR_CTYPEn_MASK       0x7
+#define CLIDR_CTYPE_DATA        0x2
+#define CLIDR_CTYPE_SEPARATE    0x3
+#define CLIDR_CTYPE_UNIFIED     0x4
+#define CLIDR_MAX_LEVEL         7
+
+#define CCSIDR_LINESIZE_MASK    0x7
+#define CCSIDR_NUMSETS_SHIFT    13
+#define CCSIDR_NUMSETS_MASK     0x7fff
+#define CCSIDR_NUMSETS_SHIFT_FEAT_CCIDX 32
+#define CCSIDR_NUMSETS_MASK_FEAT_CCIDX  0xffffff
+
+#define ID_AA64MMFR2_CCIDX_SHIFT 20
+#define ID_AA64MMFR2_CCIDX_MASK  0xf
+
+/*
+ * The way size is the number of sets times the line size of the outermost
+ * data or unified cache level reported by CLIDR_EL1.
+ */
+unsigned int __init get_llc_way_size(void)
+{
+    register_t clidr = READ_SYSREG(CLIDR_EL1);
+    register_t csselr = READ_SYSREG(CSSELR_EL1);
+    uint64_t ccsidr, mmfr2 = READ_SYSREG64(ID_AA64MMFR2_EL1);
+    unsigned int level, ctype, line_size, num_sets;
+
+    for ( level = CLIDR_MAX_LEVEL; level; level-- )
+    {
+        ctype = (clidr >> CLIDR_CTYPEn_SHIFT(level)) & CLIDR_CTYPEn_MASK;
+        if ( ctype == CLIDR_CTYPE_DATA || ctype == CLIDR_CTYPE_SEPARATE ||
+             ctype == CLIDR_CTYPE_UNIFIED )
+            break;
+    }
+
+    if ( !level )
+        return 0;
+
+    /* Select the data/unified cache at that level. */
+    WRITE_SYSREG((level - 1) << 1, CSSELR_EL1);
+    isb();
+    ccsidr = READ_SYSREG64(CCSIDR_EL1);
+    WRITE_SYSREG(csselr, CSSELR_EL1);
+    isb();
+
+    line_size = 1U << ((ccsidr & CCSIDR_LINESIZE_MASK) + 4);
+
+    if ( (mmfr2 >> ID_AA64MMFR2_CCIDX_SHIFT) & ID_AA64MMFR2_CCIDX_MASK )
+        num_sets = ((ccsidr >> CCSIDR_NUMSETS_SHIFT_FEAT_CCIDX) &
+                    CCSIDR_NUMSETS_MASK_FEAT_CCIDX) + 1;
+    else
+        num_sets = ((ccsidr >> CCSIDR_NUMSETS_SHIFT) &
+                    CCSIDR_NUMSETS_MASK) + 1;
+
+    printk(XENLOG_INFO "LLC is L%u: %u sets of %u byte lines per way\n",
+           level, num_sets, line_size);
+
+    return line_size * num_sets;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
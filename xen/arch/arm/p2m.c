@@ -494,6 +494,11 @@ unsigned long p2m_pod_decrease_reservation(struct domain *d, gfn_t gfn,
     return 0;
 }
 
+long p2m_pod_report_free(struct domain *d, gfn_t gfn, unsigned int order)
+{
+    return -EOPNOTSUPP;
+}
+
 static void p2m_set_permission(lpae_t *e, p2m_type_t t, p2m_access_t a)
 {
     /* First apply type permissions */
@@ -867,6 +872,123 @@ static bool p2m_split_superpage(struct p2m_domain *p2m, lpae_t *entry,
     return rv;
 }
 
+/*
+ * Entries with the contiguous bit set come in naturally aligned groups
+ * of P2M_CONTIG_ENTRIES that the TLB may cache as a single translation.
+ * Before any entry of such a group is changed, the whole group has to go
+ * through break-before-make so the hint is dropped everywhere at once.
+ */
+static void p2m_break_contig(struct p2m_domain *p2m, lpae_t *table,
+                             unsigned int index)
+{
+    lpae_t *group = table + (index & ~(P2M_CONTIG_ENTRIES - 1));
+    lpae_t ptes[P2M_CONTIG_ENTRIES];
+    unsigned int i;
+
+    if ( !table[index].p2m.contig )
+        return;
+
+    for ( i = 0; i < P2M_CONTIG_ENTRIES; i++ )
+    {
+        ptes[i] = group[i];
+        ptes[i].p2m.contig = 0;
+        p2m_remove_pte(&group[i], p2m->clean_pte);
+    }
+
+    p2m_force_tlb_flush_sync(p2m);
+
+    for ( i = 0; i < P2M_CONTIG_ENTRIES; i++ )
+        p2m_write_pte(&group[i], ptes[i], p2m->clean_pte);
+}
+
+/*
+ * Try to map P2M_CONTIG_ENTRIES entries of the given order with the
+ * contiguous bit set. This is only done when the whole group is empty,
+ * so there is no previous translation that could conflict with the new
+ * one while the group is being written.
+ *
+ * Returns 1 if the range was mapped, 0 if the caller should fall back to
+ * mapping entries one by one, or a negative errno.
+ */
+static int p2m_set_contig_entries(struct p2m_domain *p2m,
+                                  gfn_t sgfn,
+                                  unsigned int page_order,
+                                  mfn_t smfn,
+                                  p2m_type_t t,
+                                  p2m_access_t a)
+{
+    unsigned int level;
+    unsigned int target = 3 - (page_order / LPAE_SHIFT);
+    unsigned long nr = (unsigned long)P2M_CONTIG_ENTRIES << page_order;
+    lpae_t *table, pte;
+    unsigned int i;
+    int rc = 0;
+    DECLARE_OFFSETS(offsets, gfn_to_gaddr(sgfn));
+
+    ASSERT(p2m_is_write_locked(p2m));
+    ASSERT(!(offsets[target] & (P2M_CONTIG_ENTRIES - 1)));
+
+    table = p2m_get_root_pointer(p2m, sgfn);
+    if ( !table )
+        return -EINVAL;
+
+    for ( level = P2M_ROOT_LEVEL; level < target; level++ )
+    {
+        rc = p2m_next_level(p2m, false, level, &table, offsets[level]);
+        if ( rc == GUEST_TABLE_MAP_FAILED )
+        {
+            rc = -ENOENT;
+            goto out;
+        }
+        else if ( rc != GUEST_TABLE_NORMAL_PAGE )
+        {
+            /* Covered by a superpage, leave it to __p2m_set_entry(). */
+            rc = 0;
+            goto out;
+        }
+    }
+
+    for ( i = 0; i < P2M_CONTIG_ENTRIES; i++ )
+    {
+        if ( p2m_is_valid(table[offsets[target] + i]) )
+        {
+            rc = 0;
+            goto out;
+        }
+    }
+
+    pte = mfn_to_p2m_entry(smfn, t, a);
+    if ( target < 3 )
+        pte.p2m.table = 0; /* Superpage entry */
+    pte.p2m.contig = 1;
+
+    for ( i = 0; i < P2M_CONTIG_ENTRIES; i++ )
+    {
+        lpae_set_mfn(pte, mfn_add(smfn, i << page_order));
+        p2m_write_pte(&table[offsets[target] + i], pte, p2m->clean_pte);
+    }
+
+    p2m->stats.mappings[target] += P2M_CONTIG_ENTRIES;
+    p2m->max_mapped_gfn = gfn_max(p2m->max_mapped_gfn,
+                                  gfn_add(sgfn, nr - 1));
+    p2m->lowest_mapped_gfn = gfn_min(p2m->lowest_mapped_gfn, sgfn);
+
+    rc = 1;
+    if ( is_iommu_enabled(p2m->domain) )
+    {
+        int ret = iommu_iotlb_flush(p2m->domain, _dfn(gfn_x(sgfn)), nr,
+                                    IOMMU_FLUSHF_added);
+
+        if ( ret )
+            rc = ret;
+    }
+
+out:
+    unmap_domain_page(table);
+
+    return rc;
+}
+
 /*
  * Insert an entry in the p2m. This should be called with a mapping
  * equal to a page/superpage (4K, 2M, 1G).
@@ -924,6 +1046,9 @@ static int __p2m_set_entry(struct p2m_domain *p2m,
 
     entry = table + offsets[level];
 
+    /* The entry is about to change, it can't stay in a contiguous group. */
+    p2m_break_contig(p2m, table, offsets[level]);
+
     /*
      * If we are here with level < target, we must be at a leaf node,
      * and we need to break up the superpage.
@@ -1024,13 +1149,15 @@ static int __p2m_set_entry(struct p2m_domain *p2m,
          * It is necessary to flush the TLB before writing the new entry
          * to keep coherency when the previous entry was valid.
          *
-         * Although, it could be defered when only the permissions are
-         * changed (e.g in case of memaccess).
+         * Although, it can be deferred to p2m_write_unlock() when only
+         * the permissions and/or the software type are changed (e.g.
+         * memaccess or a type change over a range): a stale TLB entry
+         * can only grant the old permissions until then, so a whole
+         * batch of such updates costs a single flush.
          */
         if ( lpae_is_valid(orig_pte) )
         {
-            if ( likely(!p2m->mem_access_enabled) ||
-                 P2M_CLEAR_PERM(pte) != P2M_CLEAR_PERM(orig_pte) )
+            if ( P2M_CLEAR_PERM_TYPE(pte) != P2M_CLEAR_PERM_TYPE(orig_pte) )
                 p2m_force_tlb_flush_sync(p2m);
             else
                 p2m->need_flush = true;
@@ -1109,7 +1236,24 @@ int p2m_set_entry(struct p2m_domain *p2m,
         else
             order = THIRD_ORDER;
 
-        rc = __p2m_set_entry(p2m, sgfn, order, smfn, t, a);
+        /*
+         * Use the contiguous hint when a whole aligned group of 4K or 2M
+         * entries is being mapped, so it only takes one TLB entry.
+         */
+        rc = 0;
+        if ( !mfn_eq(smfn, INVALID_MFN) && order != FIRST_ORDER &&
+             likely(!p2m->mem_access_enabled) &&
+             !(mask & ((1UL << (order + P2M_CONTIG_SHIFT)) - 1)) )
+            rc = p2m_set_contig_entries(p2m, sgfn, order, smfn, t, a);
+
+        if ( rc > 0 )
+        {
+            order += P2M_CONTIG_SHIFT;
+            rc = 0;
+        }
+        else if ( !rc )
+            rc = __p2m_set_entry(p2m, sgfn, order, smfn, t, a);
+
         if ( rc )
             break;
 
@@ -1261,9 +1405,29 @@ bool p2m_resolve_translation_fault(struct domain *d, gfn_t gfn)
      * another fault on that entry.
      */
     resolved = true;
-    entry.p2m.valid = 1;
 
-    p2m_write_pte(table + offsets[level], entry, p2m->clean_pte);
+    /*
+     * Entries in a contiguous group were invalidated together, and are
+     * made valid again together so the group stays consistent.
+     */
+    if ( entry.p2m.contig )
+    {
+        lpae_t *group = table +
+                        (offsets[level] & ~(P2M_CONTIG_ENTRIES - 1));
+        unsigned int i;
+
+        for ( i = 0; i < P2M_CONTIG_ENTRIES; i++ )
+        {
+            entry = group[i];
+            entry.p2m.valid = 1;
+            p2m_write_pte(&group[i], entry, p2m->clean_pte);
+        }
+    }
+    else
+    {
+        entry.p2m.valid = 1;
+        p2m_write_pte(table + offsets[level], entry, p2m->clean_pte);
+    }
 
     /*
      * No need to flush the TLBs as the modified entry had the valid bit
@@ -907,10 +907,56 @@ static void dump_its_command(uint64_t *command)
  * TODO: Investigate whether we can be smarter here and don't need to hold
  * the lock all of the time.
  */
+static int vgic_its_handle_cmd(struct virt_its *its, uint64_t *command)
+{
+    switch ( its_cmd_get_command(command) )
+    {
+    case GITS_CMD_CLEAR:
+        return its_handle_clear(its, command);
+    case GITS_CMD_DISCARD:
+        return its_handle_discard(its, command);
+    case GITS_CMD_INT:
+        return its_handle_int(its, command);
+    case GITS_CMD_INV:
+        return its_handle_inv(its, command);
+    case GITS_CMD_INVALL:
+        return its_handle_invall(its, command);
+    case GITS_CMD_MAPC:
+        return its_handle_mapc(its, command);
+    case GITS_CMD_MAPD:
+        return its_handle_mapd(its, command);
+    case GITS_CMD_MAPI:
+    case GITS_CMD_MAPTI:
+        return its_handle_mapti(its, command);
+    case GITS_CMD_MOVALL:
+        gdprintk(XENLOG_G_INFO, "vGITS: ignoring MOVALL command\n");
+        break;
+    case GITS_CMD_MOVI:
+        return its_handle_movi(its, command);
+    case GITS_CMD_SYNC:
+        /* We handle ITS commands synchronously, so we ignore SYNC. */
+        break;
+    default:
+        gdprintk(XENLOG_WARNING, "vGITS: unhandled ITS command\n");
+        dump_its_command(command);
+        break;
+    }
+
+    return 0;
+}
+
+/*
+ * Number of guest commands fetched with a single guest memory access.
+ * Each fetch needs a stage-2 translation and a mapping of the guest page,
+ * so reading a few commands at a time saves most of that for guests
+ * queueing up a large number of MAPTI/INV commands at once.
+ */
+#define VITS_CMD_BATCH                  8
+
 static int vgic_its_handle_cmds(struct domain *d, struct virt_its *its)
 {
     paddr_t addr = its->cbaser & GENMASK(51, 12);
-    uint64_t command[4];
+    uint64_t commands[VITS_CMD_BATCH][4];
 
     ASSERT(spin_is_locked(&its->vcmd_lock));
 
@@ -919,64 +965,35 @@ static int vgic_its_handle_cmds(struct domain *d, struct virt_its *its)
 
     while ( its->creadr != its->cwriter )
     {
+        uint64_t end;
+        unsigned int i, nr;
         int ret;
 
-        ret = access_guest_memory_by_ipa(d, addr + its->creadr,
-                                         command, sizeof(command), false);
+        /* Don't read past CWRITER or across the end of the ring. */
+        end = its->cwriter > its->creadr ? its->cwriter
+                                         : ITS_CMD_BUFFER_SIZE(its->cbaser);
+        nr = min_t(uint64_t, (end - its->creadr) / ITS_CMD_SIZE,
+                   VITS_CMD_BATCH);
+
+        ret = access_guest_memory_by_ipa(d, addr + its->creadr, commands,
+                                         nr * ITS_CMD_SIZE, false);
         if ( ret )
             return ret;
 
-        switch ( its_cmd_get_command(command) )
+        for ( i = 0; i < nr; i++ )
         {
-        case GITS_CMD_CLEAR:
-            ret = its_handle_clear(its, command);
-            break;
-        case GITS_CMD_DISCARD:
-            ret = its_handle_discard(its, command);
-            break;
-        case GITS_CMD_INT:
-            ret = its_handle_int(its, command);
-            break;
-        case GITS_CMD_INV:
-            ret = its_handle_inv(its, command);
-            break;
-        case GITS_CMD_INVALL:
-            ret = its_handle_invall(its, command);
-            break;
-        case GITS_CMD_MAPC:
-            ret = its_handle_mapc(its, command);
-            break;
-        case GITS_CMD_MAPD:
-            ret = its_handle_mapd(its, command);
-            break;
-        case GITS_CMD_MAPI:
-        case GITS_CMD_MAPTI:
-            ret = its_handle_mapti(its, command);
-            break;
-        case GITS_CMD_MOVALL:
-            gdprintk(XENLOG_G_INFO, "vGITS: ignoring MOVALL command\n");
-            break;
-        case GITS_CMD_MOVI:
-            ret = its_handle_movi(its, command);
-            break;
-        case GITS_CMD_SYNC:
-            /* We handle ITS commands synchronously, so we ignore SYNC. */
-            break;
-        default:
-            gdprintk(XENLOG_WARNING, "vGITS: unhandled ITS command\n");
-            dump_its_command(command);
-            break;
-        }
+            ret = vgic_its_handle_cmd(its, commands[i]);
 
-        write_u64_atomic(&its->creadr, (its->creadr + ITS_CMD_SIZE) %
-                         ITS_CMD_BUFFER_SIZE(its->cbaser));
+            write_u64_atomic(&its->creadr, (its->creadr + ITS_CMD_SIZE) %
+                             ITS_CMD_BUFFER_SIZE(its->cbaser));
 
-        if ( ret )
-        {
-            gdprintk(XENLOG_WARNING,
-                     "vGITS: ITS command error %d while handling command\n",
-                     ret);
-            dump_its_command(command);
+            if ( ret )
+            {
+                gdprintk(XENLOG_WARNING,
+                         "vGITS: ITS command error %d while handling command\n",
+                         ret);
+                dump_its_command(commands[i]);
+            }
         }
     }
 
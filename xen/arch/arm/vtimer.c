@@ -115,6 +115,7 @@ int vcpu_vtimer_init(struct vcpu *v)
     t = &v->arch.virt_timer;
     init_timer(&t->timer, virt_timer_expired, t, v->processor);
     t->ctl = 0;
+    t->armed = false;
     t->irq = d0
         ? timer_get_irq(TIMER_VIRT_PPI)
         : GUEST_TIMER_VIRT_PPI;
@@ -146,6 +147,7 @@ void virt_timer_save(struct vcpu *v)
     {
         set_timer(&v->arch.virt_timer.timer, ticks_to_ns(v->arch.virt_timer.cval +
                   v->domain->arch.virt_timer_base.offset - boot_count));
+        v->arch.virt_timer.armed = true;
     }
 }
 
@@ -153,7 +155,16 @@ void virt_timer_restore(struct vcpu *v)
 {
     ASSERT(!is_idle_vcpu(v));
 
-    stop_timer(&v->arch.virt_timer.timer);
+    /*
+     * The hardware timer takes over again, so the software one only needs
+     * stopping if virt_timer_save() armed it. Most switches happen with
+     * the guest timer disabled or masked, avoid the timer lock for those.
+     */
+    if ( v->arch.virt_timer.armed )
+    {
+        stop_timer(&v->arch.virt_timer.timer);
+        v->arch.virt_timer.armed = false;
+    }
     migrate_timer(&v->arch.virt_timer.timer, v->processor);
     migrate_timer(&v->arch.phys_timer.timer, v->processor);
 
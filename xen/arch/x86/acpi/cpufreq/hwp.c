@@ -0,0 +1,255 @@
+/*
+ *  hwp - Intel Hardware P-states (HWP) driver
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or (at
+ *  your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful, but
+ *  WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; If not, see <http://www.gnu.org/licenses/>.
+ *
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * With HWP the processor picks its operating point autonomously, within
+ * the bounds (and energy/performance preference) it is given through
+ * IA32_HWP_REQUEST. This reacts much faster than a governor sampling
+ * the load from a timer, so the governors only set the bounds here:
+ *
+ *  - performance: run at the highest level allowed by the policy,
+ *  - powersave:   run at the lowest level allowed by the policy,
+ *  - userspace:   request the given frequency as the desired level,
+ *  - ondemand:    let the hardware choose within the policy limits.
+ *
+ * Policy frequencies (in kHz, from the ACPI _PSS data uploaded by dom0)
+ * are mapped linearly onto each CPU's own HWP performance range, as
+ * cores of one package may have different highest levels.
+ */
+
+#include <xen/types.h>
+#include <xen/errno.h>
+#include <xen/init.h>
+#include <xen/cpumask.h>
+#include <xen/xmalloc.h>
+#include <asm/msr.h>
+#include <asm/processor.h>
+#include <asm/cpufeature.h>
+#include <acpi/acpi.h>
+#include <acpi/cpufreq/cpufreq.h>
+
+#define HWP_EPP_PERFORMANCE     0x00
+#define HWP_EPP_BALANCE         0x80
+#define HWP_EPP_POWERSAVE       0xff
+
+static bool __read_mostly feature_hwp_epp;
+
+struct hwp_request {
+    unsigned int min_freq;      /* kHz, bounds of the policy */
+    unsigned int max_freq;
+    unsigned int lo_freq;       /* kHz, requested range */
+    unsigned int hi_freq;
+    unsigned int desired_freq;  /* kHz, 0 for autonomous selection */
+    unsigned int epp;
+};
+
+struct hwp_drv_data {
+    struct hwp_request req;
+    int err;
+};
+
+static struct hwp_drv_data *hwp_drv_data[NR_CPUS];
+
+static uint8_t freq_to_perf(uint64_t caps, const struct hwp_request *req,
+                            unsigned int freq)
+{
+    unsigned int highest = caps & 0xff;
+    unsigned int lowest = (caps >> 24) & 0xff;
+
+    if ( freq <= req->min_freq || req->max_freq <= req->min_freq ||
+         highest <= lowest )
+        return lowest;
+    if ( freq >= req->max_freq )
+        return highest;
+
+    return lowest + (uint64_t)(freq - req->min_freq) * (highest - lowest) /
+                    (req->max_freq - req->min_freq);
+}
+
+static void hwp_write_request(void *info)
+{
+    struct hwp_drv_data *data = info;
+    const struct hwp_request *req = &data->req;
+    uint64_t val, caps;
+
+    /* HWP gets turned off again by INIT or S3, so check every time. */
+    if ( rdmsr_safe(MSR_IA32_PM_ENABLE, val) )
+        goto fail;
+    if ( !(val & MSR_IA32_PM_ENABLE_HWP_ENABLE) &&
+         wrmsr_safe(MSR_IA32_PM_ENABLE, val | MSR_IA32_PM_ENABLE_HWP_ENABLE) )
+        goto fail;
+
+    if ( rdmsr_safe(MSR_IA32_HWP_CAPABILITIES, caps) )
+        goto fail;
+
+    val = freq_to_perf(caps, req, req->lo_freq);
+    val |= (uint64_t)freq_to_perf(caps, req, req->hi_freq) << 8;
+    if ( req->desired_freq )
+        val |= (uint64_t)freq_to_perf(caps, req, req->desired_freq) << 16;
+    if ( feature_hwp_epp )
+        val |= (uint64_t)req->epp << 24;
+
+    if ( wrmsr_safe(MSR_IA32_HWP_REQUEST, val) )
+        goto fail;
+
+    return;
+
+ fail:
+    data->err = -EIO;
+}
+
+static int hwp_cpufreq_verify(struct cpufreq_policy *policy)
+{
+    cpufreq_verify_within_limits(policy, policy->cpuinfo.min_freq,
+                                 policy->cpuinfo.max_freq);
+
+    return 0;
+}
+
+static int hwp_cpufreq_target(struct cpufreq_policy *policy,
+                              unsigned int target_freq, unsigned int relation)
+{
+    struct hwp_drv_data *data = hwp_drv_data[policy->cpu];
+    struct hwp_request req = {
+        .min_freq = policy->cpuinfo.min_freq,
+        .max_freq = policy->cpuinfo.max_freq,
+        .lo_freq = policy->min,
+        .hi_freq = policy->max,
+        .epp = HWP_EPP_BALANCE,
+    };
+
+    if ( !data )
+        return -ENODEV;
+
+    if ( policy->governor == &cpufreq_gov_performance )
+    {
+        req.lo_freq = req.hi_freq;
+        req.epp = HWP_EPP_PERFORMANCE;
+    }
+    else if ( policy->governor == &cpufreq_gov_powersave )
+    {
+        req.hi_freq = req.lo_freq;
+        req.epp = HWP_EPP_POWERSAVE;
+    }
+    else if ( policy->governor == &cpufreq_gov_userspace )
+        req.desired_freq = target_freq;
+
+    /* Nothing to do, e.g. for the periodic ondemand requests. */
+    if ( !policy->resume && !memcmp(&req, &data->req, sizeof(req)) )
+        return 0;
+
+    data->req = req;
+    data->err = 0;
+    on_selected_cpus(policy->cpus, hwp_write_request, data, 1);
+    if ( data->err )
+        return data->err;
+
+    policy->resume = 0;
+    policy->cur = req.desired_freq ?: req.hi_freq;
+
+    return 0;
+}
+
+static int hwp_cpufreq_cpu_init(struct cpufreq_policy *policy)
+{
+    unsigned int cpu = policy->cpu;
+    const struct processor_performance *perf = &processor_pminfo[cpu]->perf;
+    struct hwp_drv_data *data;
+
+    if ( !perf->state_count )
+        return -ENODEV;
+
+    data = xzalloc(struct hwp_drv_data);
+    if ( !data )
+        return -ENOMEM;
+
+    policy->shared_type = perf->shared_type;
+    if ( policy->shared_type == CPUFREQ_SHARED_TYPE_ALL ||
+         policy->shared_type == CPUFREQ_SHARED_TYPE_ANY )
+        cpumask_set_cpu(cpu, policy->cpus);
+    else
+        cpumask_copy(policy->cpus, cpumask_of(cpu));
+
+    /* _PSS lists states from the fastest to the slowest. */
+    policy->cpuinfo.max_freq = perf->states[0].core_frequency * 1000;
+    policy->cpuinfo.min_freq =
+        perf->states[perf->state_count - 1].core_frequency * 1000;
+    policy->cpuinfo.transition_latency = 0;
+    policy->min = policy->cpuinfo.min_freq;
+    policy->max = policy->cpuinfo.max_freq;
+    policy->cur = policy->max;
+
+    policy->governor = cpufreq_opt_governor ? : CPUFREQ_DEFAULT_GOVERNOR;
+
+    if ( cpu_has_aperfmperf )
+    {
+        policy->aperf_mperf = 1;
+        cpufreq_driver.getavg = get_measured_perf;
+    }
+
+    hwp_drv_data[cpu] = data;
+
+    /* Make sure the first ->target() writes the request registers. */
+    policy->resume = 1;
+
+    return 0;
+}
+
+static int hwp_cpufreq_cpu_exit(struct cpufreq_policy *policy)
+{
+    xfree(hwp_drv_data[policy->cpu]);
+    hwp_drv_data[policy->cpu] = NULL;
+
+    return 0;
+}
+
+static const struct cpufreq_driver __initconstrel hwp_cpufreq_driver = {
+    .name   = "hwp-cpufreq",
+    .verify = hwp_cpufreq_verify,
+    .target = hwp_cpufreq_target,
+    .init   = hwp_cpufreq_cpu_init,
+    .exit   = hwp_cpufreq_cpu_exit,
+};
+
+bool __init hwp_available(void)
+{
+    unsigned int eax;
+
+    if ( boot_cpu_data.cpuid_level < CPUID_PM_LEAF )
+        return false;
+
+    eax = cpuid_eax(CPUID_PM_LEAF);
+    if ( !(eax & CPUID6_EAX_HWP) )
+        return false;
+
+    feature_hwp_epp = eax & CPUID6_EAX_HWP_EPP;
+
+    return true;
+}
+
+int __init hwp_register_driver(void)
+{
+    int ret = cpufreq_register_driver(&hwp_cpufreq_driver);
+
+    if ( !ret )
+        printk(XENLOG_INFO "HWP: enabled%s\n",
+               feature_hwp_epp ? ", with energy/performance preference" : "");
+
+    return ret;
+}
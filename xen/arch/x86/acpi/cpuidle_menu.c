@@ -35,6 +35,7 @@
 #define DECAY 4
 #define MAX_INTERESTING 50000
 #define LATENCY_MULTIPLIER 10
+#define INTERVALS 8
 
 /*
  * Concepts and ideas behind the menu governor
@@ -90,6 +91,17 @@
  * As an additional rule to reduce the performance impact, menu tries to
  * limit the exit latency duration to be no more than 10% of the decaying
  * measured idle time.
+ *
+ * Repeating patterns
+ * ------------------
+ * Some wakeups are not timer driven but still periodic (e.g. a guest
+ * doing I/O at a steady rate, or IPIs from a vCPU that spins on a lock
+ * held elsewhere). The next timer event says nothing about those, so
+ * menu also keeps the last INTERVALS measured idle durations. If they
+ * are tightly clustered (standard deviation small compared to the
+ * average), their average is used as a prediction when it is shorter
+ * than the corrected timer based one. Outliers on the long side are
+ * dropped one at a time before giving up on finding a pattern.
  */
 
 struct perf_factor{
@@ -109,6 +121,8 @@ struct menu_device
     unsigned int    exit_us;
     unsigned int    bucket;
     u64             correction_factor[BUCKETS];
+    unsigned int    intervals[INTERVALS];
+    unsigned int    interval_ptr;
     struct perf_factor pf;
 };
 
@@ -174,6 +188,64 @@ static inline s_time_t avg_intr_interval_us(void)
     return avg_interval;
 }
 
+/*
+ * Look for a repeating pattern in the recent idle durations. Returns the
+ * typical interval in us, or UINT_MAX if there's no usable pattern.
+ */
+static unsigned int get_typical_interval(const struct menu_device *data)
+{
+    unsigned int thresh = UINT_MAX;
+
+    for ( ; ; )
+    {
+        unsigned int i, divisor = 0, max = 0;
+        uint64_t sum = 0, avg, variance = 0;
+
+        for ( i = 0; i < INTERVALS; i++ )
+        {
+            unsigned int value = data->intervals[i];
+
+            if ( value > thresh )
+                continue;
+            sum += value;
+            divisor++;
+            if ( value > max )
+                max = value;
+        }
+
+        /* Too many outliers dropped, no pattern to be found. */
+        if ( divisor * 4 <= INTERVALS * 3 )
+            return UINT_MAX;
+
+        avg = sum / divisor;
+
+        /* Nothing recorded yet (e.g. right after enabling the device). */
+        if ( !avg )
+            return UINT_MAX;
+
+        for ( i = 0; i < INTERVALS; i++ )
+        {
+            int64_t diff = (int64_t)data->intervals[i] - avg;
+
+            if ( data->intervals[i] <= thresh )
+                variance += diff * diff;
+        }
+        variance /= divisor;
+
+        /*
+         * Accept the average if the standard deviation is at most 1/6 of
+         * it (i.e. avg^2 > 36 * variance), or is below 20us, which is too
+         * fine grained to matter for C state selection anyway.
+         */
+        if ( (variance <= ~0ULL / 36 && avg * avg > variance * 36) ||
+             variance <= 400 )
+            return avg;
+
+        /* Drop the largest value and try again. */
+        thresh = max - 1;
+    }
+}
+
 static unsigned int get_sleep_length_us(void)
 {
     s_time_t us = (this_cpu(timer_deadline) - NOW()) / 1000;
@@ -218,6 +290,9 @@ static int menu_select(struct acpi_processor_power *power)
             data->expected_us * data->correction_factor[data->bucket],
             RESOLUTION * DECAY);
 
+    data->predicted_us = min_t(u64, data->predicted_us,
+                               get_typical_interval(data));
+
     /* find the deepest idle state that satisfies our constraints */
     for ( i = CPUIDLE_DRIVER_STATE_START + 1; i < power->count; i++ )
     {
@@ -273,6 +348,11 @@ static void menu_reflect(struct acpi_processor_power *power)
         new_factor = 1;
 
     data->correction_factor[data->bucket] = new_factor;
+
+    /* update the repeating-pattern data */
+    data->intervals[data->interval_ptr++] = data->measured_us;
+    if (data->interval_ptr >= INTERVALS)
+        data->interval_ptr = 0;
 }
 
 static int menu_enable_device(struct acpi_processor_power *power)
@@ -76,6 +76,8 @@ static int __init parse_vpmu_params(const char *s)
             vpmu_features |= XENPMU_FEATURE_IPC_ONLY;
         else if ( !cmdline_strcmp(s, "arch") )
             vpmu_features |= XENPMU_FEATURE_ARCH_ONLY;
+        else if ( !cmdline_strcmp(s, "callchain") )
+            vpmu_features |= XENPMU_FEATURE_XEN_CALLCHAIN;
         else if ( (val = parse_boolean("rtm-abort", s, ss)) >= 0 )
             opt_rtm_abort = val;
         else
@@ -84,7 +86,7 @@ static int __init parse_vpmu_params(const char *s)
         s = ss + 1;
     } while ( *ss );
 
-    /* Selecting bts/ipc/arch implies vpmu=1. */
+    /* Selecting bts/ipc/arch/callchain implies vpmu=1. */
     if ( vpmu_features )
         opt_vpmu_enabled = true;
 
@@ -176,6 +178,47 @@ static inline struct vcpu *choose_hwdom_vcpu(void)
     return hardware_domain->vcpu[idx];
 }
 
+/*
+ * Record the hypervisor call chain of a sample, for dom0's profiler to
+ * attribute hypervisor time to whole code paths rather than just leaf
+ * functions.  Only frames within the interrupted stack are followed, and
+ * the walk stops at the first exception frame.
+ */
+static void vpmu_xen_callchain(struct xen_pmu_data *xenpmu_data,
+                               const struct cpu_user_regs *regs)
+{
+    struct xen_pmu_callchain *cc = (void *)xenpmu_data +
+                                   XENPMU_CALLCHAIN_OFFSET;
+    unsigned int nr = 0;
+#ifdef CONFIG_FRAME_POINTER
+    unsigned long low = regs->rsp, high = get_stack_trace_bottom(regs->rsp);
+    unsigned long next = regs->rbp;
+#endif
+
+    cc->ip[nr++] = regs->rip;
+
+#ifdef CONFIG_FRAME_POINTER
+    while ( nr < XENPMU_CALLCHAIN_MAX &&
+            next >= low && next < high - sizeof(unsigned long) &&
+            IS_ALIGNED(next, sizeof(unsigned long)) )
+    {
+        const unsigned long *frame = (const unsigned long *)next;
+
+        if ( !is_active_kernel_text(frame[1]) )
+            break;
+
+        cc->ip[nr++] = frame[1];
+
+        /* Frames must move towards the bottom of the stack. */
+        if ( frame[0] <= next )
+            break;
+        next = frame[0];
+    }
+#endif
+
+    cc->nr = nr;
+}
+
 void vpmu_do_interrupt(struct cpu_user_regs *regs)
 {
     struct vcpu *sampled = current, *sampling;
@@ -264,6 +307,12 @@ void vpmu_do_interrupt(struct cpu_user_regs *regs)
             {
                 cur_regs = regs;
                 domid = DOMID_XEN;
+
+                if ( vpmu_features & XENPMU_FEATURE_XEN_CALLCHAIN )
+                {
+                    vpmu_xen_callchain(vpmu->xenpmu_data, regs);
+                    *flags |= PMU_SAMPLE_CALLCHAIN;
+                }
             }
             else
                 cur_regs = guest_cpu_user_regs();
@@ -769,7 +818,8 @@ long do_xenpmu_op(unsigned int op, XEN_GUEST_HANDLE_PARAM(xen_pmu_params_t) arg)
     case XENPMU_feature_set:
         if ( pmu_params.val & ~(XENPMU_FEATURE_INTEL_BTS |
                                 XENPMU_FEATURE_IPC_ONLY |
-                                XENPMU_FEATURE_ARCH_ONLY))
+                                XENPMU_FEATURE_ARCH_ONLY |
+                                XENPMU_FEATURE_XEN_CALLCHAIN))
             return -EINVAL;
 
         spin_lock(&vpmu_lock);
@@ -547,7 +547,7 @@ static int __init common_init(void)
     }
 
     if ( sizeof(struct xen_pmu_data) +
-         2 * sizeof(uint64_t) * num_counters > PAGE_SIZE )
+         2 * sizeof(uint64_t) * num_counters > XENPMU_CALLCHAIN_OFFSET )
     {
         printk(XENLOG_WARNING
                "VPMU: Register bank does not fit into VPMU shared page\n");
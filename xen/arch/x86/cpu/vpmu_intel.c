@@ -86,6 +86,36 @@ static unsigned int __read_mostly arch_pmc_cnt, fixed_pmc_cnt;
 static uint64_t __read_mostly fixed_ctrl_mask, fixed_counters_mask;
 static uint64_t __read_mostly global_ovf_ctrl_mask, global_ctrl_mask;
 
+/*
+ * Private per-vCPU state, pointed to by vpmu->priv_context.
+ *
+ * Counters are identified by bit i for general purpose counter i, and bit
+ * 32 + i for fixed counter i.  Only the counters in used_cntrs are saved and
+ * restored on context switch, and only those can be accessed directly by
+ * HVM guests: accesses to other counters are intercepted, and mark them as
+ * used.  Unused counters hence are always 0 from the guest's point of view.
+ */
+struct core2_vpmu_priv {
+    uint64_t enabled_cntrs; /* Counters currently enabled by the guest */
+    uint64_t used_cntrs;    /* Counters ever accessed by the guest */
+};
+
+/*
+ * Counters known to be clear (both value and, for general purpose counters,
+ * control) on a pCPU.  Only valid while the pCPU's generation matches
+ * core2_hw_gen, which changes whenever a vCPU allocates its vPMU context, as
+ * other PMU users (e.g. xenoprof) may have used the counters before that.
+ */
+static DEFINE_PER_CPU(uint64_t, core2_hw_clean);
+static DEFINE_PER_CPU(int, core2_hw_clean_gen);
+static atomic_t core2_hw_gen;
+
+static inline uint64_t core2_all_cntrs(void)
+{
+    return ((1ULL << arch_pmc_cnt) - 1) |
+           (((1ULL << fixed_pmc_cnt) - 1) << 32);
+}
+
 /* Total size of PMU registers block (copied to/from PV(H) guest) */
 static unsigned int __read_mostly regs_sz;
 /* Offset into context of the beginning of PMU register block */
@@ -225,21 +255,34 @@ static int is_core2_vpmu_msr(u32 msr_index, int *type, int *index)
     }
 }
 
-static void core2_vpmu_set_msr_bitmap(struct vcpu *v)
+/* Allow Read/Write of (used) PMU Counters MSR Directly. */
+static void core2_vpmu_clear_cntr_intercepts(struct vcpu *v, uint64_t cntrs)
 {
     unsigned int i;
 
-    /* Allow Read/Write PMU Counters MSR Directly. */
     for ( i = 0; i < fixed_pmc_cnt; i++ )
-        vmx_clear_msr_intercept(v, MSR_CORE_PERF_FIXED_CTR0 + i, VMX_MSR_RW);
+        if ( cntrs & ((1ULL << 32) << i) )
+            vmx_clear_msr_intercept(v, MSR_CORE_PERF_FIXED_CTR0 + i,
+                                    VMX_MSR_RW);
 
     for ( i = 0; i < arch_pmc_cnt; i++ )
     {
+        if ( !(cntrs & (1ULL << i)) )
+            continue;
+
         vmx_clear_msr_intercept(v, MSR_IA32_PERFCTR0 + i, VMX_MSR_RW);
 
         if ( full_width_write )
             vmx_clear_msr_intercept(v, MSR_IA32_A_PERFCTR0 + i, VMX_MSR_RW);
     }
+}
+
+static void core2_vpmu_set_msr_bitmap(struct vcpu *v)
+{
+    const struct core2_vpmu_priv *priv = vcpu_vpmu(v)->priv_context;
+    unsigned int i;
+
+    core2_vpmu_clear_cntr_intercepts(v, priv->used_cntrs);
 
     /* Allow Read PMU Non-global Controls Directly. */
     for ( i = 0; i < arch_pmc_cnt; i++ )
@@ -271,18 +314,44 @@ static void core2_vpmu_unset_msr_bitmap(struct vcpu *v)
     vmx_set_msr_intercept(v, MSR_IA32_DS_AREA, VMX_MSR_R);
 }
 
+/*
+ * Mark counters as used by the guest, allowing direct access to them if the
+ * context is loaded.
+ */
+static void core2_vpmu_mark_used(struct vcpu *v, uint64_t cntrs)
+{
+    struct vpmu_struct *vpmu = vcpu_vpmu(v);
+    struct core2_vpmu_priv *priv = vpmu->priv_context;
+
+    cntrs &= ~priv->used_cntrs;
+    if ( !cntrs )
+        return;
+
+    priv->used_cntrs |= cntrs;
+    this_cpu(core2_hw_clean) &= ~cntrs;
+
+    if ( is_hvm_vcpu(v) && cpu_has_vmx_msr_bitmap &&
+         vpmu_is_set(vpmu, VPMU_CONTEXT_LOADED) )
+        core2_vpmu_clear_cntr_intercepts(v, cntrs);
+}
+
 static inline void __core2_vpmu_save(struct vcpu *v)
 {
     int i;
-    struct xen_pmu_intel_ctxt *core2_vpmu_cxt = vcpu_vpmu(v)->context;
+    struct vpmu_struct *vpmu = vcpu_vpmu(v);
+    struct xen_pmu_intel_ctxt *core2_vpmu_cxt = vpmu->context;
     uint64_t *fixed_counters = vpmu_reg_pointer(core2_vpmu_cxt, fixed_counters);
     struct xen_pmu_cntr_pair *xen_pmu_cntr_pair =
         vpmu_reg_pointer(core2_vpmu_cxt, arch_counters);
+    uint64_t used = ((struct core2_vpmu_priv *)vpmu->priv_context)->used_cntrs;
 
+    /* Unused counters are 0, and can't have been changed by the guest. */
     for ( i = 0; i < fixed_pmc_cnt; i++ )
-        rdmsrl(MSR_CORE_PERF_FIXED_CTR0 + i, fixed_counters[i]);
+        if ( used & ((1ULL << 32) << i) )
+            rdmsrl(MSR_CORE_PERF_FIXED_CTR0 + i, fixed_counters[i]);
     for ( i = 0; i < arch_pmc_cnt; i++ )
-        rdmsrl(MSR_IA32_PERFCTR0 + i, xen_pmu_cntr_pair[i].counter);
+        if ( used & (1ULL << i) )
+            rdmsrl(MSR_IA32_PERFCTR0 + i, xen_pmu_cntr_pair[i].counter);
 
     if ( !is_hvm_vcpu(v) )
         rdmsrl(MSR_CORE_PERF_GLOBAL_STATUS, core2_vpmu_cxt->global_status);
@@ -318,13 +387,30 @@ static int core2_vpmu_save(struct vcpu *v, bool_t to_guest)
 static inline void __core2_vpmu_load(struct vcpu *v)
 {
     unsigned int i, pmc_start;
-    struct xen_pmu_intel_ctxt *core2_vpmu_cxt = vcpu_vpmu(v)->context;
+    struct vpmu_struct *vpmu = vcpu_vpmu(v);
+    struct xen_pmu_intel_ctxt *core2_vpmu_cxt = vpmu->context;
     uint64_t *fixed_counters = vpmu_reg_pointer(core2_vpmu_cxt, fixed_counters);
     struct xen_pmu_cntr_pair *xen_pmu_cntr_pair =
         vpmu_reg_pointer(core2_vpmu_cxt, arch_counters);
+    uint64_t used = ((struct core2_vpmu_priv *)vpmu->priv_context)->used_cntrs;
+    uint64_t clean, load;
+
+    if ( this_cpu(core2_hw_clean_gen) != atomic_read(&core2_hw_gen) )
+    {
+        this_cpu(core2_hw_clean_gen) = atomic_read(&core2_hw_gen);
+        this_cpu(core2_hw_clean) = 0;
+    }
+    clean = this_cpu(core2_hw_clean);
+
+    /*
+     * Load the counters used by the guest, and clear the ones which aren't
+     * but may have been left dirty by someone else.
+     */
+    load = (used | ~clean) & core2_all_cntrs();
 
     for ( i = 0; i < fixed_pmc_cnt; i++ )
-        wrmsrl(MSR_CORE_PERF_FIXED_CTR0 + i, fixed_counters[i]);
+        if ( load & ((1ULL << 32) << i) )
+            wrmsrl(MSR_CORE_PERF_FIXED_CTR0 + i, fixed_counters[i]);
 
     if ( full_width_write )
         pmc_start = MSR_IA32_A_PERFCTR0;
@@ -332,10 +418,15 @@ static inline void __core2_vpmu_load(struct vcpu *v)
         pmc_start = MSR_IA32_PERFCTR0;
     for ( i = 0; i < arch_pmc_cnt; i++ )
     {
+        if ( !(load & (1ULL << i)) )
+            continue;
+
         wrmsrl(pmc_start + i, xen_pmu_cntr_pair[i].counter);
         wrmsrl(MSR_P6_EVNTSEL(i), xen_pmu_cntr_pair[i].control);
     }
 
+    this_cpu(core2_hw_clean) = core2_all_cntrs() & ~used;
+
     wrmsrl(MSR_CORE_PERF_FIXED_CTR_CTRL, core2_vpmu_cxt->fixed_ctrl);
     if ( vpmu_is_set(vcpu_vpmu(v), VPMU_CPU_HAS_DS) )
         wrmsrl(MSR_IA32_DS_AREA, core2_vpmu_cxt->ds_area);
@@ -357,7 +448,7 @@ static int core2_vpmu_verify(struct vcpu *v)
     struct xen_pmu_cntr_pair *xen_pmu_cntr_pair =
         vpmu_reg_pointer(core2_vpmu_cxt, arch_counters);
     uint64_t fixed_ctrl;
-    uint64_t *priv_context = vpmu->priv_context;
+    struct core2_vpmu_priv *priv = vpmu->priv_context;
     uint64_t enabled_cntrs = 0;
 
     if ( core2_vpmu_cxt->global_ovf_ctrl & global_ovf_ctrl_mask )
@@ -402,7 +493,7 @@ static int core2_vpmu_verify(struct vcpu *v)
     else
         vpmu_reset(vpmu, VPMU_RUNNING);
 
-    *priv_context = enabled_cntrs;
+    priv->enabled_cntrs = enabled_cntrs;
 
     return 0;
 }
@@ -447,7 +538,7 @@ static int core2_vpmu_alloc_resource(struct vcpu *v)
 {
     struct vpmu_struct *vpmu = vcpu_vpmu(v);
     struct xen_pmu_intel_ctxt *core2_vpmu_cxt = NULL;
-    uint64_t *p = NULL;
+    struct core2_vpmu_priv *p = NULL;
 
     if ( !acquire_pmu_ownership(PMU_OWNER_HVM) )
         return 0;
@@ -465,10 +556,20 @@ static int core2_vpmu_alloc_resource(struct vcpu *v)
                                    sizeof(uint64_t) * fixed_pmc_cnt +
                                    sizeof(struct xen_pmu_cntr_pair) *
                                    arch_pmc_cnt);
-    p = xzalloc(uint64_t);
+    p = xzalloc(struct core2_vpmu_priv);
     if ( !core2_vpmu_cxt || !p )
         goto out_err;
 
+    /*
+     * PV guests provide the full context from the shared page, and there
+     * are no MSR intercepts to track their use of the counters.
+     */
+    if ( !is_hvm_vcpu(v) )
+        p->used_cntrs = core2_all_cntrs();
+
+    /* Hardware counters may have been used by another PMU owner. */
+    atomic_inc(&core2_hw_gen);
+
     core2_vpmu_cxt->fixed_counters = sizeof(*core2_vpmu_cxt);
     core2_vpmu_cxt->arch_counters = core2_vpmu_cxt->fixed_counters +
                                     sizeof(uint64_t) * fixed_pmc_cnt;
@@ -535,6 +636,11 @@ static int core2_vpmu_do_wrmsr(unsigned int msr, uint64_t msr_content,
     if ( !core2_vpmu_msr_common_check(msr, &type, &index) )
         return -EINVAL;
 
+    if ( type == MSR_TYPE_COUNTER )
+        core2_vpmu_mark_used(v, (1ULL << 32) << index);
+    else if ( type == MSR_TYPE_ARCH_COUNTER )
+        core2_vpmu_mark_used(v, 1ULL << index);
+
     ASSERT(!supported);
 
     if ( (type == MSR_TYPE_COUNTER) && (msr_content & fixed_counters_mask) )
@@ -542,7 +648,7 @@ static int core2_vpmu_do_wrmsr(unsigned int msr, uint64_t msr_content,
         return -EINVAL;
 
     core2_vpmu_cxt = vpmu->context;
-    enabled_cntrs = vpmu->priv_context;
+    enabled_cntrs = &((struct core2_vpmu_priv *)vpmu->priv_context)->enabled_cntrs;
     switch ( msr )
     {
     case MSR_CORE_PERF_GLOBAL_OVF_CTRL:
@@ -607,6 +713,8 @@ static int core2_vpmu_do_wrmsr(unsigned int msr, uint64_t msr_content,
             }
         }
 
+        core2_vpmu_mark_used(v, *enabled_cntrs &
+                                (((1ULL << fixed_pmc_cnt) - 1) << 32));
         core2_vpmu_cxt->fixed_ctrl = msr_content;
         break;
     default:
@@ -670,6 +778,9 @@ static int core2_vpmu_do_wrmsr(unsigned int msr, uint64_t msr_content,
             else
                 *enabled_cntrs &= ~(1ULL << tmp);
 
+            if ( msr_content )
+                core2_vpmu_mark_used(v, 1ULL << tmp);
+
             xen_pmu_cntr_pair[tmp].control = msr_content;
         }
     }
@@ -966,7 +1077,8 @@ int __init core2_vpmu_init(void)
     check_pmc_quirk();
 
     if ( sizeof(struct xen_pmu_data) + sizeof(uint64_t) * fixed_pmc_cnt +
-         sizeof(struct xen_pmu_cntr_pair) * arch_pmc_cnt > PAGE_SIZE )
+         sizeof(struct xen_pmu_cntr_pair) * arch_pmc_cnt >
+         XENPMU_CALLCHAIN_OFFSET )
     {
         printk(XENLOG_WARNING
                "VPMU: Register bank does not fit into VPMU share page\n");
@@ -117,7 +117,7 @@ static void noreturn do_nmi_crash(const struct cpu_user_regs *regs)
 
 static void nmi_shootdown_cpus(void)
 {
-    unsigned long msecs;
+    unsigned long usecs;
     unsigned int cpu = smp_processor_id();
 
     disable_lapic_nmi_watchdog();
@@ -148,11 +148,15 @@ static void nmi_shootdown_cpus(void)
 
     smp_send_nmi_allbutself();
 
-    msecs = 1000; /* Wait at most a second for the other cpus to stop */
-    while ( !cpumask_empty(&waiting_to_crash) && msecs )
+    /*
+     * Wait at most a second for the other cpus to stop.  They normally take
+     * a few microseconds, so poll often to get to the crash kernel quickly.
+     */
+    usecs = 1000000;
+    while ( !cpumask_empty(&waiting_to_crash) && usecs )
     {
-        mdelay(1);
-        msecs--;
+        udelay(10);
+        usecs -= 10;
     }
 
     /*
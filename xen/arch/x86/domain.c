@@ -659,6 +659,13 @@ int arch_sanitise_domain_config(struct xen_domctl_createdomain *config)
         return -EINVAL;
     }
 
+    if ( config->arch.misc_flags & ~XEN_X86_MISC_FLAGS_ALL )
+    {
+        dprintk(XENLOG_INFO, "Invalid arch misc flags %#x\n",
+                config->arch.misc_flags);
+        return -EINVAL;
+    }
+
     return 0;
 }
 
@@ -757,6 +764,9 @@ int arch_domain_create(struct domain *d,
     }
     d->arch.emulation_flags = emflags;
 
+    d->arch.spec_trusted = config->arch.misc_flags & XEN_X86_SPEC_TRUSTED;
+    spec_ctrl_init_domain(d);
+
 #ifdef CONFIG_PV32
     HYPERVISOR_COMPAT_VIRT_START(d) =
         is_pv_domain(d) ? __HYPERVISOR_COMPAT_VIRT_START : ~0u;
@@ -1953,6 +1963,11 @@ static void __context_switch(void)
         cpumask_clear_cpu(cpu, pd->dirty_cpumask);
     write_atomic(&p->dirty_cpu, VCPU_CPU_CLEAN);
 
+    /* Pick up the per-domain speculative settings for the exit paths. */
+    get_cpu_info()->spec_ctrl_flags =
+        (get_cpu_info()->spec_ctrl_flags & ~SCF_DOM_MASK) |
+        nd->arch.spec_ctrl_flags;
+
     per_cpu(curr_vcpu, cpu) = n;
 }
 
@@ -2006,6 +2021,7 @@ void context_switch(struct vcpu *prev, struct vcpu *next)
         if ( opt_ibpb && !is_idle_domain(nextd) )
         {
             static DEFINE_PER_CPU(unsigned int, last);
+            static DEFINE_PER_CPU(bool, last_trusted);
             unsigned int *last_id = &this_cpu(last);
 
             /*
@@ -2026,8 +2042,15 @@ void context_switch(struct vcpu *prev, struct vcpu *next)
              */
             if ( *last_id != next_id )
             {
-                wrmsrl(MSR_PRED_CMD, PRED_CMD_IBPB);
+                /*
+                 * A domain trusted not to mount speculative attacks can't
+                 * have left hostile state in the predictors, so there is
+                 * nothing to flush when switching away from one.
+                 */
+                if ( !this_cpu(last_trusted) )
+                    wrmsrl(MSR_PRED_CMD, PRED_CMD_IBPB);
                 *last_id = next_id;
+                this_cpu(last_trusted) = nextd->arch.spec_trusted;
             }
         }
     }
@@ -2453,7 +2476,18 @@ void vcpu_kick(struct vcpu *v)
 
 void vcpu_mark_events_pending(struct vcpu *v)
 {
-    int already_pending = test_and_set_bit(
+    int already_pending;
+
+    /*
+     * Callers have just set a selector bit with a locked operation, which
+     * orders this read.  If the guest hasn't consumed the previous upcall
+     * yet, it will observe the new selector bit when it does, so coalesce
+     * without a further locked access to the shared vcpu_info line.
+     */
+    if ( vcpu_info(v, evtchn_upcall_pending) )
+        return;
+
+    already_pending = test_and_set_bit(
         0, (unsigned long *)&vcpu_info(v, evtchn_upcall_pending));
 
     if ( already_pending )
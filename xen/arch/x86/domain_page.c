@@ -118,7 +118,17 @@ void *map_domain_page(mfn_t mfn)
         }
     }
 
-    idx = find_next_zero_bit(dcache->inuse, dcache->entries, dcache->cursor);
+    idx = find_next_zero_bit(dcache->inuse, dcache->entries, vcache->cursor);
+    if ( idx >= dcache->entries && vcache->cursor )
+    {
+        /*
+         * Entries below the cursor which aren't in use are as good, and,
+         * unlike reaping the garbage, don't need a TLB flush.
+         */
+        idx = find_first_zero_bit(dcache->inuse, vcache->cursor);
+        if ( idx >= vcache->cursor )
+            idx = dcache->entries;
+    }
     if ( unlikely(idx >= dcache->entries) )
     {
         unsigned long accum = 0, prev = 0;
@@ -162,7 +172,7 @@ void *map_domain_page(mfn_t mfn)
     }
 
     set_bit(idx, dcache->inuse);
-    dcache->cursor = idx + 1;
+    vcache->cursor = idx + 1;
 
     spin_unlock(&dcache->lock);
 
@@ -289,6 +299,8 @@ int mapcache_vcpu_init(struct vcpu *v)
         dcache->entries = ents;
     }
 
+    v->arch.pv.mapcache.cursor = v->vcpu_id * MAPCACHE_VCPU_ENTRIES;
+
     /* Mark all maphash entries as not in use. */
     BUILD_BUG_ON(MAPHASHENT_NOTINUSE < MAPCACHE_ENTRIES);
     for ( i = 0; i < MAPHASH_ENTRIES; i++ )
@@ -36,6 +36,8 @@
 #include <asm/debugger.h>
 #include <asm/psr.h>
 #include <asm/cpuid.h>
+#include <asm/altp2m.h>
+#include <asm/hvm/nestedhvm.h>
 
 #ifdef CONFIG_GDBSX
 static int gdbsx_guest_mem_io(domid_t domid, struct xen_domctl_gdbsx_memio *iop)
@@ -1320,6 +1322,138 @@ long arch_do_domctl(
         domain_unpause(d);
         break;
 
+    case XEN_DOMCTL_numa_migrate:
+    {
+        struct xen_domctl_numa_migrate *nm = &domctl->u.numa_migrate;
+        const unsigned long max_gfn = domain_get_maximum_gpfn(d);
+
+        ret = -EOPNOTSUPP;
+        if ( !is_hvm_domain(d) || is_iommu_enabled(d) || altp2m_active(d) ||
+             nestedhvm_enabled(d) )
+            break;
+
+        ret = -EINVAL;
+        if ( d == currd || /* no domain_pause() */
+             nm->node >= MAX_NUMNODES || !node_online(nm->node) || nm->pad ||
+             nm->first_gfn + nm->nr_gfns < nm->first_gfn )
+            break;
+
+        ret = 0;
+        domain_pause(d);
+
+        while ( nm->nr_gfns )
+        {
+            if ( nm->first_gfn > max_gfn )
+            {
+                nm->first_gfn += nm->nr_gfns;
+                nm->nr_gfns = 0;
+                break;
+            }
+
+            ret = p2m_migrate_gfn(d, _gfn(nm->first_gfn), nm->node);
+            if ( ret < 0 )
+                break;
+
+            nm->nr_migrated += ret;
+            nm->first_gfn++;
+            ret = 0;
+
+            if ( --nm->nr_gfns && !(nm->first_gfn & 0xff) &&
+                 hypercall_preempt_check() )
+            {
+                ret = -ERESTART;
+                break;
+            }
+        }
+
+        domain_unpause(d);
+
+        if ( ret == -ERESTART )
+        {
+            if ( __copy_to_guest(u_domctl, domctl, 1) )
+                return -EFAULT;
+            return hypercall_create_continuation(__HYPERVISOR_domctl,
+                                                 "h", u_domctl);
+        }
+        copyback = true;
+        break;
+    }
+
+    case XEN_DOMCTL_accessed_op:
+    {
+        struct xen_domctl_accessed_op *ao = &domctl->u.accessed_op;
+        unsigned long bits[BITS_TO_LONGS(512)];
+        unsigned int nr, nr_accessed;
+
+        /* Sampling access patterns is akin to peeking at the dirty log. */
+        ret = xsm_shadow_control(XSM_HOOK, d, XEN_DOMCTL_SHADOW_OP_PEEK);
+        if ( ret )
+            break;
+
+        ret = -EOPNOTSUPP;
+        if ( !is_hvm_domain(d) || !hap_enabled(d) || altp2m_active(d) ||
+             iommu_use_hap_pt(d) )
+            break;
+
+        ret = -EINVAL;
+        if ( d == currd || /* no domain_pause() */
+             (ao->flags & ~XEN_DOMCTL_ACCESSED_CLEAR) )
+            break;
+
+        if ( ao->op == XEN_DOMCTL_ACCESSED_OP_ENABLE ||
+             ao->op == XEN_DOMCTL_ACCESSED_OP_DISABLE )
+        {
+            domain_pause(d);
+            ret = p2m_track_accessed(d, ao->op == XEN_DOMCTL_ACCESSED_OP_ENABLE);
+            domain_unpause(d);
+            break;
+        }
+
+        if ( ao->op != XEN_DOMCTL_ACCESSED_OP_SCAN ||
+             ao->first_gfn + ao->nr_gfns < ao->first_gfn ||
+             ao->done > ao->nr_gfns || (ao->done & 7) )
+            break;
+
+        ret = 0;
+        while ( ao->done < ao->nr_gfns )
+        {
+            nr = min_t(uint64_t, ao->nr_gfns - ao->done, 512);
+
+            ret = p2m_get_accessed(d, ao->first_gfn + ao->done, nr,
+                                   ao->flags & XEN_DOMCTL_ACCESSED_CLEAR,
+                                   bits, &nr_accessed);
+            if ( ret )
+                break;
+
+            if ( !guest_handle_is_null(ao->bitmap) &&
+                 copy_to_guest_offset(ao->bitmap, ao->done / 8,
+                                      (uint8_t *)bits, DIV_ROUND_UP(nr, 8)) )
+            {
+                ret = -EFAULT;
+                break;
+            }
+
+            ao->nr_accessed += nr_accessed;
+            ao->done += nr;
+
+            if ( ao->done < ao->nr_gfns && hypercall_preempt_check() )
+            {
+                ret = -ERESTART;
+                break;
+            }
+        }
+
+        if ( ret == -ERESTART )
+        {
+            if ( __copy_to_guest(u_domctl, domctl, 1) )
+                return -EFAULT;
+            return hypercall_create_continuation(__HYPERVISOR_domctl,
+                                                 "h", u_domctl);
+        }
+        copyback = true;
+        break;
+    }
+
     default:
         ret = iommu_do_domctl(domctl, d, u_domctl);
         break;
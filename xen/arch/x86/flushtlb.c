@@ -32,6 +32,7 @@
 
 u32 tlbflush_clock = 1U;
 DEFINE_PER_CPU(u32, tlbflush_time);
+DEFINE_PER_CPU(unsigned int, tlb_live_pcids);
 
 /* Signals whether the TLB flush clock is in use. */
 bool __read_mostly tlb_clk_enabled = true;
@@ -204,21 +205,25 @@ unsigned int flush_area_local(const void *va, unsigned int flags)
             {
                 unsigned long addr = (unsigned long)va;
 
+                unsigned int live = this_cpu(tlb_live_pcids);
+
                 /*
-                 * Flush the addresses for all potential address spaces.
-                 * We can't check the current domain for being subject to
-                 * XPTI as current might be the idle vcpu while we still have
-                 * some XPTI domain TLB entries.
+                 * Flush the addresses for all address spaces which may have
+                 * entries in the TLB.  We can't check the current domain for
+                 * being subject to XPTI as current might be the idle vcpu
+                 * while we still have some XPTI domain TLB entries, but
+                 * write_ptbase() tracks which PCIDs have been in use since
+                 * the last full flush.
                  * Using invpcid is okay here, as with PCID enabled we always
                  * have global pages disabled.
                  */
                 invpcid_flush_one(PCID_PV_PRIV, addr);
-                invpcid_flush_one(PCID_PV_USER, addr);
-                if ( opt_xpti_hwdom || opt_xpti_domu )
-                {
+                if ( live & (1U << PCID_PV_USER) )
+                    invpcid_flush_one(PCID_PV_USER, addr);
+                if ( live & (1U << (PCID_PV_PRIV | PCID_PV_XPTI)) )
                     invpcid_flush_one(PCID_PV_PRIV | PCID_PV_XPTI, addr);
+                if ( live & (1U << (PCID_PV_USER | PCID_PV_XPTI)) )
                     invpcid_flush_one(PCID_PV_USER | PCID_PV_XPTI, addr);
-                }
             }
             else
                 asm volatile ( "invlpg %0"
@@ -365,6 +365,7 @@ static int dm_op(const struct dmop_args *op_args)
         [XEN_DMOP_remote_shutdown]                  = sizeof(struct xen_dm_op_remote_shutdown),
         [XEN_DMOP_relocate_memory]                  = sizeof(struct xen_dm_op_relocate_memory),
         [XEN_DMOP_pin_memory_cacheattr]             = sizeof(struct xen_dm_op_pin_memory_cacheattr),
+        [XEN_DMOP_set_ioreq_server_polling]         = sizeof(struct xen_dm_op_set_ioreq_server_polling),
     };
 
     rc = rcu_lock_remote_domain_by_id(op_args->domid, &d);
@@ -536,6 +537,21 @@ static int dm_op(const struct dmop_args *op_args)
         break;
     }
 
+    case XEN_DMOP_set_ioreq_server_polling:
+    {
+        const struct xen_dm_op_set_ioreq_server_polling *data =
+            &op.u.set_ioreq_server_polling;
+
+        rc = -EINVAL;
+        if ( data->pad || data->pad2 ||
+             (data->flags & ~XEN_DMOP_IOREQ_POLL_REQUESTS) )
+            break;
+
+        rc = hvm_set_ioreq_server_polling(d, data->id, data->flags,
+                                          data->spin_ns);
+        break;
+    }
+
     case XEN_DMOP_destroy_ioreq_server:
     {
         const struct xen_dm_op_destroy_ioreq_server *data =
@@ -737,6 +753,7 @@ CHECK_dm_op_map_mem_type_to_ioreq_server;
 CHECK_dm_op_remote_shutdown;
 CHECK_dm_op_relocate_memory;
 CHECK_dm_op_pin_memory_cacheattr;
+CHECK_dm_op_set_ioreq_server_polling;
 
 int compat_dm_op(domid_t domid,
                  unsigned int nr_bufs,
@@ -28,11 +28,30 @@
 #include <asm/iocap.h>
 #include <asm/vm_event.h>
 
+#define HVMEMUL_NR_WALKS 8
+
 struct hvmemul_cache
 {
     /* The cache is disabled as long as num_ents > max_ents. */
     unsigned int num_ents;
     unsigned int max_ents;
+    /*
+     * Complete linear -> guest frame translations done while emulating the
+     * current insn.  They're valid only for the control register state they
+     * were obtained with; any change to it discards all of them.
+     */
+    unsigned int num_walks;
+    unsigned int next_walk;
+    struct {
+        unsigned long cr0, cr3, cr4;
+        unsigned long efer;
+        bool ac;
+    } walk_ctx;
+    struct {
+        unsigned long vfn;
+        unsigned long gfn;
+        uint32_t pfec;
+    } walks[HVMEMUL_NR_WALKS];
     struct {
         paddr_t gpa:PADDR_BITS;
         unsigned int :BITS_PER_LONG - PADDR_BITS - 8;
@@ -607,6 +626,10 @@ static void *hvmemul_map_linear_addr(
         pagefault_info_t pfinfo;
         p2m_type_t p2mt;
         unsigned long addr = i ? (linear + (i << PAGE_SHIFT)) & PAGE_MASK : linear;
+        /* Bytes of the access falling into this frame. */
+        unsigned int offs = i ? (i << PAGE_SHIFT) - (linear & ~PAGE_MASK) : 0;
+        unsigned int frame_bytes = min_t(unsigned int, bytes - offs,
+                                         PAGE_SIZE - (addr & ~PAGE_MASK)) ?: 1;
 
         if ( hvmemul_ctxt->ctxt.addr_size < 64 )
             addr = (uint32_t)addr;
@@ -669,7 +692,8 @@ static void *hvmemul_map_linear_addr(
 
         if ( unlikely(curr->arch.vm_event) &&
              curr->arch.vm_event->send_event &&
-             hvm_monitor_check_p2m(addr, gfn, pfec, npfec_kind_with_gla) )
+             hvm_monitor_check_p2m(addr, gfn, pfec, npfec_kind_with_gla,
+                                   frame_bytes) )
         {
             err = ERR_PTR(~X86EMUL_RETRY);
             goto out;
@@ -1687,6 +1711,7 @@ static int hvmemul_validate(
         container_of(ctxt, struct hvm_emulate_ctxt, ctxt);
 
     hvmemul_ctxt->is_mem_access = x86_insn_is_mem_access(state, ctxt);
+    hvmemul_ctxt->is_mem_write = x86_insn_is_mem_write(state, ctxt);
 
     return !hvmemul_ctxt->validate || hvmemul_ctxt->validate(state, ctxt)
            ? X86EMUL_OKAY : X86EMUL_UNHANDLEABLE;
@@ -1811,6 +1836,79 @@ static int hvmemul_rep_outs(
                                !!(ctxt->regs->eflags & X86_EFLAGS_DF), gpa);
 }
 
+/*
+ * Copy *@reps elements of @bytes_per_rep bytes each into the guest physical
+ * range starting at @dgpa, either from the (non-overlapping) one starting at
+ * @sgpa or, if @pattern is non-NULL, by replicating the element it points
+ * to.  Both ranges are specified by their lowest address.
+ *
+ * Rather than staging the entire range, go through a bounce buffer of at most
+ * a page, processing the chunks in the order the insn would (as per @df).
+ * If a failure occurs after some progress was made, *@reps gets updated to
+ * the number of elements fully copied and success is reported, for the insn
+ * to be re-executed for the remainder.
+ */
+static int hvmemul_phys_rep_copy(paddr_t dgpa, paddr_t sgpa,
+                                 const void *pattern,
+                                 unsigned int bytes_per_rep,
+                                 unsigned long *reps, bool df)
+{
+    struct vcpu *curr = current;
+    unsigned long bytes = *reps * bytes_per_rep, done = 0;
+    unsigned int chunk = min_t(unsigned long, bytes, PAGE_SIZE);
+    char *buf = xmalloc_bytes(chunk);
+    int rc = HVMTRANS_okay;
+
+    if ( !buf )
+    {
+        if ( !pattern )
+            return HVMTRANS_unhandleable;
+        /* Fall back to storing one element at a time. */
+        buf = (void *)pattern;
+        chunk = bytes_per_rep;
+    }
+    else if ( pattern )
+    {
+        unsigned int i;
+
+        for ( i = 0; i < chunk; i += bytes_per_rep )
+            memcpy(buf + i, pattern, bytes_per_rep);
+    }
+
+    while ( done < bytes )
+    {
+        unsigned int n = min_t(unsigned long, bytes - done, chunk);
+        unsigned long off = df ? bytes - done - n : done;
+
+        if ( !pattern )
+        {
+            unsigned int token = hvmemul_cache_disable(curr);
+
+            rc = hvm_copy_from_guest_phys(buf, sgpa + off, n);
+            hvmemul_cache_restore(curr, token);
+        }
+
+        if ( rc == HVMTRANS_okay )
+            rc = hvm_copy_to_guest_phys(dgpa + off, buf, n, curr);
+
+        if ( rc != HVMTRANS_okay )
+            break;
+
+        done += n;
+    }
+
+    if ( buf != pattern )
+        xfree(buf);
+
+    if ( rc != HVMTRANS_okay && done )
+    {
+        *reps = done / bytes_per_rep;
+        rc = HVMTRANS_okay;
+    }
+
+    return rc;
+}
+
 static int hvmemul_rep_movs(
    enum x86_segment src_seg,
    unsigned long src_offset,
@@ -1923,13 +2021,16 @@ static int hvmemul_rep_movs(
     if ( df )
         dgpa -= bytes - bytes_per_rep;
 
-    /* Allocate temporary buffer. Fall back to slow emulation if this fails. */
-    buf = xmalloc_bytes(bytes);
-    if ( buf == NULL )
-        return X86EMUL_UNHANDLEABLE;
-
     if ( unlikely(hvmemul_ctxt->set_context) )
     {
+        /*
+         * The data to be written was supplied as a whole, so stage it in its
+         * entirety.  Fall back to slow emulation if allocation fails.
+         */
+        buf = xmalloc_bytes(bytes);
+        if ( buf == NULL )
+            return X86EMUL_UNHANDLEABLE;
+
         rc = set_context_data(buf, bytes);
 
         if ( rc != X86EMUL_OKAY)
@@ -1938,25 +2039,12 @@ static int hvmemul_rep_movs(
             return rc;
         }
 
-        rc = HVMTRANS_okay;
-    }
-    else
-    {
-        unsigned int token = hvmemul_cache_disable(curr);
-
-        /*
-         * We do a modicum of checking here, just for paranoia's sake and to
-         * definitely avoid copying an unitialised buffer into guest address
-         * space.
-         */
-        rc = hvm_copy_from_guest_phys(buf, sgpa, bytes);
-        hvmemul_cache_restore(curr, token);
-    }
-
-    if ( rc == HVMTRANS_okay )
         rc = hvm_copy_to_guest_phys(dgpa, buf, bytes, curr);
 
-    xfree(buf);
+        xfree(buf);
+    }
+    else
+        rc = hvmemul_phys_rep_copy(dgpa, sgpa, NULL, bytes_per_rep, reps, df);
 
     switch ( rc )
     {
@@ -2029,55 +2117,12 @@ static int hvmemul_rep_stos(
 
     switch ( p2mt )
     {
-        unsigned long bytes;
-        char *buf;
-
     default:
-        /* Allocate temporary buffer. */
-        for ( ; ; )
-        {
-            bytes = *reps * bytes_per_rep;
-            buf = xmalloc_bytes(bytes);
-            if ( buf || *reps <= 1 )
-                break;
-            *reps >>= 1;
-        }
-
-        if ( !buf )
-            buf = p_data;
-        else
-            switch ( bytes_per_rep )
-            {
-                unsigned long dummy;
-
-#define CASE(bits, suffix)                                     \
-            case (bits) / 8:                                   \
-                asm ( "rep stos" #suffix                       \
-                      : "=m" (*buf),                           \
-                        "=D" (dummy), "=c" (dummy)             \
-                      : "a" (*(const uint##bits##_t *)p_data), \
-                        "1" (buf), "2" (*reps) : "memory" );   \
-                break
-            CASE(8, b);
-            CASE(16, w);
-            CASE(32, l);
-            CASE(64, q);
-#undef CASE
-
-            default:
-                ASSERT_UNREACHABLE();
-                xfree(buf);
-                return X86EMUL_UNHANDLEABLE;
-            }
-
         /* Adjust address for reverse store. */
         if ( df )
-            gpa -= bytes - bytes_per_rep;
+            gpa -= *reps * bytes_per_rep - bytes_per_rep;
 
-        rc = hvm_copy_to_guest_phys(gpa, buf, bytes, curr);
-
-        if ( buf != p_data )
-            xfree(buf);
+        rc = hvmemul_phys_rep_copy(gpa, 0, p_data, bytes_per_rep, reps, df);
 
         switch ( rc )
         {
@@ -2636,6 +2681,7 @@ static int _hvm_emulate_one(struct hvm_emulate_ctxt *hvmemul_ctxt,
     {
         ASSERT(vio->io_req.state == STATE_IOREQ_NONE);
         vio->cache->num_ents = 0;
+        vio->cache->num_walks = 0;
     }
     else
         ASSERT(vio->io_req.state == STATE_IORESP_READY);
@@ -2649,6 +2695,16 @@ static int _hvm_emulate_one(struct hvm_emulate_ctxt *hvmemul_ctxt,
     if ( rc == X86EMUL_OKAY && vio->mmio_retry )
         rc = X86EMUL_RETRY;
 
+    /*
+     * Without paging, the prefetched bytes remain valid for the following
+     * instruction unless the one just emulated wrote to memory (and hence
+     * may have modified code) or changed CS (checked upon use).
+     */
+    hvmemul_ctxt->insn_buf_reusable = hvmemul_ctxt->insn_buf_reusable &&
+                                      rc == X86EMUL_OKAY &&
+                                      !hvmemul_ctxt->is_mem_write &&
+                                      !hvm_paging_enabled(curr);
+
     if ( !hvm_ioreq_needs_completion(&vio->io_req) )
         completion = HVMIO_no_completion;
     else if ( completion == HVMIO_no_completion )
@@ -2858,6 +2914,7 @@ void hvm_emulate_init_per_insn(
     unsigned int insn_bytes)
 {
     struct vcpu *curr = current;
+    bool carried = false;
 
     hvmemul_ctxt->ctxt.lma = hvm_long_mode_active(curr);
 
@@ -2872,9 +2929,35 @@ void hvm_emulate_init_per_insn(
             hvmemul_ctxt->seg_reg[x86_seg_ss].db ? 32 : 16;
     }
 
-    hvmemul_ctxt->insn_buf_eip = hvmemul_ctxt->ctxt.regs->rip;
+    if ( !insn_bytes && hvmemul_ctxt->insn_buf_reusable &&
+         hvmemul_ctxt->seg_reg[x86_seg_cs].base ==
+         hvmemul_ctxt->insn_buf_cs_base &&
+         hvmemul_ctxt->ctxt.regs->rip - hvmemul_ctxt->insn_buf_eip <
+         hvmemul_ctxt->insn_buf_bytes )
+    {
+        /*
+         * The new instruction starts within the bytes fetched for the
+         * previous one: shift them down, and let hvmemul_insn_fetch() fetch
+         * whatever else is needed.
+         */
+        unsigned int off = hvmemul_ctxt->ctxt.regs->rip -
+                           hvmemul_ctxt->insn_buf_eip;
+
+        hvmemul_ctxt->insn_buf_bytes -= off;
+        memmove(hvmemul_ctxt->insn_buf, &hvmemul_ctxt->insn_buf[off],
+                hvmemul_ctxt->insn_buf_bytes);
+        hvmemul_ctxt->insn_buf_eip = hvmemul_ctxt->ctxt.regs->rip;
+        carried = true;
+    }
+    else
+        hvmemul_ctxt->insn_buf_eip = hvmemul_ctxt->ctxt.regs->rip;
+
+    hvmemul_ctxt->insn_buf_reusable = !hvm_paging_enabled(curr);
+    hvmemul_ctxt->insn_buf_cs_base = hvmemul_ctxt->seg_reg[x86_seg_cs].base;
 
-    if ( insn_bytes )
+    if ( carried )
+        /* Nothing to fetch up front. */;
+    else if ( insn_bytes )
     {
         hvmemul_ctxt->insn_buf_bytes = insn_bytes;
         memcpy(hvmemul_ctxt->insn_buf, insn_buf, insn_bytes);
@@ -2903,6 +2986,7 @@ void hvm_emulate_init_per_insn(
     }
 
     hvmemul_ctxt->is_mem_access = false;
+    hvmemul_ctxt->is_mem_write = true;
 }
 
 void hvm_emulate_writeback(
@@ -3042,6 +3126,92 @@ bool hvmemul_read_cache(const struct vcpu *v, paddr_t gpa,
     return false;
 }
 
+/*
+ * Check whether the walk context recorded with the cached translations still
+ * matches the vCPU's, resetting the cache if not (or if asked to).
+ */
+static bool hvmemul_walk_ctx_valid(struct hvmemul_cache *cache,
+                                   const struct vcpu *v, bool reset)
+{
+    const struct hvm_vcpu *hvm = &v->arch.hvm;
+    bool ac = guest_cpu_user_regs()->eflags & X86_EFLAGS_AC;
+
+    if ( !reset &&
+         cache->walk_ctx.cr0 == hvm->guest_cr[0] &&
+         cache->walk_ctx.cr3 == hvm->guest_cr[3] &&
+         cache->walk_ctx.cr4 == hvm->guest_cr[4] &&
+         cache->walk_ctx.efer == hvm->guest_efer &&
+         cache->walk_ctx.ac == ac )
+        return true;
+
+    cache->num_walks = 0;
+    cache->next_walk = 0;
+    cache->walk_ctx.cr0 = hvm->guest_cr[0];
+    cache->walk_ctx.cr3 = hvm->guest_cr[3];
+    cache->walk_ctx.cr4 = hvm->guest_cr[4];
+    cache->walk_ctx.efer = hvm->guest_efer;
+    cache->walk_ctx.ac = ac;
+
+    return false;
+}
+
+/*
+ * Page walks aren't cheap, especially with shadow paging or with the guest
+ * using large numbers of page table levels, yet an emulated insn commonly
+ * needs the same translation several times (insn fetch, operand access,
+ * individual iterations of string insns, retries after I/O completion).
+ * Remember complete successful translations for the duration of the
+ * emulation of a single insn.  The page table entries they were obtained
+ * from live in the cache above, so re-walking couldn't produce a different
+ * result anyway;  accessed and dirty bits, if needed, were set by the first
+ * walk with the very same access type.
+ */
+bool hvmemul_read_walk(struct vcpu *v, unsigned long va, uint32_t pfec,
+                       unsigned long *gfn)
+{
+    struct hvmemul_cache *cache = v->arch.hvm.hvm_io.cache;
+    unsigned long vfn = va >> PAGE_SHIFT;
+    unsigned int i;
+
+    /* Cache unavailable? */
+    if ( !is_hvm_vcpu(v) || v != current ||
+         cache->num_ents > cache->max_ents || !cache->num_walks ||
+         !hvmemul_walk_ctx_valid(cache, v, false) )
+        return false;
+
+    for ( i = 0; i < cache->num_walks; ++i )
+        if ( cache->walks[i].vfn == vfn && cache->walks[i].pfec == pfec )
+        {
+            *gfn = cache->walks[i].gfn;
+            return true;
+        }
+
+    return false;
+}
+
+void hvmemul_write_walk(struct vcpu *v, unsigned long va, uint32_t pfec,
+                        unsigned long gfn)
+{
+    struct hvmemul_cache *cache = v->arch.hvm.hvm_io.cache;
+    unsigned int i;
+
+    /* Cache unavailable? */
+    if ( !is_hvm_vcpu(v) || v != current ||
+         cache->num_ents > cache->max_ents )
+        return;
+
+    hvmemul_walk_ctx_valid(cache, v, !cache->num_walks);
+
+    i = cache->next_walk;
+    cache->next_walk = (i + 1) % HVMEMUL_NR_WALKS;
+    if ( cache->num_walks < HVMEMUL_NR_WALKS )
+        ++cache->num_walks;
+
+    cache->walks[i].vfn = va >> PAGE_SHIFT;
+    cache->walks[i].gfn = gfn;
+    cache->walks[i].pfec = pfec;
+}
+
 void hvmemul_write_cache(const struct vcpu *v, paddr_t gpa,
                          const void *buffer, unsigned int size)
 {
@@ -78,6 +78,52 @@ static inline uint64_t hpet_read_maincounter(HPETState *h, uint64_t guest_time)
         return h->hpet.mc64;
 }
 
+static void hpet_mc_write_begin(HPETState *h)
+{
+    ASSERT(rw_is_write_locked(&h->lock));
+
+    write_atomic(&h->mc_seq, h->mc_seq + 1);
+    smp_wmb();
+}
+
+static void hpet_mc_write_end(HPETState *h)
+{
+    smp_wmb();
+    write_atomic(&h->mc_seq, h->mc_seq + 1);
+}
+
+/*
+ * The main counter is by far the most frequently read register (guests
+ * using the HPET as clocksource read it on every timestamp), so read it
+ * without touching the lock, which would otherwise bounce between all the
+ * vCPUs doing so.
+ */
+static uint64_t hpet_read_maincounter_lockless(HPETState *h)
+{
+    unsigned int seq;
+    uint64_t val;
+
+    for ( ; ; )
+    {
+        seq = read_atomic(&h->mc_seq);
+        if ( seq & 1 )
+        {
+            cpu_relax();
+            continue;
+        }
+        smp_rmb();
+
+        if ( hpet_enabled(h) )
+            val = guest_time_hpet(h) + read_atomic(&h->mc_offset);
+        else
+            val = read_atomic(&h->hpet.mc64);
+
+        smp_rmb();
+        if ( read_atomic(&h->mc_seq) == seq )
+            return val;
+    }
+}
+
 static uint64_t hpet_get_comparator(HPETState *h, unsigned int tn,
                                     uint64_t guest_time)
 {
@@ -183,19 +229,25 @@ static int hpet_read(
         goto out;
     }
 
-    result = addr < HPET_Tn_CMP(0) ||
-             ((addr - HPET_Tn_CMP(0)) % (HPET_Tn_CMP(1) - HPET_Tn_CMP(0))) > 7;
-    if ( result )
-        read_lock(&h->lock);
+    if ( (addr & ~7) == HPET_COUNTER )
+        val = hpet_read_maincounter_lockless(h);
     else
-        write_lock(&h->lock);
+    {
+        result = addr < HPET_Tn_CMP(0) ||
+                 ((addr - HPET_Tn_CMP(0)) %
+                  (HPET_Tn_CMP(1) - HPET_Tn_CMP(0))) > 7;
+        if ( result )
+            read_lock(&h->lock);
+        else
+            write_lock(&h->lock);
 
-    val = hpet_read64(h, addr, guest_time_hpet(h));
+        val = hpet_read64(h, addr, guest_time_hpet(h));
 
-    if ( result )
-        read_unlock(&h->lock);
-    else
-        write_unlock(&h->lock);
+        if ( result )
+            read_unlock(&h->lock);
+        else
+            write_unlock(&h->lock);
+    }
 
     result = val;
     if ( length != 8 )
@@ -384,13 +436,18 @@ static int hpet_write(
     switch ( addr & ~7 )
     {
     case HPET_CFG:
+        hpet_mc_write_begin(h);
+        if ( !(old_val & HPET_CFG_ENABLE) && (new_val & HPET_CFG_ENABLE) )
+            h->mc_offset = h->hpet.mc64 - guest_time;
+        else if ( (old_val & HPET_CFG_ENABLE) && !(new_val & HPET_CFG_ENABLE) )
+            h->hpet.mc64 = h->mc_offset + guest_time;
         h->hpet.config = hpet_fixup_reg(new_val, old_val,
                                         HPET_CFG_ENABLE | HPET_CFG_LEGACY);
+        hpet_mc_write_end(h);
 
         if ( !(old_val & HPET_CFG_ENABLE) && (new_val & HPET_CFG_ENABLE) )
         {
             /* Enable main counter and interrupt generation. */
-            h->mc_offset = h->hpet.mc64 - guest_time;
             for ( i = 0; i < HPET_TIMER_NUM; i++ )
             {
                 h->hpet.comparator64[i] =
@@ -404,7 +461,6 @@ static int hpet_write(
         else if ( (old_val & HPET_CFG_ENABLE) && !(new_val & HPET_CFG_ENABLE) )
         {
             /* Halt main counter and disable interrupt generation. */
-            h->hpet.mc64 = h->mc_offset + guest_time;
             for ( i = 0; i < HPET_TIMER_NUM; i++ )
                 if ( timer_enabled(h, i) )
                     set_stop_timer(i);
@@ -433,7 +489,9 @@ static int hpet_write(
         break;
 
     case HPET_COUNTER:
+        hpet_mc_write_begin(h);
         h->hpet.mc64 = new_val;
+        hpet_mc_write_end(h);
         if ( hpet_enabled(h) )
         {
             gdprintk(XENLOG_WARNING,
@@ -661,6 +719,8 @@ static int hpet_load(struct domain *d, hvm_domain_context_t *h)
         return -EINVAL;
     }
 
+    hpet_mc_write_begin(hp);
+
     rec = (struct hvm_hw_hpet *)&h->data[h->cur];
     h->cur += HVM_SAVE_LENGTH(HPET);
 
@@ -692,6 +752,8 @@ static int hpet_load(struct domain *d, hvm_domain_context_t *h)
     guest_time = guest_time_hpet(hp);
     hp->mc_offset = hp->hpet.mc64 - guest_time;
 
+    hpet_mc_write_end(hp);
+
     /* restart all timers */
 
     if ( hpet_enabled(hp) )
@@ -765,7 +827,9 @@ void hpet_deinit(struct domain *d)
             if ( timer_enabled(h, i) )
                 hpet_stop_timer(h, i, guest_time);
 
+        hpet_mc_write_begin(h);
         h->hpet.config = 0;
+        hpet_mc_write_end(h);
     }
 
     write_unlock(&h->lock);
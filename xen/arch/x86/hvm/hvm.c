@@ -3310,7 +3310,8 @@ static enum hvm_translation_result __hvm_copy(
         if ( unlikely(v->arch.vm_event) &&
              (flags & HVMCOPY_linear) &&
              v->arch.vm_event->send_event &&
-             hvm_monitor_check_p2m(addr, gfn, pfec, npfec_kind_with_gla) )
+             hvm_monitor_check_p2m(addr, gfn, pfec, npfec_kind_with_gla,
+                                   count) )
         {
             put_page(page);
             return HVMTRANS_need_retry;
@@ -4170,10 +4171,10 @@ static int hvm_set_param(struct domain *d, uint32_t index, uint64_t value)
         /*
          * Update GUEST_CR3 in each VMCS to point at identity map.
          * All foreign updates to guest state must synchronise on
-         * the domctl_lock.
+         * the domain's domctl_lock.
          */
         rc = -ERESTART;
-        if ( !domctl_lock_acquire() )
+        if ( !domctl_lock_acquire(d) )
             break;
 
         rc = 0;
@@ -4183,7 +4184,7 @@ static int hvm_set_param(struct domain *d, uint32_t index, uint64_t value)
             paging_update_cr3(v, false);
         domain_unpause(d);
 
-        domctl_lock_release();
+        domctl_lock_release(d);
         break;
     case HVM_PARAM_DM_DOMAIN:
         /* The only value this should ever be set to is DOMID_SELF */
@@ -221,23 +221,42 @@ int hvm_process_io_intercept(const struct hvm_io_handler *handler,
 
 static const struct hvm_io_handler *hvm_find_io_handler(const ioreq_t *p)
 {
-    struct domain *curr_d = current->domain;
+    struct vcpu *curr = current;
+    struct domain *curr_d = curr->domain;
+    struct hvm_vcpu_io *vio = &curr->arch.hvm.hvm_io;
+    const struct hvm_io_handler *handler = vio->last_handler;
     unsigned int i;
 
     BUG_ON((p->type != IOREQ_TYPE_PIO) &&
            (p->type != IOREQ_TYPE_COPY));
 
+    /*
+     * Guests tend to access the same registers over and over (timers,
+     * EOIs, ...), so try the handler that accepted the previous access to
+     * the same address before scanning all of them.  As handlers don't
+     * overlap, this still finds the same handler the scan would have.
+     */
+    if ( handler && vio->last_type == p->type && vio->last_addr == p->addr &&
+         handler->ops->accept(handler, p) )
+        return handler;
+
     for ( i = 0; i < curr_d->arch.hvm.io_handler_count; i++ )
     {
-        const struct hvm_io_handler *handler =
-            &curr_d->arch.hvm.io_handler[i];
-        const struct hvm_io_ops *ops = handler->ops;
+        const struct hvm_io_ops *ops;
+
+        handler = &curr_d->arch.hvm.io_handler[i];
+        ops = handler->ops;
 
         if ( handler->type != p->type )
             continue;
 
         if ( ops->accept(handler, p) )
+        {
+            vio->last_handler = handler;
+            vio->last_addr = p->addr;
+            vio->last_type = p->type;
             return handler;
+        }
     }
 
     return NULL;
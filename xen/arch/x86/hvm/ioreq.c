@@ -1162,6 +1162,43 @@ int hvm_set_ioreq_server_state(struct domain *d, ioservid_t id,
     return rc;
 }
 
+/* Longest a vCPU may spin waiting for an emulator's response. */
+#define IOREQ_SPIN_MAX_NS MICROSECS(100)
+
+int hvm_set_ioreq_server_polling(struct domain *d, ioservid_t id,
+                                 uint32_t flags, uint32_t spin_ns)
+{
+    struct hvm_ioreq_server *s;
+    int rc;
+
+    spin_lock_recursive(&d->arch.hvm.ioreq_server.lock);
+
+    s = get_ioreq_server(d, id);
+
+    rc = -ENOENT;
+    if ( !s )
+        goto out;
+
+    rc = -EPERM;
+    if ( s->emulator != current->domain )
+        goto out;
+
+    /*
+     * No pausing needed: requests sent while this changes are at worst
+     * notified needlessly, and an emulator stopping to poll rescans (after
+     * this hypercall, which orders against hvm_send_ioreq()'s check).
+     */
+    write_atomic(&s->spin_ns, min_t(uint32_t, spin_ns, IOREQ_SPIN_MAX_NS));
+    write_atomic(&s->poll_requests, !!(flags & XEN_DMOP_IOREQ_POLL_REQUESTS));
+    smp_mb();
+
+    rc = 0;
+
+ out:
+    spin_unlock_recursive(&d->arch.hvm.ioreq_server.lock);
+    return rc;
+}
+
 int hvm_all_ioreq_servers_add_vcpu(struct domain *d, struct vcpu *v)
 {
     struct hvm_ioreq_server *s;
@@ -1343,6 +1380,8 @@ static int hvm_send_buffered_ioreq(struct hvm_ioreq_server *s, ioreq_t *p)
                        .dir = p->dir };
     /* Timeoffset sends 64b data, but no address. Use two consecutive slots. */
     int qw = 0;
+    uint32_t wp;
+    bool notify;
 
     /* Ensure buffered_iopage fits in a page */
     BUILD_BUG_ON(sizeof(buffered_iopage_t) > PAGE_SIZE);
@@ -1394,17 +1433,28 @@ static int hvm_send_buffered_ioreq(struct hvm_ioreq_server *s, ioreq_t *p)
         return X86EMUL_UNHANDLEABLE;
     }
 
-    pg->buf_ioreq[pg->ptrs.write_pointer % IOREQ_BUFFER_SLOT_NUM] = bp;
+    wp = pg->ptrs.write_pointer;
+    pg->buf_ioreq[wp % IOREQ_BUFFER_SLOT_NUM] = bp;
 
     if ( qw )
     {
         bp.data = p->data >> 32;
-        pg->buf_ioreq[(pg->ptrs.write_pointer+1) % IOREQ_BUFFER_SLOT_NUM] = bp;
+        pg->buf_ioreq[(wp + 1) % IOREQ_BUFFER_SLOT_NUM] = bp;
     }
 
     /* Make the ioreq_t visible /before/ write_pointer. */
     smp_wmb();
-    pg->ptrs.write_pointer += qw ? 2 : 1;
+    pg->ptrs.write_pointer = wp + (qw ? 2 : 1);
+
+    /*
+     * Only notify the device model when the ring was empty.  Otherwise it
+     * has yet to consume the earlier requests, and as it keeps draining the
+     * ring until it finds it empty, it is going to find this one as well:
+     * either it observes the new write_pointer after advancing read_pointer,
+     * or we observe the ring having been drained up to here.
+     */
+    smp_mb();
+    notify = pg->ptrs.read_pointer == wp;
 
     /* Canonicalize read/write pointers to prevent their overflow. */
     while ( (s->bufioreq_handling == HVM_IOREQSRV_BUFIOREQ_ATOMIC) &&
@@ -1419,12 +1469,44 @@ static int hvm_send_buffered_ioreq(struct hvm_ioreq_server *s, ioreq_t *p)
         cmpxchg(&pg->ptrs.full, old.full, new.full);
     }
 
-    notify_via_xen_event_channel(d, s->bufioreq_evtchn);
+    if ( notify )
+    {
+        smp_mb(); /* Write pointer update /then/ check for polling. */
+        if ( !read_atomic(&s->poll_requests) )
+            notify_via_xen_event_channel(d, s->bufioreq_evtchn);
+    }
     spin_unlock(&s->bufioreq_lock);
 
     return X86EMUL_OKAY;
 }
 
+/*
+ * With an emulator on a dedicated core, the response to a request often
+ * arrives within a few microseconds.  Spinning for it (for a time chosen by
+ * the emulator) then saves blocking and being woken again.
+ */
+static void hvm_spin_for_ioresp(struct vcpu *v, const ioreq_t *p,
+                                s_time_t spin_ns)
+{
+    s_time_t deadline = NOW() + spin_ns;
+
+    do {
+        /* A bit-field, so no read_atomic(); cpu_relax() is a barrier. */
+        unsigned int state = p->state;
+
+        if ( state == STATE_IORESP_READY )
+        {
+            /* What the event channel notification would also do. */
+            clear_bit(_VPF_blocked_in_xen, &v->pause_flags);
+            return;
+        }
+        if ( state == STATE_IOREQ_NONE )
+            return;
+
+        cpu_relax();
+    } while ( NOW() < deadline );
+}
+
 int hvm_send_ioreq(struct hvm_ioreq_server *s, ioreq_t *proto_p,
                    bool buffered)
 {
@@ -1475,9 +1557,15 @@ int hvm_send_ioreq(struct hvm_ioreq_server *s, ioreq_t *proto_p,
              * barrier.
              */
             p->state = STATE_IOREQ_READY;
-            notify_via_xen_event_channel(d, port);
+            smp_mb(); /* Set state /then/ check for polling. */
+            if ( !read_atomic(&s->poll_requests) )
+                notify_via_xen_event_channel(d, port);
 
             sv->pending = true;
+
+            if ( read_atomic(&s->spin_ns) )
+                hvm_spin_for_ioresp(curr, p, read_atomic(&s->spin_ns));
+
             return X86EMUL_RETRY;
         }
     }
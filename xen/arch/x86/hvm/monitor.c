@@ -230,7 +230,7 @@ void hvm_monitor_interrupt(unsigned int vector, unsigned int type,
  * error. Assumes the caller will enable/disable arch.vm_event->send_event.
  */
 bool hvm_monitor_check_p2m(unsigned long gla, gfn_t gfn, uint32_t pfec,
-                           uint16_t kind)
+                           uint16_t kind, unsigned int bytes)
 {
     xenmem_access_t access;
     struct vcpu *curr = current;
@@ -284,6 +284,9 @@ bool hvm_monitor_check_p2m(unsigned long gla, gfn_t gfn, uint32_t pfec,
     if ( !req.u.mem_access.flags )
         return false; /* no violation */
 
+    if ( monitor_mem_access_filtered(curr->domain, gpa, bytes) )
+        return false; /* filtered out by the monitor */
+
     if ( kind == npfec_kind_with_gla )
         req.u.mem_access.flags |= MEM_ACCESS_FAULT_WITH_GLA |
                                   MEM_ACCESS_GLA_VALID;
@@ -987,6 +987,9 @@ static void svm_ctxt_switch_to(struct vcpu *v)
     vmcb->cleanbits.raw = 0;
     svm_tsc_ratio_load(v);
 
+    if ( cpu_has_pause_filter && !nestedhvm_vcpu_in_guestmode(v) )
+        vmcb->_pause_filter_count = SVM_PAUSEFILTER_INIT;
+
     if ( cpu_has_msr_tsc_aux )
         wrmsr_tsc_aux(v->arch.msrs->tsc_aux);
 }
@@ -1047,6 +1050,9 @@ void svm_vmenter_helper(const struct cpu_user_regs *regs)
 
     ASSERT(hvmemul_cache_disabled(curr));
 
+    write_atomic(&curr->arch.hvm.in_guest, true);
+    smp_mb(); /* Set in_guest /then/ look at the ASID generation. */
+
     svm_asid_handle_vmrun();
 
     if ( unlikely(tb_init_done) )
@@ -2226,6 +2232,22 @@ static void svm_vmexit_do_rdtsc(struct cpu_user_regs *regs, bool rdtscp)
     hvm_rdtsc_intercept(regs);
 }
 
+/*
+ * As for VMX's adaptive Pause-Loop Exiting: a vcpu which takes pause exits
+ * without being descheduled in between has nobody to yield to, so double its
+ * filter count each time, and put it back when it is next scheduled in.
+ */
+static void svm_pause_filter_grow(struct vcpu *v)
+{
+    struct vmcb_struct *vmcb = v->arch.hvm.svm.vmcb;
+    unsigned int count = vmcb_get_pause_filter_count(vmcb);
+
+    if ( count >= SVM_PAUSEFILTER_MAX || nestedhvm_vcpu_in_guestmode(v) )
+        return;
+
+    vmcb_set_pause_filter_count(vmcb, min(count * 2, SVM_PAUSEFILTER_MAX));
+}
+
 static void svm_vmexit_do_pause(struct cpu_user_regs *regs)
 {
     unsigned int inst_len;
@@ -2236,10 +2258,12 @@ static void svm_vmexit_do_pause(struct cpu_user_regs *regs)
 
     /*
      * The guest is running a contended spinlock and we've detected it.
-     * Do something useful, like reschedule the guest
+     * Do something useful, like reschedule the guest, preferably in favour
+     * of a preempted vcpu which may be holding the lock.
      */
     perfc_incr(pauseloop_exits);
-    do_sched_op(SCHEDOP_yield, guest_handle_from_ptr(NULL, void));
+    svm_pause_filter_grow(current);
+    vcpu_yield_to_preempted();
 }
 
 static void
@@ -2521,6 +2545,8 @@ void svm_vmexit_handler(struct cpu_user_regs *regs)
     bool_t vcpu_guestmode = 0;
     struct vlapic *vlapic = vcpu_vlapic(v);
 
+    write_atomic(&v->arch.hvm.in_guest, false);
+
     regs->rax = vmcb->rax;
     regs->rip = vmcb->rip;
     regs->rsp = vmcb->rsp;
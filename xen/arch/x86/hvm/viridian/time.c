@@ -126,6 +126,48 @@ static void stop_stimer(struct viridian_stimer *vs)
     vs->started = false;
 }
 
+static int64_t stimer_periodic_expiration(const struct viridian_stimer *vs,
+                                          int64_t now)
+{
+    int64_t expiration;
+    unsigned int missed = 0;
+
+    /*
+     * The specification says that if the timer is lazy then we
+     * skip over any missed expirations so we can treat this case
+     * as the same as if the timer is currently stopped, i.e. we
+     * just schedule expiration to be 'count' ticks from now.
+     */
+    if ( !vs->started || vs->config.lazy )
+        return now + vs->count;
+
+    /*
+     * The timer is already started, so we're re-scheduling.
+     * Hence advance the timer expiration by one tick.
+     */
+    expiration = vs->expiration + vs->count;
+
+    /* Now check to see if any expirations have been missed */
+    if ( expiration - now <= 0 )
+        missed = ((now - expiration) / vs->count) + 1;
+
+    /*
+     * The specification says that if the timer is not lazy then
+     * a non-zero missed count should be used to reduce the period
+     * of the timer until it catches up, unless the count has
+     * reached a 'significant number', in which case the timer
+     * should be treated as lazy. Unfortunately the specification
+     * does not state what that number is so the choice of number
+     * here is a pure guess.
+     */
+    if ( missed > 3 )
+        expiration = now + vs->count;
+    else if ( missed )
+        expiration = now + (vs->count / missed);
+
+    return expiration;
+}
+
 static void stimer_expire(void *data)
 {
     struct viridian_stimer *vs = data;
@@ -133,6 +175,45 @@ static void stimer_expire(void *data)
     struct viridian_vcpu *vv = v->arch.hvm.viridian;
     unsigned int stimerx = vs - &vv->stimer[0];
 
+    if ( vs->config.direct_mode )
+    {
+        int64_t now;
+
+        /* Expiry may race with the timer being disabled; see poll_stimer() */
+        if ( !vs->config.enable )
+            return;
+
+        /*
+         * Direct mode timers do not use a SynIC message slot, so the
+         * interrupt can be raised from here rather than from the vcpu's
+         * own context. With APICv this is a posted interrupt, and a
+         * running vcpu takes it without a VM exit.
+         */
+        vlapic_set_irq(vcpu_vlapic(v), vs->config.apic_vector, 0);
+
+        if ( !vs->config.periodic )
+        {
+            /*
+             * config.enable is owned by the vcpu, so leave it to
+             * poll_stimer() to clear it on the next entry. Until then the
+             * pending bit makes the CONFIG MSR read back as disabled.
+             */
+            set_bit(stimerx, &vv->stimer_pending);
+            return;
+        }
+
+        /*
+         * Re-arm in place. The timer stays on the cpu it was last
+         * migrated to by start_stimer(); a re-arm racing with a CONFIG or
+         * COUNT write can at worst cause one stray expiry, which is
+         * either harmless or filtered out by the enable check above.
+         */
+        now = time_ref_count(v->domain);
+        vs->expiration = stimer_periodic_expiration(vs, now);
+        set_timer(&vs->timer, NOW() + (vs->expiration - now) * 100ull);
+        return;
+    }
+
     set_bit(stimerx, &vv->stimer_pending);
     vcpu_kick(v);
 }
@@ -151,44 +232,7 @@ static void start_stimer(struct viridian_stimer *vs)
                stimerx);
 
     if ( vs->config.periodic )
-    {
-        /*
-         * The specification says that if the timer is lazy then we
-         * skip over any missed expirations so we can treat this case
-         * as the same as if the timer is currently stopped, i.e. we
-         * just schedule expiration to be 'count' ticks from now.
-         */
-        if ( !vs->started || vs->config.lazy )
-            expiration = now + vs->count;
-        else
-        {
-            unsigned int missed = 0;
-
-            /*
-             * The timer is already started, so we're re-scheduling.
-             * Hence advance the timer expiration by one tick.
-             */
-            expiration = vs->expiration + vs->count;
-
-            /* Now check to see if any expirations have been missed */
-            if ( expiration - now <= 0 )
-                missed = ((now - expiration) / vs->count) + 1;
-
-            /*
-             * The specification says that if the timer is not lazy then
-             * a non-zero missed count should be used to reduce the period
-             * of the timer until it catches up, unless the count has
-             * reached a 'significant number', in which case the timer
-             * should be treated as lazy. Unfortunately the specification
-             * does not state what that number is so the choice of number
-             * here is a pure guess.
-             */
-            if ( missed > 3 )
-                expiration = now + vs->count;
-            else if ( missed )
-                expiration = now + (vs->count / missed);
-        }
-    }
+        expiration = stimer_periodic_expiration(vs, now);
     else
     {
         expiration = vs->count;
@@ -229,7 +273,9 @@ static void poll_stimer(struct vcpu *v, unsigned int stimerx)
     if ( !test_bit(stimerx, &vv->stimer_pending) )
         return;
 
-    if ( !viridian_synic_deliver_timer_msg(v, vs->config.sintx,
+    /* Direct mode expiry has already raised the interrupt */
+    if ( !vs->config.direct_mode &&
+         !viridian_synic_deliver_timer_msg(v, vs->config.sintx,
                                            stimerx, vs->expiration,
                                            time_ref_count(v->domain)) )
         return;
@@ -357,7 +403,8 @@ int viridian_time_wrmsr(struct vcpu *v, uint32_t idx, uint64_t val)
 
         vs->config.as_uint64 = val;
 
-        if ( !vs->config.sintx )
+        /* Direct mode timers signal apic_vector rather than a SINT */
+        if ( !vs->config.direct_mode && !vs->config.sintx )
             vs->config.enable = 0;
 
         if ( vs->config.enable )
@@ -16,6 +16,7 @@
 #include <asm/paging.h>
 #include <asm/p2m.h>
 #include <asm/apic.h>
+#include <asm/hvm/nestedhvm.h>
 #include <asm/hvm/support.h>
 #include <public/sched.h>
 #include <public/hvm/hvm_op.h>
@@ -78,6 +79,7 @@ typedef union _HV_CRASH_CTL_REG_CONTENTS
 /* Viridian CPUID leaf 3, Hypervisor Feature Indication */
 #define CPUID3D_CRASH_MSRS (1 << 10)
 #define CPUID3D_SINT_POLLING (1 << 17)
+#define CPUID3D_STIMER_DIRECT_MODE (1 << 19)
 
 /* Viridian CPUID leaf 4: Implementation Recommendations. */
 #define CPUID4A_HCALL_REMOTE_TLB_FLUSH (1 << 2)
@@ -91,6 +93,9 @@ typedef union _HV_CRASH_CTL_REG_CONTENTS
 #define CPUID6A_MSR_BITMAPS     (1 << 1)
 #define CPUID6A_NESTED_PAGING   (1 << 3)
 
+/* Viridian CPUID leaf 0x4000000A: Nested Virtualization Features */
+#define CPUIDAA_NESTED_GUEST_MAPPING_FLUSH (1 << 18)
+
 /*
  * Version and build number reported by CPUID leaf 2
  *
@@ -123,7 +128,8 @@ void cpuid_viridian_leaves(const struct vcpu *v, uint32_t leaf,
     switch ( leaf )
     {
     case 0:
-        res->a = 0x40000006; /* Maximum leaf */
+        /* Maximum leaf */
+        res->a = nestedhvm_enabled(d) ? 0x4000000a : 0x40000006;
         memcpy(&res->b, "Micr", 4);
         memcpy(&res->c, "osof", 4);
         memcpy(&res->d, "t Hv", 4);
@@ -183,6 +189,8 @@ void cpuid_viridian_leaves(const struct vcpu *v, uint32_t leaf,
             res->d = CPUID3D_CRASH_MSRS;
         if ( viridian_feature_mask(d) & HVMPV_synic )
             res->d |= CPUID3D_SINT_POLLING;
+        if ( viridian_feature_mask(d) & HVMPV_stimer )
+            res->d |= CPUID3D_STIMER_DIRECT_MODE;
 
         break;
     }
@@ -218,6 +226,12 @@ void cpuid_viridian_leaves(const struct vcpu *v, uint32_t leaf,
         if ( hap_enabled(d) )
             res->a |= CPUID6A_NESTED_PAGING;
         break;
+
+    case 0xa:
+        /* Nested virtualization features. */
+        if ( nestedhvm_enabled(d) )
+            res->a = CPUIDAA_NESTED_GUEST_MAPPING_FLUSH;
+        break;
     }
 }
 
@@ -795,6 +809,51 @@ static int hvcall_flush_ex(const union hypercall_input *input,
     return 0;
 }
 
+static int hvcall_flush_gpa(const union hypercall_input *input,
+                            union hypercall_output *output,
+                            paddr_t input_params_gpa,
+                            paddr_t output_params_gpa)
+{
+    struct vcpu *curr = current;
+    struct {
+        uint64_t address_space;
+        uint64_t flags;
+    } input_params;
+
+    if ( !nestedhvm_enabled(curr->domain) )
+        return -EOPNOTSUPP;
+
+    /* Get input parameters. */
+    if ( input->fast )
+    {
+        if ( input->call_code != HVCALL_FLUSH_GUEST_PHYSICAL_ADDRESS_SPACE )
+            return -EINVAL;
+
+        input_params.address_space = input_params_gpa;
+        input_params.flags = output_params_gpa;
+    }
+    else if ( hvm_copy_from_guest_phys(&input_params, input_params_gpa,
+                                       sizeof(input_params)) != HVMTRANS_okay )
+        return -EINVAL;
+
+    /* No flags are defined. */
+    if ( input_params.flags )
+        return -EINVAL;
+
+    /*
+     * This is the paravirtual equivalent of a single-context INVEPT (or
+     * nested CR3 flush) issued by an L1 hypervisor, but without the cost
+     * of decoding and emulating the instruction. The shadow np2m is
+     * flushed in its entirety, so the list form of the hypercall does
+     * not need its GPA ranges to be read: every rep is complete.
+     */
+    np2m_flush_base(curr, input_params.address_space);
+
+    output->rep_complete = input->rep_count;
+
+    return 0;
+}
+
 static void send_ipi(struct hypercall_vpmask *vpmask, uint8_t vector)
 {
     struct domain *currd = current->domain;
@@ -996,6 +1055,16 @@ int viridian_hypercall(struct cpu_user_regs *regs)
                              output_params_gpa);
         break;
 
+    case HVCALL_FLUSH_GUEST_PHYSICAL_ADDRESS_SPACE:
+    case HVCALL_FLUSH_GUEST_PHYSICAL_ADDRESS_LIST:
+        if ( !test_and_set_bit(_HCALL_flush_gpa, vd->hypercall_flags) )
+            printk(XENLOG_G_INFO "%pd: VIRIDIAN HVCALL_FLUSH_GUEST_PHYSICAL_ADDRESS_SPACE/LIST\n",
+                   currd);
+
+        rc = hvcall_flush_gpa(&input, &output, input_params_gpa,
+                              output_params_gpa);
+        break;
+
     case HVCALL_SEND_IPI:
         if ( !test_and_set_bit(_HCALL_ipi, vd->hypercall_flags) )
             printk(XENLOG_G_INFO "%pd: VIRIDIAN HVCALL_SEND_IPI\n",
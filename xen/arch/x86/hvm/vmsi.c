@@ -874,6 +874,28 @@ int vpci_msix_arch_disable_entry(struct vpci_msix_entry *entry,
     return 0;
 }
 
+/*
+ * Apply new address/data values to an entry that has a PIRQ set up, by
+ * re-binding the PIRQ rather than tearing down and re-creating the mapping.
+ * Besides avoiding the PIRQ and vector reallocation, this merely rewrites
+ * the posted interrupt IRTE when interrupt posting is in use.
+ */
+int vpci_msix_arch_update_entry(struct vpci_msix_entry *entry,
+                                const struct pci_dev *pdev)
+{
+    int rc;
+
+    if ( entry->arch.pirq == INVALID_PIRQ )
+        return -ENOENT;
+
+    pcidevs_lock();
+    rc = vpci_msi_update(pdev, entry->data, entry->addr, 1, entry->arch.pirq,
+                         entry->masked);
+    pcidevs_unlock();
+
+    return rc;
+}
+
 void vpci_msix_arch_init_entry(struct vpci_msix_entry *entry)
 {
     entry->arch.pirq = INVALID_PIRQ;
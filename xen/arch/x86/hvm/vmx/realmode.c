@@ -37,6 +37,9 @@ static void realmode_deliver_exception(
     csr  = hvmemul_get_seg_reg(x86_seg_cs,   hvmemul_ctxt);
     __set_bit(x86_seg_cs, &hvmemul_ctxt->seg_reg_dirty);
 
+    /* The stack frame written below may overlap prefetched bytes. */
+    hvmemul_ctxt->insn_buf_reusable = false;
+
  again:
     last_byte = (vector * 4) + 3;
     if ( idtr->limit < last_byte ||
@@ -59,6 +59,9 @@ boolean_param("apicv", opt_apicv_enabled);
  *             executions of PAUSE in a loop.
  * ple_window: upper bound on the amount of time a guest is allowed to execute
  *             in a PAUSE loop.
+ * ple_window_max: upper bound to which a vcpu's ple_window is grown, see
+ *             vmx_ple_window_grow().  No larger than ple_window disables
+ *             adapting the window.
  * Time is measured based on a counter that runs at the same rate as the TSC,
  * refer SDM volume 3b section 21.6.13 & 22.1.3.
  */
@@ -66,6 +69,8 @@ static unsigned int __read_mostly ple_gap = 128;
 integer_param("ple_gap", ple_gap);
 static unsigned int __read_mostly ple_window = 4096;
 integer_param("ple_window", ple_window);
+static unsigned int __read_mostly ple_window_max = 4096 << 6;
+integer_param("ple_window_max", ple_window_max);
 
 static bool __read_mostly opt_ept_pml = true;
 static s8 __read_mostly opt_ept_ad = -1;
@@ -1131,6 +1136,7 @@ static int construct_vmcs(struct vcpu *v)
 
     if ( cpu_has_vmx_ple )
     {
+        v->arch.hvm.vmx.ple_window = ple_window;
         __vmwrite(PLE_GAP, ple_gap);
         __vmwrite(PLE_WINDOW, ple_window);
     }
@@ -1328,7 +1334,7 @@ static int construct_vmcs(struct vcpu *v)
 
     vmx_vlapic_msr_changed(v);
 
-    if ( opt_l1d_flush && paging_mode_hap(d) )
+    if ( opt_l1d_flush && paging_mode_hap(d) && !d->arch.spec_trusted )
         rc = vmx_add_msr(v, MSR_FLUSH_CMD, FLUSH_CMD_L1D,
                          VMX_MSR_GUEST_LOADONLY);
 
@@ -1596,10 +1602,16 @@ void vmx_clear_eoi_exit_bitmap(struct vcpu *v, u8 vector)
 
 bool_t vmx_vcpu_pml_enabled(const struct vcpu *v)
 {
-    return !!(v->arch.hvm.vmx.secondary_exec_control &
-              SECONDARY_EXEC_ENABLE_PML);
+    return !!v->arch.hvm.vmx.pml_pg;
 }
 
+/*
+ * Only the PML buffer is allocated here.  Writing the VMCS of a vCPU which
+ * isn't current means a VMCLEAR IPI to whichever pCPU last ran it, which,
+ * done for every vCPU in turn, dominates the cost of turning on log-dirty
+ * mode for large guests.  The VMCS is instead updated by the vCPU itself,
+ * from vmx_vmenter_helper(), before it next runs guest code.
+ */
 int vmx_vcpu_enable_pml(struct vcpu *v)
 {
     if ( vmx_vcpu_pml_enabled(v) )
@@ -1609,7 +1621,15 @@ int vmx_vcpu_enable_pml(struct vcpu *v)
     if ( !v->arch.hvm.vmx.pml_pg )
         return -ENOMEM;
 
-    vmx_vmcs_enter(v);
+    v->arch.hvm.vmx.pml_pending = true;
+
+    return 0;
+}
+
+void vmx_vcpu_load_pml(struct vcpu *v)
+{
+    ASSERT(v == current);
+    ASSERT(v->arch.hvm.vmx.pml_pending);
 
     __vmwrite(PML_ADDRESS, page_to_maddr(v->arch.hvm.vmx.pml_pg));
     __vmwrite(GUEST_PML_INDEX, NR_PML_ENTRIES - 1);
@@ -1619,9 +1639,7 @@ int vmx_vcpu_enable_pml(struct vcpu *v)
     __vmwrite(SECONDARY_VM_EXEC_CONTROL,
               v->arch.hvm.vmx.secondary_exec_control);
 
-    vmx_vmcs_exit(v);
-
-    return 0;
+    v->arch.hvm.vmx.pml_pending = false;
 }
 
 void vmx_vcpu_disable_pml(struct vcpu *v)
@@ -1629,16 +1647,23 @@ void vmx_vcpu_disable_pml(struct vcpu *v)
     if ( !vmx_vcpu_pml_enabled(v) )
         return;
 
-    /* Make sure we don't lose any logged GPAs. */
-    vmx_vcpu_flush_pml_buffer(v);
+    /* Nothing was logged if the vCPU never entered the guest with PML on. */
+    if ( v->arch.hvm.vmx.pml_pending )
+        v->arch.hvm.vmx.pml_pending = false;
+    else
+    {
+        /* Make sure we don't lose any logged GPAs. */
+        vmx_vcpu_flush_pml_buffer(v);
 
-    vmx_vmcs_enter(v);
+        vmx_vmcs_enter(v);
 
-    v->arch.hvm.vmx.secondary_exec_control &= ~SECONDARY_EXEC_ENABLE_PML;
-    __vmwrite(SECONDARY_VM_EXEC_CONTROL,
-              v->arch.hvm.vmx.secondary_exec_control);
+        v->arch.hvm.vmx.secondary_exec_control &=
+            ~SECONDARY_EXEC_ENABLE_PML;
+        __vmwrite(SECONDARY_VM_EXEC_CONTROL,
+                  v->arch.hvm.vmx.secondary_exec_control);
 
-    vmx_vmcs_exit(v);
+        vmx_vmcs_exit(v);
+    }
 
     v->domain->arch.paging.free_page(v->domain, v->arch.hvm.vmx.pml_pg);
     v->arch.hvm.vmx.pml_pg = NULL;
@@ -1652,6 +1677,9 @@ void vmx_vcpu_flush_pml_buffer(struct vcpu *v)
     ASSERT((v == current) || (!vcpu_runnable(v) && !v->is_running));
     ASSERT(vmx_vcpu_pml_enabled(v));
 
+    if ( v->arch.hvm.vmx.pml_pending )
+        return;
+
     vmx_vmcs_enter(v);
 
     __vmread(GUEST_PML_INDEX, &pml_idx);
@@ -1850,6 +1878,36 @@ void vmx_vmentry_failure(void)
     domain_crash(curr->domain);
 }
 
+/*
+ * Adaptive Pause-Loop Exiting.  A vcpu taking PLE exits without ever being
+ * descheduled has nobody to yield to: whoever holds the lock it is spinning
+ * on is running, and exiting just adds to its wait.  Double its window on
+ * each exit, up to ple_window_max.  Once the vcpu is descheduled, the lock
+ * holders it waits for may be preempted too, so put the window back to
+ * ple_window for its next run.
+ *
+ * Windows are left alone while running a nested guest, whose VMCS is built
+ * from the L1 hypervisor's choices.
+ */
+void vmx_ple_window_grow(struct vcpu *v)
+{
+    unsigned int window = v->arch.hvm.vmx.ple_window;
+
+    ASSERT(v == current);
+
+    if ( window >= ple_window_max || nestedhvm_vcpu_in_guestmode(v) )
+        return;
+
+    window = window > ple_window_max / 2 ? ple_window_max : window * 2;
+    v->arch.hvm.vmx.ple_window = window;
+    __vmwrite(PLE_WINDOW, window);
+}
+
+void vmx_ple_window_reset(struct vcpu *v)
+{
+    v->arch.hvm.vmx.ple_window = ple_window;
+}
+
 void vmx_do_resume(void)
 {
     struct vcpu *v = current;
@@ -1905,6 +1963,10 @@ void vmx_do_resume(void)
 
     hvm_do_resume(v);
 
+    if ( cpu_has_vmx_ple && ple_window_max > ple_window &&
+         !nestedhvm_vcpu_in_guestmode(v) )
+        __vmwrite(PLE_WINDOW, v->arch.hvm.vmx.ple_window);
+
     /* Sync host CR4 in case its value has changed. */
     __vmread(HOST_CR4, &host_cr4);
     if ( host_cr4 != read_cr4() )
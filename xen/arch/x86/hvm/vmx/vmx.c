@@ -150,9 +150,15 @@ static void vmx_pi_switch_to(struct vcpu *v)
 {
     struct pi_desc *pi_desc = &v->arch.hvm.vmx.pi_desc;
     unsigned int dest = cpu_physical_id(v->processor);
+    uint32_t ndst = x2apic_enabled ? dest
+                                   : MASK_INSR(dest, PI_xAPIC_NDST_MASK);
 
-    write_atomic(&pi_desc->ndst,
-                 x2apic_enabled ? dest : MASK_INSR(dest, PI_xAPIC_NDST_MASK));
+    /*
+     * Most switches are back onto the same pCPU; avoid dirtying the
+     * descriptor's cache line (which the IOMMU posts into) needlessly.
+     */
+    if ( pi_desc->ndst != ndst )
+        write_atomic(&pi_desc->ndst, ndst);
 
     pi_clear_sn(pi_desc);
 }
@@ -884,6 +890,7 @@ static void vmx_ctxt_switch_from(struct vcpu *v)
 static void vmx_ctxt_switch_to(struct vcpu *v)
 {
     vmx_restore_guest_msrs(v);
+    vmx_ple_window_reset(v);
     vmx_restore_dr(v);
 
     if ( v->domain->arch.hvm.pi_ops.flags & PI_CSW_TO )
@@ -3647,6 +3654,71 @@ static int vmx_handle_apic_write(void)
     return vlapic_apicv_write(current, exit_qualification & 0xfff);
 }
 
+/*
+ * Fast path for CPUID and policy backed RDMSR exits.  Outside of nested
+ * virtualisation, real mode emulation and altp2m, and without a monitor
+ * subscribed, these need nothing but the domain's precomputed CPUID/MSR
+ * policy and the vCPU's MSR state.  Being instruction intercepts they
+ * can't happen during event delivery, so there's nothing to re-inject.
+ *
+ * Returns false if the exit needs to go down the regular path.
+ */
+static bool vmx_fast_exit(struct vcpu *v, struct cpu_user_regs *regs,
+                          unsigned long exit_reason)
+{
+    const struct domain *d = v->domain;
+    struct cpuid_leaf res;
+    uint64_t msr_content;
+
+    if ( nestedhvm_enabled(d) || altp2m_active(d) ||
+         v->arch.hvm.vmx.vmx_realmode )
+        return false;
+
+    switch ( exit_reason )
+    {
+    case EXIT_REASON_CPUID:
+        if ( d->arch.monitor.cpuid_enabled ||
+             v->arch.msrs->misc_features_enables.cpuid_faulting )
+            return false;
+
+        guest_cpuid(v, regs->eax, regs->ecx, &res);
+        HVMTRACE_6D(CPUID, regs->eax, regs->ecx, res.a, res.b, res.c, res.d);
+
+        regs->rax = res.a;
+        regs->rbx = res.b;
+        regs->rcx = res.c;
+        regs->rdx = res.d;
+        break;
+
+    case EXIT_REASON_MSR_READ:
+        switch ( guest_rdmsr(v, regs->ecx, &msr_content) )
+        {
+        case X86EMUL_OKAY:
+            break;
+
+        case X86EMUL_EXCEPTION:
+            hvm_inject_hw_exception(TRAP_gp_fault, 0);
+            return true;
+
+        default:
+            return false;
+        }
+
+        HVMTRACE_3D(MSR_READ, regs->ecx,
+                    (uint32_t)msr_content, (uint32_t)(msr_content >> 32));
+        msr_split(regs, msr_content);
+        break;
+
+    default:
+        return false;
+    }
+
+    hvm_maybe_deassert_evtchn_irq();
+    update_guest_eip(); /* Safe: CPUID / RDMSR */
+
+    return true;
+}
+
 void vmx_vmexit_handler(struct cpu_user_regs *regs)
 {
     unsigned long exit_qualification, exit_reason, idtv_info, intr_info = 0;
@@ -3654,6 +3726,8 @@ void vmx_vmexit_handler(struct cpu_user_regs *regs)
     struct vcpu *v = current;
     struct domain *currd = v->domain;
 
+    write_atomic(&v->arch.hvm.in_guest, false);
+
     __vmread(GUEST_RIP,    &regs->rip);
     __vmread(GUEST_RSP,    &regs->rsp);
     __vmread(GUEST_RFLAGS, &regs->rflags);
@@ -3715,6 +3789,11 @@ void vmx_vmexit_handler(struct cpu_user_regs *regs)
     /* Now enable interrupts so it's safe to take locks. */
     local_irq_enable();
 
+    if ( (exit_reason == EXIT_REASON_CPUID ||
+          exit_reason == EXIT_REASON_MSR_READ) &&
+         vmx_fast_exit(v, regs, exit_reason) )
+        goto out;
+
     /*
      * If the guest has the ability to switch EPTP without an exit,
      * figure out whether it has done so and update the altp2m data.
@@ -3730,12 +3809,20 @@ void vmx_vmexit_handler(struct cpu_user_regs *regs)
             __vmread(EPTP_INDEX, &idx);
         else
         {
+            const struct p2m_domain *ap2m = p2m_get_altp2m(v);
             unsigned long eptp;
 
             __vmread(EPT_POINTER, &eptp);
 
-            if ( (idx = p2m_find_altp2m_by_eptp(v->domain, eptp)) ==
-                 INVALID_ALTP2M )
+            /*
+             * Most exits happen without the guest having switched views
+             * since the last one, so check the current view before searching
+             * the list under the domain wide altp2m list lock.
+             */
+            if ( ap2m && eptp == ap2m->ept.eptp )
+                idx = vcpu_altp2m(v).p2midx;
+            else if ( (idx = p2m_find_altp2m_by_eptp(v->domain, eptp)) ==
+                      INVALID_ALTP2M )
             {
                 gdprintk(XENLOG_ERR, "EPTP not found in alternate p2m list\n");
                 domain_crash(v->domain);
@@ -4233,7 +4320,8 @@ void vmx_vmexit_handler(struct cpu_user_regs *regs)
 
     case EXIT_REASON_PAUSE_INSTRUCTION:
         perfc_incr(pauseloop_exits);
-        do_sched_op(SCHEDOP_yield, guest_handle_from_ptr(NULL, void));
+        vmx_ple_window_grow(v);
+        vcpu_yield_to_preempted();
         break;
 
     case EXIT_REASON_XSETBV:
@@ -4380,9 +4468,16 @@ bool vmx_vmenter_helper(const struct cpu_user_regs *regs)
      if ( nestedhvm_vcpu_in_guestmode(curr) && vcpu_nestedhvm(curr).stale_np2m )
          return false;
 
+    write_atomic(&curr->arch.hvm.in_guest, true);
+    smp_mb(); /* Set in_guest /then/ look at the ASID generation. */
+
     if ( curr->domain->arch.hvm.pi_ops.vcpu_block )
         vmx_pi_do_resume(curr);
 
+    if ( unlikely(curr->arch.hvm.vmx.pml_pending) &&
+         !nestedhvm_vcpu_in_guestmode(curr) )
+        vmx_vcpu_load_pml(curr);
+
     if ( !cpu_has_vmx_vpid )
         goto out;
     if ( nestedhvm_vcpu_in_guestmode(curr) )
@@ -980,6 +980,50 @@ static struct vmcs_host_to_guest {
     {HOST_SYSENTER_EIP, GUEST_SYSENTER_EIP},
 };
 
+/*
+ * With VMCS shadowing every individual get_vvmcs()/set_vvmcs() costs a
+ * VMPTRLD/VMCLEAR/VMPTRLD sequence.  Fields needed together on the
+ * virtual VM entry/exit paths are therefore accessed through these
+ * helpers, which load the virtual VMCS once for the whole set.
+ */
+static void vvmcs_read_bulk(const struct vcpu *v, unsigned int n,
+                            const u16 *field, u64 *value)
+{
+    unsigned int i;
+
+    if ( !cpu_has_vmx_vmcs_shadowing )
+    {
+        for ( i = 0; i < n; i++ )
+            value[i] = get_vvmcs_virtual(vcpu_nestedhvm(v).nv_vvmcx,
+                                         field[i]);
+        return;
+    }
+
+    virtual_vmcs_enter(v);
+    for ( i = 0; i < n; i++ )
+        __vmread(field[i], &value[i]);
+    virtual_vmcs_exit(v);
+}
+
+static void vvmcs_write_bulk(const struct vcpu *v, unsigned int n,
+                             const u16 *field, const u64 *value)
+{
+    unsigned int i;
+
+    if ( !cpu_has_vmx_vmcs_shadowing )
+    {
+        for ( i = 0; i < n; i++ )
+            set_vvmcs_virtual(vcpu_nestedhvm(v).nv_vvmcx, field[i],
+                              value[i]);
+        return;
+    }
+
+    virtual_vmcs_enter(v);
+    for ( i = 0; i < n; i++ )
+        __vmwrite(field[i], value[i]);
+    virtual_vmcs_exit(v);
+}
+
 static void vvmcs_to_shadow(const struct vcpu *v, unsigned int field)
 {
     __vmwrite(field, get_vvmcs(v, field));
@@ -1083,6 +1127,33 @@ static void load_shadow_guest_state(struct vcpu *v)
     u64 cr_gh_mask, cr_read_shadow;
     int rc;
 
+    enum {
+        ENTRY_CR0_READ_SHADOW,
+        ENTRY_CR4_READ_SHADOW,
+        ENTRY_CR0_GUEST_HOST_MASK,
+        ENTRY_CR4_GUEST_HOST_MASK,
+        ENTRY_GUEST_CR0,
+        ENTRY_GUEST_CR3,
+        ENTRY_GUEST_CR4,
+        ENTRY_GUEST_PAT,
+        ENTRY_GUEST_PERF_GLOBAL_CTRL,
+        ENTRY_CONTROLS,
+        ENTRY_NR
+    };
+    static const u16 entry_fields[ENTRY_NR] = {
+        [ENTRY_CR0_READ_SHADOW]        = CR0_READ_SHADOW,
+        [ENTRY_CR4_READ_SHADOW]        = CR4_READ_SHADOW,
+        [ENTRY_CR0_GUEST_HOST_MASK]    = CR0_GUEST_HOST_MASK,
+        [ENTRY_CR4_GUEST_HOST_MASK]    = CR4_GUEST_HOST_MASK,
+        [ENTRY_GUEST_CR0]              = GUEST_CR0,
+        [ENTRY_GUEST_CR3]              = GUEST_CR3,
+        [ENTRY_GUEST_CR4]              = GUEST_CR4,
+        [ENTRY_GUEST_PAT]              = GUEST_PAT,
+        [ENTRY_GUEST_PERF_GLOBAL_CTRL] = GUEST_PERF_GLOBAL_CTRL,
+        [ENTRY_CONTROLS]               = VM_ENTRY_CONTROLS,
+    };
+    u64 val[ENTRY_NR];
+
     static const u16 vmentry_fields[] = {
         VM_ENTRY_INTR_INFO,
         VM_ENTRY_EXCEPTION_ERROR_CODE,
@@ -1093,28 +1164,30 @@ static void load_shadow_guest_state(struct vcpu *v)
     vvmcs_to_shadow_bulk(v, ARRAY_SIZE(vmcs_gstate_field),
                          vmcs_gstate_field);
 
-    nvcpu->guest_cr[0] = get_vvmcs(v, CR0_READ_SHADOW);
-    nvcpu->guest_cr[4] = get_vvmcs(v, CR4_READ_SHADOW);
+    vvmcs_read_bulk(v, ENTRY_NR, entry_fields, val);
+
+    nvcpu->guest_cr[0] = val[ENTRY_CR0_READ_SHADOW];
+    nvcpu->guest_cr[4] = val[ENTRY_CR4_READ_SHADOW];
 
-    rc = hvm_set_cr4(get_vvmcs(v, GUEST_CR4), true);
+    rc = hvm_set_cr4(val[ENTRY_GUEST_CR4], true);
     if ( rc == X86EMUL_EXCEPTION )
         hvm_inject_hw_exception(TRAP_gp_fault, 0);
 
-    rc = hvm_set_cr0(get_vvmcs(v, GUEST_CR0), true);
+    rc = hvm_set_cr0(val[ENTRY_GUEST_CR0], true);
     if ( rc == X86EMUL_EXCEPTION )
         hvm_inject_hw_exception(TRAP_gp_fault, 0);
 
-    rc = hvm_set_cr3(get_vvmcs(v, GUEST_CR3), false, true);
+    rc = hvm_set_cr3(val[ENTRY_GUEST_CR3], false, true);
     if ( rc == X86EMUL_EXCEPTION )
         hvm_inject_hw_exception(TRAP_gp_fault, 0);
 
-    control = get_vvmcs(v, VM_ENTRY_CONTROLS);
+    control = val[ENTRY_CONTROLS];
     if ( control & VM_ENTRY_LOAD_GUEST_PAT )
-        hvm_set_guest_pat(v, get_vvmcs(v, GUEST_PAT));
+        hvm_set_guest_pat(v, val[ENTRY_GUEST_PAT]);
     if ( control & VM_ENTRY_LOAD_PERF_GLOBAL_CTRL )
     {
         rc = hvm_msr_write_intercept(MSR_CORE_PERF_GLOBAL_CTRL,
-                                     get_vvmcs(v, GUEST_PERF_GLOBAL_CTRL), false);
+                                     val[ENTRY_GUEST_PERF_GLOBAL_CTRL], false);
         if ( rc == X86EMUL_EXCEPTION )
             hvm_inject_hw_exception(TRAP_gp_fault, 0);
     }
@@ -1128,14 +1201,14 @@ static void load_shadow_guest_state(struct vcpu *v)
      * guest host mask to 0xffffffff in shadow VMCS (follow the host L1 VMCS),
      * then calculate the corresponding read shadow separately for CR0 and CR4.
      */
-    cr_gh_mask = get_vvmcs(v, CR0_GUEST_HOST_MASK);
-    cr_read_shadow = (get_vvmcs(v, GUEST_CR0) & ~cr_gh_mask) |
-                     (get_vvmcs(v, CR0_READ_SHADOW) & cr_gh_mask);
+    cr_gh_mask = val[ENTRY_CR0_GUEST_HOST_MASK];
+    cr_read_shadow = (val[ENTRY_GUEST_CR0] & ~cr_gh_mask) |
+                     (val[ENTRY_CR0_READ_SHADOW] & cr_gh_mask);
     __vmwrite(CR0_READ_SHADOW, cr_read_shadow);
 
-    cr_gh_mask = get_vvmcs(v, CR4_GUEST_HOST_MASK);
-    cr_read_shadow = (get_vvmcs(v, GUEST_CR4) & ~cr_gh_mask) |
-                     (get_vvmcs(v, CR4_READ_SHADOW) & cr_gh_mask);
+    cr_gh_mask = val[ENTRY_CR4_GUEST_HOST_MASK];
+    cr_read_shadow = (val[ENTRY_GUEST_CR4] & ~cr_gh_mask) |
+                     (val[ENTRY_CR4_READ_SHADOW] & cr_gh_mask);
     __vmwrite(CR4_READ_SHADOW, cr_read_shadow);
     /* Add the nested host mask to the one set by vmx_update_guest_cr. */
     v->arch.hvm.vmx.cr4_host_mask |= cr_gh_mask;
@@ -1237,9 +1310,16 @@ static void virtual_vmentry(struct cpu_user_regs *regs)
          !hvm_long_mode_active(v) )
         vvmcs_to_shadow_bulk(v, ARRAY_SIZE(gpdpte_fields), gpdpte_fields);
 
-    regs->rip = get_vvmcs(v, GUEST_RIP);
-    regs->rsp = get_vvmcs(v, GUEST_RSP);
-    regs->rflags = get_vvmcs(v, GUEST_RFLAGS);
+    {
+        static const u16 fields[] = { GUEST_RIP, GUEST_RSP };
+        u64 val[ARRAY_SIZE(fields)];
+
+        vvmcs_read_bulk(v, ARRAY_SIZE(fields), fields, val);
+        regs->rip = val[0];
+        regs->rsp = val[1];
+    }
+    /* GUEST_RFLAGS was copied into the shadow VMCS with the guest state. */
+    __vmread(GUEST_RFLAGS, &regs->rflags);
 
     /* updating host cr0 to sync TS bit */
     __vmwrite(HOST_CR0, v->arch.hvm.vmx.host_cr0);
@@ -1268,67 +1348,100 @@ static void virtual_vmentry(struct cpu_user_regs *regs)
 
 static void sync_vvmcs_guest_state(struct vcpu *v, struct cpu_user_regs *regs)
 {
+    u16 field[4];
+    u64 val[ARRAY_SIZE(field)];
+    unsigned int n = 0;
+
     /* copy shadow vmcs.gstate back to vvmcs.gstate */
     shadow_to_vvmcs_bulk(v, ARRAY_SIZE(vmcs_gstate_field),
                          vmcs_gstate_field);
     /* RIP, RSP are in user regs */
-    set_vvmcs(v, GUEST_RIP, regs->rip);
-    set_vvmcs(v, GUEST_RSP, regs->rsp);
+    field[n] = GUEST_RIP;
+    val[n++] = regs->rip;
+    field[n] = GUEST_RSP;
+    val[n++] = regs->rsp;
 
     /* CR3 sync if exec doesn't want cr3 load exiting: i.e. nested EPT */
-    if ( !(__n2_exec_control(v) & CPU_BASED_CR3_LOAD_EXITING) )
-        shadow_to_vvmcs(v, GUEST_CR3);
+    if ( !(__n2_exec_control(v) & CPU_BASED_CR3_LOAD_EXITING) &&
+         vmread_safe(GUEST_CR3, &val[n]) == 0 )
+        field[n++] = GUEST_CR3;
 
     if ( v->arch.hvm.vmx.cr4_host_mask != ~0UL )
+    {
         /* Only need to update nested GUEST_CR4 if not all bits are trapped. */
-        set_vvmcs(v, GUEST_CR4, v->arch.hvm.guest_cr[4]);
+        field[n] = GUEST_CR4;
+        val[n++] = v->arch.hvm.guest_cr[4];
+    }
+
+    vvmcs_write_bulk(v, n, field, val);
 }
 
 static void sync_vvmcs_ro(struct vcpu *v)
 {
     struct nestedvmx *nvmx = &vcpu_2_nvmx(v);
 
+    unsigned long reason;
+
     shadow_to_vvmcs_bulk(v, ARRAY_SIZE(vmcs_ro_field), vmcs_ro_field);
 
     /* Adjust exit_reason/exit_qualifciation for violation case */
-    if ( get_vvmcs(v, VM_EXIT_REASON) == EXIT_REASON_EPT_VIOLATION )
+    __vmread(VM_EXIT_REASON, &reason);
+    if ( reason == EXIT_REASON_EPT_VIOLATION )
     {
-        set_vvmcs(v, EXIT_QUALIFICATION, nvmx->ept.exit_qual);
-        set_vvmcs(v, VM_EXIT_REASON, nvmx->ept.exit_reason);
+        static const u16 fields[] = { EXIT_QUALIFICATION, VM_EXIT_REASON };
+        const u64 val[] = { nvmx->ept.exit_qual, nvmx->ept.exit_reason };
+
+        vvmcs_write_bulk(v, ARRAY_SIZE(fields), fields, val);
     }
 }
 
-static void load_vvmcs_host_state(struct vcpu *v)
+static void load_vvmcs_host_state(struct vcpu *v, u32 control)
 {
-    int i, rc;
-    u64 r;
-    u32 control;
+    unsigned int i;
+    int rc;
+
+    enum {
+        EXIT_HOST_CR0 = ARRAY_SIZE(vmcs_h2g_field),
+        EXIT_HOST_CR3,
+        EXIT_HOST_CR4,
+        EXIT_HOST_PAT,
+        EXIT_HOST_PERF_GLOBAL_CTRL,
+        EXIT_NR
+    };
+    u16 field[EXIT_NR];
+    u64 val[EXIT_NR];
 
     for ( i = 0; i < ARRAY_SIZE(vmcs_h2g_field); i++ )
-    {
-        r = get_vvmcs(v, vmcs_h2g_field[i].host_field);
-        __vmwrite(vmcs_h2g_field[i].guest_field, r);
-    }
+        field[i] = vmcs_h2g_field[i].host_field;
+    field[EXIT_HOST_CR0] = HOST_CR0;
+    field[EXIT_HOST_CR3] = HOST_CR3;
+    field[EXIT_HOST_CR4] = HOST_CR4;
+    field[EXIT_HOST_PAT] = HOST_PAT;
+    field[EXIT_HOST_PERF_GLOBAL_CTRL] = HOST_PERF_GLOBAL_CTRL;
 
-    rc = hvm_set_cr4(get_vvmcs(v, HOST_CR4), true);
+    vvmcs_read_bulk(v, EXIT_NR, field, val);
+
+    for ( i = 0; i < ARRAY_SIZE(vmcs_h2g_field); i++ )
+        __vmwrite(vmcs_h2g_field[i].guest_field, val[i]);
+
+    rc = hvm_set_cr4(val[EXIT_HOST_CR4], true);
     if ( rc == X86EMUL_EXCEPTION )
         hvm_inject_hw_exception(TRAP_gp_fault, 0);
 
-    rc = hvm_set_cr0(get_vvmcs(v, HOST_CR0), true);
+    rc = hvm_set_cr0(val[EXIT_HOST_CR0], true);
     if ( rc == X86EMUL_EXCEPTION )
         hvm_inject_hw_exception(TRAP_gp_fault, 0);
 
-    rc = hvm_set_cr3(get_vvmcs(v, HOST_CR3), false, true);
+    rc = hvm_set_cr3(val[EXIT_HOST_CR3], false, true);
     if ( rc == X86EMUL_EXCEPTION )
         hvm_inject_hw_exception(TRAP_gp_fault, 0);
 
-    control = get_vvmcs(v, VM_EXIT_CONTROLS);
     if ( control & VM_EXIT_LOAD_HOST_PAT )
-        hvm_set_guest_pat(v, get_vvmcs(v, HOST_PAT));
+        hvm_set_guest_pat(v, val[EXIT_HOST_PAT]);
     if ( control & VM_EXIT_LOAD_PERF_GLOBAL_CTRL )
     {
         rc = hvm_msr_write_intercept(MSR_CORE_PERF_GLOBAL_CTRL,
-                                     get_vvmcs(v, HOST_PERF_GLOBAL_CTRL), true);
+                                     val[EXIT_HOST_PERF_GLOBAL_CTRL], true);
         if ( rc == X86EMUL_EXCEPTION )
             hvm_inject_hw_exception(TRAP_gp_fault, 0);
     }
@@ -1341,10 +1454,9 @@ static void load_vvmcs_host_state(struct vcpu *v)
         __vmwrite(MSR_BITMAP, virt_to_maddr(v->arch.hvm.vmx.msr_bitmap));
 }
 
-static void sync_exception_state(struct vcpu *v)
+static void sync_exception_state(struct vcpu *v, uint32_t exit_ctrl)
 {
     struct nestedvmx *nvmx = &vcpu_2_nvmx(v);
-    uint32_t exit_ctrl = get_vvmcs(v, VM_EXIT_CONTROLS);
 
     if ( !(nvmx->intr.intr_info & INTR_INFO_VALID_MASK) )
         return;
@@ -1431,10 +1543,18 @@ static void virtual_vmexit(struct cpu_user_regs *regs)
     struct vcpu *v = current;
     struct nestedvcpu *nvcpu = &vcpu_nestedhvm(v);
     unsigned long lm_l1, lm_l2;
+    static const u16 fields[] = { HOST_RIP, HOST_RSP, VM_EXIT_CONTROLS };
+    u64 val[ARRAY_SIZE(fields)];
+    u32 exit_ctrl;
 
     sync_vvmcs_ro(v);
     sync_vvmcs_guest_state(v, regs);
-    sync_exception_state(v);
+
+    /* None of these are written by the exit path; fetch them once. */
+    vvmcs_read_bulk(v, ARRAY_SIZE(fields), fields, val);
+    exit_ctrl = val[2];
+
+    sync_exception_state(v, exit_ctrl);
 
     if ( nvmx_ept_enabled(v) && hvm_pae_enabled(v) &&
          !hvm_long_mode_active(v) )
@@ -1450,7 +1570,7 @@ static void virtual_vmexit(struct cpu_user_regs *regs)
     nvcpu->nv_vmswitch_in_progress = 1;
 
     lm_l2 = hvm_long_mode_active(v);
-    lm_l1 = !!(get_vvmcs(v, VM_EXIT_CONTROLS) & VM_EXIT_IA32E_MODE);
+    lm_l1 = !!(exit_ctrl & VM_EXIT_IA32E_MODE);
 
     if ( lm_l1 )
         v->arch.hvm.guest_efer |= EFER_LMA | EFER_LME;
@@ -1461,13 +1581,13 @@ static void virtual_vmexit(struct cpu_user_regs *regs)
     vmx_update_secondary_exec_control(v);
     vmx_update_exception_bitmap(v);
 
-    load_vvmcs_host_state(v);
+    load_vvmcs_host_state(v, exit_ctrl);
 
     if ( lm_l1 != lm_l2 )
         paging_update_paging_modes(v);
 
-    regs->rip = get_vvmcs(v, HOST_RIP);
-    regs->rsp = get_vvmcs(v, HOST_RSP);
+    regs->rip = val[0];
+    regs->rsp = val[1];
     /* VM exit clears all bits except bit 1 */
     regs->rflags = X86_EFLAGS_MBS;
 
@@ -181,6 +181,16 @@ static void pt_unlock(struct periodic_time *pt)
     pt_vcpu_unlock(pt->vcpu);
 }
 
+/*
+ * Flag that v may have a pending timer interrupt.  Must be called (with the
+ * timer locked) after the pending_intr_nr update or list insertion it
+ * advertises; see pt_update_irq().
+ */
+static void pt_set_pending(struct vcpu *v)
+{
+    write_atomic(&v->arch.hvm.tm_pending, true);
+}
+
 static void pt_process_missed_ticks(struct periodic_time *pt)
 {
     s_time_t missed_ticks, now = NOW();
@@ -253,6 +263,9 @@ void pt_restore_timer(struct vcpu *v)
             pt_process_missed_ticks(pt);
             set_timer(&pt->timer, pt->scheduled);
         }
+
+        if ( pt->pending_intr_nr )
+            pt_set_pending(v);
     }
 
     pt_thaw_time(v);
@@ -270,6 +283,7 @@ static void pt_timer_fn(void *data)
     pt->scheduled += pt->period;
     pt->do_not_freeze = 0;
 
+    pt_set_pending(pt->vcpu);
     vcpu_kick(pt->vcpu);
 
     pt_unlock(pt);
@@ -305,6 +319,9 @@ static void pt_irq_fired(struct vcpu *v, struct periodic_time *pt)
         }
     }
 
+    if ( pt->pending_intr_nr )
+        pt_set_pending(v);
+
     if ( mode_is(v->domain, delay_for_missed_ticks) &&
          (hvm_get_guest_time(v) < pt->last_plt_gtime) )
         hvm_set_guest_time(v, pt->last_plt_gtime);
@@ -318,6 +335,15 @@ int pt_update_irq(struct vcpu *v)
     int irq, pt_vector = -1;
     bool level;
 
+    /*
+     * This runs on every VM entry.  Avoid the domain-wide pt_migrate lock
+     * and the list walk unless a timer has flagged that it may have become
+     * pending since the last walk which found nothing.  The flag is cleared
+     * before the walk, so anything made pending concurrently re-sets it.
+     */
+    if ( !test_and_clear_bool(v->arch.hvm.tm_pending) )
+        return -1;
+
     pt_vcpu_lock(v);
 
     earliest_pt = NULL;
@@ -352,6 +378,9 @@ int pt_update_irq(struct vcpu *v)
         return -1;
     }
 
+    /* There may be further pending ticks: keep the next entry looking. */
+    pt_set_pending(v);
+
     earliest_pt->irq_issued = 1;
     irq = earliest_pt->irq;
     level = earliest_pt->level;
@@ -586,6 +615,8 @@ static void pt_adjust_vcpu(struct periodic_time *pt, struct vcpu *v)
         list_del(&pt->list);
         list_add(&pt->list, &v->arch.hvm.tm_list);
         migrate_timer(&pt->timer, v->processor);
+        if ( pt->pending_intr_nr )
+            pt_set_pending(v);
     }
     write_unlock(&pt->vcpu->domain->arch.hvm.pl_time->pt_migrate);
 }
@@ -628,6 +659,7 @@ static void pt_resume(struct periodic_time *pt)
     {
         pt->on_list = 1;
         list_add(&pt->list, &pt->vcpu->arch.hvm.tm_list);
+        pt_set_pending(pt->vcpu);
         vcpu_kick(pt->vcpu);
     }
     pt_unlock(pt);
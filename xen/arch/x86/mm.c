@@ -209,12 +209,15 @@ static int __init parse_mmio_relax(const char *s)
 }
 custom_param("mmio-relax", parse_mmio_relax);
 
+static unsigned long __initdata frametable_pages;
+
 static void __init init_frametable_chunk(void *start, void *end)
 {
     unsigned long s = (unsigned long)start;
     unsigned long e = (unsigned long)end;
     unsigned long step;
     mfn_t mfn;
+    void *p;
 
     ASSERT(!(s & ((1 << L2_PAGETABLE_SHIFT) - 1)));
     for ( ; s < e; s += step << PAGE_SHIFT )
@@ -231,9 +234,18 @@ static void __init init_frametable_chunk(void *start, void *end)
             step >>= PAGETABLE_ORDER;
         mfn = alloc_boot_pages(step, step);
         map_pages_to_xen(s, mfn, step, PAGE_HYPERVISOR);
+        frametable_pages += step;
     }
 
-    memset(start, 0, end - start);
+    /*
+     * On hosts with terabytes of RAM the frame table is tens of GB.  Zero it
+     * with non-temporal stores, which is considerably faster than memset()
+     * for that much memory and doesn't pointlessly cycle it all through the
+     * caches.
+     */
+    for ( p = start; p + PAGE_SIZE <= end; p += PAGE_SIZE )
+        clear_page(p);
+    memset(p, 0, end - p);
     memset(end, -1, s - e);
 }
 
@@ -261,6 +273,9 @@ void __init init_frametable(void)
                          : end_pg;
     init_frametable_chunk(pdx_to_page(sidx * PDX_GROUP_COUNT), top_pg);
     memset(end_pg, -1, (unsigned long)top_pg - (unsigned long)end_pg);
+
+    printk("Frame table: %luMB for %lu page frames\n",
+           frametable_pages >> (20 - PAGE_SHIFT), max_pdx);
 }
 
 #ifndef NDEBUG
@@ -536,11 +551,29 @@ void make_cr3(struct vcpu *v, mfn_t mfn)
 void write_ptbase(struct vcpu *v)
 {
     struct cpu_info *cpu_info = get_cpu_info();
+    unsigned int *live_pcids = &this_cpu(tlb_live_pcids);
+    unsigned int pcids = 1U << PCID_PV_PRIV;
     unsigned long new_cr4;
 
     new_cr4 = (is_pv_vcpu(v) && !is_idle_vcpu(v))
               ? pv_make_cr4(v) : mmu_cr4_features;
 
+    /*
+     * Work out which PCIDs this vCPU may populate the TLB with, including
+     * through later guest kernel/user toggles which don't come back here.
+     * switch_cr3_cr4() flushes all non-global entries, so only the PCIDs of
+     * the incoming vCPU remain live afterwards.  Until the flush has
+     * happened, flushes from interrupt context need to cover both sets.
+     */
+    if ( new_cr4 & X86_CR4_PCIDE )
+    {
+        pcids |= 1U << PCID_PV_USER;
+        if ( v->domain->arch.pv.xpti )
+            pcids |= (1U << (PCID_PV_PRIV | PCID_PV_XPTI)) |
+                     (1U << (PCID_PV_USER | PCID_PV_XPTI));
+    }
+    *live_pcids |= pcids;
+
     if ( is_pv_vcpu(v) && v->domain->arch.pv.xpti )
     {
         cpu_info->root_pgt_changed = true;
@@ -558,6 +591,8 @@ void write_ptbase(struct vcpu *v)
         switch_cr3_cr4(v->arch.cr3, new_cr4);
         cpu_info->pv_cr3 = 0;
     }
+
+    *live_pcids = pcids;
 }
 
 /*
@@ -3877,16 +3912,20 @@ long do_mmuext_op(
     return rc;
 }
 
+/* Number of requests do_mmu_update() copies from the guest at a time. */
+#define MMU_UPDATE_BATCH 16
+
 long do_mmu_update(
     XEN_GUEST_HANDLE_PARAM(mmu_update_t) ureqs,
     unsigned int count,
     XEN_GUEST_HANDLE_PARAM(uint) pdone,
     unsigned int foreigndom)
 {
-    struct mmu_update req;
+    struct mmu_update req, reqs[MMU_UPDATE_BATCH];
+    unsigned int nr_reqs = 0, req_idx = 0;
     void *va = NULL;
-    unsigned long gpfn, gmfn;
-    struct page_info *page;
+    unsigned long gpfn, gmfn, pt_gmfn = 0;
+    struct page_info *page, *pt_page = NULL;
     unsigned int cmd, i = 0, done = 0, pt_dom;
     struct vcpu *curr = current, *v = curr;
     struct domain *d = v->domain, *pt_owner = d, *pg_owner;
@@ -3957,11 +3996,26 @@ long do_mmu_update(
             break;
         }
 
-        if ( unlikely(__copy_from_guest(&req, ureqs, 1) != 0) )
+        /*
+         * Fetch requests in batches.  If part of a batch is inaccessible,
+         * fall back to single requests so that everything up to the
+         * faulting entry still gets processed.
+         */
+        if ( req_idx == nr_reqs )
         {
-            rc = -EFAULT;
-            break;
+            nr_reqs = min_t(unsigned int, count - i, MMU_UPDATE_BATCH);
+            if ( unlikely(__copy_from_guest(reqs, ureqs, nr_reqs) != 0) )
+            {
+                nr_reqs = 1;
+                if ( unlikely(__copy_from_guest(reqs, ureqs, 1) != 0) )
+                {
+                    rc = -EFAULT;
+                    break;
+                }
+            }
+            req_idx = 0;
         }
+        req = reqs[req_idx++];
 
         cmd = req.ptr & (sizeof(l1_pgentry_t)-1);
 
@@ -4000,21 +4054,41 @@ long do_mmu_update(
 
             req.ptr -= cmd;
             gmfn = req.ptr >> PAGE_SHIFT;
-            page = get_page_from_gfn(pt_owner, gmfn, &p2mt, P2M_ALLOC);
 
-            if ( unlikely(!page) || p2mt != p2m_ram_rw )
+            /*
+             * Guests typically batch updates to the same page table.  Keep
+             * the reference (and the mapping below) across such requests
+             * rather than re-doing the lookup for each entry.
+             */
+            if ( pt_page && gmfn == pt_gmfn )
+                page = pt_page;
+            else
             {
-                if ( page )
-                    put_page(page);
-                if ( p2m_is_paged(p2mt) )
+                if ( pt_page )
                 {
-                    p2m_mem_paging_populate(pt_owner, _gfn(gmfn));
-                    rc = -ENOENT;
+                    put_page(pt_page);
+                    pt_page = NULL;
                 }
-                else
-                    gdprintk(XENLOG_WARNING,
-                             "Could not get page for normal update\n");
-                break;
+
+                page = get_page_from_gfn(pt_owner, gmfn, &p2mt, P2M_ALLOC);
+
+                if ( unlikely(!page) || p2mt != p2m_ram_rw )
+                {
+                    if ( page )
+                        put_page(page);
+                    if ( p2m_is_paged(p2mt) )
+                    {
+                        p2m_mem_paging_populate(pt_owner, _gfn(gmfn));
+                        rc = -ENOENT;
+                    }
+                    else
+                        gdprintk(XENLOG_WARNING,
+                                 "Could not get page for normal update\n");
+                    break;
+                }
+
+                pt_page = page;
+                pt_gmfn = gmfn;
             }
 
             mfn = page_to_mfn(page);
@@ -4103,8 +4177,6 @@ long do_mmu_update(
                 put_page_type(page);
                 rc = 0;
             }
-
-            put_page(page);
         }
         break;
 
@@ -4159,6 +4231,9 @@ long do_mmu_update(
         guest_handle_add_offset(ureqs, 1);
     }
 
+    if ( pt_page )
+        put_page(pt_page);
+
     if ( rc == -ERESTART )
         rc = hypercall_create_continuation(
             __HYPERVISOR_mmu_update, "hihi",
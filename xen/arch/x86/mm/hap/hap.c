@@ -51,9 +51,9 @@
  * Create the domain's dv_dirty_vram struct on demand.
  * Create a dirty vram range on demand when some [begin_pfn:begin_pfn+nr] is
  * first encountered.
- * Collect the guest_dirty bitmask, a bit mask of the dirty vram pages, by
- * calling paging_log_dirty_range(), which interrogates each vram
- * page's p2m type looking for pages that have been made writable.
+ * Collect the guest_dirty bitmask, a bit mask of the dirty vram pages, from
+ * the frames which paging_mark_pfn_dirty() noted as written since the last
+ * call, and have paging_log_dirty_range() make just those read-only again.
  */
 
 int hap_track_dirty_vram(struct domain *d,
@@ -64,21 +64,30 @@ int hap_track_dirty_vram(struct domain *d,
     long rc = 0;
     struct sh_dirty_vram *dirty_vram;
     uint8_t *dirty_bitmap = NULL;
+    unsigned long *written = NULL;
 
     if ( nr_frames )
     {
         unsigned int size = DIV_ROUND_UP(nr_frames, BITS_PER_BYTE);
+        bool resync = false;
 
         if ( !paging_mode_log_dirty(d) )
         {
             rc = paging_log_dirty_enable(d, false);
             if ( rc )
                 goto out;
+
+            /*
+             * Disabling log-dirty made the whole p2m writable, so any range
+             * which was tracked before has to be write-protected afresh.
+             */
+            resync = true;
         }
 
         rc = -ENOMEM;
         dirty_bitmap = vzalloc(size);
-        if ( !dirty_bitmap )
+        written = xzalloc_array(unsigned long, BITS_TO_LONGS(nr_frames));
+        if ( !dirty_bitmap || !written )
             goto out;
 
         paging_lock(d);
@@ -96,7 +105,7 @@ int hap_track_dirty_vram(struct domain *d,
             d->arch.hvm.dirty_vram = dirty_vram;
         }
 
-        if ( begin_pfn != dirty_vram->begin_pfn ||
+        if ( resync || begin_pfn != dirty_vram->begin_pfn ||
              begin_pfn + nr_frames != dirty_vram->end_pfn )
         {
             unsigned long ostart = dirty_vram->begin_pfn;
@@ -104,6 +113,7 @@ int hap_track_dirty_vram(struct domain *d,
 
             dirty_vram->begin_pfn = begin_pfn;
             dirty_vram->end_pfn = begin_pfn + nr_frames;
+            SWAP(dirty_vram->hap_written, written);
 
             paging_unlock(d);
 
@@ -131,8 +141,14 @@ int hap_track_dirty_vram(struct domain *d,
             /* Flush dirty GFNs potentially cached by hardware. */
             p2m_flush_hardware_cached_dirty(d);
 
+            /* Take the frames written so far, and start recording afresh. */
+            paging_lock(d);
+            SWAP(dirty_vram->hap_written, written);
+            paging_unlock(d);
+
             /* get the bitmap */
-            paging_log_dirty_range(d, begin_pfn, nr_frames, dirty_bitmap);
+            paging_log_dirty_range(d, begin_pfn, nr_frames, written,
+                                   dirty_bitmap);
 
             domain_unpause(d);
         }
@@ -154,6 +170,7 @@ int hap_track_dirty_vram(struct domain *d,
              */
             begin_pfn = dirty_vram->begin_pfn;
             nr_frames = dirty_vram->end_pfn - dirty_vram->begin_pfn;
+            xfree(dirty_vram->hap_written);
             xfree(dirty_vram);
             d->arch.hvm.dirty_vram = NULL;
         }
@@ -166,6 +183,7 @@ int hap_track_dirty_vram(struct domain *d,
     }
 out:
     vfree(dirty_bitmap);
+    xfree(written);
 
     return rc;
 }
@@ -600,6 +618,8 @@ void hap_teardown(struct domain *d, bool *preempted)
 
     d->arch.paging.mode &= ~PG_log_dirty;
 
+    if ( d->arch.hvm.dirty_vram )
+        xfree(d->arch.hvm.dirty_vram->hap_written);
     XFREE(d->arch.hvm.dirty_vram);
 
 out:
@@ -710,25 +730,35 @@ static bool flush_tlb(bool (*flush_vcpu)(void *ctxt, struct vcpu *v),
     cpumask_clear(mask);
 
     /* Flush paging-mode soft state (e.g., va->gfn cache; PAE PDPE cache). */
+    for_each_vcpu ( d, v )
+        if ( flush_vcpu(ctxt, v) )
+            hvm_asid_flush_vcpu(v);
+
+    /*
+     * Tickle ASIDs /then/ check in_guest.  Pairs with the barrier in
+     * {vmx,svm}_vmenter_helper(): a vCPU either is seen in guest context
+     * here, or picks up its new ASID on its next VM entry.
+     */
+    smp_mb();
+
     for_each_vcpu ( d, v )
     {
         unsigned int cpu;
 
-        if ( !flush_vcpu(ctxt, v) )
+        if ( !flush_vcpu(ctxt, v) || !read_atomic(&v->arch.hvm.in_guest) )
             continue;
 
-        hvm_asid_flush_vcpu(v);
-
         cpu = read_atomic(&v->dirty_cpu);
         if ( cpu != this_cpu && is_vcpu_dirty_cpu(cpu) && v->is_running )
             __cpumask_set_cpu(cpu, mask);
     }
 
     /*
-     * Trigger a vmexit on all pCPUs with dirty vCPU state in order to force an
-     * ASID/VPID change and hence accomplish a guest TLB flush. Note that vCPUs
-     * not currently running will already be flushed when scheduled because of
-     * the ASID tickle done in the loop above.
+     * Trigger a vmexit on all pCPUs running the guest context of a vCPU to be
+     * flushed, in order to force an ASID/VPID change and hence accomplish a
+     * guest TLB flush.  vCPUs not currently in guest context (descheduled,
+     * or running in Xen) will be flushed on their next VM entry because of
+     * the ASID tickle done above.
      */
     on_selected_cpus(mask, dummy_flush, NULL, 0);
 
@@ -30,6 +30,7 @@
 #include <asm/p2m.h>
 #include <asm/altp2m.h>
 #include <asm/hvm/emulate.h>
+#include <asm/monitor.h>
 #include <asm/vm_event.h>
 
 #include "mm-locks.h"
@@ -67,9 +68,18 @@ static int _p2m_get_mem_access(struct p2m_domain *p2m, gfn_t gfn,
         return 0;
     }
 
-    gfn_lock(p2m, gfn, 0);
-    mfn = p2m->get_entry(p2m, gfn, &t, &a, 0, NULL, NULL);
-    gfn_unlock(p2m, gfn, 0);
+    /*
+     * A pure lookup: use the read lock so that vCPUs checking access rights
+     * (e.g. from hvm_monitor_check_p2m()) don't serialise on one another.
+     */
+    if ( likely(!p2m_locked_by_me(p2m)) )
+    {
+        gfn_read_lock(p2m, gfn, 0);
+        mfn = p2m->get_entry(p2m, gfn, &t, &a, 0, NULL, NULL);
+        gfn_read_unlock(p2m, gfn, 0);
+    }
+    else
+        mfn = p2m->get_entry(p2m, gfn, &t, &a, 0, NULL, NULL);
 
     if ( mfn_eq(mfn, INVALID_MFN) )
         return -ESRCH;
@@ -226,6 +236,22 @@ bool p2m_mem_access_check(paddr_t gpa, unsigned long gla,
         return true;
     }
 
+    /*
+     * Likewise for faults outside of the sub-page ranges the monitor asked
+     * for.  The extent of the access isn't known here, so it is emulated with
+     * the checks enabled, which see each access precisely and only raise an
+     * event if one of the ranges is touched after all.
+     */
+    if ( vm_event_check_ring(d->vm_event_monitor) &&
+         monitor_mem_access_filtered(d, gpa, 1) )
+    {
+        v->arch.vm_event->send_event = true;
+        hvm_emulate_one_vm_event(EMUL_KIND_NORMAL, TRAP_invalid_op, X86_EVENT_NO_EC);
+        v->arch.vm_event->send_event = false;
+
+        return true;
+    }
+
     *req_ptr = NULL;
     req = xzalloc(vm_event_request_t);
     if ( req )
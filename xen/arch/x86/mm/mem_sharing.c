@@ -1385,6 +1385,16 @@ int relinquish_shared_pages(struct domain *d)
     }
 
     p2m_unlock(p2m);
+
+    /* Hand any pooled fork pages back for relinquish_memory() to free. */
+    if ( !rc )
+    {
+        spin_lock(&d->page_alloc_lock);
+        page_list_splice(&msd->fork_pool, &d->page_list);
+        INIT_PAGE_LIST_HEAD(&msd->fork_pool);
+        spin_unlock(&d->page_alloc_lock);
+    }
+
     return rc;
 }
 
@@ -1529,7 +1539,14 @@ int mem_sharing_fork_page(struct domain *d, gfn_t gfn, bool unsharing)
     if ( !parent )
         return -ENOENT;
 
-    if ( !(page = alloc_domheap_page(d, 0)) )
+    /* Prefer a page left over from an earlier fork reset. */
+    spin_lock(&d->page_alloc_lock);
+    page = page_list_remove_head(&d->arch.hvm.mem_sharing.fork_pool);
+    if ( page )
+        page_list_add_tail(page, &d->page_list);
+    spin_unlock(&d->page_alloc_lock);
+
+    if ( !page && !(page = alloc_domheap_page(d, 0)) )
     {
         put_gfn(parent, gfn_l);
         return -ENOMEM;
@@ -1796,12 +1813,17 @@ static int fork(struct domain *cd, struct domain *d)
  * TODO: In case this hypercall would become useful on forks with larger memory
  * footprints the hypercall continuation should be implemented (or if this
  * feature needs to be become "stable").
+ *
+ * The pages dropped from the fork aren't freed, but moved to the fork's page
+ * pool, from where mem_sharing_fork_page() takes them again instead of going
+ * through the heap allocator for each page on every reset cycle.
  */
 static int mem_sharing_fork_reset(struct domain *d, struct domain *pd)
 {
     int rc;
     struct p2m_domain *p2m = p2m_get_hostp2m(d);
     struct page_info *page, *tmp;
+    struct page_list_head *pool = &d->arch.hvm.mem_sharing.fork_pool;
 
     domain_pause(d);
 
@@ -1832,8 +1854,11 @@ static int mem_sharing_fork_reset(struct domain *d, struct domain *pd)
                             p2m_invalid, p2m_access_rwx, -1);
         ASSERT(!rc);
 
-        put_page_alloc_ref(page);
+        /* Drop the reference taken by nominate_page(), keep the allocation. */
+        set_gpfn_from_mfn(mfn_x(mfn), INVALID_M2P_ENTRY);
         put_page_and_type(page);
+        page_list_del(page, &d->page_list);
+        page_list_add_tail(page, pool);
     }
     spin_unlock_recursive(&d->page_alloc_lock);
 
@@ -338,10 +338,19 @@ static inline void p2m_unlock(struct p2m_domain *p)
         mm_write_unlock(&p->lock);
 }
 
+static inline void p2m_read_lock(struct p2m_domain *p)
+{
+    if ( p2m_is_altp2m(p) )
+        mm_read_lock(altp2m, p->domain, &p->lock);
+    else
+        mm_read_lock(p2m, p->domain, &p->lock);
+}
+
 #define gfn_lock(p,g,o)       p2m_lock(p)
 #define gfn_unlock(p,g,o)     p2m_unlock(p)
-#define p2m_read_lock(p)      mm_read_lock(p2m, (p)->domain, &(p)->lock)
+#define gfn_read_lock(p,g,o)  p2m_read_lock(p)
 #define p2m_read_unlock(p)    mm_read_unlock(&(p)->lock)
+#define gfn_read_unlock(p,g,o) p2m_read_unlock(p)
 #define p2m_locked_by_me(p)   mm_write_locked_by_me(&(p)->lock)
 #define gfn_locked_by_me(p,g) p2m_locked_by_me(p)
 
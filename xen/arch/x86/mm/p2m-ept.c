@@ -658,6 +658,113 @@ bool_t ept_handle_misconfig(uint64_t gpa)
     return spurious ? (rc >= 0) : (rc > 0);
 }
 
+/*
+ * Whether replacing leaf entry @o by @n only grants additional access to
+ * the same frame(s), with the same memory type.
+ */
+static bool ept_entry_relaxes(const ept_entry_t *o, const ept_entry_t *n)
+{
+    return o->mfn == n->mfn && o->sp == n->sp &&
+           o->emt == n->emt && o->ipat == n->ipat &&
+           o->suppress_ve == n->suppress_ve &&
+           !o->recalc && !n->recalc &&
+           o->r <= n->r && o->w <= n->w && o->x <= n->x;
+}
+
+/*
+ * Try to replace the L1 table covering @gfn by a 2M superpage entry, if all
+ * of its entries map a suitably aligned contiguous range of RAM with the
+ * same attributes.  This restores superpage mappings which got split
+ * earlier (e.g. for mem_access or by a temporary type change) once the
+ * individual pages have been reverted one at a time.
+ */
+static void ept_try_coalesce(struct p2m_domain *p2m, unsigned long gfn)
+{
+    struct domain *d = p2m->domain;
+    unsigned long gfn_remainder = gfn;
+    ept_entry_t *table, *l1t, *l2e, first, old_entry, new_entry;
+    unsigned int i;
+    uint8_t ipat = 0;
+    int emt;
+
+    table = map_domain_page(pagetable_get_mfn(p2m_get_pagetable(p2m)));
+
+    for ( i = p2m->ept.wl; i > 1; i-- )
+        if ( ept_next_level(p2m, 1, &table, &gfn_remainder, i) !=
+             GUEST_TABLE_NORMAL_PAGE )
+            goto out;
+
+    l2e = table + (gfn_remainder >> EPT_TABLE_ORDER);
+    old_entry = atomic_read_ept_entry(l2e);
+    if ( !is_epte_present(&old_entry) || is_epte_superpage(&old_entry) ||
+         old_entry.recalc )
+        goto out;
+
+    l1t = map_domain_page(_mfn(old_entry.mfn));
+
+    first = l1t[0];
+    first.a = first.d = 0;
+    if ( first.sa_p2mt != p2m_ram_rw || first.recalc ||
+         (first.mfn & (EPT_PAGETABLE_ENTRIES - 1)) )
+    {
+        unmap_domain_page(l1t);
+        goto out;
+    }
+
+    /*
+     * Entries are commonly written in ascending order, so check the last
+     * one first to bail early while a range is still being rebuilt.
+     */
+    for ( i = 0; i < EPT_PAGETABLE_ENTRIES - 1; i++ )
+    {
+        unsigned int idx = i ?: EPT_PAGETABLE_ENTRIES - 1;
+        ept_entry_t e = l1t[idx];
+
+        e.a = e.d = 0;
+        e.mfn -= idx;
+        if ( e.epte != first.epte )
+            break;
+    }
+
+    unmap_domain_page(l1t);
+
+    if ( i < EPT_PAGETABLE_ENTRIES - 1 )
+        goto out;
+
+    emt = epte_get_entry_emt(d, gfn & ~(EPT_PAGETABLE_ENTRIES - 1UL),
+                             _mfn(first.mfn), PAGE_ORDER_2M, &ipat, false);
+    if ( emt != first.emt || ipat != first.ipat )
+        goto out;
+
+    new_entry = first;
+    new_entry.sp = 1;
+    ept_p2m_type_to_flags(p2m, &new_entry);
+
+    if ( atomic_write_ept_entry(p2m, l2e, new_entry, 1) )
+        goto out;
+
+    unmap_domain_page(table);
+
+    ept_sync_domain(p2m);
+
+    if ( p2m_is_hostp2m(p2m) && iommu_use_hap_pt(d) &&
+         iommu_iotlb_flush(d, _dfn(gfn & ~(EPT_PAGETABLE_ENTRIES - 1UL)),
+                           EPT_PAGETABLE_ENTRIES, IOMMU_FLUSHF_modified) )
+    {
+        /*
+         * The IOMMU may still be using the old table; better leak it than
+         * risk a use-after-free.
+         */
+        return;
+    }
+
+    ept_free_entry(p2m, &old_entry, 1);
+    return;
+
+ out:
+    unmap_domain_page(table);
+}
+
 /*
  * ept_set_entry() computes 'need_modify_vtd_table' for itself,
  * by observing whether any gfn->mfn translations are modified.
@@ -821,6 +928,21 @@ ept_set_entry(struct p2m_domain *p2m, gfn_t gfn_, mfn_t mfn,
         new_entry.suppress_ve = is_epte_valid(&old_entry) ?
                                     old_entry.suppress_ve : 1;
 
+    /*
+     * Changes only granting additional access (e.g. log-dirty or mem_access
+     * faults being resolved) don't need the EPT to be flushed on all of the
+     * domain's CPUs: A stale, more restrictive translation will cause an EPT
+     * violation, which invalidates cached translations for the faulting
+     * address, and which hvm_hap_nested_page_fault() then treats as
+     * spurious.  This doesn't hold for shadow EPT tables of nested guests or
+     * an IOMMU sharing the tables, neither of which re-fault.
+     */
+    if ( needs_sync && is_epte_present(&old_entry) &&
+         (!target || is_epte_superpage(&old_entry)) &&
+         ept_entry_relaxes(&old_entry, &new_entry) &&
+         !nestedhvm_enabled(d) && !iommu_use_hap_pt(d) )
+        needs_sync = 0;
+
     rc = atomic_write_ept_entry(p2m, ept_entry, new_entry, target);
     if ( unlikely(rc) )
         old_entry.epte = 0;
@@ -862,6 +984,9 @@ out:
     if ( is_epte_present(&old_entry) )
         ept_free_entry(p2m, &old_entry, target);
 
+    if ( rc == 0 && target == 0 && p2mt == p2m_ram_rw && hap_has_2mb )
+        ept_try_coalesce(p2m, gfn);
+
     if ( entry_written && p2m_is_hostp2m(p2m) )
     {
         ret = p2m_altp2m_propagate_change(d, _gfn(gfn), mfn, order, p2mt, p2ma);
@@ -1219,8 +1344,8 @@ static void ept_disable_pml(struct p2m_domain *p2m)
 
     vmx_domain_disable_pml(p2m->domain);
 
-    /* Disable EPT A/D bit */
-    ept_set_ad_sync(p2m->domain, false);
+    /* Disable EPT A/D bit, unless still needed for accessed tracking */
+    ept_set_ad_sync(p2m->domain, p2m->ept.track_accessed);
     vmx_domain_update_eptp(p2m->domain);
 }
 
@@ -1250,6 +1375,66 @@ static void ept_flush_pml_buffers(struct p2m_domain *p2m)
     vmx_domain_flush_pml_buffers(p2m->domain);
 }
 
+static int ept_track_accessed(struct p2m_domain *p2m, bool enable)
+{
+    struct domain *d = p2m->domain;
+
+    /* Domain must have been paused */
+    ASSERT(atomic_read(&d->pause_count));
+    ASSERT(p2m_is_hostp2m(p2m));
+
+    p2m_lock(p2m);
+    p2m->ept.track_accessed = enable;
+    /* PML needs the A/D bits regardless */
+    ept_set_ad_sync(d, enable || vmx_domain_pml_enabled(d));
+    vmx_domain_update_eptp(d);
+    p2m_unlock(p2m);
+
+    return 0;
+}
+
+/*
+ * Report, and optionally clear, the accessed bit of the leaf entry mapping
+ * @gfn.  @page_order is set to the order of the naturally aligned block the
+ * answer applies to: the superpage found, or the non-present range.
+ */
+static bool ept_test_and_clear_accessed(struct p2m_domain *p2m,
+                                        unsigned long gfn, bool clear,
+                                        unsigned int *page_order)
+{
+    ept_entry_t *table =
+        map_domain_page(pagetable_get_mfn(p2m_get_pagetable(p2m)));
+    unsigned long gfn_remainder = gfn;
+    ept_entry_t *ept_entry;
+    bool accessed = false;
+    int i;
+
+    ASSERT(p2m_locked_by_me(p2m));
+
+    for ( i = p2m->ept.wl; i > 0; i-- )
+    {
+        int ret = ept_next_level(p2m, 1, &table, &gfn_remainder, i);
+
+        if ( ret == GUEST_TABLE_MAP_FAILED || ret == GUEST_TABLE_POD_PAGE )
+            goto out;
+        if ( ret == GUEST_TABLE_SUPER_PAGE )
+            break;
+    }
+
+    ept_entry = table + (gfn_remainder >> (i * EPT_TABLE_ORDER));
+
+    /* The hardware may set the bit concurrently, hence the atomic update. */
+    if ( is_epte_present(ept_entry) )
+        accessed = clear ? test_and_clear_bit(EPTE_ACCESSED_SHIFT,
+                                              &ept_entry->epte)
+                         : ept_entry->a;
+
+ out:
+    *page_order = i * EPT_TABLE_ORDER;
+    unmap_domain_page(table);
+    return accessed;
+}
+
 int ept_p2m_init(struct p2m_domain *p2m)
 {
     struct ept_data *ept = &p2m->ept;
@@ -1278,6 +1463,12 @@ int ept_p2m_init(struct p2m_domain *p2m)
         p2m->flush_hardware_cached_dirty = ept_flush_pml_buffers;
     }
 
+    if ( cpu_has_vmx_ept_ad )
+    {
+        p2m->track_accessed = ept_track_accessed;
+        p2m->test_and_clear_accessed = ept_test_and_clear_accessed;
+    }
+
     if ( !zalloc_cpumask_var(&ept->invalidate) )
         return -ENOMEM;
 
@@ -1392,7 +1583,11 @@ void p2m_init_altp2m_ept(struct domain *d, unsigned int i)
     p2m->ept.ad = hostp2m->ept.ad;
     ept = &p2m->ept;
     ept->mfn = pagetable_get_pfn(p2m_get_pagetable(p2m));
-    d->arch.altp2m_eptp[array_index_nospec(i, MAX_EPTP)] = ept->eptp;
+
+    /* Pairs with p2m_switch_vcpu_altp2m_by_id()'s lockless check. */
+    smp_wmb();
+    write_atomic(&d->arch.altp2m_eptp[array_index_nospec(i, MAX_EPTP)],
+                 ept->eptp);
     d->arch.altp2m_visible_eptp[array_index_nospec(i, MAX_EPTP)] = ept->eptp;
 }
 
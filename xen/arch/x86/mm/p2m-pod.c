@@ -91,12 +91,12 @@ p2m_pod_cache_add(struct p2m_domain *p2m,
     ASSERT(pod_locked_by_me(p2m));
 
     /*
-     * Pages from domain_alloc and returned by the balloon driver aren't
-     * guaranteed to be zero; but by reclaiming zero pages, we implicitly
-     * promise to provide zero pages. So we scrub pages before using.
+     * Note that pages from domain_alloc and returned by the balloon driver
+     * aren't guaranteed to be zero.  They get cleared only once handed to
+     * the guest by p2m_pod_demand_populate(), such that filling the cache
+     * (in particular at domain creation) doesn't need to touch memory the
+     * guest may never populate.
      */
-    for ( i = 0; i < (1UL << order); i++ )
-        clear_domain_page(mfn_add(page_to_mfn(page), i));
 
     /* First, take all pages off the domain list */
     lock_page_alloc(p2m);
@@ -671,8 +671,8 @@ void p2m_pod_dump_data(struct domain *d)
 {
     struct p2m_domain *p2m = p2m_get_hostp2m(d);
 
-    printk("    PoD entries=%ld cachesize=%ld\n",
-           p2m->pod.entry_count, p2m->pod.count);
+    printk("    PoD entries=%ld cachesize=%ld reported=%lu\n",
+           p2m->pod.entry_count, p2m->pod.count, p2m->pod.reported);
 }
 
 
@@ -799,14 +799,7 @@ p2m_pod_zero_check_superpage(struct p2m_domain *p2m, gfn_t gfn)
     for ( i = 0; i < SUPERPAGE_PAGES; i++ )
     {
         map = map_domain_page(mfn_add(mfn0, i));
-
-        for ( j = 0; j < (PAGE_SIZE / sizeof(*map)); j++ )
-            if ( *(map+j) != 0 )
-            {
-                reset = 1;
-                break;
-            }
-
+        reset = !page_is_zero(map);
         unmap_domain_page(map);
 
         if ( reset )
@@ -948,12 +941,12 @@ p2m_pod_zero_check(struct p2m_domain *p2m, const gfn_t *gfns, unsigned int count
     /* Now check each page for real */
     for ( i = 0; i < count; i++ )
     {
+        bool zero;
+
         if ( !map[i] )
             continue;
 
-        for ( j = 0; j < (PAGE_SIZE / sizeof(*map[i])); j++ )
-            if ( *(map[i] + j) != 0 )
-                break;
+        zero = page_is_zero(map[i]);
 
         unmap_domain_page(map[i]);
 
@@ -963,7 +956,7 @@ p2m_pod_zero_check(struct p2m_domain *p2m, const gfn_t *gfns, unsigned int count
          * See comment in p2m_pod_zero_check_superpage() re gnttab
          * check timing.
          */
-        if ( j < (PAGE_SIZE / sizeof(*map[i])) )
+        if ( !zero )
         {
             /*
              * If the previous p2m_set_entry call succeeded, this one shouldn't
@@ -1118,6 +1111,33 @@ static void pod_eager_record(struct p2m_domain *p2m, gfn_t gfn,
     mrp->idx %= ARRAY_SIZE(mrp->list);
 }
 
+/*
+ * Allocate a fresh page for the PoD cache, on account of memory released by
+ * p2m_pod_report_free().  The allocation is subject to the domain's
+ * max_pages as usual, so a guest can only grow back to its allowance.
+ */
+static void pod_refill_reported(struct p2m_domain *p2m, unsigned int order)
+{
+    struct page_info *p;
+
+    ASSERT(pod_locked_by_me(p2m));
+
+    if ( order > PAGE_ORDER_2M || p2m->pod.reported < (1UL << order) )
+        order = PAGE_ORDER_4K;
+
+    p = alloc_domheap_pages(p2m->domain, order, 0);
+    if ( !p && order != PAGE_ORDER_4K )
+    {
+        order = PAGE_ORDER_4K;
+        p = alloc_domheap_pages(p2m->domain, order, 0);
+    }
+    if ( !p )
+        return;
+
+    p2m->pod.reported -= 1UL << order;
+    p2m_pod_cache_add(p2m, p, order);
+}
+
 bool
 p2m_pod_demand_populate(struct p2m_domain *p2m, gfn_t gfn,
                         unsigned int order)
@@ -1171,6 +1191,10 @@ p2m_pod_demand_populate(struct p2m_domain *p2m, gfn_t gfn,
     if ( p2m->pod.count == 0 )
         p2m_pod_emergency_sweep(p2m);
 
+    /* Take back memory the guest earlier reported as free. */
+    if ( p2m->pod.count == 0 && p2m->pod.reported )
+        pod_refill_reported(p2m, order);
+
     /* If the sweep failed, give up. */
     if ( p2m->pod.count == 0 )
         goto out_of_memory;
@@ -1189,6 +1213,13 @@ p2m_pod_demand_populate(struct p2m_domain *p2m, gfn_t gfn,
 
     BUG_ON((mfn_x(mfn) & ((1UL << order) - 1)) != 0);
 
+    /*
+     * By reclaiming zero pages, we implicitly promise to provide zero
+     * pages.  So we scrub pages before using.
+     */
+    for ( i = 0; i < (1UL << order); i++ )
+        clear_domain_page(mfn_add(mfn, i));
+
     if ( p2m_set_entry(p2m, gfn_aligned, mfn, order, p2m_ram_rw,
                        p2m->default_access) )
     {
@@ -1267,6 +1298,81 @@ remap_and_retry:
 }
 
 
+long p2m_pod_report_free(struct domain *d, gfn_t gfn, unsigned int order)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    unsigned int max_ref = 1;
+    unsigned long i;
+    long freed = 0;
+
+    if ( !paging_mode_translate(d) || is_iommu_enabled(d) )
+        return -EOPNOTSUPP;
+
+    /* Allow an extra refcount for one shadow pt mapping in shadowed domains */
+    if ( paging_mode_shadow(d) )
+        max_ref++;
+
+    gfn_lock(p2m, gfn, order);
+
+    for ( i = 0; i < (1UL << order); i++ )
+    {
+        gfn_t cur = gfn_add(gfn, i);
+        struct page_info *pg;
+        p2m_type_t t;
+        p2m_access_t a;
+        mfn_t mfn;
+
+        mfn = p2m->get_entry(p2m, cur, &t, &a, 0, NULL, NULL);
+        if ( t != p2m_ram_rw )
+            continue;
+
+        pg = mfn_to_page(mfn);
+        if ( is_special_page(pg) || page_get_owner(pg) != d ||
+             !(pg->count_info & PGC_allocated) ||
+             (pg->count_info & PGC_page_table) ||
+             (pg->count_info & PGC_count_mask) > max_ref )
+            continue;
+
+        if ( p2m_set_entry(p2m, cur, INVALID_MFN, PAGE_ORDER_4K,
+                           p2m_populate_on_demand, p2m->default_access) )
+            continue;
+
+        /* As in p2m_pod_zero_check(): only the allocation ref may remain. */
+        if ( (pg->count_info & PGC_count_mask) > 1 )
+        {
+            if ( p2m_set_entry(p2m, cur, mfn, PAGE_ORDER_4K, t, a) )
+            {
+                ASSERT_UNREACHABLE();
+                domain_crash(d);
+                break;
+            }
+            continue;
+        }
+
+        p2m_tlb_flush_sync(p2m);
+        set_gpfn_from_mfn(mfn_x(mfn), INVALID_M2P_ENTRY);
+
+        pod_lock(p2m);
+        p2m->pod.entry_count++;
+        p2m->pod.reported++;
+        pod_unlock(p2m);
+
+        /* Copied from common/memory.c:guest_remove_page() */
+        if ( unlikely(!get_page(pg, d)) )
+        {
+            ASSERT_UNREACHABLE();
+            continue;
+        }
+        put_page_alloc_ref(pg);
+        put_page(pg);
+        freed++;
+    }
+
+    gfn_unlock(p2m, gfn, order);
+
+    return freed;
+}
+
 int
 guest_physmap_mark_populate_on_demand(struct domain *d, unsigned long gfn_l,
                                       unsigned int order)
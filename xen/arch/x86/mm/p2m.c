@@ -35,6 +35,7 @@
 #include <asm/p2m.h>
 #include <asm/hvm/vmx/vmx.h> /* ept_p2m_init() */
 #include <asm/mem_sharing.h>
+#include <asm/hvm/emulate.h>
 #include <asm/hvm/nestedhvm.h>
 #include <asm/altp2m.h>
 #include <asm/vm_event.h>
@@ -458,6 +459,67 @@ void p2m_flush_hardware_cached_dirty(struct domain *d)
     }
 }
 
+int p2m_track_accessed(struct domain *d, bool enable)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+
+    if ( !p2m->track_accessed )
+        return -EOPNOTSUPP;
+
+    return p2m->track_accessed(p2m, enable);
+}
+
+/*
+ * Accessed bits are per p2m entry, so a superpage mapping reports (and
+ * clears) all of the gfns it covers at once.  Non-present gfns read as not
+ * accessed.  Any cleared bit requires the EPT TLBs to be flushed, or cached
+ * translations would never set it again.
+ */
+int p2m_get_accessed(struct domain *d, unsigned long gfn, unsigned int nr,
+                     bool clear, unsigned long *bitmap,
+                     unsigned int *nr_accessed)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    unsigned int i = 0, n, order;
+    bool cleared = false;
+
+    if ( !p2m->test_and_clear_accessed )
+        return -EOPNOTSUPP;
+
+    bitmap_zero(bitmap, nr);
+    *nr_accessed = 0;
+
+    p2m_lock(p2m);
+
+    if ( gfn > p2m->max_mapped_pfn )
+        nr = 0;
+    else if ( nr > p2m->max_mapped_pfn - gfn + 1 )
+        nr = p2m->max_mapped_pfn - gfn + 1;
+
+    while ( i < nr )
+    {
+        unsigned long cur = gfn + i;
+        bool accessed = p2m->test_and_clear_accessed(p2m, cur, clear, &order);
+
+        n = min_t(unsigned long, nr - i,
+                  (1UL << order) - (cur & ((1UL << order) - 1)));
+        if ( accessed )
+        {
+            bitmap_set(bitmap, i, n);
+            *nr_accessed += n;
+            cleared |= clear;
+        }
+        i += n;
+    }
+
+    if ( cleared )
+        p2m->tlb_flush(p2m);
+
+    p2m_unlock(p2m);
+
+    return 0;
+}
+
 /*
  * Force a synchronous P2M TLB flush if a deferred flush is pending.
  *
@@ -1036,6 +1098,21 @@ int p2m_change_type_one(struct domain *d, unsigned long gfn_l,
     BUG_ON(p2m_is_grant(ot) || p2m_is_grant(nt));
     BUG_ON(p2m_is_foreign(ot) || p2m_is_foreign(nt));
 
+    /*
+     * Refuse mismatching types under the read lock first, so that callers
+     * sweeping over ranges which are mostly of some other type don't take
+     * the write lock for every GFN.  The type is re-checked below.
+     */
+    if ( likely(!p2m_locked_by_me(p2m)) )
+    {
+        gfn_read_lock(p2m, gfn, 0);
+        p2m->get_entry(p2m, gfn, &pt, &a, 0, NULL, NULL);
+        gfn_read_unlock(p2m, gfn, 0);
+
+        if ( pt != ot )
+            return -EBUSY;
+    }
+
     gfn_lock(p2m, gfn, 0);
 
     mfn = p2m->get_entry(p2m, gfn, &pt, &a, 0, NULL, NULL);
@@ -1049,6 +1126,83 @@ int p2m_change_type_one(struct domain *d, unsigned long gfn_l,
     return rc;
 }
 
+/*
+ * Move the RAM page backing @gfn onto NUMA node @node.  The caller has to
+ * keep the guest paused.  Returns 1 if the page was moved, 0 if it was left
+ * alone (already on @node, not plain RAM, or in use by something other than
+ * the guest), or a negative errno value.
+ */
+int p2m_migrate_gfn(struct domain *d, gfn_t gfn, nodeid_t node)
+{
+    struct p2m_domain *p2m = p2m_get_hostp2m(d);
+    struct page_info *page, *new_page = NULL;
+    p2m_type_t t;
+    p2m_access_t a;
+    mfn_t mfn, new_mfn;
+    int rc = 0;
+
+    gfn_lock(p2m, gfn, 0);
+
+    mfn = p2m->get_entry(p2m, gfn, &t, &a, 0, NULL, NULL);
+    if ( t != p2m_ram_rw || !mfn_valid(mfn) || is_iomem_page(mfn) ||
+         phys_to_nid(mfn_to_maddr(mfn)) == node )
+        goto out;
+
+    page = mfn_to_page(mfn);
+    if ( !get_page(page, d) )
+        goto out;
+
+    /* Leave pages alone which anyone but the guest has a reference to. */
+    if ( (page->count_info & (PGC_count_mask | PGC_allocated)) !=
+         (2 | PGC_allocated) ||
+         (page->u.inuse.type_info & PGT_count_mask) != 0 )
+        goto out_put;
+
+    rc = -ENOMEM;
+    page_alloc_mm_pre_lock(d);
+    new_page = alloc_domheap_page(d, MEMF_node(node) | MEMF_exact_node);
+    if ( !new_page )
+        goto out_put;
+    if ( unlikely(!get_page(new_page, d)) )
+    {
+        gprintk(XENLOG_ERR,
+                "%pd: fresh page for GFN %"PRI_gfn" in unexpected state\n",
+                d, gfn_x(gfn));
+        domain_crash(d);
+        new_page = NULL;
+        goto out_put;
+    }
+    new_mfn = page_to_mfn(new_page);
+
+    copy_domain_page(new_mfn, mfn);
+
+    rc = p2m_set_entry(p2m, gfn, new_mfn, PAGE_ORDER_4K, t, a);
+    if ( rc )
+        goto out_put;
+
+    set_gpfn_from_mfn(mfn_x(new_mfn), gfn_x(gfn));
+    set_gpfn_from_mfn(mfn_x(mfn), INVALID_M2P_ENTRY);
+
+    /* Release the old page; its contents mustn't leak to the next owner. */
+    put_page_alloc_ref(page);
+    scrub_one_page(page);
+    rc = 1;
+
+ out_put:
+    put_page(page);
+ out:
+    gfn_unlock(p2m, gfn, 0);
+
+    if ( new_page )
+    {
+        if ( rc < 0 )
+            put_page_alloc_ref(new_page);
+        put_page(new_page);
+    }
+
+    return rc;
+}
+
 /* Modify the p2m type of [start, end_exclusive) from ot to nt. */
 static void change_type_range(struct p2m_domain *p2m,
                               unsigned long start, unsigned long end_exclusive,
@@ -1775,6 +1929,8 @@ unsigned long paging_gva_to_gfn(struct vcpu *v,
 {
     struct p2m_domain *hostp2m = p2m_get_hostp2m(v->domain);
     const struct paging_mode *hostmode = paging_get_hostmode(v);
+    uint32_t walk_pfec = *pfec;
+    unsigned long gfn;
 
     if ( is_hvm_vcpu(v) && paging_mode_hap(v->domain) && nestedhvm_is_n2(v) )
     {
@@ -1812,7 +1968,14 @@ unsigned long paging_gva_to_gfn(struct vcpu *v,
         return l1_gfn;
     }
 
-    return hostmode->gva_to_gfn(v, hostp2m, va, pfec);
+    if ( hvmemul_read_walk(v, va, walk_pfec, &gfn) )
+        return gfn;
+
+    gfn = hostmode->gva_to_gfn(v, hostp2m, va, pfec);
+    if ( gfn != gfn_x(INVALID_GFN) )
+        hvmemul_write_walk(v, va, walk_pfec, gfn);
+
+    return gfn;
 }
 
 /*
@@ -2009,10 +2172,22 @@ bool_t p2m_switch_vcpu_altp2m_by_id(struct vcpu *v, unsigned int idx)
     if ( idx >= MAX_ALTP2M )
         return rc;
 
-    altp2m_list_lock(d);
+    /*
+     * A vCPU switching its own view needn't serialise with its siblings:
+     * destroying a view or switching the whole domain both pause all other
+     * vCPUs first, so the view can't go away under our feet, and a view
+     * being initialised only becomes visible once p2m_init_altp2m_ept() has
+     * published its EPTP.
+     */
+    if ( v != current )
+        altp2m_list_lock(d);
 
-    if ( d->arch.altp2m_eptp[idx] != mfn_x(INVALID_MFN) )
+    if ( read_atomic(&d->arch.altp2m_eptp[array_index_nospec(idx,
+                                                              MAX_EPTP)]) !=
+         mfn_x(INVALID_MFN) )
     {
+        smp_rmb();
+
         if ( idx != vcpu_altp2m(v).p2midx )
         {
             atomic_dec(&p2m_get_altp2m(v)->active_vcpus);
@@ -2023,7 +2198,9 @@ bool_t p2m_switch_vcpu_altp2m_by_id(struct vcpu *v, unsigned int idx)
         rc = 1;
     }
 
-    altp2m_list_unlock(d);
+    if ( v != current )
+        altp2m_list_unlock(d);
+
     return rc;
 }
 
@@ -2754,19 +2931,19 @@ int p2m_get_suppress_ve(struct domain *d, gfn_t gfn, bool *suppress_ve,
     else
         p2m = host_p2m;
 
-    gfn_lock(host_p2m, gfn, 0);
+    gfn_read_lock(host_p2m, gfn, 0);
 
     if ( ap2m )
-        p2m_lock(ap2m);
+        p2m_read_lock(ap2m);
 
     mfn = p2m->get_entry(p2m, gfn, &t, &a, 0, NULL, suppress_ve);
     if ( !mfn_valid(mfn) )
         rc = -ESRCH;
 
     if ( ap2m )
-        p2m_unlock(ap2m);
+        p2m_read_unlock(ap2m);
 
-    gfn_unlock(host_p2m, gfn, 0);
+    gfn_read_unlock(host_p2m, gfn, 0);
 
     return rc;
 }
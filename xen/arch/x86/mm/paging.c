@@ -288,6 +288,17 @@ void paging_mark_pfn_dirty(struct domain *d, pfn_t pfn)
     /* Recursive: this is called from inside the shadow code */
     paging_lock_recursive(d);
 
+    /* Note writes to a framebuffer tracked by hap_track_dirty_vram(). */
+    if ( hap_enabled(d) && d->arch.hvm.dirty_vram )
+    {
+        struct sh_dirty_vram *dirty_vram = d->arch.hvm.dirty_vram;
+
+        if ( pfn_x(pfn) >= dirty_vram->begin_pfn &&
+             pfn_x(pfn) < dirty_vram->end_pfn )
+            __set_bit(pfn_x(pfn) - dirty_vram->begin_pfn,
+                      dirty_vram->hap_written);
+    }
+
     if ( unlikely(!mfn_valid(d->arch.paging.log_dirty.top)) ) 
     {
          d->arch.paging.log_dirty.top = paging_new_log_dirty_node(d);
@@ -398,6 +409,72 @@ int paging_mfn_is_dirty(struct domain *d, mfn_t gmfn)
 }
 
 
+/* State for reporting the log-dirty bitmap as a list of ranges. */
+struct log_dirty_ranges {
+    struct xen_domctl_shadow_op_range cur; /* Open range, if cur.nr != 0. */
+    unsigned int used;                     /* Entries used, including cur. */
+};
+
+static int log_dirty_ranges_close(struct xen_domctl_shadow_op *sc,
+                                  struct log_dirty_ranges *r)
+{
+    if ( !r->cur.nr )
+        return 0;
+
+    if ( copy_to_guest_offset(sc->dirty_ranges, r->used - 1, &r->cur, 1) )
+        return -EFAULT;
+
+    r->cur.nr = 0;
+
+    return 0;
+}
+
+/*
+ * Append the dirty pfns of one leaf of the bitmap, covering nr pfns from
+ * base, to the list of ranges, clearing them if requested.  If the list
+ * fills up, returns -ENOBUFS with *stop set to the first unreported pfn.
+ */
+static int log_dirty_leaf_ranges(struct xen_domctl_shadow_op *sc,
+                                 struct log_dirty_ranges *r,
+                                 unsigned long *l1, unsigned long base,
+                                 unsigned int nr, bool clean,
+                                 unsigned long *stop)
+{
+    unsigned int i = 0, j;
+    int rc;
+
+    while ( (i = find_next_bit(l1, nr, i)) < nr )
+    {
+        j = find_next_zero_bit(l1, nr, i);
+
+        if ( !r->cur.nr || base + i != r->cur.start + r->cur.nr )
+        {
+            rc = log_dirty_ranges_close(sc, r);
+            if ( rc )
+                return rc;
+
+            if ( r->used == sc->nr_ranges )
+            {
+                *stop = base + i;
+                return -ENOBUFS;
+            }
+
+            r->cur.start = base + i;
+            r->used++;
+        }
+
+        r->cur.nr += j - i;
+
+        if ( clean )
+            for ( ; i < j; i++ )
+                __clear_bit(i, l1);
+
+        i = j;
+    }
+
+    return 0;
+}
+
 /* Read a domain's log-dirty bitmap and stats.  If the operation is a CLEAN,
  * clear the bitmap and stats as well. */
 static int paging_log_dirty_op(struct domain *d,
@@ -409,6 +486,8 @@ static int paging_log_dirty_op(struct domain *d,
     mfn_t *l4 = NULL, *l3 = NULL, *l2 = NULL;
     unsigned long *l1 = NULL;
     int i4, i3, i2;
+    bool ranges = sc->mode & XEN_DOMCTL_SHADOW_LOGDIRTY_RANGES, full = false;
+    struct log_dirty_ranges r = {};
 
     if ( !resuming )
     {
@@ -455,7 +534,7 @@ static int paging_log_dirty_op(struct domain *d,
     sc->stats.fault_count = d->arch.paging.log_dirty.fault_count;
     sc->stats.dirty_count = d->arch.paging.log_dirty.dirty_count;
 
-    if ( guest_handle_is_null(sc->dirty_bitmap) )
+    if ( ranges || guest_handle_is_null(sc->dirty_bitmap) )
         /* caller may have wanted just to clean the state or access stats. */
         peek = 0;
 
@@ -471,16 +550,19 @@ static int paging_log_dirty_op(struct domain *d,
     i4 = d->arch.paging.preempt.log_dirty.i4;
     i3 = d->arch.paging.preempt.log_dirty.i3;
     pages = d->arch.paging.preempt.log_dirty.done;
+    r.used = d->arch.paging.preempt.log_dirty.ranges;
 
-    for ( ; (pages < sc->pages) && (i4 < LOGDIRTY_NODE_ENTRIES); i4++, i3 = 0 )
+    for ( ; (pages < sc->pages) && !full && (i4 < LOGDIRTY_NODE_ENTRIES);
+          i4++, i3 = 0 )
     {
         l3 = (l4 && mfn_valid(l4[i4])) ? map_domain_page(l4[i4]) : NULL;
-        for ( ; (pages < sc->pages) && (i3 < LOGDIRTY_NODE_ENTRIES); i3++ )
+        for ( ; (pages < sc->pages) && !full && (i3 < LOGDIRTY_NODE_ENTRIES);
+              i3++ )
         {
             l2 = ((l3 && mfn_valid(l3[i3])) ?
                   map_domain_page(l3[i3]) : NULL);
             for ( i2 = 0;
-                  (pages < sc->pages) && (i2 < LOGDIRTY_NODE_ENTRIES);
+                  (pages < sc->pages) && !full && (i2 < LOGDIRTY_NODE_ENTRIES);
                   i2++ )
             {
                 unsigned int bytes = PAGE_SIZE;
@@ -488,7 +570,25 @@ static int paging_log_dirty_op(struct domain *d,
                       map_domain_page(l2[i2]) : NULL);
                 if ( unlikely(((sc->pages - pages + 7) >> 3) < bytes) )
                     bytes = (unsigned int)((sc->pages - pages + 7) >> 3);
-                if ( likely(peek) )
+                if ( ranges && l1 )
+                {
+                    /* Only allocated leaves can have anything to report. */
+                    rv = log_dirty_leaf_ranges(
+                        sc, &r, l1, pages,
+                        min_t(unsigned long, bytes << 3, sc->pages - pages),
+                        clean, &pages);
+                    if ( rv == -ENOBUFS )
+                    {
+                        rv = 0;
+                        full = true;
+                        unmap_domain_page(l1);
+                        l1 = NULL;
+                        break;
+                    }
+                    if ( rv )
+                        goto out;
+                }
+                else if ( likely(peek) )
                 {
                     if ( (l1 ? copy_to_guest_offset(sc->dirty_bitmap,
                                                     pages >> 3, (uint8_t *)l1,
@@ -503,15 +603,22 @@ static int paging_log_dirty_op(struct domain *d,
                 pages += bytes << 3;
                 if ( l1 )
                 {
-                    if ( clean )
+                    if ( clean && !ranges )
                         clear_page(l1);
                     unmap_domain_page(l1);
+                    l1 = NULL;
                 }
             }
             if ( l2 )
                 unmap_domain_page(l2);
+            l2 = NULL;
 
-            if ( i3 < LOGDIRTY_NODE_ENTRIES - 1 && hypercall_preempt_check() )
+            /* Ranges are not carried over a preemption. */
+            if ( ranges && (rv = log_dirty_ranges_close(sc, &r)) != 0 )
+                goto out;
+
+            if ( !full && i3 < LOGDIRTY_NODE_ENTRIES - 1 &&
+                 hypercall_preempt_check() )
             {
                 d->arch.paging.preempt.log_dirty.i4 = i4;
                 d->arch.paging.preempt.log_dirty.i3 = i3 + 1;
@@ -521,8 +628,9 @@ static int paging_log_dirty_op(struct domain *d,
         }
         if ( l3 )
             unmap_domain_page(l3);
+        l3 = NULL;
 
-        if ( !rv && i4 < LOGDIRTY_NODE_ENTRIES - 1 &&
+        if ( !rv && !full && i4 < LOGDIRTY_NODE_ENTRIES - 1 &&
              hypercall_preempt_check() )
         {
             d->arch.paging.preempt.log_dirty.i4 = i4 + 1;
@@ -549,6 +657,7 @@ static int paging_log_dirty_op(struct domain *d,
         d->arch.paging.preempt.dom = current->domain;
         d->arch.paging.preempt.op = sc->op;
         d->arch.paging.preempt.log_dirty.done = pages;
+        d->arch.paging.preempt.log_dirty.ranges = r.used;
     }
 
     paging_unlock(d);
@@ -562,6 +671,8 @@ static int paging_log_dirty_op(struct domain *d,
 
     if ( pages < sc->pages )
         sc->pages = pages;
+    if ( ranges )
+        sc->nr_ranges = r.used;
     if ( clean )
     {
         /* We need to further call clean_dirty_bitmap() functions of specific
@@ -591,27 +702,35 @@ static int paging_log_dirty_op(struct domain *d,
 void paging_log_dirty_range(struct domain *d,
                            unsigned long begin_pfn,
                            unsigned long nr,
+                           const unsigned long *written,
                            uint8_t *dirty_bitmap)
 {
     struct p2m_domain *p2m = p2m_get_hostp2m(d);
-    int i;
-    unsigned long pfn;
+    unsigned long i;
 
     /*
      * Set l1e entries of P2M table to be read-only.
      *
-     * On first write, it page faults, its entry is changed to read-write,
-     * and on retry the write succeeds.
+     * On first write, it page faults (or is logged by PML), its entry is
+     * changed to read-write, the pfn is marked dirty, and on retry the write
+     * succeeds.
      *
-     * We populate dirty_bitmap by looking for entries that have been
-     * switched to read-write.
+     * Only the entries which were marked since the last call can have been
+     * switched to read-write, so only those need to be looked at: the cost
+     * scales with the number of frames written, not the size of the range.
      */
 
+    i = find_first_bit(written, nr);
+    if ( i >= nr )
+        return;
+
     p2m_lock(p2m);
 
-    for ( i = 0, pfn = begin_pfn; pfn < begin_pfn + nr; i++, pfn++ )
-        if ( !p2m_change_type_one(d, pfn, p2m_ram_rw, p2m_ram_logdirty) )
-            dirty_bitmap[i >> 3] |= (1 << (i & 7));
+    for ( ; i < nr; i = find_next_bit(written, nr, i + 1) )
+    {
+        p2m_change_type_one(d, begin_pfn + i, p2m_ram_rw, p2m_ram_logdirty);
+        dirty_bitmap[i >> 3] |= (1 << (i & 7));
+    }
 
     p2m_unlock(p2m);
 
@@ -740,7 +859,11 @@ int paging_domctl(struct domain *d, struct xen_domctl_shadow_op *sc,
 
     case XEN_DOMCTL_SHADOW_OP_CLEAN:
     case XEN_DOMCTL_SHADOW_OP_PEEK:
-        if ( sc->mode & ~XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL )
+        if ( sc->mode & ~(XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL |
+                          XEN_DOMCTL_SHADOW_LOGDIRTY_RANGES) )
+            return -EINVAL;
+        if ( (sc->mode & XEN_DOMCTL_SHADOW_LOGDIRTY_RANGES) &&
+             (!sc->nr_ranges || guest_handle_is_null(sc->dirty_ranges)) )
             return -EINVAL;
         return paging_log_dirty_op(d, sc, resuming);
     }
@@ -772,11 +895,11 @@ long paging_domctl_continuation(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
     ret = xsm_domctl(XSM_OTHER, d, op.cmd);
     if ( !ret )
     {
-        if ( domctl_lock_acquire() )
+        if ( domctl_lock_acquire(d) )
         {
             ret = paging_domctl(d, &op.u.shadow_op, u_domctl, 1);
 
-            domctl_lock_release();
+            domctl_lock_release(d);
         }
         else
             ret = -ERESTART;
@@ -37,6 +37,7 @@ int arch_monitor_init_domain(struct domain *d)
 void arch_monitor_cleanup_domain(struct domain *d)
 {
     xfree(d->arch.monitor.msr_bitmap);
+    xfree(d->arch.monitor.mem_access_filter);
 
     memset(&d->arch.monitor, 0, sizeof(d->arch.monitor));
     memset(&d->monitor, 0, sizeof(d->monitor));
@@ -140,6 +141,85 @@ bool monitored_msr_onchangeonly(const struct domain *d, u32 msr)
     return test_bit(msr + sizeof(struct monitor_msr_bitmap) * 8, bitmap);
 }
 
+/*
+ * Whether a mem_access violation by an access to [gpa, gpa + size) is to be
+ * resolved without sending an event, i.e. whether the page has filter ranges
+ * but the access touches none of them.
+ */
+bool monitor_mem_access_filtered(const struct domain *d, paddr_t gpa,
+                                 unsigned int size)
+{
+    const struct monitor_mem_access_filter *f = d->arch.monitor.mem_access_filter;
+    unsigned int i, nr = d->arch.monitor.nr_mem_access_filters;
+    bool page_filtered = false;
+
+    for ( i = 0; i < nr; i++ )
+    {
+        if ( PFN_DOWN(f[i].start) != PFN_DOWN(gpa) )
+            continue;
+
+        if ( gpa < f[i].end && gpa + size > f[i].start )
+            return false;
+
+        page_filtered = true;
+    }
+
+    return page_filtered;
+}
+
+static int monitor_mem_access_filter(struct domain *d, bool add,
+                                     paddr_t gpa, unsigned int size)
+{
+    struct monitor_mem_access_filter *f = d->arch.monitor.mem_access_filter;
+    unsigned int i, nr = d->arch.monitor.nr_mem_access_filters;
+    int rc = 0;
+
+    if ( add )
+    {
+        if ( !size || PFN_DOWN(gpa) != PFN_DOWN(gpa + size - 1) )
+            return -EINVAL;
+
+        if ( nr >= MONITOR_MEM_ACCESS_FILTERS )
+            return -ENOSPC;
+
+        if ( !f &&
+             !(f = xzalloc_array(struct monitor_mem_access_filter,
+                                 MONITOR_MEM_ACCESS_FILTERS)) )
+            return -ENOMEM;
+
+        domain_pause(d);
+        d->arch.monitor.mem_access_filter = f;
+        f[nr].start = gpa;
+        f[nr].end = gpa + size;
+        d->arch.monitor.nr_mem_access_filters = nr + 1;
+        domain_unpause(d);
+
+        return 0;
+    }
+
+    domain_pause(d);
+
+    if ( !size )
+        nr = 0;
+    else
+    {
+        for ( i = 0; i < nr; i++ )
+            if ( f[i].start == gpa && f[i].end == gpa + size )
+                break;
+
+        if ( i < nr )
+            f[i] = f[--nr];
+        else
+            rc = -ENOENT;
+    }
+
+    d->arch.monitor.nr_mem_access_filters = nr;
+
+    domain_unpause(d);
+
+    return rc;
+}
+
 int arch_monitor_domctl_event(struct domain *d,
                               struct xen_domctl_monitor_op *mop)
 {
@@ -242,6 +322,14 @@ int arch_monitor_domctl_event(struct domain *d,
         break;
     }
 
+    case XEN_DOMCTL_MONITOR_EVENT_MEM_ACCESS_FILTER:
+        if ( unlikely(mop->u.mem_access_filter.pad) )
+            return -EINVAL;
+
+        return monitor_mem_access_filter(d, requested_status,
+                                         mop->u.mem_access_filter.gpa,
+                                         mop->u.mem_access_filter.size);
+
     case XEN_DOMCTL_MONITOR_EVENT_INGUEST_PAGEFAULT:
     {
         bool old_status = ad->monitor.inguest_pagefault_disabled;
@@ -192,14 +192,19 @@ ret_t do_physdev_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         ret = -EINVAL;
         if ( eoi.irq >= currd->nr_pirqs )
             break;
-        spin_lock(&currd->event_lock);
+        /*
+         * No event_lock: vcpus EOI-ing different pirqs shouldn't serialise.
+         * pirq_guest_eoi() revalidates the binding under the desc lock, and
+         * a stale event channel only gets one of our own ports unmasked.
+         */
+        rcu_read_lock(&pirq_rcu_lock);
         pirq = pirq_info(currd, eoi.irq);
         if ( !pirq ) {
-            spin_unlock(&currd->event_lock);
+            rcu_read_unlock(&pirq_rcu_lock);
             break;
         }
         if ( currd->arch.auto_unmask )
-            evtchn_unmask(pirq->evtchn);
+            evtchn_unmask(read_atomic(&pirq->evtchn));
         if ( is_pv_domain(currd) || domain_pirq_to_irq(currd, eoi.irq) > 0 )
             pirq_guest_eoi(pirq);
         if ( is_hvm_domain(currd) &&
@@ -214,7 +219,7 @@ ret_t do_physdev_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
                     && hvm_irq->gsi_assert_count[gsi] )
                 send_guest_pirq(currd, pirq);
         }
-        spin_unlock(&currd->event_lock);
+        rcu_read_unlock(&pirq_rcu_lock);
         ret = 0;
         break;
     }
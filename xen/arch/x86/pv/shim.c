@@ -598,6 +598,12 @@ static long pv_shim_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
 
         evtchn_assign_vcpu(d, ipi.port, ipi.vcpu);
         evtchn_reserve(d, ipi.port);
+        /*
+         * IPIs never leave the guest, so let EVTCHNOP_send deliver them
+         * locally instead of bouncing every one through L0.  The L0 port
+         * stays bound so that port numbers remain in sync.
+         */
+        evtchn_from_port(d, ipi.port)->state = ECS_IPI;
         spin_unlock(&d->event_lock);
 
         if ( __copy_to_guest(arg, &ipi, 1) )
@@ -629,6 +635,9 @@ static long pv_shim_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
             consoled_guest_rx();
             rc = 0;
         }
+        else if ( port_is_valid(d, send.port) &&
+                  evtchn_from_port(d, send.port)->state == ECS_IPI )
+            rc = evtchn_send(d, send.port);
         else
             rc = xen_hypercall_event_channel_op(EVTCHNOP_send, &send);
 
@@ -760,6 +760,9 @@ static struct domain *__init create_dom0(const module_t *image,
     if ( iommu_enabled )
         dom0_cfg.flags |= XEN_DOMCTL_CDF_iommu;
 
+    if ( opt_trusted_hwdom )
+        dom0_cfg.arch.misc_flags |= XEN_X86_SPEC_TRUSTED;
+
     /* Create initial domain 0. */
     d = domain_create(get_initial_domain_id(), &dom0_cfg, !pv_shim);
     if ( IS_ERR(d) || (alloc_dom0_vcpu0(d) == NULL) )
@@ -75,6 +75,13 @@ struct cpuinfo_x86 cpu_data[NR_CPUS];
 u32 x86_cpu_to_apicid[NR_CPUS] __read_mostly =
 	{ [0 ... NR_CPUS-1] = BAD_APICID };
 
+/*
+ * Processors from the P6 and K8 families onwards don't need the long delays
+ * around INIT and STARTUP IPIs which the MP specification asks for, and which
+ * otherwise account for over 10ms per AP brought up.
+ */
+static bool __read_mostly fast_ap_wakeup;
+
 static int cpu_error;
 static enum cpu_state {
     CPU_STATE_DYING,    /* slave -> master: I am dying */
@@ -181,9 +188,9 @@ static void smp_callin(void)
     Dprintk("Waiting for CALLOUT.\n");
     for ( i = 0; cpu_state != CPU_STATE_CALLOUT; i++ )
     {
-        BUG_ON(i >= 200);
+        BUG_ON(i >= 20000);
         cpu_relax();
-        mdelay(10);
+        udelay(100);
     }
 
     /*
@@ -449,7 +456,8 @@ static int wakeup_secondary_cpu(int phys_apicid, unsigned long start_eip)
             send_status = apic_read(APIC_ICR) & APIC_ICR_BUSY;
         } while ( send_status && (timeout++ < 1000) );
 
-        mdelay(10);
+        if ( !fast_ap_wakeup )
+            mdelay(10);
 
         Dprintk("Deasserting INIT.\n");
 
@@ -494,7 +502,7 @@ static int wakeup_secondary_cpu(int phys_apicid, unsigned long start_eip)
         if ( !x2apic_enabled )
         {
             /* Give the other CPU some time to accept the IPI. */
-            udelay(300);
+            udelay(fast_ap_wakeup ? 10 : 300);
 
             Dprintk("Startup point 1.\n");
 
@@ -507,7 +515,7 @@ static int wakeup_secondary_cpu(int phys_apicid, unsigned long start_eip)
             } while ( send_status && (timeout++ < 1000) );
 
             /* Give the other CPU some time to accept the IPI. */
-            udelay(200);
+            udelay(fast_ap_wakeup ? 10 : 200);
         }
 
         /* Due to the Pentium erratum 3AP. */
@@ -580,11 +588,11 @@ static int do_boot_cpu(int apicid, int cpu)
         Dprintk("After Callout %d.\n", cpu);
 
         /* Wait 5s total for a response. */
-        for ( timeout = 0; timeout < 50000; timeout++ )
+        for ( timeout = 0; timeout < 500000; timeout++ )
         {
             if ( cpu_state != CPU_STATE_CALLOUT )
                 break;
-            udelay(100);
+            udelay(10);
         }
 
         if ( cpu_state == CPU_STATE_CALLIN )
@@ -1112,6 +1120,12 @@ void __init smp_prepare_cpus(void)
     initialize_cpu_data(0); /* Final full version of the data */
     print_cpu_info(0);
 
+    fast_ap_wakeup = ((boot_cpu_data.x86_vendor & X86_VENDOR_INTEL) &&
+                      boot_cpu_data.x86 >= 6) ||
+                     ((boot_cpu_data.x86_vendor &
+                       (X86_VENDOR_AMD | X86_VENDOR_HYGON)) &&
+                      boot_cpu_data.x86 >= 0xf);
+
     boot_cpu_physical_apicid = get_apic_id();
     x86_cpu_to_apicid[0] = boot_cpu_physical_apicid;
 
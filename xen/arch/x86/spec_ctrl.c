@@ -20,6 +20,7 @@
 #include <xen/init.h>
 #include <xen/lib.h>
 #include <xen/param.h>
+#include <xen/sched.h>
 #include <xen/warning.h>
 
 #include <asm/microcode.h>
@@ -53,6 +54,7 @@ bool __read_mostly opt_ssbd = false;
 int8_t __read_mostly opt_eager_fpu = -1;
 int8_t __read_mostly opt_l1d_flush = -1;
 bool __read_mostly opt_branch_harden = true;
+bool __initdata opt_trusted_hwdom;
 
 bool __initdata bsp_delay_spec_ctrl;
 uint8_t __read_mostly default_xen_spec_ctrl;
@@ -184,6 +186,8 @@ static int __init parse_spec_ctrl(const char *s)
             opt_branch_harden = val;
         else if ( (val = parse_boolean("srb-lock", s, ss)) >= 0 )
             opt_srb_lock = val;
+        else if ( (val = parse_boolean("trusted-hwdom", s, ss)) >= 0 )
+            opt_trusted_hwdom = val;
         else
             rc = -EINVAL;
 
@@ -1229,6 +1233,17 @@ void __init init_speculation_mitigations(void)
         wrmsrl(MSR_MCU_OPT_CTRL, default_xen_mcu_opt_ctrl);
 }
 
+/*
+ * Calculate the per-domain mitigation settings.  A domain which is trusted
+ * not to mount speculative attacks needs no VERW flush on exit to it, as
+ * there is nothing it would try to sample out of the microarchitectural
+ * buffers.  The IBPB and L1D flush decisions are made at their point of use.
+ */
+void spec_ctrl_init_domain(struct domain *d)
+{
+    d->arch.spec_ctrl_flags = d->arch.spec_trusted ? SCF_no_verw : 0;
+}
+
 static void __init __maybe_unused build_assertions(void)
 {
     /* The optimised assembly relies on this alias. */
@@ -76,6 +76,14 @@ static DEFINE_PER_CPU(struct cpu_time, cpu_time);
 #define EPOCH MILLISECS(1000)
 static struct timer calibration_timer;
 
+/*
+ * With the TSC as (reliable) platform timer all CPUs share one fixed
+ * (TSC, system time) stamp and scale, so there is nothing to calibrate.
+ * Leaving the stamps alone also keeps every guest's vcpu_time_info
+ * unchanged, so guests never see a hypervisor update of it.
+ */
+static bool __read_mostly tsc_stamps_fixed;
+
 /*
  * We simulate a 32-bit platform timer from the 16-bit PIT ch2 counter.
  * Otherwise overflow happens too quickly (~50ms) for us to guarantee that
@@ -1775,6 +1783,10 @@ static void time_calibration(void *unused)
         .semaphore = ATOMIC_INIT(0)
     };
 
+    /* Not re-armed: time_resume() does so once the stamps are unfixed. */
+    if ( tsc_stamps_fixed )
+        return;
+
     if ( clocksource_is_tsc() )
     {
         local_irq_disable();
@@ -2008,6 +2020,12 @@ static int __init verify_tsc_reliability(void)
              */
             time_calibration_rendezvous_fn = time_calibration_nop_rendezvous;
 
+            /*
+             * reset_percpu_time() gave all CPUs the same stamp, and with a
+             * constant TSC they share the same scale, so keep them as is.
+             */
+            tsc_stamps_fixed = boot_cpu_has(X86_FEATURE_CONSTANT_TSC);
+
             /* Finish platform timer switch. */
             try_platform_timer_tail(true);
 
@@ -2181,6 +2199,12 @@ int time_suspend(void)
         cmos_utc_offset += get_sec();
         kill_timer(&calibration_timer);
 
+        /*
+         * The per-CPU stamps get re-seeded on resume, so they will no longer
+         * be shared: calibrate (without rendezvous) from now on.
+         */
+        tsc_stamps_fixed = false;
+
         /* Sync platform timer stamps. */
         platform_time_calibration();
     }
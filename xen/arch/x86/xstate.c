@@ -57,9 +57,19 @@ static inline bool xsetbv(u32 index, u64 xfeatures)
 
 bool set_xcr0(u64 xfeatures)
 {
+    u64 *this_xcr0 = &this_cpu(xcr0);
+
+    /*
+     * XSETBV is serialising and far from cheap, yet the FPU save/restore
+     * paths switch to xcr0_accum and back around every XSAVE/XRSTOR, which
+     * in the common case is the very same value.
+     */
+    if ( *this_xcr0 == xfeatures )
+        return true;
+
     if ( !xsetbv(XCR_XFEATURE_ENABLED_MASK, xfeatures) )
         return false;
-    this_cpu(xcr0) = xfeatures;
+    *this_xcr0 = xfeatures;
     return true;
 }
 
@@ -615,9 +625,13 @@ void xstate_init(struct cpuinfo_x86 *c)
     feature_mask = (((u64)edx << 32) | eax) & XCNTXT_MASK;
 
     /*
-     * Set CR4_OSXSAVE and run "cpuid" to get xsave_cntxt_size.
+     * Set CR4_OSXSAVE and run "cpuid" to get xsave_cntxt_size.  The cached
+     * XCR0/XSS values can't be trusted here (e.g. when coming back from S3),
+     * so invalidate them to force the next writes to reach hardware.
      */
     set_in_cr4(X86_CR4_OSXSAVE);
+    this_cpu(xcr0) = 0;
+    this_cpu(xss) = ~0ULL;
     if ( !set_xcr0(feature_mask) )
         BUG();
 
@@ -27,6 +27,7 @@
 #include <xen/param.h>
 #include <xen/sched.h>
 #include <xen/time.h>
+#include <xen/vmap.h>
 #include <xsm/xsm.h>
 
 #include <public/argo.h>
@@ -127,6 +128,8 @@ struct argo_ring_info
     unsigned int tx_ptr;
     /* mapped ring pages protected by L3 */
     void **mfn_mapping;
+    /* contiguous mapping of all of the ring pages, if any, protected by L3 */
+    void *ring_va;
     /* list of mfns of guest ring, protected by L3 */
     mfn_t *mfns;
     /* list of struct pending_ent for this ring, protected by L3 */
@@ -221,9 +224,17 @@ struct argo_domain
  * Since holding R(L1) will block acquiring W(L1), it will ensure that
  * no domains pointers that argo is interested in become invalid while either
  * W(L1) or R(L1) are held.
+ *
+ * L1 is taken for reading on every argo operation, by every vCPU, whereas
+ * writers only show up on domain creation, destruction and soft reset.  It
+ * therefore is a per-CPU rwlock: a reader only marks its own CPU, keeping
+ * the send path from bouncing a global lock cache line between CPUs, at
+ * the price of a writer having to wait for every CPU's readers to drain.
  */
 
-static DEFINE_RWLOCK(L1_global_argo_rwlock); /* L1 */
+static DEFINE_PERCPU_RWLOCK_GLOBAL(argo_percpu_rwlock);
+static DEFINE_PERCPU_RWLOCK_RESOURCE(L1_global_argo_rwlock,
+                                     argo_percpu_rwlock); /* L1 */
 
 /*
  * == rings_L2 : The per-domain ring hash lock: d->argo->rings_L2_rwlock
@@ -281,14 +292,18 @@ static DEFINE_RWLOCK(L1_global_argo_rwlock); /* L1 */
  *
  * The LOCKING macros defined below here are for use at verification points.
  */
-#define LOCKING_Write_L1 (rw_is_write_locked(&L1_global_argo_rwlock))
+#define LOCKING_Write_L1 (percpu_rw_is_write_locked(&L1_global_argo_rwlock))
 /*
  * While LOCKING_Read_L1 will return true even if the lock is write-locked,
  * that's OK because everywhere that a Read lock is needed with these macros,
  * holding a Write lock there instead is OK too: we're checking that _at least_
  * the specified level of locks are held.
+ * A reader on the per-CPU fast path doesn't touch the underlying rwlock, so
+ * check this CPU's reader marker as well.
  */
-#define LOCKING_Read_L1 (rw_is_locked(&L1_global_argo_rwlock))
+#define LOCKING_Read_L1 \
+    (this_cpu(argo_percpu_rwlock) == &L1_global_argo_rwlock || \
+     rw_is_locked(&L1_global_argo_rwlock.rwlock))
 
 #define LOCKING_Write_rings_L2(d) \
     ((LOCKING_Read_L1 && rw_is_write_locked(&(d)->argo->rings_L2_rwlock)) || \
@@ -461,6 +476,12 @@ ring_unmap(const struct domain *d, struct argo_ring_info *ring_info)
 
     ASSERT(LOCKING_L3(d, ring_info));
 
+    if ( ring_info->ring_va )
+    {
+        vunmap(ring_info->ring_va);
+        ring_info->ring_va = NULL;
+    }
+
     if ( !ring_info->mfn_mapping )
         return;
 
@@ -486,14 +507,6 @@ ring_map_page(const struct domain *d, struct argo_ring_info *ring_info,
 {
     ASSERT(LOCKING_L3(d, ring_info));
 
-    /*
-     * FIXME: Investigate using vmap to create a single contiguous virtual
-     * address space mapping of the ring instead of using the array of single
-     * page mappings.
-     * Affects logic in memcpy_to_guest_ring, the mfn_mapping array data
-     * structure, and places where ring mappings are added or removed.
-     */
-
     if ( i >= ring_info->nmfns )
     {
         gprintk(XENLOG_ERR,
@@ -532,6 +545,27 @@ ring_map_page(const struct domain *d, struct argo_ring_info *ring_info,
     return 0;
 }
 
+/*
+ * Large messages are copied through a single contiguous mapping of the
+ * ring, set up on first use, rather than page by page.  The per-page
+ * mappings stay in use for the ring header and small messages, and as the
+ * fallback should the vmap area be exhausted.
+ */
+static void *
+ring_map_contig(const struct domain *d, struct argo_ring_info *ring_info)
+{
+    ASSERT(LOCKING_L3(d, ring_info));
+
+    if ( !ring_info->ring_va && ring_info->mfns && ring_info->nmfns > 1 )
+    {
+        ring_info->ring_va = vmap(ring_info->mfns, ring_info->nmfns);
+        argo_dprintk("vmapped %u ring pages to %p\n",
+                     ring_info->nmfns, ring_info->ring_va);
+    }
+
+    return ring_info->ring_va;
+}
+
 static void
 update_tx_ptr(const struct domain *d, struct argo_ring_info *ring_info,
               uint32_t tx_ptr)
@@ -561,6 +595,19 @@ memcpy_to_guest_ring(const struct domain *d, struct argo_ring_info *ring_info,
 
     ASSERT(LOCKING_L3(d, ring_info));
 
+    /* Copies not crossing a page boundary gain nothing from the vmap. */
+    if ( (offset & ~PAGE_MASK) + len > PAGE_SIZE &&
+         offset + len <= ((unsigned long)ring_info->nmfns << PAGE_SHIFT) &&
+         (dst = ring_map_contig(d, ring_info)) != NULL )
+    {
+        if ( src )
+            memcpy(dst + offset, src, len);
+        else if ( copy_from_guest(dst + offset, src_hnd, len) )
+            return -EFAULT;
+
+        return 0;
+    }
+
     offset &= ~PAGE_MASK;
 
     if ( len + offset > XEN_ARGO_MAX_RING_SIZE )
@@ -1549,11 +1596,11 @@ unregister_ring(struct domain *currd,
     ring_id.aport = unreg.aport;
     ring_id.domain_id = currd->domain_id;
 
-    read_lock(&L1_global_argo_rwlock);
+    percpu_read_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     if ( unlikely(!currd->argo) )
     {
-        read_unlock(&L1_global_argo_rwlock);
+        percpu_read_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
         return -ENODEV;
     }
 
@@ -1589,7 +1636,7 @@ unregister_ring(struct domain *currd,
  out:
     write_unlock(&currd->argo->rings_L2_rwlock);
 
-    read_unlock(&L1_global_argo_rwlock);
+    percpu_read_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     if ( dst_d )
         put_domain(dst_d);
@@ -1694,7 +1741,7 @@ register_ring(struct domain *currd,
         goto out;
     }
 
-    read_lock(&L1_global_argo_rwlock);
+    percpu_read_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     if ( !currd->argo )
     {
@@ -1841,7 +1888,7 @@ register_ring(struct domain *currd,
     write_unlock(&currd->argo->rings_L2_rwlock);
 
  out_unlock:
-    read_unlock(&L1_global_argo_rwlock);
+    percpu_read_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
  out:
     if ( dst_d )
@@ -1912,7 +1959,7 @@ notify(struct domain *currd,
 
     ASSERT(currd == current->domain);
 
-    read_lock(&L1_global_argo_rwlock);
+    percpu_read_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     if ( !currd->argo )
     {
@@ -1953,7 +2000,7 @@ notify(struct domain *currd,
     }
 
  out:
-    read_unlock(&L1_global_argo_rwlock);
+    percpu_read_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     return ret;
 }
@@ -2003,7 +2050,7 @@ sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
         return ret;
     }
 
-    read_lock(&L1_global_argo_rwlock);
+    percpu_read_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     if ( !src_d->argo )
     {
@@ -2062,7 +2109,7 @@ sendv(struct domain *src_d, xen_argo_addr_t *src_addr,
     read_unlock(&dst_d->argo->rings_L2_rwlock);
 
  out_unlock:
-    read_unlock(&L1_global_argo_rwlock);
+    percpu_read_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     if ( ret >= 0 )
         signal_domain(dst_d);
@@ -2313,11 +2360,11 @@ argo_init(struct domain *d)
 
     argo_domain_init(argo);
 
-    write_lock(&L1_global_argo_rwlock);
+    percpu_write_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     d->argo = argo;
 
-    write_unlock(&L1_global_argo_rwlock);
+    percpu_write_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     return 0;
 }
@@ -2327,7 +2374,7 @@ argo_destroy(struct domain *d)
 {
     BUG_ON(!d->is_dying);
 
-    write_lock(&L1_global_argo_rwlock);
+    percpu_write_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     argo_dprintk("destroy: domid %u d->argo=%p\n", d->domain_id, d->argo);
 
@@ -2339,13 +2386,13 @@ argo_destroy(struct domain *d)
         XFREE(d->argo);
     }
 
-    write_unlock(&L1_global_argo_rwlock);
+    percpu_write_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 }
 
 void
 argo_soft_reset(struct domain *d)
 {
-    write_lock(&L1_global_argo_rwlock);
+    percpu_write_lock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 
     argo_dprintk("soft reset d=%u d->argo=%p\n", d->domain_id, d->argo);
 
@@ -2363,5 +2410,5 @@ argo_soft_reset(struct domain *d)
         argo_domain_init(d->argo);
     }
 
-    write_unlock(&L1_global_argo_rwlock);
+    percpu_write_unlock(argo_percpu_rwlock, &L1_global_argo_rwlock);
 }
@@ -92,6 +92,7 @@ int compat_memory_op(unsigned int cmd, XEN_GUEST_HANDLE_PARAM(void) compat)
         case XENMEM_increase_reservation:
         case XENMEM_decrease_reservation:
         case XENMEM_populate_physmap:
+        case XENMEM_report_free_pages:
             if ( copy_from_guest(&cmp.rsrv, compat, 1) )
                 return start_extent;
 
@@ -479,8 +480,10 @@ int compat_memory_op(unsigned int cmd, XEN_GUEST_HANDLE_PARAM(void) compat)
         case XENMEM_increase_reservation:
         case XENMEM_decrease_reservation:
         case XENMEM_populate_physmap:
+        case XENMEM_report_free_pages:
             end_extent = split >= 0 ? rc : cmd >> MEMOP_EXTENT_SHIFT;
             if ( (op != XENMEM_decrease_reservation) &&
+                 (op != XENMEM_report_free_pages) &&
                  !guest_handle_is_null(nat.rsrv->extent_start) )
             {
                 for ( ; start_extent < end_extent; ++start_extent )
@@ -54,6 +54,10 @@ CHECK_evtchn_op;
 #undef xen_evtchn_status
 #undef xen_evtchn_unmask
 
+#define xen_evtchn_batch evtchn_batch
+CHECK_evtchn_batch;
+#undef xen_evtchn_batch
+
 #define xen_evtchn_expand_array evtchn_expand_array
 CHECK_evtchn_expand_array;
 #undef xen_evtchn_expand_array
@@ -33,6 +33,7 @@
 #include <xen/xenoprof.h>
 #include <xen/irq.h>
 #include <xen/argo.h>
+#include <xen/llc-coloring.h>
 #include <asm/debugger.h>
 #include <asm/p2m.h>
 #include <asm/processor.h>
@@ -55,14 +56,25 @@ unsigned int xen_processor_pmbits = XEN_PROCESSOR_PM_PX;
 bool_t opt_dom0_vcpus_pin;
 boolean_param("dom0_vcpus_pin", opt_dom0_vcpus_pin);
 
-/* Protect updates/reads (resp.) of domain_list and domain_hash. */
+/* Protect updates/reads (resp.) of domain_list and domain_table. */
 DEFINE_SPINLOCK(domlist_update_lock);
 DEFINE_RCU_READ_LOCK(domlist_read_lock);
 
-#define DOMAIN_HASH_SIZE 256
-#define DOMAIN_HASH(_id) ((int)(_id)&(DOMAIN_HASH_SIZE-1))
-static struct domain *domain_hash[DOMAIN_HASH_SIZE];
+/*
+ * Two-level table indexed by domid, for O(1) lock-free lookups.  Leaves are
+ * allocated on demand when the first domain using them is created, and are
+ * never freed, so at most a few hundred KiB are used by hosts cycling
+ * through the whole domid space.  System domains are not in the table.
+ */
+#define DOMAIN_TABLE_LEAF_SHIFT 8
+#define DOMAIN_TABLE_LEAF_SIZE  (1U << DOMAIN_TABLE_LEAF_SHIFT)
+#define DOMAIN_TABLE_SIZE \
+    DIV_ROUND_UP(DOMID_FIRST_RESERVED, DOMAIN_TABLE_LEAF_SIZE)
+#define DOMAIN_TABLE_IDX(id)    ((id) >> DOMAIN_TABLE_LEAF_SHIFT)
+#define DOMAIN_TABLE_OFF(id)    ((id) & (DOMAIN_TABLE_LEAF_SIZE - 1))
+static struct domain **domain_table[DOMAIN_TABLE_SIZE];
 struct domain *domain_list;
+unsigned int domlist_generation;
 
 struct domain *hardware_domain __read_mostly;
 
@@ -286,6 +298,8 @@ static void _domain_destroy(struct domain *d)
 
     argo_destroy(d);
 
+    domain_llc_coloring_free(d);
+
     rangeset_domain_destroy(d);
 
     free_cpumask_var(d->dirty_cpumask);
@@ -357,7 +371,7 @@ struct domain *domain_create(domid_t domid,
                              struct xen_domctl_createdomain *config,
                              bool is_priv)
 {
-    struct domain *d, **pd, *old_hwdom = NULL;
+    struct domain *d, **pd, **leaf = NULL, *old_hwdom = NULL;
     enum { INIT_watchdog = 1u<<1,
            INIT_evtchn = 1u<<3, INIT_gnttab = 1u<<4, INIT_arch = 1u<<5 };
     int err, init_status = 0;
@@ -415,6 +429,7 @@ struct domain *domain_create(domid_t domid,
     spin_lock_init_prof(d, domain_lock);
     spin_lock_init_prof(d, page_alloc_lock);
     spin_lock_init(&d->hypercall_deadlock_mutex);
+    rwlock_init(&d->domctl_lock);
     INIT_PAGE_LIST_HEAD(&d->page_list);
     INIT_PAGE_LIST_HEAD(&d->extra_page_list);
     INIT_PAGE_LIST_HEAD(&d->xenpage_list);
@@ -423,6 +438,8 @@ struct domain *domain_create(domid_t domid,
     d->node_affinity = NODE_MASK_ALL;
     d->auto_node_affinity = 1;
 
+    domain_llc_coloring_init(d);
+
     spin_lock_init(&d->shutdown_lock);
     d->shutdown_code = SHUTDOWN_CODE_INVALID;
 
@@ -500,6 +517,14 @@ struct domain *domain_create(domid_t domid,
         if ( (err = late_hwdom_init(d)) != 0 )
             goto fail;
 
+        if ( !domain_table[DOMAIN_TABLE_IDX(domid)] )
+        {
+            err = -ENOMEM;
+            leaf = xzalloc_array(struct domain *, DOMAIN_TABLE_LEAF_SIZE);
+            if ( !leaf )
+                goto fail;
+        }
+
         /*
          * Must not fail beyond this point, as our caller doesn't know whether
          * the domain has been entered into domain_list or not.
@@ -511,11 +536,20 @@ struct domain *domain_create(domid_t domid,
             if ( (*pd)->domain_id > d->domain_id )
                 break;
         d->next_in_list = *pd;
-        d->next_in_hashbucket = domain_hash[DOMAIN_HASH(domid)];
         rcu_assign_pointer(*pd, d);
-        rcu_assign_pointer(domain_hash[DOMAIN_HASH(domid)], d);
+        if ( !domain_table[DOMAIN_TABLE_IDX(domid)] )
+        {
+            rcu_assign_pointer(domain_table[DOMAIN_TABLE_IDX(domid)], leaf);
+            leaf = NULL;
+        }
+        rcu_assign_pointer(domain_table[DOMAIN_TABLE_IDX(domid)]
+                                       [DOMAIN_TABLE_OFF(domid)], d);
+        write_atomic(&domlist_generation, domlist_generation + 1);
         spin_unlock(&domlist_update_lock);
 
+        /* Lost a race with another domain creation allocating the leaf. */
+        xfree(leaf);
+
         memcpy(d->handle, config->handle, sizeof(d->handle));
     }
 
@@ -619,23 +653,28 @@ out:
 }
 
 
+/* Must be called with domlist_read_lock held. */
+static struct domain *domain_table_lookup(domid_t dom)
+{
+    struct domain **leaf;
+
+    if ( dom >= DOMID_FIRST_RESERVED )
+        return NULL;
+
+    leaf = rcu_dereference(domain_table[DOMAIN_TABLE_IDX(dom)]);
+
+    return leaf ? rcu_dereference(leaf[DOMAIN_TABLE_OFF(dom)]) : NULL;
+}
+
 struct domain *get_domain_by_id(domid_t dom)
 {
     struct domain *d;
 
     rcu_read_lock(&domlist_read_lock);
 
-    for ( d = rcu_dereference(domain_hash[DOMAIN_HASH(dom)]);
-          d != NULL;
-          d = rcu_dereference(d->next_in_hashbucket) )
-    {
-        if ( d->domain_id == dom )
-        {
-            if ( unlikely(!get_domain(d)) )
-                d = NULL;
-            break;
-        }
-    }
+    d = domain_table_lookup(dom);
+    if ( d && unlikely(!get_domain(d)) )
+        d = NULL;
 
     rcu_read_unlock(&domlist_read_lock);
 
@@ -645,20 +684,13 @@ struct domain *get_domain_by_id(domid_t dom)
 
 struct domain *rcu_lock_domain_by_id(domid_t dom)
 {
-    struct domain *d = NULL;
+    struct domain *d;
 
     rcu_read_lock(&domlist_read_lock);
 
-    for ( d = rcu_dereference(domain_hash[DOMAIN_HASH(dom)]);
-          d != NULL;
-          d = rcu_dereference(d->next_in_hashbucket) )
-    {
-        if ( d->domain_id == dom )
-        {
-            rcu_lock_domain(d);
-            break;
-        }
-    }
+    d = domain_table_lookup(dom);
+    if ( d )
+        rcu_lock_domain(d);
 
     rcu_read_unlock(&domlist_read_lock);
 
@@ -725,12 +757,14 @@ int domain_kill(struct domain *d)
             return domain_kill(d);
         d->is_dying = DOMDYING_dying;
         argo_destroy(d);
-        gnttab_release_mappings(d);
         vnuma_destroy(d->vnuma);
         domain_set_outstanding_pages(d, 0);
         /* fallthrough */
     case DOMDYING_dying:
         rc = evtchn_destroy(d);
+        if ( rc )
+            break;
+        rc = gnttab_release_mappings(d);
         if ( rc )
             break;
         rc = domain_relinquish_resources(d);
@@ -949,16 +983,15 @@ void domain_destroy(struct domain *d)
 
     TRACE_1D(TRC_DOM0_DOM_REM, d->domain_id);
 
-    /* Delete from task list and task hashtable. */
+    /* Delete from task list and domid table. */
     spin_lock(&domlist_update_lock);
     pd = &domain_list;
     while ( *pd != d ) 
         pd = &(*pd)->next_in_list;
     rcu_assign_pointer(*pd, d->next_in_list);
-    pd = &domain_hash[DOMAIN_HASH(d->domain_id)];
-    while ( *pd != d ) 
-        pd = &(*pd)->next_in_hashbucket;
-    rcu_assign_pointer(*pd, d->next_in_hashbucket);
+    rcu_assign_pointer(domain_table[DOMAIN_TABLE_IDX(d->domain_id)]
+                                   [DOMAIN_TABLE_OFF(d->domain_id)], NULL);
+    write_atomic(&domlist_generation, domlist_generation + 1);
     spin_unlock(&domlist_update_lock);
 
     /* Schedule RCU asynchronous completion of domain destroy. */
@@ -1050,13 +1083,10 @@ void domain_pause_nosync(struct domain *d)
 
 void domain_unpause(struct domain *d)
 {
-    struct vcpu *v;
-
     arch_domain_unpause(d);
 
     if ( atomic_dec_and_test(&d->pause_count) )
-        for_each_vcpu( d, v )
-            vcpu_wake(v);
+        domain_wake(d);
 }
 
 int __domain_pause_by_systemcontroller(struct domain *d,
@@ -1207,8 +1237,7 @@ int vcpu_reset(struct vcpu *v)
 
     set_bit(_VPF_down, &v->pause_flags);
 
-    clear_bit(v->vcpu_id, d->poll_mask);
-    v->poll_evtchn = 0;
+    evtchn_poll_release(v);
 
     v->fpu_initialised = 0;
     v->fpu_dirtied     = 0;
@@ -1580,6 +1609,8 @@ struct pirq *pirq_get_info(struct domain *d, int pirq)
     return info;
 }
 
+DEFINE_RCU_READ_LOCK(pirq_rcu_lock);
+
 static void _free_pirq_struct(struct rcu_head *head)
 {
     xfree(container_of(head, struct pirq, rcu_head));
@@ -18,6 +18,7 @@
 #include <xen/trace.h>
 #include <xen/console.h>
 #include <xen/iocap.h>
+#include <xen/llc-coloring.h>
 #include <xen/rcupdate.h>
 #include <xen/guest_access.h>
 #include <xen/bitmap.h>
@@ -32,7 +33,11 @@
 #include <public/domctl.h>
 #include <xsm/xsm.h>
 
-static DEFINE_SPINLOCK(domctl_lock);
+/*
+ * Operations without a target domain take this exclusively; all others
+ * only share it and serialise on the target's own domctl_lock.
+ */
+static DEFINE_RWLOCK(domctl_lock);
 
 static int nodemask_to_xenctl_bitmap(struct xenctl_bitmap *xenctl_nodemap,
                                      const nodemask_t *nodemask)
@@ -121,31 +126,74 @@ void getdomaininfo(struct domain *d, struct xen_domctl_getdomaininfo *info)
     arch_get_domain_info(d, info);
 }
 
-bool_t domctl_lock_acquire(void)
+bool domctl_lock_acquire(struct domain *d)
 {
-    /*
-     * Caller may try to pause its own VCPUs. We must prevent deadlock
-     * against other non-domctl routines which try to do the same.
-     */
-    if ( !spin_trylock(&current->domain->hypercall_deadlock_mutex) )
-        return 0;
+    struct domain *currd = current->domain;
+
+    if ( d ? !read_trylock(&domctl_lock) : !write_trylock(&domctl_lock) )
+        return false;
+
+    if ( d == currd )
+    {
+        /*
+         * Caller may try to pause its own VCPUs. We must prevent deadlock
+         * against other non-domctl routines which try to do the same.
+         */
+        if ( !spin_trylock(&currd->hypercall_deadlock_mutex) )
+            goto fail;
+
+        if ( write_trylock(&currd->domctl_lock) )
+            return true;
+
+        spin_unlock(&currd->hypercall_deadlock_mutex);
+        goto fail;
+    }
 
     /*
-     * Trylock here is paranoia if we have multiple privileged domains. Then
-     * we could have one domain trying to pause another which is spinning
-     * on domctl_lock -- results in deadlock.
+     * The caller holds its own domctl_lock shared for the duration, and the
+     * target's exclusively.  A domain which is being operated on hence can't
+     * at the same time operate on (and e.g. try to pause) its controller,
+     * which would deadlock if both sides were spinning for the other's VCPUs
+     * to deschedule.  Trylock throughout, as before, with the caller
+     * preempting on contention.
      */
-    if ( spin_trylock(&domctl_lock) )
-        return 1;
+    if ( !read_trylock(&currd->domctl_lock) )
+        goto fail;
 
-    spin_unlock(&current->domain->hypercall_deadlock_mutex);
-    return 0;
+    if ( !d || write_trylock(&d->domctl_lock) )
+        return true;
+
+    read_unlock(&currd->domctl_lock);
+
+ fail:
+    if ( d )
+        read_unlock(&domctl_lock);
+    else
+        write_unlock(&domctl_lock);
+
+    return false;
 }
 
-void domctl_lock_release(void)
+void domctl_lock_release(struct domain *d)
 {
-    spin_unlock(&domctl_lock);
-    spin_unlock(&current->domain->hypercall_deadlock_mutex);
+    struct domain *currd = current->domain;
+
+    if ( d == currd )
+    {
+        write_unlock(&currd->domctl_lock);
+        spin_unlock(&currd->hypercall_deadlock_mutex);
+    }
+    else
+    {
+        if ( d )
+            write_unlock(&d->domctl_lock);
+        read_unlock(&currd->domctl_lock);
+    }
+
+    if ( d )
+        read_unlock(&domctl_lock);
+    else
+        write_unlock(&domctl_lock);
 }
 
 void vnuma_destroy(struct vnuma_info *vnuma)
@@ -278,7 +326,7 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
     long ret = 0;
     bool_t copyback = 0;
     struct xen_domctl curop, *op = &curop;
-    struct domain *d;
+    struct domain *d, *ld;
 
     if ( copy_from_guest(op, u_domctl, 1) )
         return -EFAULT;
@@ -318,7 +366,14 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
     if ( ret )
         goto domctl_out_unlock_domonly;
 
-    if ( !domctl_lock_acquire() )
+    /*
+     * Operations on a real domain only serialise against others on the same
+     * domain.  Everything else (domain creation, operations on DOMID_IO or
+     * without any domain) remains globally serialised.
+     */
+    ld = d != dom_io ? d : NULL;
+
+    if ( !domctl_lock_acquire(ld) )
     {
         if ( d && d != dom_io )
             rcu_unlock_domain(d);
@@ -496,7 +551,7 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
         break;
 
     case XEN_DOMCTL_destroydomain:
-        domctl_lock_release();
+        domctl_lock_release(ld);
         domain_lock(d);
         ret = domain_kill(d);
         domain_unlock(d);
@@ -867,12 +922,18 @@ long do_domctl(XEN_GUEST_HANDLE_PARAM(xen_domctl_t) u_domctl)
             copyback = 1;
         break;
 
+#ifdef CONFIG_LLC_COLORING
+    case XEN_DOMCTL_set_llc_colors:
+        ret = domain_set_llc_colors(d, &op->u.set_llc_colors);
+        break;
+#endif
+
     default:
         ret = arch_do_domctl(op, d, u_domctl);
         break;
     }
 
-    domctl_lock_release();
+    domctl_lock_release(ld);
 
  domctl_out_unlock_domonly:
     if ( d && d != dom_io )
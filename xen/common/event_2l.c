@@ -26,9 +26,17 @@ static void evtchn_2l_set_pending(struct vcpu *v, struct evtchn *evtchn)
      * NB. On x86, the atomic bit operations also act as memory barriers.
      * There is therefore sufficiently strict ordering for this architecture --
      * others may require explicit memory barriers.
+     *
+     * A busy sender will mostly find the port still pending.  Check with a
+     * plain read first, so that such sends coalesce without pulling the
+     * (guest written) pending word's cache line over exclusively.  The
+     * barrier orders the check after the sender's prior writes, which the
+     * locked operation would otherwise have done.
      */
 
-    if ( guest_test_and_set_bit(d, port, &shared_info(d, evtchn_pending)) )
+    smp_mb();
+    if ( guest_test_bit(d, port, &shared_info(d, evtchn_pending)) ||
+         guest_test_and_set_bit(d, port, &shared_info(d, evtchn_pending)) )
         return;
 
     if ( !guest_test_bit(d, port, &shared_info(d, evtchn_mask)) &&
@@ -185,6 +185,33 @@ static void free_evtchn_bucket(struct domain *d, struct evtchn *bucket)
     xfree(bucket);
 }
 
+/*
+ * Make sure d->evtchn_port_map covers @nr ports.  The map grows at least
+ * geometrically, to keep the cost of copying it low.
+ */
+static int grow_port_map(struct domain *d, unsigned int nr)
+{
+    unsigned int bits = max(nr, d->evtchn_port_map_bits * 2);
+    unsigned long *map;
+
+    if ( nr <= d->evtchn_port_map_bits )
+        return 0;
+
+    bits = min(bits, max(nr, max_evtchns(d)));
+    map = xzalloc_array(unsigned long, BITS_TO_LONGS(bits));
+    if ( !map )
+        return -ENOMEM;
+
+    if ( d->evtchn_port_map )
+        bitmap_copy(map, d->evtchn_port_map, d->evtchn_port_map_bits);
+    xfree(d->evtchn_port_map);
+
+    d->evtchn_port_map = map;
+    d->evtchn_port_map_bits = bits;
+
+    return 0;
+}
+
 int evtchn_allocate_port(struct domain *d, evtchn_port_t port)
 {
     if ( port > d->max_evtchn_port || port >= max_evtchns(d) )
@@ -202,6 +229,11 @@ int evtchn_allocate_port(struct domain *d, evtchn_port_t port)
         struct evtchn *chn;
         struct evtchn **grp;
 
+        if ( grow_port_map(d, max_t(unsigned int,
+                                    d->valid_evtchns + EVTCHNS_PER_BUCKET,
+                                    port + 1)) )
+            return -ENOMEM;
+
         if ( !group_from_port(d, port) )
         {
             grp = xzalloc_array(struct evtchn *, BUCKETS_PER_GROUP);
@@ -225,6 +257,7 @@ int evtchn_allocate_port(struct domain *d, evtchn_port_t port)
         write_atomic(&d->valid_evtchns, d->valid_evtchns + EVTCHNS_PER_BUCKET);
     }
 
+    __set_bit(port, d->evtchn_port_map);
     write_atomic(&d->active_evtchns, d->active_evtchns + 1);
 
     return 0;
@@ -232,19 +265,32 @@ int evtchn_allocate_port(struct domain *d, evtchn_port_t port)
 
 static int get_free_port(struct domain *d)
 {
-    int            port;
+    unsigned int   port = 0;
 
     if ( d->is_dying )
         return -EINVAL;
 
-    for ( port = 0; port <= d->max_evtchn_port; port++ )
+    /*
+     * Consult the allocation bitmap rather than probing every port.  Ports
+     * found clear there may still be busy (i.e. not yet unlinked from a FIFO
+     * queue), in which case the search simply continues.  Once all valid
+     * ports are in use, a new bucket gets allocated for the next port.
+     */
+    for ( ; ; )
     {
-        int rc = evtchn_allocate_port(d, port);
+        int rc;
 
+        port = find_next_zero_bit(d->evtchn_port_map, d->valid_evtchns, port);
+        if ( port > d->max_evtchn_port )
+            break;
+
+        rc = evtchn_allocate_port(d, port);
         if ( rc == 0 )
             return port;
         else if ( rc != -EBUSY )
             return rc;
+
+        ++port;
     }
 
     return -ENOSPC;
@@ -258,7 +304,10 @@ static void check_free_port(struct domain *d, evtchn_port_t port)
 {
     if ( port_is_valid(d, port) &&
          evtchn_from_port(d, port)->state == ECS_FREE )
+    {
+        __clear_bit(port, d->evtchn_port_map);
         write_atomic(&d->active_evtchns, d->active_evtchns - 1);
+    }
 }
 
 void evtchn_free(struct domain *d, struct evtchn *chn)
@@ -273,6 +322,7 @@ void evtchn_free(struct domain *d, struct evtchn *chn)
         smp_wmb();
     }
     write_atomic(&d->active_evtchns, d->active_evtchns - 1);
+    __clear_bit(chn->port, d->evtchn_port_map);
 
     /* Reset binding to vcpu0 when the channel is freed. */
     chn->state          = ECS_FREE;
@@ -1198,6 +1248,50 @@ static long evtchn_set_priority(const struct evtchn_set_priority *set_priority)
     return ret;
 }
 
+/*
+ * Process the ports of an EVTCHNOP_batch request, starting from batch->done
+ * and updating it as ports get processed.
+ */
+static long evtchn_batch(struct evtchn_batch *batch,
+                         XEN_GUEST_HANDLE_PARAM(evtchn_port_t) ports)
+{
+    struct domain *d = current->domain;
+    unsigned int base = offsetof(struct evtchn_batch, ports) /
+                        sizeof(evtchn_port_t);
+    evtchn_port_t buf[32];
+
+    if ( batch->op != EVTCHNOP_send && batch->op != EVTCHNOP_unmask )
+        return -EOPNOTSUPP;
+
+    if ( batch->done > batch->nr )
+        return -EINVAL;
+
+    while ( batch->done < batch->nr )
+    {
+        unsigned int i, n = min_t(unsigned int, batch->nr - batch->done,
+                                  ARRAY_SIZE(buf));
+
+        if ( batch->done && hypercall_preempt_check() )
+            return -ERESTART;
+
+        if ( copy_from_guest_offset(buf, ports, base + batch->done, n) )
+            return -EFAULT;
+
+        for ( i = 0; i < n; i++ )
+        {
+            long rc = batch->op == EVTCHNOP_send ? evtchn_send(d, buf[i])
+                                                 : evtchn_unmask(buf[i]);
+
+            if ( rc )
+                return rc;
+
+            batch->done++;
+        }
+    }
+
+    return 0;
+}
+
 long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
 {
     long rc;
@@ -1320,6 +1414,27 @@ long do_event_channel_op(int cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         break;
     }
 
+    case EVTCHNOP_batch:
+    case EVTCHNOP_batch_cont: {
+        struct evtchn_batch batch;
+
+        if ( copy_from_guest(&batch, arg, 1) != 0 )
+            return -EFAULT;
+
+        if ( cmd == EVTCHNOP_batch )
+            batch.done = 0;
+
+        rc = evtchn_batch(&batch, guest_handle_cast(arg, evtchn_port_t));
+
+        if ( __copy_field_to_guest(guest_handle_cast(arg, evtchn_batch_t),
+                                   &batch, done) )
+            rc = -EFAULT;
+        else if ( rc == -ERESTART )
+            rc = hypercall_create_continuation(__HYPERVISOR_event_channel_op,
+                                               "ih", EVTCHNOP_batch_cont, arg);
+        break;
+    }
+
     case EVTCHNOP_init_control: {
         struct evtchn_init_control init_control;
         if ( copy_from_guest(&init_control, arg, 1) != 0 )
@@ -1444,6 +1559,114 @@ void notify_via_xen_event_channel(struct domain *ld, int lport)
     evtchn_read_unlock(lchn);
 }
 
+/*
+ * SCHEDOP_poll registrations.  Every polled port is counted in the
+ * domain's poll_hash (or poll_wildcards), so that sending on a port nobody
+ * polls, the common case with PV spinlocks where each vcpu polls its own
+ * kick port, doesn't have to look at every polling vcpu.  Those that are
+ * looked at are matched against the exact ports they poll, so multi-port
+ * pollers are no longer woken by every event in the domain.
+ *
+ * A vcpu's registration is only written by the vcpu itself, in do_poll(),
+ * while it is clear in poll_mask and poll_evtchn is 0.  It is dropped by
+ * whoever clears the vcpu from poll_mask, who then sets poll_evtchn to 0.
+ */
+#define EVTCHN_POLL_HASH 64
+
+static atomic_t *poll_bucket(const struct domain *d, evtchn_port_t port)
+{
+    return &d->poll_hash[port % EVTCHN_POLL_HASH];
+}
+
+static bool poll_matches(const struct vcpu *v, evtchn_port_t port)
+{
+    int sel = read_atomic(&v->poll_evtchn);
+    unsigned int i, nr;
+
+    if ( sel >= 0 )
+        return sel == port;
+
+    nr = read_atomic(&v->nr_poll_ports);
+    if ( !nr )
+        return true;
+
+    for ( i = 0; i < nr; i++ )
+        if ( v->poll_ports[i] == port )
+            return true;
+
+    return false;
+}
+
+static void poll_unregister(struct vcpu *v)
+{
+    struct domain *d = v->domain;
+    unsigned int i;
+
+    if ( v->poll_evtchn > 0 )
+        atomic_dec(poll_bucket(d, v->poll_evtchn));
+    else if ( !v->nr_poll_ports )
+        atomic_dec(&d->poll_wildcards);
+    else
+        for ( i = 0; i < v->nr_poll_ports; i++ )
+            atomic_dec(poll_bucket(d, v->poll_ports[i]));
+
+    /* Done with the registration: the vcpu may now reuse it. */
+    smp_mb();
+    write_atomic(&v->poll_evtchn, 0);
+}
+
+void evtchn_poll_register(struct vcpu *v, const evtchn_port_t *ports,
+                          unsigned int nr)
+{
+    struct domain *d = v->domain;
+    unsigned int i;
+
+    ASSERT(!v->poll_evtchn);
+    ASSERT(nr <= 1 || ports == v->poll_ports);
+
+    if ( nr == 1 && ports[0] )
+    {
+        v->poll_evtchn = ports[0];
+        atomic_inc(poll_bucket(d, ports[0]));
+    }
+    else
+    {
+        /* No ports, or the reserved port 0, means any port. */
+        v->nr_poll_ports = nr > 1 ? nr : 0;
+        v->poll_evtchn = -1;
+        if ( !v->nr_poll_ports )
+            atomic_inc(&d->poll_wildcards);
+        else
+            for ( i = 0; i < nr; i++ )
+                atomic_inc(poll_bucket(d, ports[i]));
+    }
+
+    /* Registration before poll_mask, which senders look at first. */
+    smp_wmb();
+    set_bit(v->vcpu_id, d->poll_mask);
+}
+
+bool evtchn_poll_clear(struct vcpu *v)
+{
+    if ( !test_and_clear_bit(v->vcpu_id, v->domain->poll_mask) )
+        return false;
+
+    poll_unregister(v);
+
+    return true;
+}
+
+void evtchn_poll_release(struct vcpu *v)
+{
+    if ( evtchn_poll_clear(v) )
+        return;
+
+    /* A waker got here first, and may still be looking at poll_ports. */
+    while ( read_atomic(&v->poll_evtchn) )
+        cpu_relax();
+    smp_mb();
+}
+
 void evtchn_check_pollers(struct domain *d, unsigned int port)
 {
     struct vcpu *v;
@@ -1453,18 +1676,18 @@ void evtchn_check_pollers(struct domain *d, unsigned int port)
     if ( likely(bitmap_empty(d->poll_mask, d->max_vcpus)) )
         return;
 
-    /* Wake any interested (or potentially interested) pollers. */
+    if ( !atomic_read(poll_bucket(d, port)) &&
+         !atomic_read(&d->poll_wildcards) )
+        return;
+
+    /* Wake any interested pollers. */
     for ( vcpuid = find_first_bit(d->poll_mask, d->max_vcpus);
           vcpuid < d->max_vcpus;
           vcpuid = find_next_bit(d->poll_mask, d->max_vcpus, vcpuid+1) )
     {
         v = d->vcpu[vcpuid];
-        if ( ((v->poll_evtchn <= 0) || (v->poll_evtchn == port)) &&
-             test_and_clear_bit(vcpuid, d->poll_mask) )
-        {
-            v->poll_evtchn = 0;
+        if ( poll_matches(v, port) && evtchn_poll_clear(v) )
             vcpu_unblock(v);
-        }
     }
 }
 
@@ -1476,21 +1699,37 @@ int evtchn_init(struct domain *d, unsigned int max_port)
     d->evtchn = alloc_evtchn_bucket(d, 0);
     if ( !d->evtchn )
         return -ENOMEM;
+    if ( grow_port_map(d, EVTCHNS_PER_BUCKET) )
+    {
+        free_evtchn_bucket(d, d->evtchn);
+        return -ENOMEM;
+    }
     d->valid_evtchns = EVTCHNS_PER_BUCKET;
 
     spin_lock_init_prof(d, event_lock);
     if ( get_free_port(d) != 0 )
     {
+        XFREE(d->evtchn_port_map);
         free_evtchn_bucket(d, d->evtchn);
         return -EINVAL;
     }
     evtchn_from_port(d, 0)->state = ECS_RESERVED;
     write_atomic(&d->active_evtchns, 0);
 
+    d->poll_hash = xzalloc_array(atomic_t, EVTCHN_POLL_HASH);
+    if ( !d->poll_hash )
+    {
+        XFREE(d->evtchn_port_map);
+        free_evtchn_bucket(d, d->evtchn);
+        return -ENOMEM;
+    }
+
 #if MAX_VIRT_CPUS > BITS_PER_LONG
     d->poll_mask = xzalloc_array(unsigned long, BITS_TO_LONGS(d->max_vcpus));
     if ( !d->poll_mask )
     {
+        XFREE(d->poll_hash);
+        XFREE(d->evtchn_port_map);
         free_evtchn_bucket(d, d->evtchn);
         return -ENOMEM;
     }
@@ -1548,6 +1787,8 @@ void evtchn_destroy_final(struct domain *d)
         xfree(d->evtchn_group[i]);
     }
     free_evtchn_bucket(d, d->evtchn);
+    XFREE(d->evtchn_port_map);
+    XFREE(d->poll_hash);
 
 #if MAX_VIRT_CPUS > BITS_PER_LONG
     xfree(d->poll_mask);
@@ -162,7 +162,7 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
 {
     struct domain *d = v->domain;
     unsigned int port;
-    event_word_t *word;
+    event_word_t *word, w;
     unsigned long flags;
     bool_t was_pending;
     struct evtchn_fifo_queue *q, *old_q;
@@ -182,6 +182,20 @@ static void evtchn_fifo_set_pending(struct vcpu *v, struct evtchn *evtchn)
         return;
     }
 
+    /*
+     * Fast path: an event which is already pending and either linked or
+     * masked needs no queue manipulation, so there's nothing to lock.
+     * Once the guest dequeues (clears LINKED) or unmasks it, it will act
+     * on the PENDING bit still set here, which covers this send as well.
+     * The barrier orders the sender's prior writes against the check, just
+     * like the locked test-and-set below would.
+     */
+    smp_mb();
+    w = read_atomic(word);
+    if ( (w & (1 << EVTCHN_FIFO_PENDING)) &&
+         (w & ((1 << EVTCHN_FIFO_LINKED) | (1 << EVTCHN_FIFO_MASKED))) )
+        return;
+
     /*
      * Lock all queues related to the event channel (in case of a queue change
      * this might be two).
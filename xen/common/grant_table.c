@@ -530,6 +530,10 @@ _get_maptrack_handle(struct grant_table *t, struct vcpu *v)
 {
     unsigned int head, next, prev_head;
 
+    /* The vCPU's own stash needs no locking. */
+    if ( v == current && v->maptrack_cache_nr )
+        return v->maptrack_cache[--v->maptrack_cache_nr];
+
     spin_lock(&v->maptrack_freelist_lock);
 
     do {
@@ -602,18 +606,47 @@ static grant_handle_t steal_maptrack_handle(struct grant_table *t,
     return INVALID_MAPTRACK_HANDLE;
 }
 
+/*
+ * Can the current vCPU hand out a handle without stealing one?  The free list
+ * always keeps one entry, so a list with no more than that is empty.
+ */
+static bool maptrack_freelist_empty(const struct grant_table *t,
+                                    const struct vcpu *v)
+{
+    unsigned int head = read_atomic(&v->maptrack_head);
+
+    return !v->maptrack_cache_nr &&
+           (head == MAPTRACK_TAIL ||
+            read_atomic(&maptrack_entry(t, head).ref) == MAPTRACK_TAIL);
+}
+
 static inline void
 put_maptrack_handle(
     struct grant_table *t, grant_handle_t handle)
 {
-    struct domain *currd = current->domain;
+    struct vcpu *curr = current;
+    struct domain *currd = curr->domain;
     struct vcpu *v;
     unsigned int prev_tail, cur_tail;
 
-    /* 1. Set entry to be a tail. */
+    /*
+     * 1. Keep the entry on the current vCPU if it owns it, or would
+     * otherwise have to steal its next one.  The stash is bounded, so
+     * entries cannot pile up out of reach of other vCPUs.
+     */
+    if ( curr->maptrack_cache_nr < ARRAY_SIZE(curr->maptrack_cache) &&
+         (maptrack_entry(t, handle).vcpu == curr->vcpu_id ||
+          maptrack_freelist_empty(t, curr)) )
+    {
+        maptrack_entry(t, handle).vcpu = curr->vcpu_id;
+        curr->maptrack_cache[curr->maptrack_cache_nr++] = handle;
+        return;
+    }
+
+    /* 2. Set entry to be a tail. */
     maptrack_entry(t, handle).ref = MAPTRACK_TAIL;
 
-    /* 2. Add entry to the tail of the list on the original VCPU. */
+    /* 3. Add entry to the tail of the list on the original VCPU. */
     v = currd->vcpu[maptrack_entry(t, handle).vcpu];
 
     spin_lock(&v->maptrack_freelist_lock);
@@ -624,7 +657,7 @@ put_maptrack_handle(
         cur_tail = cmpxchg(&v->maptrack_tail, prev_tail, handle);
     } while ( cur_tail != prev_tail );
 
-    /* 3. Update the old tail entry to point to the new entry. */
+    /* 4. Update the old tail entry to point to the new entry. */
     write_atomic(&maptrack_entry(t, prev_tail).ref, handle);
 
     spin_unlock(&v->maptrack_freelist_lock);
@@ -977,11 +1010,16 @@ static unsigned int mapkind(
     return kind;
 }
 
+/*
+ * @rd is the (RCU-locked) domain named by op->dom, looked up by the caller
+ * so that a batch of operations against the same domain only pays for the
+ * lookup once.  NULL if no such domain exists.
+ */
 static void
 map_grant_ref(
-    struct gnttab_map_grant_ref *op)
+    struct gnttab_map_grant_ref *op, struct domain *rd)
 {
-    struct domain *ld, *rd, *owner = NULL;
+    struct domain *ld, *owner = NULL;
     struct grant_table *lgt, *rgt;
     grant_ref_t ref;
     grant_handle_t handle;
@@ -1014,7 +1052,7 @@ map_grant_ref(
         return;
     }
 
-    if ( unlikely((rd = rcu_lock_domain_by_id(op->dom)) == NULL) )
+    if ( unlikely(!rd) )
     {
         gdprintk(XENLOG_INFO, "Could not find domain %d\n", op->dom);
         op->status = GNTST_bad_domain;
@@ -1024,7 +1062,6 @@ map_grant_ref(
     rc = xsm_grant_mapref(XSM_HOOK, ld, rd, op->flags);
     if ( rc )
     {
-        rcu_unlock_domain(rd);
         op->status = GNTST_permission_denied;
         return;
     }
@@ -1033,7 +1070,6 @@ map_grant_ref(
     handle = get_maptrack_handle(lgt);
     if ( unlikely(handle == INVALID_MAPTRACK_HANDLE) )
     {
-        rcu_unlock_domain(rd);
         gdprintk(XENLOG_INFO, "Failed to obtain maptrack handle\n");
         op->status = GNTST_no_device_space;
         return;
@@ -1256,7 +1292,6 @@ map_grant_ref(
     op->handle       = handle;
     op->status       = GNTST_okay;
 
-    rcu_unlock_domain(rd);
     return;
 
  undo_out:
@@ -1301,7 +1336,6 @@ map_grant_ref(
     grant_read_unlock(rgt);
     op->status = rc;
     put_maptrack_handle(lgt, handle);
-    rcu_unlock_domain(rd);
 }
 
 static long
@@ -1309,23 +1343,50 @@ gnttab_map_grant_ref(
     XEN_GUEST_HANDLE_PARAM(gnttab_map_grant_ref_t) uop, unsigned int count)
 {
     int i;
+    long rc = 0;
     struct gnttab_map_grant_ref op;
+    struct domain *rd = NULL;
+    domid_t rdom = DOMID_INVALID;
 
     for ( i = 0; i < count; i++ )
     {
         if ( i && hypercall_preempt_check() )
-            return i;
+        {
+            rc = i;
+            break;
+        }
 
         if ( unlikely(__copy_from_guest_offset(&op, uop, i, 1)) )
-            return -EFAULT;
+        {
+            rc = -EFAULT;
+            break;
+        }
+
+        /*
+         * Backends typically map many grants from the same frontend in one
+         * batch: keep the remote domain locked across consecutive ops.
+         */
+        if ( !i || op.dom != rdom )
+        {
+            if ( rd )
+                rcu_unlock_domain(rd);
+            rd = rcu_lock_domain_by_id(op.dom);
+            rdom = op.dom;
+        }
 
-        map_grant_ref(&op);
+        map_grant_ref(&op, rd);
 
         if ( unlikely(__copy_to_guest_offset(uop, i, &op, 1)) )
-            return -EFAULT;
+        {
+            rc = -EFAULT;
+            break;
+        }
     }
 
-    return 0;
+    if ( rd )
+        rcu_unlock_domain(rd);
+
+    return rc;
 }
 
 static void
@@ -2771,6 +2832,7 @@ struct gnttab_copy_buf {
     bool_t read_only;
     bool_t have_grant;
     bool_t have_type;
+    bool_t dirty;       /* Written since claimed; log-dirty update pending. */
 };
 
 static int gnttab_copy_lock_domain(domid_t domid, bool is_gref,
@@ -2835,6 +2897,17 @@ static int gnttab_copy_lock_domains(const struct gnttab_copy *op,
 
 static void gnttab_copy_release_buf(struct gnttab_copy_buf *buf)
 {
+    /*
+     * Log-dirty tracking is done once per claimed frame rather than once per
+     * copy op: netback style batches typically write many small chunks into
+     * the same destination page, and paging_mark_dirty() takes the paging
+     * lock each time while log-dirty mode is active.
+     */
+    if ( buf->dirty )
+    {
+        gnttab_mark_dirty(buf->domain, buf->mfn);
+        buf->dirty = 0;
+    }
     if ( buf->virt )
     {
         unmap_domain_page(buf->virt);
@@ -2951,9 +3024,13 @@ static int gnttab_copy_buf(const struct gnttab_copy *op,
     /* Make sure the above checks are not bypassed speculatively */
     block_speculation();
 
-    memcpy(dest->virt + op->dest.offset, src->virt + op->source.offset,
-           op->len);
-    gnttab_mark_dirty(dest->domain, dest->mfn);
+    /* Whole page copies can use the (non-temporal) page copy primitive. */
+    if ( op->len == PAGE_SIZE )
+        copy_page(dest->virt, src->virt);
+    else
+        memcpy(dest->virt + op->dest.offset, src->virt + op->source.offset,
+               op->len);
+    dest->dirty = 1;
     rc = GNTST_okay;
  out:
     return rc;
@@ -3699,7 +3776,7 @@ do_grant_table_op(
 #include "compat/grant_table.c"
 #endif
 
-void
+int
 gnttab_release_mappings(
     struct domain *d)
 {
@@ -3715,10 +3792,36 @@ gnttab_release_mappings(
 
     BUG_ON(!d->is_dying);
 
-    for ( handle = 0; handle < gt->maptrack_limit; handle++ )
+    /*
+     * Walk the maptrack table from the top, so the progress made can be
+     * recorded by lowering maptrack_limit (at page boundaries), allowing
+     * a preempted invocation to resume where it left off.
+     */
+    for ( handle = gt->maptrack_limit; handle; )
     {
         unsigned int clear_flags = 0;
 
+        /*
+         * Deal with full pages such that their freeing (in the body of the
+         * if()) remains simple.
+         */
+        if ( handle < gt->maptrack_limit && !(handle % MAPTRACK_PER_PAGE) )
+        {
+            /*
+             * Changing maptrack_limit alters nr_maptrack_frames()'es return
+             * value.  Free the then excess trailing page right here, rather
+             * than leaving it to grant_table_destroy() (and in turn requiring
+             * to leave gt->maptrack_limit unaltered).
+             */
+            gt->maptrack_limit = handle;
+            FREE_XENHEAP_PAGE(gt->maptrack[nr_maptrack_frames(gt)]);
+
+            if ( hypercall_preempt_check() )
+                return -ERESTART;
+        }
+
+        --handle;
+
         map = &maptrack_entry(gt, handle);
         if ( !(map->flags & (GNTMAP_device_map|GNTMAP_host_map)) )
             continue;
@@ -3809,6 +3912,14 @@ gnttab_release_mappings(
 
         map->flags = 0;
     }
+
+    if ( gt->maptrack_limit )
+    {
+        gt->maptrack_limit = 0;
+        FREE_XENHEAP_PAGE(gt->maptrack[0]);
+    }
+
+    return 0;
 }
 
 void grant_table_warn_active_grants(struct domain *d)
@@ -3893,6 +4004,7 @@ void grant_table_init_vcpu(struct vcpu *v)
     spin_lock_init(&v->maptrack_freelist_lock);
     v->maptrack_head = MAPTRACK_TAIL;
     v->maptrack_tail = MAPTRACK_TAIL;
+    v->maptrack_cache_nr = 0;
 }
 
 #ifdef CONFIG_MEM_SHARING
@@ -801,6 +801,18 @@ static void crash_save_vmcoreinfo(void)
     VMCOREINFO_OFFSET(domain, domain_id);
     VMCOREINFO_OFFSET(domain, next_in_list);
 
+    /*
+     * Page states and ownership, so that dump tools can leave out free and
+     * guest pages without hardcoding the count_info layout of a particular
+     * Xen version.
+     */
+    VMCOREINFO_NUMBER(PGC_allocated);
+    VMCOREINFO_NUMBER(PGC_xen_heap);
+    VMCOREINFO_NUMBER(PGC_state);
+    VMCOREINFO_NUMBER(PGC_state_inuse);
+    VMCOREINFO_NUMBER(PGC_state_free);
+    VMCOREINFO_NUMBER(PGC_count_mask);
+
 #ifdef ARCH_CRASH_SAVE_VMCOREINFO
     arch_crash_save_vmcoreinfo();
 #endif
@@ -4,6 +4,7 @@
 
 #include <asm/regs.h>
 #include <xen/keyhandler.h>
+#include <xen/llc-coloring.h>
 #include <xen/shutdown.h>
 #include <xen/event.h>
 #include <xen/console.h>
@@ -295,6 +296,8 @@ static void dump_domains(unsigned char key)
         printk("NODE affinity for domain %d: [%*pbl]\n",
                d->domain_id, NODEMASK_PR(&d->node_affinity));
 
+        domain_dump_llc_colors(d);
+
         printk("VCPU information and callbacks for domain %u:\n",
                d->domain_id);
 
@@ -51,8 +51,9 @@ static unsigned int payload_version = 1;
 /* Defines an outstanding patching action. */
 struct livepatch_work
 {
-    atomic_t semaphore;          /* Used to rendezvous CPUs in
+    atomic_t semaphore;          /* Used to elect the CPU driving
                                     check_for_livepatch_work. */
+    unsigned int seq;            /* Identifies the current operation. */
     uint32_t timeout;            /* Timeout to do the operation. */
     struct payload *data;        /* The payload on which to act. */
     volatile bool_t do_work;     /* Signals work to do. */
@@ -72,6 +73,17 @@ static struct livepatch_work livepatch_work;
 static DEFINE_PER_CPU(bool_t, work_to_do);
 static DEFINE_PER_CPU(struct tasklet, livepatch_tasklet);
 
+/*
+ * Quiesce state of each CPU, polled by the master CPU.  Each CPU only ever
+ * writes its own copy, so arriving CPUs don't contend on a shared counter.
+ * The operation's sequence number is folded in so that stale state from an
+ * earlier (possibly aborted) operation is never mistaken for the current one.
+ */
+static DEFINE_PER_CPU(unsigned int, livepatch_quiesce);
+#define QUIESCE_ARRIVED 0 /* In idle context, waiting with IRQs enabled. */
+#define QUIESCE_IRQ_OFF 1 /* IRQs disabled, waiting for patching to finish. */
+#define QUIESCE_STATE(seq, phase) (((seq) << 1) | (phase))
+
 static int get_name(const struct xen_livepatch_name *name, char *n)
 {
     if ( !name->size || name->size > XEN_LIVEPATCH_NAME_SIZE )
@@ -1579,6 +1591,7 @@ static int schedule_work(struct payload *data, uint32_t cmd, uint32_t timeout)
 
     atomic_set(&livepatch_work.semaphore, -1);
 
+    livepatch_work.seq++;
     livepatch_work.ready = 0;
 
     smp_wmb();
@@ -1596,19 +1609,33 @@ static void tasklet_fn(void *unused)
     this_cpu(work_to_do) = 1;
 }
 
-static int livepatch_spin(atomic_t *counter, s_time_t timeout,
+static int livepatch_spin(unsigned int phase, s_time_t timeout,
                           unsigned int cpus, const char *s)
 {
+    unsigned int self = smp_processor_id(), cpu, done = 0;
+    unsigned int state = QUIESCE_STATE(livepatch_work.seq, phase);
     int rc = 0;
 
-    while ( atomic_read(counter) != cpus && NOW() < timeout )
-        cpu_relax();
+    for_each_online_cpu ( cpu )
+    {
+        if ( cpu == self )
+            continue;
+
+        while ( read_atomic(&per_cpu(livepatch_quiesce, cpu)) != state &&
+                NOW() < timeout )
+            cpu_relax();
+
+        if ( read_atomic(&per_cpu(livepatch_quiesce, cpu)) != state )
+            break;
+
+        done++;
+    }
 
     /* Log & abort. */
-    if ( atomic_read(counter) != cpus )
+    if ( done != cpus )
     {
         printk(XENLOG_ERR LIVEPATCH "%s: Timed out on semaphore in %s quiesce phase %u/%u\n",
-               livepatch_work.data->name, s, atomic_read(counter), cpus);
+               livepatch_work.data->name, s, done, cpus);
         rc = -EBUSY;
         livepatch_work.data->rc = rc;
         smp_wmb();
@@ -1694,20 +1721,14 @@ void check_for_livepatch_work(void)
         }
 
         timeout = livepatch_work.timeout + NOW();
-        if ( livepatch_spin(&livepatch_work.semaphore, timeout, cpus, "CPU") )
+        if ( livepatch_spin(QUIESCE_ARRIVED, timeout, cpus, "CPU") )
             goto abort;
 
         /* All CPUs are waiting, now signal to disable IRQs. */
-        atomic_set(&livepatch_work.semaphore, 0);
-        /*
-         * MUST have a barrier after semaphore so that the other CPUs don't
-         * leak out of the 'Wait for all CPUs to rendezvous' loop and increment
-         * 'semaphore' before we set it to zero.
-         */
         smp_wmb();
         livepatch_work.ready = 1;
 
-        if ( !livepatch_spin(&livepatch_work.semaphore, timeout, cpus, "IRQ") )
+        if ( !livepatch_spin(QUIESCE_IRQ_OFF, timeout, cpus, "IRQ") )
         {
             local_irq_save(flags);
             /* Do the patching. */
@@ -1769,17 +1790,19 @@ void check_for_livepatch_work(void)
     }
     else
     {
+        unsigned int seq = livepatch_work.seq;
+
+        write_atomic(&this_cpu(livepatch_quiesce),
+                     QUIESCE_STATE(seq, QUIESCE_ARRIVED));
+
         /* Wait for all CPUs to rendezvous. */
         while ( livepatch_work.do_work && !livepatch_work.ready )
             cpu_relax();
 
         /* Disable IRQs and signal. */
         local_irq_save(flags);
-        /*
-         * We re-use the sempahore, so MUST have it reset by master before
-         * we exit the loop above.
-         */
-        atomic_inc(&livepatch_work.semaphore);
+        write_atomic(&this_cpu(livepatch_quiesce),
+                     QUIESCE_STATE(seq, QUIESCE_IRQ_OFF));
 
         /* Wait for patching to complete. */
         while ( livepatch_work.do_work )
@@ -0,0 +1,282 @@
+/*
+ * Last Level Cache (LLC) coloring common code
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <xen/bitmap.h>
+#include <xen/errno.h>
+#include <xen/guest_access.h>
+#include <xen/init.h>
+#include <xen/lib.h>
+#include <xen/llc-coloring.h>
+#include <xen/param.h>
+#include <xen/sched.h>
+#include <xen/xmalloc.h>
+#include <public/domctl.h>
+
+bool __read_mostly llc_coloring_enabled;
+boolean_param("llc-coloring", llc_coloring_enabled);
+
+static unsigned long __initdata llc_way_size;
+size_param("llc-way-size", llc_way_size);
+
+static unsigned int __read_mostly max_nr_colors;
+
+/* Used by all domains which haven't been given colors of their own. */
+static unsigned int __read_mostly default_colors[NR_LLC_COLORS];
+
+/*
+ * Parse a list of colors and color ranges, e.g. "0-3,6,8-9", into at most
+ * @max_num distinct entries of @colors.
+ */
+static int parse_color_config(const char *buf, unsigned int colors[],
+                              unsigned int max_num, unsigned int *num)
+{
+    DECLARE_BITMAP(seen, NR_LLC_COLORS);
+    const char *s = buf;
+
+    bitmap_zero(seen, NR_LLC_COLORS);
+    *num = 0;
+
+    while ( *s != '\0' )
+    {
+        unsigned long start, end;
+
+        start = simple_strtoul(s, &s, 0);
+        if ( *s == '-' )
+            end = simple_strtoul(s + 1, &s, 0);
+        else
+            end = start;
+
+        if ( start > end || end >= NR_LLC_COLORS )
+            return -EINVAL;
+
+        for ( ; start <= end; start++ )
+        {
+            if ( __test_and_set_bit(start, seen) )
+                return -EINVAL;
+            if ( *num == max_num )
+                return -E2BIG;
+            colors[(*num)++] = start;
+        }
+
+        if ( *s == ',' )
+            s++;
+        else if ( *s != '\0' )
+            return -EINVAL;
+    }
+
+    return 0;
+}
+
+/* Colors must exist on this platform and be listed at most once. */
+static bool check_colors(const unsigned int colors[], unsigned int num)
+{
+    DECLARE_BITMAP(seen, NR_LLC_COLORS);
+    unsigned int i;
+
+    if ( !num || num > max_nr_colors )
+        return false;
+
+    bitmap_zero(seen, NR_LLC_COLORS);
+
+    for ( i = 0; i < num; i++ )
+        if ( colors[i] >= max_nr_colors || __test_and_set_bit(colors[i], seen) )
+            return false;
+
+    return true;
+}
+
+static void print_colors(const unsigned int colors[], unsigned int num)
+{
+    unsigned int i;
+
+    printk("{ ");
+    for ( i = 0; i < num; i++ )
+    {
+        unsigned int start = colors[i], end = start;
+
+        while ( i + 1 < num && colors[i + 1] == end + 1 )
+            end = colors[++i];
+
+        if ( start == end )
+            printk("%u ", start);
+        else
+            printk("%u-%u ", start, end);
+    }
+    printk("}\n");
+}
+
+void __init llc_coloring_init(void)
+{
+    unsigned long way_size;
+    unsigned int i;
+
+    if ( !llc_coloring_enabled )
+        return;
+
+    way_size = llc_way_size ?: get_llc_way_size();
+    if ( !way_size )
+    {
+        printk(XENLOG_WARNING
+               "LLC way size unknown, disabling LLC coloring\n");
+        llc_coloring_enabled = false;
+        return;
+    }
+
+    max_nr_colors = way_size >> PAGE_SHIFT;
+    if ( max_nr_colors < 2 || max_nr_colors > NR_LLC_COLORS ||
+         (max_nr_colors & (max_nr_colors - 1)) )
+    {
+        printk(XENLOG_WARNING
+               "LLC way size %#lx gives %u colors (need a power of 2 from 2 to %u), disabling LLC coloring\n",
+               way_size, max_nr_colors, NR_LLC_COLORS);
+        max_nr_colors = 0;
+        llc_coloring_enabled = false;
+        return;
+    }
+
+    for ( i = 0; i < max_nr_colors; i++ )
+        default_colors[i] = i;
+
+    dump_llc_coloring_info();
+}
+
+void dump_llc_coloring_info(void)
+{
+    if ( !llc_coloring_enabled )
+        return;
+
+    printk("LLC coloring info:\n");
+    printk("    Number of LLC colors supported: %u\n", max_nr_colors);
+}
+
+unsigned int get_max_nr_llc_colors(void)
+{
+    return max_nr_colors;
+}
+
+unsigned int page_to_llc_color(const struct page_info *pg)
+{
+    return mfn_x(page_to_mfn(pg)) & (max_nr_colors - 1);
+}
+
+void domain_llc_coloring_init(struct domain *d)
+{
+    d->llc_colors = default_colors;
+    d->num_llc_colors = max_nr_colors;
+}
+
+void domain_llc_coloring_free(struct domain *d)
+{
+    if ( d->llc_colors != default_colors )
+        xfree((void *)d->llc_colors);
+
+    d->llc_colors = default_colors;
+    d->num_llc_colors = max_nr_colors;
+}
+
+void domain_dump_llc_colors(const struct domain *d)
+{
+    if ( !llc_coloring_enabled )
+        return;
+
+    if ( is_domain_direct_mapped(d) )
+    {
+        printk("    LLC colors: none (direct mapped)\n");
+        return;
+    }
+
+    printk("    %u LLC colors: ", d->num_llc_colors);
+    print_colors(d->llc_colors, d->num_llc_colors);
+}
+
+/* On success the domain takes ownership of the xmalloc()-ed @colors. */
+static int domain_install_colors(struct domain *d, unsigned int *colors,
+                                 unsigned int num)
+{
+    if ( is_domain_direct_mapped(d) )
+        return -EOPNOTSUPP;
+
+    if ( domain_tot_pages(d) )
+        return -EBUSY;
+
+    if ( !check_colors(colors, num) )
+        return -EINVAL;
+
+    domain_llc_coloring_free(d);
+    d->llc_colors = colors;
+    d->num_llc_colors = num;
+
+    return 0;
+}
+
+int domain_set_llc_colors(struct domain *d,
+                          const struct xen_domctl_set_llc_colors *config)
+{
+    unsigned int *colors;
+    int rc;
+
+    if ( !llc_coloring_enabled )
+        return -EOPNOTSUPP;
+
+    if ( config->pad || !config->num_llc_colors ||
+         config->num_llc_colors > max_nr_colors )
+        return -EINVAL;
+
+    colors = xmalloc_array(unsigned int, config->num_llc_colors);
+    if ( !colors )
+        return -ENOMEM;
+
+    if ( copy_from_guest(colors, config->llc_colors, config->num_llc_colors) )
+        rc = -EFAULT;
+    else
+        rc = domain_install_colors(d, colors, config->num_llc_colors);
+
+    if ( rc )
+        xfree(colors);
+
+    return rc;
+}
+
+int __init domain_set_llc_colors_from_str(struct domain *d, const char *str)
+{
+    unsigned int *colors, num;
+    int rc;
+
+    if ( !llc_coloring_enabled )
+        return -EOPNOTSUPP;
+
+    colors = xmalloc_array(unsigned int, max_nr_colors);
+    if ( !colors )
+        return -ENOMEM;
+
+    rc = parse_color_config(str, colors, max_nr_colors, &num);
+    if ( !rc )
+        rc = domain_install_colors(d, colors, num);
+
+    if ( rc )
+        xfree(colors);
+
+    return rc;
+}
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -488,6 +488,37 @@ static void decrease_reservation(struct memop_args *a)
     a->nr_done = i;
 }
 
+static void report_free_pages(struct memop_args *a)
+{
+    unsigned long i;
+    xen_pfn_t gpfn;
+
+    if ( !is_hvm_domain(a->domain) ||
+         !guest_handle_subrange_okay(a->extent_list, a->nr_done,
+                                     a->nr_extents-1) ||
+         a->extent_order > max_order(current->domain) )
+        return;
+
+    for ( i = a->nr_done; i < a->nr_extents; i++ )
+    {
+        if ( i != a->nr_done && hypercall_preempt_check() )
+        {
+            a->preempted = 1;
+            goto out;
+        }
+
+        if ( unlikely(__copy_from_guest_offset(&gpfn, a->extent_list, i, 1)) ||
+             unlikely(gpfn & ((1UL << a->extent_order) - 1)) )
+            goto out;
+
+        if ( p2m_pod_report_free(a->domain, _gfn(gpfn), a->extent_order) < 0 )
+            goto out;
+    }
+
+ out:
+    a->nr_done = i;
+}
+
 static bool propagate_node(unsigned int xmf, unsigned int *memflags)
 {
     const struct domain *currd = current->domain;
@@ -1144,6 +1175,12 @@ static int acquire_resource(
                                  mfn_list);
         break;
 
+    case XENMEM_resource_vcpu_runstate:
+        rc = xmar.id ? -EINVAL
+                     : sched_acquire_runstate(d, xmar.frame, xmar.nr_frames,
+                                              mfn_list);
+        break;
+
     default:
         rc = arch_acquire_resource(d, xmar.type, xmar.id, xmar.frame,
                                    xmar.nr_frames, mfn_list);
@@ -1197,9 +1234,13 @@ long do_memory_op(unsigned long cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
     case XENMEM_increase_reservation:
     case XENMEM_decrease_reservation:
     case XENMEM_populate_physmap:
+    case XENMEM_report_free_pages:
         if ( copy_from_guest(&reservation, arg, 1) )
             return start_extent;
 
+        if ( op == XENMEM_report_free_pages && reservation.mem_flags )
+            return start_extent;
+
         /* Is size too large for us to encode a continuation? */
         if ( reservation.nr_extents > (UINT_MAX >> MEMOP_EXTENT_SHIFT) )
             return start_extent;
@@ -1232,7 +1273,8 @@ long do_memory_op(unsigned long cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         }
 
 #ifdef CONFIG_X86
-        if ( pv_shim && op != XENMEM_decrease_reservation && !start_extent )
+        if ( pv_shim && op != XENMEM_decrease_reservation &&
+             op != XENMEM_report_free_pages && !start_extent )
             /* Avoid calling pv_shim_online_memory when in a continuation. */
             pv_shim_online_memory(args.nr_extents, args.extent_order);
 #endif
@@ -1245,6 +1287,9 @@ long do_memory_op(unsigned long cmd, XEN_GUEST_HANDLE_PARAM(void) arg)
         case XENMEM_decrease_reservation:
             decrease_reservation(&args);
             break;
+        case XENMEM_report_free_pages:
+            report_free_pages(&args);
+            break;
         default: /* XENMEM_populate_physmap */
             populate_physmap(&args);
             break;
@@ -120,6 +120,7 @@
  *   regions within it.
  */
 
+#include <xen/cpu.h>
 #include <xen/init.h>
 #include <xen/types.h>
 #include <xen/lib.h>
@@ -131,6 +132,7 @@
 #include <xen/softirq.h>
 #include <xen/domain_page.h>
 #include <xen/keyhandler.h>
+#include <xen/llc-coloring.h>
 #include <xen/perfc.h>
 #include <xen/pfn.h>
 #include <xen/numa.h>
@@ -151,6 +153,10 @@
 #define p2m_pod_offline_or_broken_replace(pg) BUG_ON(pg != NULL)
 #endif
 
+#ifndef PGC_colored
+#define PGC_colored 0
+#endif
+
 /*
  * Comma-separated list of hexadecimal page numbers containing bad bytes.
  * e.g. 'badpage=0x3f45,0x8a321'.
@@ -217,6 +223,42 @@ size_param("bootscrub_chunk", opt_bootscrub_chunk);
 static bool __read_mostly opt_scrub_domheap;
 boolean_param("scrub-domheap", opt_scrub_domheap);
 
+/* pcp-cache -> Per-CPU caches of free order-0 pages (see pcp_alloc()). */
+static bool __read_mostly opt_pcp_cache = true;
+boolean_param("pcp-cache", opt_pcp_cache);
+
+/*
+ * heap-preserve-order -> Allocations below this order are satisfied from any
+ * smaller free chunk in the allowed zones before a chunk of at least this
+ * order is split (see get_free_buddy()).  0 disables.
+ */
+static unsigned int __read_mostly opt_preserve_order = 9;
+integer_param("heap-preserve-order", opt_preserve_order);
+
+/*
+ * slow-memory-nodes -> Nodes whose memory is slower than the rest (e.g. CXL
+ * attached), only used once the faster nodes a domain may allocate from are
+ * exhausted (see get_free_buddy()).
+ */
+static nodemask_t __read_mostly slow_nodes;
+static int __init parse_slow_nodes(const char *s)
+{
+    do {
+        unsigned long start = simple_strtoul(s, &s, 0), end = start;
+
+        if ( *s == '-' )
+            end = simple_strtoul(s + 1, &s, 0);
+        if ( start > end || end >= MAX_NUMNODES )
+            return -EINVAL;
+
+        for ( ; start <= end; start++ )
+            node_set(start, slow_nodes);
+    } while ( *s++ == ',' );
+
+    return s[-1] ? -EINVAL : 0;
+}
+custom_param("slow-memory-nodes", parse_slow_nodes);
+
 #ifdef CONFIG_SCRUB_DEBUG
 static bool __read_mostly scrub_debug;
 #else
@@ -457,6 +499,42 @@ static long total_avail_pages;
 static DEFINE_SPINLOCK(heap_lock);
 static long outstanding_claims; /* total outstanding claims by all domains */
 
+/*
+ * Per-CPU caches of clean order-0 pages from the CPU's own node.
+ *
+ * Single page allocations and frees dominate (populate/decrease_reservation,
+ * p2m and shadow pool growth, xmalloc), and each used to be a round trip
+ * through the global heap_lock.  A CPU instead refills its cache with one
+ * 2^PCP_BATCH_ORDER chunk at a time and hands pages back to the buddy
+ * allocator in batches of PCP_BATCH pages, so the lock is taken roughly once
+ * per PCP_BATCH operations, and only pages local to the CPU's node are ever
+ * cached.
+ *
+ * Cached pages are PGC_state_inuse with no owner, and are not accounted in
+ * avail[] / total_avail_pages.  Memory claims therefore never cover cached
+ * pages, and at most PCP_HIGH pages per CPU are hidden from the heap.
+ * Only accessed by the owning CPU, except after it has gone offline.
+ */
+#define PCP_BATCH_ORDER 4
+#define PCP_BATCH       (1U << PCP_BATCH_ORDER)
+#define PCP_HIGH        (4 * PCP_BATCH)
+
+struct pcp_cache {
+    struct page_list_head list;
+    unsigned int count;
+};
+static DEFINE_PER_CPU(struct pcp_cache, pcp_cache);
+static bool __read_mostly pcp_enabled;
+
+static struct page_info *alloc_heap_pages(
+    unsigned int zone_lo, unsigned int zone_hi,
+    unsigned int order, unsigned int memflags,
+    struct domain *d);
+static struct page_info *pcp_alloc(
+    unsigned int zone_lo, unsigned int zone_hi, unsigned int memflags,
+    struct domain *d);
+static bool pcp_free(struct page_info *pg, bool need_scrub);
+
 unsigned long domain_adjust_tot_pages(struct domain *d, long pages)
 {
     long dom_before, dom_after, dom_claimed, sys_before, sys_after;
@@ -812,8 +890,9 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
                                         const struct domain *d)
 {
     nodeid_t first, node = MEMF_get_node(memflags), req_node = node;
-    nodemask_t nodemask = node_online_map;
+    nodemask_t nodemask = node_online_map, slow, tried;
     unsigned int j, zone, nodemask_retry = 0;
+    unsigned int preserve = min(opt_preserve_order, MAX_ORDER + 1U);
     struct page_info *pg;
     bool use_unscrubbed = (memflags & MEMF_no_scrub);
 
@@ -833,6 +912,18 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
             ASSERT_UNREACHABLE();
     }
 
+    /*
+     * Of the preferred nodes, use the slow memory tier ones only once the
+     * others are full.  Domains whose affinity is limited to slow nodes (as
+     * set by the toolstack to place them there) simply use those.
+     */
+    nodes_and(slow, nodemask, slow_nodes);
+    if ( nodes_equal(slow, nodemask) )
+        nodes_clear(slow);
+    else
+        nodes_andnot(nodemask, nodemask, slow);
+    nodes_clear(tried);
+
     if ( node == NUMA_NO_NODE )
     {
         if ( d != NULL )
@@ -855,6 +946,33 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
      */
     for ( ; ; )
     {
+        /*
+         * Small requests are first served from fragments, in any zone and
+         * whether or not they are scrubbed, and only then from a larger chunk.
+         * Preferring the smallest order in the highest zone alone, as below,
+         * would split a superpage-sized chunk high up while fragments sit
+         * unused in lower zones (or merely need scrubbing), and the superpage
+         * couldn't be reassembled until every piece of it is freed again.
+         */
+        if ( order < preserve )
+        {
+            zone = zone_hi;
+            do {
+                if ( !avail[node] || (avail[node][zone] < (1UL << order)) )
+                    continue;
+
+                for ( j = order; j < preserve; j++ )
+                {
+                    if ( (pg = page_list_remove_head(&heap(node, zone, j))) )
+                    {
+                        if ( pg->u.free.first_dirty != INVALID_DIRTY_IDX )
+                            check_and_stop_scrub(pg);
+                        return pg;
+                    }
+                }
+            } while ( zone-- > zone_lo ); /* careful: unsigned zone may wrap */
+        }
+
         zone = zone_hi;
         do {
             /* Check if target node can support the allocation. */
@@ -862,7 +980,7 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
                 continue;
 
             /* Find smallest order which can satisfy the request. */
-            for ( j = order; j <= MAX_ORDER; j++ )
+            for ( j = max(order, preserve); j <= MAX_ORDER; j++ )
             {
                 if ( (pg = page_list_remove_head(&heap(node, zone, j))) )
                 {
@@ -900,10 +1018,20 @@ static struct page_info *get_free_buddy(unsigned int zone_lo,
             node = first_node(nodemask);
         if ( node == first )
         {
+            if ( memflags & MEMF_exact_node )
+                return NULL;
+            nodes_or(tried, tried, nodemask);
+            if ( !nodes_empty(slow) )
+            {
+                /* Faster preferred nodes are full: go on with slower ones. */
+                nodemask = slow;
+                nodes_clear(slow);
+            }
             /* When we have tried all in nodemask, we fall back to others. */
-            if ( (memflags & MEMF_exact_node) || nodemask_retry++ )
+            else if ( nodemask_retry++ )
                 return NULL;
-            nodes_andnot(nodemask, node_online_map, nodemask);
+            else
+                nodes_andnot(nodemask, node_online_map, tried);
             first = node = first_node(nodemask);
             if ( node >= MAX_NUMNODES )
                 return NULL;
@@ -934,6 +1062,10 @@ static struct page_info *alloc_heap_pages(
     if ( unlikely(order > MAX_ORDER) )
         return NULL;
 
+    if ( !order && pcp_enabled &&
+         (pg = pcp_alloc(zone_lo, zone_hi, memflags, d)) != NULL )
+        return pg;
+
     spin_lock(&heap_lock);
 
     /*
@@ -1162,13 +1294,31 @@ static int reserve_offlined_page(struct page_info *head)
     return count;
 }
 
-static nodemask_t node_scrubbing;
+/*
+ * Number of CPUs currently scrubbing each node, and how many may do so
+ * concurrently.  Scrubbing is memory bandwidth bound, so a handful of CPUs
+ * per node is enough to saturate it without starving guests running on the
+ * node of bandwidth.
+ */
+static atomic_t node_scrubbers[MAX_NUMNODES];
+static unsigned int __read_mostly opt_scrub_cpus = 4;
+integer_param("scrub-cpus", opt_scrub_cpus);
+
+static bool node_scrub_get(nodeid_t node)
+{
+    return atomic_add_unless(&node_scrubbers[node], 1, max(opt_scrub_cpus, 1U));
+}
+
+static void node_scrub_put(nodeid_t node)
+{
+    atomic_dec(&node_scrubbers[node]);
+}
 
 /*
  * If get_node is true this will return closest node that needs to be scrubbed,
- * with appropriate bit in node_scrubbing set.
+ * with a scrubber slot taken (see node_scrub_get()).
  * If get_node is not set, this will return *a* node that needs to be scrubbed.
- * node_scrubbing bitmask will no be updated.
+ * No scrubber slot will be taken.
  * If no node needs scrubbing then NUMA_NO_NODE is returned.
  */
 static unsigned int node_to_scrub(bool get_node)
@@ -1181,7 +1331,7 @@ static unsigned int node_to_scrub(bool get_node)
         node = 0;
 
     if ( node_need_scrub[node] &&
-         (!get_node || !node_test_and_set(node, node_scrubbing)) )
+         (!get_node || node_scrub_get(node)) )
         return node;
 
     /*
@@ -1215,10 +1365,10 @@ static unsigned int node_to_scrub(bool get_node)
              * then we'd need to take this lock every time we come in here.
              */
             if ( (dist < shortest || closest == NUMA_NO_NODE) &&
-                 !node_test_and_set(node, node_scrubbing) )
+                 node_scrub_get(node) )
             {
                 if ( closest != NUMA_NO_NODE )
-                    node_clear(closest, node_scrubbing);
+                    node_scrub_put(closest);
                 shortest = dist;
                 closest = node;
             }
@@ -1251,6 +1401,48 @@ static void scrub_continue(void *data)
     }
 }
 
+/*
+ * Find the last dirty buddy on the list which no other CPU is scrubbing.
+ * Unscrubbed buddies are always at the end of the list.
+ */
+static struct page_info *scrub_next_buddy(struct page_list_head *head)
+{
+    struct page_info *pg;
+
+    ASSERT(spin_is_locked(&heap_lock));
+
+    if ( page_list_empty(head) )
+        return NULL;
+
+    for ( pg = page_list_last(head); ; pg = page_list_prev(pg, head) )
+    {
+        if ( pg->u.free.first_dirty == INVALID_DIRTY_IDX )
+            break;
+        if ( pg->u.free.scrub_state == BUDDY_NOT_SCRUBBING )
+            return pg;
+        if ( pg == page_list_first(head) )
+            break;
+    }
+
+    return NULL;
+}
+
+/*
+ * Don't scrub while an SMT sibling is running a guest: the scrubber would
+ * compete with it for core resources and memory bandwidth.  The CPU goes
+ * back to sleep and tries again on its next idle wakeup.
+ */
+static bool scrub_throttled(unsigned int cpu)
+{
+    unsigned int sibling;
+
+    for_each_cpu ( sibling, per_cpu(cpu_sibling_mask, cpu) )
+        if ( sibling != cpu && !is_idle_vcpu(get_cpu_current(sibling)) )
+            return true;
+
+    return false;
+}
+
 bool scrub_free_pages(void)
 {
     struct page_info *pg;
@@ -1260,6 +1452,9 @@ bool scrub_free_pages(void)
     nodeid_t node;
     unsigned int cnt = 0;
 
+    if ( scrub_throttled(cpu) )
+        return false;
+
     node = node_to_scrub(true);
     if ( node == NUMA_NO_NODE )
         return false;
@@ -1271,16 +1466,11 @@ bool scrub_free_pages(void)
         unsigned int order = MAX_ORDER;
 
         do {
-            while ( !page_list_empty(&heap(node, zone, order)) )
+            while ( (pg = scrub_next_buddy(&heap(node, zone, order))) )
             {
                 unsigned int i, dirty_cnt;
                 struct scrub_wait_state st;
 
-                /* Unscrubbed pages are always at the end of the list. */
-                pg = page_list_last(&heap(node, zone, order));
-                if ( pg->u.free.first_dirty == INVALID_DIRTY_IDX )
-                    break;
-
                 ASSERT(pg->u.free.scrub_state == BUDDY_NOT_SCRUBBING);
                 pg->u.free.scrub_state = BUDDY_SCRUBBING;
 
@@ -1370,12 +1560,12 @@ bool scrub_free_pages(void)
     spin_unlock(&heap_lock);
 
  out_nolock:
-    node_clear(node, node_scrubbing);
+    node_scrub_put(node);
     return node_to_scrub(false) != NUMA_NO_NODE;
 }
 
-/* Free 2^@order set of pages. */
-static void free_heap_pages(
+/* Free 2^@order set of pages.  Caller must hold heap_lock. */
+static void __free_heap_pages(
     struct page_info *pg, unsigned int order, bool need_scrub)
 {
     unsigned long mask;
@@ -1385,8 +1575,7 @@ static void free_heap_pages(
 
     ASSERT(order <= MAX_ORDER);
     ASSERT(node >= 0);
-
-    spin_lock(&heap_lock);
+    ASSERT(spin_is_locked(&heap_lock));
 
     for ( i = 0; i < (1 << order); i++ )
     {
@@ -1506,10 +1695,216 @@ static void free_heap_pages(
 
     if ( tainted )
         reserve_offlined_page(pg);
+}
 
+/* Free 2^@order set of pages. */
+static void free_heap_pages(
+    struct page_info *pg, unsigned int order, bool need_scrub)
+{
+    if ( !order && pcp_enabled && pcp_free(pg, need_scrub) )
+        return;
+
+    spin_lock(&heap_lock);
+    __free_heap_pages(pg, order, need_scrub);
     spin_unlock(&heap_lock);
 }
 
+/*
+ * Return up to @nr pages from @pcp to the buddy allocator.  Done under a
+ * single acquisition of heap_lock, after flushing any TLBs that may still
+ * reference the pages (the buddy allocator only tracks that for pages which
+ * still have an owner when freed).
+ */
+static void pcp_drain(struct pcp_cache *pcp, unsigned int nr)
+{
+    PAGE_LIST_HEAD(batch);
+    struct page_info *pg;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+
+    while ( nr-- && (pg = page_list_remove_head(&pcp->list)) != NULL )
+    {
+        pcp->count--;
+        accumulate_tlbflush(&need_tlbflush, pg, &tlbflush_timestamp);
+        page_list_add_tail(pg, &batch);
+    }
+
+    if ( page_list_empty(&batch) )
+        return;
+
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    spin_lock(&heap_lock);
+    while ( (pg = page_list_remove_head(&batch)) != NULL )
+        __free_heap_pages(pg, 0, false);
+    spin_unlock(&heap_lock);
+}
+
+/* Can a cached page from this CPU's node satisfy a request for @d? */
+static bool pcp_node_ok(unsigned int memflags, const struct domain *d,
+                        nodeid_t local)
+{
+    nodeid_t req_node = MEMF_get_node(memflags);
+    nodemask_t nodemask;
+
+    if ( req_node != NUMA_NO_NODE )
+        return req_node == local;
+
+    if ( !d )
+        return true;
+
+    /* Stay within, and keep cycling through, the domain's node affinity. */
+    nodes_and(nodemask, node_online_map, d->node_affinity);
+    if ( nodes_empty(nodemask) )
+        return false;
+
+    return cycle_node(d->last_alloc_node, nodemask) == local;
+}
+
+static struct page_info *pcp_alloc(
+    unsigned int zone_lo, unsigned int zone_hi, unsigned int memflags,
+    struct domain *d)
+{
+    struct pcp_cache *pcp = &this_cpu(pcp_cache);
+    nodeid_t node = cpu_to_node(smp_processor_id());
+    struct page_info *pg;
+    unsigned int i;
+    bool need_tlbflush = false;
+    uint32_t tlbflush_timestamp = 0;
+
+    if ( !pcp_node_ok(memflags, d, node) )
+        return NULL;
+
+    if ( !pcp->count )
+    {
+        /*
+         * Refill from unclaimed memory only (d == NULL), and only from this
+         * node.  The chunk comes back scrubbed and TLB-clean.
+         */
+        pg = alloc_heap_pages(zone_lo, zone_hi, PCP_BATCH_ORDER,
+                              MEMF_node(node) | MEMF_exact_node, NULL);
+        if ( !pg )
+            return NULL;
+
+        for ( i = 0; i < PCP_BATCH; i++ )
+        {
+            pg[i].u.free.need_tlbflush = false;
+            page_list_add_tail(&pg[i], &pcp->list);
+        }
+        pcp->count = PCP_BATCH;
+    }
+
+    pg = page_list_first(&pcp->list);
+    if ( page_to_zone(pg) < zone_lo || page_to_zone(pg) > zone_hi )
+        return NULL;
+
+    page_list_del(pg, &pcp->list);
+    pcp->count--;
+
+    /* Offlined while sitting in the cache?  Let the buddy allocator have it. */
+    if ( unlikely((ACCESS_ONCE(pg->count_info) & PGC_state) !=
+                  PGC_state_inuse) )
+    {
+        spin_lock(&heap_lock);
+        __free_heap_pages(pg, 0, false);
+        spin_unlock(&heap_lock);
+        return NULL;
+    }
+
+    if ( !(memflags & MEMF_no_tlbflush) )
+        accumulate_tlbflush(&need_tlbflush, pg, &tlbflush_timestamp);
+
+    pg->u.inuse.type_info = 0;
+
+    if ( d != NULL )
+        d->last_alloc_node = node;
+
+    flush_page_to_ram(mfn_x(page_to_mfn(pg)),
+                      !(memflags & MEMF_no_icache_flush));
+
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    return pg;
+}
+
+static bool pcp_free(struct page_info *pg, bool need_scrub)
+{
+    struct pcp_cache *pcp = &this_cpu(pcp_cache);
+    unsigned long x = ACCESS_ONCE(pg->count_info);
+
+    if ( need_scrub || scrub_debug ||
+         phys_to_nid(page_to_maddr(pg)) != cpu_to_node(smp_processor_id()) ||
+         page_to_zone(pg) == MEMZONE_XEN )
+        return false;
+
+    /*
+     * Leave pages being offlined to the buddy allocator.  offline_page()
+     * updates count_info under heap_lock only, hence the cmpxchg().
+     */
+    if ( (x & (PGC_state | PGC_broken)) != PGC_state_inuse ||
+         cmpxchg(&pg->count_info, x, PGC_state_inuse) != x )
+        return false;
+
+    /* As per __free_heap_pages(). */
+    pg->u.free.need_tlbflush = (page_get_owner(pg) != NULL);
+    if ( pg->u.free.need_tlbflush )
+        page_set_tlbflush_timestamp(pg);
+    page_set_owner(pg, NULL);
+    set_gpfn_from_mfn(mfn_x(page_to_mfn(pg)), INVALID_M2P_ENTRY);
+
+    page_list_add(pg, &pcp->list);
+    if ( ++pcp->count > PCP_HIGH )
+        pcp_drain(pcp, PCP_BATCH);
+
+    return true;
+}
+
+static int cpu_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+    struct pcp_cache *pcp = &per_cpu(pcp_cache, cpu);
+
+    switch ( action )
+    {
+    case CPU_UP_PREPARE:
+        INIT_PAGE_LIST_HEAD(&pcp->list);
+        pcp->count = 0;
+        break;
+
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        pcp_drain(pcp, pcp->count);
+        break;
+
+    default:
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block cpu_nfb = {
+    .notifier_call = cpu_callback,
+};
+
+static int __init pcp_cache_init(void)
+{
+    void *cpu = (void *)(long)smp_processor_id();
+
+    if ( !opt_pcp_cache )
+        return 0;
+
+    cpu_callback(&cpu_nfb, CPU_UP_PREPARE, cpu);
+    register_cpu_notifier(&cpu_nfb);
+    pcp_enabled = true;
+
+    return 0;
+}
+presmp_initcall(pcp_cache_init);
+
 
 /*
  * Following rules applied for page offline:
@@ -1765,11 +2160,32 @@ int query_page_offline(mfn_t mfn, uint32_t *status)
  * latter is not on a MAX_ORDER boundary, then we reserve the page by
  * not freeing it to the buddy allocator.
  */
+/*
+ * Hand a run of pages, all on the same node, to the buddy allocator in the
+ * largest naturally aligned chunks possible rather than page by page, which
+ * would also have free_heap_pages() merge each of them with its buddies.
+ */
+static void _init_heap_pages(const struct page_info *pg,
+                             unsigned long nr_pages, bool need_scrub)
+{
+    unsigned long s = mfn_x(page_to_mfn(pg)), e = s + nr_pages;
+
+    while ( s < e )
+    {
+        unsigned int order = min_t(unsigned int, MAX_ORDER, flsl(e - s) - 1);
+
+        if ( s )
+            order = min_t(unsigned int, order, ffsl(s) - 1);
+        free_heap_pages(mfn_to_page(_mfn(s)), order, need_scrub);
+        s += 1UL << order;
+    }
+}
+
 static void init_heap_pages(
     struct page_info *pg, unsigned long nr_pages)
 {
-    unsigned long i;
-    bool idle_scrub = false;
+    unsigned long i, n;
+    bool need_scrub = scrub_debug;
 
     /*
      * Keep MFN 0 away from the buddy allocator to avoid crossing zone
@@ -1794,35 +2210,35 @@ static void init_heap_pages(
     spin_unlock(&heap_lock);
 
     if ( system_state < SYS_STATE_active && opt_bootscrub == BOOTSCRUB_IDLE )
-        idle_scrub = true;
+        need_scrub = true;
 
-    for ( i = 0; i < nr_pages; i++ )
+    for ( i = 0; i < nr_pages; i += n )
     {
-        unsigned int nid = phys_to_nid(page_to_maddr(pg+i));
+        unsigned int nid = phys_to_nid(page_to_maddr(pg + i));
+        unsigned long head = 0, tail = 0;
+
+        /* Find the run of pages on this node. */
+        for ( n = 1; i + n < nr_pages; n++ )
+            if ( phys_to_nid(page_to_maddr(pg + i + n)) != nid )
+                break;
 
         if ( unlikely(!avail[nid]) )
         {
             unsigned long s = mfn_x(page_to_mfn(pg + i));
-            unsigned long e = mfn_x(mfn_add(page_to_mfn(pg + nr_pages - 1), 1));
-            bool use_tail = (nid == phys_to_nid(pfn_to_paddr(e - 1))) &&
-                            !(s & ((1UL << MAX_ORDER) - 1)) &&
+            unsigned long e = s + n;
+            bool use_tail = !(s & ((1UL << MAX_ORDER) - 1)) &&
                             (find_first_set_bit(e) <= find_first_set_bit(s));
-            unsigned long n;
+            unsigned long used = init_node_heap(nid, s, n, &use_tail);
 
-            n = init_node_heap(nid, mfn_x(page_to_mfn(pg + i)), nr_pages - i,
-                               &use_tail);
-            BUG_ON(i + n > nr_pages);
-            if ( n && !use_tail )
-            {
-                i += n - 1;
-                continue;
-            }
-            if ( i + n == nr_pages )
-                break;
-            nr_pages -= n;
+            BUG_ON(used > n);
+            if ( use_tail )
+                tail = used;
+            else
+                head = used;
         }
 
-        free_heap_pages(pg + i, 0, scrub_debug || idle_scrub);
+        if ( head + tail < n )
+            _init_heap_pages(pg + i + head, n - head - tail, need_scrub);
     }
 }
 
@@ -1847,10 +2263,209 @@ static unsigned long avail_heap_pages(
     return free_pages;
 }
 
+#ifdef CONFIG_LLC_COLORING
+/*************************
+ * COLORED SIDE-ALLOCATOR
+ *
+ * With LLC coloring, all memory beyond the first buddy-alloc-size bytes is
+ * kept in per-color lists of single free pages, which are handed out to
+ * domains according to their colors.  Free pages in the color heap stay
+ * in the PGC_state_inuse state with PGC_colored set, without an owner,
+ * and with u.free.first_dirty telling whether they still need scrubbing.
+ * The lists and counters are protected by heap_lock.
+ */
+
+static unsigned long __initdata buddy_alloc_size =
+    MB(CONFIG_BUDDY_ALLOCATOR_SIZE);
+size_param("buddy-alloc-size", buddy_alloc_size);
+
+static struct page_list_head color_heap[NR_LLC_COLORS];
+static unsigned long free_colored_pages[NR_LLC_COLORS];
+static unsigned long total_colored_pages;
+
+static bool domain_is_colored(const struct domain *d)
+{
+    return llc_coloring_enabled && d && !is_system_domain(d) &&
+           !is_domain_direct_mapped(d);
+}
+
+static void free_color_heap_page(struct page_info *pg, bool need_scrub)
+{
+    unsigned int color = page_to_llc_color(pg);
+
+    spin_lock(&heap_lock);
+
+    /* Pages being offlined leave the color heap for good. */
+    if ( unlikely(!page_state_is(pg, inuse)) )
+    {
+        pg->count_info &= ~PGC_colored;
+        __free_heap_pages(pg, 0, need_scrub);
+        spin_unlock(&heap_lock);
+        return;
+    }
+
+    /* As per __free_heap_pages(). */
+    pg->u.free.need_tlbflush = (page_get_owner(pg) != NULL);
+    if ( pg->u.free.need_tlbflush )
+        page_set_tlbflush_timestamp(pg);
+    page_set_owner(pg, NULL);
+    set_gpfn_from_mfn(mfn_x(page_to_mfn(pg)), INVALID_M2P_ENTRY);
+
+    pg->count_info = PGC_state_inuse | PGC_colored;
+    pg->u.free.first_dirty = need_scrub ? 0 : INVALID_DIRTY_IDX;
+    if ( need_scrub )
+        poison_one_page(pg);
+
+    page_list_add(pg, &color_heap[color]);
+    free_colored_pages[color]++;
+    total_colored_pages++;
+
+    spin_unlock(&heap_lock);
+}
+
+/* Allocate a page of whichever of the domain's colors has most left. */
+static struct page_info *alloc_color_heap_page(unsigned int memflags,
+                                               struct domain *d)
+{
+    struct page_info *pg;
+    unsigned int i, color;
+    unsigned long max;
+    bool need_tlbflush = false, dirty;
+    uint32_t tlbflush_timestamp = 0;
+
+    spin_lock(&heap_lock);
+
+    for ( ; ; )
+    {
+        for ( max = 0, color = 0, i = 0; i < d->num_llc_colors; i++ )
+            if ( free_colored_pages[d->llc_colors[i]] > max )
+            {
+                color = d->llc_colors[i];
+                max = free_colored_pages[color];
+            }
+
+        if ( !max )
+        {
+            spin_unlock(&heap_lock);
+            return NULL;
+        }
+
+        pg = page_list_remove_head(&color_heap[color]);
+        free_colored_pages[color]--;
+        total_colored_pages--;
+
+        if ( likely(page_state_is(pg, inuse)) )
+            break;
+
+        /* Offlined while free: let the buddy allocator deal with it. */
+        pg->count_info &= ~PGC_colored;
+        __free_heap_pages(pg, 0, false);
+    }
+
+    dirty = pg->u.free.first_dirty != INVALID_DIRTY_IDX;
+
+    if ( !(memflags & MEMF_no_tlbflush) )
+        accumulate_tlbflush(&need_tlbflush, pg, &tlbflush_timestamp);
+
+    /* Initialise fields which have other uses for free pages. */
+    pg->u.inuse.type_info = 0;
+    page_set_owner(pg, NULL);
+
+    spin_unlock(&heap_lock);
+
+    if ( dirty )
+    {
+        if ( !(memflags & MEMF_no_scrub) )
+            scrub_one_page(pg);
+    }
+    else if ( scrub_debug && !(memflags & MEMF_no_scrub) )
+        check_one_page(pg);
+
+    flush_page_to_ram(mfn_x(page_to_mfn(pg)),
+                      !(memflags & MEMF_no_icache_flush));
+
+    if ( need_tlbflush )
+        filtered_flush_tlb_mask(tlbflush_timestamp);
+
+    return pg;
+}
+
+static void __init init_color_heap(void)
+{
+    unsigned int color;
+
+    for ( color = 0; color < ARRAY_SIZE(color_heap); color++ )
+        INIT_PAGE_LIST_HEAD(&color_heap[color]);
+}
+
+static void __init init_color_heap_pages(struct page_info *pg,
+                                         unsigned long nr_pages)
+{
+    bool need_scrub = opt_bootscrub != BOOTSCRUB_OFF || scrub_debug;
+    unsigned long i;
+
+    if ( buddy_alloc_size )
+    {
+        unsigned long buddy_pages = min(PFN_DOWN(buddy_alloc_size), nr_pages);
+
+        init_heap_pages(pg, buddy_pages);
+        buddy_alloc_size -= buddy_pages << PAGE_SHIFT;
+        pg += buddy_pages;
+        nr_pages -= buddy_pages;
+    }
+
+    for ( i = 0; i < nr_pages; i++ )
+    {
+        pg[i].count_info = PGC_state_inuse | PGC_colored;
+        page_set_owner(&pg[i], NULL);
+        free_color_heap_page(&pg[i], need_scrub);
+    }
+}
+
+static void dump_color_heap(void)
+{
+    unsigned int color;
+
+    if ( !llc_coloring_enabled )
+        return;
+
+    printk("    Color heap: %lukB free\n",
+           total_colored_pages << (PAGE_SHIFT - 10));
+    for ( color = 0; color < get_max_nr_llc_colors(); color++ )
+        printk("    color[%u]: %lukB free\n", color,
+               free_colored_pages[color] << (PAGE_SHIFT - 10));
+}
+
+#else /* !CONFIG_LLC_COLORING */
+
+#define domain_is_colored(d) ((void)(d), false)
+#define total_colored_pages 0UL
+#define init_color_heap() ((void)0)
+#define init_color_heap_pages init_heap_pages
+
+static void free_color_heap_page(struct page_info *pg, bool need_scrub)
+{
+    ASSERT_UNREACHABLE();
+}
+
+static struct page_info *alloc_color_heap_page(unsigned int memflags,
+                                               struct domain *d)
+{
+    ASSERT_UNREACHABLE();
+    return NULL;
+}
+
+static void dump_color_heap(void) {}
+
+#endif /* CONFIG_LLC_COLORING */
+
 void __init end_boot_allocator(void)
 {
     unsigned int i;
 
+    if ( llc_coloring_enabled )
+        init_color_heap();
+
     /* Pages that are free now go to the domain sub-allocator. */
     for ( i = 0; i < nr_bootmem_regions; i++ )
     {
@@ -1866,7 +2481,13 @@ void __init end_boot_allocator(void)
     for ( i = nr_bootmem_regions; i-- > 0; )
     {
         struct bootmem_region *r = &bootmem_region_list[i];
-        if ( r->s < r->e )
+
+        if ( r->s >= r->e )
+            continue;
+
+        if ( llc_coloring_enabled )
+            init_color_heap_pages(mfn_to_page(_mfn(r->s)), r->e - r->s);
+        else
             init_heap_pages(mfn_to_page(_mfn(r->s)), r->e - r->s);
     }
     nr_bootmem_regions = 0;
@@ -1878,6 +2499,10 @@ void __init end_boot_allocator(void)
     if ( dma_bitsize )
         printk(" DMA width %u bits", dma_bitsize);
     printk("\n");
+
+    nodes_and(slow_nodes, slow_nodes, node_online_map);
+    if ( !nodes_empty(slow_nodes) )
+        printk("Slow memory nodes: %*pbl\n", NODEMASK_PR(&slow_nodes));
 }
 
 static void __init smp_scrub_heap_pages(void *data)
@@ -2274,7 +2899,7 @@ int assign_pages(
 
         for ( i = 0; i < (1ul << order); i++ )
         {
-            ASSERT(!(pg[i].count_info & ~PGC_extra));
+            ASSERT(!(pg[i].count_info & ~(PGC_extra | PGC_colored)));
             if ( pg[i].count_info & PGC_extra )
                 extra_pages++;
         }
@@ -2312,8 +2937,8 @@ int assign_pages(
         ASSERT(page_get_owner(&pg[i]) == NULL);
         page_set_owner(&pg[i], d);
         smp_wmb(); /* Domain pointer must be visible before updating refcnt. */
-        pg[i].count_info =
-            (pg[i].count_info & PGC_extra) | PGC_allocated | 1;
+        pg[i].count_info = (pg[i].count_info & (PGC_extra | PGC_colored)) |
+                           PGC_allocated | 1;
         page_list_add_tail(&pg[i], page_to_list(d, &pg[i]));
     }
 
@@ -2340,16 +2965,28 @@ struct page_info *alloc_domheap_pages(
     if ( memflags & MEMF_no_owner )
         memflags |= MEMF_no_refcount;
 
-    if ( !dma_bitsize )
-        memflags &= ~MEMF_no_dma;
-    else if ( (dma_zone = bits_to_zone(dma_bitsize)) < zone_hi )
-        pg = alloc_heap_pages(dma_zone + 1, zone_hi, order, memflags, d);
+    /*
+     * Colored domains get their memory from the color heap only, one page
+     * at a time: callers fall back to order 0 when larger requests fail.
+     */
+    if ( !(memflags & MEMF_no_owner) && domain_is_colored(d) )
+    {
+        if ( order || (pg = alloc_color_heap_page(memflags, d)) == NULL )
+            return NULL;
+    }
+    else
+    {
+        if ( !dma_bitsize )
+            memflags &= ~MEMF_no_dma;
+        else if ( (dma_zone = bits_to_zone(dma_bitsize)) < zone_hi )
+            pg = alloc_heap_pages(dma_zone + 1, zone_hi, order, memflags, d);
 
-    if ( (pg == NULL) &&
-         ((memflags & MEMF_no_dma) ||
-          ((pg = alloc_heap_pages(MEMZONE_XEN + 1, zone_hi, order,
-                                  memflags, d)) == NULL)) )
-         return NULL;
+        if ( (pg == NULL) &&
+             ((memflags & MEMF_no_dma) ||
+              ((pg = alloc_heap_pages(MEMZONE_XEN + 1, zone_hi, order,
+                                      memflags, d)) == NULL)) )
+             return NULL;
+    }
 
     if ( d && !(memflags & MEMF_no_owner) )
     {
@@ -2359,13 +2996,16 @@ struct page_info *alloc_domheap_pages(
 
             for ( i = 0; i < (1ul << order); i++ )
             {
-                ASSERT(!pg[i].count_info);
-                pg[i].count_info = PGC_extra;
+                ASSERT(!(pg[i].count_info & ~PGC_colored));
+                pg[i].count_info |= PGC_extra;
             }
         }
         if ( assign_pages(d, pg, order, memflags) )
         {
-            free_heap_pages(pg, order, memflags & MEMF_no_scrub);
+            if ( pg->count_info & PGC_colored )
+                free_color_heap_page(pg, memflags & MEMF_no_scrub);
+            else
+                free_heap_pages(pg, order, memflags & MEMF_no_scrub);
             return NULL;
         }
     }
@@ -2448,7 +3088,13 @@ void free_domheap_pages(struct page_info *pg, unsigned int order)
             scrub = 1;
         }
 
-        free_heap_pages(pg, order, scrub);
+        if ( pg->count_info & PGC_colored )
+        {
+            ASSERT(!order);
+            free_color_heap_page(pg, scrub);
+        }
+        else
+            free_heap_pages(pg, order, scrub);
     }
 
     if ( drop_dom_ref )
@@ -2473,7 +3119,7 @@ unsigned long avail_domheap_pages(void)
 {
     return avail_heap_pages(MEMZONE_XEN + 1,
                             NR_ZONES - 1,
-                            -1);
+                            -1) + total_colored_pages;
 }
 
 unsigned long avail_node_heap_pages(unsigned int nodeid)
@@ -2507,6 +3153,8 @@ static void pagealloc_info(unsigned char key)
     }
 
     printk("    Dom heap: %lukB free\n", total << (PAGE_SHIFT-10));
+
+    dump_color_heap();
 }
 
 static __init int pagealloc_keyhandler_init(void)
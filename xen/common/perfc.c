@@ -7,15 +7,18 @@
 #include <xen/spinlock.h>
 #include <xen/mm.h>
 #include <xen/guest_access.h>
+#include <xen/hypfs.h>
+#include <xen/init.h>
 #include <public/sysctl.h>
 #include <asm/perfc.h>
 
-#define PERFCOUNTER( var, name )              { name, TYPE_SINGLE, 0 },
-#define PERFCOUNTER_ARRAY( var, name, size )  { name, TYPE_ARRAY,  size },
-#define PERFSTATUS( var, name )               { name, TYPE_S_SINGLE, 0 },
-#define PERFSTATUS_ARRAY( var, name, size )   { name, TYPE_S_ARRAY,  size },
+#define PERFCOUNTER( var, name )              { name, #var, TYPE_SINGLE, 0 },
+#define PERFCOUNTER_ARRAY( var, name, size )  { name, #var, TYPE_ARRAY,  size },
+#define PERFSTATUS( var, name )               { name, #var, TYPE_S_SINGLE, 0 },
+#define PERFSTATUS_ARRAY( var, name, size )   { name, #var, TYPE_S_ARRAY,  size },
 static const struct {
     const char *name;
+    const char *var;
     enum { TYPE_SINGLE, TYPE_ARRAY,
            TYPE_S_SINGLE, TYPE_S_ARRAY
     } type;
@@ -270,6 +273,91 @@ int perfc_control(struct xen_sysctl_perfc_op *pc)
     return rc;
 }
 
+#ifdef CONFIG_HYPFS
+/*
+ * Expose each counter as /perfc/<counter> in hypfs, so that individual
+ * (hot path) counters and histograms can be sampled cheaply without
+ * copying out all counters for all CPUs, as XEN_SYSCTL_perfc_op does.
+ * Counters are presented summed over all online CPUs, as 64-bit values:
+ * single counters as UINT, arrays (histograms) as BLOB of one value per
+ * bucket.
+ */
+struct perfc_hypfs_entry {
+    struct hypfs_entry_leaf leaf;
+    unsigned int idx;          /* index into perfc_info[] */
+    unsigned int first;        /* first slot in perfcounters[] */
+};
+
+static HYPFS_DIR_INIT(perfc_dir, "perfc");
+
+static int perfc_hypfs_read(const struct hypfs_entry *entry,
+                            XEN_GUEST_HANDLE_PARAM(void) uaddr)
+{
+    const struct perfc_hypfs_entry *pe =
+        container_of(entry, const struct perfc_hypfs_entry, leaf.e);
+    unsigned int k, nr = entry->size / sizeof(uint64_t);
+
+    for ( k = 0; k < nr; k++ )
+    {
+        unsigned int cpu;
+        uint64_t sum = 0;
+
+        for_each_online_cpu ( cpu )
+            sum += per_cpu(perfcounters, cpu)[pe->first + k];
+        if ( perfc_info[pe->idx].type == TYPE_S_SINGLE ||
+             perfc_info[pe->idx].type == TYPE_S_ARRAY )
+            sum = (perfc_t)sum;
+
+        if ( copy_to_guest_offset(uaddr, k * sizeof(sum), &sum, 1) )
+            return -EFAULT;
+    }
+
+    return 0;
+}
+
+static const struct hypfs_funcs perfc_hypfs_funcs = {
+    .enter = hypfs_node_enter,
+    .exit = hypfs_node_exit,
+    .read = perfc_hypfs_read,
+    .write = hypfs_write_deny,
+    .getsize = hypfs_getsize,
+    .findentry = hypfs_leaf_findentry,
+};
+
+static int __init perfc_hypfs_init(void)
+{
+    struct perfc_hypfs_entry *pe = xzalloc_array(struct perfc_hypfs_entry,
+                                                 NR_PERFCTRS);
+    unsigned int i, j;
+
+    if ( !pe )
+        return -ENOMEM;
+
+    hypfs_add_dir(&hypfs_root, &perfc_dir, true);
+
+    for ( i = j = 0; i < NR_PERFCTRS; i++ )
+    {
+        bool array = perfc_info[i].type == TYPE_ARRAY ||
+                     perfc_info[i].type == TYPE_S_ARRAY;
+        unsigned int nr = array ? perfc_info[i].nr_elements : 1;
+
+        pe[i].idx = i;
+        pe[i].first = j;
+        pe[i].leaf.e.type = array ? XEN_HYPFS_TYPE_BLOB : XEN_HYPFS_TYPE_UINT;
+        pe[i].leaf.e.encoding = XEN_HYPFS_ENC_PLAIN;
+        pe[i].leaf.e.name = perfc_info[i].var;
+        pe[i].leaf.e.size = nr * sizeof(uint64_t);
+        pe[i].leaf.e.funcs = &perfc_hypfs_funcs;
+        hypfs_add_leaf(&perfc_dir, &pe[i].leaf, true);
+
+        j += nr;
+    }
+
+    return 0;
+}
+__initcall(perfc_hypfs_init);
+#endif /* CONFIG_HYPFS */
+
 /*
  * Local variables:
  * mode: C
@@ -10,11 +10,16 @@
 #include <xen/sched.h>
 #include <xen/errno.h>
 #include <xen/rangeset.h>
+#include <xen/rbtree.h>
 #include <xsm/xsm.h>
 
-/* An inclusive range [s,e] and pointer to next range in ascending order. */
+/*
+ * An inclusive range [s,e], threaded on the set's list in ascending order
+ * and indexed by the same order in the set's tree.
+ */
 struct range {
     struct list_head list;
+    struct rb_node node;
     unsigned long s, e;
 };
 
@@ -23,8 +28,9 @@ struct rangeset {
     struct list_head rangeset_list;
     struct domain   *domain;
 
-    /* Ordered list of ranges contained in this set, and protecting lock. */
+    /* Ordered list and tree of ranges contained in this set, and lock. */
     struct list_head range_list;
+    struct rb_root   range_tree;
 
     /* Number of ranges that can be allocated */
     long             nr_ranges;
@@ -38,20 +44,33 @@ struct rangeset {
 };
 
 /*****************************
- * Private range functions hide the underlying linked-list implemnetation.
+ * Private range functions hide the underlying implementation: a list for
+ * in-order walks, and a red-black tree giving O(log n) lookups for sets with
+ * many ranges (e.g. large I/O port or MMIO permission sets).
+ *
+ * Ranges are disjoint and kept in order, and their bounds are only ever
+ * adjusted in ways which preserve that order, so the tree never needs
+ * re-sorting when a range is modified in place.
  */
 
 /* Find highest range lower than or containing s. NULL if no such range. */
 static struct range *find_range(
     struct rangeset *r, unsigned long s)
 {
-    struct range *x = NULL, *y;
+    struct rb_node *n = r->range_tree.rb_node;
+    struct range *x = NULL;
 
-    list_for_each_entry ( y, &r->range_list, list )
+    while ( n )
     {
+        struct range *y = rb_entry(n, struct range, node);
+
         if ( y->s > s )
-            break;
-        x = y;
+            n = n->rb_left;
+        else
+        {
+            x = y;
+            n = n->rb_right;
+        }
     }
 
     return x;
@@ -79,16 +98,39 @@ static struct range *next_range(
 static void insert_range(
     struct rangeset *r, struct range *x, struct range *y)
 {
+    struct rb_node *parent, **link;
+
     list_add(&y->list, (x != NULL) ? &x->list : &r->range_list);
+
+    /* Link y as the in-order successor of x, or as the first node. */
+    if ( x == NULL )
+    {
+        parent = rb_first(&r->range_tree);
+        link = parent ? &parent->rb_left : &r->range_tree.rb_node;
+    }
+    else if ( x->node.rb_right == NULL )
+    {
+        parent = &x->node;
+        link = &parent->rb_right;
+    }
+    else
+    {
+        parent = rb_next(&x->node);
+        link = &parent->rb_left;
+    }
+
+    rb_link_node(&y->node, parent, link);
+    rb_insert_color(&y->node, &r->range_tree);
 }
 
-/* Remove a range from its list and free it. */
+/* Remove a range from its list and tree, and free it. */
 static void destroy_range(
     struct rangeset *r, struct range *x)
 {
     r->nr_ranges++;
 
     list_del(&x->list);
+    rb_erase(&x->node, &r->range_tree);
     xfree(x);
 }
 
@@ -295,7 +337,8 @@ int rangeset_report_ranges(
 
     read_lock(&r->lock);
 
-    for ( x = first_range(r); x && (x->s <= e) && !rc; x = next_range(r, x) )
+    x = find_range(r, s) ?: first_range(r);
+    for ( ; x && (x->s <= e) && !rc; x = next_range(r, x) )
         if ( x->e >= s )
             rc = cb(max(x->s, s), min(x->e, e), ctxt);
 
@@ -431,6 +474,7 @@ struct rangeset *rangeset_new(
 
     rwlock_init(&r->lock);
     INIT_LIST_HEAD(&r->range_list);
+    r->range_tree = RB_ROOT;
     r->nr_ranges = -1;
 
     BUG_ON(flags & ~RANGESETF_prettyprint_hex);
@@ -512,6 +556,7 @@ void rangeset_domain_destroy(
 void rangeset_swap(struct rangeset *a, struct rangeset *b)
 {
     LIST_HEAD(tmp);
+    struct rb_root tmp_tree;
 
     if ( a < b )
     {
@@ -528,6 +573,10 @@ void rangeset_swap(struct rangeset *a, struct rangeset *b)
     list_splice_init(&b->range_list, &a->range_list);
     list_splice(&tmp, &b->range_list);
 
+    tmp_tree = a->range_tree;
+    a->range_tree = b->range_tree;
+    b->range_tree = tmp_tree;
+
     write_unlock(&a->lock);
     write_unlock(&b->lock);
 }
@@ -58,6 +58,7 @@ static struct rcu_ctrlblk {
     cpumask_t   cpumask; /* CPUs that need to switch in order ... */
     cpumask_t   idle_cpumask; /* ... unless they are already idle */
     /* for current batch to proceed.        */
+    unsigned int nr_pending; /* Number of CPUs set in cpumask */
 } __cacheline_aligned rcu_ctrlblk = {
     .cur = -300,
     .completed = -300,
@@ -365,6 +366,7 @@ static void rcu_start_batch(struct rcu_ctrlblk *rcp)
         */
         smp_mb();
         cpumask_andnot(&rcp->cpumask, &cpu_online_map, &rcp->idle_cpumask);
+        rcp->nr_pending = cpumask_weight(&rcp->cpumask);
     }
 }
 
@@ -375,8 +377,13 @@ static void rcu_start_batch(struct rcu_ctrlblk *rcp)
  */
 static void cpu_quiet(int cpu, struct rcu_ctrlblk *rcp)
 {
-    cpumask_clear_cpu(cpu, &rcp->cpumask);
-    if (cpumask_empty(&rcp->cpumask)) {
+    /*
+     * Keep track of the number of CPUs left, rather than scanning the
+     * whole mask (under the global lock) for every CPU reporting.
+     */
+    if (cpumask_test_and_clear_cpu(cpu, &rcp->cpumask))
+        rcp->nr_pending--;
+    if (!rcp->nr_pending) {
         /* batch completed ! */
         rcp->completed = rcp->cur;
         rcu_start_batch(rcp);
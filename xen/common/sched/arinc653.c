@@ -61,6 +61,11 @@
  */
 #define SCHED_PRIV(s) ((a653sched_priv_t *)((s)->sched_data))
 
+/**
+ * Return the per-pCPU scheduler data of the given physical CPU
+ */
+#define APCPU(cpu) ((a653sched_pcpu_t *)get_sched_res(cpu)->sched_priv)
+
 /**************************************************************************
  * Private Type Definitions                                               *
  **************************************************************************/
@@ -79,6 +84,8 @@ typedef struct arinc653_unit_s
     /* list holds the linked list information for the list this UNIT
      * is stored in */
     struct list_head    list;
+    /* sched_cpu holds the first pCPU whose schedule lists this UNIT, or -1 */
+    int                 sched_cpu;
 } arinc653_unit_t;
 
 /**
@@ -101,48 +108,88 @@ typedef struct sched_entry_s
 } sched_entry_t;
 
 /**
- * This structure defines data that is global to an instance of the scheduler
+ * The a653sched_sched_t structure holds an ARINC 653 schedule, i.e., the
+ * sequence of entries making up a major frame.
  */
-typedef struct a653sched_priv_s
+typedef struct a653sched_sched_s
 {
-    /* lock for the whole pluggable scheduler, nests inside cpupool_lock */
-    spinlock_t lock;
-
     /**
-     * This array holds the active ARINC 653 schedule.
+     * This array holds the ARINC 653 schedule.
      *
      * When the system tries to start a new UNIT, this schedule is scanned
      * to look for a matching (handle, UNIT #) pair. If both the handle (UUID)
      * and UNIT number match, then the UNIT is allowed to run. Its run time
      * (per major frame) is given in the third entry of the schedule.
      */
-    sched_entry_t schedule[ARINC653_MAX_DOMAINS_PER_SCHEDULE];
+    sched_entry_t entries[ARINC653_MAX_DOMAINS_PER_SCHEDULE];
 
     /**
      * This variable holds the number of entries that are valid in
-     * the arinc653_schedule table.
+     * the entries table.
      *
      * This is not necessarily the same as the number of domains in the
      * schedule. A domain could be listed multiple times within the schedule,
      * or a domain with multiple UNITs could have a different
      * schedule entry for each UNIT.
      */
-    unsigned int num_schedule_entries;
+    unsigned int num_entries;
 
     /**
      * the major frame time for the ARINC 653 schedule.
      */
     s_time_t major_frame;
+} a653sched_sched_t;
+
+/**
+ * The a653sched_pcpu_t structure holds the state of a physical CPU. Each
+ * pCPU runs its own schedule, with its own major frame.
+ *
+ * The schedule is only changed while holding both the scheduler lock and
+ * the pCPU's scheduling lock, so a653sched_do_schedule() only needs the
+ * latter (which it is called with).
+ */
+typedef struct a653sched_pcpu_s
+{
+    /* the schedule run by this pCPU */
+    a653sched_sched_t sched;
+
+    /* the time that the next major frame starts */
+    s_time_t next_major_frame;
+
+    /* the entry currently being run, and until when */
+    unsigned int sched_index;
+    s_time_t next_switch_time;
+
+    /* the pCPU this data belongs to */
+    unsigned int cpu;
+
+    /* list holds the linked list information for the list of pCPUs */
+    struct list_head list;
+} a653sched_pcpu_t;
+
+/**
+ * This structure defines data that is global to an instance of the scheduler
+ */
+typedef struct a653sched_priv_s
+{
+    /* lock for the whole pluggable scheduler, nests inside cpupool_lock */
+    spinlock_t lock;
 
     /**
-     * the time that the next major frame starts
+     * The schedule installed for all pCPUs, which pCPUs added to the pool
+     * start with as well.
      */
-    s_time_t next_major_frame;
+    a653sched_sched_t sched;
 
     /**
      * pointers to all Xen UNIT structures for iterating through
      */
     struct list_head unit_list;
+
+    /**
+     * the per-pCPU data of all the pCPUs of the pool
+     */
+    struct list_head pcpu_list;
 } a653sched_priv_t;
 
 /**************************************************************************
@@ -196,22 +243,92 @@ static struct sched_unit *find_unit(
     return NULL;
 }
 
+/**
+ * This function searches the pCPU list for the data of the given pCPU.
+ *
+ * @param ops       Pointer to this instance of the scheduler structure
+ * @param cpu       pCPU number
+ *
+ * @return          <ul>
+ *                  <li> Pointer to the pCPU data if the pCPU is ours
+ *                  <li> NULL otherwise
+ *                  </ul>
+ */
+static a653sched_pcpu_t *find_pcpu(const struct scheduler *ops,
+                                   unsigned int cpu)
+{
+    a653sched_pcpu_t *apc;
+
+    list_for_each_entry ( apc, &SCHED_PRIV(ops)->pcpu_list, list )
+        if ( apc->cpu == cpu )
+            return apc;
+
+    return NULL;
+}
+
 /**
  * This function updates the pointer to the Xen UNIT structure for each entry
- * in the ARINC 653 schedule.
+ * in the ARINC 653 schedule of every pCPU, and the pCPU each UNIT is
+ * scheduled on. Must be called with the scheduler lock held.
  *
  * @param ops       Pointer to this instance of the scheduler structure
  * @return          <None>
  */
 static void update_schedule_units(const struct scheduler *ops)
 {
-    unsigned int i, n_entries = SCHED_PRIV(ops)->num_schedule_entries;
+    a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
+    arinc653_unit_t *aunit;
+    a653sched_pcpu_t *apc;
+    unsigned int i;
+
+    list_for_each_entry ( aunit, &sched_priv->unit_list, list )
+        aunit->sched_cpu = -1;
+
+    list_for_each_entry ( apc, &sched_priv->pcpu_list, list )
+    {
+        spinlock_t *lock = pcpu_schedule_lock(apc->cpu);
+
+        for ( i = 0; i < apc->sched.num_entries; i++ )
+        {
+            struct sched_unit *unit =
+                find_unit(ops, apc->sched.entries[i].dom_handle,
+                          apc->sched.entries[i].unit_id);
+
+            apc->sched.entries[i].unit = unit;
+            if ( unit && AUNIT(unit)->sched_cpu < 0 )
+                AUNIT(unit)->sched_cpu = apc->cpu;
+        }
 
-    for ( i = 0; i < n_entries; i++ )
-        SCHED_PRIV(ops)->schedule[i].unit =
-            find_unit(ops,
-                      SCHED_PRIV(ops)->schedule[i].dom_handle,
-                      SCHED_PRIV(ops)->schedule[i].unit_id);
+        pcpu_schedule_unlock(lock, apc->cpu);
+    }
+}
+
+/**
+ * This function installs a schedule on a pCPU. The new schedule takes
+ * effect immediately. We do not even wait for the current major frame to
+ * expire.
+ *
+ * @param apc       Pointer to the pCPU data
+ * @param sched     Pointer to the schedule
+ * @param now       Current time
+ */
+static void pcpu_install_schedule(a653sched_pcpu_t *apc,
+                                  const a653sched_sched_t *sched,
+                                  s_time_t now)
+{
+    spinlock_t *lock = pcpu_schedule_lock(apc->cpu);
+
+    apc->sched = *sched;
+
+    /*
+     * Signal a new major frame to begin. The next major frame is set up by
+     * the do_schedule callback function when it is next invoked.
+     */
+    apc->next_major_frame = now;
+
+    pcpu_schedule_unlock(lock, apc->cpu);
+
+    cpu_raise_softirq(apc->cpu, SCHEDULE_SOFTIRQ);
 }
 
 /**
@@ -231,24 +348,25 @@ arinc653_sched_set(
     struct xen_sysctl_arinc653_schedule *schedule)
 {
     a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
-    s_time_t total_runtime = 0;
+    a653sched_sched_t *new_sched;
+    a653sched_pcpu_t *apc = NULL;
+    s_time_t total_runtime = 0, now;
     unsigned int i;
     unsigned long flags;
     int rc = -EINVAL;
 
-    spin_lock_irqsave(&sched_priv->lock, flags);
-
-    /* Check for valid major frame and number of schedule entries. */
-    if ( (schedule->major_frame <= 0)
+    /* Check for valid flags, major frame and number of schedule entries. */
+    if ( (schedule->flags & ~XEN_ARINC653_SCHED_CPU)
+         || (schedule->major_frame <= 0)
          || (schedule->num_sched_entries < 1)
          || (schedule->num_sched_entries > ARINC653_MAX_DOMAINS_PER_SCHEDULE) )
-        goto fail;
+        return -EINVAL;
 
     for ( i = 0; i < schedule->num_sched_entries; i++ )
     {
         /* Check for a valid run time. */
         if ( schedule->sched_entries[i].runtime <= 0 )
-            goto fail;
+            return -EINVAL;
 
         /* Add this entry's run time to total run time. */
         total_runtime += schedule->sched_entries[i].runtime;
@@ -259,36 +377,53 @@ arinc653_sched_set(
      * indicated by comparing the total run time to the major frame length.
      */
     if ( total_runtime > schedule->major_frame )
-        goto fail;
+        return -EINVAL;
 
-    /* Copy the new schedule into place. */
-    sched_priv->num_schedule_entries = schedule->num_sched_entries;
-    sched_priv->major_frame = schedule->major_frame;
+    /* Too large for the stack: build the new schedule separately. */
+    new_sched = xzalloc(a653sched_sched_t);
+    if ( new_sched == NULL )
+        return -ENOMEM;
+
+    new_sched->num_entries = schedule->num_sched_entries;
+    new_sched->major_frame = schedule->major_frame;
     for ( i = 0; i < schedule->num_sched_entries; i++ )
     {
-        memcpy(sched_priv->schedule[i].dom_handle,
+        memcpy(new_sched->entries[i].dom_handle,
                schedule->sched_entries[i].dom_handle,
-               sizeof(sched_priv->schedule[i].dom_handle));
-        sched_priv->schedule[i].unit_id =
+               sizeof(new_sched->entries[i].dom_handle));
+        new_sched->entries[i].unit_id =
             schedule->sched_entries[i].vcpu_id;
-        sched_priv->schedule[i].runtime =
+        new_sched->entries[i].runtime =
             schedule->sched_entries[i].runtime;
     }
-    update_schedule_units(ops);
 
-    /*
-     * The newly-installed schedule takes effect immediately. We do not even
-     * wait for the current major frame to expire.
-     *
-     * Signal a new major frame to begin. The next major frame is set up by
-     * the do_schedule callback function when it is next invoked.
-     */
-    sched_priv->next_major_frame = NOW();
+    spin_lock_irqsave(&sched_priv->lock, flags);
+
+    if ( schedule->flags & XEN_ARINC653_SCHED_CPU )
+    {
+        apc = find_pcpu(ops, schedule->cpu);
+        if ( apc == NULL )
+            goto fail;
+    }
+
+    now = NOW();
+
+    /* Copy the new schedule into place. */
+    if ( apc != NULL )
+        pcpu_install_schedule(apc, new_sched, now);
+    else
+    {
+        sched_priv->sched = *new_sched;
+        list_for_each_entry ( apc, &sched_priv->pcpu_list, list )
+            pcpu_install_schedule(apc, new_sched, now);
+    }
+    update_schedule_units(ops);
 
     rc = 0;
 
  fail:
     spin_unlock_irqrestore(&sched_priv->lock, flags);
+    xfree(new_sched);
     return rc;
 }
 
@@ -308,22 +443,42 @@ arinc653_sched_get(
     struct xen_sysctl_arinc653_schedule *schedule)
 {
     a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
+    const a653sched_sched_t *sched = &sched_priv->sched;
+    spinlock_t *lock = NULL;
+    unsigned int cpu = schedule->cpu;
     unsigned int i;
     unsigned long flags;
 
     spin_lock_irqsave(&sched_priv->lock, flags);
 
-    schedule->num_sched_entries = sched_priv->num_schedule_entries;
-    schedule->major_frame = sched_priv->major_frame;
-    for ( i = 0; i < sched_priv->num_schedule_entries; i++ )
+    if ( schedule->flags & XEN_ARINC653_SCHED_CPU )
+    {
+        const a653sched_pcpu_t *apc = find_pcpu(ops, cpu);
+
+        if ( apc == NULL )
+        {
+            spin_unlock_irqrestore(&sched_priv->lock, flags);
+            return -EINVAL;
+        }
+
+        lock = pcpu_schedule_lock(cpu);
+        sched = &apc->sched;
+    }
+
+    schedule->num_sched_entries = sched->num_entries;
+    schedule->major_frame = sched->major_frame;
+    for ( i = 0; i < sched->num_entries; i++ )
     {
         memcpy(schedule->sched_entries[i].dom_handle,
-               sched_priv->schedule[i].dom_handle,
-               sizeof(sched_priv->schedule[i].dom_handle));
-        schedule->sched_entries[i].vcpu_id = sched_priv->schedule[i].unit_id;
-        schedule->sched_entries[i].runtime = sched_priv->schedule[i].runtime;
+               sched->entries[i].dom_handle,
+               sizeof(sched->entries[i].dom_handle));
+        schedule->sched_entries[i].vcpu_id = sched->entries[i].unit_id;
+        schedule->sched_entries[i].runtime = sched->entries[i].runtime;
     }
 
+    if ( lock )
+        pcpu_schedule_unlock(lock, cpu);
+
     spin_unlock_irqrestore(&sched_priv->lock, flags);
 
     return 0;
@@ -354,9 +509,9 @@ a653sched_init(struct scheduler *ops)
 
     ops->sched_data = prv;
 
-    prv->next_major_frame = 0;
     spin_lock_init(&prv->lock);
     INIT_LIST_HEAD(&prv->unit_list);
+    INIT_LIST_HEAD(&prv->pcpu_list);
 
     return 0;
 }
@@ -369,10 +524,72 @@ a653sched_init(struct scheduler *ops)
 static void
 a653sched_deinit(struct scheduler *ops)
 {
+    ASSERT(list_empty(&SCHED_PRIV(ops)->pcpu_list));
+
     xfree(SCHED_PRIV(ops));
     ops->sched_data = NULL;
 }
 
+/**
+ * This function allocates scheduler-specific data for a physical CPU
+ *
+ * @param ops       Pointer to this instance of the scheduler structure
+ * @param cpu       The cpu being added to the scheduler
+ *
+ * @return          Pointer to the allocated data
+ */
+static void *
+a653sched_alloc_pdata(const struct scheduler *ops, int cpu)
+{
+    a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
+    a653sched_pcpu_t *apc;
+    unsigned long flags;
+
+    apc = xzalloc(a653sched_pcpu_t);
+    if ( apc == NULL )
+        return ERR_PTR(-ENOMEM);
+
+    apc->cpu = cpu;
+
+    spin_lock_irqsave(&sched_priv->lock, flags);
+
+    /* Start with the schedule installed for all pCPUs. */
+    apc->sched = sched_priv->sched;
+    list_add_tail(&apc->list, &sched_priv->pcpu_list);
+    update_schedule_units(ops);
+
+    spin_unlock_irqrestore(&sched_priv->lock, flags);
+
+    return apc;
+}
+
+/**
+ * This function frees scheduler-specific data for a physical CPU
+ *
+ * @param ops       Pointer to this instance of the scheduler structure
+ * @param pcpu      Pointer to the data to free
+ * @param cpu       The cpu being removed from the scheduler
+ */
+static void
+a653sched_free_pdata(const struct scheduler *ops, void *pcpu, int cpu)
+{
+    a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
+    a653sched_pcpu_t *apc = pcpu;
+    unsigned long flags;
+
+    if ( apc == NULL )
+        return;
+
+    spin_lock_irqsave(&sched_priv->lock, flags);
+
+    list_del(&apc->list);
+    update_schedule_units(ops);
+
+    spin_unlock_irqrestore(&sched_priv->lock, flags);
+
+    xfree(apc);
+}
+
 /**
  * This function allocates scheduler-specific data for a UNIT
  *
@@ -387,6 +604,7 @@ a653sched_alloc_udata(const struct scheduler *ops, struct sched_unit *unit,
 {
     a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
     arinc653_unit_t *svc;
+    a653sched_pcpu_t *apc;
     unsigned int entry;
     unsigned long flags;
 
@@ -401,23 +619,28 @@ a653sched_alloc_udata(const struct scheduler *ops, struct sched_unit *unit,
     spin_lock_irqsave(&sched_priv->lock, flags);
 
     /*
-     * Add every one of dom0's units to the schedule, as long as there are
-     * slots available.
+     * Add every one of dom0's units to the schedule of the pCPU it has been
+     * placed on, as long as there are slots available.
      */
-    if ( unit->domain->domain_id == 0 )
+    if ( unit->domain->domain_id == 0 &&
+         (apc = find_pcpu(ops, sched_unit_master(unit))) != NULL )
     {
-        entry = sched_priv->num_schedule_entries;
+        spinlock_t *lock = pcpu_schedule_lock(apc->cpu);
+
+        entry = apc->sched.num_entries;
 
         if ( entry < ARINC653_MAX_DOMAINS_PER_SCHEDULE )
         {
-            sched_priv->schedule[entry].dom_handle[0] = '\0';
-            sched_priv->schedule[entry].unit_id = unit->unit_id;
-            sched_priv->schedule[entry].runtime = DEFAULT_TIMESLICE;
-            sched_priv->schedule[entry].unit = unit;
+            apc->sched.entries[entry].dom_handle[0] = '\0';
+            apc->sched.entries[entry].unit_id = unit->unit_id;
+            apc->sched.entries[entry].runtime = DEFAULT_TIMESLICE;
+            apc->sched.entries[entry].unit = unit;
 
-            sched_priv->major_frame += DEFAULT_TIMESLICE;
-            ++sched_priv->num_schedule_entries;
+            apc->sched.major_frame += DEFAULT_TIMESLICE;
+            ++apc->sched.num_entries;
         }
+
+        pcpu_schedule_unlock(lock, apc->cpu);
     }
 
     /*
@@ -428,6 +651,7 @@ a653sched_alloc_udata(const struct scheduler *ops, struct sched_unit *unit,
      */
     svc->unit = unit;
     svc->awake = false;
+    svc->sched_cpu = -1;
     if ( !is_idle_unit(unit) )
         list_add(&svc->list, &SCHED_PRIV(ops)->unit_list);
     update_schedule_units(ops);
@@ -457,10 +681,12 @@ a653sched_free_udata(const struct scheduler *ops, void *priv)
     if ( !is_idle_unit(av->unit) )
         list_del(&av->list);
 
-    xfree(av);
+    /* Drop any reference from the schedules before freeing. */
     update_schedule_units(ops);
 
     spin_unlock_irqrestore(&sched_priv->lock, flags);
+
+    xfree(av);
 }
 
 /**
@@ -513,33 +739,30 @@ a653sched_do_schedule(
     bool tasklet_work_scheduled)
 {
     struct sched_unit *new_task = NULL;
-    static unsigned int sched_index = 0;
-    static s_time_t next_switch_time;
-    a653sched_priv_t *sched_priv = SCHED_PRIV(ops);
     const unsigned int cpu = sched_get_resource_cpu(smp_processor_id());
-    unsigned long flags;
-
-    spin_lock_irqsave(&sched_priv->lock, flags);
+    a653sched_pcpu_t *apc = APCPU(cpu);
+    const a653sched_sched_t *sched = &apc->sched;
 
-    if ( sched_priv->num_schedule_entries < 1 )
-        sched_priv->next_major_frame = now + DEFAULT_TIMESLICE;
-    else if ( now >= sched_priv->next_major_frame )
+    /* We only need the (already held) scheduling lock of this pCPU. */
+    if ( sched->num_entries < 1 )
+        apc->next_major_frame = now + DEFAULT_TIMESLICE;
+    else if ( now >= apc->next_major_frame )
     {
         /* time to enter a new major frame
          * the first time this function is called, this will be true */
         /* start with the first domain in the schedule */
-        sched_index = 0;
-        sched_priv->next_major_frame = now + sched_priv->major_frame;
-        next_switch_time = now + sched_priv->schedule[0].runtime;
+        apc->sched_index = 0;
+        apc->next_major_frame = now + sched->major_frame;
+        apc->next_switch_time = now + sched->entries[0].runtime;
     }
     else
     {
-        while ( (now >= next_switch_time)
-                && (sched_index < sched_priv->num_schedule_entries) )
+        while ( (now >= apc->next_switch_time)
+                && (apc->sched_index < sched->num_entries) )
         {
             /* time to switch to the next domain in this major frame */
-            sched_index++;
-            next_switch_time += sched_priv->schedule[sched_index].runtime;
+            apc->sched_index++;
+            apc->next_switch_time += sched->entries[apc->sched_index].runtime;
         }
     }
 
@@ -547,8 +770,8 @@ a653sched_do_schedule(
      * If we exhausted the domains in the schedule and still have time left
      * in the major frame then switch next at the next major frame.
      */
-    if ( sched_index >= sched_priv->num_schedule_entries )
-        next_switch_time = sched_priv->next_major_frame;
+    if ( apc->sched_index >= sched->num_entries )
+        apc->next_switch_time = apc->next_major_frame;
 
     /*
      * If there are more domains to run in the current major frame, set
@@ -556,8 +779,8 @@ a653sched_do_schedule(
      * Otherwise, set new_task equal to the address of the idle task's
      * sched_unit structure.
      */
-    new_task = (sched_index < sched_priv->num_schedule_entries)
-        ? sched_priv->schedule[sched_index].unit
+    new_task = (apc->sched_index < sched->num_entries)
+        ? sched->entries[apc->sched_index].unit
         : IDLETASK(cpu);
 
     /* Check to see if the new task can be run (awake & runnable). */
@@ -572,9 +795,7 @@ a653sched_do_schedule(
      * Check to make sure we did not miss a major frame.
      * This is a good test for robust partitioning.
      */
-    BUG_ON(now >= sched_priv->next_major_frame);
-
-    spin_unlock_irqrestore(&sched_priv->lock, flags);
+    BUG_ON(now >= apc->next_major_frame);
 
     /* Tasklet work (which runs in idle UNIT context) overrides all else. */
     if ( tasklet_work_scheduled )
@@ -589,7 +810,7 @@ a653sched_do_schedule(
      * Return the amount of time the next domain has to run and the address
      * of the selected task's UNIT structure.
      */
-    prev->next_time = next_switch_time - now;
+    prev->next_time = apc->next_switch_time - now;
     prev->next_task = new_task;
     new_task->migrated = false;
 
@@ -610,13 +831,22 @@ a653sched_pick_resource(const struct scheduler *ops,
 {
     const cpumask_t *online;
     unsigned int cpu;
+    int sched_cpu = AUNIT(unit) ? ACCESS_ONCE(AUNIT(unit)->sched_cpu) : -1;
+
+    online = cpupool_domain_master_cpumask(unit->domain);
+
+    /*
+     * Prefer the pCPU whose schedule the unit is part of, as that is the
+     * only pCPU where it can run.
+     */
+    if ( sched_cpu >= 0 && cpumask_test_cpu(sched_cpu, online) &&
+         cpumask_test_cpu(sched_cpu, unit->cpu_hard_affinity) )
+        return get_sched_res(sched_cpu);
 
     /*
      * If present, prefer unit's current processor, else
      * just find the first valid unit.
      */
-    online = cpupool_domain_master_cpumask(unit->domain);
-
     cpu = cpumask_first(online);
 
     if ( cpumask_test_cpu(sched_unit_master(unit), online)
@@ -631,7 +861,7 @@ a653sched_pick_resource(const struct scheduler *ops,
  *
  * @param new_ops   Pointer to this instance of the scheduler structure
  * @param cpu       The cpu that is changing scheduler
- * @param pdata     scheduler specific PCPU data (we don't have any)
+ * @param pdata     scheduler specific PCPU data
  * @param vdata     scheduler specific UNIT data of the idle unit
  */
 static spinlock_t *
@@ -641,7 +871,7 @@ a653_switch_sched(struct scheduler *new_ops, unsigned int cpu,
     struct sched_resource *sr = get_sched_res(cpu);
     const arinc653_unit_t *svc = vdata;
 
-    ASSERT(!pdata && svc && is_idle_unit(svc->unit));
+    ASSERT(pdata && svc && is_idle_unit(svc->unit));
 
     sched_idle_unit(cpu)->priv = vdata;
 
@@ -675,7 +905,22 @@ a653sched_adjust_global(const struct scheduler *ops,
         rc = arinc653_sched_set(ops, &local_sched);
         break;
     case XEN_SYSCTL_SCHEDOP_getinfo:
+    {
+        uint8_t flags;
+        uint32_t cpu;
+
+        /* The caller selects the pCPU whose schedule is returned. */
+        if ( copy_from_guest(&local_sched, sc->u.sched_arinc653.schedule, 1) )
+        {
+            rc = -EFAULT;
+            break;
+        }
+        flags = local_sched.flags;
+        cpu = local_sched.cpu;
+
         memset(&local_sched, -1, sizeof(local_sched));
+        local_sched.flags = flags;
+        local_sched.cpu = cpu;
         rc = arinc653_sched_get(ops, &local_sched);
         if ( rc )
             break;
@@ -684,6 +929,7 @@ a653sched_adjust_global(const struct scheduler *ops,
             rc = -EFAULT;
         break;
     }
+    }
 
     return rc;
 }
@@ -719,6 +965,8 @@ static const struct scheduler sched_arinc653_def = {
     .pick_resource  = a653sched_pick_resource,
 
     .switch_sched   = a653_switch_sched,
+    .alloc_pdata    = a653sched_alloc_pdata,
+    .free_pdata     = a653sched_free_pdata,
 
     .adjust         = NULL,
     .adjust_global  = a653sched_adjust_global,
@@ -259,6 +259,28 @@ static inline void vcpu_urgent_count_update(struct vcpu *v)
     }
 }
 
+/* Mirror a vCPU's runstate into the area tools may have mapped. */
+static void vcpu_runstate_share(const struct vcpu *v)
+{
+    struct xen_mem_vcpu_runstate *area =
+        ACCESS_ONCE(v->domain->shared_runstate);
+
+    if ( likely(!area) )
+        return;
+
+    area += v->vcpu_id;
+
+    write_atomic(&area->state_entry_time,
+                 v->runstate.state_entry_time | XEN_RUNSTATE_UPDATE);
+    smp_wmb();
+
+    area->state = v->runstate.state;
+    memcpy(area->time, v->runstate.time, sizeof(area->time));
+
+    smp_wmb();
+    write_atomic(&area->state_entry_time, v->runstate.state_entry_time);
+}
+
 static inline void vcpu_runstate_change(
     struct vcpu *v, int new_state, s_time_t new_entry_time)
 {
@@ -287,6 +309,8 @@ static inline void vcpu_runstate_change(
     }
 
     v->runstate.state = new_state;
+
+    vcpu_runstate_share(v);
 }
 
 void sched_guest_idle(void (*idle) (void), unsigned int cpu)
@@ -332,6 +356,74 @@ void vcpu_runstate_get(const struct vcpu *v,
     rcu_read_unlock(&sched_res_rculock);
 }
 
+static unsigned int shared_runstate_order(const struct domain *d)
+{
+    return get_order_from_bytes(d->max_vcpus *
+                                sizeof(struct xen_mem_vcpu_runstate));
+}
+
+/*
+ * Hand out the frames of a domain's shared runstate area, setting it up on
+ * first use.  The area stays around until the domain is destroyed.
+ */
+int sched_acquire_runstate(struct domain *d, unsigned long frame,
+                           unsigned int nr_frames, xen_pfn_t mfn_list[])
+{
+    unsigned int i, order = shared_runstate_order(d);
+    struct xen_mem_vcpu_runstate *area;
+    struct vcpu *v;
+    bool init = false;
+
+    if ( frame >= (1UL << order) || nr_frames > (1UL << order) - frame )
+        return -EINVAL;
+
+    spin_lock(&d->domain_lock);
+
+    area = d->shared_runstate;
+    if ( !area && !d->is_dying )
+    {
+        area = alloc_xenheap_pages(order, 0);
+        if ( area )
+        {
+            memset(area, 0, PAGE_SIZE << order);
+            for ( i = 0; i < (1U << order); i++ )
+                share_xen_page_with_guest(
+                    virt_to_page((void *)area + i * PAGE_SIZE), d, SHARE_ro);
+
+            smp_wmb();
+            d->shared_runstate = area;
+            init = true;
+        }
+    }
+
+    spin_unlock(&d->domain_lock);
+
+    if ( !area )
+        return -ENOMEM;
+
+    /* Fill in the current state, from here on updates go to the area. */
+    if ( init )
+    {
+        rcu_read_lock(&sched_res_rculock);
+
+        for_each_vcpu ( d, v )
+        {
+            spinlock_t *lock = unit_schedule_lock_irq(v->sched_unit);
+
+            vcpu_runstate_share(v);
+            unit_schedule_unlock_irq(lock, v->sched_unit);
+        }
+
+        rcu_read_unlock(&sched_res_rculock);
+    }
+
+    for ( i = 0; i < nr_frames; i++ )
+        mfn_list[i] = mfn_x(page_to_mfn(virt_to_page((void *)area +
+                                                     (frame + i) * PAGE_SIZE)));
+
+    return 0;
+}
+
 uint64_t get_cpu_idle_time(unsigned int cpu)
 {
     struct vcpu_runstate_info state = { 0 };
@@ -797,6 +889,7 @@ void sched_destroy_vcpu(struct vcpu *v)
     kill_timer(&v->periodic_timer);
     kill_timer(&v->singleshot_timer);
     kill_timer(&v->poll_timer);
+    XFREE(v->poll_ports);
     if ( test_and_clear_bool(v->is_urgent) )
         atomic_dec(&per_cpu(sched_urgent_count, v->processor));
     /*
@@ -847,6 +940,13 @@ void sched_destroy_domain(struct domain *d)
 {
     ASSERT(d->domain_id < DOMID_FIRST_RESERVED);
 
+    /* All vCPUs are gone, so nothing can update the area anymore. */
+    if ( d->shared_runstate )
+    {
+        free_xenheap_pages(d->shared_runstate, shared_runstate_order(d));
+        d->shared_runstate = NULL;
+    }
+
     if ( d->cpupool )
     {
         SCHED_STAT_CRANK(dom_destroy);
@@ -914,38 +1014,59 @@ void vcpu_sleep_sync(struct vcpu *v)
     sync_vcpu_execstate(v);
 }
 
+/*
+ * Update the runstate of a vcpu being woken up. Returns whether it is
+ * runnable, in which case its unit needs to be woken, too.
+ */
+static bool vcpu_wake_prepare(struct vcpu *v)
+{
+    TRACE_2D(TRC_SCHED_WAKE, v->domain->domain_id, v->vcpu_id);
+
+    if ( likely(vcpu_runnable(v)) )
+    {
+        if ( v->runstate.state >= RUNSTATE_blocked )
+            vcpu_runstate_change(v, RUNSTATE_runnable, NOW());
+        return true;
+    }
+
+    if ( !(v->pause_flags & VPF_blocked) )
+    {
+        if ( v->runstate.state == RUNSTATE_blocked )
+            vcpu_runstate_change(v, RUNSTATE_offline, NOW());
+    }
+
+    return false;
+}
+
+/* Get a runnable vcpu of an already running unit onto its cpu. */
+static void vcpu_wake_kick(const struct sched_unit *unit, struct vcpu *v)
+{
+    if ( unit->is_running && !v->is_running && !v->force_context_switch )
+    {
+        v->force_context_switch = true;
+        cpu_raise_softirq(v->processor, SCHED_SLAVE_SOFTIRQ);
+    }
+}
+
 void vcpu_wake(struct vcpu *v)
 {
     unsigned long flags;
     spinlock_t *lock;
     struct sched_unit *unit = v->sched_unit;
 
-    TRACE_2D(TRC_SCHED_WAKE, v->domain->domain_id, v->vcpu_id);
-
     rcu_read_lock(&sched_res_rculock);
 
     lock = unit_schedule_lock_irqsave(unit, &flags);
 
-    if ( likely(vcpu_runnable(v)) )
+    if ( vcpu_wake_prepare(v) )
     {
-        if ( v->runstate.state >= RUNSTATE_blocked )
-            vcpu_runstate_change(v, RUNSTATE_runnable, NOW());
         /*
          * Call sched_wake() unconditionally, even if unit is running already.
          * We might have not been de-scheduled after vcpu_sleep_nosync_locked()
          * and are now to be woken up again.
          */
         sched_wake(unit_scheduler(unit), unit);
-        if ( unit->is_running && !v->is_running && !v->force_context_switch )
-        {
-            v->force_context_switch = true;
-            cpu_raise_softirq(v->processor, SCHED_SLAVE_SOFTIRQ);
-        }
-    }
-    else if ( !(v->pause_flags & VPF_blocked) )
-    {
-        if ( v->runstate.state == RUNSTATE_blocked )
-            vcpu_runstate_change(v, RUNSTATE_offline, NOW());
+        vcpu_wake_kick(unit, v);
     }
 
     unit_schedule_unlock_irqrestore(lock, flags, unit);
@@ -953,6 +1074,44 @@ void vcpu_wake(struct vcpu *v)
     rcu_read_unlock(&sched_res_rculock);
 }
 
+/*
+ * Wake all vcpus of a domain. With a scheduling granularity above 1 this
+ * takes each unit's lock and calls into the scheduler once per unit
+ * instead of once per vcpu, so the siblings of a unit are woken as a gang
+ * and the scheduler only has to place (and tickle for) the unit once.
+ */
+void domain_wake(struct domain *d)
+{
+    struct sched_unit *unit;
+
+    rcu_read_lock(&sched_res_rculock);
+
+    for_each_sched_unit ( d, unit )
+    {
+        unsigned long flags;
+        spinlock_t *lock;
+        struct vcpu *v;
+        bool wake = false;
+
+        lock = unit_schedule_lock_irqsave(unit, &flags);
+
+        for_each_sched_unit_vcpu ( unit, v )
+            wake |= vcpu_wake_prepare(v);
+
+        if ( wake )
+        {
+            sched_wake(unit_scheduler(unit), unit);
+            for_each_sched_unit_vcpu ( unit, v )
+                if ( vcpu_runnable(v) )
+                    vcpu_wake_kick(unit, v);
+        }
+
+        unit_schedule_unlock_irqrestore(lock, flags, unit);
+    }
+
+    rcu_read_unlock(&sched_res_rculock);
+}
+
 void vcpu_unblock(struct vcpu *v)
 {
     if ( !test_and_clear_bit(_VPF_blocked, &v->pause_flags) )
@@ -1442,20 +1601,39 @@ static long do_poll(struct sched_poll *sched_poll)
 {
     struct vcpu   *v = current;
     struct domain *d = v->domain;
-    evtchn_port_t  port = 0;
+    unsigned int   nr = sched_poll->nr_ports;
+    evtchn_port_t  port = 0, *ports = &port;
     long           rc;
     unsigned int   i;
 
     /* Fairly arbitrary limit. */
-    if ( sched_poll->nr_ports > 128 )
+    if ( nr > EVTCHN_POLL_MAX_PORTS )
         return -EINVAL;
 
-    if ( !guest_handle_okay(sched_poll->ports, sched_poll->nr_ports) )
+    if ( !guest_handle_okay(sched_poll->ports, nr) )
+        return -EFAULT;
+
+    if ( nr > 1 )
+    {
+        if ( !v->poll_ports )
+            v->poll_ports = xmalloc_array(evtchn_port_t,
+                                          EVTCHN_POLL_MAX_PORTS);
+        if ( !v->poll_ports )
+            return -ENOMEM;
+        ports = v->poll_ports;
+    }
+
+    /*
+     * We may have been woken from a previous poll by something other than
+     * its ports (e.g. an event for us), leaving that registered.
+     */
+    evtchn_poll_release(v);
+
+    if ( nr && __copy_from_guest(ports, sched_poll->ports, nr) )
         return -EFAULT;
 
     set_bit(_VPF_blocked, &v->pause_flags);
-    v->poll_evtchn = -1;
-    set_bit(v->vcpu_id, d->poll_mask);
+    evtchn_poll_register(v, ports, nr);
 
     arch_vcpu_block(v);
 
@@ -1479,13 +1657,9 @@ static long do_poll(struct sched_poll *sched_poll)
     if ( local_events_need_delivery() )
         goto out;
 
-    for ( i = 0; i < sched_poll->nr_ports; i++ )
+    for ( i = 0; i < nr; i++ )
     {
-        rc = -EFAULT;
-        if ( __copy_from_guest_offset(&port, sched_poll->ports, i, 1) )
-            goto out;
-
-        rc = evtchn_port_poll(d, port);
+        rc = evtchn_port_poll(d, ports[i]);
         if ( rc )
         {
             if ( rc > 0 )
@@ -1494,9 +1668,6 @@ static long do_poll(struct sched_poll *sched_poll)
         }
     }
 
-    if ( sched_poll->nr_ports == 1 )
-        v->poll_evtchn = port;
-
     if ( sched_poll->timeout != 0 )
         set_timer(&v->poll_timer, sched_poll->timeout);
 
@@ -1506,8 +1677,7 @@ static long do_poll(struct sched_poll *sched_poll)
     return 0;
 
  out:
-    v->poll_evtchn = 0;
-    clear_bit(v->vcpu_id, d->poll_mask);
+    evtchn_poll_release(v);
     clear_bit(_VPF_blocked, &v->pause_flags);
     return rc;
 }
@@ -1533,6 +1703,53 @@ long vcpu_yield(void)
     return 0;
 }
 
+/*
+ * Yield on behalf of a vcpu caught spinning, e.g. by Pause-Loop Exiting.
+ * Most likely it waits for a lock held by a sibling which has been
+ * preempted, so pick a sibling that is runnable but not running (round
+ * robin, so spinners don't all pick the same one) and let the scheduler
+ * move it ahead, if it can, before yielding.
+ */
+long vcpu_yield_to_preempted(void)
+{
+    struct vcpu *v = current, *target = NULL;
+    struct domain *d = v->domain;
+    unsigned int i, id = d->last_yield_target;
+    spinlock_t *lock;
+
+    for ( i = 0; i < d->max_vcpus; i++ )
+    {
+        struct vcpu *w;
+
+        id = (id + 1) % d->max_vcpus;
+        w = d->vcpu[id];
+
+        if ( w && w->sched_unit != v->sched_unit &&
+             w->runstate.state == RUNSTATE_runnable )
+        {
+            target = w;
+            break;
+        }
+    }
+
+    if ( !target )
+        return vcpu_yield();
+
+    d->last_yield_target = id;
+
+    rcu_read_lock(&sched_res_rculock);
+
+    lock = unit_schedule_lock_irq(target->sched_unit);
+    sched_yield_to(vcpu_scheduler(v), v->sched_unit, target->sched_unit);
+    unit_schedule_unlock_irq(lock, target->sched_unit);
+
+    rcu_read_unlock(&sched_res_rculock);
+
+    SCHED_STAT_CRANK(vcpu_yield_to);
+
+    return vcpu_yield();
+}
+
 static void domain_watchdog_timeout(void *data)
 {
     struct domain *d = data;
@@ -2720,7 +2937,7 @@ static void poll_timer_fn(void *data)
 {
     struct vcpu *v = data;
 
-    if ( test_and_clear_bit(v->vcpu_id, v->domain->poll_mask) )
+    if ( evtchn_poll_clear(v) )
         vcpu_unblock(v);
 }
 
@@ -13,6 +13,8 @@
 
 #include <xen/cpu.h>
 #include <xen/cpumask.h>
+#include <xen/event.h>
+#include <xen/guest_access.h>
 #include <xen/init.h>
 #include <xen/keyhandler.h>
 #include <xen/lib.h>
@@ -382,6 +384,92 @@ int cpupool_move_domain(struct domain *d, struct cpupool *c)
     return ret;
 }
 
+/*
+ * Move a list of domains to another cpupool
+ *
+ * The domains are handled in batches of CPUPOOL_MOVE_BATCH: all domains of a
+ * batch are paused asynchronously before any of them is moved, so that
+ * waiting for their vcpus to be descheduled (done synchronously by
+ * sched_move_domain()) overlaps, and cpupool_lock is taken only once per
+ * batch.
+ */
+#define CPUPOOL_MOVE_BATCH 16
+
+static int cpupool_move_domains(unsigned int poolid,
+                                XEN_GUEST_HANDLE_64(uint16) domids,
+                                unsigned int n_dom)
+{
+    struct domain *doms[CPUPOOL_MOVE_BATCH];
+    uint16_t ids[CPUPOOL_MOVE_BATCH];
+    struct cpupool *c;
+    unsigned int done, nr, cnt, i;
+    int ret = 0;
+
+    for ( done = 0; done < n_dom; done += nr )
+    {
+        nr = min(n_dom - done, (unsigned int)CPUPOOL_MOVE_BATCH);
+
+        if ( done && hypercall_preempt_check() )
+            return -EAGAIN;
+
+        if ( copy_from_guest_offset(ids, domids, done, nr) )
+            return -EFAULT;
+
+        /* Collect the domains which are not in the cpupool already. */
+        for ( cnt = i = 0; i < nr; i++ )
+        {
+            struct domain *d;
+
+            ret = rcu_lock_remote_domain_by_id(ids[i], &d);
+            if ( ret )
+                break;
+            if ( d->cpupool == NULL )
+            {
+                ret = -EINVAL;
+                rcu_unlock_domain(d);
+                break;
+            }
+            if ( d->cpupool->cpupool_id == poolid )
+            {
+                rcu_unlock_domain(d);
+                continue;
+            }
+            doms[cnt++] = d;
+        }
+
+        if ( !ret && cnt )
+        {
+            for ( i = 0; i < cnt; i++ )
+                domain_pause_nosync(doms[i]);
+
+            debugtrace_printk("cpupool move_domains(%u doms)->pool=%u\n",
+                              cnt, poolid);
+            ret = -ENOENT;
+            spin_lock(&cpupool_lock);
+
+            c = cpupool_find_by_id(poolid);
+            if ( (c != NULL) && cpumask_weight(c->cpu_valid) )
+                for ( ret = 0, i = 0; !ret && i < cnt; i++ )
+                    ret = cpupool_move_domain_locked(doms[i], c);
+
+            spin_unlock(&cpupool_lock);
+            debugtrace_printk("cpupool move_domains->pool=%u ret %d\n",
+                              poolid, ret);
+
+            for ( i = 0; i < cnt; i++ )
+                domain_unpause(doms[i]);
+        }
+
+        for ( i = 0; i < cnt; i++ )
+            rcu_unlock_domain(doms[i]);
+
+        if ( ret )
+            break;
+    }
+
+    return ret;
+}
+
 /*
  * assign a specific cpu to a cpupool
  * cpupool_lock must be held
@@ -912,6 +1000,10 @@ int cpupool_do_sysctl(struct xen_sysctl_cpupool_op *op)
     }
     break;
 
+    case XEN_SYSCTL_CPUPOOL_OP_MOVEDOMAINS:
+        ret = cpupool_move_domains(op->cpupool_id, op->domids, op->n_dom);
+        break;
+
     case XEN_SYSCTL_CPUPOOL_OP_FREEINFO:
     {
         ret = cpumask_to_xenctl_bitmap(
@@ -211,6 +211,7 @@ struct csched_private {
     spinlock_t lock;
 
     cpumask_var_t idlers;
+    cpumask_var_t smt_idle;     /* Idlers on fully idle cores, see below */
     cpumask_var_t cpus;
     uint32_t *balance_bias;
     uint32_t runq_sort;
@@ -345,6 +346,69 @@ static void burn_credits(struct csched_unit *svc, s_time_t now)
     svc->start_time += (credits * MILLISECS(1)) / CSCHED_CREDITS_PER_MSEC;
 }
 
+/*
+ * Besides the idlers mask, we track idleness per core: all the threads of a
+ * core have their bits set in smt_idle when all of them (or at least all of
+ * them in our cpupool) are idle.  This lets tickling prefer waking a thread
+ * on a fully idle core (or, with sched_smt_power_savings, a thread that
+ * has busy siblings) without looking at each idler's siblings.
+ *
+ * Like idlers, smt_idle is updated with per-bit atomics and no lock.  It is
+ * therefore just a hint, which may be stale for short periods: whoever uses
+ * it must still check idlers.
+ */
+static bool csched_core_idle(const struct csched_private *prv,
+                             unsigned int cpu)
+{
+    unsigned int sib;
+
+    for_each_cpu ( sib, per_cpu(cpu_sibling_mask, cpu) )
+        if ( cpumask_test_cpu(sib, prv->cpus) &&
+             !cpumask_test_cpu(sib, prv->idlers) )
+            return false;
+
+    return true;
+}
+
+static void csched_smt_idle_clear(struct csched_private *prv,
+                                  unsigned int cpu)
+{
+    unsigned int sib;
+
+    for_each_cpu ( sib, per_cpu(cpu_sibling_mask, cpu) )
+        cpumask_clear_cpu(sib, prv->smt_idle);
+}
+
+static void csched_set_idle(struct csched_private *prv, unsigned int cpu)
+{
+    unsigned int sib;
+
+    cpumask_set_cpu(cpu, prv->idlers);
+    smp_mb(); /* Set our idlers bit /then/ check our siblings'. */
+
+    if ( !csched_core_idle(prv, cpu) )
+        return;
+
+    for_each_cpu ( sib, per_cpu(cpu_sibling_mask, cpu) )
+        if ( cpumask_test_cpu(sib, prv->cpus) )
+            cpumask_set_cpu(sib, prv->smt_idle);
+    smp_mb(); /* Set smt_idle /then/ recheck the siblings. */
+
+    /*
+     * A sibling may have become busy after we checked, and cleared smt_idle
+     * before we set it: undo in that case, see csched_clear_idle().
+     */
+    if ( !csched_core_idle(prv, cpu) )
+        csched_smt_idle_clear(prv, cpu);
+}
+
+static void csched_clear_idle(struct csched_private *prv, unsigned int cpu)
+{
+    cpumask_clear_cpu(cpu, prv->idlers);
+    smp_mb(); /* Clear our idlers bit /then/ smt_idle. */
+    csched_smt_idle_clear(prv, cpu);
+}
+
 static bool __read_mostly opt_tickle_one_idle = true;
 boolean_param("tickle_one_idle_cpu", opt_tickle_one_idle);
 
@@ -465,6 +529,23 @@ static inline void __runq_tickle(const struct csched_unit *new)
                 SCHED_STAT_CRANK(tickled_idle_cpu);
                 if ( opt_tickle_one_idle )
                 {
+                    /*
+                     * Prefer idlers on fully idle cores, to run on a core
+                     * of its own, or the other way round for power saving.
+                     * (mask is empty here, and can be used as scratch.)
+                     */
+                    if ( sched_smt_power_savings )
+                        cpumask_andnot(&mask, cpumask_scratch_cpu(cpu),
+                                       prv->smt_idle);
+                    else
+                        cpumask_and(&mask, cpumask_scratch_cpu(cpu),
+                                    prv->smt_idle);
+                    if ( !cpumask_empty(&mask) )
+                    {
+                        cpumask_copy(cpumask_scratch_cpu(cpu), &mask);
+                        cpumask_clear(&mask);
+                    }
+
                     this_cpu(last_tickle_cpu) =
                         cpumask_cycle(this_cpu(last_tickle_cpu),
                                       cpumask_scratch_cpu(cpu));
@@ -500,7 +581,7 @@ static inline void __runq_tickle(const struct csched_unit *new)
          * true, the loop does only one step, and only one bit is cleared.
          */
         for_each_cpu(cpu, &mask)
-            cpumask_clear_cpu(cpu, prv->idlers);
+            csched_clear_idle(prv, cpu);
         cpumask_raise_softirq(&mask, SCHEDULE_SOFTIRQ);
     }
     else
@@ -546,7 +627,7 @@ csched_deinit_pdata(const struct scheduler *ops, void *pcpu, int cpu)
 
     prv->credit -= prv->credits_per_tslice;
     prv->ncpus--;
-    cpumask_clear_cpu(cpu, prv->idlers);
+    csched_clear_idle(prv, cpu);
     cpumask_clear_cpu(cpu, prv->cpus);
     if ( (prv->master == cpu) && (prv->ncpus > 0) )
     {
@@ -610,7 +691,7 @@ init_pdata(struct csched_private *prv, struct csched_pcpu *spc, int cpu)
 
     /* Start off idling... */
     BUG_ON(!is_idle_unit(curr_on_cpu(cpu)));
-    cpumask_set_cpu(cpu, prv->idlers);
+    csched_set_idle(prv, cpu);
     spc->nr_runnable = 0;
 }
 
@@ -1165,6 +1246,31 @@ csched_unit_yield(const struct scheduler *ops, struct sched_unit *unit)
     set_bit(CSCHED_FLAG_UNIT_YIELD, &svc->flags);
 }
 
+/*
+ * Boost a preempted unit which the yielding one is probably waiting for,
+ * taking it to the front of its runqueue as if it had just woken.  It loses
+ * the boost as soon as it is found consuming credits.
+ */
+static void
+csched_unit_yield_to(const struct scheduler *ops, struct sched_unit *unit,
+                     struct sched_unit *target)
+{
+    struct csched_unit * const svc = CSCHED_UNIT(target);
+
+    if ( !__unit_on_runq(svc) || svc->pri != CSCHED_PRI_TS_UNDER ||
+         test_bit(CSCHED_FLAG_UNIT_PARKED, &svc->flags) )
+        return;
+
+    TRACE_2D(TRC_CSCHED_BOOST_START, target->domain->domain_id,
+             target->unit_id);
+    SCHED_STAT_CRANK(unit_boost);
+    svc->pri = CSCHED_PRI_TS_BOOST;
+
+    runq_remove(svc);
+    runq_insert(svc);
+    __runq_tickle(svc);
+}
+
 static int
 csched_dom_cntl(
     const struct scheduler *ops,
@@ -1968,11 +2074,11 @@ static void csched_schedule(
     if ( !tasklet_work_scheduled && snext->pri == CSCHED_PRI_IDLE )
     {
         if ( !cpumask_test_cpu(sched_cpu, prv->idlers) )
-            cpumask_set_cpu(sched_cpu, prv->idlers);
+            csched_set_idle(prv, sched_cpu);
     }
     else if ( cpumask_test_cpu(sched_cpu, prv->idlers) )
     {
-        cpumask_clear_cpu(sched_cpu, prv->idlers);
+        csched_clear_idle(prv, sched_cpu);
     }
 
     if ( !is_idle_unit(snext->unit) )
@@ -2118,6 +2224,7 @@ csched_dump(const struct scheduler *ops)
            prv->unit_migr_delay/ MICROSECS(1));
 
     printk("idlers: %*pb\n", CPUMASK_PR(prv->idlers));
+    printk("smt_idle: %*pb\n", CPUMASK_PR(prv->smt_idle));
 
     printk("active units:\n");
     loop = 0;
@@ -2192,8 +2299,10 @@ csched_init(struct scheduler *ops)
     }
 
     if ( !zalloc_cpumask_var(&prv->cpus) ||
-         !zalloc_cpumask_var(&prv->idlers) )
+         !zalloc_cpumask_var(&prv->idlers) ||
+         !zalloc_cpumask_var(&prv->smt_idle) )
     {
+        free_cpumask_var(prv->idlers);
         free_cpumask_var(prv->cpus);
         xfree(prv->balance_bias);
         xfree(prv);
@@ -2228,6 +2337,7 @@ csched_deinit(struct scheduler *ops)
         ops->sched_data = NULL;
         free_cpumask_var(prv->cpus);
         free_cpumask_var(prv->idlers);
+        free_cpumask_var(prv->smt_idle);
         xfree(prv->balance_bias);
         xfree(prv);
     }
@@ -2247,6 +2357,7 @@ static const struct scheduler sched_credit_def = {
     .sleep          = csched_unit_sleep,
     .wake           = csched_unit_wake,
     .yield          = csched_unit_yield,
+    .yield_to       = csched_unit_yield_to,
 
     .adjust         = csched_dom_cntl,
     .adjust_affinity= csched_aff_cntl,
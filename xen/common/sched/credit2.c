@@ -257,6 +257,13 @@
  * MIN_TIMER.
  */
 #define CSCHED2_MIGRATE_RESIST       ((opt_migrate_resist)*MICROSECS(1))
+/*
+ * Boost: Extra credit a woken unit of a latency sensitive domain is
+ * treated as having, until it next gets to run.  It's large enough for
+ * such a unit to rank above any non boosted one.
+ */
+#define CSCHED2_BOOST_CREDIT         (2 * CSCHED2_CREDIT_INIT + \
+                                      CSCHED2_CARRYOVER_MAX)
 /* How much to "compensate" an unit for L2 migration. */
 #define CSCHED2_MIGRATE_COMPENSATION MICROSECS(50)
 /* How tolerant we should be when peeking at runtime of units on other cpus */
@@ -313,6 +320,13 @@
  */
 #define __CSFLAG_pinned 5
 #define CSFLAG_pinned (1U<<__CSFLAG_pinned)
+/*
+ * CSFLAG_boost: this unit belongs to a latency sensitive domain, and has
+ * woken up with credit left.  It ranks above non boosted units until it
+ * next gets to run (see prio_credit()).
+ */
+#define __CSFLAG_boost 6
+#define CSFLAG_boost (1U<<__CSFLAG_boost)
 
 static unsigned int __read_mostly opt_migrate_resist = 500;
 integer_param("sched_credit2_migrate_resist", opt_migrate_resist);
@@ -402,6 +416,12 @@ static int __read_mostly opt_underload_balance_tolerance = 0;
 integer_param("credit2_balance_under", opt_underload_balance_tolerance);
 static int __read_mostly opt_overload_balance_tolerance = -3;
 integer_param("credit2_balance_over", opt_overload_balance_tolerance);
+/*
+ * Whether a pCPU about to go idle steals work from other runqueues, instead
+ * of waiting for the next load balancing pass.
+ */
+static bool __read_mostly opt_steal = true;
+boolean_param("credit2_steal", opt_steal);
 /*
  * Domains subject to a cap receive a replenishment of their runtime budget
  * once every opt_cap_period interval. Default is 10 ms. The amount of budget
@@ -507,6 +527,7 @@ struct csched2_runqueue_data {
     s_time_t load_last_update; /* Last time average was updated              */
     s_time_t avgload;          /* Decaying queue load                        */
     s_time_t b_avgload;        /* Decaying queue load modified by balancing  */
+                               /* (written atomically, see csched2_res_pick) */
 
     cpumask_t active,          /* CPUs enabled for this runqueue             */
         smt_idle,              /* Fully idle-and-untickled cores (see below) */
@@ -590,6 +611,7 @@ struct csched2_dom {
     uint16_t weight;            /* User specified weight                      */
     uint16_t cap;               /* User specified cap                         */
     uint16_t nr_units;          /* Number of units of this domain             */
+    bool latency;               /* Latency sensitive (boost on wakeup)        */
 };
 
 /*
@@ -820,6 +842,13 @@ static void t2c_update(const struct csched2_runqueue_data *rqd, s_time_t time,
         svc->credit = val;
 }
 
+/* Credit to compare units by, when picking who should run first. */
+static inline int prio_credit(const struct csched2_unit *svc)
+{
+    return svc->credit + ((svc->flags & CSFLAG_boost) ? CSCHED2_BOOST_CREDIT
+                                                       : 0);
+}
+
 static s_time_t c2t(const struct csched2_runqueue_data *rqd, s_time_t credit,
                     const struct csched2_unit *svc)
 {
@@ -1101,7 +1130,7 @@ _runq_assign(struct csched2_unit *svc, struct csched2_runqueue_data *rqd)
     update_max_weight(svc->rqd, svc->weight, 0);
 
     /* Expected new load based on adding this unit */
-    rqd->b_avgload += svc->avgload;
+    write_atomic(&rqd->b_avgload, rqd->b_avgload + svc->avgload);
 
     if ( unlikely(tb_init_done) )
     {
@@ -1141,7 +1170,8 @@ _runq_deassign(struct csched2_unit *svc)
     update_max_weight(rqd, 0, svc->weight);
 
     /* Expected new load based on removing this unit */
-    rqd->b_avgload = max_t(s_time_t, rqd->b_avgload - svc->avgload, 0);
+    write_atomic(&rqd->b_avgload,
+                 max_t(s_time_t, rqd->b_avgload - svc->avgload, 0));
 
     svc->rqd = NULL;
 }
@@ -1296,7 +1326,7 @@ update_runq_load(const struct scheduler *ops,
     if ( rqd->load_last_update + (1ULL << W)  < now )
     {
         rqd->avgload = load << P;
-        rqd->b_avgload = load << P;
+        write_atomic(&rqd->b_avgload, load << P);
     }
     else
     {
@@ -1322,9 +1352,10 @@ update_runq_load(const struct scheduler *ops,
         rqd->avgload = rqd->avgload +
                        ((delta * (load << P)) >> W) -
                        ((delta * rqd->avgload) >> W);
-        rqd->b_avgload = rqd->b_avgload +
-                         ((delta * (load << P)) >> W) -
-                         ((delta * rqd->b_avgload) >> W);
+        write_atomic(&rqd->b_avgload,
+                     rqd->b_avgload +
+                     ((delta * (load << P)) >> W) -
+                     ((delta * rqd->b_avgload) >> W));
     }
     rqd->load += change;
     rqd->load_last_update = now;
@@ -1441,7 +1472,7 @@ static void runq_insert(struct csched2_unit *svc)
     {
         struct csched2_unit * iter_svc = runq_elem(iter);
 
-        if ( svc->credit > iter_svc->credit )
+        if ( prio_credit(svc) > prio_credit(iter_svc) )
             break;
 
         pos++;
@@ -1529,7 +1560,7 @@ static s_time_t tickle_score(const struct scheduler *ops, s_time_t now,
 
     burn_credits(rqd, cur, now);
 
-    score = new->credit - cur->credit;
+    score = prio_credit(new) - prio_credit(cur);
     if ( sched_unit_master(new->unit) != cpu )
         score -= CSCHED2_MIGRATE_RESIST;
 
@@ -2277,6 +2308,16 @@ csched2_unit_wake(const struct scheduler *ops, struct sched_unit *unit)
 
     update_load(ops, svc->rqd, svc, 1, now);
 
+    /*
+     * Units of latency sensitive domains jump the queue on wakeup, as long
+     * as they have credit left, so they can't starve anyone beyond their
+     * own fair share.
+     */
+    if ( svc->sdom->latency && svc->credit > 0 )
+        __set_bit(__CSFLAG_boost, &svc->flags);
+    else
+        __clear_bit(__CSFLAG_boost, &svc->flags);
+
     /* Put the UNIT on the runq */
     runq_insert(svc);
     runq_tickle(ops, svc, now);
@@ -2293,6 +2334,33 @@ csched2_unit_yield(const struct scheduler *ops, struct sched_unit *unit)
     __set_bit(__CSFLAG_unit_yield, &svc->flags);
 }
 
+/*
+ * Swap credits with a preempted unit which the yielding one is probably
+ * waiting for, if that lets it run sooner.  The total is unchanged, so this
+ * is fair to everyone else.  Only done within a runqueue: then the lock
+ * held on the target's behalf protects both.
+ */
+static void
+csched2_unit_yield_to(const struct scheduler *ops, struct sched_unit *unit,
+                      struct sched_unit *target)
+{
+    struct csched2_unit * const svc = csched2_unit(unit);
+    struct csched2_unit * const tsvc = csched2_unit(target);
+    int credit;
+
+    if ( svc->rqd != tsvc->rqd || !unit_on_runq(tsvc) ||
+         tsvc->credit >= svc->credit )
+        return;
+
+    credit = svc->credit;
+    svc->credit = tsvc->credit;
+    tsvc->credit = credit;
+
+    runq_remove(tsvc);
+    runq_insert(tsvc);
+    runq_tickle(ops, tsvc, NOW());
+}
+
 static void
 csched2_context_saved(const struct scheduler *ops, struct sched_unit *unit)
 {
@@ -2353,8 +2421,12 @@ csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
      * - Runqueue lock of vc->processor is already locked
      * - Need to grab prv lock to make sure active runqueues don't
      *   change
-     * - Need to grab locks for other runqueues while checking
-     *   avgload
+     * - Other runqueues' avgload is read without taking their locks:
+     *   it is only ever updated atomically, and a slightly stale value
+     *   is as good as one read under the lock, which may be stale by the
+     *   time we act upon it anyway.  This avoids bouncing all runqueue
+     *   locks around on each wakeup, and ignoring runqueues whose lock
+     *   happens to be contended.
      * Locking constraint is:
      * - Lock prv before runqueue locks
      * - Trylock between runqueue locks (no ordering)
@@ -2439,22 +2511,15 @@ csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
             continue;
 
         /*
-         * If checking a different runqueue, grab the lock, read the avg,
-         * and then release the lock.
-         *
-         * If on our own runqueue, don't grab or release the lock;
-         * but subtract our own load from the runqueue load to simulate
-         * impartiality.
+         * If on our own runqueue, subtract our own load from the runqueue
+         * load to simulate impartiality.
          */
         if ( rqd == svc->rqd )
         {
             rqd_avgload = max_t(s_time_t, rqd->b_avgload - svc->avgload, 0);
         }
-        else if ( spin_trylock(&rqd->lock) )
-        {
-            rqd_avgload = rqd->b_avgload;
-            spin_unlock(&rqd->lock);
-        }
+        else
+            rqd_avgload = read_atomic(&rqd->b_avgload);
 
         /*
          * if svc has a soft-affinity, and some cpus of rqd are part of it,
@@ -2519,8 +2584,8 @@ csched2_res_pick(const struct scheduler *ops, const struct sched_unit *unit)
     else
     {
         /*
-         * We didn't find anyone at all (most likely because of spinlock
-         * contention).
+         * We didn't find anyone at all (most likely because the affinity
+         * or the cpupool changed under our feet).
          */
         new_cpu = get_fallback_cpu(svc);
         min_rqd = c2rqd(new_cpu);
@@ -2561,10 +2626,37 @@ typedef struct {
     s_time_t load_delta;
     struct csched2_unit * best_push_svc, *best_pull_svc;
     /* NB: Read by consider() */
+    s_time_t imbalance;
     struct csched2_runqueue_data *lrqd;
     struct csched2_runqueue_data *orqd;
 } balance_state_t;
 
+/*
+ * Cost of moving svc from runqueue 'from' to runqueue 'to', as far as the
+ * memory locality of its domain is concerned: moving a unit off the nodes
+ * its domain's memory lives on costs a quarter of its load, moving it back
+ * there gains as much. Neutral if the domain has no particular affinity.
+ */
+static s_time_t numa_move_cost(const struct csched2_unit *svc,
+                               const struct csched2_runqueue_data *from,
+                               const struct csched2_runqueue_data *to)
+{
+    const nodemask_t *affinity;
+    bool was_home, is_home;
+
+    if ( !svc )
+        return 0;
+
+    affinity = &svc->unit->domain->node_affinity;
+    was_home = nodemask_test(cpu_to_node(from->pick_bias), affinity);
+    is_home = nodemask_test(cpu_to_node(to->pick_bias), affinity);
+
+    if ( was_home == is_home )
+        return 0;
+
+    return is_home ? -(svc->avgload / 4) : svc->avgload / 4;
+}
+
 static void consider(balance_state_t *st,
                      struct csched2_unit *push_svc,
                      struct csched2_unit *pull_svc)
@@ -2590,6 +2682,14 @@ static void consider(balance_state_t *st,
     if ( delta < 0 )
         delta = -delta;
 
+    /* Only moves that actually improve the balance are candidates... */
+    if ( delta >= st->imbalance )
+        return;
+
+    /* ... and among those, prefer the ones bringing units home. */
+    delta += numa_move_cost(push_svc, st->lrqd, st->orqd) +
+             numa_move_cost(pull_svc, st->orqd, st->lrqd);
+
     if ( delta < st->load_delta )
     {
         st->load_delta = delta;
@@ -2690,6 +2790,7 @@ static void balance_load(const struct scheduler *ops, int cpu, s_time_t now)
     struct list_head *push_iter, *pull_iter;
     bool inner_load_updated = 0;
     struct csched2_runqueue_data *rqd, *max_delta_rqd;
+    s_time_t max_score;
 
     balance_state_t st = { .best_push_svc = NULL, .best_pull_svc = NULL };
 
@@ -2711,10 +2812,11 @@ retry:
         return;
 
     st.load_delta = 0;
+    max_score = 0;
 
     list_for_each_entry ( rqd, &prv->rql, rql )
     {
-        s_time_t delta;
+        s_time_t delta, score;
 
         st.orqd = rqd;
 
@@ -2728,8 +2830,16 @@ retry:
         if ( delta < 0 )
             delta = -delta;
 
-        if ( delta > st.load_delta )
+        /*
+         * Moving units across NUMA nodes costs their cache and memory
+         * locality, so only prefer a remote runqueue over a local one if
+         * its imbalance is at least twice as large.
+         */
+        score = same_node(cpu, rqd->pick_bias) ? delta : delta / 2;
+
+        if ( score > max_score )
         {
+            max_score = score;
             st.load_delta = delta;
             max_delta_rqd = rqd;
         }
@@ -2742,6 +2852,8 @@ retry:
     if ( !max_delta_rqd )
         goto out;
 
+    st.orqd = max_delta_rqd;
+
     {
         s_time_t load_max;
         int cpus_max;
@@ -2812,6 +2924,8 @@ retry:
 
     SCHED_STAT_CRANK(acct_load_balance);
 
+    st.imbalance = st.load_delta;
+
     /* Look for "swap" which gives the best load average
      * FIXME: O(n^2)! */
 
@@ -2867,6 +2981,68 @@ retry:
     return;
 }
 
+/*
+ * Pull a runnable unit which can run on cpu from another runqueue into rqd,
+ * as cpu is about to go idle.  Runqueues on cpu's own NUMA node are tried
+ * first.  Like balance_load(), only trylocks are used, so this may give up
+ * spuriously.  Returns whether a unit was moved.
+ */
+static bool steal_work(const struct scheduler *ops,
+                       struct csched2_runqueue_data *rqd,
+                       unsigned int cpu, s_time_t now)
+{
+    struct csched2_private *prv = csched2_priv(ops);
+    struct csched2_runqueue_data *orqd;
+    unsigned int pass;
+    bool stolen = false;
+
+    ASSERT(spin_is_locked(get_sched_res(cpu)->schedule_lock));
+
+    if ( prv->active_queues < 2 || !read_trylock(&prv->lock) )
+        return false;
+
+    for ( pass = 0; pass < 2 && !stolen; pass++ )
+    {
+        list_for_each_entry ( orqd, &prv->rql, rql )
+        {
+            struct csched2_unit *svc;
+
+            if ( orqd == rqd || same_node(cpu, orqd->pick_bias) != !pass ||
+                 list_empty(&orqd->runq) || !spin_trylock(&orqd->lock) )
+                continue;
+
+            /* Leave the work to idle pCPUs of its own runqueue, if any. */
+            cpumask_andnot(cpumask_scratch, &orqd->idle, &orqd->tickled);
+            if ( orqd->id < 0 || !cpumask_empty(cpumask_scratch) )
+            {
+                spin_unlock(&orqd->lock);
+                continue;
+            }
+
+            list_for_each_entry ( svc, &orqd->runq, runq_elem )
+            {
+                if ( !cpumask_test_cpu(cpu, svc->unit->cpu_hard_affinity) ||
+                     !unit_is_migrateable(svc, rqd) )
+                    continue;
+
+                migrate(ops, svc, rqd, now);
+                SCHED_STAT_CRANK(migrate_stolen);
+                stolen = true;
+                break;
+            }
+
+            spin_unlock(&orqd->lock);
+
+            if ( stolen )
+                break;
+        }
+    }
+
+    read_unlock(&prv->lock);
+
+    return stolen;
+}
+
 static void
 csched2_unit_migrate(
     const struct scheduler *ops, struct sched_unit *unit, unsigned int new_cpu)
@@ -2923,10 +3099,20 @@ csched2_dom_cntl(
         read_lock_irqsave(&prv->lock, flags);
         op->u.credit2.weight = sdom->weight;
         op->u.credit2.cap = sdom->cap;
+        op->u.credit2.flags = sdom->latency ? XEN_DOMCTL_SCHED_CREDIT2_latency
+                                            : 0;
         read_unlock_irqrestore(&prv->lock, flags);
         break;
     case XEN_DOMCTL_SCHEDOP_putinfo:
+        if ( op->u.credit2.flags & ~XEN_DOMCTL_SCHED_CREDIT2_latency )
+        {
+            rc = -EINVAL;
+            break;
+        }
+
         write_lock_irqsave(&prv->lock, flags);
+        /* Latency sensitivity, only looked at when units wake up. */
+        sdom->latency = op->u.credit2.flags & XEN_DOMCTL_SCHED_CREDIT2_latency;
         /* Weight */
         if ( op->u.credit2.weight != 0 )
         {
@@ -3483,7 +3669,7 @@ runq_candidate(struct csched2_runqueue_data *rqd,
          * its credit is at least CSCHED2_MIGRATE_RESIST higher.
          */
         if ( sched_unit_master(svc->unit) != cpu
-             && snext->credit + CSCHED2_MIGRATE_RESIST > svc->credit )
+             && prio_credit(snext) + CSCHED2_MIGRATE_RESIST > prio_credit(svc) )
         {
             SCHED_STAT_CRANK(migrate_resisted);
             continue;
@@ -3495,7 +3681,7 @@ runq_candidate(struct csched2_runqueue_data *rqd,
          * if the one in runqueue either is not capped, or is capped but has
          * some budget, then choose it.
          */
-        if ( (yield || svc->credit > snext->credit) &&
+        if ( (yield || prio_credit(svc) > prio_credit(snext)) &&
              (!has_cap(svc) || unit_grab_budget(svc)) &&
              unit_runnable_state(svc->unit) )
             snext = svc;
@@ -3590,6 +3776,9 @@ static void csched2_schedule(
     /* Update credits (and budget, if necessary). */
     burn_credits(rqd, scurr, now);
 
+    /* Having got to run, a boosted unit goes back to competing normally. */
+    __clear_bit(__CSFLAG_boost, &scurr->flags);
+
     /*
      *  Below 0, means that we are capped and we have overrun our  budget.
      *  Let's try to get some more but, if we fail (e.g., because of the
@@ -3623,8 +3812,15 @@ static void csched2_schedule(
         snext = csched2_unit(sched_idle_unit(sched_cpu));
     }
     else
+    {
         snext = runq_candidate(rqd, scurr, sched_cpu, now);
 
+        /* Rather than going idle, try to find work elsewhere. */
+        if ( opt_steal && is_idle_unit(snext->unit) &&
+             steal_work(ops, rqd, sched_cpu, now) )
+            snext = runq_candidate(rqd, scurr, sched_cpu, now);
+    }
+
     /* If switching from a non-idle runnable unit, put it
      * back on the runqueue. */
     if ( snext != scurr
@@ -4191,6 +4387,7 @@ static const struct scheduler sched_credit2_def = {
     .sleep          = csched2_unit_sleep,
     .wake           = csched2_unit_wake,
     .yield          = csched2_unit_yield,
+    .yield_to       = csched2_unit_yield_to,
 
     .adjust         = csched2_dom_cntl,
     .adjust_affinity= csched2_aff_cntl,
@@ -96,8 +96,16 @@ struct null_pcpu {
 struct null_unit {
     struct list_head waitq_elem;
     struct sched_unit *unit;
+    unsigned int waitq_skipped; /* times overtaken while in the waitqueue */
 };
 
+/*
+ * Number of times a unit in the waitqueue can be overtaken by more recently
+ * queued units with soft-affinity with a pCPU that became free, before it is
+ * given that pCPU anyway.
+ */
+#define NULL_WAITQ_MAX_SKIP 4
+
 /*
  * Domain
  */
@@ -130,6 +138,49 @@ static inline bool unit_check_affinity(struct sched_unit *unit,
     return cpumask_test_cpu(cpu, cpumask_scratch_cpu(cpu));
 }
 
+/*
+ * Pick the unit from the waitqueue that should be assigned to cpu, if any.
+ *
+ * Units are considered in the order they were queued, and one with
+ * soft-affinity with cpu is preferred over one with just hard-affinity.
+ * To avoid starving units that do not have soft-affinity with any free
+ * pCPU, the oldest suitable unit is picked anyway once it has been
+ * overtaken NULL_WAITQ_MAX_SKIP times.
+ *
+ * This is a single pass over the waitqueue. The caller must hold the
+ * waitqueue lock.
+ */
+static struct null_unit *waitq_pick(struct null_private *prv,
+                                    unsigned int cpu)
+{
+    struct null_unit *wvc, *oldest = NULL;
+
+    ASSERT(spin_is_locked(&prv->waitq_lock));
+
+    list_for_each_entry( wvc, &prv->waitq, waitq_elem )
+    {
+        if ( !unit_check_affinity(wvc->unit, cpu, BALANCE_HARD_AFFINITY) )
+            continue;
+
+        if ( oldest == NULL )
+        {
+            oldest = wvc;
+            if ( oldest->waitq_skipped >= NULL_WAITQ_MAX_SKIP )
+                return oldest;
+        }
+
+        if ( has_soft_affinity(wvc->unit) &&
+             unit_check_affinity(wvc->unit, cpu, BALANCE_SOFT_AFFINITY) )
+        {
+            if ( wvc != oldest )
+                oldest->waitq_skipped++;
+            return wvc;
+        }
+    }
+
+    return oldest;
+}
+
 static int null_init(struct scheduler *ops)
 {
     struct null_private *prv;
@@ -268,6 +319,38 @@ static void null_free_domdata(const struct scheduler *ops, void *data)
  *
  * So this is not part of any hot path.
  */
+/*
+ * Pick a pCPU among the ones in cpus, preferring the ones that are on the
+ * same NUMA node as cpu, and then the ones within the node-affinity of the
+ * domain, so that the unit runs close to its memory.
+ */
+static unsigned int pick_numa_cpu(const struct domain *d, unsigned int cpu,
+                                  const cpumask_t *cpus)
+{
+    unsigned int c, node = cpu_to_node(cpu), first = nr_cpu_ids;
+
+    if ( node == NUMA_NO_NODE || !nodemask_test(node, &d->node_affinity) )
+        node = NUMA_NO_NODE;
+
+    for_each_cpu ( c, cpus )
+    {
+        unsigned int n = cpu_to_node(c);
+
+        if ( n == NUMA_NO_NODE )
+            continue;
+        if ( n == node )
+            return c;
+        if ( first == nr_cpu_ids && nodemask_test(n, &d->node_affinity) )
+        {
+            first = c;
+            if ( node == NUMA_NO_NODE )
+                break;
+        }
+    }
+
+    return first != nr_cpu_ids ? first : cpumask_first(cpus);
+}
+
 static struct sched_resource *
 pick_res(const struct null_private *prv, const struct sched_unit *unit)
 {
@@ -300,10 +383,13 @@ pick_res(const struct null_private *prv, const struct sched_unit *unit)
             goto out;
         }
 
-        /* If not, just go for a free pCPU, within our affinity, if any */
+        /*
+         * If not, just go for a free pCPU, within our affinity, if any,
+         * and as close as possible to the domain's memory.
+         */
         cpumask_and(cpumask_scratch_cpu(cpu), cpumask_scratch_cpu(cpu),
                     &prv->cpus_free);
-        new_cpu = cpumask_first(cpumask_scratch_cpu(cpu));
+        new_cpu = pick_numa_cpu(unit->domain, cpu, cpumask_scratch_cpu(cpu));
 
         if ( likely(new_cpu != nr_cpu_ids) )
             goto out;
@@ -347,6 +433,7 @@ static void unit_assign(struct null_private *prv, struct sched_unit *unit,
     ASSERT(is_unit_online(unit));
 
     npc->unit = unit;
+    null_unit(unit)->waitq_skipped = 0;
     sched_set_res(unit, get_sched_res(cpu));
     cpumask_clear_cpu(cpu, &prv->cpus_free);
 
@@ -368,7 +455,6 @@ static void unit_assign(struct null_private *prv, struct sched_unit *unit,
 /* Returns true if a cpu was tickled */
 static bool unit_deassign(struct null_private *prv, const struct sched_unit *unit)
 {
-    unsigned int bs;
     unsigned int cpu = sched_unit_master(unit);
     struct null_unit *wvc;
     struct null_pcpu *npc = get_sched_res(cpu)->sched_priv;
@@ -400,29 +486,19 @@ static bool unit_deassign(struct null_private *prv, const struct sched_unit *uni
     /*
      * If unit is assigned to a pCPU, let's see if there is someone waiting,
      * suitable to be assigned to it (prioritizing units that have
-     * soft-affinity with cpu).
+     * soft-affinity with cpu, see waitq_pick()).
      */
-    for_each_affinity_balance_step( bs )
+    wvc = waitq_pick(prv, cpu);
+    if ( wvc )
     {
-        list_for_each_entry( wvc, &prv->waitq, waitq_elem )
-        {
-            if ( bs == BALANCE_SOFT_AFFINITY &&
-                 !has_soft_affinity(wvc->unit) )
-                continue;
-
-            if ( unit_check_affinity(wvc->unit, cpu, bs) )
-            {
-                list_del_init(&wvc->waitq_elem);
-                unit_assign(prv, wvc->unit, cpu);
-                cpu_raise_softirq(cpu, SCHEDULE_SOFTIRQ);
-                spin_unlock(&prv->waitq_lock);
-                return true;
-            }
-        }
+        list_del_init(&wvc->waitq_elem);
+        unit_assign(prv, wvc->unit, cpu);
+        cpu_raise_softirq(cpu, SCHEDULE_SOFTIRQ);
     }
+
     spin_unlock(&prv->waitq_lock);
 
-    return false;
+    return wvc != NULL;
 }
 
 /* Change the scheduler of cpu to us (null). */
@@ -804,7 +880,6 @@ static inline void null_unit_check(struct sched_unit *unit)
 static void null_schedule(const struct scheduler *ops, struct sched_unit *prev,
                           s_time_t now, bool tasklet_work_scheduled)
 {
-    unsigned int bs;
     const unsigned int cur_cpu = smp_processor_id();
     const unsigned int sched_cpu = sched_get_resource_cpu(cur_cpu);
     struct null_pcpu *npc = get_sched_res(sched_cpu)->sched_priv;
@@ -850,70 +925,55 @@ static void null_schedule(const struct scheduler *ops, struct sched_unit *prev,
      */
     if ( unlikely(prev->next_task == NULL) )
     {
-        bool unit_found;
-
         spin_lock(&prv->waitq_lock);
 
         if ( list_empty(&prv->waitq) )
             goto unlock;
 
         /*
-         * We scan the waitqueue twice, for prioritizing units that have
+         * Look for a unit in the waitqueue, prioritizing units that have
          * soft-affinity with cpu. This may look like something expensive to
          * do here in null_schedule(), but it's actually fine, because we do
          * it only in cases where a pcpu has no unit associated (e.g., as
          * said above, the cpu has just joined a cpupool).
          */
-        unit_found = false;
-        for_each_affinity_balance_step( bs )
+        wvc = waitq_pick(prv, sched_cpu);
+        if ( wvc )
         {
-            list_for_each_entry( wvc, &prv->waitq, waitq_elem )
+            spinlock_t *lock;
+
+            /*
+             * If the unit in the waitqueue has just come up online,
+             * we risk racing with vcpu_wake(). To avoid this, sync
+             * on the spinlock that vcpu_wake() holds, but only with
+             * trylock, to avoid deadlock).
+             */
+            lock = pcpu_schedule_trylock(sched_unit_master(wvc->unit));
+
+            /*
+             * We know the vcpu's lock is not this resource's lock. In
+             * fact, if it were, since this cpu is free, vcpu_wake()
+             * would have assigned the unit to here directly.
+             */
+            ASSERT(lock != get_sched_res(sched_cpu)->schedule_lock);
+
+            if ( lock )
             {
-                if ( bs == BALANCE_SOFT_AFFINITY &&
-                     !has_soft_affinity(wvc->unit) )
-                    continue;
-
-                if ( unit_check_affinity(wvc->unit, sched_cpu, bs) )
-                {
-                    spinlock_t *lock;
-
-                    unit_found = true;
-
-                    /*
-                     * If the unit in the waitqueue has just come up online,
-                     * we risk racing with vcpu_wake(). To avoid this, sync
-                     * on the spinlock that vcpu_wake() holds, but only with
-                     * trylock, to avoid deadlock).
-                     */
-                    lock = pcpu_schedule_trylock(sched_unit_master(wvc->unit));
-
-                    /*
-                     * We know the vcpu's lock is not this resource's lock. In
-                     * fact, if it were, since this cpu is free, vcpu_wake()
-                     * would have assigned the unit to here directly.
-                     */
-                    ASSERT(lock != get_sched_res(sched_cpu)->schedule_lock);
-
-                    if ( lock ) {
-                        unit_assign(prv, wvc->unit, sched_cpu);
-                        list_del_init(&wvc->waitq_elem);
-                        prev->next_task = wvc->unit;
-                        spin_unlock(lock);
-                        goto unlock;
-                    }
-                }
+                unit_assign(prv, wvc->unit, sched_cpu);
+                list_del_init(&wvc->waitq_elem);
+                prev->next_task = wvc->unit;
+                spin_unlock(lock);
             }
+            else
+                /*
+                 * We found a unit with suitable affinity in the waitqueue,
+                 * but we could not pick it up (due to lock contention), and
+                 * hence we are still free: plan for another try. In fact, we
+                 * don't want such unit to be stuck in the waitqueue, when
+                 * there are free cpus where it could run.
+                 */
+                cpu_raise_softirq(cur_cpu, SCHEDULE_SOFTIRQ);
         }
-        /*
-         * If we did find a unit with suitable affinity in the waitqueue, but
-         * we could not pick it up (due to lock contention), and hence we are
-         * still free, plan for another try. In fact, we don't want such unit
-         * to be stuck in the waitqueue, when there are free cpus where it
-         * could run.
-         */
-        if ( unlikely( unit_found && prev->next_task == NULL &&
-                       !list_empty(&prv->waitq)) )
-            cpu_raise_softirq(cur_cpu, SCHEDULE_SOFTIRQ);
  unlock:
         spin_unlock(&prv->waitq_lock);
 
@@ -310,6 +310,10 @@ struct scheduler {
                                     struct sched_unit *);
     void         (*yield)          (const struct scheduler *,
                                     struct sched_unit *);
+    /* Called with the target's lock held, not the yielding unit's. */
+    void         (*yield_to)       (const struct scheduler *,
+                                    struct sched_unit *,
+                                    struct sched_unit *target);
     void         (*context_saved)  (const struct scheduler *,
                                     struct sched_unit *);
 
@@ -442,6 +446,14 @@ static inline void sched_yield(const struct scheduler *s,
         s->yield(s, unit);
 }
 
+static inline void sched_yield_to(const struct scheduler *s,
+                                  struct sched_unit *unit,
+                                  struct sched_unit *target)
+{
+    if ( s->yield_to )
+        s->yield_to(s, unit, target);
+}
+
 static inline void sched_context_saved(const struct scheduler *s,
                                        struct sched_unit *unit)
 {
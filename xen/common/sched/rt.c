@@ -13,6 +13,7 @@
 
 #include <xen/init.h>
 #include <xen/lib.h>
+#include <xen/param.h>
 #include <xen/sched.h>
 #include <xen/domain.h>
 #include <xen/delay.h>
@@ -65,25 +66,34 @@
  * When an UNIT has no task but with budget left, its budget is preserved.
  *
  * Queue scheme:
- * A global runqueue and a global depletedqueue for each CPU pool.
+ * The pCPUs of a CPU pool are grouped into runqueues, according to the
+ * host topology and the rtds_runqueue parameter (see below). Each runqueue
+ * has its own runqueue, depletedqueue and replenishment queue.
  * The runqueue holds all runnable UNITs with budget,
  * sorted by priority_level and deadline;
  * The depletedqueue holds all UNITs without budget, unsorted;
+ * Within a runqueue, scheduling is global EDF; units only move to another
+ * runqueue when they are migrated (e.g., because of affinity changes).
+ * With the default of a single runqueue per pool, this is plain global EDF,
+ * while one runqueue per pCPU gives partitioned EDF.
  *
  * Note: cpumask and cpupool is supported.
  */
 
 /*
  * Locking:
- * A global system lock is used to protect the RunQ and DepletedQ.
- * The global lock is referenced by sched_res->schedule_lock
- * from all physical cpus.
+ * Each runqueue has a lock protecting its RunQ, DepletedQ and ReplQ.
+ * The lock is referenced by sched_res->schedule_lock of all the physical
+ * cpus of the runqueue.
  *
  * The lock is already grabbed when calling wake/sleep/schedule/ functions
  * in schedule.c
  *
  * The functions involes RunQ and needs to grab locks are:
  *    unit_insert, unit_remove, context_saved, runq_insert
+ *
+ * The private scheduler lock protects the lists of domains and runqueues.
+ * If both are needed, the private lock must be taken first.
  */
 
 
@@ -94,6 +104,45 @@
 #define RTDS_DEFAULT_PERIOD     (MICROSECS(10000))
 #define RTDS_DEFAULT_BUDGET     (MICROSECS(4000))
 
+/*
+ * Runqueue organization, same as for Credit2: pCPUs sharing a core, a socket
+ * or a NUMA node, or all the pCPUs of a pool, or each pCPU on its own, can be
+ * grouped into runqueues.  Default is one runqueue for the whole pool.
+ */
+#define OPT_RUNQUEUE_CPU    0
+#define OPT_RUNQUEUE_CORE   1
+#define OPT_RUNQUEUE_SOCKET 2
+#define OPT_RUNQUEUE_NODE   3
+#define OPT_RUNQUEUE_ALL    4
+static const char *const opt_runqueue_str[] = {
+    [OPT_RUNQUEUE_CPU] = "cpu",
+    [OPT_RUNQUEUE_CORE] = "core",
+    [OPT_RUNQUEUE_SOCKET] = "socket",
+    [OPT_RUNQUEUE_NODE] = "node",
+    [OPT_RUNQUEUE_ALL] = "all"
+};
+static int __read_mostly opt_runqueue = OPT_RUNQUEUE_ALL;
+
+static int __init parse_rtds_runqueue(const char *s)
+{
+    unsigned int i;
+
+    for ( i = 0; i < ARRAY_SIZE(opt_runqueue_str); i++ )
+    {
+        if ( !strcmp(s, opt_runqueue_str[i]) )
+        {
+            opt_runqueue = i;
+            return 0;
+        }
+    }
+
+    return -EINVAL;
+}
+custom_param("rtds_runqueue", parse_rtds_runqueue);
+
+/* Fixed point shift for the utilisation (budget / period) of an unit. */
+#define RTDS_UTIL_SHIFT     10
+
 /*
  * Max period: max delta of time type, because period is added to the time
  * an unit activates, so this must not overflow.
@@ -176,23 +225,46 @@
 static void repl_timer_handler(void *data);
 
 /*
- * System-wide private data, include global RunQueue/DepletedQ
- * Global lock is referenced by sched_res->schedule_lock from all
- * physical cpus. It can be grabbed via unit_schedule_lock_irq()
+ * Runqueue data, include RunQueue/DepletedQ/ReplQ
+ * The lock is referenced by sched_res->schedule_lock from all
+ * physical cpus of the runqueue. It can be grabbed via
+ * unit_schedule_lock_irq()
  */
-struct rt_private {
-    spinlock_t lock;            /* the global coarse-grained lock */
-    struct list_head sdom;      /* list of availalbe domains, used for dump */
+struct rt_runqueue {
+    spinlock_t lock;            /* the runqueue lock */
+    struct list_head rql;       /* on the list of runqueues */
+    int id;                     /* ID of this runqueue, for dumping */
+    unsigned int refcnt;        /* pCPUs (allocated or active) using it */
+    unsigned int pick_bias;     /* a pCPU of it, for topology matching */
+    const struct scheduler *ops; /* for the replenishment timer handler */
 
     struct list_head runq;      /* ordered list of runnable units */
     struct list_head depletedq; /* unordered list of depleted units */
 
     struct timer repl_timer;    /* replenishment timer */
     struct list_head replq;     /* ordered list of units that need replenishment */
+    unsigned long util;         /* sum of the utilisation of units on replq */
 
+    cpumask_t active;           /* cpus enabled for this runqueue */
     cpumask_t tickled;          /* cpus been tickled */
 };
 
+/*
+ * System-wide private data
+ */
+struct rt_private {
+    spinlock_t lock;            /* protects the sdom and rql lists */
+    struct list_head sdom;      /* list of availalbe domains, used for dump */
+    struct list_head rql;       /* list of runqueues */
+};
+
+/*
+ * Physical CPU
+ */
+struct rt_pcpu {
+    struct rt_runqueue *rqd;    /* runqueue this pCPU belongs to */
+};
+
 /*
  * Virtual CPU
  */
@@ -216,6 +288,8 @@ struct rt_unit {
     unsigned priority_level;
 
     unsigned flags;              /* mark __RTDS_scheduled, etc.. */
+
+    unsigned long util;          /* utilisation accounted on the replq */
 };
 
 /*
@@ -239,19 +313,21 @@ static inline struct rt_unit *rt_unit(const struct sched_unit *unit)
     return unit->priv;
 }
 
-static inline struct list_head *rt_runq(const struct scheduler *ops)
+static inline struct rt_pcpu *rt_pcpu(unsigned int cpu)
 {
-    return &rt_priv(ops)->runq;
+    return get_sched_res(cpu)->sched_priv;
 }
 
-static inline struct list_head *rt_depletedq(const struct scheduler *ops)
+/* Runqueue of a pCPU. */
+static inline struct rt_runqueue *c_rqd(unsigned int cpu)
 {
-    return &rt_priv(ops)->depletedq;
+    return rt_pcpu(cpu)->rqd;
 }
 
-static inline struct list_head *rt_replq(const struct scheduler *ops)
+/* Runqueue of an unit, i.e., of the pCPU it is assigned to. */
+static inline struct rt_runqueue *unit_rqd(const struct rt_unit *svc)
 {
-    return &rt_priv(ops)->replq;
+    return c_rqd(sched_unit_master(svc->unit));
 }
 
 static inline bool has_extratime(const struct rt_unit *svc)
@@ -351,58 +427,68 @@ rt_dump_unit(const struct scheduler *ops, const struct rt_unit *svc)
 static void
 rt_dump_pcpu(const struct scheduler *ops, int cpu)
 {
-    struct rt_private *prv = rt_priv(ops);
+    struct rt_runqueue *rqd = c_rqd(cpu);
     const struct rt_unit *svc;
     unsigned long flags;
 
-    spin_lock_irqsave(&prv->lock, flags);
-    printk("CPU[%02d]\n", cpu);
+    spin_lock_irqsave(&rqd->lock, flags);
+    printk("CPU[%02d] runq=%d\n", cpu, rqd->id);
     /* current UNIT (nothing to say if that's the idle unit). */
     svc = rt_unit(curr_on_cpu(cpu));
     if ( svc && !is_idle_unit(svc->unit) )
     {
         rt_dump_unit(ops, svc);
     }
-    spin_unlock_irqrestore(&prv->lock, flags);
+    spin_unlock_irqrestore(&rqd->lock, flags);
 }
 
 static void
 rt_dump(const struct scheduler *ops)
 {
-    struct list_head *runq, *depletedq, *replq, *iter;
+    struct list_head *iter;
     struct rt_private *prv = rt_priv(ops);
+    struct rt_runqueue *rqd;
     const struct rt_unit *svc;
     const struct rt_dom *sdom;
     unsigned long flags;
 
     spin_lock_irqsave(&prv->lock, flags);
 
+    printk("Runqueue arrangement: %s\n", opt_runqueue_str[opt_runqueue]);
+
     if ( list_empty(&prv->sdom) )
         goto out;
 
-    runq = rt_runq(ops);
-    depletedq = rt_depletedq(ops);
-    replq = rt_replq(ops);
-
-    printk("Global RunQueue info:\n");
-    list_for_each ( iter, runq )
+    list_for_each_entry ( rqd, &prv->rql, rql )
     {
-        svc = q_elem(iter);
-        rt_dump_unit(ops, svc);
-    }
+        /* No need to save IRQs here, they're already disabled */
+        spin_lock(&rqd->lock);
 
-    printk("Global DepletedQueue info:\n");
-    list_for_each ( iter, depletedq )
-    {
-        svc = q_elem(iter);
-        rt_dump_unit(ops, svc);
-    }
+        printk("Runqueue %d: cpus=%*pbl util=%lu\n", rqd->id,
+               CPUMASK_PR(&rqd->active), rqd->util);
 
-    printk("Global Replenishment Events info:\n");
-    list_for_each ( iter, replq )
-    {
-        svc = replq_elem(iter);
-        rt_dump_unit(ops, svc);
+        printk("RunQueue info:\n");
+        list_for_each ( iter, &rqd->runq )
+        {
+            svc = q_elem(iter);
+            rt_dump_unit(ops, svc);
+        }
+
+        printk("DepletedQueue info:\n");
+        list_for_each ( iter, &rqd->depletedq )
+        {
+            svc = q_elem(iter);
+            rt_dump_unit(ops, svc);
+        }
+
+        printk("Replenishment Events info:\n");
+        list_for_each ( iter, &rqd->replq )
+        {
+            svc = replq_elem(iter);
+            rt_dump_unit(ops, svc);
+        }
+
+        spin_unlock(&rqd->lock);
     }
 
     printk("Domain info:\n");
@@ -415,8 +501,12 @@ rt_dump(const struct scheduler *ops)
 
         for_each_sched_unit ( sdom->dom, unit )
         {
+            spinlock_t *lock = unit_schedule_lock(unit);
+
             svc = rt_unit(unit);
             rt_dump_unit(ops, svc);
+
+            unit_schedule_unlock(lock, unit);
         }
     }
 
@@ -532,11 +622,13 @@ q_remove(struct rt_unit *svc)
 static inline void
 replq_remove(const struct scheduler *ops, struct rt_unit *svc)
 {
-    struct rt_private *prv = rt_priv(ops);
-    struct list_head *replq = rt_replq(ops);
+    struct rt_runqueue *rqd = unit_rqd(svc);
+    struct list_head *replq = &rqd->replq;
 
     ASSERT( unit_on_replq(svc) );
 
+    rqd->util -= svc->util;
+
     if ( deadline_queue_remove(replq, &svc->replq_elem) )
     {
         /*
@@ -548,10 +640,10 @@ replq_remove(const struct scheduler *ops, struct rt_unit *svc)
         if ( !list_empty(replq) )
         {
             const struct rt_unit *svc_next = replq_elem(replq->next);
-            set_timer(&prv->repl_timer, svc_next->cur_deadline);
+            set_timer(&rqd->repl_timer, svc_next->cur_deadline);
         }
         else
-            stop_timer(&prv->repl_timer);
+            stop_timer(&rqd->repl_timer);
     }
 }
 
@@ -563,10 +655,10 @@ replq_remove(const struct scheduler *ops, struct rt_unit *svc)
 static void
 runq_insert(const struct scheduler *ops, struct rt_unit *svc)
 {
-    struct rt_private *prv = rt_priv(ops);
-    struct list_head *runq = rt_runq(ops);
+    struct rt_runqueue *rqd = unit_rqd(svc);
+    struct list_head *runq = &rqd->runq;
 
-    ASSERT( spin_is_locked(&prv->lock) );
+    ASSERT( spin_is_locked(&rqd->lock) );
     ASSERT( !unit_on_q(svc) );
     ASSERT( unit_on_replq(svc) );
 
@@ -575,23 +667,27 @@ runq_insert(const struct scheduler *ops, struct rt_unit *svc)
          has_extratime(svc) )
         deadline_runq_insert(svc, &svc->q_elem, runq);
     else
-        list_add(&svc->q_elem, &prv->depletedq);
+        list_add(&svc->q_elem, &rqd->depletedq);
 }
 
 static void
 replq_insert(const struct scheduler *ops, struct rt_unit *svc)
 {
-    struct list_head *replq = rt_replq(ops);
-    struct rt_private *prv = rt_priv(ops);
+    struct rt_runqueue *rqd = unit_rqd(svc);
+    struct list_head *replq = &rqd->replq;
 
     ASSERT( !unit_on_replq(svc) );
 
+    /* Account for the bandwidth of the unit, for load balancing. */
+    svc->util = (svc->budget << RTDS_UTIL_SHIFT) / svc->period;
+    rqd->util += svc->util;
+
     /*
      * The timer may be re-programmed if svc is inserted
      * at the front of the event list.
      */
     if ( deadline_replq_insert(svc, &svc->replq_elem, replq) )
-        set_timer(&prv->repl_timer, svc->cur_deadline);
+        set_timer(&rqd->repl_timer, svc->cur_deadline);
 }
 
 /*
@@ -603,7 +699,8 @@ replq_insert(const struct scheduler *ops, struct rt_unit *svc)
 static void
 replq_reinsert(const struct scheduler *ops, struct rt_unit *svc)
 {
-    struct list_head *replq = rt_replq(ops);
+    struct rt_runqueue *rqd = unit_rqd(svc);
+    struct list_head *replq = &rqd->replq;
     const struct rt_unit *rearm_svc = svc;
     bool rearm = false;
 
@@ -628,7 +725,7 @@ replq_reinsert(const struct scheduler *ops, struct rt_unit *svc)
         rearm = deadline_replq_insert(svc, &svc->replq_elem, replq);
 
     if ( rearm )
-        set_timer(&rt_priv(ops)->repl_timer, rearm_svc->cur_deadline);
+        set_timer(&rqd->repl_timer, rearm_svc->cur_deadline);
 }
 
 /*
@@ -651,6 +748,28 @@ rt_res_pick_locked(const struct sched_unit *unit, unsigned int locked_cpu)
             : cpumask_cycle(sched_unit_master(unit), cpus);
     ASSERT( !cpumask_empty(cpus) && cpumask_test_cpu(cpu, cpus) );
 
+    /*
+     * With more than one runqueue, and if the unit has to move anyway, send
+     * it to the runqueue with the lowest reserved bandwidth.  The sums are
+     * read without holding the runqueue locks, which is fine for a hint.
+     */
+    if ( opt_runqueue != OPT_RUNQUEUE_ALL && cpu != sched_unit_master(unit) )
+    {
+        unsigned long best_util = read_atomic(&c_rqd(cpu)->util);
+        unsigned int i;
+
+        for_each_cpu ( i, cpus )
+        {
+            unsigned long util = read_atomic(&c_rqd(i)->util);
+
+            if ( util < best_util )
+            {
+                best_util = util;
+                cpu = i;
+            }
+        }
+    }
+
     return get_sched_res(cpu);
 }
 
@@ -687,9 +806,7 @@ rt_init(struct scheduler *ops)
 
     spin_lock_init(&prv->lock);
     INIT_LIST_HEAD(&prv->sdom);
-    INIT_LIST_HEAD(&prv->runq);
-    INIT_LIST_HEAD(&prv->depletedq);
-    INIT_LIST_HEAD(&prv->replq);
+    INIT_LIST_HEAD(&prv->rql);
 
     ops->sched_data = prv;
     rc = 0;
@@ -706,48 +823,209 @@ rt_deinit(struct scheduler *ops)
 {
     struct rt_private *prv = rt_priv(ops);
 
-    ASSERT(prv->repl_timer.status == TIMER_STATUS_invalid ||
-           prv->repl_timer.status == TIMER_STATUS_killed);
+    ASSERT(list_empty(&prv->rql));
 
     ops->sched_data = NULL;
     xfree(prv);
 }
 
+static inline bool same_node(unsigned int cpua, unsigned int cpub)
+{
+    return cpu_to_node(cpua) == cpu_to_node(cpub);
+}
+
+static inline bool same_socket(unsigned int cpua, unsigned int cpub)
+{
+    return cpu_to_socket(cpua) == cpu_to_socket(cpub);
+}
+
+static inline bool same_core(unsigned int cpua, unsigned int cpub)
+{
+    return same_socket(cpua, cpub) &&
+           cpu_to_core(cpua) == cpu_to_core(cpub);
+}
+
+static inline bool
+cpu_runqueue_match(const struct rt_runqueue *rqd, unsigned int cpu)
+{
+    unsigned int peer_cpu = rqd->pick_bias;
+
+    /* OPT_RUNQUEUE_CPU will never find an existing runqueue. */
+    return opt_runqueue == OPT_RUNQUEUE_ALL ||
+           (opt_runqueue == OPT_RUNQUEUE_CORE && same_core(peer_cpu, cpu)) ||
+           (opt_runqueue == OPT_RUNQUEUE_SOCKET && same_socket(peer_cpu, cpu)) ||
+           (opt_runqueue == OPT_RUNQUEUE_NODE && same_node(peer_cpu, cpu));
+}
+
+/*
+ * Find (or create) the runqueue a pCPU should be put in. Runqueues are kept
+ * ordered by id, and a new one takes the first unused id.
+ */
+static struct rt_runqueue *
+cpu_add_to_runqueue(const struct scheduler *ops, unsigned int cpu)
+{
+    struct rt_private *prv = rt_priv(ops);
+    struct rt_runqueue *rqd, *rqd_new;
+    struct list_head *rqd_ins;
+    unsigned long flags;
+    int rqi = 0;
+    bool rqi_unused = false;
+
+    /* Prealloc in case we need it - not allowed with interrupts off. */
+    rqd_new = xzalloc(struct rt_runqueue);
+
+    spin_lock_irqsave(&prv->lock, flags);
+
+    rqd_ins = &prv->rql;
+    list_for_each_entry ( rqd, &prv->rql, rql )
+    {
+        if ( cpu_runqueue_match(rqd, cpu) )
+            goto found;
+
+        /* Remember first unused queue index. */
+        if ( !rqi_unused && rqd->id > rqi )
+            rqi_unused = true;
+
+        if ( !rqi_unused )
+        {
+            rqi++;
+            rqd_ins = &rqd->rql;
+        }
+    }
+
+    if ( !rqd_new )
+    {
+        rqd = ERR_PTR(-ENOMEM);
+        goto out;
+    }
+    rqd = rqd_new;
+    rqd_new = NULL;
+
+    spin_lock_init(&rqd->lock);
+    INIT_LIST_HEAD(&rqd->runq);
+    INIT_LIST_HEAD(&rqd->depletedq);
+    INIT_LIST_HEAD(&rqd->replq);
+    list_add(&rqd->rql, rqd_ins);
+    rqd->pick_bias = cpu;
+    rqd->id = rqi;
+    rqd->ops = ops;
+
+ found:
+    rqd->refcnt++;
+
+ out:
+    spin_unlock_irqrestore(&prv->lock, flags);
+
+    xfree(rqd_new);
+
+    return rqd;
+}
+
+static void *
+rt_alloc_pdata(const struct scheduler *ops, int cpu)
+{
+    struct rt_pcpu *spc;
+    struct rt_runqueue *rqd;
+
+    spc = xzalloc(struct rt_pcpu);
+    if ( spc == NULL )
+        return ERR_PTR(-ENOMEM);
+
+    rqd = cpu_add_to_runqueue(ops, cpu);
+    if ( IS_ERR(rqd) )
+    {
+        xfree(spc);
+        return rqd;
+    }
+
+    spc->rqd = rqd;
+
+    return spc;
+}
+
+static void
+rt_free_pdata(const struct scheduler *ops, void *pcpu, int cpu)
+{
+    struct rt_private *prv = rt_priv(ops);
+    struct rt_pcpu *spc = pcpu;
+    struct rt_runqueue *rqd;
+    unsigned long flags;
+
+    if ( !spc )
+        return;
+
+    spin_lock_irqsave(&prv->lock, flags);
+
+    rqd = spc->rqd;
+    ASSERT(rqd && rqd->refcnt);
+    ASSERT(!cpumask_test_cpu(cpu, &rqd->active));
+
+    rqd->refcnt--;
+    if ( !rqd->refcnt )
+    {
+        ASSERT(rqd->repl_timer.status == TIMER_STATUS_invalid ||
+               rqd->repl_timer.status == TIMER_STATUS_killed);
+        list_del(&rqd->rql);
+    }
+    else
+        rqd = NULL;
+
+    spin_unlock_irqrestore(&prv->lock, flags);
+
+    xfree(rqd);
+    xfree(spc);
+}
+
 /* Change the scheduler of cpu to us (RTDS). */
 static spinlock_t *
 rt_switch_sched(struct scheduler *new_ops, unsigned int cpu,
                 void *pdata, void *vdata)
 {
     struct rt_private *prv = rt_priv(new_ops);
+    struct rt_pcpu *spc = pdata;
     struct rt_unit *svc = vdata;
+    struct rt_runqueue *rqd;
+
+    ASSERT(spc && svc && is_idle_unit(svc->unit));
 
-    ASSERT(!pdata && svc && is_idle_unit(svc->unit));
+    rqd = spc->rqd;
 
     /*
      * We are holding the runqueue lock already (it's been taken in
      * schedule_cpu_switch()). It's actually the runqueue lock of
      * another scheduler, but that is how things need to be, for
-     * preventing races.
+     * preventing races. It having no ordering relationship with our own
+     * locks, it's fine to take our private lock after it.
      */
-    ASSERT(get_sched_res(cpu)->schedule_lock != &prv->lock);
+    ASSERT(get_sched_res(cpu)->schedule_lock != &rqd->lock);
+    ASSERT(!local_irq_is_enabled());
+
+    spin_lock(&prv->lock);
 
     /*
      * If we are the absolute first cpu being switched toward this
-     * scheduler (in which case we'll see TIMER_STATUS_invalid), or the
-     * first one that is added back to the cpupool that had all its cpus
+     * runqueue (in which case we'll see TIMER_STATUS_invalid), or the
+     * first one that is added back to a runqueue that had all its cpus
      * removed (in which case we'll see TIMER_STATUS_killed), it's our
      * job to (re)initialize the timer.
      */
-    if ( prv->repl_timer.status == TIMER_STATUS_invalid ||
-         prv->repl_timer.status == TIMER_STATUS_killed )
+    if ( rqd->repl_timer.status == TIMER_STATUS_invalid ||
+         rqd->repl_timer.status == TIMER_STATUS_killed )
     {
-        init_timer(&prv->repl_timer, repl_timer_handler, (void *)new_ops, cpu);
-        dprintk(XENLOG_DEBUG, "RTDS: timer initialized on cpu %u\n", cpu);
+        init_timer(&rqd->repl_timer, repl_timer_handler, rqd, cpu);
+        dprintk(XENLOG_DEBUG, "RTDS: runq %d timer initialized on cpu %u\n",
+                rqd->id, cpu);
     }
 
+    if ( cpumask_empty(&rqd->active) )
+        rqd->pick_bias = cpu;
+    __cpumask_set_cpu(cpu, &rqd->active);
+
     sched_idle_unit(cpu)->priv = vdata;
 
-    return &prv->lock;
+    spin_unlock(&prv->lock);
+
+    return &rqd->lock;
 }
 
 static void
@@ -755,28 +1033,50 @@ rt_deinit_pdata(const struct scheduler *ops, void *pcpu, int cpu)
 {
     unsigned long flags;
     struct rt_private *prv = rt_priv(ops);
+    struct rt_pcpu *spc = pcpu;
+    struct rt_runqueue *rqd;
+    bool kill = false;
+
+    ASSERT(spc && spc->rqd);
+    rqd = spc->rqd;
 
     spin_lock_irqsave(&prv->lock, flags);
+    /* No need to save IRQs here, they're already disabled */
+    spin_lock(&rqd->lock);
+
+    __cpumask_clear_cpu(cpu, &rqd->active);
+    __cpumask_clear_cpu(cpu, &rqd->tickled);
+
+    if ( rqd->pick_bias == cpu && !cpumask_empty(&rqd->active) )
+        rqd->pick_bias = cpumask_first(&rqd->active);
 
-    if ( prv->repl_timer.cpu == cpu )
+    if ( rqd->repl_timer.cpu == cpu )
     {
-        cpumask_t *online = get_sched_res(cpu)->cpupool->res_valid;
-        unsigned int new_cpu = cpumask_cycle(cpu, online);
+        unsigned int new_cpu = cpumask_cycle(cpu, &rqd->active);
 
         /*
          * Make sure the timer run on one of the cpus that are still available
-         * to this scheduler. If there aren't any left, it means it's the time
+         * to this runqueue. If there aren't any left, it means it's the time
          * to just kill it.
          */
         if ( new_cpu >= nr_cpu_ids )
-        {
-            kill_timer(&prv->repl_timer);
-            dprintk(XENLOG_DEBUG, "RTDS: timer killed on cpu %d\n", cpu);
-        }
+            kill = true;
         else
-        {
-            migrate_timer(&prv->repl_timer, new_cpu);
-        }
+            migrate_timer(&rqd->repl_timer, new_cpu);
+    }
+
+    spin_unlock(&rqd->lock);
+
+    /*
+     * With no cpus left, no unit can be queued here any longer. Kill the
+     * timer without holding the runqueue lock, as the handler may be
+     * spinning on it.
+     */
+    if ( kill )
+    {
+        kill_timer(&rqd->repl_timer);
+        dprintk(XENLOG_DEBUG, "RTDS: runq %d timer killed on cpu %d\n",
+                rqd->id, cpu);
     }
 
     spin_unlock_irqrestore(&prv->lock, flags);
@@ -991,9 +1291,9 @@ burn_budget(const struct scheduler *ops, struct rt_unit *svc, s_time_t now)
  * lock is grabbed before calling this function
  */
 static struct rt_unit *
-runq_pick(const struct scheduler *ops, const cpumask_t *mask, unsigned int cpu)
+runq_pick(struct rt_runqueue *rqd, const cpumask_t *mask, unsigned int cpu)
 {
-    struct list_head *runq = rt_runq(ops);
+    struct list_head *runq = &rqd->runq;
     struct list_head *iter;
     struct rt_unit *svc = NULL;
     struct rt_unit *iter_svc = NULL;
@@ -1048,7 +1348,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
 {
     const unsigned int cur_cpu = smp_processor_id();
     const unsigned int sched_cpu = sched_get_resource_cpu(cur_cpu);
-    struct rt_private *prv = rt_priv(ops);
+    struct rt_runqueue *rqd = c_rqd(sched_cpu);
     struct rt_unit *const scurr = rt_unit(currunit);
     struct rt_unit *snext = NULL;
     bool migrated = false;
@@ -1060,7 +1360,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
         } d;
         d.cpu = cur_cpu;
         d.tasklet = tasklet_work_scheduled;
-        d.tickled = cpumask_test_cpu(sched_cpu, &prv->tickled);
+        d.tickled = cpumask_test_cpu(sched_cpu, &rqd->tickled);
         d.idle = is_idle_unit(currunit);
         trace_var(TRC_RTDS_SCHEDULE, 1,
                   sizeof(d),
@@ -1068,7 +1368,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
     }
 
     /* clear ticked bit now that we've been scheduled */
-    cpumask_clear_cpu(sched_cpu, &prv->tickled);
+    cpumask_clear_cpu(sched_cpu, &rqd->tickled);
 
     /* burn_budget would return for IDLE UNIT */
     burn_budget(ops, scurr, now);
@@ -1080,7 +1380,7 @@ rt_schedule(const struct scheduler *ops, struct sched_unit *currunit,
     }
     else
     {
-        snext = runq_pick(ops, cpumask_of(sched_cpu), cur_cpu);
+        snext = runq_pick(rqd, cpumask_of(sched_cpu), cur_cpu);
 
         if ( snext == NULL )
             snext = rt_unit(sched_idle_unit(sched_cpu));
@@ -1169,7 +1469,7 @@ rt_unit_sleep(const struct scheduler *ops, struct sched_unit *unit)
 static void
 runq_tickle(const struct scheduler *ops, const struct rt_unit *new)
 {
-    struct rt_private *prv = rt_priv(ops);
+    struct rt_runqueue *rqd;
     const struct rt_unit *latest_deadline_unit = NULL; /* lowest priority */
     const struct rt_unit *iter_svc;
     const struct sched_unit *iter_unit;
@@ -1180,9 +1480,12 @@ runq_tickle(const struct scheduler *ops, const struct rt_unit *new)
     if ( new == NULL || is_idle_unit(new->unit) )
         return;
 
+    /* Only the cpus of the unit's runqueue can pick it from there. */
+    rqd = unit_rqd(new);
     online = cpupool_domain_master_cpumask(new->unit->domain);
     cpumask_and(not_tickled, online, new->unit->cpu_hard_affinity);
-    cpumask_andnot(not_tickled, not_tickled, &prv->tickled);
+    cpumask_and(not_tickled, not_tickled, &rqd->active);
+    cpumask_andnot(not_tickled, not_tickled, &rqd->tickled);
 
     /*
      * 1) If there are any idle CPUs, kick one.
@@ -1233,7 +1536,7 @@ runq_tickle(const struct scheduler *ops, const struct rt_unit *new)
                   (unsigned char *)&d);
     }
 
-    cpumask_set_cpu(cpu_to_tickle, &prv->tickled);
+    cpumask_set_cpu(cpu_to_tickle, &rqd->tickled);
     cpu_raise_softirq(cpu_to_tickle, SCHEDULE_SOFTIRQ);
     return;
 }
@@ -1347,9 +1650,9 @@ rt_dom_cntl(
     struct domain *d,
     struct xen_domctl_scheduler_op *op)
 {
-    struct rt_private *prv = rt_priv(ops);
     struct rt_unit *svc;
     const struct sched_unit *unit;
+    spinlock_t *lock;
     unsigned long flags;
     int rc = 0;
     struct xen_domctl_schedparam_vcpu local_sched;
@@ -1369,14 +1672,14 @@ rt_dom_cntl(
             rc = -EINVAL;
             break;
         }
-        spin_lock_irqsave(&prv->lock, flags);
         for_each_sched_unit ( d, unit )
         {
+            lock = unit_schedule_lock_irqsave(unit, &flags);
             svc = rt_unit(unit);
             svc->period = MICROSECS(op->u.rtds.period); /* transfer to nanosec */
             svc->budget = MICROSECS(op->u.rtds.budget);
+            unit_schedule_unlock_irqrestore(lock, flags, unit);
         }
-        spin_unlock_irqrestore(&prv->lock, flags);
         break;
     case XEN_DOMCTL_SCHEDOP_getvcpuinfo:
     case XEN_DOMCTL_SCHEDOP_putvcpuinfo:
@@ -1395,17 +1698,19 @@ rt_dom_cntl(
                 break;
             }
 
+            unit = d->vcpu[local_sched.vcpuid]->sched_unit;
+
             if ( op->cmd == XEN_DOMCTL_SCHEDOP_getvcpuinfo )
             {
-                spin_lock_irqsave(&prv->lock, flags);
-                svc = rt_unit(d->vcpu[local_sched.vcpuid]->sched_unit);
+                lock = unit_schedule_lock_irqsave(unit, &flags);
+                svc = rt_unit(unit);
                 local_sched.u.rtds.budget = svc->budget / MICROSECS(1);
                 local_sched.u.rtds.period = svc->period / MICROSECS(1);
                 if ( has_extratime(svc) )
                     local_sched.u.rtds.flags |= XEN_DOMCTL_SCHEDRT_extra;
                 else
                     local_sched.u.rtds.flags &= ~XEN_DOMCTL_SCHEDRT_extra;
-                spin_unlock_irqrestore(&prv->lock, flags);
+                unit_schedule_unlock_irqrestore(lock, flags, unit);
 
                 if ( copy_to_guest_offset(op->u.v.vcpus, index,
                                           &local_sched, 1) )
@@ -1425,15 +1730,15 @@ rt_dom_cntl(
                     break;
                 }
 
-                spin_lock_irqsave(&prv->lock, flags);
-                svc = rt_unit(d->vcpu[local_sched.vcpuid]->sched_unit);
+                lock = unit_schedule_lock_irqsave(unit, &flags);
+                svc = rt_unit(unit);
                 svc->period = period;
                 svc->budget = budget;
                 if ( local_sched.u.rtds.flags & XEN_DOMCTL_SCHEDRT_extra )
                     __set_bit(__RTDS_extratime, &svc->flags);
                 else
                     __clear_bit(__RTDS_extratime, &svc->flags);
-                spin_unlock_irqrestore(&prv->lock, flags);
+                unit_schedule_unlock_irqrestore(lock, flags, unit);
             }
             /* Process a most 64 vCPUs without checking for preemptions. */
             if ( (++index > 63) && hypercall_preempt_check() )
@@ -1454,15 +1759,15 @@ rt_dom_cntl(
  */
 static void repl_timer_handler(void *data){
     s_time_t now;
-    const struct scheduler *ops = data;
-    struct rt_private *prv = rt_priv(ops);
-    struct list_head *replq = rt_replq(ops);
-    struct list_head *runq = rt_runq(ops);
+    struct rt_runqueue *rqd = data;
+    const struct scheduler *ops = rqd->ops;
+    struct list_head *replq = &rqd->replq;
+    struct list_head *runq = &rqd->runq;
     struct list_head *iter, *tmp;
     struct rt_unit *svc;
     LIST_HEAD(tmp_replq);
 
-    spin_lock_irq(&prv->lock);
+    spin_lock_irq(&rqd->lock);
 
     now = NOW();
 
@@ -1523,9 +1828,9 @@ static void repl_timer_handler(void *data){
      * the one in the front.
      */
     if ( !list_empty(replq) )
-        set_timer(&prv->repl_timer, replq_elem(replq->next)->cur_deadline);
+        set_timer(&rqd->repl_timer, replq_elem(replq->next)->cur_deadline);
 
-    spin_unlock_irq(&prv->lock);
+    spin_unlock_irq(&rqd->lock);
 }
 
 static const struct scheduler sched_rtds_def = {
@@ -1539,7 +1844,9 @@ static const struct scheduler sched_rtds_def = {
     .init           = rt_init,
     .deinit         = rt_deinit,
     .switch_sched   = rt_switch_sched,
+    .alloc_pdata    = rt_alloc_pdata,
     .deinit_pdata   = rt_deinit_pdata,
+    .free_pdata     = rt_free_pdata,
     .alloc_domdata  = rt_alloc_domdata,
     .free_domdata   = rt_free_domdata,
     .alloc_udata    = rt_alloc_udata,
@@ -116,24 +116,42 @@ void spin_debug_disable(void)
 
 #ifdef CONFIG_DEBUG_LOCK_PROFILE
 
+static void lock_profile_rel(struct lock_profile *prof)
+{
+    s_time_t hold = NOW() - prof->time_locked;
+
+    prof->time_hold += hold;
+    if ( hold > prof->time_hold_max )
+        prof->time_hold_max = hold;
+    prof->lock_cnt++;
+}
+
+static void lock_profile_got(struct lock_profile *prof, s_time_t block,
+                             unsigned int waiters)
+{
+    prof->time_locked = NOW();
+    if ( block )
+    {
+        s_time_t wait = prof->time_locked - block;
+
+        prof->time_block += wait;
+        if ( wait > prof->time_block_max )
+            prof->time_block_max = wait;
+        if ( waiters > prof->waiters_max )
+            prof->waiters_max = waiters;
+        prof->block_cnt++;
+    }
+}
+
 #define LOCK_PROFILE_REL                                                     \
     if (lock->profile)                                                       \
-    {                                                                        \
-        lock->profile->time_hold += NOW() - lock->profile->time_locked;      \
-        lock->profile->lock_cnt++;                                           \
-    }
+        lock_profile_rel(lock->profile);
 #define LOCK_PROFILE_VAR    s_time_t block = 0
 #define LOCK_PROFILE_BLOCK  block = block ? : NOW();
 #define LOCK_PROFILE_GOT                                                     \
     if (lock->profile)                                                       \
-    {                                                                        \
-        lock->profile->time_locked = NOW();                                  \
-        if (block)                                                           \
-        {                                                                    \
-            lock->profile->time_block += lock->profile->time_locked - block; \
-            lock->profile->block_cnt++;                                      \
-        }                                                                    \
-    }
+        lock_profile_got(lock->profile, block,                               \
+                         (typeof(tickets.tail))(tickets.tail - tickets.head));
 
 #else
 
@@ -159,20 +177,40 @@ static always_inline u16 observe_head(spinlock_tickets_t *t)
     return read_atomic(&t->head);
 }
 
+/*
+ * Number of cpu_relax() iterations to back off for per waiter queued ahead
+ * of us, beyond the immediately next one, and the upper bound of waiters
+ * taken into account.  Waiters further back in the queue thus poll the
+ * lock's cache line less frequently, leaving the bandwidth to the owner's
+ * unlock and the next waiter.
+ */
+#define SPIN_BACKOFF_UNIT    8
+#define SPIN_BACKOFF_MAX     32
+
+static always_inline void spin_backoff(u16 ahead)
+{
+    unsigned int i = min_t(unsigned int, ahead, SPIN_BACKOFF_MAX);
+
+    for ( i = (i - 1) * SPIN_BACKOFF_UNIT; i; i-- )
+        cpu_relax();
+}
+
 void inline _spin_lock_cb(spinlock_t *lock, void (*cb)(void *), void *data)
 {
     spinlock_tickets_t tickets = SPINLOCK_TICKET_INC;
+    u16 head;
     LOCK_PROFILE_VAR;
 
     check_lock(&lock->debug, false);
     preempt_disable();
     tickets.head_tail = arch_fetch_and_add(&lock->tickets.head_tail,
                                            tickets.head_tail);
-    while ( tickets.tail != observe_head(&lock->tickets) )
+    while ( tickets.tail != (head = observe_head(&lock->tickets)) )
     {
         LOCK_PROFILE_BLOCK;
         if ( unlikely(cb) )
             cb(data);
+        spin_backoff(tickets.tail - head);
         arch_lock_relax();
     }
     arch_lock_acquire_barrier();
@@ -391,6 +429,9 @@ static void spinlock_profile_print_elem(struct lock_profile *data,
         printk("cpu=%d\n", lock->debug.cpu);
     printk("  lock:%" PRId64 "(%" PRI_stime "), block:%" PRId64 "(%" PRI_stime ")\n",
            data->lock_cnt, data->time_hold, data->block_cnt, data->time_block);
+    printk("  max hold:%" PRI_stime ", max block:%" PRI_stime
+           ", max waiters:%u\n",
+           data->time_hold_max, data->time_block_max, data->waiters_max);
 }
 
 void spinlock_profile_printall(unsigned char key)
@@ -411,6 +452,9 @@ static void spinlock_profile_reset_elem(struct lock_profile *data,
     data->block_cnt = 0;
     data->time_hold = 0;
     data->time_block = 0;
+    data->time_hold_max = 0;
+    data->time_block_max = 0;
+    data->waiters_max = 0;
 }
 
 void spinlock_profile_reset(unsigned char key)
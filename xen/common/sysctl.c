@@ -81,6 +81,10 @@ long do_sysctl(XEN_GUEST_HANDLE_PARAM(xen_sysctl_t) u_sysctl)
 
         rcu_read_lock(&domlist_read_lock);
 
+        /* Sampled first, so a racing update is seen as a change next time. */
+        op->u.getdomaininfolist.generation = read_atomic(&domlist_generation);
+        smp_rmb();
+
         for_each_domain ( d )
         {
             if ( d->domain_id < op->u.getdomaininfolist.first_domain )
@@ -27,12 +27,20 @@ DEFINE_PER_CPU(unsigned long, tasklet_work_to_do);
 static DEFINE_PER_CPU(struct list_head, tasklet_list);
 static DEFINE_PER_CPU(struct list_head, softirq_tasklet_list);
 
-/* Protects all lists and tasklet structures. */
-static DEFINE_SPINLOCK(tasklet_lock);
+/*
+ * Protects both of a CPU's lists.  Tasklet state (including which list a
+ * tasklet is on) is protected by the tasklet's own lock, which nests
+ * outside of these.  All locks are taken with interrupts disabled.
+ */
+static DEFINE_PER_CPU(spinlock_t, tasklet_lock);
 
+/* Called with the tasklet's lock held. */
 static void tasklet_enqueue(struct tasklet *t)
 {
     unsigned int cpu = t->scheduled_on;
+    spinlock_t *lock = &per_cpu(tasklet_lock, cpu);
+
+    spin_lock(lock);
 
     if ( t->is_softirq )
     {
@@ -49,25 +57,76 @@ static void tasklet_enqueue(struct tasklet *t)
         if ( !test_and_set_bit(_TASKLET_enqueued, work_to_do) )
             cpu_raise_softirq(cpu, SCHEDULE_SOFTIRQ);
     }
+
+    spin_unlock(lock);
+}
+
+/* Called with the tasklet's lock held. */
+static void tasklet_unlink(struct tasklet *t)
+{
+    spinlock_t *lock;
+
+    if ( list_empty(&t->list) )
+        return;
+
+    lock = &per_cpu(tasklet_lock, t->scheduled_on);
+    spin_lock(lock);
+    list_del_init(&t->list);
+    spin_unlock(lock);
+}
+
+/*
+ * Take the first tasklet off one of @cpu's lists, returning it with its lock
+ * held.  Lock order is tasklet before list, hence the trylock; contention is
+ * limited to concurrent (re)scheduling or killing of that very tasklet.
+ * Called with interrupts disabled.
+ */
+static struct tasklet *tasklet_dequeue(unsigned int cpu,
+                                       struct list_head *list)
+{
+    spinlock_t *lock = &per_cpu(tasklet_lock, cpu);
+    struct tasklet *t;
+
+    for ( ; ; )
+    {
+        spin_lock(lock);
+
+        if ( list_empty(list) )
+        {
+            spin_unlock(lock);
+            return NULL;
+        }
+
+        t = list_entry(list->next, struct tasklet, list);
+        if ( spin_trylock(&t->lock) )
+            break;
+
+        spin_unlock(lock);
+        cpu_relax();
+    }
+
+    list_del_init(&t->list);
+    spin_unlock(lock);
+
+    return t;
 }
 
 void tasklet_schedule_on_cpu(struct tasklet *t, unsigned int cpu)
 {
     unsigned long flags;
 
-    spin_lock_irqsave(&tasklet_lock, flags);
+    spin_lock_irqsave(&t->lock, flags);
 
     if ( tasklets_initialised && !t->is_dead )
     {
+        if ( !t->is_running )
+            tasklet_unlink(t);
         t->scheduled_on = cpu;
         if ( !t->is_running )
-        {
-            list_del(&t->list);
             tasklet_enqueue(t);
-        }
     }
 
-    spin_unlock_irqrestore(&tasklet_lock, flags);
+    spin_unlock_irqrestore(&t->lock, flags);
 }
 
 void tasklet_schedule(struct tasklet *t)
@@ -75,24 +134,26 @@ void tasklet_schedule(struct tasklet *t)
     tasklet_schedule_on_cpu(t, smp_processor_id());
 }
 
+/* Called with interrupts disabled. */
 static void do_tasklet_work(unsigned int cpu, struct list_head *list)
 {
     struct tasklet *t;
 
-    if ( unlikely(list_empty(list) || cpu_is_offline(cpu)) )
+    if ( unlikely(cpu_is_offline(cpu)) )
         return;
 
-    t = list_entry(list->next, struct tasklet, list);
-    list_del_init(&t->list);
+    t = tasklet_dequeue(cpu, list);
+    if ( unlikely(!t) )
+        return;
 
     BUG_ON(t->is_dead || t->is_running || (t->scheduled_on != cpu));
     t->scheduled_on = -1;
     t->is_running = 1;
 
-    spin_unlock_irq(&tasklet_lock);
+    spin_unlock_irq(&t->lock);
     sync_local_execstate();
     t->func(t->data);
-    spin_lock_irq(&tasklet_lock);
+    spin_lock_irq(&t->lock);
 
     t->is_running = 0;
 
@@ -101,6 +162,8 @@ static void do_tasklet_work(unsigned int cpu, struct list_head *list)
         BUG_ON(t->is_dead || !list_empty(&t->list));
         tasklet_enqueue(t);
     }
+
+    spin_unlock(&t->lock);
 }
 
 /* VCPU context work */
@@ -109,6 +172,7 @@ void do_tasklet(void)
     unsigned int cpu = smp_processor_id();
     unsigned long *work_to_do = &per_cpu(tasklet_work_to_do, cpu);
     struct list_head *list = &per_cpu(tasklet_list, cpu);
+    spinlock_t *lock = &per_cpu(tasklet_lock, cpu);
 
     /*
      * We want to be sure any caller has checked that a tasklet is both
@@ -121,17 +185,19 @@ void do_tasklet(void)
      */
     ASSERT(tasklet_work_to_do(cpu));
 
-    spin_lock_irq(&tasklet_lock);
+    local_irq_disable();
 
     do_tasklet_work(cpu, list);
 
+    spin_lock(lock);
+
     if ( list_empty(list) )
     {
-        clear_bit(_TASKLET_enqueued, work_to_do);        
+        clear_bit(_TASKLET_enqueued, work_to_do);
         raise_softirq(SCHEDULE_SOFTIRQ);
     }
 
-    spin_unlock_irq(&tasklet_lock);
+    spin_unlock_irq(lock);
 }
 
 /* Softirq context work */
@@ -139,31 +205,34 @@ static void tasklet_softirq_action(void)
 {
     unsigned int cpu = smp_processor_id();
     struct list_head *list = &per_cpu(softirq_tasklet_list, cpu);
+    spinlock_t *lock = &per_cpu(tasklet_lock, cpu);
 
-    spin_lock_irq(&tasklet_lock);
+    local_irq_disable();
 
     do_tasklet_work(cpu, list);
 
+    spin_lock(lock);
+
     if ( !list_empty(list) && !cpu_is_offline(cpu) )
         raise_softirq(TASKLET_SOFTIRQ);
 
-    spin_unlock_irq(&tasklet_lock);
+    spin_unlock_irq(lock);
 }
 
 void tasklet_kill(struct tasklet *t)
 {
     unsigned long flags;
 
-    spin_lock_irqsave(&tasklet_lock, flags);
-
     /* Cope with uninitialised tasklets. */
     if ( list_head_is_null(&t->list) )
-        goto unlock;
+        return;
+
+    spin_lock_irqsave(&t->lock, flags);
 
     if ( !list_empty(&t->list) )
     {
         BUG_ON(t->is_dead || t->is_running || (t->scheduled_on < 0));
-        list_del_init(&t->list);
+        tasklet_unlink(t);
     }
 
     t->scheduled_on = -1;
@@ -171,13 +240,12 @@ void tasklet_kill(struct tasklet *t)
 
     while ( t->is_running )
     {
-        spin_unlock_irqrestore(&tasklet_lock, flags);
+        spin_unlock_irqrestore(&t->lock, flags);
         cpu_relax();
-        spin_lock_irqsave(&tasklet_lock, flags);
+        spin_lock_irqsave(&t->lock, flags);
     }
 
- unlock:
-    spin_unlock_irqrestore(&tasklet_lock, flags);
+    spin_unlock_irqrestore(&t->lock, flags);
 }
 
 static void migrate_tasklets_from_cpu(unsigned int cpu, struct list_head *list)
@@ -185,24 +253,24 @@ static void migrate_tasklets_from_cpu(unsigned int cpu, struct list_head *list)
     unsigned long flags;
     struct tasklet *t;
 
-    spin_lock_irqsave(&tasklet_lock, flags);
+    local_irq_save(flags);
 
-    while ( !list_empty(list) )
+    while ( (t = tasklet_dequeue(cpu, list)) != NULL )
     {
-        t = list_entry(list->next, struct tasklet, list);
         BUG_ON(t->scheduled_on != cpu);
         t->scheduled_on = smp_processor_id();
-        list_del(&t->list);
         tasklet_enqueue(t);
+        spin_unlock(&t->lock);
     }
 
-    spin_unlock_irqrestore(&tasklet_lock, flags);
+    local_irq_restore(flags);
 }
 
 void tasklet_init(struct tasklet *t, void (*func)(void *), void *data)
 {
     memset(t, 0, sizeof(*t));
     INIT_LIST_HEAD(&t->list);
+    spin_lock_init(&t->lock);
     t->scheduled_on = -1;
     t->func = func;
     t->data = data;
@@ -222,6 +290,7 @@ static int cpu_callback(
     switch ( action )
     {
     case CPU_UP_PREPARE:
+        spin_lock_init(&per_cpu(tasklet_lock, cpu));
         INIT_LIST_HEAD(&per_cpu(tasklet_list, cpu));
         INIT_LIST_HEAD(&per_cpu(softirq_tasklet_list, cpu));
         break;
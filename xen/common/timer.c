@@ -29,12 +29,30 @@
 static unsigned int timer_slop __read_mostly = 50000; /* 50 us */
 integer_param("timer_slop", timer_slop);
 
+/*
+ * Timers due further away than TIMER_WHEEL_HORIZON, but within one rotation
+ * of the wheel, are kept in a wheel of TIMER_WHEEL_SLOTS slots, each
+ * covering 2^TIMER_WHEEL_SHIFT ns, rather than in the heap.  Many such
+ * timers (timeouts, watchdogs) get stopped or re-set long before they
+ * expire, which is O(1) in the wheel.  Those which survive get cascaded into
+ * the heap shortly before they are due, so that they still fire precisely.
+ */
+#define TIMER_WHEEL_SHIFT   20 /* ~1ms */
+#define TIMER_WHEEL_SLOTS   256
+#define TIMER_WHEEL_SLOT    (1LL << TIMER_WHEEL_SHIFT)
+#define TIMER_WHEEL_HORIZON (4 * TIMER_WHEEL_SLOT)
+#define TIMER_WHEEL_RANGE   ((TIMER_WHEEL_SLOTS - 1) * TIMER_WHEEL_SLOT)
+
 struct timers {
     spinlock_t     lock;
     struct timer **heap;
     struct timer  *list;
     struct timer  *running;
     struct list_head inactive;
+    unsigned int   wheel_count;
+    s_time_t       wheel_time; /* Start of the first slot to cascade. */
+    DECLARE_BITMAP(wheel_used, TIMER_WHEEL_SLOTS);
+    struct hlist_head wheel[TIMER_WHEEL_SLOTS];
 } __cacheline_aligned;
 
 static DEFINE_PER_CPU(struct timers, timers);
@@ -176,6 +194,117 @@ static int add_to_list(struct timer **pprev, struct timer *t)
 }
 
 
+/****************************************************************************
+ * TIMER WHEEL OPERATIONS.
+ *
+ * Every timer in the wheel expires at or after wheel_time, which only moves
+ * forward, when slots get cascaded.
+ */
+
+static unsigned int wheel_slot(s_time_t expires)
+{
+    return (expires >> TIMER_WHEEL_SHIFT) & (TIMER_WHEEL_SLOTS - 1);
+}
+
+/* When the timers of the slot starting at @start need moving to the heap. */
+static s_time_t wheel_cascade_time(s_time_t start)
+{
+    return start + TIMER_WHEEL_SLOT - TIMER_WHEEL_HORIZON;
+}
+
+static void remove_from_wheel(struct timers *ts, struct timer *t)
+{
+    unsigned int slot = wheel_slot(t->expires);
+
+    hlist_del(&t->wheel);
+    if ( hlist_empty(&ts->wheel[slot]) )
+        __clear_bit(slot, ts->wheel_used);
+    ts->wheel_count--;
+}
+
+/* Add @t to the wheel. Return TRUE if the timer hardware needs updating. */
+static int add_to_wheel(struct timers *ts, struct timer *t)
+{
+    unsigned int slot = wheel_slot(t->expires);
+    s_time_t deadline = per_cpu(timer_deadline, t->cpu);
+
+    hlist_add_head(&t->wheel, &ts->wheel[slot]);
+    __set_bit(slot, ts->wheel_used);
+    ts->wheel_count++;
+
+    return !deadline ||
+           wheel_cascade_time(t->expires & ~(TIMER_WHEEL_SLOT - 1)) <
+           deadline;
+}
+
+static struct timer *first_wheel_timer(const struct timers *ts)
+{
+    unsigned int slot;
+
+    if ( !ts->wheel_count )
+        return NULL;
+
+    slot = find_first_bit(ts->wheel_used, TIMER_WHEEL_SLOTS);
+    ASSERT(slot < TIMER_WHEEL_SLOTS);
+
+    return hlist_entry(ts->wheel[slot].first, struct timer, wheel);
+}
+
+/* Time at which the wheel next needs cascading, or STIME_MAX. */
+static s_time_t wheel_deadline(const struct timers *ts)
+{
+    unsigned int first = wheel_slot(ts->wheel_time), slot;
+
+    if ( !ts->wheel_count )
+        return STIME_MAX;
+
+    slot = find_next_bit(ts->wheel_used, TIMER_WHEEL_SLOTS, first);
+    if ( slot >= TIMER_WHEEL_SLOTS )
+        slot = find_first_bit(ts->wheel_used, TIMER_WHEEL_SLOTS) +
+               TIMER_WHEEL_SLOTS;
+
+    return wheel_cascade_time((ts->wheel_time & ~(TIMER_WHEEL_SLOT - 1)) +
+                              ((s_time_t)(slot - first) << TIMER_WHEEL_SHIFT));
+}
+
+static int add_entry(struct timer *t);
+
+/* Move the wheel timers due before @now + TIMER_WHEEL_HORIZON to the heap. */
+static void cascade_wheel(struct timers *ts, s_time_t now)
+{
+    s_time_t limit = now + TIMER_WHEEL_HORIZON;
+    s_time_t start = ts->wheel_time & ~(TIMER_WHEEL_SLOT - 1);
+    unsigned int i, first = wheel_slot(start), nr;
+
+    if ( limit <= ts->wheel_time )
+        return;
+
+    nr = min_t(s_time_t, ((limit - start) >> TIMER_WHEEL_SHIFT) + 1,
+               TIMER_WHEEL_SLOTS);
+
+    for ( i = 0; i < nr && ts->wheel_count; i++ )
+    {
+        unsigned int slot = (first + i) & (TIMER_WHEEL_SLOTS - 1);
+        struct hlist_node *pos, *n;
+        struct timer *t;
+
+        if ( !test_bit(slot, ts->wheel_used) )
+            continue;
+
+        hlist_for_each_entry_safe ( t, pos, n, &ts->wheel[slot], wheel )
+        {
+            if ( t->expires >= limit )
+                continue;
+            remove_from_wheel(ts, t);
+            t->status = TIMER_STATUS_invalid;
+            add_entry(t);
+        }
+    }
+
+    ts->wheel_time = limit & ~(TIMER_WHEEL_SLOT - 1);
+}
+
+
 /****************************************************************************
  * TIMER OPERATIONS.
  */
@@ -193,6 +322,11 @@ static int remove_entry(struct timer *t)
     case TIMER_STATUS_in_list:
         rc = remove_from_list(&timers->list, t);
         break;
+    case TIMER_STATUS_in_wheel:
+        /* At worst the hardware fires for nothing; no need to reprogram. */
+        remove_from_wheel(timers, t);
+        rc = 0;
+        break;
     default:
         rc = 0;
         BUG();
@@ -205,10 +339,17 @@ static int remove_entry(struct timer *t)
 static int add_entry(struct timer *t)
 {
     struct timers *timers = &per_cpu(timers, t->cpu);
+    s_time_t delta = t->expires - NOW();
     int rc;
 
     ASSERT(t->status == TIMER_STATUS_invalid);
 
+    if ( delta >= TIMER_WHEEL_HORIZON && delta < TIMER_WHEEL_RANGE )
+    {
+        t->status = TIMER_STATUS_in_wheel;
+        return add_to_wheel(timers, t);
+    }
+
     /* Try to add to heap. t->heap_offset indicates whether we succeed. */
     t->heap_offset = 0;
     t->status = TIMER_STATUS_in_heap;
@@ -491,6 +632,9 @@ static void timer_softirq_action(void)
 
     now = NOW();
 
+    /* Get wheel timers which are due soon into the heap. */
+    cascade_wheel(ts, now);
+
     /* Execute ready heap timers. */
     while ( (heap_metadata(heap)->size != 0) &&
             ((t = heap[1])->expires < now) )
@@ -522,6 +666,7 @@ static void timer_softirq_action(void)
         deadline = heap[1]->expires;
     if ( (ts->list != NULL) && (ts->list->expires < deadline) )
         deadline = ts->list->expires;
+    deadline = min(deadline, wheel_deadline(ts));
     now = NOW();
     this_cpu(timer_deadline) =
         (deadline == STIME_MAX) ? 0 : MAX(deadline, now + timer_slop);
@@ -566,6 +711,13 @@ static void dump_timerq(unsigned char key)
             dump_timer(ts->heap[j], now);
         for ( t = ts->list; t != NULL; t = t->list_next )
             dump_timer(t, now);
+        for ( j = 0; ts->wheel_count && j < TIMER_WHEEL_SLOTS; j++ )
+        {
+            struct hlist_node *pos;
+
+            hlist_for_each_entry ( t, pos, &ts->wheel[j], wheel )
+                dump_timer(t, now);
+        }
         spin_unlock_irqrestore(&ts->lock, flags);
     }
 }
@@ -594,7 +746,8 @@ static void migrate_timers_from_cpu(unsigned int old_cpu)
     }
 
     while ( (t = heap_metadata(old_ts->heap)->size
-             ? old_ts->heap[1] : old_ts->list) != NULL )
+             ? old_ts->heap[1]
+             : old_ts->list ?: first_wheel_timer(old_ts)) != NULL )
     {
         remove_entry(t);
         write_atomic(&t->cpu, new_cpu);
@@ -0,0 +1,39 @@
+/*
+ * Wrapper for decompressing zstd-compressed kernel, initramfs, and initrd
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ */
+
+#include "decompress.h"
+#include "zstd/decompress.c"
+
+STATIC int INIT unzstd(unsigned char *input, unsigned int in_len,
+		       int (*fill)(void *, unsigned int),
+		       int (*flush)(void *, unsigned int),
+		       unsigned char *output,
+		       unsigned int *posp,
+		       void (*error)(const char *x))
+{
+	size_t in_used, out_len;
+	const char *msg;
+
+	if (fill || flush || !input || !output) {
+		error("zstd: only in-memory decompression is supported");
+		return -1;
+	}
+
+	/* The caller has sized the output buffer for the whole image. */
+	if (zstd_decompress(input, in_len, output, ~(size_t)0 - (size_t)output,
+			    &in_used, &out_len, &msg)) {
+		error(msg);
+		return -1;
+	}
+
+	if (posp)
+		*posp = in_used;
+
+	return 0;
+}
@@ -22,6 +22,7 @@
 
 #include <xen/sched.h>
 #include <xen/event.h>
+#include <xen/vmap.h>
 #include <xen/wait.h>
 #include <xen/vm_event.h>
 #include <xen/mem_access.h>
@@ -36,6 +37,64 @@
 #define xen_rmb()  smp_rmb()
 #define xen_wmb()  smp_wmb()
 
+static void vm_event_unmap_ring(struct vm_event_domain *ved)
+{
+    unsigned int i;
+
+    if ( ved->ring_page )
+    {
+        vunmap(ved->ring_page);
+        ved->ring_page = NULL;
+    }
+
+    for ( i = 0; i < ved->nr_frames; i++ )
+        put_page_and_type(ved->ring_pg_struct[i]);
+    ved->nr_frames = 0;
+}
+
+/* Take writable references to the ring's frames and map them contiguously. */
+static int vm_event_map_ring(struct domain *d, struct vm_event_domain *ved,
+                             unsigned long ring_gfn, unsigned int nr_frames)
+{
+    mfn_t mfns[XEN_VM_EVENT_RING_FRAMES_MAX];
+    unsigned int i;
+    int rc;
+
+    for ( i = 0; i < nr_frames; i++ )
+    {
+        struct page_info *page;
+        p2m_type_t p2mt;
+
+        rc = check_get_page_from_gfn(d, _gfn(ring_gfn + i), false, &p2mt,
+                                     &page);
+        if ( rc )
+        {
+            rc = (rc == -EAGAIN) ? -ENOENT : rc;
+            goto err;
+        }
+
+        if ( !get_page_type(page, PGT_writable_page) )
+        {
+            put_page(page);
+            rc = -EINVAL;
+            goto err;
+        }
+
+        ved->ring_pg_struct[ved->nr_frames++] = page;
+        mfns[i] = page_to_mfn(page);
+    }
+
+    rc = -ENOMEM;
+    ved->ring_page = vmap(mfns, nr_frames);
+    if ( ved->ring_page )
+        return 0;
+
+ err:
+    vm_event_unmap_ring(ved);
+
+    return rc;
+}
+
 static int vm_event_enable(
     struct domain *d,
     struct xen_domctl_vm_event_op *vec,
@@ -46,6 +105,7 @@ static int vm_event_enable(
 {
     int rc;
     unsigned long ring_gfn = d->arch.hvm.params[param];
+    unsigned int nr_frames = vec->u.enable.nr_frames ?: 1;
     struct vm_event_domain *ved;
 
     /*
@@ -59,6 +119,9 @@ static int vm_event_enable(
     if ( ring_gfn == 0 )
         return -EOPNOTSUPP;
 
+    if ( nr_frames > XEN_VM_EVENT_RING_FRAMES_MAX )
+        return -E2BIG;
+
     ved = xzalloc(struct vm_event_domain);
     if ( !ved )
         return -ENOMEM;
@@ -72,14 +135,13 @@ static int vm_event_enable(
     if ( rc < 0 )
         goto err;
 
-    rc = prepare_ring_for_helper(d, ring_gfn, &ved->ring_pg_struct,
-                                 &ved->ring_page);
+    rc = vm_event_map_ring(d, ved, ring_gfn, nr_frames);
     if ( rc < 0 )
         goto err;
 
     FRONT_RING_INIT(&ved->front_ring,
                     (vm_event_sring_t *)ved->ring_page,
-                    PAGE_SIZE);
+                    nr_frames * PAGE_SIZE);
 
     rc = alloc_unbound_xen_event_channel(d, 0, current->domain->domain_id,
                                          notification_fn);
@@ -94,7 +156,7 @@ static int vm_event_enable(
     return 0;
 
  err:
-    destroy_ring_for_helper(&ved->ring_page, ved->ring_pg_struct);
+    vm_event_unmap_ring(ved);
     xfree(ved);
 
     return rc;
@@ -205,7 +267,7 @@ static int vm_event_disable(struct domain *d, struct vm_event_domain **p_ved)
             }
         }
 
-        destroy_ring_for_helper(&ved->ring_page, ved->ring_pg_struct);
+        vm_event_unmap_ring(ved);
 
         vm_event_cleanup_domain(d);
 
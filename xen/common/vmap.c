@@ -9,7 +9,10 @@
 #include <xen/vmap.h>
 #include <asm/page.h>
 
-static DEFINE_SPINLOCK(vm_lock);
+/* One lock per region, so that vmalloc_xen() users don't contend with vmap(). */
+static spinlock_t vm_lock[VMAP_REGION_NR] = {
+    [0 ... VMAP_REGION_NR - 1] = SPIN_LOCK_UNLOCKED
+};
 static void *__read_mostly vm_base[VMAP_REGION_NR];
 #define vm_bitmap(x) ((unsigned long *)vm_base[x])
 /* highest allocated bit in the bitmap */
@@ -59,7 +62,7 @@ static void *vm_alloc(unsigned int nr, unsigned int align,
     if ( !vm_base[t] )
         return NULL;
 
-    spin_lock(&vm_lock);
+    spin_lock(&vm_lock[t]);
     for ( ; ; )
     {
         struct page_info *pg;
@@ -92,7 +95,7 @@ static void *vm_alloc(unsigned int nr, unsigned int align,
         if ( start < vm_top[t] )
             break;
 
-        spin_unlock(&vm_lock);
+        spin_unlock(&vm_lock[t]);
 
         if ( vm_top[t] >= vm_end[t] )
             return NULL;
@@ -101,7 +104,7 @@ static void *vm_alloc(unsigned int nr, unsigned int align,
         if ( !pg )
             return NULL;
 
-        spin_lock(&vm_lock);
+        spin_lock(&vm_lock[t]);
 
         if ( start >= vm_top[t] )
         {
@@ -121,20 +124,20 @@ static void *vm_alloc(unsigned int nr, unsigned int align,
 
         if ( start >= vm_top[t] )
         {
-            spin_unlock(&vm_lock);
+            spin_unlock(&vm_lock[t]);
             return NULL;
         }
     }
 
-    for ( bit = start; bit < start + nr; ++bit )
-        __set_bit(bit, vm_bitmap(t));
+    bitmap_set(vm_bitmap(t), start, nr);
+    bit = start + nr;
     if ( bit < vm_top[t] )
         ASSERT(!test_bit(bit, vm_bitmap(t)));
     else
         ASSERT(bit == vm_top[t]);
     if ( start <= vm_low[t] + 2 )
         vm_low[t] = bit;
-    spin_unlock(&vm_lock);
+    spin_unlock(&vm_lock[t]);
 
     return vm_base[t] + start * PAGE_SIZE;
 }
@@ -172,7 +175,7 @@ static unsigned int vm_size(const void *va, enum vmap_region type)
 static void vm_free(const void *va)
 {
     enum vmap_region type = VMAP_DEFAULT;
-    unsigned int bit = vm_index(va, type);
+    unsigned int bit = vm_index(va, type), end;
 
     if ( !bit )
     {
@@ -186,17 +189,16 @@ static void vm_free(const void *va)
         return;
     }
 
-    spin_lock(&vm_lock);
+    spin_lock(&vm_lock[type]);
     if ( bit < vm_low[type] )
     {
         vm_low[type] = bit - 1;
         while ( !test_bit(vm_low[type] - 1, vm_bitmap(type)) )
             --vm_low[type];
     }
-    while ( __test_and_clear_bit(bit, vm_bitmap(type)) )
-        if ( ++bit == vm_top[type] )
-            break;
-    spin_unlock(&vm_lock);
+    end = find_next_zero_bit(vm_bitmap(type), vm_top[type], bit + 1);
+    bitmap_clear(vm_bitmap(type), bit, min(end, vm_top[type]) - bit);
+    spin_unlock(&vm_lock[type]);
 }
 
 void *__vmap(const mfn_t *mfn, unsigned int granularity,
@@ -23,8 +23,11 @@
  * Adapted for Xen by Dan Magenheimer (dan.magenheimer@oracle.com)
  */
 
+#include <xen/cpu.h>
+#include <xen/init.h>
 #include <xen/irq.h>
 #include <xen/mm.h>
+#include <xen/percpu.h>
 #include <xen/pfn.h>
 #include <asm/time.h>
 
@@ -548,6 +551,118 @@ static void *xmalloc_whole_pages(unsigned long size, unsigned long align)
     return res;
 }
 
+/*
+ * Per-CPU caches of freed small blocks, per block size, to keep the
+ * common short-lived small allocations away from the pool lock.  Blocks
+ * in a cache are still allocated as far as the pool is concerned, and
+ * are linked through their first word.  xmalloc() and xfree() aren't
+ * used in IRQ context, so no locking is needed.
+ */
+#define XMALLOC_CACHE_MAX_SIZE  256
+#define XMALLOC_CACHE_CLASSES   (XMALLOC_CACHE_MAX_SIZE / MEM_ALIGN)
+#define XMALLOC_CACHE_DEPTH     16
+
+struct xmalloc_cache {
+    void *head[XMALLOC_CACHE_CLASSES];
+    unsigned int count[XMALLOC_CACHE_CLASSES];
+};
+
+static DEFINE_PER_CPU(struct xmalloc_cache, xmalloc_cache);
+static bool __read_mostly xmalloc_cache_enabled;
+
+static void *xmalloc_cache_get(unsigned long size)
+{
+    struct xmalloc_cache *c;
+    unsigned int idx;
+    void *p;
+
+    size = (size < MIN_BLOCK_SIZE) ? MIN_BLOCK_SIZE : ROUNDUP_SIZE(size);
+    if ( !xmalloc_cache_enabled || size > XMALLOC_CACHE_MAX_SIZE )
+        return NULL;
+
+    c = &this_cpu(xmalloc_cache);
+    idx = size / MEM_ALIGN - 1;
+    p = c->head[idx];
+    if ( p )
+    {
+        c->head[idx] = *(void **)p;
+        c->count[idx]--;
+    }
+
+    return p;
+}
+
+static bool xmalloc_cache_put(void *p)
+{
+    const struct bhdr *b = p - BHDR_OVERHEAD;
+    unsigned long size = b->size & BLOCK_SIZE_MASK;
+    struct xmalloc_cache *c;
+    unsigned int idx;
+
+    if ( !xmalloc_cache_enabled || size > XMALLOC_CACHE_MAX_SIZE )
+        return false;
+
+    c = &this_cpu(xmalloc_cache);
+    idx = size / MEM_ALIGN - 1;
+    if ( c->count[idx] >= XMALLOC_CACHE_DEPTH )
+        return false;
+
+    *(void **)p = c->head[idx];
+    c->head[idx] = p;
+    c->count[idx]++;
+
+    return true;
+}
+
+static void xmalloc_cache_flush(unsigned int cpu)
+{
+    struct xmalloc_cache *c = &per_cpu(xmalloc_cache, cpu);
+    unsigned int idx;
+
+    for ( idx = 0; idx < XMALLOC_CACHE_CLASSES; idx++ )
+    {
+        while ( c->head[idx] )
+        {
+            void *p = c->head[idx];
+
+            c->head[idx] = *(void **)p;
+            xmem_pool_free(p, xenpool);
+        }
+        c->count[idx] = 0;
+    }
+}
+
+static int cpu_callback(
+    struct notifier_block *nfb, unsigned long action, void *hcpu)
+{
+    unsigned int cpu = (unsigned long)hcpu;
+
+    switch ( action )
+    {
+    case CPU_UP_CANCELED:
+    case CPU_DEAD:
+        xmalloc_cache_flush(cpu);
+        break;
+    default:
+        break;
+    }
+
+    return NOTIFY_DONE;
+}
+
+static struct notifier_block cpu_nfb = {
+    .notifier_call = cpu_callback
+};
+
+static int __init xmalloc_cache_init(void)
+{
+    register_cpu_notifier(&cpu_nfb);
+    xmalloc_cache_enabled = true;
+
+    return 0;
+}
+presmp_initcall(xmalloc_cache_init);
+
 static void tlsf_init(void)
 {
     xenpool = xmem_pool_create("xmalloc", xmalloc_pool_get,
@@ -612,7 +727,11 @@ void *_xmalloc(unsigned long size, unsigned long align)
         tlsf_init();
 
     if ( size < PAGE_SIZE )
-        p = xmem_pool_alloc(size, xenpool);
+    {
+        p = xmalloc_cache_get(size);
+        if ( p == NULL )
+            p = xmem_pool_alloc(size, xenpool);
+    }
     if ( p == NULL )
         return xmalloc_whole_pages(size - align + MEM_ALIGN, align);
 
@@ -723,5 +842,8 @@ void xfree(void *p)
     /* Strip alignment padding. */
     p = strip_padding(p);
 
+    if ( xmalloc_cache_put(p) )
+        return;
+
     xmem_pool_free(p, xenpool);
 }
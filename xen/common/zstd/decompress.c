@@ -0,0 +1,978 @@
+/*
+ * Zstandard (RFC 8878) decoder for boot images
+ *
+ * The whole compressed image is expected to be in memory, and the output
+ * buffer to be large enough to hold the decompressed data, so no window
+ * buffer is needed: matches are copied straight out of the output.
+ * Dictionaries are not supported, as no compressor uses them for kernels
+ * or initial ramdisks.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#define ZSTD_MAGIC		0xFD2FB528U
+#define ZSTD_SKIPPABLE_MAGIC	0x184D2A50U	/* low 4 bits are free */
+#define ZSTD_SKIPPABLE_MASK	0xFFFFFFF0U
+
+#define ZSTD_BLOCK_MAX		(128 << 10)
+
+#define ZSTD_HUF_MAX_BITS	11
+#define ZSTD_HUF_MAX_SYMBOLS	256
+#define ZSTD_HUF_WEIGHT_LOG	6
+
+#define ZSTD_LL_MAX_LOG		9
+#define ZSTD_ML_MAX_LOG		9
+#define ZSTD_OF_MAX_LOG		8
+#define ZSTD_LL_MAX_SYMBOL	35
+#define ZSTD_ML_MAX_SYMBOL	52
+#define ZSTD_OF_MAX_SYMBOL	31
+#define ZSTD_FSE_MAX_SYMBOLS	(ZSTD_ML_MAX_SYMBOL + 1)
+#define ZSTD_OF_DEFAULT_NR	29
+
+struct zstd_fse_entry {
+	uint16_t base;		/* of the next state */
+	uint8_t symbol;
+	uint8_t bits;		/* read to get the next state */
+};
+
+struct zstd_fse {
+	struct zstd_fse_entry table[1 << ZSTD_LL_MAX_LOG];
+	unsigned int log;
+	int valid;		/* usable in "repeat" mode */
+};
+
+struct zstd_huf_entry {
+	uint8_t symbol;
+	uint8_t bits;
+};
+
+struct zstd_ctx {
+	struct zstd_huf_entry huf[1 << ZSTD_HUF_MAX_BITS];
+	unsigned int huf_bits;	/* 0 if there is no table yet */
+	struct zstd_fse ll, of, ml;
+	struct zstd_fse weights;
+	uint32_t rep[3];
+	uint8_t literals[ZSTD_BLOCK_MAX];
+};
+
+/* Backwards bitstream, as used for Huffman and FSE coded data. */
+struct zstd_bits {
+	const uint8_t *src;
+	size_t len;
+	int64_t pos;		/* bits left to read, < 0 once overread */
+};
+
+/* Predefined distributions for the sequence codes (RFC 8878 3.1.1.3.2.2). */
+static const int16_t zstd_ll_default[ZSTD_LL_MAX_SYMBOL + 1] = {
+	4, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 2, 1, 1, 1, 1, 1,
+	-1, -1, -1, -1
+};
+#define ZSTD_LL_DEFAULT_LOG	6
+
+static const int16_t zstd_ml_default[ZSTD_ML_MAX_SYMBOL + 1] = {
+	1, 4, 3, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, -1, -1,
+	-1, -1, -1, -1, -1
+};
+#define ZSTD_ML_DEFAULT_LOG	6
+
+static const int16_t zstd_of_default[ZSTD_OF_DEFAULT_NR] = {
+	1, 1, 1, 1, 1, 1, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, -1, -1, -1, -1, -1
+};
+#define ZSTD_OF_DEFAULT_LOG	5
+
+static const uint32_t zstd_ll_base[ZSTD_LL_MAX_SYMBOL + 1] = {
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+	16, 18, 20, 22, 24, 28, 32, 40, 48, 64, 128, 256, 512, 1024, 2048, 4096,
+	8192, 16384, 32768, 65536
+};
+
+static const uint8_t zstd_ll_bits[ZSTD_LL_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 6, 7, 8, 9, 10, 11, 12,
+	13, 14, 15, 16
+};
+
+static const uint32_t zstd_ml_base[ZSTD_ML_MAX_SYMBOL + 1] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+	19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34,
+	35, 37, 39, 41, 43, 47, 51, 59, 67, 83, 99, 131, 259, 515, 1027, 2051,
+	4099, 8195, 16387, 32771, 65539
+};
+
+static const uint8_t zstd_ml_bits[ZSTD_ML_MAX_SYMBOL + 1] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1, 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 7, 8, 9, 10, 11,
+	12, 13, 14, 15, 16
+};
+
+static inline uint32_t INIT zstd_le32(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t INIT zstd_le64(const uint8_t *p)
+{
+	return zstd_le32(p) | ((uint64_t)zstd_le32(p + 4) << 32);
+}
+
+static inline unsigned int INIT zstd_highbit(uint32_t v)
+{
+	return 31 - __builtin_clz(v);
+}
+
+/*
+ * Bits [off, off + n) of a little endian bitstream of len bytes, n <= 56.
+ * Bits before the start of the stream read as zero, as backwards streams
+ * are padded with zeroes when they are overread.
+ */
+static inline uint64_t INIT zstd_get_bits(const uint8_t *src, size_t len,
+					  int64_t off, unsigned int n)
+{
+	uint64_t v = 0;
+	unsigned int shift = 0;
+	size_t byte, i;
+
+	if (!n)
+		return 0;
+	if (off < 0) {
+		if (off + n <= 0)
+			return 0;
+		shift = -off;
+		n -= shift;
+		off = 0;
+	}
+
+	byte = off >> 3;
+	if (byte + 8 <= len)
+		v = zstd_le64(src + byte);
+	else
+		for (i = 0; byte + i < len; i++)
+			v |= (uint64_t)src[byte + i] << (8 * i);
+
+	return ((v >> (off & 7)) & ((1ULL << n) - 1)) << shift;
+}
+
+static int INIT zstd_bits_init(struct zstd_bits *bs, const uint8_t *src,
+			       size_t len)
+{
+	if (!len || !src[len - 1])
+		return -1;
+
+	bs->src = src;
+	bs->len = len;
+	/* Skip the padding, up to and including the highest set bit. */
+	bs->pos = (len - 1) * 8 + zstd_highbit(src[len - 1]);
+
+	return 0;
+}
+
+static inline uint64_t INIT zstd_bits_peek(const struct zstd_bits *bs,
+					   unsigned int n)
+{
+	return zstd_get_bits(bs->src, bs->len, bs->pos - n, n);
+}
+
+static inline uint64_t INIT zstd_bits_read(struct zstd_bits *bs,
+					   unsigned int n)
+{
+	bs->pos -= n;
+	return zstd_get_bits(bs->src, bs->len, bs->pos, n);
+}
+
+static int INIT zstd_fse_build(struct zstd_fse *fse, const int16_t *norm,
+			       unsigned int nr, unsigned int log)
+{
+	unsigned int size = 1U << log, high = size - 1;
+	unsigned int step = (size >> 1) + (size >> 3) + 3;
+	unsigned int pos = 0, s, i;
+	uint16_t next[ZSTD_FSE_MAX_SYMBOLS];
+
+	/* "Less than 1" probabilities take a single cell at the top. */
+	for (s = 0; s < nr; s++) {
+		if (norm[s] == -1) {
+			fse->table[high--].symbol = s;
+			next[s] = 1;
+		} else
+			next[s] = norm[s];
+	}
+
+	for (s = 0; s < nr; s++) {
+		if (norm[s] <= 0)
+			continue;
+		for (i = 0; i < norm[s]; i++) {
+			fse->table[pos].symbol = s;
+			do
+				pos = (pos + step) & (size - 1);
+			while (pos > high);
+		}
+	}
+	if (pos)
+		return -1;
+
+	for (i = 0; i < size; i++) {
+		unsigned int n = next[fse->table[i].symbol]++;
+		unsigned int bits = log - zstd_highbit(n);
+
+		fse->table[i].bits = bits;
+		fse->table[i].base = (n << bits) - size;
+	}
+
+	fse->log = log;
+	fse->valid = 1;
+
+	return 0;
+}
+
+static void INIT zstd_fse_rle(struct zstd_fse *fse, uint8_t symbol)
+{
+	fse->table[0].symbol = symbol;
+	fse->table[0].bits = 0;
+	fse->table[0].base = 0;
+	fse->log = 0;
+	fse->valid = 1;
+}
+
+/* Read an FSE table description, returning the bytes it takes up. */
+static int INIT zstd_fse_read(struct zstd_fse *fse, const uint8_t *src,
+			      size_t len, unsigned int max_log,
+			      unsigned int max_symbol)
+{
+	int16_t norm[ZSTD_FSE_MAX_SYMBOLS];
+	uint64_t total = (uint64_t)len * 8, off = 4;
+	unsigned int log, bits, nr = 0;
+	int remaining, threshold;
+
+	if (!len)
+		return -1;
+	log = (src[0] & 0xf) + 5;
+	if (log > max_log)
+		return -1;
+
+	remaining = (1 << log) + 1;
+	threshold = 1 << log;
+	bits = log + 1;
+
+	while (remaining > 1) {
+		int max = 2 * threshold - 1 - remaining;
+		int val;
+
+		if (nr > max_symbol || off + bits > total)
+			return -1;
+
+		val = zstd_get_bits(src, len, off, bits - 1);
+		if (val < max)
+			off += bits - 1;
+		else {
+			val = zstd_get_bits(src, len, off, bits);
+			if (val >= threshold)
+				val -= max;
+			off += bits;
+		}
+
+		val--;
+		remaining -= val < 0 ? -val : val;
+		norm[nr++] = val;
+
+		if (!val) {
+			unsigned int repeat;
+
+			do {
+				if (off + 2 > total)
+					return -1;
+				repeat = zstd_get_bits(src, len, off, 2);
+				off += 2;
+				if (nr + repeat > max_symbol + 1)
+					return -1;
+				for (val = 0; val < repeat; val++)
+					norm[nr++] = 0;
+			} while (repeat == 3);
+		}
+
+		if (remaining < 1)
+			return -1;
+		while (remaining < threshold) {
+			bits--;
+			threshold >>= 1;
+		}
+	}
+
+	if (zstd_fse_build(fse, norm, nr, log))
+		return -1;
+
+	return (off + 7) >> 3;
+}
+
+static inline unsigned int INIT zstd_fse_update(const struct zstd_fse *fse,
+						unsigned int state,
+						struct zstd_bits *bs)
+{
+	const struct zstd_fse_entry *e = &fse->table[state];
+
+	return e->base + zstd_bits_read(bs, e->bits);
+}
+
+/* Read a Huffman tree description, returning the bytes it takes up. */
+static int INIT zstd_huf_read(struct zstd_ctx *ctx, const uint8_t *src,
+			      size_t len)
+{
+	uint8_t weights[ZSTD_HUF_MAX_SYMBOLS];
+	unsigned int i, nr = 0, max_bits, pos = 0, w, s;
+	uint32_t sum = 0, last;
+	size_t used;
+
+	if (!len)
+		return -1;
+
+	if (src[0] >= 128) {
+		/* Weights stored directly, 4 bits each. */
+		nr = src[0] - 127;
+		used = 1 + (nr + 1) / 2;
+		if (used > len)
+			return -1;
+		for (i = 0; i < nr; i++)
+			weights[i] = (i & 1) ? src[1 + i / 2] & 0xf
+					     : src[1 + i / 2] >> 4;
+	} else {
+		/* FSE compressed weights, with two interleaved states. */
+		struct zstd_fse *fse = &ctx->weights;
+		struct zstd_bits bs;
+		unsigned int s1, s2;
+		int n;
+
+		used = 1 + src[0];
+		if (used > len)
+			return -1;
+		n = zstd_fse_read(fse, src + 1, src[0], ZSTD_HUF_WEIGHT_LOG,
+				  ZSTD_HUF_MAX_BITS + 1);
+		if (n < 0 || zstd_bits_init(&bs, src + 1 + n, src[0] - n))
+			return -1;
+		s1 = zstd_bits_read(&bs, fse->log);
+		s2 = zstd_bits_read(&bs, fse->log);
+
+		for (;;) {
+			if (nr > ZSTD_HUF_MAX_SYMBOLS - 3)
+				return -1;
+			weights[nr++] = fse->table[s1].symbol;
+			s1 = zstd_fse_update(fse, s1, &bs);
+			if (bs.pos < 0) {
+				weights[nr++] = fse->table[s2].symbol;
+				break;
+			}
+			weights[nr++] = fse->table[s2].symbol;
+			s2 = zstd_fse_update(fse, s2, &bs);
+			if (bs.pos < 0) {
+				weights[nr++] = fse->table[s1].symbol;
+				break;
+			}
+		}
+	}
+
+	if (nr >= ZSTD_HUF_MAX_SYMBOLS)
+		return -1;
+	for (i = 0; i < nr; i++) {
+		if (weights[i] > ZSTD_HUF_MAX_BITS)
+			return -1;
+		if (weights[i])
+			sum += 1U << (weights[i] - 1);
+	}
+	if (!sum)
+		return -1;
+
+	/* The last weight is implied: it fills the sum up to a power of 2. */
+	max_bits = zstd_highbit(sum) + 1;
+	last = (1U << max_bits) - sum;
+	if (max_bits > ZSTD_HUF_MAX_BITS || (last & (last - 1)))
+		return -1;
+	weights[nr++] = zstd_highbit(last) + 1;
+
+	/* Codes are handed out starting from the lowest weight. */
+	for (w = 1; w <= max_bits; w++)
+		for (s = 0; s < nr; s++) {
+			if (weights[s] != w)
+				continue;
+			for (i = 0; i < (1U << (w - 1)); i++) {
+				ctx->huf[pos + i].symbol = s;
+				ctx->huf[pos + i].bits = max_bits + 1 - w;
+			}
+			pos += 1U << (w - 1);
+		}
+	ctx->huf_bits = max_bits;
+
+	return used;
+}
+
+static int INIT zstd_huf_stream(const struct zstd_ctx *ctx,
+				const uint8_t *src, size_t len,
+				uint8_t *out, size_t nr)
+{
+	struct zstd_bits bs;
+	size_t i;
+
+	if (zstd_bits_init(&bs, src, len))
+		return -1;
+
+	for (i = 0; i < nr; i++) {
+		const struct zstd_huf_entry *e =
+			&ctx->huf[zstd_bits_peek(&bs, ctx->huf_bits)];
+
+		out[i] = e->symbol;
+		bs.pos -= e->bits;
+	}
+
+	return bs.pos ? -1 : 0;
+}
+
+/* Decode the literals section, returning the bytes it takes up. */
+static int INIT zstd_literals(struct zstd_ctx *ctx, const uint8_t *src,
+			      size_t len, const uint8_t **lit, size_t *nr)
+{
+	unsigned int type = src[0] & 3, format = (src[0] >> 2) & 3;
+	size_t hsize, regen, csize, used;
+	const uint8_t *p;
+
+	if (type < 2) {
+		/* Raw or RLE literals. */
+		switch (format) {
+		case 0: case 2:
+			hsize = 1;
+			regen = src[0] >> 3;
+			break;
+		case 1:
+			hsize = 2;
+			if (len < hsize)
+				return -1;
+			regen = (src[0] >> 4) + (src[1] << 4);
+			break;
+		default:
+			hsize = 3;
+			if (len < hsize)
+				return -1;
+			regen = (src[0] >> 4) + (src[1] << 4) + (src[2] << 12);
+			break;
+		}
+		if (regen > ZSTD_BLOCK_MAX)
+			return -1;
+
+		if (type == 0) {
+			if (hsize + regen > len)
+				return -1;
+			*lit = src + hsize;
+			used = hsize + regen;
+		} else {
+			if (hsize + 1 > len)
+				return -1;
+			memset(ctx->literals, src[hsize], regen);
+			*lit = ctx->literals;
+			used = hsize + 1;
+		}
+		*nr = regen;
+
+		return used;
+	}
+
+	/* Huffman coded literals, possibly reusing the previous tree. */
+	hsize = format < 2 ? 3 : format + 2;
+	if (len < hsize)
+		return -1;
+	switch (hsize) {
+	case 3: {
+		uint32_t h = src[0] | (src[1] << 8) | (src[2] << 16);
+
+		regen = (h >> 4) & 0x3ff;
+		csize = (h >> 14) & 0x3ff;
+		break;
+	}
+	case 4: {
+		uint32_t h = zstd_le32(src);
+
+		regen = (h >> 4) & 0x3fff;
+		csize = h >> 18;
+		break;
+	}
+	default: {
+		uint64_t h = zstd_le32(src) | ((uint64_t)src[4] << 32);
+
+		regen = (h >> 4) & 0x3ffff;
+		csize = (h >> 22) & 0x3ffff;
+		break;
+	}
+	}
+	if (regen > ZSTD_BLOCK_MAX || hsize + csize > len)
+		return -1;
+
+	p = src + hsize;
+	used = hsize + csize;
+	if (type == 2) {
+		int n = zstd_huf_read(ctx, p, csize);
+
+		if (n < 0)
+			return -1;
+		p += n;
+		csize -= n;
+	} else if (!ctx->huf_bits)
+		return -1;
+
+	if (format == 0) {
+		if (zstd_huf_stream(ctx, p, csize, ctx->literals, regen))
+			return -1;
+	} else {
+		size_t size[4], seg = (regen + 3) / 4, i;
+		uint8_t *out = ctx->literals;
+
+		if (csize < 6 || 3 * seg > regen)
+			return -1;
+		size[0] = p[0] | (p[1] << 8);
+		size[1] = p[2] | (p[3] << 8);
+		size[2] = p[4] | (p[5] << 8);
+		p += 6;
+		csize -= 6;
+		if (size[0] + size[1] + size[2] > csize)
+			return -1;
+		size[3] = csize - size[0] - size[1] - size[2];
+
+		for (i = 0; i < 4; i++) {
+			size_t n = i < 3 ? seg : regen - 3 * seg;
+
+			if (zstd_huf_stream(ctx, p, size[i], out, n))
+				return -1;
+			p += size[i];
+			out += n;
+		}
+	}
+
+	*lit = ctx->literals;
+	*nr = regen;
+
+	return used;
+}
+
+/* Set up one of the sequence code tables, returning the bytes used. */
+static int INIT zstd_seq_table(struct zstd_fse *fse, unsigned int mode,
+			       const uint8_t *src, size_t len,
+			       const int16_t *def, unsigned int def_nr,
+			       unsigned int def_log, unsigned int max_log,
+			       unsigned int max_symbol)
+{
+	switch (mode) {
+	case 0: /* Predefined */
+		return zstd_fse_build(fse, def, def_nr, def_log);
+	case 1: /* RLE */
+		if (!len || src[0] > max_symbol)
+			return -1;
+		zstd_fse_rle(fse, src[0]);
+		return 1;
+	case 2: /* FSE compressed */
+		return zstd_fse_read(fse, src, len, max_log, max_symbol);
+	default: /* Repeat */
+		return fse->valid ? 0 : -1;
+	}
+}
+
+static inline int INIT zstd_copy(uint8_t *dst, size_t cap, size_t *pos,
+				 const uint8_t *src, size_t n)
+{
+	if (n > cap - *pos)
+		return -1;
+	memcpy(dst + *pos, src, n);
+	*pos += n;
+
+	return 0;
+}
+
+static int INIT zstd_block(struct zstd_ctx *ctx, const uint8_t *src,
+			   size_t len, uint8_t *dst, size_t cap, size_t *pos,
+			   size_t start)
+{
+	const uint8_t *lit;
+	size_t nr_lit, nr_seq, i;
+	unsigned int ll, of, ml;
+	struct zstd_bits bs;
+	int n;
+
+	if (!len)
+		return -1;
+	n = zstd_literals(ctx, src, len, &lit, &nr_lit);
+	if (n < 0)
+		return -1;
+	src += n;
+	len -= n;
+
+	/* Number of sequences, in 1 to 3 bytes. */
+	if (!len)
+		return -1;
+	if (src[0] < 128) {
+		nr_seq = src[0];
+		n = 1;
+	} else if (src[0] < 255) {
+		if (len < 2)
+			return -1;
+		nr_seq = ((src[0] - 128) << 8) + src[1];
+		n = 2;
+	} else {
+		if (len < 3)
+			return -1;
+		nr_seq = src[1] + (src[2] << 8) + 0x7f00;
+		n = 3;
+	}
+	src += n;
+	len -= n;
+
+	if (!nr_seq)
+		return zstd_copy(dst, cap, pos, lit, nr_lit);
+
+	if (!len || (src[0] & 3))
+		return -1;
+	ll = src[0] >> 6;
+	of = (src[0] >> 4) & 3;
+	ml = (src[0] >> 2) & 3;
+	src++;
+	len--;
+
+	n = zstd_seq_table(&ctx->ll, ll, src, len, zstd_ll_default,
+			   ZSTD_LL_MAX_SYMBOL + 1, ZSTD_LL_DEFAULT_LOG,
+			   ZSTD_LL_MAX_LOG, ZSTD_LL_MAX_SYMBOL);
+	if (n < 0)
+		return -1;
+	src += n;
+	len -= n;
+	n = zstd_seq_table(&ctx->of, of, src, len, zstd_of_default,
+			   ZSTD_OF_DEFAULT_NR, ZSTD_OF_DEFAULT_LOG,
+			   ZSTD_OF_MAX_LOG, ZSTD_OF_MAX_SYMBOL);
+	if (n < 0)
+		return -1;
+	src += n;
+	len -= n;
+	n = zstd_seq_table(&ctx->ml, ml, src, len, zstd_ml_default,
+			   ZSTD_ML_MAX_SYMBOL + 1, ZSTD_ML_DEFAULT_LOG,
+			   ZSTD_ML_MAX_LOG, ZSTD_ML_MAX_SYMBOL);
+	if (n < 0)
+		return -1;
+	src += n;
+	len -= n;
+
+	if (zstd_bits_init(&bs, src, len))
+		return -1;
+	ll = zstd_bits_read(&bs, ctx->ll.log);
+	of = zstd_bits_read(&bs, ctx->of.log);
+	ml = zstd_bits_read(&bs, ctx->ml.log);
+
+	for (i = 0; i < nr_seq; i++) {
+		unsigned int ll_code = ctx->ll.table[ll].symbol;
+		unsigned int of_code = ctx->of.table[of].symbol;
+		unsigned int ml_code = ctx->ml.table[ml].symbol;
+		uint32_t offset, lit_len, match_len;
+
+		offset = (1U << of_code) + zstd_bits_read(&bs, of_code);
+		match_len = zstd_ml_base[ml_code] +
+			    zstd_bits_read(&bs, zstd_ml_bits[ml_code]);
+		lit_len = zstd_ll_base[ll_code] +
+			  zstd_bits_read(&bs, zstd_ll_bits[ll_code]);
+
+		if (offset > 3) {
+			offset -= 3;
+			ctx->rep[2] = ctx->rep[1];
+			ctx->rep[1] = ctx->rep[0];
+			ctx->rep[0] = offset;
+		} else {
+			/* Repeat offsets, shifted by one with no literals. */
+			unsigned int idx = offset - 1 + !lit_len;
+
+			if (idx) {
+				offset = idx < 3 ? ctx->rep[idx]
+						 : ctx->rep[0] - 1;
+				if (idx > 1)
+					ctx->rep[2] = ctx->rep[1];
+				ctx->rep[1] = ctx->rep[0];
+				ctx->rep[0] = offset;
+			} else
+				offset = ctx->rep[0];
+		}
+
+		if (i + 1 < nr_seq) {
+			ll = zstd_fse_update(&ctx->ll, ll, &bs);
+			ml = zstd_fse_update(&ctx->ml, ml, &bs);
+			of = zstd_fse_update(&ctx->of, of, &bs);
+		}
+
+		if (lit_len > nr_lit ||
+		    zstd_copy(dst, cap, pos, lit, lit_len))
+			return -1;
+		lit += lit_len;
+		nr_lit -= lit_len;
+
+		if (!offset || offset > *pos - start || match_len > cap - *pos)
+			return -1;
+		if (offset >= match_len)
+			memcpy(dst + *pos, dst + *pos - offset, match_len);
+		else {
+			uint8_t *op = dst + *pos;
+			const uint8_t *ip = op - offset;
+			uint32_t j;
+
+			for (j = 0; j < match_len; j++)
+				op[j] = ip[j];
+		}
+		*pos += match_len;
+	}
+
+	if (bs.pos)
+		return -1;
+
+	return zstd_copy(dst, cap, pos, lit, nr_lit);
+}
+
+#define XXH_PRIME64_1	0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2	0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3	0x165667B19E3779F9ULL
+#define XXH_PRIME64_4	0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5	0x27D4EB2F165667C5ULL
+
+static inline uint64_t INIT xxh64_rotl(uint64_t x, unsigned int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t INIT xxh64_round(uint64_t acc, uint64_t input)
+{
+	acc += input * XXH_PRIME64_2;
+	return xxh64_rotl(acc, 31) * XXH_PRIME64_1;
+}
+
+static inline uint64_t INIT xxh64_merge(uint64_t acc, uint64_t val)
+{
+	acc ^= xxh64_round(0, val);
+	return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+/* XXH64 with a seed of 0, as used for the content checksum. */
+static uint64_t INIT xxh64(const uint8_t *p, size_t len)
+{
+	const uint8_t *end = p + len;
+	uint64_t h;
+
+	if (len >= 32) {
+		uint64_t v1 = XXH_PRIME64_1 + XXH_PRIME64_2;
+		uint64_t v2 = XXH_PRIME64_2;
+		uint64_t v3 = 0;
+		uint64_t v4 = -XXH_PRIME64_1;
+
+		do {
+			v1 = xxh64_round(v1, zstd_le64(p));
+			v2 = xxh64_round(v2, zstd_le64(p + 8));
+			v3 = xxh64_round(v3, zstd_le64(p + 16));
+			v4 = xxh64_round(v4, zstd_le64(p + 24));
+			p += 32;
+		} while (end - p >= 32);
+
+		h = xxh64_rotl(v1, 1) + xxh64_rotl(v2, 7) +
+		    xxh64_rotl(v3, 12) + xxh64_rotl(v4, 18);
+		h = xxh64_merge(h, v1);
+		h = xxh64_merge(h, v2);
+		h = xxh64_merge(h, v3);
+		h = xxh64_merge(h, v4);
+	} else
+		h = XXH_PRIME64_5;
+
+	h += len;
+
+	for (; end - p >= 8; p += 8) {
+		h ^= xxh64_round(0, zstd_le64(p));
+		h = xxh64_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+	}
+	if (end - p >= 4) {
+		h ^= zstd_le32(p) * XXH_PRIME64_1;
+		h = xxh64_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= *p * XXH_PRIME64_5;
+		h = xxh64_rotl(h, 11) * XXH_PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= XXH_PRIME64_2;
+	h ^= h >> 29;
+	h *= XXH_PRIME64_3;
+	h ^= h >> 32;
+
+	return h;
+}
+
+/* Decode one frame, returning the bytes it takes up. */
+static long INIT zstd_frame(struct zstd_ctx *ctx, const uint8_t *src,
+			    size_t len, uint8_t *dst, size_t cap, size_t *pos,
+			    const char **msg)
+{
+	static const uint8_t dict_size[] = { 0, 1, 2, 4 };
+	unsigned int fhd, fcs_size, i;
+	uint64_t fcs = 0, dict = 0;
+	size_t p = 5, start = *pos;
+
+	*msg = "corrupted input";
+	if (len < 6)
+		return -1;
+	fhd = src[4];
+	if (fhd & 0x08)
+		return -1;
+
+	/* Window descriptor, unless the frame is a single segment. */
+	if (!(fhd & 0x20))
+		p++;
+
+	fcs_size = (fhd >> 6) ? 1U << (fhd >> 6) : !!(fhd & 0x20);
+	if (p + dict_size[fhd & 3] + fcs_size > len)
+		return -1;
+
+	for (i = 0; i < dict_size[fhd & 3]; i++)
+		dict |= (uint64_t)src[p + i] << (8 * i);
+	p += dict_size[fhd & 3];
+
+	for (i = 0; i < fcs_size; i++)
+		fcs |= (uint64_t)src[p + i] << (8 * i);
+	if (fcs_size == 2)
+		fcs += 256;
+	p += fcs_size;
+
+	if (dict) {
+		*msg = "dictionaries are not supported";
+		return -1;
+	}
+	if (fcs_size && fcs > cap - start) {
+		*msg = "output buffer too small";
+		return -1;
+	}
+
+	ctx->huf_bits = 0;
+	ctx->ll.valid = ctx->of.valid = ctx->ml.valid = 0;
+	ctx->rep[0] = 1;
+	ctx->rep[1] = 4;
+	ctx->rep[2] = 8;
+
+	for (;;) {
+		uint32_t bh, size;
+
+		if (p + 3 > len)
+			return -1;
+		bh = src[p] | (src[p + 1] << 8) | (src[p + 2] << 16);
+		size = bh >> 3;
+		p += 3;
+		if (size > ZSTD_BLOCK_MAX)
+			return -1;
+
+		switch ((bh >> 1) & 3) {
+		case 0: /* Raw */
+			if (size > len - p ||
+			    zstd_copy(dst, cap, pos, src + p, size))
+				return -1;
+			p += size;
+			break;
+		case 1: /* RLE */
+			if (p + 1 > len || size > cap - *pos)
+				return -1;
+			memset(dst + *pos, src[p], size);
+			*pos += size;
+			p++;
+			break;
+		case 2: /* Compressed */
+			if (size > len - p ||
+			    zstd_block(ctx, src + p, size, dst, cap, pos, start))
+				return -1;
+			p += size;
+			break;
+		default:
+			return -1;
+		}
+
+		if (bh & 1)
+			break;
+	}
+
+	if (fcs_size && *pos - start != fcs)
+		return -1;
+
+	if (fhd & 0x04) {
+		if (p + 4 > len)
+			return -1;
+		if ((uint32_t)xxh64(dst + start, *pos - start) !=
+		    zstd_le32(src + p)) {
+			*msg = "checksum mismatch";
+			return -1;
+		}
+		p += 4;
+	}
+
+	return p;
+}
+
+/*
+ * Decompress the frames at the start of src into dst.  Decoding stops at
+ * the first data which is not a frame, such as the size appended to
+ * compressed Linux kernels, and the amount of input used is returned in
+ * *in_used.
+ */
+static int INIT zstd_decompress(const uint8_t *src, size_t len,
+				uint8_t *dst, size_t cap, size_t *in_used,
+				size_t *out_len, const char **msg)
+{
+	struct zstd_ctx *ctx;
+	size_t p = 0, pos = 0;
+	unsigned int frames = 0;
+	int ret = -1;
+
+	ctx = large_malloc(sizeof(*ctx));
+	if (!ctx) {
+		*msg = "could not allocate decoder state";
+		return -1;
+	}
+
+	while (len - p >= 4) {
+		uint32_t magic = zstd_le32(src + p);
+
+		if (magic == ZSTD_MAGIC) {
+			long n = zstd_frame(ctx, src + p, len - p, dst, cap,
+					    &pos, msg);
+
+			if (n < 0)
+				goto out;
+			p += n;
+			frames++;
+		} else if ((magic & ZSTD_SKIPPABLE_MASK) ==
+			   ZSTD_SKIPPABLE_MAGIC) {
+			if (len - p < 8 || zstd_le32(src + p + 4) > len - p - 8) {
+				*msg = "truncated skippable frame";
+				goto out;
+			}
+			p += 8 + zstd_le32(src + p + 4);
+		} else
+			break;
+	}
+
+	if (!frames) {
+		*msg = "not a zstd stream";
+		goto out;
+	}
+
+	*in_used = p;
+	*out_len = pos;
+	ret = 0;
+
+ out:
+	large_free(ctx);
+	return ret;
+}
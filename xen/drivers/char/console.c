@@ -327,10 +327,35 @@ static void do_dec_thresh(unsigned char key, struct cpu_user_regs *regs)
 
 static void conring_puts(const char *str, size_t len)
 {
+    uint32_t p = conringp;
+
     ASSERT(spin_is_locked(&console_lock));
 
-    while ( len-- )
-        conring[CONRING_IDX_MASK(conringp++)] = *str++;
+    /* Only the tail of overly long strings can survive in the ring. */
+    if ( len > conring_size )
+    {
+        str += len - conring_size;
+        p += len - conring_size;
+        len = conring_size;
+    }
+
+    while ( len )
+    {
+        size_t chunk = min_t(size_t, len,
+                             conring_size - CONRING_IDX_MASK(p));
+
+        memcpy(&conring[CONRING_IDX_MASK(p)], str, chunk);
+        str += chunk;
+        p += chunk;
+        len -= chunk;
+    }
+
+    /*
+     * Publish the new producer index only once the data is in place, for
+     * the benefit of lockless readers like read_console_ring().
+     */
+    smp_wmb();
+    write_atomic(&conringp, p);
 
     if ( conringp - conringc > conring_size )
         conringc = conringp - conring_size;
@@ -886,18 +911,39 @@ static void vprintk_common(const char *prefix, const char *fmt, va_list args)
         bool_t continued, do_print;
     }            *state;
     static DEFINE_PER_CPU(struct vps, state);
+    /*
+     * Messages are formatted into a per-CPU staging buffer before taking
+     * console_lock, so that CPUs printing concurrently don't serialise on
+     * vsnprintf().  Nested calls on the same CPU (from NMI/#MC context, or
+     * from __printk_ratelimit() with console_lock held) use the shared
+     * buffer, under console_lock.
+     */
+    static DEFINE_PER_CPU(char[1024], staging_buf);
+    static DEFINE_PER_CPU(bool, staging_busy);
     static char   buf[1024];
-    char         *p, *q;
+    char         *p, *q, *msg = NULL;
     unsigned long flags;
 
-    /* console_lock can be acquired recursively from __printk_ratelimit(). */
     local_irq_save(flags);
+
+    if ( !this_cpu(staging_busy) )
+    {
+        this_cpu(staging_busy) = true;
+        msg = this_cpu(staging_buf);
+        (void)vsnprintf(msg, sizeof(this_cpu(staging_buf)), fmt, args);
+    }
+
+    /* console_lock can be acquired recursively from __printk_ratelimit(). */
     spin_lock_recursive(&console_lock);
     state = &this_cpu(state);
 
-    (void)vsnprintf(buf, sizeof(buf), fmt, args);
+    if ( !msg )
+    {
+        msg = buf;
+        (void)vsnprintf(msg, sizeof(buf), fmt, args);
+    }
 
-    p = buf;
+    p = msg;
 
     while ( (q = strchr(p, '\n')) != NULL )
     {
@@ -929,6 +975,10 @@ static void vprintk_common(const char *prefix, const char *fmt, va_list args)
     }
 
     spin_unlock_recursive(&console_lock);
+
+    if ( msg != buf )
+        this_cpu(staging_busy) = false;
+
     local_irq_restore(flags);
 }
 
@@ -63,6 +63,9 @@ LIST_HEAD_READ_MOSTLY(cpufreq_governor_list);
 /* set xen as default cpufreq */
 enum cpufreq_controller cpufreq_controller = FREQCTL_xen;
 
+/* Use the hardware P-states driver where available. */
+bool __initdata opt_cpufreq_hwp;
+
 static int __init cpufreq_cmdline_parse(const char *s);
 
 static int __init setup_cpufreq_option(const char *str)
@@ -89,10 +92,12 @@ static int __init setup_cpufreq_option(const char *str)
         return 0;
     }
 
-    if ( choice > 0 || !cmdline_strcmp(str, "xen") )
+    if ( choice > 0 || !cmdline_strcmp(str, "xen") ||
+         !cmdline_strcmp(str, "hwp") )
     {
         xen_processor_pmbits |= XEN_PROCESSOR_PM_PX;
         cpufreq_controller = FREQCTL_xen;
+        opt_cpufreq_hwp = !cmdline_strcmp(str, "hwp");
         if ( *arg && *(arg + 1) )
             return cpufreq_cmdline_parse(arg + 1);
     }
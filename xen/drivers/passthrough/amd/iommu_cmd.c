@@ -20,26 +20,32 @@
 #include "iommu.h"
 #include "../ats.h"
 
-static int queue_iommu_command(struct amd_iommu *iommu, u32 cmd[])
+static bool queue_iommu_command(struct amd_iommu *iommu, u32 cmd[])
 {
-    uint32_t tail, head;
+    uint32_t tail;
 
     tail = iommu->cmd_buffer.tail + IOMMU_CMD_BUFFER_ENTRY_SIZE;
     if ( tail == iommu->cmd_buffer.size )
         tail = 0;
 
-    head = readl(iommu->mmio_base +
-                 IOMMU_CMD_BUFFER_HEAD_OFFSET) & IOMMU_RING_BUFFER_PTR_MASK;
-    if ( head != tail )
-    {
-        memcpy(iommu->cmd_buffer.buffer + iommu->cmd_buffer.tail,
-               cmd, IOMMU_CMD_BUFFER_ENTRY_SIZE);
+    /*
+     * Only go and read the hardware head pointer if the cached one says
+     * the ring is full, to avoid an MMIO read for every command queued.
+     */
+    if ( tail == iommu->cmd_buffer.head )
+        iommu->cmd_buffer.head = readl(iommu->mmio_base +
+                                       IOMMU_CMD_BUFFER_HEAD_OFFSET) &
+                                 IOMMU_RING_BUFFER_PTR_MASK;
 
-        iommu->cmd_buffer.tail = tail;
-        return 1;
-    }
+    if ( tail == iommu->cmd_buffer.head )
+        return false;
+
+    memcpy(iommu->cmd_buffer.buffer + iommu->cmd_buffer.tail,
+           cmd, IOMMU_CMD_BUFFER_ENTRY_SIZE);
 
-    return 0;
+    iommu->cmd_buffer.tail = tail;
+
+    return true;
 }
 
 static void commit_iommu_command_buffer(struct amd_iommu *iommu)
@@ -48,15 +54,19 @@ static void commit_iommu_command_buffer(struct amd_iommu *iommu)
            iommu->mmio_base + IOMMU_CMD_BUFFER_TAIL_OFFSET);
 }
 
-static int send_iommu_command(struct amd_iommu *iommu, u32 cmd[])
+/*
+ * Queue a command without making it visible to the IOMMU yet.  Commands
+ * are handed to the hardware in one go (a single tail pointer update) by
+ * flush_command_buffer(), unless the ring fills up in the meantime, in which
+ * case what was queued so far gets submitted to make room.
+ */
+static void send_iommu_command(struct amd_iommu *iommu, u32 cmd[])
 {
-    if ( queue_iommu_command(iommu, cmd) )
+    while ( !queue_iommu_command(iommu, cmd) )
     {
         commit_iommu_command_buffer(iommu);
-        return 1;
+        cpu_relax();
     }
-
-    return 0;
 }
 
 static void flush_command_buffer(struct amd_iommu *iommu)
@@ -77,6 +87,7 @@ static void flush_command_buffer(struct amd_iommu *iommu)
                          IOMMU_COMP_WAIT_I_FLAG_MASK,
                          IOMMU_COMP_WAIT_I_FLAG_SHIFT, &cmd[0]);
     send_iommu_command(iommu, cmd);
+    commit_iommu_command_buffer(iommu);
 
     /* Make loop_count long enough for polling completion wait bit */
     loop_count = 1000;
@@ -104,7 +115,7 @@ static void invalidate_iommu_pages(struct amd_iommu *iommu,
     u32 cmd[4], entry;
     int sflag = 0, pde = 0;
 
-    ASSERT ( order == 0 || order == 9 || order == 18 );
+    ASSERT(order < PADDR_BITS - PAGE_SHIFT);
 
     /* All pages associated with the domainID are invalidated */
     if ( order || (io_addr == INV_IOMMU_ALL_PAGES_ADDRESS ) )
@@ -161,7 +172,7 @@ static void invalidate_iotlb_pages(struct amd_iommu *iommu,
     u32 cmd[4], entry;
     int sflag = 0;
 
-    ASSERT ( order == 0 || order == 9 || order == 18 );
+    ASSERT(order < PADDR_BITS - PAGE_SHIFT);
 
     if ( order || (io_addr == INV_IOMMU_ALL_PAGES_ADDRESS ) )
         sflag = 1;
@@ -208,7 +219,7 @@ static void invalidate_iotlb_pages(struct amd_iommu *iommu,
 
     set_field_in_reg_u32(sflag, 0,
                          IOMMU_INV_IOTLB_PAGES_S_FLAG_MASK,
-                         IOMMU_INV_IOTLB_PAGES_S_FLAG_MASK, &entry);
+                         IOMMU_INV_IOTLB_PAGES_S_FLAG_SHIFT, &entry);
 
     set_field_in_reg_u32((u32)addr_lo >> PAGE_SHIFT, entry,
                          IOMMU_INV_IOTLB_PAGES_ADDR_LOW_MASK,
@@ -272,19 +283,37 @@ static void invalidate_iommu_all(struct amd_iommu *iommu)
     send_iommu_command(iommu, cmd);
 }
 
+static bool queue_iotlb_flush(struct amd_iommu *iommu, u8 devfn,
+                              const struct pci_dev *pdev,
+                              daddr_t daddr, unsigned int order)
+{
+    unsigned int req_id, queueid, maxpend;
+
+    if ( !pci_ats_enabled(pdev->seg, pdev->bus, pdev->devfn) )
+        return false;
+
+    if ( !iommu_has_cap(iommu, PCI_CAP_IOTLB_SHIFT) )
+        return false;
+
+    req_id = get_dma_requestor_id(iommu->seg, PCI_BDF2(pdev->bus, devfn));
+    queueid = req_id;
+    maxpend = pdev->ats.queue_depth & 0xff;
+
+    /* send INVALIDATE_IOTLB_PAGES command */
+    invalidate_iotlb_pages(iommu, maxpend, 0, queueid, daddr, req_id, order);
+
+    return true;
+}
+
 void amd_iommu_flush_iotlb(u8 devfn, const struct pci_dev *pdev,
                            daddr_t daddr, unsigned int order)
 {
     unsigned long flags;
     struct amd_iommu *iommu;
-    unsigned int req_id, queueid, maxpend;
 
     if ( !ats_enabled )
         return;
 
-    if ( !pci_ats_enabled(pdev->seg, pdev->bus, pdev->devfn) )
-        return;
-
     iommu = find_iommu_for_device(pdev->seg, PCI_BDF2(pdev->bus, pdev->devfn));
 
     if ( !iommu )
@@ -294,34 +323,32 @@ void amd_iommu_flush_iotlb(u8 devfn, const struct pci_dev *pdev,
         return;
     }
 
-    if ( !iommu_has_cap(iommu, PCI_CAP_IOTLB_SHIFT) )
-        return;
-
-    req_id = get_dma_requestor_id(iommu->seg, PCI_BDF2(pdev->bus, devfn));
-    queueid = req_id;
-    maxpend = pdev->ats.queue_depth & 0xff;
-
-    /* send INVALIDATE_IOTLB_PAGES command */
     spin_lock_irqsave(&iommu->lock, flags);
-    invalidate_iotlb_pages(iommu, maxpend, 0, queueid, daddr, req_id, order);
-    flush_command_buffer(iommu);
+    if ( queue_iotlb_flush(iommu, devfn, pdev, daddr, order) )
+        flush_command_buffer(iommu);
     spin_unlock_irqrestore(&iommu->lock, flags);
 }
 
-static void amd_iommu_flush_all_iotlbs(struct domain *d, daddr_t daddr,
-                                       unsigned int order)
+/*
+ * Queue device IOTLB invalidations for all of the domain's ATS capable
+ * devices behind @iommu, to be completed by the same COMPLETION_WAIT as
+ * the IOMMU's own invalidation.
+ */
+static void queue_all_iotlb_flushes(struct amd_iommu *iommu, struct domain *d,
+                                    daddr_t daddr, unsigned int order)
 {
     struct pci_dev *pdev;
 
-    if ( !ats_enabled )
-        return;
-
     for_each_pdev( d, pdev )
     {
         u8 devfn = pdev->devfn;
 
+        if ( find_iommu_for_device(pdev->seg,
+                                   PCI_BDF2(pdev->bus, pdev->devfn)) != iommu )
+            continue;
+
         do {
-            amd_iommu_flush_iotlb(devfn, pdev, daddr, order);
+            queue_iotlb_flush(iommu, devfn, pdev, daddr, order);
             devfn += pdev->phantom_stride;
         } while ( devfn != pdev->devfn &&
                   PCI_SLOT(devfn) == PCI_SLOT(pdev->devfn) );
@@ -341,12 +368,11 @@ static void _amd_iommu_flush_pages(struct domain *d,
     {
         spin_lock_irqsave(&iommu->lock, flags);
         invalidate_iommu_pages(iommu, daddr, dom_id, order);
+        if ( ats_enabled )
+            queue_all_iotlb_flushes(iommu, d, daddr, order);
         flush_command_buffer(iommu);
         spin_unlock_irqrestore(&iommu->lock, flags);
     }
-
-    if ( ats_enabled )
-        amd_iommu_flush_all_iotlbs(d, daddr, order);
 }
 
 void amd_iommu_flush_all_pages(struct domain *d)
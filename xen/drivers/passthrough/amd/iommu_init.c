@@ -212,6 +212,7 @@ static void set_iommu_command_buffer_control(struct amd_iommu *iommu,
     {
         writeq(0, iommu->mmio_base + IOMMU_CMD_BUFFER_HEAD_OFFSET);
         writeq(0, iommu->mmio_base + IOMMU_CMD_BUFFER_TAIL_OFFSET);
+        iommu->cmd_buffer.head = iommu->cmd_buffer.tail = 0;
     }
 
     iommu->ctrl.cmd_buf_en = enable;
@@ -350,21 +350,12 @@ int amd_iommu_unmap_page(struct domain *d, dfn_t dfn,
     return 0;
 }
 
-static unsigned long flush_count(unsigned long dfn, unsigned long page_count,
-                                 unsigned int order)
-{
-    unsigned long start = dfn >> order;
-    unsigned long end = ((dfn + page_count - 1) >> order) + 1;
-
-    ASSERT(end > start);
-    return end - start;
-}
-
 int amd_iommu_flush_iotlb_pages(struct domain *d, dfn_t dfn,
                                 unsigned long page_count,
                                 unsigned int flush_flags)
 {
     unsigned long dfn_l = dfn_x(dfn);
+    unsigned int order;
 
     ASSERT(page_count && !dfn_eq(dfn, INVALID_DFN));
     ASSERT(flush_flags);
@@ -381,19 +372,19 @@ int amd_iommu_flush_iotlb_pages(struct domain *d, dfn_t dfn,
     }
 
     /*
-     * Flushes are expensive so find the minimal single flush that will
-     * cover the page range.
+     * Flushes are expensive so issue the minimal single, naturally aligned
+     * power-of-two sized flush that will cover the page range.  The
+     * invalidation commands can express any such size, not just the ones
+     * corresponding to page table levels.
      *
      * NOTE: It is unnecessary to round down the DFN value to align with
      *       the flush order here. This is done by the internals of the
      *       flush code.
      */
-    if ( page_count == 1 ) /* order 0 flush count */
-        amd_iommu_flush_pages(d, dfn_l, 0);
-    else if ( flush_count(dfn_l, page_count, 9) == 1 )
-        amd_iommu_flush_pages(d, dfn_l, 9);
-    else if ( flush_count(dfn_l, page_count, 18) == 1 )
-        amd_iommu_flush_pages(d, dfn_l, 18);
+    order = flsl(dfn_l ^ (dfn_l + page_count - 1));
+
+    if ( order < PADDR_BITS - PAGE_SHIFT )
+        amd_iommu_flush_pages(d, dfn_l, order);
     else
         amd_iommu_flush_all_pages(d);
 
@@ -492,6 +492,7 @@ static struct iommu_group *iommu_group_get(struct device *dev)
 #define ARM_SMMU_CB_FAR_HI		0x64
 #define ARM_SMMU_CB_FSYNR0		0x68
 #define ARM_SMMU_CB_S1_TLBIASID		0x610
+#define ARM_SMMU_CB_S2_TLBIIPAS2	0x630
 
 #define SCTLR_S1_ASIDPNE		(1 << 12)
 #define SCTLR_CFCFG			(1 << 7)
@@ -876,7 +877,8 @@ static void arm_smmu_tlb_sync(struct arm_smmu_device *smmu)
 	}
 }
 
-static void arm_smmu_tlb_inv_context(struct arm_smmu_domain *smmu_domain)
+/* Xen: Split out of arm_smmu_tlb_inv_context() so syncs can be batched */
+static void arm_smmu_tlb_inv_context_nosync(struct arm_smmu_domain *smmu_domain)
 {
 	struct arm_smmu_cfg *cfg = &smmu_domain->cfg;
 	struct arm_smmu_device *smmu = smmu_domain->smmu;
@@ -892,8 +894,12 @@ static void arm_smmu_tlb_inv_context(struct arm_smmu_domain *smmu_domain)
 		writel_relaxed(ARM_SMMU_CB_VMID(cfg),
 			       base + ARM_SMMU_GR0_TLBIVMID);
 	}
+}
 
-	arm_smmu_tlb_sync(smmu);
+static void arm_smmu_tlb_inv_context(struct arm_smmu_domain *smmu_domain)
+{
+	arm_smmu_tlb_inv_context_nosync(smmu_domain);
+	arm_smmu_tlb_sync(smmu_domain->smmu);
 }
 
 static irqreturn_t arm_smmu_context_fault(int irq, void *dev)
@@ -2512,7 +2518,48 @@ static int force_stage = 2;
  */
 static u32 platform_features = ARM_SMMU_FEAT_COHERENT_WALK;
 
-static int __must_check arm_smmu_iotlb_flush_all(struct domain *d)
+/*
+ * Xen: Above this many pages invalidating the whole VMID is expected to be
+ * cheaper than invalidating by IPA one page at a time.
+ */
+#define ARM_SMMU_TLBI_RANGE_MAX		32
+
+/*
+ * Invalidate a range of IPAs in a stage-2 context bank. Only SMMUv2
+ * provides invalidation by IPA, return false if the whole context needs
+ * to be invalidated instead.
+ */
+static bool arm_smmu_tlb_inv_range_nosync(struct arm_smmu_domain *smmu_domain,
+					  paddr_t ipa, unsigned long page_count)
+{
+	struct arm_smmu_cfg *cfg = &smmu_domain->cfg;
+	struct arm_smmu_device *smmu = smmu_domain->smmu;
+	void __iomem *reg;
+
+	if (smmu->version == ARM_SMMU_V1 || cfg->cbar != CBAR_TYPE_S2_TRANS)
+		return false;
+
+	reg = ARM_SMMU_CB_BASE(smmu) + ARM_SMMU_CB(smmu, cfg->cbndx) +
+	      ARM_SMMU_CB_S2_TLBIIPAS2;
+
+	for (; page_count--; ipa += PAGE_SIZE) {
+#ifdef CONFIG_64BIT
+		writeq_relaxed(ipa >> 12, reg);
+#else
+		writel_relaxed(ipa >> 12, reg);
+#endif
+	}
+
+	return true;
+}
+
+/*
+ * Xen: Issue the invalidations for all the contexts of the domain first, and
+ * only then wait for them to complete, rather than syncing each context in
+ * turn.
+ */
+static void arm_smmu_iotlb_flush_contexts(struct domain *d, dfn_t dfn,
+					  unsigned long page_count)
 {
 	struct arm_smmu_xen_domain *smmu_domain = dom_iommu(d)->arch.priv;
 	struct iommu_domain *cfg;
@@ -2526,9 +2573,23 @@ static int __must_check arm_smmu_iotlb_flush_all(struct domain *d)
 		 */
 		if (unlikely(!ACCESS_ONCE(cfg->priv->smmu)))
 			continue;
-		arm_smmu_tlb_inv_context(cfg->priv);
+		if (!page_count ||
+		    !arm_smmu_tlb_inv_range_nosync(cfg->priv,
+						   pfn_to_paddr(dfn_x(dfn)),
+						   page_count))
+			arm_smmu_tlb_inv_context_nosync(cfg->priv);
+	}
+	list_for_each_entry(cfg, &smmu_domain->contexts, list) {
+		if (unlikely(!ACCESS_ONCE(cfg->priv->smmu)))
+			continue;
+		arm_smmu_tlb_sync(cfg->priv->smmu);
 	}
 	spin_unlock(&smmu_domain->lock);
+}
+
+static int __must_check arm_smmu_iotlb_flush_all(struct domain *d)
+{
+	arm_smmu_iotlb_flush_contexts(d, INVALID_DFN, 0);
 
 	return 0;
 }
@@ -2539,8 +2600,16 @@ static int __must_check arm_smmu_iotlb_flush(struct domain *d, dfn_t dfn,
 {
 	ASSERT(flush_flags);
 
-	/* ARM SMMU v1 doesn't have flush by VMA and VMID */
-	return arm_smmu_iotlb_flush_all(d);
+	/*
+	 * ARM SMMU v1 doesn't have flush by VMA and VMID, and large ranges are
+	 * cheaper to flush as a whole.
+	 */
+	if (page_count > ARM_SMMU_TLBI_RANGE_MAX)
+		page_count = 0;
+
+	arm_smmu_iotlb_flush_contexts(d, dfn, page_count);
+
+	return 0;
 }
 
 static struct iommu_domain *arm_smmu_get_domain(struct domain *d,
@@ -234,21 +234,51 @@ void iommu_domain_destroy(struct domain *d)
     arch_iommu_domain_destroy(d);
 }
 
+/*
+ * Largest order the IOMMU can map which both @dfn and @mfn are aligned to
+ * and which does not exceed @nr pages.
+ */
+static unsigned int mapping_order(const struct domain_iommu *hd,
+                                  dfn_t dfn, mfn_t mfn, unsigned long nr)
+{
+    unsigned long res = dfn_x(dfn) | mfn_x(mfn);
+    unsigned long sizes = hd->platform_ops->page_sizes & ~PAGE_SIZE_4K;
+
+    while ( sizes )
+    {
+        unsigned int bit = flsl(sizes) - 1;
+        unsigned int order = bit - PAGE_SHIFT;
+
+        if ( nr >= (1UL << order) && !(res & ((1UL << order) - 1)) )
+            return order;
+
+        sizes &= ~(1UL << bit);
+    }
+
+    return 0;
+}
+
 int iommu_map(struct domain *d, dfn_t dfn, mfn_t mfn,
               unsigned long page_count, unsigned int flags,
               unsigned int *flush_flags)
 {
     const struct domain_iommu *hd = dom_iommu(d);
     unsigned long i;
+    unsigned int order;
     int rc = 0;
 
     if ( !is_iommu_enabled(d) )
         return 0;
 
-    for ( i = 0; i < page_count; i++ )
+    ASSERT(!IOMMUF_order_of(flags));
+
+    for ( i = 0; i < page_count; i += 1UL << order )
     {
+        order = mapping_order(hd, dfn_add(dfn, i), mfn_add(mfn, i),
+                              page_count - i);
         rc = iommu_call(hd->platform_ops, map_page, d, dfn_add(dfn, i),
-                        mfn_add(mfn, i), flags, flush_flags);
+                        mfn_add(mfn, i), flags | IOMMUF_order(order),
+                        flush_flags);
 
         if ( likely(!rc) )
             continue;
@@ -175,12 +175,20 @@ bool __init intel_iommu_supports_eim(void)
  * low qword in IRTE is to be updated, this function's atomic variant can
  * present an atomic update to VT-d hardware even when cmpxchg16b
  * instruction is not supported.
+ *
+ * Returns false if the entry already had the requested contents, in which
+ * case there's no need to write it back or invalidate the interrupt entry
+ * cache.  This is common as IO-APIC RTEs are written in two halves and MSI
+ * messages get re-written e.g. on affinity changes to the same target.
  */
-static void update_irte(struct vtd_iommu *iommu, struct iremap_entry *entry,
+static bool update_irte(struct vtd_iommu *iommu, struct iremap_entry *entry,
                         const struct iremap_entry *new_ire, bool atomic)
 {
     ASSERT(spin_is_locked(&iommu->intremap.lock));
 
+    if ( entry->lo == new_ire->lo && entry->hi == new_ire->hi )
+        return false;
+
     if ( cpu_has_cx16 )
     {
         __uint128_t ret;
@@ -214,6 +222,10 @@ static void update_irte(struct vtd_iommu *iommu, struct iremap_entry *entry,
         else
             BUG();
     }
+
+    iommu_sync_cache(entry, sizeof(*entry));
+
+    return true;
 }
 
 /* Mark specified intr remap entry as free */
@@ -229,9 +241,8 @@ static void free_remap_entry(struct vtd_iommu *iommu, int index)
     GET_IREMAP_ENTRY(iommu->intremap.maddr, index,
                      iremap_entries, iremap_entry);
 
-    update_irte(iommu, iremap_entry, &new_ire, false);
-    iommu_sync_cache(iremap_entry, sizeof(*iremap_entry));
-    iommu_flush_iec_index(iommu, 0, index);
+    if ( update_irte(iommu, iremap_entry, &new_ire, false) )
+        iommu_flush_iec_index(iommu, 0, index);
 
     unmap_vtd_domain_page(iremap_entries);
     iommu->intremap.num--;
@@ -405,9 +416,8 @@ static int ioapic_rte_to_remap_entry(struct vtd_iommu *iommu,
         remap_rte->format = 1;    /* indicate remap format */
     }
 
-    update_irte(iommu, iremap_entry, &new_ire, !init);
-    iommu_sync_cache(iremap_entry, sizeof(*iremap_entry));
-    iommu_flush_iec_index(iommu, 0, index);
+    if ( update_irte(iommu, iremap_entry, &new_ire, !init) )
+        iommu_flush_iec_index(iommu, 0, index);
 
     unmap_vtd_domain_page(iremap_entries);
     spin_unlock_irqrestore(&iommu->intremap.lock, flags);
@@ -627,12 +637,11 @@ static int msi_msg_to_remap_entry(
     remap_rte->address_hi = 0;
     remap_rte->data = index - i;
 
-    update_irte(iommu, iremap_entry, &new_ire, msi_desc->irte_initialized);
+    if ( update_irte(iommu, iremap_entry, &new_ire,
+                     msi_desc->irte_initialized) )
+        iommu_flush_iec_index(iommu, 0, index);
     msi_desc->irte_initialized = true;
 
-    iommu_sync_cache(iremap_entry, sizeof(*iremap_entry));
-    iommu_flush_iec_index(iommu, 0, index);
-
     unmap_vtd_domain_page(iremap_entries);
     spin_unlock_irqrestore(&iommu->intremap.lock, flags);
 
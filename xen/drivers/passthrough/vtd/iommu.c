@@ -254,7 +254,15 @@ static u64 bus_to_context_maddr(struct vtd_iommu *iommu, u8 bus)
     return maddr;
 }
 
-static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
+/*
+ * Walk the page tables of @domain for @addr and return the machine address
+ * of the table at @target level (1 being the leaf table).  A superpage found
+ * on the way is split into a newly allocated next level table when
+ * @flush_flags is non-NULL, and makes the walk fail otherwise.
+ */
+static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr,
+                                  unsigned int target,
+                                  unsigned int *flush_flags, int alloc)
 {
     struct domain_iommu *hd = dom_iommu(domain);
     int addr_width = agaw_to_width(hd->arch.vtd.agaw);
@@ -275,6 +283,13 @@ static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
         hd->arch.vtd.pgd_maddr = page_to_maddr(pg);
     }
 
+    /* Only possible with 2-level tables and a superpage target. */
+    if ( level <= target )
+    {
+        pte_maddr = hd->arch.vtd.pgd_maddr;
+        goto out;
+    }
+
     parent = (struct dma_pte *)map_vtd_domain_page(hd->arch.vtd.pgd_maddr);
     while ( level > 1 )
     {
@@ -282,7 +297,39 @@ static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
         pte = &parent[offset];
 
         pte_maddr = dma_pte_addr(*pte);
-        if ( !pte_maddr )
+        if ( dma_pte_present(*pte) && dma_pte_superpage(*pte) )
+        {
+            struct page_info *pg;
+            struct dma_pte *split;
+            unsigned int i;
+
+            if ( !flush_flags || !(pg = iommu_alloc_pgtable(domain)) )
+            {
+                pte_maddr = 0;
+                break;
+            }
+
+            /* Replace the superpage by a table of equivalent entries. */
+            split = map_vtd_domain_page(page_to_maddr(pg));
+            for ( i = 0; i < PTE_NUM; i++ )
+            {
+                split[i].val = pte->val & ~(PAGE_MASK_4K | DMA_PTE_SP);
+                dma_set_pte_addr(split[i],
+                                 pte_maddr + ((paddr_t)i << PAGE_SHIFT_4K));
+            }
+            iommu_sync_cache(split, PAGE_SIZE_4K);
+            unmap_vtd_domain_page(split);
+
+            pte_maddr = page_to_maddr(pg);
+            dma_clear_pte(*pte);
+            dma_set_pte_addr(*pte, pte_maddr);
+            dma_set_pte_readable(*pte);
+            dma_set_pte_writable(*pte);
+            iommu_sync_cache(pte, sizeof(struct dma_pte));
+
+            *flush_flags |= IOMMU_FLUSHF_modified;
+        }
+        else if ( !pte_maddr )
         {
             struct page_info *pg;
 
@@ -305,7 +352,7 @@ static u64 addr_to_dma_page_maddr(struct domain *domain, u64 addr, int alloc)
             iommu_sync_cache(pte, sizeof(struct dma_pte));
         }
 
-        if ( level == 2 )
+        if ( level == target + 1 )
             break;
 
         unmap_vtd_domain_page(parent);
@@ -336,7 +383,7 @@ static uint64_t domain_pgd_maddr(struct domain *d, unsigned int nr_pt_levels)
     if ( !hd->arch.vtd.pgd_maddr )
     {
         /* Ensure we have pagetables allocated down to leaf PTE. */
-        addr_to_dma_page_maddr(d, 0, 1);
+        addr_to_dma_page_maddr(d, 0, 1, NULL, 1);
 
         if ( !hd->arch.vtd.pgd_maddr )
             return 0;
@@ -633,7 +680,13 @@ static int __must_check iommu_flush_iotlb(struct domain *d, dfn_t dfn,
     struct vtd_iommu *iommu;
     bool_t flush_dev_iotlb;
     int iommu_domid;
-    int rc = 0;
+    int rc = 0, ret;
+
+    /*
+     * Only queue the invalidations, so that multiple IOMMUs process them in
+     * parallel, and wait for their completion afterwards.
+     */
+    this_cpu(qinval_async) = true;
 
     /*
      * No need pcideves_lock here because we have flush
@@ -651,16 +704,26 @@ static int __must_check iommu_flush_iotlb(struct domain *d, dfn_t dfn,
         if ( iommu_domid == -1 )
             continue;
 
-        if ( !page_count || (page_count & (page_count - 1)) ||
-             dfn_eq(dfn, INVALID_DFN) || !IS_ALIGNED(dfn_x(dfn), page_count) )
+        if ( !page_count || dfn_eq(dfn, INVALID_DFN) )
             rc = iommu_flush_iotlb_dsi(iommu, iommu_domid,
                                        0, flush_dev_iotlb);
         else
+        {
+            /*
+             * Cover ranges which aren't naturally aligned powers of two
+             * with the smallest such block containing them, rather than
+             * dropping all of the domain's cached translations.  Flushing
+             * a few entries too many is harmless.
+             */
+            unsigned long last = dfn_x(dfn) + page_count - 1;
+            unsigned int order = dfn_x(dfn) == last
+                                 ? 0 : flsl(dfn_x(dfn) ^ last);
+
             rc = iommu_flush_iotlb_psi(iommu, iommu_domid,
-                                       dfn_to_daddr(dfn),
-                                       get_order_from_pages(page_count),
+                                       dfn_to_daddr(dfn), order,
                                        !dma_old_pte_present,
                                        flush_dev_iotlb);
+        }
 
         if ( rc > 0 )
         {
@@ -669,6 +732,20 @@ static int __must_check iommu_flush_iotlb(struct domain *d, dfn_t dfn,
         }
     }
 
+    this_cpu(qinval_async) = false;
+
+    for_each_drhd_unit ( drhd )
+    {
+        iommu = drhd->iommu;
+
+        if ( !test_bit(iommu->index, &hd->arch.vtd.iommu_bitmap) )
+            continue;
+
+        ret = qinval_sync(iommu);
+        if ( !rc )
+            rc = ret;
+    }
+
     return rc;
 }
 
@@ -690,20 +767,30 @@ static int __must_check iommu_flush_iotlb_all(struct domain *d)
 }
 
 /* clear one page's page table */
-static void dma_pte_clear_one(struct domain *domain, uint64_t addr,
-                              unsigned int *flush_flags)
+static int dma_pte_clear_one(struct domain *domain, uint64_t addr,
+                             unsigned int *flush_flags)
 {
     struct domain_iommu *hd = dom_iommu(domain);
     struct dma_pte *page = NULL, *pte = NULL;
     u64 pg_maddr;
+    int rc = 0;
 
     spin_lock(&hd->arch.mapping_lock);
-    /* get last level pte */
-    pg_maddr = addr_to_dma_page_maddr(domain, addr, 0);
+    /* get last level pte, splitting a superpage covering it */
+    pg_maddr = addr_to_dma_page_maddr(domain, addr, 1, flush_flags, 0);
     if ( pg_maddr == 0 )
     {
+        /* Failing to split a superpage is the only error case. */
+        pg_maddr = addr_to_dma_page_maddr(domain, addr, 2, NULL, 0);
+        if ( pg_maddr )
+        {
+            page = map_vtd_domain_page(pg_maddr);
+            if ( dma_pte_superpage(page[address_level_offset(addr, 2)]) )
+                rc = -ENOMEM;
+            unmap_vtd_domain_page(page);
+        }
         spin_unlock(&hd->arch.mapping_lock);
-        return;
+        return rc;
     }
 
     page = (struct dma_pte *)map_vtd_domain_page(pg_maddr);
@@ -713,7 +800,7 @@ static void dma_pte_clear_one(struct domain *domain, uint64_t addr,
     {
         spin_unlock(&hd->arch.mapping_lock);
         unmap_vtd_domain_page(page);
-        return;
+        return 0;
     }
 
     dma_clear_pte(*pte);
@@ -723,6 +810,8 @@ static void dma_pte_clear_one(struct domain *domain, uint64_t addr,
     iommu_sync_cache(pte, sizeof(struct dma_pte));
 
     unmap_vtd_domain_page(page);
+
+    return 0;
 }
 
 static int iommu_set_root_entry(struct vtd_iommu *iommu)
@@ -1749,9 +1838,15 @@ static int __must_check intel_iommu_map_page(struct domain *d, dfn_t dfn,
 {
     struct domain_iommu *hd = dom_iommu(d);
     struct dma_pte *page, *pte, old, new = {};
+    unsigned int order = IOMMUF_order_of(flags);
+    unsigned int level = order ? order / LEVEL_STRIDE + 1 : 1;
     u64 pg_maddr;
     int rc = 0;
 
+    ASSERT(order == 0 || order == PAGE_ORDER_2M);
+    ASSERT(!(dfn_x(dfn) & ((1UL << order) - 1)));
+    ASSERT(!(mfn_x(mfn) & ((1UL << order) - 1)));
+
     /* Do nothing if VT-d shares EPT page table */
     if ( iommu_use_hap_pt(d) )
         return 0;
@@ -1762,7 +1857,8 @@ static int __must_check intel_iommu_map_page(struct domain *d, dfn_t dfn,
 
     spin_lock(&hd->arch.mapping_lock);
 
-    pg_maddr = addr_to_dma_page_maddr(d, dfn_to_daddr(dfn), 1);
+    pg_maddr = addr_to_dma_page_maddr(d, dfn_to_daddr(dfn), level,
+                                      flush_flags, 1);
     if ( !pg_maddr )
     {
         spin_unlock(&hd->arch.mapping_lock);
@@ -1770,13 +1866,15 @@ static int __must_check intel_iommu_map_page(struct domain *d, dfn_t dfn,
     }
 
     page = (struct dma_pte *)map_vtd_domain_page(pg_maddr);
-    pte = &page[dfn_x(dfn) & LEVEL_MASK];
+    pte = &page[address_level_offset(dfn_to_daddr(dfn), level)];
     old = *pte;
 
     dma_set_pte_addr(new, mfn_to_maddr(mfn));
     dma_set_pte_prot(new,
                      ((flags & IOMMUF_readable) ? DMA_PTE_READ  : 0) |
                      ((flags & IOMMUF_writable) ? DMA_PTE_WRITE : 0));
+    if ( level > 1 )
+        dma_set_pte_superpage(new);
 
     /* Set the SNP on leaf page table if Snoop Control available */
     if ( iommu_snoop )
@@ -1813,9 +1911,7 @@ static int __must_check intel_iommu_unmap_page(struct domain *d, dfn_t dfn,
     if ( iommu_hwdom_passthrough && is_hardware_domain(d) )
         return 0;
 
-    dma_pte_clear_one(d, dfn_to_daddr(dfn), flush_flags);
-
-    return 0;
+    return dma_pte_clear_one(d, dfn_to_daddr(dfn), flush_flags);
 }
 
 static int intel_iommu_lookup_page(struct domain *d, dfn_t dfn, mfn_t *mfn,
@@ -1835,7 +1931,7 @@ static int intel_iommu_lookup_page(struct domain *d, dfn_t dfn, mfn_t *mfn,
 
     spin_lock(&hd->arch.mapping_lock);
 
-    pg_maddr = addr_to_dma_page_maddr(d, dfn_to_daddr(dfn), 0);
+    pg_maddr = addr_to_dma_page_maddr(d, dfn_to_daddr(dfn), 2, NULL, 0);
     if ( !pg_maddr )
     {
         spin_unlock(&hd->arch.mapping_lock);
@@ -1843,9 +1939,26 @@ static int intel_iommu_lookup_page(struct domain *d, dfn_t dfn, mfn_t *mfn,
     }
 
     page = map_vtd_domain_page(pg_maddr);
-    val = page[dfn_x(dfn) & LEVEL_MASK];
-
+    val = page[address_level_offset(dfn_to_daddr(dfn), 2)];
     unmap_vtd_domain_page(page);
+
+    if ( dma_pte_present(val) && dma_pte_superpage(val) )
+        dma_set_pte_addr(val, (paddr_t)(dfn_x(dfn) & LEVEL_MASK) <<
+                              PAGE_SHIFT_4K);
+    else
+    {
+        pg_maddr = dma_pte_addr(val);
+        if ( !pg_maddr )
+        {
+            spin_unlock(&hd->arch.mapping_lock);
+            return -ENOENT;
+        }
+
+        page = map_vtd_domain_page(pg_maddr);
+        val = page[dfn_x(dfn) & LEVEL_MASK];
+        unmap_vtd_domain_page(page);
+    }
+
     spin_unlock(&hd->arch.mapping_lock);
 
     if ( !dma_pte_present(val) )
@@ -2221,8 +2334,9 @@ static int __init vtd_setup(void)
 
     /* We enable the following features only if they are supported by all VT-d
      * engines: Snoop Control, DMA passthrough, Queued Invalidation, Interrupt
-     * Remapping, and Posted Interrupt
+     * Remapping, Posted Interrupt, and 2M superpage mappings
      */
+    iommu_ops.page_sizes |= PAGE_SIZE_4K << PAGE_ORDER_2M;
     for_each_drhd_unit ( drhd )
     {
         iommu = drhd->iommu;
@@ -2232,6 +2346,9 @@ static int __init vtd_setup(void)
                cap_sps_2mb(iommu->cap) ? ", 2MB" : "",
                cap_sps_1gb(iommu->cap) ? ", 1GB" : "");
 
+        if ( !cap_sps_2mb(iommu->cap) )
+            iommu_ops.page_sizes &= ~(PAGE_SIZE_4K << PAGE_ORDER_2M);
+
 #ifndef iommu_snoop
         if ( iommu_snoop && !ecap_snp_ctl(iommu->ecap) )
             iommu_snoop = false;
@@ -2612,14 +2729,15 @@ static void vtd_dump_page_table_level(paddr_t pt_maddr, int level, paddr_t gpa,
             continue;
 
         address = gpa + offset_level_address(i, level);
-        if ( next_level >= 1 ) 
+        if ( next_level >= 1 && !dma_pte_superpage(*pte) )
             vtd_dump_page_table_level(dma_pte_addr(*pte), next_level,
                                       address, indent + 1);
         else
-            printk("%*sdfn: %08lx mfn: %08lx\n",
+            printk("%*sdfn: %08lx mfn: %08lx%s\n",
                    indent, "",
                    (unsigned long)(address >> PAGE_SHIFT_4K),
-                   (unsigned long)(dma_pte_addr(*pte) >> PAGE_SHIFT_4K));
+                   (unsigned long)(dma_pte_addr(*pte) >> PAGE_SHIFT_4K),
+                   next_level ? " (superpage)" : "");
     }
 
     unmap_vtd_domain_page(pt_vaddr);
@@ -462,10 +462,6 @@ struct qinval_entry {
 #define QINVAL_ENTRY_ORDER  ( PAGE_SHIFT - 4 )
 #define QINVAL_ENTRY_NR     (1 << (QINVAL_PAGE_ORDER + 8))
 
-/* Status data flag */
-#define QINVAL_STAT_INIT  0
-#define QINVAL_STAT_DONE  1
-
 /* Queue invalidation head/tail shift */
 #define QINVAL_INDEX_SHIFT 4
 
@@ -520,6 +516,8 @@ struct vtd_iommu {
     struct acpi_drhd_unit *drhd;
 
     uint64_t qinval_maddr;   /* queue invalidation page machine address */
+    uint32_t qinval_seq;     /* last queued wait descriptor, register_lock */
+    uint32_t qinval_poll;    /* last completed wait descriptor, written by hw */
 
     struct {
         uint64_t maddr;   /* interrupt remap table machine address */
@@ -31,7 +31,20 @@
 
 #define VTD_QI_TIMEOUT	1
 
+/*
+ * Set while the current CPU issues IOTLB invalidations to several IOMMUs,
+ * to only queue them and have their completion waited for by qinval_sync().
+ */
+DEFINE_PER_CPU(bool, qinval_async);
+
 static int __must_check invalidate_sync(struct vtd_iommu *iommu);
+static uint32_t queue_invalidate_wait_nosync(struct vtd_iommu *iommu,
+                                             u8 iflag, u8 sw, u8 fn);
+static int __must_check flush_iotlb_qi(struct vtd_iommu *iommu, u16 did,
+                                       u64 addr,
+                                       unsigned int size_order, u64 type,
+                                       bool flush_non_present_entry,
+                                       bool flush_dev_iotlb);
 
 static void print_qi_regs(struct vtd_iommu *iommu)
 {
@@ -140,22 +153,33 @@ static int __must_check queue_invalidate_iotlb_sync(struct vtd_iommu *iommu,
     qinval_update_qtail(iommu, index);
     spin_unlock_irqrestore(&iommu->register_lock, flags);
 
+    if ( this_cpu(qinval_async) )
+    {
+        queue_invalidate_wait_nosync(iommu, 0, 1, 1);
+        return 0;
+    }
+
     return invalidate_sync(iommu);
 }
 
-static int __must_check queue_invalidate_wait(struct vtd_iommu *iommu,
-                                              u8 iflag, u8 sw, u8 fn,
-                                              bool_t flush_dev_iotlb)
+/*
+ * Queue a wait descriptor and return its sequence number, which the
+ * hardware writes to the IOMMU's status word once all prior descriptors
+ * have completed.  As wait descriptors complete in order, the status word
+ * only ever moves forward, and a waiter may return as soon as it reaches
+ * (or passes) its own sequence number.
+ */
+static uint32_t queue_invalidate_wait_nosync(struct vtd_iommu *iommu,
+                                             u8 iflag, u8 sw, u8 fn)
 {
-    static DEFINE_PER_CPU(uint32_t, poll_slot);
     unsigned int index;
     unsigned long flags;
     u64 entry_base;
     struct qinval_entry *qinval_entry, *qinval_entries;
-    uint32_t *this_poll_slot = &this_cpu(poll_slot);
+    uint32_t seq;
 
     spin_lock_irqsave(&iommu->register_lock, flags);
-    ACCESS_ONCE(*this_poll_slot) = QINVAL_STAT_INIT;
+    seq = ++iommu->qinval_seq;
     index = qinval_next_index(iommu);
     entry_base = iommu->qinval_maddr +
                  ((index >> QINVAL_ENTRY_ORDER) << PAGE_SHIFT);
@@ -167,39 +191,64 @@ static int __must_check queue_invalidate_wait(struct vtd_iommu *iommu,
     qinval_entry->q.inv_wait_dsc.lo.sw = sw;
     qinval_entry->q.inv_wait_dsc.lo.fn = fn;
     qinval_entry->q.inv_wait_dsc.lo.res_1 = 0;
-    qinval_entry->q.inv_wait_dsc.lo.sdata = QINVAL_STAT_DONE;
-    qinval_entry->q.inv_wait_dsc.hi.saddr = virt_to_maddr(this_poll_slot);
+    qinval_entry->q.inv_wait_dsc.lo.sdata = seq;
+    qinval_entry->q.inv_wait_dsc.hi.saddr = virt_to_maddr(&iommu->qinval_poll);
 
     unmap_vtd_domain_page(qinval_entries);
     qinval_update_qtail(iommu, index);
     spin_unlock_irqrestore(&iommu->register_lock, flags);
 
-    /* Now we don't support interrupt method */
-    if ( sw )
-    {
-        s_time_t timeout;
+    return seq;
+}
 
-        /* In case all wait descriptor writes to same addr with same data */
-        timeout = NOW() + MILLISECS(flush_dev_iotlb ?
-                                    iommu_dev_iotlb_timeout : VTD_QI_TIMEOUT);
+static int __must_check qinval_wait_seq(struct vtd_iommu *iommu, uint32_t seq,
+                                        unsigned int timeout_ms)
+{
+    s_time_t timeout = NOW() + MILLISECS(timeout_ms);
 
-        while ( ACCESS_ONCE(*this_poll_slot) != QINVAL_STAT_DONE )
+    while ( (int32_t)(ACCESS_ONCE(iommu->qinval_poll) - seq) < 0 )
+    {
+        if ( NOW() > timeout )
         {
-            if ( NOW() > timeout )
-            {
-                print_qi_regs(iommu);
-                printk(XENLOG_WARNING VTDPREFIX
-                       " Queue invalidate wait descriptor timed out\n");
-                return -ETIMEDOUT;
-            }
-            cpu_relax();
+            print_qi_regs(iommu);
+            printk(XENLOG_WARNING VTDPREFIX
+                   " Queue invalidate wait descriptor timed out\n");
+            return -ETIMEDOUT;
         }
-        return 0;
+        cpu_relax();
     }
 
+    return 0;
+}
+
+static int __must_check queue_invalidate_wait(struct vtd_iommu *iommu,
+                                              u8 iflag, u8 sw, u8 fn,
+                                              bool_t flush_dev_iotlb)
+{
+    uint32_t seq = queue_invalidate_wait_nosync(iommu, iflag, sw, fn);
+
+    /* Now we don't support interrupt method */
+    if ( sw )
+        return qinval_wait_seq(iommu, seq,
+                               flush_dev_iotlb ? iommu_dev_iotlb_timeout
+                                               : VTD_QI_TIMEOUT);
+
     return -EOPNOTSUPP;
 }
 
+/*
+ * Wait for the completion of all invalidations queued so far, in particular
+ * the ones queued without waiting while qinval_async was set.
+ */
+int qinval_sync(struct vtd_iommu *iommu)
+{
+    if ( iommu->flush.iotlb != flush_iotlb_qi )
+        return 0;
+
+    return qinval_wait_seq(iommu, ACCESS_ONCE(iommu->qinval_seq),
+                           VTD_QI_TIMEOUT);
+}
+
 static int __must_check invalidate_sync(struct vtd_iommu *iommu)
 {
     ASSERT(iommu->qinval_maddr);
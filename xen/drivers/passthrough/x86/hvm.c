@@ -365,6 +365,7 @@ int pt_irq_create_bind(
              * As such on every 'pt_irq_create_bind' call we MUST set it.
              */
             pirq_dpci->dom = d;
+            set_bit(pirq_dpci->gmsi.gvec, hvm_domain_irq(d)->dpci_msi_gvecs);
             /* bind after hvm_irq_dpci is setup to avoid race with irq handler*/
             rc = pirq_guest_bind(d->vcpu[0], info, 0);
             if ( rc == 0 && pt_irq_bind->u.msi.gtable )
@@ -412,6 +413,8 @@ int pt_irq_create_bind(
 
                 pirq_dpci->gmsi.gvec = pt_irq_bind->u.msi.gvec;
                 pirq_dpci->gmsi.gflags = gflags;
+                set_bit(pirq_dpci->gmsi.gvec,
+                        hvm_domain_irq(d)->dpci_msi_gvecs);
             }
         }
         /* Calculate dest_vcpu_id for MSI-type pirq migration. */
@@ -626,6 +629,36 @@ int pt_irq_create_bind(
     return 0;
 }
 
+static int _update_dpci_msi_gvecs(struct domain *d,
+                                  struct hvm_pirq_dpci *pirq_dpci, void *arg)
+{
+    unsigned long *gvecs = arg;
+
+    if ( pirq_dpci->flags & HVM_IRQ_DPCI_MACH_MSI )
+        __set_bit(pirq_dpci->gmsi.gvec, gvecs);
+
+    return 0;
+}
+
+/*
+ * Drop the vectors no longer used by any MSI from the domain's set.  The
+ * set is built separately and then copied, so that bits of vectors still in
+ * use never appear clear to a concurrent hvm_dpci_msi_eoi().
+ */
+static void update_dpci_msi_gvecs(struct domain *d)
+{
+    DECLARE_BITMAP(gvecs, X86_NR_VECTORS) = {};
+    struct hvm_irq *hvm_irq = hvm_domain_irq(d);
+    unsigned int i;
+
+    ASSERT(spin_is_locked(&d->event_lock));
+
+    pt_pirq_iterate(d, _update_dpci_msi_gvecs, gvecs);
+
+    for ( i = 0; i < ARRAY_SIZE(gvecs); i++ )
+        write_atomic(&hvm_irq->dpci_msi_gvecs[i], gvecs[i]);
+}
+
 int pt_irq_destroy_bind(
     struct domain *d, const struct xen_domctl_bind_pt_irq *pt_irq_bind)
 {
@@ -753,6 +786,9 @@ int pt_irq_destroy_bind(
         pt_pirq_softirq_reset(pirq_dpci);
 
         pirq_cleanup_check(pirq, d);
+
+        if ( pt_irq_bind->irq_type == PT_IRQ_TYPE_MSI )
+            update_dpci_msi_gvecs(d);
     }
 
     spin_unlock(&d->event_lock);
@@ -877,7 +913,8 @@ static int _hvm_dpci_msi_eoi(struct domain *d,
 void hvm_dpci_msi_eoi(struct domain *d, int vector)
 {
     if ( !is_iommu_enabled(d) ||
-         (!hvm_domain_irq(d)->dpci && !is_hardware_domain(d)) )
+         (!hvm_domain_irq(d)->dpci && !is_hardware_domain(d)) ||
+         !test_bit(vector, hvm_domain_irq(d)->dpci_msi_gvecs) )
        return;
 
     spin_lock(&d->event_lock);
@@ -1001,13 +1038,51 @@ static void hvm_gsi_eoi(struct domain *d, unsigned int gsi,
     hvm_pirq_eoi(pirq, ent);
 }
 
+/*
+ * Lockless check whether a guest GSI may have a passthrough interrupt in
+ * flight, so that EOIs of vectors used only by emulated devices needn't take
+ * the event lock (and have the vIOAPIC drop and retake its own).  A mapping
+ * can only become visible here before the guest gets to see an interrupt
+ * through it, and a stale positive result just takes the slow path, which
+ * re-checks under the event lock.
+ */
+bool hvm_dpci_gsi_mapped(struct domain *d, unsigned int guest_gsi)
+{
+    const struct hvm_irq_dpci *dpci;
+    bool mapped;
+
+    if ( !is_iommu_enabled(d) )
+        return false;
+
+    if ( is_hardware_domain(d) )
+    {
+        const struct pirq *pirq;
+
+        rcu_read_lock(&pirq_rcu_lock);
+        pirq = pirq_info(d, guest_gsi);
+        mapped = pirq && (pirq_dpci(pirq)->flags & HVM_IRQ_DPCI_MAPPED);
+        rcu_read_unlock(&pirq_rcu_lock);
+
+        return mapped;
+    }
+
+    dpci = domain_get_irq_dpci(d);
+    if ( !dpci )
+        return false;
+
+    if ( guest_gsi < NR_ISAIRQS )
+        return test_bit(guest_gsi, dpci->isairq_map);
+
+    return !list_empty(&dpci->girq[guest_gsi]);
+}
+
 void hvm_dpci_eoi(struct domain *d, unsigned int guest_gsi,
                   const union vioapic_redir_entry *ent)
 {
     const struct hvm_irq_dpci *hvm_irq_dpci;
     const struct hvm_girq_dpci_mapping *girq;
 
-    if ( !is_iommu_enabled(d) )
+    if ( !hvm_dpci_gsi_mapped(d, guest_gsi) )
         return;
 
     if ( is_hardware_domain(d) )
@@ -57,6 +57,12 @@ static int map_range(unsigned long s, unsigned long e, void *data,
         if ( rc == 0 )
         {
             *c += size;
+            /*
+             * Also check for preemption between ranges, as a device may
+             * have many BARs each small enough to be mapped in one go.
+             */
+            if ( general_preempt_check() )
+                return -ERESTART;
             break;
         }
         if ( rc < 0 )
@@ -325,6 +331,18 @@ static int modify_bars(const struct pci_dev *pdev, uint16_t cmd, bool rom_only)
         return apply_map(pdev->domain, pdev, mem, cmd);
     }
 
+    if ( rangeset_is_empty(mem) )
+    {
+        /*
+         * Everything overlaps with already enabled BARs, so there's nothing
+         * to {un}map: update the decoding right away rather than deferring
+         * an empty operation to the next vpci_process_pending().
+         */
+        rangeset_destroy(mem);
+        modify_decoding(pdev, cmd, rom_only);
+        return 0;
+    }
+
     defer_map(dev->domain, dev, mem, cmd, rom_only);
 
     return 0;
@@ -42,7 +42,13 @@ static uint32_t control_read(const struct pci_dev *pdev, unsigned int reg,
 static int update_entry(struct vpci_msix_entry *entry,
                         const struct pci_dev *pdev, unsigned int nr)
 {
-    int rc = vpci_msix_arch_disable_entry(entry, pdev);
+    int rc;
+
+    /* Try to update an already set up entry in place first. */
+    if ( !vpci_msix_arch_update_entry(entry, pdev) )
+        return 0;
+
+    rc = vpci_msix_arch_disable_entry(entry, pdev);
 
     /* Ignore ENOENT, it means the entry wasn't setup. */
     if ( rc && rc != -ENOENT )
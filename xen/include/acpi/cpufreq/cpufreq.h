@@ -110,6 +110,7 @@ struct cpufreq_governor {
     struct list_head governor_list;
 };
 
+extern bool opt_cpufreq_hwp;
 extern struct cpufreq_governor *cpufreq_opt_governor;
 extern struct cpufreq_governor cpufreq_gov_dbs;
 extern struct cpufreq_governor cpufreq_gov_userspace;
@@ -9,6 +9,8 @@
 
 int powernow_cpufreq_init(void);
 unsigned int powernow_register_driver(void);
+bool hwp_available(void);
+int hwp_register_driver(void);
 unsigned int get_measured_perf(unsigned int cpu, unsigned int flag);
 void cpufreq_residency_update(unsigned int, uint8_t);
 void cpufreq_statistic_update(unsigned int, uint8_t, uint8_t);
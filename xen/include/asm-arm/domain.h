@@ -38,6 +38,8 @@ struct vtimer {
     struct timer timer;
     uint32_t ctl;
     uint64_t cval;
+    /* Software timer armed on behalf of a descheduled vCPU */
+    bool armed;
 };
 
 struct arch_domain
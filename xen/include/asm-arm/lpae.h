@@ -104,6 +104,17 @@ typedef struct __packed {
 #define P2M_PERM_MASK (0x00400000000000C0ULL)
 #define P2M_CLEAR_PERM(pte) ((pte).bits & ~P2M_PERM_MASK)
 
+/*
+ * Number of naturally aligned entries that can share a TLB entry when
+ * they all have the contiguous bit set (4K granule).
+ */
+#define P2M_CONTIG_SHIFT    4
+#define P2M_CONTIG_ENTRIES  (1U << P2M_CONTIG_SHIFT)
+
+/* Software p2m type, ignored by the hardware */
+#define P2M_TYPE_MASK (0x0780000000000000ULL)
+#define P2M_CLEAR_PERM_TYPE(pte) (P2M_CLEAR_PERM(pte) & ~P2M_TYPE_MASK)
+
 /*
  * Walk is the common bits of p2m and pt entries which are needed to
  * simply walk the table (e.g. for debug).
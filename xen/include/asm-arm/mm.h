@@ -108,6 +108,11 @@ struct page_info
   /* Page is Xen heap? */
 #define _PGC_xen_heap     PG_shift(2)
 #define PGC_xen_heap      PG_mask(1, 2)
+#ifdef CONFIG_LLC_COLORING
+/* Page belongs to the LLC colored heap? */
+#define _PGC_colored      PG_shift(3)
+#define PGC_colored       PG_mask(1, 3)
+#endif
 /* ... */
 /* Page is broken? */
 #define _PGC_broken       PG_shift(7)
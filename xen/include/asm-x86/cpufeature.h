@@ -27,6 +27,8 @@
 #define CPUID5_ECX_INTERRUPT_BREAK      0x2
 
 #define CPUID_PM_LEAF                    6
+#define CPUID6_EAX_HWP                   (1u << 7)
+#define CPUID6_EAX_HWP_EPP               (1u << 10)
 #define CPUID6_ECX_APERFMPERF_CAPABILITY 0x1
 
 /* CPUID level 0x00000001.edx */
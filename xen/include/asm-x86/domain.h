@@ -44,6 +44,12 @@ struct mapcache_vcpu {
     /* Shadow of mapcache_domain.epoch. */
     unsigned int shadow_epoch;
 
+    /*
+     * Where to search mapcache_domain.inuse from.  Starts in this vCPU's
+     * share of the entries, to keep vCPUs off each other's bitmap words.
+     */
+    unsigned int cursor;
+
     /* Lock-free per-VCPU hash of recently-used mappings. */
     struct vcpu_maphash_entry {
         unsigned long mfn;
@@ -53,9 +59,8 @@ struct mapcache_vcpu {
 };
 
 struct mapcache_domain {
-    /* The number of array entries, and a cursor into the array. */
+    /* The number of array entries. */
     unsigned int entries;
-    unsigned int cursor;
 
     /* Protects map_domain_page(). */
     spinlock_t lock;
@@ -225,6 +230,7 @@ struct paging_domain {
                 unsigned long done:PADDR_BITS - PAGE_SHIFT;
                 unsigned long i4:PAGETABLE_ORDER;
                 unsigned long i3:PAGETABLE_ORDER;
+                unsigned int ranges;
             } log_dirty;
         };
     } preempt;
@@ -431,6 +437,8 @@ struct arch_domain
         unsigned int inguest_pagefault_disabled                            : 1;
         unsigned int control_register_values                               : 1;
         struct monitor_msr_bitmap *msr_bitmap;
+        struct monitor_mem_access_filter *mem_access_filter;
+        unsigned int nr_mem_access_filters;
         uint64_t write_ctrlreg_mask[4];
     } monitor;
 
@@ -439,6 +447,12 @@ struct arch_domain
 
     /* Emulated devices enabled bitmap. */
     uint32_t emulation_flags;
+
+    /* Trusted not to mount speculative attacks (XEN_X86_SPEC_TRUSTED). */
+    bool spec_trusted;
+
+    /* SCF_* bits to merge into cpuinfo.spec_ctrl_flags when scheduled in. */
+    uint8_t spec_ctrl_flags;
 } __cacheline_aligned;
 
 #ifdef CONFIG_HVM
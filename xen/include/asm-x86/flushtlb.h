@@ -21,6 +21,12 @@ extern u32 tlbflush_clock;
 /* Time at which each CPU's TLB was last flushed. */
 DECLARE_PER_CPU(u32, tlbflush_time);
 
+/*
+ * Bitmap of the PCIDs which may have non-global TLB entries on this CPU, as
+ * maintained by write_ptbase().  PCID 0 is always assumed to be live.
+ */
+DECLARE_PER_CPU(unsigned int, tlb_live_pcids);
+
 /* TLB clock is in use. */
 extern bool tlb_clk_enabled;
 
@@ -62,6 +62,9 @@ struct hvm_ioreq_server {
     struct rangeset        *range[NR_IO_RANGE_TYPES];
     bool                   enabled;
     uint8_t                bufioreq_handling;
+    /* See XEN_DMOP_set_ioreq_server_polling. */
+    bool                   poll_requests;
+    uint32_t               spin_ns;
 };
 
 #ifdef CONFIG_MEM_SHARING
@@ -74,6 +77,13 @@ struct mem_sharing_domain
      * to resume the search.
      */
     unsigned long next_shared_gfn_to_relinquish;
+
+    /*
+     * Pages released by a fork reset.  They remain allocated to (and
+     * accounted against) the fork, and are reused for copying pages from
+     * the parent until the fork is destroyed.
+     */
+    struct page_list_head fork_pool;
 };
 #endif
 
@@ -34,6 +34,12 @@ struct hvm_emulate_ctxt {
     uint8_t insn_buf[16];
     unsigned long insn_buf_eip;
     unsigned int insn_buf_bytes;
+    /*
+     * The bytes past the instruction just emulated may be used for the next
+     * one, when the context emulates multiple instructions in a row.
+     */
+    bool insn_buf_reusable;
+    unsigned long insn_buf_cs_base;
 
     struct segment_register seg_reg[10];
     unsigned long seg_reg_accessed;
@@ -49,6 +55,7 @@ struct hvm_emulate_ctxt {
     uint32_t intr_shadow;
 
     bool is_mem_access;
+    bool is_mem_write;
 
     bool_t set_context;
 };
@@ -126,6 +133,10 @@ bool hvmemul_read_cache(const struct vcpu *, paddr_t gpa,
                         void *buffer, unsigned int size);
 void hvmemul_write_cache(const struct vcpu *, paddr_t gpa,
                          const void *buffer, unsigned int size);
+bool hvmemul_read_walk(struct vcpu *, unsigned long va, uint32_t pfec,
+                       unsigned long *gfn);
+void hvmemul_write_walk(struct vcpu *, unsigned long va, uint32_t pfec,
+                        unsigned long gfn);
 unsigned int hvmemul_cache_disable(struct vcpu *);
 void hvmemul_cache_restore(struct vcpu *, unsigned int token);
 /* For use in ASSERT()s only: */
@@ -139,6 +150,11 @@ static inline bool hvmemul_read_cache(const struct vcpu *v, paddr_t gpa,
                                       unsigned int size) { return false; }
 static inline void hvmemul_write_cache(const struct vcpu *v, paddr_t gpa,
                                        const void *buf, unsigned int size) {}
+static inline bool hvmemul_read_walk(struct vcpu *v, unsigned long va,
+                                     uint32_t pfec,
+                                     unsigned long *gfn) { return false; }
+static inline void hvmemul_write_walk(struct vcpu *v, unsigned long va,
+                                      uint32_t pfec, unsigned long gfn) {}
 #endif
 
 void hvm_dump_emulation_state(const char *loglvl, const char *prefix,
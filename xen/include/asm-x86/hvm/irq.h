@@ -79,6 +79,13 @@ struct hvm_irq {
 
     struct hvm_irq_dpci *dpci;
 
+    /*
+     * Guest vectors (possibly) used by passed through MSIs, allowing EOIs of
+     * other vectors to skip the search for a PIRQ to EOI.  Updated with the
+     * domain's event_lock held, read locklessly.
+     */
+    DECLARE_BITMAP(dpci_msi_gvecs, X86_NR_VECTORS);
+
     /*
      * Number of wires asserting each GSI.
      *
@@ -50,7 +50,7 @@ void hvm_monitor_interrupt(unsigned int vector, unsigned int type,
 bool hvm_monitor_emul_unimplemented(void);
 
 bool hvm_monitor_check_p2m(unsigned long gla, gfn_t gfn, uint32_t pfec,
-                           uint16_t kind);
+                           uint16_t kind, unsigned int bytes);
 
 #endif /* __ASM_X86_HVM_MONITOR_H__ */
 
@@ -91,6 +91,7 @@ extern u32 svm_feature_flags;
 #define cpu_has_svm_vloadsave cpu_has_svm_feature(SVM_FEATURE_VLOADSAVE)
 
 #define SVM_PAUSEFILTER_INIT    4000
+#define SVM_PAUSEFILTER_MAX     0xffffU
 #define SVM_PAUSETHRESH_INIT    1000
 
 /* TSC rate */
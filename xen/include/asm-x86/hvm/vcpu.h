@@ -89,6 +89,14 @@ struct hvm_vcpu_io {
     unsigned long msix_snoop_gpa;
 
     const struct g2m_ioport *g2m_ioport;
+
+    /*
+     * Internal handler which last accepted an access of type @last_type to
+     * @last_addr, tried first by hvm_find_io_handler().
+     */
+    const struct hvm_io_handler *last_handler;
+    uint64_t            last_addr;
+    uint8_t             last_type;
 };
 
 static inline bool hvm_ioreq_needs_completion(const ioreq_t *ioreq)
@@ -169,6 +177,18 @@ struct hvm_vcpu {
     /* Lock and list for virtual platform timers. */
     spinlock_t          tm_lock;
     struct list_head    tm_list;
+    /*
+     * Set whenever a timer on tm_list may have interrupts pending, so that
+     * pt_update_irq() can skip taking the locks on the common empty path.
+     */
+    bool                tm_pending;
+
+    /*
+     * Set from just before picking the ASID for VM entry until the next VM
+     * exit, so that TLB flushes need only IPI pCPUs actually running the
+     * vCPU's guest context (see hap's flush_tlb()).
+     */
+    bool                in_guest;
 
     bool                flag_dr_dirty;
     bool                debug_state_latch;
@@ -59,6 +59,7 @@ enum {
     _HCALL_spin_wait,
     _HCALL_flush,
     _HCALL_flush_ex,
+    _HCALL_flush_gpa,
     _HCALL_ipi,
     _HCALL_ipi_ex,
     _HCALL_nr /* must be last */
@@ -53,6 +53,8 @@ struct ept_data {
     };
     /* Set of PCPUs needing an INVEPT before a VMENTER. */
     cpumask_var_t invalidate;
+    /* A/D bits kept enabled for accessed-bit working set sampling. */
+    bool track_accessed;
 };
 
 #define _VMX_DOMAIN_PML_ENABLED    0
@@ -163,6 +165,9 @@ struct vmx_vcpu {
 
     uint8_t              lbr_flags;
 
+    /* Current Pause-Loop Exiting window, see vmx_ple_window_grow(). */
+    unsigned int         ple_window;
+
     /* Bitmask of segments that we can't safely use in virtual 8086 mode */
     uint16_t             vm86_segment_mask;
     /* Shadow CS, SS, DS, ES, FS, GS, TR while in virtual 8086 mode */
@@ -176,6 +181,8 @@ struct vmx_vcpu {
     struct page_info     *vmwrite_bitmap;
 
     struct page_info     *pml_pg;
+    /* PML buffer allocated, but not yet loaded into the VMCS. */
+    bool                 pml_pending;
 
     /* Bitmask of trapped CR4 bits. */
     unsigned long        cr4_host_mask;
@@ -194,6 +201,8 @@ void vmx_vmcs_enter(struct vcpu *v);
 bool_t __must_check vmx_vmcs_try_enter(struct vcpu *v);
 void vmx_vmcs_exit(struct vcpu *v);
 void vmx_vmcs_reload(struct vcpu *v);
+void vmx_ple_window_grow(struct vcpu *v);
+void vmx_ple_window_reset(struct vcpu *v);
 
 #define CPU_BASED_VIRTUAL_INTR_PENDING        0x00000004
 #define CPU_BASED_USE_TSC_OFFSETING           0x00000008
@@ -663,6 +672,7 @@ DECLARE_PER_CPU(bool_t, vmxon);
 
 bool_t vmx_vcpu_pml_enabled(const struct vcpu *v);
 int vmx_vcpu_enable_pml(struct vcpu *v);
+void vmx_vcpu_load_pml(struct vcpu *v);
 void vmx_vcpu_disable_pml(struct vcpu *v);
 void vmx_vcpu_flush_pml_buffer(struct vcpu *v);
 bool_t vmx_domain_pml_enabled(const struct domain *d);
@@ -78,6 +78,7 @@ typedef enum {
 #define EPTE_AVAIL1_SHIFT       8
 #define EPTE_EMT_SHIFT          3
 #define EPTE_IGMT_SHIFT         6
+#define EPTE_ACCESSED_SHIFT     8
 #define EPTE_RWX_MASK           0x7
 #define EPTE_FLAG_MASK          0x7f
 
@@ -89,6 +89,11 @@ typedef struct HPETState {
     uint64_t hpet_to_ns_scale; /* hpet ticks to ns (multiplied by 2^10) */
     uint64_t hpet_to_ns_limit; /* max hpet ticks convertable to ns      */
     uint64_t mc_offset;
+    /*
+     * Sequence count for lockless reads of the main counter: odd while
+     * config, mc64 or mc_offset are being updated (under the write lock).
+     */
+    unsigned int mc_seq;
     struct periodic_time pt[HPET_TIMER_NUM];
     rwlock_t lock;
 } HPETState;
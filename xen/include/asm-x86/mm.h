@@ -312,8 +312,12 @@ struct page_info
 
 #define PRtype_info "016lx"/* should only be used for printk's */
 
-/* The number of out-of-sync shadows we allow per vcpu (prime, please) */
-#define SHADOW_OOS_PAGES 3
+/*
+ * The number of out-of-sync shadows we allow per vcpu (prime, please).
+ * Each slot costs one snapshot page from the shadow pool, so this wants
+ * to stay well below shadow_min_acceptable_pages()'s per-vcpu share.
+ */
+#define SHADOW_OOS_PAGES 7
 
 /* OOS fixup entries */
 #define SHADOW_OOS_FIXUPS 2
@@ -32,6 +32,12 @@ struct monitor_msr_bitmap {
     DECLARE_BITMAP(high, 8192);
 };
 
+#define MONITOR_MEM_ACCESS_FILTERS 16
+
+struct monitor_mem_access_filter {
+    paddr_t start, end; /* [start, end), within a single page */
+};
+
 static inline
 void arch_monitor_allow_userspace(struct domain *d, bool allow_userspace)
 {
@@ -89,7 +95,8 @@ static inline uint32_t arch_monitor_get_capabilities(struct domain *d)
                     (1U << XEN_DOMCTL_MONITOR_EVENT_DEBUG_EXCEPTION) |
                     (1U << XEN_DOMCTL_MONITOR_EVENT_WRITE_CTRLREG) |
                     (1U << XEN_DOMCTL_MONITOR_EVENT_EMUL_UNIMPLEMENTED) |
-                    (1U << XEN_DOMCTL_MONITOR_EVENT_INGUEST_PAGEFAULT));
+                    (1U << XEN_DOMCTL_MONITOR_EVENT_INGUEST_PAGEFAULT) |
+                    (1U << XEN_DOMCTL_MONITOR_EVENT_MEM_ACCESS_FILTER));
 
     if ( hvm_is_singlestep_supported() )
         capabilities |= (1U << XEN_DOMCTL_MONITOR_EVENT_SINGLESTEP);
@@ -122,5 +129,7 @@ static inline void arch_monitor_cleanup_domain(struct domain *d) {}
 
 bool monitored_msr(const struct domain *d, u32 msr);
 bool monitored_msr_onchangeonly(const struct domain *d, u32 msr);
+bool monitor_mem_access_filtered(const struct domain *d, paddr_t gpa,
+                                 unsigned int size);
 
 #endif /* __ASM_X86_MONITOR_H__ */
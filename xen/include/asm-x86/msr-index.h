@@ -463,6 +463,12 @@
 #define MSR_IA32_TSC_DEADLINE		0x000006E0
 #define MSR_IA32_ENERGY_PERF_BIAS	0x000001b0
 
+/* Hardware P-states (HWP) */
+#define MSR_IA32_PM_ENABLE		0x00000770
+#define MSR_IA32_PM_ENABLE_HWP_ENABLE	(1ULL << 0)
+#define MSR_IA32_HWP_CAPABILITIES	0x00000771
+#define MSR_IA32_HWP_REQUEST		0x00000774
+
 /* Platform Shared Resource MSRs */
 #define MSR_IA32_CMT_EVTSEL		0x00000c8d
 #define MSR_IA32_CMT_EVTSEL_UE_MASK	0x0000ffff
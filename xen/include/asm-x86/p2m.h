@@ -264,6 +264,11 @@ struct p2m_domain {
     void               (*enable_hardware_log_dirty)(struct p2m_domain *p2m);
     void               (*disable_hardware_log_dirty)(struct p2m_domain *p2m);
     void               (*flush_hardware_cached_dirty)(struct p2m_domain *p2m);
+    int                (*track_accessed)(struct p2m_domain *p2m, bool enable);
+    bool               (*test_and_clear_accessed)(struct p2m_domain *p2m,
+                                                  unsigned long gfn,
+                                                  bool clear,
+                                                  unsigned int *page_order);
     void               (*change_entry_type_global)(struct p2m_domain *p2m,
                                                    p2m_type_t ot,
                                                    p2m_type_t nt);
@@ -331,6 +336,9 @@ struct p2m_domain {
                          single;       /* Non-super lists                   */
         long             count,        /* # of pages in cache lists         */
                          entry_count;  /* # of pages in p2m marked pod      */
+        unsigned long    reported;     /* # of pages released through free *
+                                        * page reporting, which may be     *
+                                        * allocated again on demand        */
         gfn_t            reclaim_single; /* Last gfn of a scan */
         gfn_t            max_guest;    /* gfn of max guest demand-populate */
 
@@ -626,6 +634,14 @@ void p2m_disable_hardware_log_dirty(struct domain *d);
 /* Flush hardware cached dirty GFNs */
 void p2m_flush_hardware_cached_dirty(struct domain *d);
 
+/* Turn hardware accessed-bit tracking on or off (domain paused). */
+int p2m_track_accessed(struct domain *d, bool enable);
+
+/* Sample, and optionally clear, the accessed bits of [gfn, gfn + nr). */
+int p2m_get_accessed(struct domain *d, unsigned long gfn, unsigned int nr,
+                     bool clear, unsigned long *bitmap,
+                     unsigned int *nr_accessed);
+
 /* Change types across all p2m entries in a domain */
 void p2m_change_entry_type_global(struct domain *d, 
                                   p2m_type_t ot, p2m_type_t nt);
@@ -639,6 +655,9 @@ void p2m_change_type_range(struct domain *d,
 int p2m_change_type_one(struct domain *d, unsigned long gfn,
                         p2m_type_t ot, p2m_type_t nt);
 
+/* Move the page backing a gfn onto another NUMA node */
+int p2m_migrate_gfn(struct domain *d, gfn_t gfn, nodeid_t node);
+
 /* Synchronously change the p2m type for a range of gfns */
 int p2m_finish_type_change(struct domain *d,
                            gfn_t first_gfn,
@@ -247,6 +247,7 @@ typedef struct { u64 pfn; } pagetable_t;
 
 void clear_page_sse2(void *);
 void copy_page_sse2(void *, const void *);
+bool page_is_zero(const void *);
 
 #define clear_page(_p)      clear_page_sse2(_p)
 #define copy_page(_t, _f)   copy_page_sse2(_t, _f)
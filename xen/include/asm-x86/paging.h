@@ -154,10 +154,14 @@ struct paging_mode {
 
 #if PG_log_dirty
 
-/* get the dirty bitmap for a specific range of pfns */
+/*
+ * get the dirty bitmap for a specific range of pfns, given the bitmap of
+ * those which have been written (and so made writable) since the last call
+ */
 void paging_log_dirty_range(struct domain *d,
                             unsigned long begin_pfn,
                             unsigned long nr,
+                            const unsigned long *written,
                             uint8_t *dirty_bitmap);
 
 /* enable log dirty */
@@ -198,6 +202,8 @@ int paging_mfn_is_dirty(struct domain *d, mfn_t gmfn);
 struct sh_dirty_vram {
     unsigned long begin_pfn;
     unsigned long end_pfn;
+    /* HAP: frames in the range written since the last query. */
+    unsigned long *hap_written;
 #ifdef CONFIG_SHADOW_PAGING
     paddr_t *sl1ma;
     uint8_t *dirty_bitmap;
@@ -24,6 +24,10 @@
 #define SCF_use_shadow (1 << 0)
 #define SCF_ist_wrmsr  (1 << 1)
 #define SCF_ist_rsb    (1 << 2)
+#define SCF_no_verw    (1 << 3)
+
+/* cpuinfo.spec_ctrl_flags bits which are controlled per domain. */
+#define SCF_DOM_MASK   SCF_no_verw
 
 #ifndef __ASSEMBLY__
 
@@ -31,7 +35,10 @@
 #include <asm/current.h>
 #include <asm/msr-index.h>
 
+struct domain;
+
 void init_speculation_mitigations(void);
+void spec_ctrl_init_domain(struct domain *d);
 
 extern bool opt_ibpb;
 extern bool opt_ssbd;
@@ -45,6 +52,8 @@ extern uint8_t default_spec_ctrl_flags;
 
 extern int8_t opt_xpti_hwdom, opt_xpti_domu;
 
+extern bool opt_trusted_hwdom;
+
 extern int8_t opt_pv_l1tf_hwdom, opt_pv_l1tf_domu;
 
 /*
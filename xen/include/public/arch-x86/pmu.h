@@ -90,6 +90,7 @@ DEFINE_XEN_GUEST_HANDLE(xen_pmu_regs_t);
 #define PMU_SAMPLE_USER    (1<<1) /* Sample is from user or kernel mode */
 #define PMU_SAMPLE_REAL    (1<<2) /* Sample is from realmode */
 #define PMU_SAMPLE_PV      (1<<3) /* Sample from a PV guest */
+#define PMU_SAMPLE_CALLCHAIN (1<<4) /* Hypervisor call chain is present */
 
 /*
  * Architecture-specific information describing state of the processor at
@@ -304,6 +304,18 @@ struct xen_arch_domainconfig {
                                      XEN_X86_EMU_PIT | XEN_X86_EMU_USE_PIRQ |\
                                      XEN_X86_EMU_VPCI)
     uint32_t emulation_flags;
+
+/*
+ * The domain is trusted not to mount speculative sidechannel attacks against
+ * Xen or other domains.  Xen may then omit the flushing which is otherwise
+ * performed on its behalf (VERW on exit to the domain, IBPB after it has run,
+ * and the L1D flush on VMEntry).
+ */
+#define _XEN_X86_SPEC_TRUSTED       0
+#define XEN_X86_SPEC_TRUSTED        (1U<<_XEN_X86_SPEC_TRUSTED)
+
+#define XEN_X86_MISC_FLAGS_ALL      XEN_X86_SPEC_TRUSTED
+    uint32_t misc_flags;
 };
 
 /* Location of online VCPU bitmap. */
@@ -38,7 +38,7 @@
 #include "hvm/save.h"
 #include "memory.h"
 
-#define XEN_DOMCTL_INTERFACE_VERSION 0x00000013
+#define XEN_DOMCTL_INTERFACE_VERSION 0x00000014
 
 /*
  * NB. xen_domctl.domain is an IN/OUT parameter for this operation.
@@ -239,12 +239,25 @@ struct xen_domctl_getpageframeinfo3 {
   * writably by the hypervisor in the dirty bitmap.
   */
 #define XEN_DOMCTL_SHADOW_LOGDIRTY_FINAL   (1 << 0)
+ /*
+  * Report dirty pages as a list of ranges in dirty_ranges, rather than as a
+  * bitmap.  If the list fills up, pages is updated to the pfn at which the
+  * scan stopped, and (for CLEAN) everything from there on is left dirty.
+  */
+#define XEN_DOMCTL_SHADOW_LOGDIRTY_RANGES  (1 << 1)
 
 struct xen_domctl_shadow_op_stats {
     uint32_t fault_count;
     uint32_t dirty_count;
 };
 
+struct xen_domctl_shadow_op_range {
+    uint64_aligned_t start; /* First dirty pfn. */
+    uint64_aligned_t nr;    /* Number of consecutive dirty pfns. */
+};
+typedef struct xen_domctl_shadow_op_range xen_domctl_shadow_op_range_t;
+DEFINE_XEN_GUEST_HANDLE(xen_domctl_shadow_op_range_t);
+
 struct xen_domctl_shadow_op {
     /* IN variables. */
     uint32_t       op;       /* XEN_DOMCTL_SHADOW_OP_* */
@@ -260,6 +273,11 @@ struct xen_domctl_shadow_op {
     XEN_GUEST_HANDLE_64(uint8) dirty_bitmap;
     uint64_aligned_t pages; /* Size of buffer. Updated with actual size. */
     struct xen_domctl_shadow_op_stats stats;
+
+    /* OP_PEEK / OP_CLEAN with XEN_DOMCTL_SHADOW_LOGDIRTY_RANGES */
+    XEN_GUEST_HANDLE_64(xen_domctl_shadow_op_range_t) dirty_ranges;
+    uint32_t nr_ranges;     /* Size of dirty_ranges.  Updated with entries used. */
+    uint32_t pad;
 };
 
 
@@ -366,6 +384,13 @@ struct xen_domctl_sched_credit {
 struct xen_domctl_sched_credit2 {
     uint16_t weight;
     uint16_t cap;
+/*
+ * Latency sensitive: the domain's vCPUs are run ahead of others when they
+ * wake up, as long as they haven't exhausted their credit.
+ */
+#define _XEN_DOMCTL_SCHED_CREDIT2_latency 0
+#define XEN_DOMCTL_SCHED_CREDIT2_latency  (1U<<_XEN_DOMCTL_SCHED_CREDIT2_latency)
+    uint32_t flags;
 };
 
 struct xen_domctl_sched_rtds {
@@ -852,6 +877,12 @@ struct xen_domctl_vm_event_op {
     union {
         struct {
             uint32_t port;       /* OUT: event channel for ring */
+            /*
+             * IN: number of contiguous frames, starting at the ring GFN, the
+             * ring occupies.  0 is treated as 1.
+             */
+            uint32_t nr_frames;
+#define XEN_VM_EVENT_RING_FRAMES_MAX 8
         } enable;
 
         uint32_t version;
@@ -1042,6 +1073,15 @@ struct xen_domctl_psr_cmt_op {
 #define XEN_DOMCTL_MONITOR_EVENT_EMUL_UNIMPLEMENTED    10
 /* Enabled by default */
 #define XEN_DOMCTL_MONITOR_EVENT_INGUEST_PAGEFAULT     11
+/*
+ * Sub-page filtering of mem_access events: ENABLE adds the range described
+ * by u.mem_access_filter, DISABLE removes it again (or all ranges if size is
+ * 0).  Once a page has at least one range, mem_access violations on this page
+ * which don't touch any of its ranges are resolved by emulating the access in
+ * Xen, rather than being sent to the monitor.  Pages without ranges are not
+ * affected.
+ */
+#define XEN_DOMCTL_MONITOR_EVENT_MEM_ACCESS_FILTER     12
 
 struct xen_domctl_monitor_op {
     uint32_t op; /* XEN_DOMCTL_MONITOR_OP_* */
@@ -1092,6 +1132,12 @@ struct xen_domctl_monitor_op {
             /* Pause vCPU until response */
             uint8_t sync;
         } debug_exception;
+
+        struct {
+            uint64_aligned_t gpa;   /* Start of the range */
+            uint32_t size;          /* Must not cross a page boundary */
+            uint32_t pad;
+        } mem_access_filter;
     } u;
 };
 
@@ -1132,6 +1178,74 @@ struct xen_domctl_vuart_op {
                                  */
 };
 
+/*
+ * XEN_DOMCTL_numa_migrate (x86 HVM only)
+ *
+ * Move the RAM backing the gfn range [first_gfn, first_gfn + nr_gfns) onto
+ * NUMA node @node, one 4k page at a time.  Pages which are already on
+ * @node, are not plain writable RAM, or are referenced by anything but the
+ * guest itself (grant or foreign mappings, page tables, ...) are skipped.
+ * The guest is paused while its pages are being copied.
+ *
+ * On return first_gfn and nr_gfns describe the range not processed yet
+ * (nr_gfns is 0 on success), and nr_migrated has been increased by the
+ * number of pages actually moved.  Not supported for domains with an IOMMU
+ * context, altp2m or nested virt.
+ */
+struct xen_domctl_numa_migrate {
+    uint64_aligned_t first_gfn;     /* IN/OUT */
+    uint64_aligned_t nr_gfns;       /* IN/OUT */
+    uint64_aligned_t nr_migrated;   /* IN/OUT */
+    uint32_t node;                  /* IN */
+    uint32_t pad;
+};
+
+/*
+ * XEN_DOMCTL_accessed_op (x86 HVM with EPT A/D bit support only)
+ *
+ * Working set estimation from the hardware accessed bits of the guest's
+ * p2m.  ENABLE turns on hardware A/D bit updates for the domain's EPT (the
+ * guest is briefly paused), DISABLE turns them off again.
+ *
+ * SCAN reports the accessed state of the gfn range [first_gfn, first_gfn +
+ * nr_gfns): bit i of @bitmap (if not null) is set if gfn first_gfn + i was
+ * accessed, and nr_accessed is increased by the number of such gfns.  With
+ * XEN_DOMCTL_ACCESSED_CLEAR the bits are cleared as well, so that the next
+ * SCAN reports accesses since this one.  Entries start out with the bit set,
+ * hence an initial clearing SCAN after ENABLE.  Accessed bits are tracked per
+ * p2m entry, so all gfns of a superpage mapping are reported together.
+ *
+ * @done must be 0 (or a multiple of 8) on entry and is the number of gfns
+ * processed on return.  Not supported for domains using altp2m or sharing
+ * the EPT with the IOMMU.
+ */
+struct xen_domctl_accessed_op {
+    uint32_t op;                    /* IN: XEN_DOMCTL_ACCESSED_OP_* */
+#define XEN_DOMCTL_ACCESSED_OP_ENABLE   0
+#define XEN_DOMCTL_ACCESSED_OP_DISABLE  1
+#define XEN_DOMCTL_ACCESSED_OP_SCAN     2
+    uint32_t flags;                 /* IN: XEN_DOMCTL_ACCESSED_* */
+#define XEN_DOMCTL_ACCESSED_CLEAR       (1U << 0)
+    uint64_aligned_t first_gfn;     /* IN */
+    uint64_aligned_t nr_gfns;       /* IN */
+    uint64_aligned_t done;          /* IN/OUT */
+    uint64_aligned_t nr_accessed;   /* IN/OUT */
+    XEN_GUEST_HANDLE_64(uint8) bitmap; /* OUT: one bit per gfn */
+};
+
+/*
+ * XEN_DOMCTL_set_llc_colors (Arm, with LLC coloring enabled)
+ *
+ * Restrict the domain's memory to pages of the given last level cache
+ * colors.  Must be issued before any memory is allocated to the domain.
+ * Without it a domain may use all colors.
+ */
+struct xen_domctl_set_llc_colors {
+    uint32_t num_llc_colors;        /* IN: number of entries in llc_colors */
+    uint32_t pad;
+    XEN_GUEST_HANDLE_64(uint32) llc_colors; /* IN: distinct color indices */
+};
+
 struct xen_domctl {
     uint32_t cmd;
 #define XEN_DOMCTL_createdomain                   1
@@ -1216,6 +1330,9 @@ struct xen_domctl {
 #define XEN_DOMCTL_vuart_op                      81
 #define XEN_DOMCTL_get_cpu_policy                82
 #define XEN_DOMCTL_set_cpu_policy                83
+#define XEN_DOMCTL_numa_migrate                  84
+#define XEN_DOMCTL_accessed_op                   85
+#define XEN_DOMCTL_set_llc_colors                86
 #define XEN_DOMCTL_gdbsx_guestmemio            1000
 #define XEN_DOMCTL_gdbsx_pausevcpu             1001
 #define XEN_DOMCTL_gdbsx_unpausevcpu           1002
@@ -1276,6 +1393,9 @@ struct xen_domctl {
         struct xen_domctl_monitor_op        monitor_op;
         struct xen_domctl_psr_alloc         psr_alloc;
         struct xen_domctl_vuart_op          vuart_op;
+        struct xen_domctl_numa_migrate      numa_migrate;
+        struct xen_domctl_accessed_op       accessed_op;
+        struct xen_domctl_set_llc_colors    set_llc_colors;
         uint8_t                             pad[128];
     } u;
 };
@@ -77,6 +77,10 @@
 #ifdef __XEN__
 #define EVTCHNOP_reset_cont      14
 #endif
+#define EVTCHNOP_batch           15
+#ifdef __XEN__
+#define EVTCHNOP_batch_cont      16
+#endif
 /* ` } */
 
 typedef uint32_t evtchn_port_t;
@@ -315,6 +319,32 @@ struct evtchn_set_priority {
 };
 typedef struct evtchn_set_priority evtchn_set_priority_t;
 
+/*
+ * EVTCHNOP_batch: Perform <op> on each of the <nr> local ports in <ports>,
+ * in order, with a single hypercall.  This is meant for backends which need
+ * to notify, or re-enable, many channels at a time.
+ *
+ * <op> may be EVTCHNOP_send or EVTCHNOP_unmask; the semantics for each port
+ * are the same as those of the respective individual operation.  Processing
+ * stops at the first port for which the operation fails, its error being
+ * returned.  In all cases <done> is set to the number of ports which were
+ * successfully processed.
+ *
+ * Guests should fall back to individual operations if this one isn't
+ * supported (-ENOSYS or -EOPNOTSUPP).
+ */
+struct evtchn_batch {
+    /* IN parameters. */
+    uint32_t op;
+    uint32_t nr;
+    /* OUT parameters. */
+    uint32_t done;
+    /* IN parameters. */
+    evtchn_port_t ports[XEN_FLEX_ARRAY_DIM];
+};
+typedef struct evtchn_batch evtchn_batch_t;
+DEFINE_XEN_GUEST_HANDLE(evtchn_batch_t);
+
 /*
  * ` enum neg_errnoval
  * ` HYPERVISOR_event_channel_op_compat(struct evtchn_op *op)
@@ -434,6 +434,36 @@ struct xen_dm_op_pin_memory_cacheattr {
 };
 typedef struct xen_dm_op_pin_memory_cacheattr xen_dm_op_pin_memory_cacheattr_t;
 
+/*
+ * XEN_DMOP_set_ioreq_server_polling : Choose how IOREQ Server <id> and the
+ *                                     target's vCPUs wait for each other.
+ *
+ * With XEN_DMOP_IOREQ_POLL_REQUESTS set the emulator is expected to poll the
+ * synchronous ioreq structures and buffered ioreq ring (e.g. from a thread
+ * on a dedicated core), and Xen no longer sends event channel notifications
+ * for new requests.  An emulator clearing the flag again must rescan all
+ * ioreq structures and the ring afterwards.
+ *
+ * A non-zero <spin_ns> makes a vCPU which has issued a synchronous request
+ * spin for up to that long (capped at 100us) waiting for the response,
+ * before blocking.  The emulator still has to notify the vCPU's event
+ * channel after each response, as usual.
+ */
+#define XEN_DMOP_set_ioreq_server_polling 19
+
+struct xen_dm_op_set_ioreq_server_polling {
+    /* IN - server id */
+    ioservid_t id;
+    uint16_t pad;
+    /* IN - XEN_DMOP_IOREQ_POLL_* */
+    uint32_t flags;
+#define XEN_DMOP_IOREQ_POLL_REQUESTS (1u << 0)
+    /* IN - how long a vCPU spins for a response, in ns */
+    uint32_t spin_ns;
+    uint32_t pad2;
+};
+typedef struct xen_dm_op_set_ioreq_server_polling xen_dm_op_set_ioreq_server_polling_t;
+
 struct xen_dm_op {
     uint32_t op;
     uint32_t pad;
@@ -456,6 +486,7 @@ struct xen_dm_op {
         xen_dm_op_remote_shutdown_t remote_shutdown;
         xen_dm_op_relocate_memory_t relocate_memory;
         xen_dm_op_pin_memory_cacheattr_t pin_memory_cacheattr;
+        xen_dm_op_set_ioreq_server_polling_t set_ioreq_server_polling;
     } u;
 };
 
@@ -39,6 +39,19 @@
 #define XENMEM_decrease_reservation 1
 #define XENMEM_populate_physmap     6
 
+/*
+ * Report the specified extents of guest memory as free (i.e. of no further
+ * interest to the guest), allowing Xen to reclaim the backing pages right
+ * away.  The gfns stay valid: a later access is satisfied with a zeroed page,
+ * as long as the domain is still within its memory allowance and the host
+ * has memory available.  Pages which are not plain RAM, or are in use by
+ * anything other than the guest (grant or foreign mappings, ...), are left
+ * alone.  Only for HVM guests without passthrough devices.
+ * Returns the number of extents processed.
+ * arg == addr of struct xen_memory_reservation (mem_flags must be 0).
+ */
+#define XENMEM_report_free_pages    29
+
 #if __XEN_INTERFACE_VERSION__ >= 0x00030209
 /*
  * Maximum # bits addressable by the user of the allocated region (e.g., I/O
@@ -67,6 +80,8 @@ struct xen_memory_reservation {
      *   OUT: MFN (*not* GMFN) bases of extents that were allocated
      * XENMEM_decrease_reservation:
      *   IN:  GMFN bases of extents to free
+     * XENMEM_report_free_pages:
+     *   IN:  GPFN bases of extents reported free
      * XENMEM_populate_physmap:
      *   IN:  GPFN bases of extents to populate with memory
      *   OUT: GMFN bases of extents that were allocated
@@ -625,6 +640,7 @@ struct xen_mem_acquire_resource {
 
 #define XENMEM_resource_ioreq_server 0
 #define XENMEM_resource_grant_table 1
+#define XENMEM_resource_vcpu_runstate 2
 
     /*
      * IN - a type-specific resource identifier, which must be zero
@@ -632,6 +648,7 @@ struct xen_mem_acquire_resource {
      *
      * type == XENMEM_resource_ioreq_server -> id == ioreq server id
      * type == XENMEM_resource_grant_table -> id defined below
+     * type == XENMEM_resource_vcpu_runstate -> id == 0
      */
     uint32_t id;
 
@@ -671,6 +688,28 @@ struct xen_mem_acquire_resource {
 typedef struct xen_mem_acquire_resource xen_mem_acquire_resource_t;
 DEFINE_XEN_GUEST_HANDLE(xen_mem_acquire_resource_t);
 
+#if defined(__XEN__) || defined(__XEN_TOOLS__)
+/*
+ * The frames of XENMEM_resource_vcpu_runstate are a read-only array of
+ * the entries below, indexed by vCPU id, which Xen keeps up to date on
+ * every runstate change of the domain's vCPUs.  This lets tools monitor
+ * the vCPUs of many domains without issuing hypercalls.
+ *
+ * time[] accumulates up to state_entry_time; the time spent in the current
+ * state so far is to be added by the reader.  While an entry is being
+ * updated, XEN_RUNSTATE_UPDATE is set in state_entry_time: readers have to
+ * retry when they find it set, or when state_entry_time changed while they
+ * were reading the rest of the entry.
+ */
+struct xen_mem_vcpu_runstate {
+    uint32_t state;             /* RUNSTATE_* */
+    uint32_t pad;
+    uint64_aligned_t state_entry_time;
+    uint64_aligned_t time[4];
+};
+typedef struct xen_mem_vcpu_runstate xen_mem_vcpu_runstate_t;
+#endif /* defined(__XEN__) || defined(__XEN_TOOLS__) */
+
 /*
  * XENMEM_get_vnumainfo used by guest to get
  * vNUMA topology from hypervisor.
@@ -720,7 +759,7 @@ struct xen_vnuma_topology_info {
 typedef struct xen_vnuma_topology_info xen_vnuma_topology_info_t;
 DEFINE_XEN_GUEST_HANDLE(xen_vnuma_topology_info_t);
 
-/* Next available subop number is 29 */
+/* Next available subop number is 30 */
 
 #endif /* __XEN_PUBLIC_MEMORY_H__ */
 
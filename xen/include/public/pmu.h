@@ -93,10 +93,13 @@ DEFINE_XEN_GUEST_HANDLE(xen_pmu_params_t);
  *                              Architectural Performance Events exposed by
  *                              cpuid and listed in the Intel developer's manual
  *                              (ignored on AMD).
+ * - XENPMU_FEATURE_XEN_CALLCHAIN: Record the hypervisor's call chain when
+ *                              it is sampled (see struct xen_pmu_callchain).
  */
 #define XENPMU_FEATURE_INTEL_BTS  (1<<0)
 #define XENPMU_FEATURE_IPC_ONLY   (1<<1)
 #define XENPMU_FEATURE_ARCH_ONLY  (1<<2)
+#define XENPMU_FEATURE_XEN_CALLCHAIN (1<<3)
 
 /*
  * Shared PMU data between hypervisor and PV(H) domains.
@@ -130,6 +133,25 @@ struct xen_pmu_data {
     xen_pmu_arch_t pmu;
 };
 
+/*
+ * Call chain of the hypervisor at the time of the interrupt, valid when the
+ * sample is for DOMID_XEN and PMU_SAMPLE_CALLCHAIN is set in pmu_flags.
+ * Its layout matches the one of Linux's struct perf_callchain_entry: ip[0]
+ * is the interrupted instruction, followed by up to XENPMU_CALLCHAIN_MAX - 1
+ * return addresses, innermost first.
+ *
+ * It is located at offset XENPMU_CALLCHAIN_OFFSET of the page registered
+ * with XENPMU_init, i.e. at its very end.
+ * RO for guests.
+ */
+#define XENPMU_CALLCHAIN_MAX      32
+struct xen_pmu_callchain {
+    uint64_t nr;
+    uint64_t ip[XENPMU_CALLCHAIN_MAX];
+};
+typedef struct xen_pmu_callchain xen_pmu_callchain_t;
+#define XENPMU_CALLCHAIN_OFFSET   (4096 - sizeof(struct xen_pmu_callchain))
+
 #endif /* __XEN_PUBLIC_PMU_H__ */
 
 /*
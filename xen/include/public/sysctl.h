@@ -35,7 +35,7 @@
 #include "domctl.h"
 #include "physdev.h"
 
-#define XEN_SYSCTL_INTERFACE_VERSION 0x00000013
+#define XEN_SYSCTL_INTERFACE_VERSION 0x00000014
 
 /*
  * Read console content from Xen buffer ring.
@@ -164,6 +164,12 @@ struct xen_sysctl_getdomaininfolist {
     XEN_GUEST_HANDLE_64(xen_domctl_getdomaininfo_t) buffer;
     /* OUT variables. */
     uint32_t              num_domains;
+    /*
+     * Incremented whenever a domain is created or destroyed.  Monitoring
+     * tools may use an unchanged value to skip refreshing any per-domain
+     * data they cache (names, device lists, ...) besides the info itself.
+     */
+    uint32_t              generation;
 };
 
 /* Inject debug keys into Xen. */
@@ -551,15 +557,17 @@ struct xen_sysctl_numainfo {
 #define XEN_SYSCTL_CPUPOOL_OP_RMCPU                 5  /* R */
 #define XEN_SYSCTL_CPUPOOL_OP_MOVEDOMAIN            6  /* M */
 #define XEN_SYSCTL_CPUPOOL_OP_FREEINFO              7  /* F */
+#define XEN_SYSCTL_CPUPOOL_OP_MOVEDOMAINS           8  /* B */
 #define XEN_SYSCTL_CPUPOOL_PAR_ANY     0xFFFFFFFF
 struct xen_sysctl_cpupool_op {
     uint32_t op;          /* IN */
-    uint32_t cpupool_id;  /* IN: CDIARM OUT: CI */
-    uint32_t sched_id;    /* IN: C      OUT: I  */
-    uint32_t domid;       /* IN: M              */
-    uint32_t cpu;         /* IN: AR             */
-    uint32_t n_dom;       /*            OUT: I  */
-    struct xenctl_bitmap cpumap; /*     OUT: IF */
+    uint32_t cpupool_id;  /* IN: CDIARMB OUT: CI */
+    uint32_t sched_id;    /* IN: C       OUT: I  */
+    uint32_t domid;       /* IN: M               */
+    uint32_t cpu;         /* IN: AR              */
+    uint32_t n_dom;       /* IN: B       OUT: I  */
+    struct xenctl_bitmap cpumap; /*      OUT: IF */
+    XEN_GUEST_HANDLE_64(uint16) domids; /* IN: B */
 };
 
 /*
@@ -594,6 +602,14 @@ struct xen_sysctl_cpupool_op {
  * -ENOENT:
  *  all: The cpupool with the specified cpupool_id doesn't exist.
  *
+ * XEN_SYSCTL_CPUPOOL_OP_MOVEDOMAINS moves the n_dom domains listed in
+ * domids to the cpupool, like XEN_SYSCTL_CPUPOOL_OP_MOVEDOMAIN would for
+ * each of them.  Domains already in the cpupool are skipped, so the
+ * operation can simply be repeated when it fails with:
+ * -EAGAIN:
+ *  B: The operation was preempted, with part of the domains moved.
+ * On other errors, some of the domains may have been moved as well.
+ *
  * Some common error return values like -ENOMEM and -EFAULT are possible for
  * all the operations.
  */
@@ -610,6 +626,13 @@ struct xen_sysctl_arinc653_schedule {
     /* num_sched_entries holds how many of the entries in the
      * sched_entries[] array are valid. */
     uint8_t     num_sched_entries;
+    /* If XEN_ARINC653_SCHED_CPU is set in flags, the schedule is the one
+     * of physical CPU cpu only.  Otherwise it is the schedule installed
+     * on all physical CPUs of the cpupool. */
+#define _XEN_ARINC653_SCHED_CPU 0
+#define XEN_ARINC653_SCHED_CPU  (1U << _XEN_ARINC653_SCHED_CPU)
+    uint8_t     flags;
+    uint32_t    cpu;
     /* The sched_entries array holds the actual schedule entries. */
     struct {
         /* dom_handle must match a domain's UUID */
@@ -185,6 +185,21 @@ static bool evtchn_usable(const struct evtchn *evtchn)
 
 void evtchn_check_pollers(struct domain *d, unsigned int port);
 
+/* Most ports SCHEDOP_poll accepts at once. */
+#define EVTCHN_POLL_MAX_PORTS 128
+
+/*
+ * Register current as polling @nr @ports (which must be v->poll_ports if
+ * more than one) and mark it in d->poll_mask.  Whoever then clears the
+ * vcpu's bit in d->poll_mask drops the registration.
+ */
+void evtchn_poll_register(struct vcpu *v, const evtchn_port_t *ports,
+                          unsigned int nr);
+/* Drop @v's registration, or wait for whoever is dropping it to finish. */
+void evtchn_poll_release(struct vcpu *v);
+/* Clear @v from d->poll_mask, returning whether it was there to clear. */
+bool evtchn_poll_clear(struct vcpu *v);
+
 /* Close all event channels and reset to 2-level ABI. */
 int evtchn_reset(struct domain *d, bool resuming);
 
@@ -126,6 +126,10 @@ void arch_iommu_hwdom_init(struct domain *d);
 #define IOMMUF_readable  (1u<<_IOMMUF_readable)
 #define _IOMMUF_writable 1
 #define IOMMUF_writable  (1u<<_IOMMUF_writable)
+/* Order of the mapping requested from map_page(); only passed, not looked up. */
+#define _IOMMUF_order    16
+#define IOMMUF_order(n)  ((n) << _IOMMUF_order)
+#define IOMMUF_order_of(f) ((f) >> _IOMMUF_order)
 
 /*
  * flush_flags:
@@ -261,6 +265,11 @@ struct iommu_ops {
                                    unsigned int *flush_flags);
     int __must_check (*lookup_page)(struct domain *d, dfn_t dfn, mfn_t *mfn,
                                     unsigned int *flags);
+    /*
+     * Bitmap of the mapping sizes map_page() accepts an IOMMUF_order() for.
+     * 4k is always supported and need not be set.
+     */
+    unsigned long page_sizes;
 
 #ifdef CONFIG_X86
     int (*enable_x2apic)(void);
@@ -136,14 +136,30 @@ struct pirq {
 };
 
 #define INVALID_PIRQ (-1)
+
+/*
+ * The pirq tree is modified under the domain's event_lock, but may be
+ * looked up either with that held or in an RCU read section on
+ * pirq_rcu_lock: radix tree nodes and struct pirq are both freed only after
+ * a grace period.  Lock-free readers must cope with the pirq being
+ * (un)bound under their feet, e.g. by revalidating its irq under the
+ * descriptor lock, as pirq_spin_lock_irq_desc() does.
+ */
+extern rcu_read_lock_t pirq_rcu_lock;
+
 #define pirq_info(d, p) ((struct pirq *)radix_tree_lookup(&(d)->pirq_tree, p))
 
 /* Use this instead of pirq_info() if the structure may need allocating. */
 extern struct pirq *pirq_get_info(struct domain *, int pirq);
 
 #define pirq_field(d, p, f, def) ({ \
-    const struct pirq *__pi = pirq_info(d, p); \
-    __pi ? __pi->f : def; \
+    struct pirq *__pi; \
+    typeof(__pi->f) __v; \
+    rcu_read_lock(&pirq_rcu_lock); \
+    __pi = pirq_info(d, p); \
+    __v = __pi ? __pi->f : (def); \
+    rcu_read_unlock(&pirq_rcu_lock); \
+    __v; \
 })
 #define pirq_to_evtchn(d, pirq) pirq_field(d, pirq, evtchn, 0)
 #define pirq_masked(d, pirq) pirq_field(d, pirq, masked, 0)
@@ -0,0 +1,73 @@
+/*
+ * Last Level Cache (LLC) coloring support.
+ *
+ * A page's color is the set of LLC sets its contents can be cached in,
+ * i.e. the bits of its frame number below the LLC way size: with a way
+ * size of W bytes there are W / PAGE_SIZE colors.  Giving domains
+ * disjoint colors partitions the LLC between them.
+ *
+ * Direct-mapped domains (the Arm hardware domain) need physically contiguous
+ * memory and so are never colored.
+ */
+#ifndef __XEN_LLC_COLORING_H__
+#define __XEN_LLC_COLORING_H__
+
+#include <xen/errno.h>
+#include <xen/types.h>
+
+struct domain;
+struct page_info;
+struct xen_domctl_set_llc_colors;
+
+#ifdef CONFIG_LLC_COLORING
+
+#define NR_LLC_COLORS (1U << CONFIG_LLC_COLORS_ORDER)
+
+extern bool llc_coloring_enabled;
+
+void llc_coloring_init(void);
+void dump_llc_coloring_info(void);
+
+unsigned int get_max_nr_llc_colors(void);
+unsigned int page_to_llc_color(const struct page_info *pg);
+
+void domain_llc_coloring_init(struct domain *d);
+void domain_llc_coloring_free(struct domain *d);
+void domain_dump_llc_colors(const struct domain *d);
+
+int domain_set_llc_colors(struct domain *d,
+                          const struct xen_domctl_set_llc_colors *config);
+int domain_set_llc_colors_from_str(struct domain *d, const char *str);
+
+/* Arch hook: the LLC way size in bytes, or 0 if it can't be found. */
+unsigned int get_llc_way_size(void);
+
+#else
+
+#define llc_coloring_enabled false
+
+static inline void llc_coloring_init(void) {}
+static inline void dump_llc_coloring_info(void) {}
+static inline void domain_llc_coloring_init(struct domain *d) {}
+static inline void domain_llc_coloring_free(struct domain *d) {}
+static inline void domain_dump_llc_colors(const struct domain *d) {}
+
+static inline int domain_set_llc_colors_from_str(struct domain *d,
+                                                 const char *str)
+{
+    return -EOPNOTSUPP;
+}
+
+#endif /* CONFIG_LLC_COLORING */
+
+#endif /* __XEN_LLC_COLORING_H__ */
+
+/*
+ * Local variables:
+ * mode: C
+ * c-file-style: "BSD"
+ * c-basic-offset: 4
+ * tab-width: 4
+ * indent-tabs-mode: nil
+ * End:
+ */
@@ -32,6 +32,13 @@ unsigned long
 p2m_pod_decrease_reservation(struct domain *d, gfn_t gfn,
                              unsigned int order);
 
+/*
+ * Release the pages backing a guest-reported free range, turning the range
+ * into PoD entries.  Returns the number of pages released, or a negative
+ * errno value if the domain does not support it.
+ */
+long p2m_pod_report_free(struct domain *d, gfn_t gfn, unsigned int order);
+
 int __must_check check_get_page_from_gfn(struct domain *d, gfn_t gfn,
                                          bool readonly, p2m_type_t *p2mt_p,
                                          struct page_info **page_p);
@@ -22,6 +22,7 @@ PERFCOUNTER(schedule,               "sched: specific scheduler")
 PERFCOUNTER(dom_init,               "sched: dom_init")
 PERFCOUNTER(dom_destroy,            "sched: dom_destroy")
 PERFCOUNTER(vcpu_yield,             "sched: vcpu_yield")
+PERFCOUNTER(vcpu_yield_to,          "sched: vcpu_yield_to")
 PERFCOUNTER(unit_alloc,             "sched: unit_alloc")
 PERFCOUNTER(unit_insert,            "sched: unit_insert")
 PERFCOUNTER(unit_remove,            "sched: unit_remove")
@@ -67,6 +68,7 @@ PERFCOUNTER(upd_max_weight_full,    "csched2: update_max_weight_full")
 PERFCOUNTER(migrate_requested,      "csched2: migrate_requested")
 PERFCOUNTER(migrate_on_runq,        "csched2: migrate_on_runq")
 PERFCOUNTER(migrate_no_runq,        "csched2: migrate_no_runq")
+PERFCOUNTER(migrate_stolen,         "csched2: migrate_stolen")
 PERFCOUNTER(runtime_min_timer,      "csched2: runtime_min_timer")
 PERFCOUNTER(runtime_max_timer,      "csched2: runtime_max_timer")
 PERFCOUNTER(pick_resource,          "csched2: pick_resource")
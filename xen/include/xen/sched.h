@@ -217,9 +217,14 @@ struct vcpu
     /*
      * > 0: a single port is being polled;
      * = 0: nothing is being polled (vcpu should be clear in d->poll_mask);
-     * < 0: multiple ports may be being polled.
+     * < 0: the nr_poll_ports ports in poll_ports are being polled, or any
+     *      port if nr_poll_ports is 0.
+     * Only transitions to 0 once the poller's registration has been
+     * dropped, see evtchn_poll_release().
      */
     int              poll_evtchn;
+    unsigned int     nr_poll_ports;
+    evtchn_port_t   *poll_ports;
 
     /* (over-)protected by ->domain->event_lock */
     int              pirq_evtchn_head;
@@ -236,6 +241,10 @@ struct vcpu
     spinlock_t       maptrack_freelist_lock;
     unsigned int     maptrack_head;
     unsigned int     maptrack_tail;
+    /* Lock-free stash of free handles, only touched by the vCPU itself. */
+#define MAPTRACK_CACHE_SIZE 16
+    unsigned int     maptrack_cache_nr;
+    unsigned int     maptrack_cache[MAPTRACK_CACHE_SIZE];
 
     /* IRQ-safe virq_lock protects against delivering VIRQ to stale evtchn. */
     evtchn_port_t    virq_to_evtchn[NR_VIRQS];
@@ -331,6 +340,9 @@ struct domain
 
     spinlock_t       domain_lock;
 
+    /* vCPU runstates mappable by tools, see XENMEM_resource_vcpu_runstate */
+    struct xen_mem_vcpu_runstate *shared_runstate;
+
     spinlock_t       page_alloc_lock; /* protects all the following fields  */
     struct page_list_head page_list;  /* linked list */
     struct page_list_head extra_page_list; /* linked list (size extra_pages) */
@@ -349,13 +361,20 @@ struct domain
     atomic_t         shr_pages;         /* shared pages */
     atomic_t         paged_pages;       /* paged-out pages */
 
+#ifdef CONFIG_LLC_COLORING
+    /* LLC colors the domain's memory is allocated from. */
+    const unsigned int *llc_colors;
+    unsigned int     num_llc_colors;
+#endif
+
     /* Scheduling. */
     void            *sched_priv;    /* scheduler-specific data */
     struct sched_unit *sched_unit_list;
     struct cpupool  *cpupool;
+    /* vcpu_yield_to_preempted() round robin position. */
+    unsigned int     last_yield_target;
 
     struct domain   *next_in_list;
-    struct domain   *next_in_hashbucket;
 
     struct list_head rangesets;
     spinlock_t       rangesets_lock;
@@ -365,6 +384,13 @@ struct domain
     struct evtchn  **evtchn_group[NR_EVTCHN_GROUPS]; /* all other buckets */
     unsigned int     max_evtchn_port; /* max permitted port number */
     unsigned int     valid_evtchns;   /* number of allocated event channels */
+    /*
+     * Bitmap of ports below valid_evtchns which are allocated, sized to
+     * evtchn_port_map_bits (possibly more than valid_evtchns).  Protected by
+     * event_lock.
+     */
+    unsigned long   *evtchn_port_map;
+    unsigned int     evtchn_port_map_bits;
     /*
      * Number of in-use event channels.  Writers should use write_atomic().
      * Readers need to use read_atomic() only when not holding event_lock.
@@ -433,6 +459,13 @@ struct domain
 #else
     unsigned long   *poll_mask;
 #endif
+    /*
+     * Number of pollers of the ports hashing to each bucket, and of pollers
+     * interested in any port, letting evtchn_check_pollers() skip the walk
+     * of poll_mask for ports nobody polls.
+     */
+    atomic_t        *poll_hash;
+    atomic_t         poll_wildcards;
 
     /* I/O capabilities (access to IRQs and memory-mapped I/O). */
     struct rangeset *iomem_caps;
@@ -487,6 +520,12 @@ struct domain
      */
     spinlock_t hypercall_deadlock_mutex;
 
+    /*
+     * Serialises toolstack operations on this domain, see
+     * domctl_lock_acquire().
+     */
+    rwlock_t domctl_lock;
+
     struct lock_profile_qhead profile_head;
 
     /* Various vm_events */
@@ -547,7 +586,7 @@ static inline unsigned int domain_tot_pages(const struct domain *d)
     return d->tot_pages - d->extra_pages;
 }
 
-/* Protect updates/reads (resp.) of domain_list and domain_hash. */
+/* Protect updates/reads (resp.) of domain_list and domain_table. */
 extern spinlock_t domlist_update_lock;
 extern rcu_read_lock_t domlist_read_lock;
 
@@ -695,11 +734,15 @@ int  sched_init_vcpu(struct vcpu *v);
 void sched_destroy_vcpu(struct vcpu *v);
 int  sched_init_domain(struct domain *d, unsigned int poolid);
 void sched_destroy_domain(struct domain *d);
+int sched_acquire_runstate(struct domain *d, unsigned long frame,
+                           unsigned int nr_frames, xen_pfn_t mfn_list[]);
 long sched_adjust(struct domain *, struct xen_domctl_scheduler_op *);
 long sched_adjust_global(struct xen_sysctl_scheduler_op *);
 int  sched_id(void);
 void vcpu_wake(struct vcpu *v);
+void domain_wake(struct domain *d);
 long vcpu_yield(void);
+long vcpu_yield_to_preempted(void);
 void vcpu_sleep_nosync(struct vcpu *v);
 void vcpu_sleep_sync(struct vcpu *v);
 
@@ -779,6 +822,8 @@ static inline void hypercall_cancel_continuation(struct vcpu *v)
     ))
 
 extern struct domain *domain_list;
+/* Bumped, under domlist_update_lock, whenever domain_list changes. */
+extern unsigned int domlist_generation;
 
 /* Caller must hold the domlist_read_lock or domlist_update_lock. */
 static inline struct domain *first_domain_in_cpupool(const struct cpupool *c)
@@ -81,6 +81,9 @@ struct lock_profile {
     s_time_t            time_hold;   /* cumulated lock time */
     s_time_t            time_block;  /* cumulated wait time */
     s_time_t            time_locked; /* system time of last locking */
+    s_time_t            time_hold_max;  /* longest single hold */
+    s_time_t            time_block_max; /* longest single wait */
+    unsigned int        waiters_max; /* most CPUs seen queued ahead */
 };
 
 struct lock_profile_qhead {
@@ -89,7 +92,7 @@ struct lock_profile_qhead {
     int32_t                   idx;     /* index for printout */
 };
 
-#define _LOCK_PROFILE(name) { 0, #name, &name, 0, 0, 0, 0, 0 }
+#define _LOCK_PROFILE(_name) { .name = #_name, .lock = &(_name) }
 #define _LOCK_PROFILE_PTR(name)                                               \
     static struct lock_profile * const __lock_profile_##name                  \
     __used_section(".lockprofile.data") =                                     \
@@ -13,10 +13,12 @@
 #include <xen/types.h>
 #include <xen/list.h>
 #include <xen/percpu.h>
+#include <xen/spinlock.h>
 
 struct tasklet
 {
     struct list_head list;
+    spinlock_t lock;
     int scheduled_on;
     bool_t is_softirq;
     bool_t is_running;
@@ -25,9 +27,15 @@ struct tasklet
     void *data;
 };
 
-#define _DECLARE_TASKLET(name, func, data, softirq)                     \
+#define _DECLARE_TASKLET(name, fn, arg, softirq)                        \
     struct tasklet name = {                                             \
-        LIST_HEAD_INIT(name.list), -1, softirq, 0, 0, func, data }
+        .list = LIST_HEAD_INIT(name.list),                              \
+        .lock = SPIN_LOCK_UNLOCKED,                                     \
+        .scheduled_on = -1,                                             \
+        .is_softirq = softirq,                                          \
+        .func = fn,                                                     \
+        .data = arg,                                                    \
+    }
 #define DECLARE_TASKLET(name, func, data)               \
     _DECLARE_TASKLET(name, func, data, 0)
 #define DECLARE_SOFTIRQ_TASKLET(name, func, data)       \
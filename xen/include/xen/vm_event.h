@@ -24,17 +24,18 @@
 #define __VM_EVENT_H__
 
 #include <xen/sched.h>
+#include <public/domctl.h>
 #include <public/vm_event.h>
 
 struct vm_event_domain
 {
     spinlock_t lock;
-    /* The ring has 64 entries */
-    unsigned char foreign_producers;
-    unsigned char target_producers;
-    /* shared ring page */
+    unsigned int foreign_producers;
+    unsigned int target_producers;
+    /* shared ring, virtually contiguous over nr_frames pages */
     void *ring_page;
-    struct page_info *ring_pg_struct;
+    unsigned int nr_frames;
+    struct page_info *ring_pg_struct[XEN_VM_EVENT_RING_FRAMES_MAX];
     /* front-end ring */
     vm_event_front_ring_t front_ring;
     /* event channel port (vcpu0 only) */
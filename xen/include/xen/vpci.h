@@ -173,6 +173,8 @@ int __must_check vpci_msix_arch_enable_entry(struct vpci_msix_entry *entry,
                                              paddr_t table_base);
 int __must_check vpci_msix_arch_disable_entry(struct vpci_msix_entry *entry,
                                               const struct pci_dev *pdev);
+int __must_check vpci_msix_arch_update_entry(struct vpci_msix_entry *entry,
+                                             const struct pci_dev *pdev);
 void vpci_msix_arch_init_entry(struct vpci_msix_entry *entry);
 int vpci_msix_arch_print(const struct vpci_msix *msix);
 
@@ -55,6 +55,7 @@ const struct selinux_class_perm selinux_class_perm = {
 #define AVC_CACHE_SLOTS            512
 #define AVC_DEF_CACHE_THRESHOLD        512
 #define AVC_CACHE_RECLAIM        16
+#define AVC_PCPU_SLOTS           16
 
 #ifdef CONFIG_XSM_FLASK_AVC_STATS
 #define avc_cache_stats_incr(field)    \
@@ -84,6 +85,19 @@ struct avc_cache {
     atomic_t        lru_hint;    /* LRU hint for reclaim scan */
     atomic_t        active_nodes;
     u32            latest_notif;    /* latest revocation notification */
+    atomic_t        generation;    /* bumped whenever a node goes away */
+};
+
+/*
+ * Small direct-mapped per-CPU cache of decisions in front of the shared
+ * hash table, so that hot checks neither walk hash chains nor touch
+ * remote cache lines.  Entries are copies, valid only as long as no node
+ * has been removed or replaced since they were taken (generation), and
+ * an empty slot has a zero tclass.
+ */
+struct avc_pcpu_cache {
+    unsigned int        generation;
+    struct avc_entry    slots[AVC_PCPU_SLOTS];
 };
 
 /* Exported via Flask hypercall */
@@ -94,6 +108,7 @@ DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats);
 #endif
 
 static struct avc_cache avc_cache;
+static DEFINE_PER_CPU(struct avc_pcpu_cache, avc_pcpu_cache);
 
 static DEFINE_RCU_READ_LOCK(avc_rcu_lock);
 
@@ -238,6 +253,7 @@ void __init avc_init(void)
     }
     atomic_set(&avc_cache.active_nodes, 0);
     atomic_set(&avc_cache.lru_hint, 0);
+    atomic_set(&avc_cache.generation, 0);
 }
 
 int avc_get_hash_stats(struct xen_flask_hash_stats *arg)
@@ -283,9 +299,17 @@ static void avc_node_free(struct rcu_head *rhead)
     avc_cache_stats_incr(frees);
 }
 
+static inline void avc_generation_bump(void)
+{
+    /* Order the unlinking of a node before the invalidation. */
+    smp_wmb();
+    atomic_inc(&avc_cache.generation);
+}
+
 static void avc_node_delete(struct avc_node *node)
 {
     hlist_del_rcu(&node->list);
+    avc_generation_bump();
     call_rcu(&node->rhead, avc_node_free);
     atomic_dec(&avc_cache.active_nodes);
 }
@@ -300,6 +324,7 @@ static void avc_node_kill(struct avc_node *node)
 static void avc_node_replace(struct avc_node *new, struct avc_node *old)
 {
     hlist_replace_rcu(&old->list, &new->list);
+    avc_generation_bump();
     call_rcu(&old->rhead, avc_node_free);
     atomic_dec(&avc_cache.active_nodes);
 }
@@ -695,7 +720,10 @@ int avc_ss_reset(u32 seqno)
         rcu_read_unlock(&avc_rcu_lock);
         spin_unlock_irqrestore(lock, flag);
     }
-    
+
+    /* Drop per-CPU copies even if the shared cache was empty. */
+    avc_generation_bump();
+
     avc_latest_notif_update(seqno, 0);
     return rc;
 }
@@ -719,16 +747,77 @@ int avc_ss_reset(u32 seqno)
  * auditing, e.g. in cases where a lock must be held for the check but
  * should be released for the auditing.
  */
+static inline const struct avc_entry *avc_pcpu_lookup(
+    u32 ssid, u32 tsid, u16 tclass, unsigned int generation)
+{
+    struct avc_pcpu_cache *pc = &this_cpu(avc_pcpu_cache);
+    const struct avc_entry *ae;
+
+    if ( unlikely(pc->generation != generation) )
+    {
+        memset(pc->slots, 0, sizeof(pc->slots));
+        pc->generation = generation;
+        return NULL;
+    }
+
+    ae = &pc->slots[avc_hash(ssid, tsid, tclass) & (AVC_PCPU_SLOTS - 1)];
+    if ( ae->ssid == ssid && ae->tsid == tsid && ae->tclass == tclass )
+        return ae;
+
+    return NULL;
+}
+
+static inline void avc_pcpu_insert(u32 ssid, u32 tsid, u16 tclass,
+                                   const struct av_decision *avd,
+                                   unsigned int generation)
+{
+    struct avc_pcpu_cache *pc = &this_cpu(avc_pcpu_cache);
+    struct avc_entry *ae;
+
+    if ( pc->generation != generation )
+        return;
+
+    ae = &pc->slots[avc_hash(ssid, tsid, tclass) & (AVC_PCPU_SLOTS - 1)];
+    ae->ssid = ssid;
+    ae->tsid = tsid;
+    ae->tclass = tclass;
+    ae->avd = *avd;
+}
+
 int avc_has_perm_noaudit(u32 ssid, u32 tsid, u16 tclass, u32 requested,
                          struct av_decision *in_avd)
 {
     struct avc_node *node;
     struct av_decision avd_entry, *avd;
+    const struct avc_entry *ae;
+    unsigned int generation;
+    unsigned long flags;
     int rc = 0;
     u32 denied;
 
     BUG_ON(!requested);
 
+    /*
+     * Fast path: a fully granting decision in this CPU's cache.  Anything
+     * else (including denials, which may need to update the shared entry
+     * when permissive) goes through the shared cache below.
+     */
+    generation = atomic_read(&avc_cache.generation);
+    smp_rmb();
+
+    local_irq_save(flags);
+    ae = avc_pcpu_lookup(ssid, tsid, tclass, generation);
+    if ( ae && !(requested & ~ae->avd.allowed) )
+    {
+        if ( in_avd )
+            *in_avd = ae->avd;
+        local_irq_restore(flags);
+        avc_cache_stats_incr(lookups);
+        avc_cache_stats_incr(hits);
+        return 0;
+    }
+    local_irq_restore(flags);
+
     rcu_read_lock(&avc_rcu_lock);
 
     node = avc_lookup(ssid, tsid, tclass);
@@ -746,10 +835,20 @@ int avc_has_perm_noaudit(u32 ssid, u32 tsid, u16 tclass, u32 requested,
             goto out;
         rcu_read_lock(&avc_rcu_lock);
         node = avc_insert(ssid,tsid,tclass,avd);
+        if ( node )
+        {
+            local_irq_save(flags);
+            avc_pcpu_insert(ssid, tsid, tclass, avd, generation);
+            local_irq_restore(flags);
+        }
     } else {
         if ( in_avd )
             memcpy(in_avd, &node->ae.avd, sizeof(*in_avd));
         avd = &node->ae.avd;
+
+        local_irq_save(flags);
+        avc_pcpu_insert(ssid, tsid, tclass, avd, generation);
+        local_irq_restore(flags);
     }
 
     denied = requested & ~(avd->allowed);